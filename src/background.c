@@ -18,6 +18,13 @@
 #include "image.h"
 #include "gradient.h"
 #include "hint.h"
+#include "render.h"
+#include "stats.h"
+#include "event.h"
+#include "timing.h"
+#include "settings.h"
+#include "shm.h"
+#include "bulk.h"
 
 /** Enumeration of background types. */
 typedef unsigned char BackgroundType;
@@ -34,6 +41,10 @@ typedef struct BackgroundNode {
    BackgroundType type;          /**< The type of background. */
    char *value;
    Pixmap pixmap;
+   size_t pixmapSize;            /**< Size of the pixmap in bytes. */
+   struct BackgroundNode *source;   /**< Background with the same pixmap
+                                     *   (NULL if this has its own). */
+   char loaded;                  /**< Set once the pixmap is built. */
    struct BackgroundNode *next;  /**< Next background in the list. */
 } BackgroundNode;
 
@@ -46,8 +57,21 @@ static BackgroundNode *defaultBackground;
 /** The last background loaded. */
 static BackgroundNode *lastBackground;
 
+/** The pixmap published in _XROOTPMAP_ID (None if not ours). */
+static Pixmap publishedPixmap;
+
+static BackgroundNode *PrepareBackground(BackgroundNode *bp);
+static void ReleaseBackground(BackgroundNode *bp);
+static void PublishBackground(Pixmap pixmap);
+static void PrepareBackgrounds(const TimeType *now, int x, int y, Window w,
+                               void *data);
 static void LoadGradientBackground(BackgroundNode *bp);
 static void LoadImageBackground(BackgroundNode *bp);
+static char PutBulkBackground(BackgroundNode *bp, IconNode *ip,
+                              int width, int height);
+#ifdef USE_BULK
+static void FinishBulkBackground(void *data);
+#endif
 
 /** Initialize any data needed for background support. */
 void InitializeBackgrounds(void)
@@ -55,51 +79,158 @@ void InitializeBackgrounds(void)
    backgrounds = NULL;
    defaultBackground = NULL;
    lastBackground = NULL;
+   publishedPixmap = None;
 }
 
-/** Startup background support. */
+/** Startup background support.
+ * Pixmaps are built when first shown or from the event loop, one
+ * background at a time, so startup only waits for the current desktop.
+ * With LowMemory, only the pixmap being shown is kept.
+ */
 void StartupBackgrounds(void)
 {
 
    BackgroundNode *bp;
+   BackgroundNode *other;
+
+   for(bp = backgrounds; bp; bp = bp->next) {
+
+      /* Desktops with the same background share a pixmap. */
+      bp->source = NULL;
+      bp->loaded = 0;
+      bp->pixmap = None;
+      for(other = backgrounds; other != bp; other = other->next) {
+         if(  other->source == NULL && other->type == bp->type
+            && !strcmp(other->value, bp->value)) {
+            bp->source = other;
+            break;
+         }
+      }
+
+      if(bp->desktop == -1) {
+         defaultBackground = bp;
+      }
 
+   }
+
+   if(backgrounds && !settings.lowMemory) {
+      RegisterTimeout(0, PrepareBackgrounds, NULL);
+   }
+
+}
+
+/** Shutdown background support. */
+void ShutdownBackgrounds(void)
+{
+   BackgroundNode *bp;
+   UnregisterTimeout(PrepareBackgrounds, NULL);
    for(bp = backgrounds; bp; bp = bp->next) {
+      if(bp->source == NULL) {
+         ReleaseBackground(bp);
+      }
+      bp->pixmap = None;
+      bp->loaded = 0;
+   }
+   lastBackground = NULL;
+}
+
+/** Free the pixmap of a background.
+ * The pixmap is built again when the background is next shown.
+ */
+void ReleaseBackground(BackgroundNode *bp)
+{
+   if(bp->pixmap != None) {
+      CancelBulk(bp);
+      if(bp->pixmap == publishedPixmap) {
+         PublishBackground(None);
+      }
+      ReleaseRenderTarget(bp->pixmap);
+      JXFreePixmap(display, bp->pixmap);
+      RecordPixmapStats(PIXMAP_BACKGROUND, -(long)bp->pixmapSize);
+      bp->pixmap = None;
+   }
+   bp->loaded = 0;
+}
 
-      /* Load background data. */
+/** Rebuild the backgrounds that depend on the size of the root window. */
+void UpdateBackgrounds(void)
+{
+   BackgroundNode *bp;
+   char reload = 0;
+
+   for(bp = backgrounds; bp; bp = bp->next) {
+      if(bp->source || !bp->loaded) {
+         continue;
+      }
       switch(bp->type) {
-      case BACKGROUND_SOLID:
       case BACKGROUND_GRADIENT:
-         LoadGradientBackground(bp);
-         break;
-      case BACKGROUND_COMMAND:
-         /* Nothing to do. */
-         break;
       case BACKGROUND_STRETCH:
-      case BACKGROUND_TILE:
       case BACKGROUND_SCALE:
-         LoadImageBackground(bp);
+         ReleaseBackground(bp);
+         reload = 1;
+         break;
+      case BACKGROUND_COMMAND:
+         /* Run the command again in case it draws for the size. */
+         reload = 1;
          break;
       default:
-         Debug("invalid background type in LoadBackground: %d", bp->type);
          break;
       }
+   }
 
-      if(bp->desktop == -1) {
-         defaultBackground = bp;
+   if(reload) {
+      lastBackground = NULL;
+      LoadBackground(currentDesktop);
+      if(!settings.lowMemory) {
+         RegisterTimeout(0, PrepareBackgrounds, NULL);
       }
-
    }
+}
 
+/** Build the pixmap for a background if not already built.
+ * @return The background that owns the pixmap.
+ */
+BackgroundNode *PrepareBackground(BackgroundNode *bp)
+{
+   if(bp->source) {
+      bp = bp->source;
+   }
+   if(bp->loaded) {
+      return bp;
+   }
+   bp->loaded = 1;
+
+   /* Load background data. */
+   switch(bp->type) {
+   case BACKGROUND_SOLID:
+   case BACKGROUND_GRADIENT:
+      LoadGradientBackground(bp);
+      break;
+   case BACKGROUND_COMMAND:
+      /* Nothing to do. */
+      break;
+   case BACKGROUND_STRETCH:
+   case BACKGROUND_TILE:
+   case BACKGROUND_SCALE:
+      LoadImageBackground(bp);
+      break;
+   default:
+      Debug("invalid background type in LoadBackground: %d", bp->type);
+      break;
+   }
+   return bp;
 }
 
-/** Shutdown background support. */
-void ShutdownBackgrounds(void)
+/** Build the next background that has not been shown yet. */
+void PrepareBackgrounds(const TimeType *now, int x, int y, Window w,
+                        void *data)
 {
    BackgroundNode *bp;
    for(bp = backgrounds; bp; bp = bp->next) {
-      if(bp->pixmap != None) {
-         JXFreePixmap(display, bp->pixmap);
-         bp->pixmap = None;
+      if(bp->source == NULL && !bp->loaded) {
+         PrepareBackground(bp);
+         RegisterTimeout(0, PrepareBackgrounds, NULL);
+         return;
       }
    }
 }
@@ -173,6 +304,9 @@ void SetBackground(int desktop, const char *type, const char *value)
    bp->type = bgType;
    bp->value = CopyString(value);
    bp->pixmap = None;
+   bp->pixmapSize = 0;
+   bp->source = NULL;
+   bp->loaded = 0;
 
    /* Insert the node into the list. */
    bp->next = backgrounds;
@@ -187,6 +321,7 @@ void LoadBackground(int desktop)
    XSetWindowAttributes attr;
    unsigned long attrValues;
    BackgroundNode *bp;
+   BackgroundNode *previous;
 
    /* Determine the background to load. */
    for(bp = backgrounds; bp; bp = bp->next) {
@@ -209,20 +344,67 @@ void LoadBackground(int desktop)
       && !strcmp(bp->value, lastBackground->value)) {
       return;
    }
+   previous = lastBackground;
    lastBackground = bp;
 
    /* Load the background based on type. */
    if(bp->type == BACKGROUND_COMMAND) {
+      /* The command publishes its own pixmap. */
+      PublishBackground(None);
       RunCommand(bp->value);
+   } else {
+      bp = PrepareBackground(bp);
+      attrValues = CWBackPixmap;
+      attr.background_pixmap = bp->pixmap;
+      JXChangeWindowAttributes(display, rootWindow, attrValues, &attr);
+      PublishBackground(bp->pixmap);
+      JXClearWindow(display, rootWindow);
+   }
+
+   /* Free the background no longer shown if saving memory. */
+   if(settings.lowMemory && previous) {
+      if(previous->source) {
+         previous = previous->source;
+      }
+      if(previous != bp) {
+         ReleaseBackground(previous);
+      }
+   }
+
+}
+
+/** Publish the root pixmap for pseudo-transparent clients.
+ * Programs that set the background and exit keep their pixmap alive and
+ * name it in ESETROOT_PMAP_ID as well; they are killed to free it, as
+ * those programs do for each other. JWM frees its own pixmaps, so it only
+ * sets _XROOTPMAP_ID: naming one in ESETROOT_PMAP_ID would let the next
+ * such program kill JWM.
+ * @param pixmap The pixmap (None to remove the property).
+ */
+void PublishBackground(Pixmap pixmap)
+{
+   Pixmap retained;
+   Pixmap current;
+
+   if(pixmap == None) {
+      if(publishedPixmap != None) {
+         JXDeleteProperty(display, rootWindow, atoms[ATOM_XROOTPMAP_ID]);
+         publishedPixmap = None;
+      }
       return;
    }
 
-   attrValues = CWBackPixmap;
-   attr.background_pixmap = bp->pixmap;
-   JXChangeWindowAttributes(display, rootWindow, attrValues, &attr);
-   SetPixmapAtom(rootWindow, ATOM_XROOTPMAP_ID, bp->pixmap);
-   JXClearWindow(display, rootWindow);
+   if(GetPixmapAtom(rootWindow, ATOM_ESETROOT_PMAP_ID, &retained)) {
+      if(  retained != None
+         && GetPixmapAtom(rootWindow, ATOM_XROOTPMAP_ID, &current)
+         && current == retained) {
+         JXKillClient(display, retained);
+      }
+      JXDeleteProperty(display, rootWindow, atoms[ATOM_ESETROOT_PMAP_ID]);
+   }
 
+   SetPixmapAtom(rootWindow, ATOM_XROOTPMAP_ID, pixmap);
+   publishedPixmap = pixmap;
 }
 
 /** Load a gradient background. */
@@ -268,14 +450,17 @@ void LoadGradientBackground(BackgroundNode *bp)
    if(color1.pixel == color2.pixel) {
       bp->pixmap = JXCreatePixmap(display, rootWindow, 1, 1,
                                   rootDepth);
+      bp->pixmapSize = GetPixmapSize(1, 1, rootDepth);
       JXSetForeground(display, rootGC, color1.pixel);
       JXDrawPoint(display, bp->pixmap, rootGC, 0, 0);
    } else {
       bp->pixmap = JXCreatePixmap(display, rootWindow, 1, rootHeight,
                                   rootDepth);
+      bp->pixmapSize = GetPixmapSize(1, rootHeight, rootDepth);
       DrawHorizontalGradient(bp->pixmap, rootGC, color1.pixel,
                              color2.pixel, 0, 0, 1, rootHeight);
    }
+   RecordPixmapStats(PIXMAP_BACKGROUND, (long)bp->pixmapSize);
 
 }
 
@@ -306,15 +491,73 @@ void LoadImageBackground(BackgroundNode *bp)
 
    /* Create the pixmap. */
    bp->pixmap = JXCreatePixmap(display, rootWindow, width, height, rootDepth);
+   bp->pixmapSize = GetPixmapSize(width, height, rootDepth);
+   RecordPixmapStats(PIXMAP_BACKGROUND, (long)bp->pixmapSize);
 
    /* Clear the pixmap in case it is too small. */
    JXSetForeground(display, rootGC, 0);
    JXFillRectangle(display, bp->pixmap, rootGC, 0, 0, width, height);
 
    /* Draw the icon on the background pixmap. */
-   PutIcon(ip, bp->pixmap, 0, 0, 0, width, height);
+   if(!PutBulkBackground(bp, ip, width, height)) {
+      PutIcon(ip, bp->pixmap, 0, 0, 0, width, height);
+   }
 
    /* We don't need the icon anymore. */
    DestroyIcon(ip);
 
 }
+
+/** Upload an image background on the bulk connection.
+ * This is only worth it when the image would otherwise go through the
+ * main connection, that is, without shared memory. The pixmap stays
+ * black until the upload is done.
+ * @return 1 if the upload was queued, 0 to draw the image directly.
+ */
+char PutBulkBackground(BackgroundNode *bp, IconNode *ip,
+                       int width, int height)
+{
+#ifdef USE_BULK
+   XImage *image;
+
+#ifdef USE_SHM
+   if(haveShm) {
+      return 0;
+   }
+#endif
+   if(!haveBulk) {
+      return 0;
+   }
+   image = CreateIconImage(ip, width, height);
+   if(!image) {
+      return 0;
+   }
+   if(!PutBulkImage(bp->pixmap, image, (width - image->width) / 2,
+                    (height - image->height) / 2,
+                    FinishBulkBackground, bp)) {
+      DestroyUploadImage(image);
+      return 0;
+   }
+   return 1;
+#else
+   return 0;
+#endif
+}
+
+#ifdef USE_BULK
+
+/** Show an image background once it has been uploaded. */
+void FinishBulkBackground(void *data)
+{
+   BackgroundNode *bp = (BackgroundNode*)data;
+   BackgroundNode *shown = lastBackground;
+   if(shown && shown->source) {
+      shown = shown->source;
+   }
+   if(shown == bp && bp->pixmap != None) {
+      /* Publish again so pseudo-transparent clients redraw. */
+      PublishBackground(bp->pixmap);
+      JXClearWindow(display, rootWindow);
+   }
+}
+#endif
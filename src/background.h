@@ -24,6 +24,11 @@ void DestroyBackgrounds(void);
  */
 void SetBackground(int desktop, const char *type, const char *value);
 
+/** Rebuild the backgrounds that depend on the size of the root window.
+ * The background of the current desktop is loaded again if needed.
+ */
+void UpdateBackgrounds(void);
+
 /** Load the background for the specified desktop.
  * @param desktop The current desktop.
  */
@@ -0,0 +1,272 @@
+/**
+ * @file bench.c
+ * @author Joe Wingbermuehle
+ * @date 2026
+ *
+ * @brief Rendering benchmark against a live X server.
+ *
+ * Each primitive is drawn many times into an off-screen pixmap using
+ * the colors, fonts, and icons from the configuration. Client time is
+ * the time taken to issue the requests; server time is the wait for
+ * the server to finish them afterwards.
+ *
+ */
+
+#include "jwm.h"
+
+#ifdef USE_BENCH
+
+#include "bench.h"
+#include "main.h"
+#include "color.h"
+#include "font.h"
+#include "icon.h"
+#include "gradient.h"
+#include "border.h"
+#include "render.h"
+#include "shm.h"
+#include "timing.h"
+#include "misc.h"
+
+/** Number of times each primitive is drawn. */
+#define BENCH_ITERATIONS   500
+
+/** Size of the off-screen pixmap. */
+#define BENCH_WIDTH        800
+#define BENCH_HEIGHT       400
+
+/** Number of items drawn in a menu. */
+#define BENCH_MENU_ITEMS   10
+
+/** Size of the image uploaded by the upload primitive. */
+#define BENCH_IMAGE_SIZE   256
+
+/** Text drawn by the primitives. */
+static const char * const BENCH_TEXT[] = {
+   "Terminal - user@host: ~/src/jwm",
+   "Mozilla Firefox",
+   "Document 1 - Editor",
+   "Applications"
+};
+#define BENCH_TEXT_COUNT   ARRAY_LENGTH(BENCH_TEXT)
+
+/** A primitive to measure. */
+typedef struct BenchPrimitive {
+   const char *name;
+   void (*Draw)(Drawable d, int i);
+} BenchPrimitive;
+
+static void DrawGradientBench(Drawable d, int i);
+static void DrawStringBench(Drawable d, int i);
+static void DrawIconBench(Drawable d, int i);
+static void DrawUploadBench(Drawable d, int i);
+static void DrawFrameBench(Drawable d, int i);
+static void DrawTrayBench(Drawable d, int i);
+static void DrawMenuBench(Drawable d, int i);
+
+static const BenchPrimitive PRIMITIVES[] = {
+   { "gradient",  DrawGradientBench  },
+   { "string",    DrawStringBench    },
+   { "icon",      DrawIconBench      },
+   { "upload",    DrawUploadBench    },
+   { "frame",     DrawFrameBench     },
+   { "tray",      DrawTrayBench      },
+   { "menu",      DrawMenuBench      }
+};
+#define PRIMITIVE_COUNT    ARRAY_LENGTH(PRIMITIVES)
+
+static IconNode *benchIcon;
+
+static unsigned long long MeasureRoundTrip(void);
+
+/** Render frames, trays, and menus off-screen and report the time taken. */
+void RunRenderBenchmark(void)
+{
+   Pixmap d;
+   unsigned long long roundTrip;
+   unsigned int x;
+   int i;
+
+   printf("render benchmark: xrender %s, fonts %s, mit-shm %s\n",
+#ifdef USE_XRENDER
+          haveRender ? "on" : "off",
+#else
+          "n/a",
+#endif
+#if defined(USE_PANGO)
+          "pango",
+#elif defined(USE_XFT)
+          "xft",
+#else
+          "core",
+#endif
+#ifdef USE_SHM
+          haveShm ? "on" : "off"
+#else
+          "n/a"
+#endif
+          );
+
+   d = JXCreatePixmap(display, rootWindow, BENCH_WIDTH, BENCH_HEIGHT,
+                      rootDepth);
+   benchIcon = GetDefaultIcon();
+   roundTrip = MeasureRoundTrip();
+   printf("   round trip: %llu us\n", roundTrip);
+   printf("   %-10s %10s %12s %12s\n",
+          "primitive", "count", "client us", "server us");
+
+   for(x = 0; x < PRIMITIVE_COUNT; x++) {
+      unsigned long long start, client, server;
+
+      /* Draw once first so caches are filled as in normal use. */
+      (PRIMITIVES[x].Draw)(d, 0);
+      JXSync(display, False);
+
+      start = GetMonotonicTime();
+      for(i = 0; i < BENCH_ITERATIONS; i++) {
+         (PRIMITIVES[x].Draw)(d, i);
+      }
+      client = GetMonotonicTime() - start;
+      start = GetMonotonicTime();
+      JXSync(display, False);
+      server = GetMonotonicTime() - start;
+      server = server > roundTrip ? server - roundTrip : 0;
+
+      printf("   %-10s %10d %12.2f %12.2f\n", PRIMITIVES[x].name,
+             BENCH_ITERATIONS,
+             (double)client / BENCH_ITERATIONS,
+             (double)server / BENCH_ITERATIONS);
+   }
+
+   ReleaseRenderTarget(d);
+   ReleaseFontTarget(d);
+   JXFreePixmap(display, d);
+}
+
+/** Get the time in microseconds of a round trip with nothing queued. */
+unsigned long long MeasureRoundTrip(void)
+{
+   unsigned long long start;
+   int i;
+   JXSync(display, False);
+   start = GetMonotonicTime();
+   for(i = 0; i < 16; i++) {
+      JXSync(display, False);
+   }
+   return (GetMonotonicTime() - start) / 16;
+}
+
+/** Draw a title bar gradient. */
+void DrawGradientBench(Drawable d, int i)
+{
+   DrawHorizontalGradient(d, rootGC, colors[COLOR_TITLE_BG1],
+                          colors[COLOR_TITLE_BG2], 0, 0,
+                          BENCH_WIDTH, GetTitleHeight());
+}
+
+/** Draw a window title. */
+void DrawStringBench(Drawable d, int i)
+{
+   RenderString(d, FONT_BORDER, COLOR_TITLE_FG, 4, 2, BENCH_WIDTH - 8,
+                BENCH_TEXT[i % BENCH_TEXT_COUNT]);
+}
+
+/** Draw the default icon at a few sizes. */
+void DrawIconBench(Drawable d, int i)
+{
+   if(benchIcon) {
+      PutIcon(benchIcon, d, colors[COLOR_TITLE_FG], 0, 0,
+              16 + (i % 4) * 8, 16 + (i % 4) * 8);
+   }
+}
+
+/** Upload an image large enough to use shared memory when available. */
+void DrawUploadBench(Drawable d, int i)
+{
+   XImage *image = CreateUploadImage(rootDepth, BENCH_IMAGE_SIZE,
+                                     BENCH_IMAGE_SIZE);
+   memset(image->data, i, image->bytes_per_line * image->height);
+   PutUploadImage(d, rootGC, image, 0, 0);
+   DestroyUploadImage(image);
+}
+
+/** Draw a title bar as DrawBorder does for a frame. */
+void DrawFrameBench(Drawable d, int i)
+{
+   const unsigned titleHeight = GetTitleHeight();
+   const char *title = BENCH_TEXT[i % BENCH_TEXT_COUNT];
+   const ColorType fg = (i & 1) ? COLOR_TITLE_ACTIVE_FG : COLOR_TITLE_FG;
+   const long bg1 = colors[(i & 1) ? COLOR_TITLE_ACTIVE_BG1
+                                   : COLOR_TITLE_BG1];
+   const long bg2 = colors[(i & 1) ? COLOR_TITLE_ACTIVE_BG2
+                                   : COLOR_TITLE_BG2];
+
+   DrawHorizontalGradient(d, rootGC, bg1, bg2, 0, 0,
+                          BENCH_WIDTH, titleHeight);
+   if(benchIcon) {
+      PutIcon(benchIcon, d, colors[fg], 2, 2,
+              titleHeight - 4, titleHeight - 4);
+   }
+   RenderString(d, FONT_BORDER, fg, titleHeight + 4,
+                (titleHeight - GetStringHeight(FONT_BORDER)) / 2,
+                BENCH_WIDTH - titleHeight * 4, title);
+   JXSetForeground(display, rootGC, colors[COLOR_TITLE_DOWN]);
+   JXDrawRectangle(display, d, rootGC, 0, 0,
+                   BENCH_WIDTH - 1, titleHeight - 1);
+}
+
+/** Draw a tray with a few task list entries and a clock. */
+void DrawTrayBench(Drawable d, int i)
+{
+   const int height = GetStringHeight(FONT_TRAY) + 8;
+   const int itemWidth = BENCH_WIDTH / 5;
+   int x;
+
+   DrawHorizontalGradient(d, rootGC, colors[COLOR_TRAY_BG1],
+                          colors[COLOR_TRAY_BG2], 0, 0,
+                          BENCH_WIDTH, height);
+   for(x = 0; x < 4; x++) {
+      const int offset = x * itemWidth;
+      if(benchIcon) {
+         PutIcon(benchIcon, d, colors[COLOR_TRAY_FG], offset + 2, 2,
+                 height - 4, height - 4);
+      }
+      RenderString(d, FONT_TRAY, COLOR_TRAY_FG, offset + height, 4,
+                   itemWidth - height - 4,
+                   BENCH_TEXT[(i + x) % BENCH_TEXT_COUNT]);
+   }
+   RenderString(d, FONT_CLOCK, COLOR_CLOCK_FG, BENCH_WIDTH - itemWidth, 4,
+                itemWidth, GetTimeString("%I:%M %p", NULL));
+}
+
+/** Draw a menu with one item selected. */
+void DrawMenuBench(Drawable d, int i)
+{
+   const int itemHeight = GetStringHeight(FONT_MENU) + 4;
+   const int width = BENCH_WIDTH / 3;
+   const int active = i % BENCH_MENU_ITEMS;
+   int x;
+
+   JXSetForeground(display, rootGC, colors[COLOR_MENU_BG]);
+   JXFillRectangle(display, d, rootGC, 0, 0, width,
+                   itemHeight * BENCH_MENU_ITEMS);
+   for(x = 0; x < BENCH_MENU_ITEMS; x++) {
+      const int y = x * itemHeight;
+      ColorType fg = COLOR_MENU_FG;
+      if(x == active) {
+         DrawHorizontalGradient(d, rootGC, colors[COLOR_MENU_ACTIVE_BG1],
+                                colors[COLOR_MENU_ACTIVE_BG2], 0, y,
+                                width, itemHeight);
+         fg = COLOR_MENU_ACTIVE_FG;
+      }
+      if(benchIcon) {
+         PutIcon(benchIcon, d, colors[fg], 2, y + 2,
+                 itemHeight - 4, itemHeight - 4);
+      }
+      RenderString(d, FONT_MENU, fg, itemHeight + 2, y + 2,
+                   width - itemHeight - 4,
+                   BENCH_TEXT[x % BENCH_TEXT_COUNT]);
+   }
+}
+
+#endif /* USE_BENCH */
@@ -0,0 +1,23 @@
+/**
+ * @file bench.h
+ * @author Joe Wingbermuehle
+ * @date 2026
+ *
+ * @brief Rendering benchmark against a live X server.
+ *
+ */
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#ifdef USE_BENCH
+
+/** Render frames, trays, and menus off-screen and report the time taken.
+ * Colors, fonts, and icons must be started from the configuration.
+ * Results for each primitive are written to standard output.
+ */
+void RunRenderBenchmark(void);
+
+#endif /* USE_BENCH */
+
+#endif /* BENCH_H */
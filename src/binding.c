@@ -45,6 +45,9 @@ static const ModifierNode MODIFIERS[] = {
 };
 static const unsigned MODIFIER_COUNT = ARRAY_LENGTH(MODIFIERS);
 
+/** Number of buckets in the binding table (a power of 2). */
+#define BINDING_TABLE_SIZE 256
+
 typedef struct KeyNode {
 
    /* These are filled in when the configuration file is parsed */
@@ -58,6 +61,9 @@ typedef struct KeyNode {
    /* This is filled in by StartupKeys if it isn't already set. */
    int code;
 
+   /* The next binding in the same bucket of the binding table. */
+   struct KeyNode *hashNext;
+
 } KeyNode;
 
 typedef struct LockNode {
@@ -70,31 +76,78 @@ static LockNode lockMods[] = {
    { XK_Num_Lock,    0 }
 };
 
+/** A key grabbed on a window.
+ * Each grab is held for every combination of the lock modifiers.
+ */
+typedef struct KeyGrab {
+   Window window;
+   int code;
+   unsigned int state;
+} KeyGrab;
+
 static KeyNode *bindings[MC_COUNT];
+static KeyNode *bindingTable[BINDING_TABLE_SIZE];
 unsigned lockMask;
 
+/* Grabs held on the server and the lock modifiers they were made with.
+ * These are kept across a reload so only changed grabs are sent. */
+static KeyGrab *keyGrabs = NULL;
+static unsigned int keyGrabCount = 0;
+static unsigned int grabLocks[ARRAY_LENGTH(lockMods)];
+
+static void BuildBindingTable(void);
+static unsigned int GetBindingHash(MouseContextType context, unsigned state,
+                                   int code);
+static KeyNode *FindBinding(MouseContextType context, unsigned state,
+                            int code);
 static unsigned int GetModifierMask(XModifierKeymap *modmap, KeySym key);
 static KeySym ParseKeyString(const char *str);
 static char ShouldGrab(ActionType key);
-static void GrabKey(KeyNode *np, Window win);
+static void UpdateLockMasks(void);
+static void UpdateKeyGrabs(void);
+static void SetKeyGrab(const KeyGrab *gp, const unsigned int *locks,
+                       char grab);
+static int CompareKeyGrabs(const void *a, const void *b);
 
 /** Initialize binding data. */
 void InitializeBindings(void)
 {
    memset(bindings, 0, sizeof(bindings));
+   memset(bindingTable, 0, sizeof(bindingTable));
    lockMask = 0;
 }
 
 /** Startup bindings. */
 void StartupBindings(void)
 {
+   UpdateBindings();
+}
 
-   XModifierKeymap *modmap;
+/** Update key codes and grabs for the current keyboard mapping. */
+void UpdateBindings(void)
+{
    KeyNode *np;
-   TrayType *tp;
-   int x;
 
-   /* Get the keys that we don't care about (num lock, etc). */
+   UpdateLockMasks();
+
+   /* Look up the key codes. */
+   for(np = bindings[MC_NONE]; np; np = np->next) {
+      if(np->symbol != NoSymbol) {
+         np->code = JXKeysymToKeycode(display, np->symbol);
+      }
+   }
+
+   UpdateKeyGrabs();
+   BuildBindingTable();
+}
+
+/** Get the keys that we don't care about (num lock, etc). */
+void UpdateLockMasks(void)
+{
+   XModifierKeymap *modmap;
+   unsigned int x;
+
+   lockMask = 0;
    modmap = JXGetModifierMapping(display);
    for(x = 0; x < ARRAY_LENGTH(lockMods); x++) {
       lockMods[x].mask = GetModifierMask(modmap, lockMods[x].symbol);
@@ -103,31 +156,204 @@ void StartupBindings(void)
    JXFreeModifiermap(modmap);
    lockMask |= Button1Mask | Button2Mask | Button3Mask
             | Button4Mask | Button5Mask | (1<<13) | (1<<14);
+}
+
+/** Grab the keys that are bound, releasing grabs no longer needed.
+ * The grabs wanted are compared with the grabs held so that a reload
+ * only sends the grabs that changed.
+ */
+void UpdateKeyGrabs(void)
+{
+   KeyNode *np;
+   TrayType *tp;
+   KeyGrab *wanted;
+   unsigned int wantedCount;
+   unsigned int windowCount;
+   unsigned int oldIndex, newIndex;
+   unsigned int locks[ARRAY_LENGTH(lockMods)];
+   unsigned int x;
 
-   /* Look up and grab the keys. */
+   /* Build the sorted list of grabs on the root and the trays. */
+   windowCount = 1;
+   for(tp = GetTrays(); tp; tp = tp->next) {
+      windowCount += 1;
+   }
+   wantedCount = 0;
+   for(np = bindings[MC_NONE]; np; np = np->next) {
+      if(np->code && ShouldGrab(np->action)) {
+         wantedCount += windowCount;
+      }
+   }
+   wanted = wantedCount ? Allocate(sizeof(KeyGrab) * wantedCount) : NULL;
+   wantedCount = 0;
    for(np = bindings[MC_NONE]; np; np = np->next) {
+      if(np->code && ShouldGrab(np->action)) {
+         wanted[wantedCount].window = rootWindow;
+         wanted[wantedCount].code = np->code;
+         wanted[wantedCount].state = np->state;
+         wantedCount += 1;
+         for(tp = GetTrays(); tp; tp = tp->next) {
+            wanted[wantedCount].window = tp->window;
+            wanted[wantedCount].code = np->code;
+            wanted[wantedCount].state = np->state;
+            wantedCount += 1;
+         }
+      }
+   }
+   if(wantedCount > 1) {
+      qsort(wanted, wantedCount, sizeof(KeyGrab), CompareKeyGrabs);
+      newIndex = 1;
+      for(x = 1; x < wantedCount; x++) {
+         if(CompareKeyGrabs(&wanted[newIndex - 1], &wanted[x])) {
+            wanted[newIndex] = wanted[x];
+            newIndex += 1;
+         }
+      }
+      wantedCount = newIndex;
+   }
 
-      /* Determine the key code. */
-      if(!np->code) {
-         np->code = JXKeysymToKeycode(display, np->symbol);
+   /* A change to the lock modifiers invalidates every grab. */
+   for(x = 0; x < ARRAY_LENGTH(lockMods); x++) {
+      locks[x] = lockMods[x].mask;
+   }
+   if(memcmp(locks, grabLocks, sizeof(locks))) {
+      for(oldIndex = 0; oldIndex < keyGrabCount; oldIndex++) {
+         SetKeyGrab(&keyGrabs[oldIndex], grabLocks, 0);
+      }
+      keyGrabCount = 0;
+      memcpy(grabLocks, locks, sizeof(locks));
+   }
+
+   /* Merge the sorted lists. */
+   oldIndex = 0;
+   newIndex = 0;
+   while(oldIndex < keyGrabCount || newIndex < wantedCount) {
+      int cmp;
+      if(oldIndex == keyGrabCount) {
+         cmp = 1;
+      } else if(newIndex == wantedCount) {
+         cmp = -1;
+      } else {
+         cmp = CompareKeyGrabs(&keyGrabs[oldIndex], &wanted[newIndex]);
       }
+      if(cmp < 0) {
+         SetKeyGrab(&keyGrabs[oldIndex], grabLocks, 0);
+         oldIndex += 1;
+      } else if(cmp > 0) {
+         SetKeyGrab(&wanted[newIndex], grabLocks, 1);
+         newIndex += 1;
+      } else {
+         oldIndex += 1;
+         newIndex += 1;
+      }
+   }
+
+   if(keyGrabs) {
+      Release(keyGrabs);
+   }
+   keyGrabs = wanted;
+   keyGrabCount = wantedCount;
+}
 
-      /* Grab the key if needed. */
-      if(ShouldGrab(np->action)) {
+/** Grab or release a key for each combination of the lock modifiers. */
+void SetKeyGrab(const KeyGrab *gp, const unsigned int *locks, char grab)
+{
+   const unsigned int maxIndex = 1 << ARRAY_LENGTH(lockMods);
+   unsigned int index;
+   unsigned int x;
 
-         /* Grab on the root. */
-         GrabKey(np, rootWindow);
+   for(index = 0; index < maxIndex; index++) {
 
-         /* Grab on the trays. */
-         for(tp = GetTrays(); tp; tp = tp->next) {
-            GrabKey(np, tp->window);
+      /* Compute the modifier mask. */
+      unsigned int mask = gp->state;
+      for(x = 0; x < ARRAY_LENGTH(lockMods); x++) {
+         if(index & (1 << x)) {
+            mask |= locks[x];
          }
+      }
 
+      if(grab) {
+         JXGrabKey(display, gp->code, mask, gp->window,
+                   True, GrabModeAsync, GrabModeAsync);
+      } else {
+         JXUngrabKey(display, gp->code, mask, gp->window);
       }
 
    }
 }
 
+/** Compare key grabs by window, key code, and modifiers. */
+int CompareKeyGrabs(const void *a, const void *b)
+{
+   const KeyGrab *ga = (const KeyGrab*)a;
+   const KeyGrab *gb = (const KeyGrab*)b;
+   if(ga->window != gb->window) {
+      return ga->window < gb->window ? -1 : 1;
+   }
+   if(ga->code != gb->code) {
+      return ga->code < gb->code ? -1 : 1;
+   }
+   if(ga->state != gb->state) {
+      return ga->state < gb->state ? -1 : 1;
+   }
+   return 0;
+}
+
+/** Build the table used to look up bindings.
+ * This must be done once all key codes are known.
+ */
+void BuildBindingTable(void)
+{
+   KeyNode *np;
+   unsigned int i;
+
+   memset(bindingTable, 0, sizeof(bindingTable));
+   for(i = 0; i < MC_COUNT; i++) {
+      for(np = bindings[i]; np; np = np->next) {
+
+         /* Append so the first match is the same as in the list. */
+         KeyNode **npp = &bindingTable[GetBindingHash(i, np->state,
+                                                      np->code)];
+         while(*npp) {
+            npp = &(*npp)->hashNext;
+         }
+         np->hashNext = NULL;
+         *npp = np;
+
+      }
+   }
+}
+
+/** Get the bucket in the binding table for a binding. */
+unsigned int GetBindingHash(MouseContextType context, unsigned state,
+                            int code)
+{
+   unsigned int hash = (unsigned int)code;
+   hash = hash * 31 + state;
+   hash = hash * 31 + context;
+   return (hash ^ (hash >> 8)) & (BINDING_TABLE_SIZE - 1);
+}
+
+/** Find the binding for an event. */
+KeyNode *FindBinding(MouseContextType context, unsigned state, int code)
+{
+   KeyNode *np;
+
+   /* Remove modifiers we don't care about from the state. */
+   state &= ~lockMask;
+
+   /* Mask off flags. */
+   context &= MC_MASK;
+
+   np = bindingTable[GetBindingHash(context, state, code)];
+   for(; np; np = np->hashNext) {
+      if(np->context == context && np->state == state && np->code == code) {
+         return np;
+      }
+   }
+   return NULL;
+}
+
 /** Shutdown bindings. */
 void ShutdownBindings(void)
 {
@@ -147,8 +373,32 @@ void ShutdownBindings(void)
       JXUngrabKey(display, AnyKey, AnyModifier, tp->window);
    }
 
-   /* Ungrab keys on the root. */
-   JXUngrabKey(display, AnyKey, AnyModifier, rootWindow);
+   if(shouldRestart) {
+
+      /* Keep the grabs on the root so keys stay bound while restarting.
+       * The trays are recreated, so their grabs are forgotten. */
+      unsigned int count = 0;
+      unsigned int x;
+      for(x = 0; x < keyGrabCount; x++) {
+         if(keyGrabs[x].window == rootWindow) {
+            keyGrabs[count] = keyGrabs[x];
+            count += 1;
+         }
+      }
+      keyGrabCount = count;
+
+   } else {
+
+      /* Ungrab keys on the root. */
+      JXUngrabKey(display, AnyKey, AnyModifier, rootWindow);
+      if(keyGrabs) {
+         Release(keyGrabs);
+         keyGrabs = NULL;
+      }
+      keyGrabCount = 0;
+      memset(grabLocks, 0, sizeof(grabLocks));
+
+   }
 }
 
 /** Destroy key data. */
@@ -165,6 +415,7 @@ void DestroyBindings(void)
          bindings[i] = np;
       }
    }
+   memset(bindingTable, 0, sizeof(bindingTable));
 }
 
 /** Grab a key. */
@@ -203,20 +454,12 @@ void GrabKey(KeyNode *np, Window win)
 /** Get the key action from an event. */
 ActionType GetKey(MouseContextType context, unsigned state, int code)
 {
-   KeyNode *np;
+   const KeyNode *np;
    ActionType result;
 
-   /* Remove modifiers we don't care about from the state. */
-   state &= ~lockMask;
-
-   /* Mask off flags. */
-   context &= MC_MASK;
-
-   /* Loop looking for a matching key binding. */
-   for(np = bindings[context]; np; np = np->next) {
-      if(np->state == state && np->code == code) {
-         return np->action;
-      }
+   np = FindBinding(context, state, code);
+   if(np) {
+      return np->action;
    }
 
    result.action = ACTION_NONE;
@@ -227,40 +470,20 @@ ActionType GetKey(MouseContextType context, unsigned state, int code)
 /** Run a command invoked from a key binding. */
 void RunKeyCommand(MouseContextType context, unsigned state, int code)
 {
-   KeyNode *np;
-
-   /* Remove the lock key modifiers. */
-   state &= ~lockMask;
-
-   /* Mask off flags. */
-   context &= MC_MASK;
-
-   for(np = bindings[context]; np; np = np->next) {
-      if(np->state == state && np->code == code) {
-         RunCommand(np->command);
-         return;
-      }
+   const KeyNode *np = FindBinding(context, state, code);
+   if(np) {
+      RunCommand(np->command);
    }
 }
 
 /** Show a root menu caused by a key binding. */
 void ShowKeyMenu(MouseContextType context, unsigned state, int code)
 {
-   KeyNode *np;
-
-   /* Remove the lock key modifiers. */
-   state &= ~lockMask;
-
-   /* Mask off flags. */
-   context &= MC_MASK;
-
-   for(np = bindings[context]; np; np = np->next) {
-      if(np->state == state && np->code == code) {
-         const int button = GetRootMenuIndexFromString(np->command);
-         if(JLIKELY(button >= 0)) {
-            ShowRootMenu(button, -1, -1, 1);
-         }
-         return;
+   const KeyNode *np = FindBinding(context, state, code);
+   if(np) {
+      const int button = GetRootMenuIndexFromString(np->command);
+      if(JLIKELY(button >= 0)) {
+         ShowRootMenu(button, -1, -1, 1);
       }
    }
 }
@@ -525,3 +748,18 @@ void ValidateKeys(void)
    }
 }
 
+
+/** Count the key grabs the bindings need on each window. */
+unsigned int CountKeyGrabs(unsigned int *keys)
+{
+   KeyNode *np;
+
+   /* Key codes are only looked up at startup, so check the symbol. */
+   *keys = 0;
+   for(np = bindings[MC_NONE]; np; np = np->next) {
+      if((np->code || np->symbol != NoSymbol) && ShouldGrab(np->action)) {
+         *keys += 1;
+      }
+   }
+   return *keys << ARRAY_LENGTH(lockMods);
+}
@@ -18,6 +18,11 @@ void StartupBindings(void);
 void ShutdownBindings(void);
 void DestroyBindings(void);
 
+/** Update key codes and grabs after the keyboard mapping changed.
+ * Only grabs that changed are sent to the server.
+ */
+void UpdateBindings(void);
+
 /** Mask of 'lock' keys. */
 extern unsigned int lockMask;
 
@@ -69,4 +74,12 @@ void ShowKeyMenu(MouseContextType context, unsigned state, int code);
  */
 void ValidateKeys(void);
 
+/** Count the key grabs the bindings need on each window.
+ * Each grabbed key is grabbed once for every combination of the lock
+ * modifiers on the root window and on each tray.
+ * @param keys Set to the number of keys grabbed.
+ * @return The number of grabs on each window.
+ */
+unsigned int CountKeyGrabs(unsigned int *keys);
+
 #endif /* KEY_H */
@@ -11,18 +11,67 @@
 #include "border.h"
 #include "client.h"
 #include "clientlist.h"
+#include "event.h"
 #include "color.h"
 #include "icon.h"
 #include "font.h"
 #include "misc.h"
 #include "settings.h"
 #include "grab.h"
+#include "render.h"
+#include "stats.h"
+#include "trace.h"
+#include "gcpool.h"
+
+/** Number of title bars to keep. */
+#define TITLE_CACHE_SIZE 16
+
+/** Bits of a title layer key. */
+#define TITLE_KEY_TITLE    (1 << 0)    /**< A title bar is shown. */
+#define TITLE_KEY_ACTIVE   (1 << 1)    /**< Active colors. */
+#define TITLE_KEY_MAX      (1 << 2)    /**< Maximized. */
+#define TITLE_KEY_CLOSE    (1 << 3)    /**< Close button. */
+#define TITLE_KEY_MAXIMIZE (1 << 4)    /**< Maximize button. */
+#define TITLE_KEY_MINIMIZE (1 << 5)    /**< Minimize button. */
+
+/** The top of a frame without the client icon and the title text.
+ * These only depend on the size, focus and buttons of a frame, so they
+ * are kept and shared by all clients that look the same.
+ */
+typedef struct TitleLayer {
+   Pixmap pixmap;                /**< The drawn title (None if unused). */
+   unsigned int width;           /**< Width of the frame. */
+   int north;                    /**< Height of the top of the frame. */
+   int south;                    /**< Bottom border size. */
+   int west;                     /**< Left border size. */
+   unsigned int key;             /**< TITLE_KEY_* bits. */
+   unsigned long stamp;          /**< Last use, for replacement. */
+   XPoint text;                  /**< Start and end of the title text. */
+   short icons[TBC_COUNT];       /**< Offsets of client icons. */
+   unsigned char iconCount;      /**< Number of client icons. */
+} TitleLayer;
 
 static char *buttonNames[BI_COUNT];
 static IconNode *buttonIcons[BI_COUNT];
+static TitleLayer titleLayers[TITLE_CACHE_SIZE];
+static unsigned long titleStamp;
+
+/** Status bits that change the size of a border. */
+#define BORDER_STATUS_MASK (STAT_FULLSCREEN | STAT_SHADED)
+
+/** Incremented when the settings used for border sizes may change. */
+static unsigned int borderGeneration = 1;
 
 static char IsContextEnabled(MouseContextType context, const ClientNode *np);
-static void DrawBorderHelper(const ClientNode *np);
+static const BorderLayout *GetBorderLayout(ClientNode *np, int west,
+                                           unsigned int titleHeight);
+static void DrawBorderHelper(const ClientNode *np, Region region);
+static void ClearBorderArea(const ClientNode *np, Region region,
+                            int x, int y, int width, int height);
+static const TitleLayer *GetTitleLayer(const ClientNode *np,
+                                       unsigned int width, char title);
+static void DrawTitleLayer(const ClientNode *np, TitleLayer *lp);
+static void ReleaseTitleLayer(TitleLayer *lp);
 static void DrawBorderHandles(const ClientNode *np,
                               Pixmap canvas, GC gc);
 static void DrawBorderButton(const ClientNode *np, MouseContextType context,
@@ -33,7 +82,8 @@ static void DrawLeftButton(const ClientNode *np, MouseContextType context,
                            int x, int y, Pixmap canvas, GC gc, long fg);
 static void DrawRightButton(const ClientNode *np, MouseContextType context,
                             int x, int y, Pixmap canvas, GC gc, long fg);
-static XPoint DrawBorderButtons(const ClientNode *np, Pixmap canvas, GC gc);
+static XPoint DrawBorderButtons(const ClientNode *np, Pixmap canvas, GC gc,
+                                TitleLayer *lp);
 static char DrawBorderIcon(BorderIconType t,
                            unsigned xoffset, unsigned yoffset,
                            Pixmap canvas, long fg);
@@ -49,6 +99,8 @@ static void DrawMinButton(unsigned xoffset, unsigned yoffset,
                           Pixmap canvas, GC gc, long fg);
 
 #ifdef USE_SHAPE
+static void UpdateBorderShape(ClientNode *np, int north, int west,
+                              int width, int height);
 static void FillRoundedRectangle(Drawable d, GC gc, int x, int y,
                                  int width, int height, int radius);
 #endif
@@ -78,6 +130,24 @@ void StartupBorders(void)
    if(buttonIcons[BI_MENU] == NULL) {
       buttonIcons[BI_MENU] = GetDefaultIcon();
    }
+
+   memset(titleLayers, 0, sizeof(titleLayers));
+   titleStamp = 0;
+
+   /* Zero is never a valid generation. */
+   borderGeneration += 1;
+   if(JUNLIKELY(borderGeneration == 0)) {
+      borderGeneration = 1;
+   }
+}
+
+/** Release server resources. */
+void ShutdownBorders(void)
+{
+   unsigned int i;
+   for(i = 0; i < TITLE_CACHE_SIZE; i++) {
+      ReleaseTitleLayer(&titleLayers[i]);
+   }
 }
 
 /** Destroy structures. */
@@ -119,85 +189,117 @@ char IsContextEnabled(MouseContextType context, const ClientNode *np)
    }
 }
 
+/** Lay out the title bar buttons of a client.
+ * The layout is kept until the width, border, or title height changes.
+ */
+const BorderLayout *GetBorderLayout(ClientNode *np, int west,
+                                    unsigned int titleHeight)
+{
+   BorderLayout *lp = &np->layout;
+   int rightOffset;
+   int leftOffset;
+   int index;
+   int titleIndex;
+
+   if(  lp->width == np->width && lp->west == west
+      && lp->height == titleHeight && lp->border == np->state.border) {
+      return lp;
+   }
+   lp->width = np->width;
+   lp->west = west;
+   lp->height = titleHeight;
+   lp->border = np->state.border;
+   lp->count = 0;
+
+   rightOffset = np->width + west;
+   leftOffset = west;
+
+   /* Buttons to the left of the title. */
+   index = 0;
+   while(settings.titleBarLayout[index]) {
+      const int nextOffset = leftOffset + titleHeight + 1;
+      const MouseContextType context = settings.titleBarLayout[index];
+      if(context == MC_MOVE) {
+         /* At the title. */
+         break;
+      }
+      if(nextOffset >= np->width - west) {
+         /* Past the end of the window. */
+         break;
+      }
+
+      if(IsContextEnabled(context, np)) {
+         lp->offsets[lp->count] = leftOffset;
+         lp->contexts[lp->count] = context;
+         lp->count += 1;
+         leftOffset = nextOffset;
+      }
+
+      index += 1;
+   }
+
+   /* Seek to the last title bar component. */
+   titleIndex = index;
+   while(settings.titleBarLayout[index]) index += 1;
+   index -= 1;
+
+   /* Buttons to the right of the title. */
+   while(index > titleIndex) {
+      const int nextOffset = rightOffset - titleHeight - 1;
+      const MouseContextType context = settings.titleBarLayout[index];
+      if(context == MC_MOVE) {
+         /* Hit the title bar from the right. */
+         break;
+      }
+      if(nextOffset < leftOffset) {
+         /* No more room. */
+         break;
+      }
+
+      if(IsContextEnabled(context, np)) {
+         lp->offsets[lp->count] = nextOffset;
+         lp->contexts[lp->count] = context;
+         lp->count += 1;
+         rightOffset = nextOffset;
+      }
+
+      index -= 1;
+   }
+
+   lp->left = leftOffset;
+   lp->right = rightOffset;
+   return lp;
+}
+
 /** Determine the border action to take given coordinates. */
-MouseContextType GetBorderContext(const ClientNode *np, int x, int y)
+MouseContextType GetBorderContext(ClientNode *np, int x, int y)
 {
    int north, south, east, west;
    unsigned resizeMask;
    const unsigned titleHeight = GetTitleHeight();
 
-   GetBorderSize(&np->state, &north, &south, &east, &west);
+   GetClientBorderSize(np, &north, &south, &east, &west);
 
    /* Check title bar actions. */
    if((np->state.border & BORDER_TITLE) &&
-      titleHeight > settings.borderWidth) {
-      int rightOffset = np->width + west;
-      int leftOffset = west;
-
-      if(y >= south && y <= titleHeight + south) {
-         int index = 0;
-         int titleIndex;
-
-         /* Check button(s) to the left of the title. */
-         while(settings.titleBarLayout[index]) {
-            const int nextOffset = leftOffset + titleHeight + 1;
-            const MouseContextType context = settings.titleBarLayout[index];
-            if(context == MC_MOVE) {
-               /* At the title. */
-               break;
-            }
-            if(nextOffset >= np->width - west) {
-               /* Past the end of the window. */
-               break;
-            }
-
-            if(IsContextEnabled(context, np)) {
-               if(x >= leftOffset && x < nextOffset) {
-                  return context;
-               }
-               leftOffset = nextOffset;
-            }
-
-            index += 1;
-         }
-
-         /* Seek to the last title bar component. */
-         titleIndex = index;
-         while(settings.titleBarLayout[index]) index += 1;
-         index -= 1;
-
-         /* Check button(s) on to right of the title. */
-         while(index > titleIndex) {
-            const int nextOffset = rightOffset - titleHeight - 1;
-            const MouseContextType context = settings.titleBarLayout[index];
-            if(context == MC_MOVE) {
-               /* Hit the title bar from the right. */
-               break;
-            }
-            if(nextOffset < leftOffset) {
-               /* No more room. */
-               break;
-            }
-
-            if(IsContextEnabled(context, np)) {
-               if(x >= nextOffset && x < rightOffset) {
-                  return context;
-               }
-               rightOffset = nextOffset;
-            }
-
-            index -= 1;
+      titleHeight > settings.borderWidth &&
+      y >= south && y <= titleHeight + south) {
+      const BorderLayout *lp = GetBorderLayout(np, west, titleHeight);
+      unsigned int i;
+
+      for(i = 0; i < lp->count; i++) {
+         const int offset = lp->offsets[i];
+         if(x >= offset && x < offset + (int)titleHeight + 1) {
+            return lp->contexts[i];
          }
       }
 
       /* Check for move. */
-      if(y >= south && y <= titleHeight + south) {
-         if(x >= leftOffset && x < rightOffset) {
-            if(np->state.border & BORDER_MOVE) {
-               return MC_MOVE;
-            } else {
-               return MC_NONE;
-            }
+      if(x >= lp->left && x < lp->right) {
+         if(np->state.border & BORDER_MOVE) {
+            return MC_MOVE;
+         } else {
+            return MC_NONE;
          }
       }
 
@@ -247,12 +349,8 @@ MouseContextType GetBorderContext(const ClientNode *np, int x, int y)
 }
 
 /** Reset the shape of a window border. */
-void ResetBorder(const ClientNode *np)
+void ResetBorder(ClientNode *np)
 {
-#ifdef USE_SHAPE
-   Pixmap shapePixmap;
-   GC shapeGC;
-#endif
 
    int north, south, east, west;
    int width, height;
@@ -266,7 +364,7 @@ void ResetBorder(const ClientNode *np)
    GrabServer();
 
    /* Determine the size of the window. */
-   GetBorderSize(&np->state, &north, &south, &east, &west);
+   GetClientBorderSize(np, &north, &south, &east, &west);
    width = np->width + east + west;
    if(np->state.status & STAT_SHADED) {
       height = north + south;
@@ -283,75 +381,169 @@ void ResetBorder(const ClientNode *np)
                       width, height);
 
 #ifdef USE_SHAPE
-   if(settings.cornerRadius > 0 || (np->state.status & STAT_SHAPED)) {
+   UpdateBorderShape(np, north, west, width, height);
+#endif
 
-      /* First set the shape to the window border. */
-      shapePixmap = JXCreatePixmap(display, np->parent, width, height, 1);
-      shapeGC = JXCreateGC(display, shapePixmap, 0, NULL);
+   UngrabServer();
 
-      /* Make the whole area transparent. */
-      JXSetForeground(display, shapeGC, 0);
-      JXFillRectangle(display, shapePixmap, shapeGC, 0, 0, width, height);
+}
 
-      /* Draw the window area without the corners. */
-      /* Corner bound radius -1 to allow slightly better outline drawing */
-      JXSetForeground(display, shapeGC, 1);
-      if((np->state.status & STAT_FULLSCREEN) &&
-         !(np->state.status & STAT_SHADED)) {
-         JXFillRectangle(display, shapePixmap, shapeGC, 0, 0, width, height);
-      } else {
-         const int radius
-            = (np->state.maxFlags && (np->state.border & BORDER_NOMAX))
-            ? 0 : (settings.cornerRadius - 1);
-         FillRoundedRectangle(shapePixmap, shapeGC, 0, 0, width, height,
-                              radius);
+#ifdef USE_SHAPE
+/** Set the shape of a frame if anything it depends on changed. */
+void UpdateBorderShape(ClientNode *np, int north, int west,
+                       int width, int height)
+{
+   const unsigned int status = np->state.status
+                             & (STAT_SHADED | STAT_FULLSCREEN | STAT_SHAPED);
+   BorderShape *sp = &np->shape;
+   Pixmap shapePixmap;
+   GC shapeGC;
+   int radius;
+
+   if(settings.cornerRadius == 0 && !(status & STAT_SHAPED)) {
+      /* No shape needed; remove the one we set. */
+      if(sp->valid) {
+         JXShapeCombineMask(display, np->parent, ShapeBounding, 0, 0,
+                            None, ShapeSet);
+         sp->valid = 0;
       }
+      sp->pending = 0;
+      return;
+   }
 
-      /* Apply the client window. */
-      if(!(np->state.status & STAT_SHADED) &&
-          (np->state.status & STAT_SHAPED)) {
+   radius = (np->state.maxFlags && (np->state.border & BORDER_NOMAX))
+          ? 0 : (settings.cornerRadius - 1);
+   if(  sp->valid && !sp->pending
+      && sp->width == width && sp->height == height
+      && sp->north == north && sp->west == west
+      && sp->radius == radius && sp->status == status) {
+      return;
+   }
 
-         XRectangle *rects;
-         int count;
-         int ordering;
+   /* First set the shape to the window border. */
+   shapePixmap = JXCreatePixmap(display, np->parent, width, height, 1);
+   shapeGC = AcquireGC(1, 0, NULL);
 
-         /* Cut out an area for the client window. */
-         JXSetForeground(display, shapeGC, 0);
-         JXFillRectangle(display, shapePixmap, shapeGC, west, north,
-                         np->width, np->height);
+   /* Make the whole area transparent. */
+   JXSetForeground(display, shapeGC, 0);
+   JXFillRectangle(display, shapePixmap, shapeGC, 0, 0, width, height);
 
-         /* Fill in the visible area. */
-         rects = JXShapeGetRectangles(display, np->window, ShapeBounding,
-                                      &count, &ordering);
-         if(JLIKELY(rects)) {
-            int i;
-            for(i = 0; i < count; i++) {
-               rects[i].x += east;
-               rects[i].y += north;
-            }
-            JXSetForeground(display, shapeGC, 1);
-            JXFillRectangles(display, shapePixmap, shapeGC, rects, count);
-            JXFree(rects);
-         }
+   /* Draw the window area without the corners. */
+   /* Corner bound radius -1 to allow slightly better outline drawing */
+   JXSetForeground(display, shapeGC, 1);
+   if((status & STAT_FULLSCREEN) && !(status & STAT_SHADED)) {
+      JXFillRectangle(display, shapePixmap, shapeGC, 0, 0, width, height);
+   } else {
+      FillRoundedRectangle(shapePixmap, shapeGC, 0, 0, width, height,
+                           radius);
+   }
 
-      }
+   /* Apply the client window. */
+   if(!(status & STAT_SHADED) && (status & STAT_SHAPED)) {
 
-      /* Set the shape. */
-      JXShapeCombineMask(display, np->parent, ShapeBounding, 0, 0,
-                         shapePixmap, ShapeSet);
+      XRectangle *rects;
+      int count;
+      int ordering;
+
+      /* Cut out an area for the client window. */
+      JXSetForeground(display, shapeGC, 0);
+      JXFillRectangle(display, shapePixmap, shapeGC, west, north,
+                      np->width, np->height);
+
+      /* Fill in the visible area. */
+      rects = JXShapeGetRectangles(display, np->window, ShapeBounding,
+                                   &count, &ordering);
+      if(JLIKELY(rects)) {
+         int i;
+         for(i = 0; i < count; i++) {
+            rects[i].x += west;
+            rects[i].y += north;
+         }
+         JXSetForeground(display, shapeGC, 1);
+         JXFillRectangles(display, shapePixmap, shapeGC, rects, count);
+         JXFree(rects);
+      }
 
-      JXFreeGC(display, shapeGC);
-      JXFreePixmap(display, shapePixmap);
    }
-#endif
 
-   UngrabServer();
+   /* Set the shape. */
+   JXShapeCombineMask(display, np->parent, ShapeBounding, 0, 0,
+                      shapePixmap, ShapeSet);
+
+   ReleaseGC(shapeGC);
+   JXFreePixmap(display, shapePixmap);
+
+   sp->width = width;
+   sp->height = height;
+   sp->north = north;
+   sp->west = west;
+   sp->radius = radius;
+   sp->status = status;
+   sp->valid = 1;
+   sp->pending = 0;
+}
 
+/** Apply the shape changes of clients since the last event. */
+void FlushBorderShapes(void)
+{
+   ClientNode *np;
+   unsigned int x;
+   for(x = 0; x < LAYER_COUNT; x++) {
+      for(np = nodes[x]; np; np = np->next) {
+         if(np->shape.pending) {
+            int north, south, east, west;
+            int height;
+            if(np->parent == None) {
+               np->shape.pending = 0;
+               continue;
+            }
+            GetClientBorderSize(np, &north, &south, &east, &west);
+            if(np->state.status & STAT_SHADED) {
+               height = north + south;
+            } else {
+               height = np->height + north + south;
+            }
+            UpdateBorderShape(np, north, west, np->width + east + west,
+                              height);
+         }
+      }
+   }
 }
+#endif /* USE_SHAPE */
 
 /** Draw a client border. */
 void DrawBorder(ClientNode *np)
 {
+   np->drawPending = 0;
+   ExposeBorder(np, NULL);
+}
+
+/** Draw a window border once the event queue is drained. */
+void RequireBorderDraw(ClientNode *np)
+{
+   np->drawPending = 1;
+   RequireWork(WORK_BORDERS);
+}
+
+/** Draw the borders requested with RequireBorderDraw. */
+void FlushBorders(void)
+{
+   ClientNode *np;
+   unsigned int x;
+   for(x = 0; x < LAYER_COUNT; x++) {
+      for(np = nodes[x]; np; np = np->next) {
+         if(np->drawPending) {
+            DrawBorder(np);
+         }
+      }
+   }
+}
+
+/** Redraw the exposed part of a window border. */
+void ExposeBorder(ClientNode *np, Region region)
+{
+
+   TraceTime traceStart;
 
    Assert(np);
 
@@ -379,28 +571,35 @@ void DrawBorder(ClientNode *np)
    }
 
    /* Do the actual drawing. */
-   DrawBorderHelper(np);
+   traceStart = StartTrace();
+   DrawBorderHelper(np, region);
+   RecordTrace("DrawBorder", -1, traceStart);
 
 }
 
-/** Helper method for drawing borders. */
-void DrawBorderHelper(const ClientNode *np)
+/** Helper method for drawing borders.
+ * With a region, drawing is clipped to it. The title bar is redrawn as a
+ * whole when any of it is exposed since the title and icons are blended
+ * over it.
+ */
+void DrawBorderHelper(const ClientNode *np, Region region)
 {
    ColorType borderTextColor;
 
-   long titleColor1, titleColor2;
+   long titleColor2;
    long outlineColor;
 
    int north, south, east, west;
    unsigned int width, height;
    const int titleHeight = GetTitleHeight();
+   const TitleLayer *lp;
+   char title;
 
-   Pixmap canvas;
    GC gc;
 
    Assert(np);
 
-   GetBorderSize(&np->state, &north, &south, &east, &west);
+   GetClientBorderSize(np, &north, &south, &east, &west);
    width = np->width + east + west;
    height = np->height + north + south;
 
@@ -408,14 +607,12 @@ void DrawBorderHelper(const ClientNode *np)
    if(np->state.status & (STAT_ACTIVE | STAT_FLASH)) {
 
       borderTextColor = COLOR_TITLE_ACTIVE_FG;
-      titleColor1 = colors[COLOR_TITLE_ACTIVE_BG1];
       titleColor2 = colors[COLOR_TITLE_ACTIVE_BG2];
       outlineColor = colors[COLOR_TITLE_ACTIVE_DOWN];
 
    } else {
 
       borderTextColor = COLOR_TITLE_FG;
-      titleColor1 = colors[COLOR_TITLE_BG1];
       titleColor2 = colors[COLOR_TITLE_BG2];
       outlineColor = colors[COLOR_TITLE_DOWN];
 
@@ -424,30 +621,52 @@ void DrawBorderHelper(const ClientNode *np)
    /* Set parent background to reduce flicker. */
    JXSetWindowBackground(display, np->parent, titleColor2);
 
-   canvas = JXCreatePixmap(display, np->parent, width, north, rootDepth);
-   gc = JXCreateGC(display, canvas, 0, NULL);
-
-   /* Clear the window with the right color. */
-   JXSetForeground(display, gc, titleColor2);
-   JXFillRectangle(display, canvas, gc, 0, 0, width, north);
-
-   /* Draw the top part (either a title or north border). */
-   if((np->state.border & BORDER_TITLE) &&
+   /* Get the top part (either a title or north border). */
+   title = (np->state.border & BORDER_TITLE) &&
       !(np->state.maxFlags && (np->state.border & TITLE_NOMAX)) &&
-      titleHeight > settings.borderWidth) {
+      titleHeight > settings.borderWidth;
+   lp = GetTitleLayer(np, width, title);
+
+   /* Copy the pixmap for the title bar and clear the part of
+    * the window to be drawn directly. */
+   gc = AcquireGC(rootDepth, 0, NULL);
+   if(region) {
+      XRectangle area;
+      area.x = 0;
+      area.y = 0;
+      area.width = width;
+      area.height = north;
+      if(JXRectInRegion(region, 0, 0, width, north) != RectangleOut) {
+         JXUnionRectWithRegion(&area, region, region);
+      }
+      JXSetRegion(display, gc, region);
+   }
+   if(settings.windowDecorations == DECO_MOTIF) {
+      const int off = 2;
+      JXCopyArea(display, lp->pixmap, np->parent, gc, off, off,
+         width - 2 * off, north - off, off, off);
+      ClearBorderArea(np, region,
+         off, north, width - 2 * off, height - north - off);
+   } else {
+      JXCopyArea(display, lp->pixmap, np->parent, gc, 1, 1,
+         width - 2, north - 1, 1, 1);
+      ClearBorderArea(np, region,
+         1, north, width - 2, height - north - 1);
+   }
 
-      XPoint point;
+   /* Draw the icons and the title over the cached title bar. */
+   if(title) {
 
-      /* Draw a title bar. */
-      DrawHorizontalGradient(canvas, gc, titleColor1, titleColor2,
-                             0, 1, width, titleHeight - 2);
+      const XPoint point = lp->text;
+      const int yoffset = settings.windowDecorations == DECO_MOTIF
+                        ? south - 1 : 0;
+      unsigned int i;
 
-      /* Draw the buttons.
-       * This returns the start and end positions of the title as `x` and `y`.
-       */
-      point = DrawBorderButtons(np, canvas, gc);
+      for(i = 0; i < lp->iconCount; i++) {
+         DrawIconButton(np, lp->icons[i], yoffset, np->parent, gc,
+                        colors[borderTextColor]);
+      }
 
-      /* Draw the title. */
       if(np->name && np->name[0] && point.x < point.y) {
          unsigned titleWidth = point.y - point.x;
          const int sheight = GetStringHeight(FONT_BORDER);
@@ -473,27 +692,12 @@ void DrawBorderHelper(const ClientNode *np)
          if(settings.windowDecorations == DECO_MOTIF) {
             titley += south - 1;
          }
-         RenderString(canvas, FONT_BORDER, borderTextColor,
+         RenderString(np->parent, FONT_BORDER, borderTextColor,
                       titlex, titley, titleWidth, np->name);
       }
 
    }
 
-   /* Copy the pixmap for the title bar and clear the part of
-    * the window to be drawn directly. */
-   if(settings.windowDecorations == DECO_MOTIF) {
-      const int off = 2;
-      JXCopyArea(display, canvas, np->parent, gc, off, off,
-         width - 2 * off, north - off, off, off);
-      JXClearArea(display, np->parent,
-         off, north, width - 2 * off, height - north - off, False);
-   } else {
-      JXCopyArea(display, canvas, np->parent, gc, 1, 1,
-         width - 2, north - 1, 1, 1);
-      JXClearArea(display, np->parent,
-         1, north, width - 2, height - north - 1, False);
-   }
-
    /* Window outline. */
    if(settings.windowDecorations == DECO_MOTIF) {
       DrawBorderHandles(np, np->parent, gc);
@@ -511,9 +715,154 @@ void DrawBorderHelper(const ClientNode *np)
       }
    }
 
-   JXFreePixmap(display, canvas);
-   JXFreeGC(display, gc);
+   if(region) {
+      JXSetClipMask(display, gc, None);
+   }
+   ReleaseGC(gc);
+
+}
+
+/** Clear part of a frame below the title bar.
+ * Only the area that is also in the region (if any) is cleared.
+ */
+void ClearBorderArea(const ClientNode *np, Region region,
+                     int x, int y, int width, int height)
+{
+   if(width <= 0 || height <= 0) {
+      return;
+   }
+   if(region) {
+      XRectangle box;
+      int x2, y2;
+      JXClipBox(region, &box);
+      x2 = Min(x + width, box.x + box.width);
+      y2 = Min(y + height, box.y + box.height);
+      x = Max(x, box.x);
+      y = Max(y, box.y);
+      width = x2 - x;
+      height = y2 - y;
+      if(width <= 0 || height <= 0) {
+         return;
+      }
+   }
+   JXClearArea(display, np->parent, x, y, width, height, False);
+}
+
+/** Get the title layer for a client, drawing it if needed. */
+const TitleLayer *GetTitleLayer(const ClientNode *np, unsigned int width,
+                                char title)
+{
+   TitleLayer *lp;
+   TitleLayer *best;
+   int north, south, east, west;
+   unsigned int key;
+   unsigned int i;
+
+   GetClientBorderSize(np, &north, &south, &east, &west);
+   key = 0;
+   if(title) {
+      key |= TITLE_KEY_TITLE;
+      if(np->state.status & (STAT_ACTIVE | STAT_FLASH)) {
+         key |= TITLE_KEY_ACTIVE;
+      }
+      if(np->state.maxFlags) {
+         key |= TITLE_KEY_MAX;
+      }
+      if(IsContextEnabled(MC_CLOSE, np)) {
+         key |= TITLE_KEY_CLOSE;
+      }
+      if(IsContextEnabled(MC_MAXIMIZE, np)) {
+         key |= TITLE_KEY_MAXIMIZE;
+      }
+      if(IsContextEnabled(MC_MINIMIZE, np)) {
+         key |= TITLE_KEY_MINIMIZE;
+      }
+   } else if(np->state.status & (STAT_ACTIVE | STAT_FLASH)) {
+      key |= TITLE_KEY_ACTIVE;
+   }
+
+   /* Look for a match, otherwise replace the least recently used. */
+   titleStamp += 1;
+   best = &titleLayers[0];
+   for(i = 0; i < TITLE_CACHE_SIZE; i++) {
+      lp = &titleLayers[i];
+      if(  lp->pixmap != None && lp->key == key && lp->width == width
+         && lp->north == north && lp->south == south && lp->west == west) {
+         lp->stamp = titleStamp;
+         return lp;
+      }
+      if(lp->stamp < best->stamp) {
+         best = lp;
+      }
+   }
+
+   lp = best;
+   ReleaseTitleLayer(lp);
+   lp->width = width;
+   lp->north = north;
+   lp->south = south;
+   lp->west = west;
+   lp->key = key;
+   lp->stamp = titleStamp;
+   DrawTitleLayer(np, lp);
+   return lp;
+}
+
+/** Draw a title layer. */
+void DrawTitleLayer(const ClientNode *np, TitleLayer *lp)
+{
+   const int titleHeight = GetTitleHeight();
+   long titleColor1, titleColor2;
+   GC gc;
+
+   if(lp->key & TITLE_KEY_ACTIVE) {
+      titleColor1 = colors[COLOR_TITLE_ACTIVE_BG1];
+      titleColor2 = colors[COLOR_TITLE_ACTIVE_BG2];
+   } else {
+      titleColor1 = colors[COLOR_TITLE_BG1];
+      titleColor2 = colors[COLOR_TITLE_BG2];
+   }
+
+   lp->pixmap = JXCreatePixmap(display, rootWindow, lp->width, lp->north,
+                               rootDepth);
+   RecordPixmapStats(PIXMAP_BORDER,
+                     (long)GetPixmapSize(lp->width, lp->north, rootDepth));
+   gc = AcquireGC(rootDepth, 0, NULL);
 
+   /* Clear the window with the right color. */
+   JXSetForeground(display, gc, titleColor2);
+   JXFillRectangle(display, lp->pixmap, gc, 0, 0, lp->width, lp->north);
+
+   lp->iconCount = 0;
+   lp->text.x = 0;
+   lp->text.y = 0;
+   if(lp->key & TITLE_KEY_TITLE) {
+
+      /* Draw a title bar. */
+      DrawHorizontalGradient(lp->pixmap, gc, titleColor1, titleColor2,
+                             0, 1, lp->width, titleHeight - 2);
+
+      /* Draw the buttons.
+       * This returns the start and end positions of the title as `x` and `y`.
+       */
+      lp->text = DrawBorderButtons(np, lp->pixmap, gc, lp);
+
+   }
+
+   ReleaseGC(gc);
+}
+
+/** Release the pixmap of a title layer. */
+void ReleaseTitleLayer(TitleLayer *lp)
+{
+   if(lp->pixmap != None) {
+      ReleaseRenderTarget(lp->pixmap);
+      JXFreePixmap(display, lp->pixmap);
+      RecordPixmapStats(PIXMAP_BORDER,
+                        -(long)GetPixmapSize(lp->width, lp->north,
+                                             rootDepth));
+      lp->pixmap = None;
+   }
 }
 
 /** Draw window handles. */
@@ -532,7 +881,7 @@ void DrawBorderHandles(const ClientNode *np, Pixmap canvas, GC gc)
    }
 
    /* Determine the window size. */
-   GetBorderSize(&np->state, &north, &south, &east, &west);
+   GetClientBorderSize(np, &north, &south, &east, &west);
    titleHeight = GetTitleHeight();
    width = np->width + east + west;
    if(np->state.status & STAT_SHADED) {
@@ -788,7 +1137,7 @@ void DrawBorderButton(const ClientNode *np, MouseContextType context,
       }
       break;
    case MC_ICON:
-      DrawIconButton(np, x, y, canvas, gc, fg);
+      /* Client icons are drawn over the title layer. */
       break;
    default:
       Assert(0);
@@ -818,7 +1167,7 @@ void DrawButtonBorder(const ClientNode *np, int x, Pixmap canvas, GC gc)
       pixelDown = colors[COLOR_TITLE_DOWN];
    }
 
-   GetBorderSize(&np->state, &north, &south, &east, &west);
+   GetClientBorderSize(np, &north, &south, &east, &west);
 
    JXSetForeground(display, gc, pixelDown);
    JXDrawLine(display, canvas, gc, x, y1, x, y2);
@@ -842,8 +1191,11 @@ void DrawRightButton(const ClientNode *np, MouseContextType context,
    DrawBorderButton(np, context, x, y, canvas, gc, fg);
 }
 
-/** Draw the buttons on a client frame. */
-XPoint DrawBorderButtons(const ClientNode *np, Pixmap canvas, GC gc)
+/** Draw the buttons on a client frame.
+ * The offsets of client icons are saved in the title layer.
+ */
+XPoint DrawBorderButtons(const ClientNode *np, Pixmap canvas, GC gc,
+                         TitleLayer *lp)
 {
    long fg;
    XPoint point;
@@ -860,7 +1212,7 @@ XPoint DrawBorderButtons(const ClientNode *np, Pixmap canvas, GC gc)
       fg = colors[COLOR_TITLE_FG];
    }
 
-   GetBorderSize(&np->state, &north, &south, &east, &west);
+   GetClientBorderSize(np, &north, &south, &east, &west);
    if(settings.windowDecorations == DECO_MOTIF) {
       yoffset = south - 1;
    } else {
@@ -884,6 +1236,9 @@ XPoint DrawBorderButtons(const ClientNode *np, Pixmap canvas, GC gc)
 
       /* Draw the button only if it's enabled. */
       if(IsContextEnabled(context, np)) {
+         if(context == MC_ICON) {
+            lp->icons[lp->iconCount++] = leftOffset;
+         }
          DrawRightButton(np, context, leftOffset, yoffset, canvas, gc, fg);
          leftOffset = nextOffset;
       }
@@ -912,6 +1267,9 @@ XPoint DrawBorderButtons(const ClientNode *np, Pixmap canvas, GC gc)
 
       if(IsContextEnabled(context, np)) {
          rightOffset = nextOffset;
+         if(context == MC_ICON) {
+            lp->icons[lp->iconCount++] = rightOffset;
+         }
          DrawLeftButton(np, context, rightOffset, yoffset, canvas, gc, fg);
       }
 
@@ -1237,6 +1595,30 @@ void GetBorderSize(const ClientState *state,
    }
 }
 
+/** Get the size of the border of a client. */
+void GetClientBorderSize(const ClientNode *np,
+                         int *north, int *south, int *east, int *west)
+{
+   /* The cache does not change what the client looks like. */
+   BorderExtents *ep = (BorderExtents*)&np->extents;
+   const unsigned int status = np->state.status & BORDER_STATUS_MASK;
+
+   if(  ep->generation != borderGeneration || ep->status != status
+      || ep->border != np->state.border
+      || ep->maxFlags != np->state.maxFlags) {
+      GetBorderSize(&np->state, &ep->north, &ep->south,
+                    &ep->east, &ep->west);
+      ep->generation = borderGeneration;
+      ep->status = status;
+      ep->border = np->state.border;
+      ep->maxFlags = np->state.maxFlags;
+   }
+   *north = ep->north;
+   *south = ep->south;
+   *east = ep->east;
+   *west = ep->west;
+}
+
 /** Draw a rounded rectangle. */
 void DrawRoundedRectangle(Drawable d, GC gc, int x, int y,
                           int width, int height, int radius)
@@ -12,6 +12,7 @@
 
 #include "gradient.h"
 #include "binding.h"
+#include "settings.h"
 
 struct ClientNode;
 struct ClientState;
@@ -28,29 +29,81 @@ typedef unsigned char BorderIconType;
 /*@{*/
 void InitializeBorders(void);
 void StartupBorders(void);
-#define ShutdownBorders()      (void)(0)
+void ShutdownBorders(void);
 void DestroyBorders(void);
 /*@}*/
 
+/** The frame shape last applied to a client. */
+typedef struct BorderShape {
+   int width, height;   /**< Size of the frame. */
+   int north, west;     /**< Position of the client in the frame. */
+   int radius;          /**< Corner radius used. */
+   unsigned int status; /**< Client status bits that affect the shape. */
+   char valid;          /**< Set if a shape has been applied. */
+   char pending;        /**< Set if the client window shape changed. */
+} BorderShape;
+
+/** Title bar buttons laid out for finding the mouse context. */
+typedef struct BorderLayout {
+   int width;              /**< Width of the client (-1 if not laid out). */
+   int west;               /**< Offset of the client in the frame. */
+   unsigned int height;    /**< Title bar height. */
+   unsigned int border;    /**< Border flags the layout is for. */
+   int left, right;        /**< Extent of the title between buttons. */
+   unsigned int count;     /**< Number of buttons. */
+   int offsets[TBC_COUNT]; /**< Left edge of each button. */
+   MouseContextType contexts[TBC_COUNT];  /**< Context of each button. */
+} BorderLayout;
+
+/** Border sizes of a client, kept until what they depend on changes. */
+typedef struct BorderExtents {
+   int north, south, east, west;
+   unsigned int status;       /**< Status bits the sizes are for. */
+   unsigned short border;     /**< Border flags the sizes are for. */
+   unsigned char maxFlags;    /**< Maximization the sizes are for. */
+   unsigned int generation;   /**< Settings generation (0 if unset). */
+} BorderExtents;
+
 /** Determine the mouse context for a location.
  * @param np The client.
  * @param x The x-coordinate of the mouse (frame relative).
  * @param y The y-coordinate of the mouse (frame relative).
  * @return The context.
  */
-MouseContextType GetBorderContext(const struct ClientNode *np,
-                                  int x, int y);
+MouseContextType GetBorderContext(struct ClientNode *np, int x, int y);
 
 /** Reset the shape of a window border.
  * @param np The client.
  */
-void ResetBorder(const struct ClientNode *np);
+void ResetBorder(struct ClientNode *np);
+
+#ifdef USE_SHAPE
+/** Apply the shape changes of clients since the last event.
+ * The frame shape is only rebuilt for clients whose shape changed.
+ */
+void FlushBorderShapes(void);
+#endif
 
 /** Draw a window border.
  * @param np The client whose frame to draw.
  */
 void DrawBorder(struct ClientNode *np);
 
+/** Draw a window border once the event queue is drained.
+ * Several requests for the same client are drawn once.
+ * @param np The client whose frame to draw.
+ */
+void RequireBorderDraw(struct ClientNode *np);
+
+/** Draw the borders requested with RequireBorderDraw. */
+void FlushBorders(void);
+
+/** Redraw the exposed part of a window border.
+ * @param np The client whose frame was exposed.
+ * @param region The exposed region (NULL to draw everything).
+ */
+void ExposeBorder(struct ClientNode *np, Region region);
+
 /** Get the size of a border icon.
  * @return The size in pixels (note that icons are square).
  */
@@ -69,6 +122,18 @@ unsigned GetTitleHeight(void);
 void GetBorderSize(const struct ClientState *state,
                    int *north, int *south, int *east, int *west);
 
+/** Get the size of the border of a client.
+ * This is the same as GetBorderSize for the client state, but the sizes
+ * are cached in the client until its state or the settings change.
+ * @param np The client.
+ * @param north Pointer to the value to contain the north border size.
+ * @param south Pointer to the value to contain the south border size.
+ * @param east Pointer to the value to contain the east border size.
+ * @param west Pointer to the value to contain the west border size.
+ */
+void GetClientBorderSize(const struct ClientNode *np,
+                         int *north, int *south, int *east, int *west);
+
 /** Redraw all borders on the current desktop. */
 void ExposeCurrentDesktop(void);
 
@@ -0,0 +1,370 @@
+/**
+ * @file bulk.c
+ * @author Joe Wingbermuehle
+ * @date 2026
+ *
+ * @brief Bulk transfers on a second X connection.
+ *
+ * Large property reads and image uploads are done by a worker thread on
+ * its own connection so that they do not hold up events on the main
+ * connection. Finished transfers are handed back through a pipe and
+ * their callbacks run from the event loop.
+ *
+ * The worker only makes X calls on its own connection. Jobs are
+ * allocated and released on the main thread, and the worker does not
+ * use the JX wrappers since they touch debug state.
+ *
+ */
+
+#include "jwm.h"
+
+#ifdef USE_BULK
+
+#include "bulk.h"
+#include "main.h"
+#include "event.h"
+#include "error.h"
+#include "shm.h"
+#include "misc.h"
+
+#include <fcntl.h>
+#include <pthread.h>
+
+/** Kinds of bulk transfer. */
+typedef unsigned char BulkJobType;
+#define BULK_PROPERTY   0  /**< Read a window property. */
+#define BULK_IMAGE      1  /**< Upload an image. */
+
+/** A queued transfer. */
+typedef struct BulkJob {
+   BulkJobType type;
+   char cancelled;            /**< Set to skip the callback. */
+
+   BulkProperty property;     /**< The property read. */
+   Atom reqType;              /**< Type requested for the property. */
+   long length;               /**< 32-bit units to read. */
+   BulkPropertyCallback propertyCallback;
+
+   Drawable drawable;         /**< Drawable for an upload. */
+   XImage *image;             /**< Image to upload. */
+   int x, y;                  /**< Location of the upload. */
+   BulkImageCallback imageCallback;
+
+   void *data;                /**< Data to pass to the callback. */
+   struct BulkJob *next;
+} BulkJob;
+
+char haveBulk = 0;
+
+static Display *bulkDisplay;
+static GC bulkGC;
+static pthread_t bulkThread;
+static int bulkWakeFds[2];
+
+/* The lock protects the queues and bulkStop. */
+static pthread_mutex_t bulkLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t bulkCond = PTHREAD_COND_INITIALIZER;
+static BulkJob *pendingHead;
+static BulkJob *pendingTail;
+static BulkJob *runningJob;
+static BulkJob *doneHead;
+static BulkJob *doneTail;
+static char bulkStop;
+
+static void QueueBulkJob(BulkJob *jp);
+static void FinishBulkJob(BulkJob *jp, char report);
+static void HandleBulkWake(int fd, void *data);
+static void *RunBulkWorker(void *arg);
+static void RunBulkJob(BulkJob *jp);
+
+/** Open the bulk connection and start the worker. */
+void StartupBulk(void)
+{
+   sigset_t all, saved;
+   int rc;
+
+   haveBulk = 0;
+   pendingHead = NULL;
+   pendingTail = NULL;
+   runningJob = NULL;
+   doneHead = NULL;
+   doneTail = NULL;
+   bulkStop = 0;
+
+   bulkDisplay = JXOpenDisplay(DisplayString(display));
+   if(JUNLIKELY(!bulkDisplay)) {
+      Warning(_("could not open a second connection for bulk transfers"));
+      return;
+   }
+   fcntl(ConnectionNumber(bulkDisplay), F_SETFD, FD_CLOEXEC);
+   bulkGC = JXCreateGC(bulkDisplay, RootWindow(bulkDisplay, rootScreen),
+                       0, NULL);
+   XSetGraphicsExposures(bulkDisplay, bulkGC, False);
+
+   if(pipe(bulkWakeFds)) {
+      Warning(_("could not create pipe"));
+      JXFreeGC(bulkDisplay, bulkGC);
+      JXCloseDisplay(bulkDisplay);
+      return;
+   }
+   fcntl(bulkWakeFds[0], F_SETFL, O_NONBLOCK);
+   fcntl(bulkWakeFds[1], F_SETFL, O_NONBLOCK);
+   fcntl(bulkWakeFds[0], F_SETFD, FD_CLOEXEC);
+   fcntl(bulkWakeFds[1], F_SETFD, FD_CLOEXEC);
+
+   /* Signals are handled on the main thread. */
+   sigfillset(&all);
+   pthread_sigmask(SIG_SETMASK, &all, &saved);
+   rc = pthread_create(&bulkThread, NULL, RunBulkWorker, NULL);
+   pthread_sigmask(SIG_SETMASK, &saved, NULL);
+   if(JUNLIKELY(rc != 0)) {
+      Warning(_("could not start the bulk transfer thread"));
+      close(bulkWakeFds[0]);
+      close(bulkWakeFds[1]);
+      JXFreeGC(bulkDisplay, bulkGC);
+      JXCloseDisplay(bulkDisplay);
+      return;
+   }
+
+   RegisterFileWatch(bulkWakeFds[0], HandleBulkWake, NULL);
+   haveBulk = 1;
+}
+
+/** Stop the worker and close the bulk connection.
+ * Transfers that have not finished are dropped without their callbacks.
+ */
+void ShutdownBulk(void)
+{
+   BulkJob *jp;
+
+   if(!haveBulk) {
+      return;
+   }
+   haveBulk = 0;
+
+   pthread_mutex_lock(&bulkLock);
+   bulkStop = 1;
+   pthread_cond_signal(&bulkCond);
+   pthread_mutex_unlock(&bulkLock);
+   pthread_join(bulkThread, NULL);
+
+   UnregisterFileWatch(bulkWakeFds[0]);
+   close(bulkWakeFds[0]);
+   close(bulkWakeFds[1]);
+
+   while(doneHead) {
+      jp = doneHead;
+      doneHead = jp->next;
+      FinishBulkJob(jp, 0);
+   }
+   while(pendingHead) {
+      jp = pendingHead;
+      pendingHead = jp->next;
+      FinishBulkJob(jp, 0);
+   }
+   doneTail = NULL;
+   pendingTail = NULL;
+
+   JXFreeGC(bulkDisplay, bulkGC);
+   JXCloseDisplay(bulkDisplay);
+}
+
+/** Read a window property on the bulk connection. */
+char ReadBulkProperty(Window w, Atom atom, Atom type, long length,
+                      BulkPropertyCallback callback, void *data)
+{
+   BulkJob *jp;
+
+   if(!haveBulk) {
+      return 0;
+   }
+
+   jp = Allocate(sizeof(BulkJob));
+   memset(jp, 0, sizeof(BulkJob));
+   jp->type = BULK_PROPERTY;
+   jp->property.window = w;
+   jp->property.atom = atom;
+   jp->reqType = type;
+   jp->length = length;
+   jp->propertyCallback = callback;
+   jp->data = data;
+   QueueBulkJob(jp);
+   return 1;
+}
+
+/** Upload an image on the bulk connection. */
+char PutBulkImage(Drawable d, XImage *image, int x, int y,
+                  BulkImageCallback callback, void *data)
+{
+   BulkJob *jp;
+
+   if(!haveBulk) {
+      return 0;
+   }
+
+   /* Requests on different connections are not ordered, so make sure
+    * the server has the drawable (and anything drawn on it) first. */
+   JXSync(display, False);
+
+   jp = Allocate(sizeof(BulkJob));
+   memset(jp, 0, sizeof(BulkJob));
+   jp->type = BULK_IMAGE;
+   jp->drawable = d;
+   jp->image = image;
+   jp->x = x;
+   jp->y = y;
+   jp->imageCallback = callback;
+   jp->data = data;
+   QueueBulkJob(jp);
+   return 1;
+}
+
+/** Cancel the callbacks for pending transfers. */
+void CancelBulk(const void *data)
+{
+   BulkJob *jp;
+
+   if(!haveBulk) {
+      return;
+   }
+
+   pthread_mutex_lock(&bulkLock);
+   for(jp = pendingHead; jp; jp = jp->next) {
+      if(jp->data == data) {
+         jp->cancelled = 1;
+      }
+   }
+   if(runningJob && runningJob->data == data) {
+      runningJob->cancelled = 1;
+   }
+   for(jp = doneHead; jp; jp = jp->next) {
+      if(jp->data == data) {
+         jp->cancelled = 1;
+      }
+   }
+   pthread_mutex_unlock(&bulkLock);
+}
+
+/** Hand a job to the worker. */
+void QueueBulkJob(BulkJob *jp)
+{
+   jp->next = NULL;
+   pthread_mutex_lock(&bulkLock);
+   if(pendingTail) {
+      pendingTail->next = jp;
+   } else {
+      pendingHead = jp;
+   }
+   pendingTail = jp;
+   pthread_cond_signal(&bulkCond);
+   pthread_mutex_unlock(&bulkLock);
+}
+
+/** Run the callback for a finished job and release it. */
+void FinishBulkJob(BulkJob *jp, char report)
+{
+   report = report && !jp->cancelled;
+   if(jp->type == BULK_PROPERTY) {
+      if(report) {
+         (jp->propertyCallback)(&jp->property, jp->data);
+      }
+      if(jp->property.data) {
+         JXFree(jp->property.data);
+      }
+   } else {
+      DestroyUploadImage(jp->image);
+      if(report) {
+         (jp->imageCallback)(jp->data);
+      }
+   }
+   Release(jp);
+}
+
+/** Run the callbacks for finished jobs. */
+void HandleBulkWake(int fd, void *data)
+{
+   char buffer[32];
+   BulkJob *jp;
+
+   /* Drain the pipe; the queue says which jobs finished. */
+   while(read(fd, buffer, sizeof(buffer)) > 0) {
+   }
+
+   /* Take one job at a time since callbacks may cancel others. */
+   for(;;) {
+      pthread_mutex_lock(&bulkLock);
+      jp = doneHead;
+      if(jp) {
+         doneHead = jp->next;
+         if(!doneHead) {
+            doneTail = NULL;
+         }
+      }
+      pthread_mutex_unlock(&bulkLock);
+      if(!jp) {
+         break;
+      }
+      FinishBulkJob(jp, 1);
+   }
+}
+
+/** Worker thread for bulk transfers. */
+void *RunBulkWorker(void *arg)
+{
+   BulkJob *jp;
+
+   pthread_mutex_lock(&bulkLock);
+   for(;;) {
+      while(!pendingHead && !bulkStop) {
+         pthread_cond_wait(&bulkCond, &bulkLock);
+      }
+      if(bulkStop) {
+         break;
+      }
+
+      jp = pendingHead;
+      pendingHead = jp->next;
+      if(!pendingHead) {
+         pendingTail = NULL;
+      }
+      runningJob = jp;
+      pthread_mutex_unlock(&bulkLock);
+
+      RunBulkJob(jp);
+
+      pthread_mutex_lock(&bulkLock);
+      runningJob = NULL;
+      jp->next = NULL;
+      if(doneTail) {
+         doneTail->next = jp;
+      } else {
+         doneHead = jp;
+      }
+      doneTail = jp;
+      if(write(bulkWakeFds[1], "", 1) < 0) {
+         /* The pipe is full, so the event loop is already awake. */
+      }
+   }
+   pthread_mutex_unlock(&bulkLock);
+   return NULL;
+}
+
+/** Do the transfer for a job (called on the worker thread). */
+void RunBulkJob(BulkJob *jp)
+{
+   if(jp->type == BULK_PROPERTY) {
+      BulkProperty *pp = &jp->property;
+      if(XGetWindowProperty(bulkDisplay, pp->window, pp->atom, 0,
+                            jp->length, False, jp->reqType, &pp->type,
+                            &pp->format, &pp->count, &pp->extra,
+                            &pp->data) != Success) {
+         pp->data = NULL;
+      }
+   } else {
+      XPutImage(bulkDisplay, jp->drawable, bulkGC, jp->image, 0, 0,
+                jp->x, jp->y, jp->image->width, jp->image->height);
+      XSync(bulkDisplay, False);
+   }
+}
+
+#endif /* USE_BULK */
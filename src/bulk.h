@@ -0,0 +1,93 @@
+/**
+ * @file bulk.h
+ * @author Joe Wingbermuehle
+ * @date 2026
+ *
+ * @brief Bulk transfers on a second X connection.
+ *
+ */
+
+#ifndef BULK_H
+#define BULK_H
+
+#ifdef USE_BULK
+
+/** Result of a property read on the bulk connection. */
+typedef struct BulkProperty {
+   Window window;          /**< The window. */
+   Atom atom;              /**< The property. */
+   Atom type;              /**< Actual type of the property. */
+   int format;             /**< Actual format of the property. */
+   unsigned long count;    /**< Number of items read. */
+   unsigned long extra;    /**< Bytes left unread. */
+   unsigned char *data;    /**< The data (NULL if not read). */
+} BulkProperty;
+
+/** Callback for a property read on the bulk connection.
+ * The data is freed once the callback returns.
+ * @param result The property.
+ * @param data The data passed to ReadBulkProperty.
+ */
+typedef void (*BulkPropertyCallback)(const BulkProperty *result,
+                                     void *data);
+
+/** Callback for an image upload on the bulk connection.
+ * @param data The data passed to PutBulkImage.
+ */
+typedef void (*BulkImageCallback)(void *data);
+
+/** Set if the bulk connection is open. */
+extern char haveBulk;
+
+/*@{*/
+void StartupBulk(void);
+void ShutdownBulk(void);
+/*@}*/
+
+/** Read a window property on the bulk connection.
+ * The callback is called from the event loop once the property is read.
+ * @param w The window.
+ * @param atom The property.
+ * @param type The type of the property (AnyPropertyType for any).
+ * @param length The maximum number of 32-bit units to read.
+ * @param callback The callback.
+ * @param data Data to pass to the callback.
+ * @return 1 if the read was queued, 0 if there is no bulk connection.
+ */
+char ReadBulkProperty(Window w, Atom atom, Atom type, long length,
+                      BulkPropertyCallback callback, void *data);
+
+/** Upload an image on the bulk connection.
+ * The image is owned by the bulk connection and is destroyed with
+ * DestroyUploadImage once the server has it, after which the callback
+ * is called from the event loop. The drawable must be of the root
+ * depth and must not be freed until the callback is called or the
+ * upload is cancelled.
+ * @param d The drawable to receive the image.
+ * @param image An image created with CreateUploadImage.
+ * @param x The x-coordinate in the drawable.
+ * @param y The y-coordinate in the drawable.
+ * @param callback The callback.
+ * @param data Data to pass to the callback.
+ * @return 1 if the upload was queued, 0 if there is no bulk connection.
+ */
+char PutBulkImage(Drawable d, XImage *image, int x, int y,
+                  BulkImageCallback callback, void *data);
+
+/** Cancel the callbacks for pending transfers.
+ * Transfers already started still finish.
+ * @param data The data passed when the transfers were queued (not NULL).
+ */
+void CancelBulk(const void *data);
+
+#else
+
+#define haveBulk 0
+
+#define StartupBulk()            ((void)0)
+#define ShutdownBulk()           ((void)0)
+#define CancelBulk( a )          ((void)0)
+
+#endif /* USE_BULK */
+
+#endif /* BULK_H */
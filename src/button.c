@@ -15,6 +15,7 @@
 #include "image.h"
 #include "misc.h"
 #include "settings.h"
+#include "gcpool.h"
 
 /** Draw a button. */
 void DrawButton(ButtonNode *bp)
@@ -41,7 +42,7 @@ void DrawButton(ButtonNode *bp)
    y = bp->y;
    width = bp->width;
    height = bp->height;
-   gc = JXCreateGC(display, drawable, 0, NULL);
+   gc = AcquireGC(rootDepth, 0, NULL);
 
    /* Determine the colors to use. */
    switch(bp->type) {
@@ -200,7 +201,7 @@ void DrawButton(ButtonNode *bp)
                    textWidth, bp->text);
    }
 
-   JXFreeGC(display, gc);
+   ReleaseGC(gc);
 
 }
 
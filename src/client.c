@@ -23,33 +23,88 @@
 #include "event.h"
 #include "settings.h"
 #include "timing.h"
+#include "trace.h"
+#include "stats.h"
 #include "grab.h"
 #include "desktop.h"
+#include "winmap.h"
+#include "misc.h"
+#include "prefetch.h"
+#include "render.h"
+#include "font.h"
+#include "restart.h"
+#include "preview.h"
+
+/** Number of client nodes allocated at a time. */
+#define CLIENT_SLAB_SIZE 32
+
+/** A block of client nodes. */
+typedef struct ClientSlab {
+   struct ClientSlab *next;
+   ClientNode nodes[CLIENT_SLAB_SIZE];
+} ClientSlab;
 
 static ClientNode *activeClient;
 
+/** Blocks of client nodes and the nodes not in use (linked by next). */
+static ClientSlab *clientSlabs = NULL;
+static ClientNode *freeClients = NULL;
+
 unsigned int clientCount;
 
+/** Stacking order last sent to the server (top to bottom). */
+static Window *sentStack = NULL;
+static unsigned int sentStackCount = 0;
+static char sentStackValid = 0;
+
+/** Client order last published in _NET_CLIENT_LIST_STACKING. */
+static Window *sentOrder = NULL;
+static unsigned int sentOrderCount = 0;
+
+/* Clients with the urgency hint flash together from one timer. */
+static unsigned int urgentCount = 0;
+static char urgentPhase = 0;
+
+/** Windows in the sent stack sorted by window for lookups. */
+typedef struct StackPosition {
+   Window window;
+   unsigned int index;
+} StackPosition;
+
+static ClientNode *AllocateClient(void);
+static void ReleaseClient(ClientNode *np);
+static void DestroyClientInfo(ClientNode *np);
+static char CheckClientWindow(Window w, char alreadyMapped);
+static Bool MatchWithdrawEvent(Display *d, XEvent *e, XPointer arg);
 static void LoadFocus(void);
 static void RestackTransients(const ClientNode *np);
 static void MinimizeTransients(ClientNode *np, char lower);
 static void RestoreTransients(ClientNode *np, char raise);
+static void MoveClientLayer(ClientNode *np, unsigned int layer);
+static void SetStickyHelper(ClientNode *np, char isSticky);
+static void SetDesktopHelper(ClientNode *np, unsigned int desktop);
 static void KillClientHandler(ClientNode *np);
 static void UnmapClient(ClientNode *np);
+static void SignalUrgent(const TimeType *now, int x, int y, Window w,
+                         void *data);
+static char SendStack(const Window *stack, unsigned int count);
+static char UpdateClientOrder(void);
+static int CompareStackPosition(const void *a, const void *b);
 
 /** Load windows that are already mapped. */
 void StartupClients(void)
 {
 
-   XWindowAttributes attr;
    Window rootReturn, parentReturn, *childrenReturn;
    unsigned int childrenCount;
-   unsigned int x;
+   unsigned int x, y;
 
    clientCount = 0;
    activeClient = NULL;
    currentDesktop = 0;
    previousDesktop = 0;
+   StartupDesktopLists();
+   LoadRestartState();
 
    /* Clear out the client lists. */
    for(x = 0; x < LAYER_COUNT; x++) {
@@ -61,18 +116,26 @@ void StartupClients(void)
    JXQueryTree(display, rootWindow, &rootReturn, &parentReturn,
                &childrenReturn, &childrenCount);
 
-   /* Add each client. */
-   for(x = 0; x < childrenCount; x++) {
-      if(JXGetWindowAttributes(display, childrenReturn[x], &attr)) {
-         if(attr.override_redirect == False && attr.map_state == IsViewable) {
-            AddClientWindow(childrenReturn[x], 1, 1);
-         }
+   /* Add each client.
+    * Properties are requested a batch at a time and the client list
+    * is published once all windows have been adopted. */
+   childrenCount = FilterViewableWindows(childrenReturn, childrenCount);
+   HoldNetClientList(1);
+   for(x = 0; x < childrenCount; x += PREFETCH_WINDOWS) {
+      const unsigned int count = Min(childrenCount - x, PREFETCH_WINDOWS);
+      PrefetchProperties(&childrenReturn[x], count);
+      for(y = 0; y < count; y++) {
+         AddClientWindow(childrenReturn[x + y], 1, 1);
       }
+      FinishPrefetch();
    }
+   HoldNetClientList(0);
 
    JXFree(childrenReturn);
 
-   LoadFocus();
+   if(!FinishRestartState()) {
+      LoadFocus();
+   }
 
    RequireTaskUpdate();
    RequirePagerUpdate();
@@ -91,6 +154,58 @@ void ShutdownClients(void)
       }
    }
 
+   ShutdownDesktopLists();
+
+   if(sentStack) {
+      Release(sentStack);
+      sentStack = NULL;
+   }
+   if(sentOrder) {
+      Release(sentOrder);
+      sentOrder = NULL;
+   }
+   sentStackCount = 0;
+   sentOrderCount = 0;
+   sentStackValid = 0;
+
+}
+
+/** Release client nodes. */
+void DestroyClients(void)
+{
+   while(clientSlabs) {
+      ClientSlab *sp = clientSlabs->next;
+      Release(clientSlabs);
+      clientSlabs = sp;
+   }
+   freeClients = NULL;
+}
+
+/** Get an unused client node. */
+ClientNode *AllocateClient(void)
+{
+   ClientNode *np;
+   if(!freeClients) {
+      ClientSlab *sp = Allocate(sizeof(ClientSlab));
+      unsigned int x;
+      for(x = 0; x < CLIENT_SLAB_SIZE; x++) {
+         sp->nodes[x].next = freeClients;
+         freeClients = &sp->nodes[x];
+      }
+      sp->next = clientSlabs;
+      clientSlabs = sp;
+   }
+   np = freeClients;
+   freeClients = np->next;
+   memset(np, 0, sizeof(ClientNode));
+   return np;
+}
+
+/** Return a client node to the free list. */
+void ReleaseClient(ClientNode *np)
+{
+   np->next = freeClients;
+   freeClients = np;
 }
 
 /** Set the focus to the window currently under the mouse pointer. */
@@ -119,6 +234,7 @@ ClientNode *AddClientWindow(Window w, char alreadyMapped, char notOwner)
 
    XWindowAttributes attr;
    ClientNode *np;
+   StatsTime start;
 
    Assert(w != None);
 
@@ -127,17 +243,39 @@ ClientNode *AddClientWindow(Window w, char alreadyMapped, char notOwner)
       return NULL;
    }
 
-   /* Determine if we should care about this window. */
-   if(attr.override_redirect == True) {
+   /* Determine if we should care about this window. Windows that are
+    * not managed are mapped if this is a map request. */
+   if(attr.override_redirect == True || attr.class == InputOnly) {
+      if(!alreadyMapped && notOwner) {
+         JXMapWindow(display, w);
+      }
       return NULL;
    }
-   if(attr.class == InputOnly) {
-      return NULL;
+
+   /* Select events before reading any properties so that changes made
+    * while the properties are read are queued. */
+   if(notOwner) {
+      XSetWindowAttributes sattr;
+      sattr.event_mask
+         = EnterWindowMask
+         | ColormapChangeMask
+         | PropertyChangeMask
+         | KeyReleaseMask
+         | StructureNotifyMask;
+      sattr.do_not_propagate_mask = ButtonPressMask
+                                  | ButtonReleaseMask
+                                  | PointerMotionMask
+                                  | KeyPressMask
+                                  | KeyReleaseMask;
+      JXChangeWindowAttributes(display, w,
+                               CWEventMask | CWDontPropagate, &sattr);
    }
 
+   /* Request the properties we are about to read all at once. */
+   PrefetchProperties(&w, 1);
+
    /* Prepare a client node for this window. */
-   np = Allocate(sizeof(ClientNode));
-   memset(np, 0, sizeof(ClientNode));
+   np = AllocateClient();
 
    np->window = w;
    np->parent = None;
@@ -156,6 +294,7 @@ ClientNode *AddClientWindow(Window w, char alreadyMapped, char notOwner)
 
    np->state.border = BORDER_DEFAULT;
    np->mouseContext = MC_NONE;
+   np->layout.width = -1;
 
    ReadClientInfo(np, alreadyMapped);
 
@@ -166,9 +305,23 @@ ClientNode *AddClientWindow(Window w, char alreadyMapped, char notOwner)
       np->state.defaultLayer = LAYER_ABOVE;
    }
 
+   start = StartStats();
    ApplyGroups(np);
+   RecordSectionStats(SECTION_GROUPS, start);
+   ApplyRestartState(np);
    if(np->icon == NULL) {
-      LoadIcon(np);
+      (void)LoadIcon(np);
+   }
+
+   /* The properties are read and the icon is rendered by now, so the
+    * server is only grabbed while the window is reparented and mapped.
+    * The window may have gone away while the properties were read. */
+   GrabServer();
+   if(JUNLIKELY(!CheckClientWindow(w, alreadyMapped))) {
+      UngrabServer();
+      ReleasePrefetch(w);
+      DestroyClientInfo(np);
+      return NULL;
    }
 
    /* We now know the layer, so insert */
@@ -180,34 +333,27 @@ ClientNode *AddClientWindow(Window w, char alreadyMapped, char notOwner)
       nodeTail[np->state.layer] = np;
    }
    nodes[np->state.layer] = np;
+   UpdateDesktopList(np);
+   UpdateTransientList(np);
+   AddFocusList(np);
 
    if(notOwner) {
-      XSetWindowAttributes sattr;
       JXAddToSaveSet(display, np->window);
-      sattr.event_mask
-         = EnterWindowMask
-         | ColormapChangeMask
-         | PropertyChangeMask
-         | KeyReleaseMask
-         | StructureNotifyMask;
-      sattr.do_not_propagate_mask = ButtonPressMask
-                                  | ButtonReleaseMask
-                                  | PointerMotionMask
-                                  | KeyPressMask
-                                  | KeyReleaseMask;
-      JXChangeWindowAttributes(display, np->window,
-                               CWEventMask | CWDontPropagate, &sattr);
+
+      /* One grab covers every button and modifier; our own dialogs
+       * grab the buttons themselves. */
+      JXGrabButton(display, AnyButton, AnyModifier, np->window, True,
+                   ButtonPressMask, GrabModeSync, GrabModeAsync, None, None);
    }
-   JXGrabButton(display, AnyButton, AnyModifier, np->window, True,
-                ButtonPressMask, GrabModeSync, GrabModeAsync, None, None);
 
    PlaceClient(np, alreadyMapped);
    ReparentClient(np);
-   XSaveContext(display, np->window, clientContext, (void*)np);
+   RegisterWindow(np->window, WINDOW_CLIENT, np);
 
    if(np->state.status & STAT_MAPPED) {
       JXMapWindow(display, np->window);
    }
+   UngrabServer();
 
    clientCount += 1;
 
@@ -220,11 +366,6 @@ ClientNode *AddClientWindow(Window w, char alreadyMapped, char notOwner)
    } else {
       SetOpacity(np, settings.inactiveClientOpacity, 1);
    }
-   if(np->state.status & STAT_STICKY) {
-      SetCardinalAtom(np->window, ATOM_NET_WM_DESKTOP, ~0UL);
-   } else {
-      SetCardinalAtom(np->window, ATOM_NET_WM_DESKTOP, np->state.desktop);
-   }
 
    /* Shade the client if requested. */
    if(np->state.status & STAT_SHADED) {
@@ -246,7 +387,7 @@ ClientNode *AddClientWindow(Window w, char alreadyMapped, char notOwner)
    }
 
    if(np->state.status & STAT_URGENT) {
-      RegisterCallback(URGENCY_DELAY, SignalUrgent, np);
+      StartUrgent();
    }
 
    /* Update task bars. */
@@ -263,6 +404,7 @@ ClientNode *AddClientWindow(Window w, char alreadyMapped, char notOwner)
    }
 
    ReadClientStrut(np);
+   ReleasePrefetch(np->window);
 
    /* Focus transients if their parent has focus. */
    if(np->owner != None) {
@@ -295,7 +437,6 @@ void MinimizeTransients(ClientNode *np, char lower)
 {
 
    ClientNode *tp;
-   int x;
 
    Assert(np);
 
@@ -309,16 +450,10 @@ void MinimizeTransients(ClientNode *np, char lower)
    np->state.status |= STAT_MINIMIZED;
 
    /* Minimize transient windows. */
-   for(x = 0; x < LAYER_COUNT; x++) {
-      tp = nodes[x];
-      while(tp) {
-         ClientNode *next = tp->next;
-         if(tp->owner == np->window
-            && (tp->state.status & (STAT_MAPPED | STAT_SHADED))
-            && !(tp->state.status & STAT_MINIMIZED)) {
-            MinimizeTransients(tp, lower);
-         }
-         tp = next;
+   for(tp = GetNextTransient(np, NULL); tp; tp = GetNextTransient(np, tp)) {
+      if(  (tp->state.status & (STAT_MAPPED | STAT_SHADED))
+         && !(tp->state.status & STAT_MINIMIZED)) {
+         MinimizeTransients(tp, lower);
       }
    }
 
@@ -431,7 +566,6 @@ void RestoreTransients(ClientNode *np, char raise)
 {
 
    ClientNode *tp;
-   int x;
 
    Assert(np);
 
@@ -456,11 +590,9 @@ void RestoreTransients(ClientNode *np, char raise)
    np->state.status &= ~STAT_SDESKTOP;
 
    /* Restore transient windows. */
-   for(x = 0; x < LAYER_COUNT; x++) {
-      for(tp = nodes[x]; tp; tp = tp->next) {
-         if(tp->owner == np->window && (tp->state.status & STAT_MINIMIZED)) {
-            RestoreTransients(tp, raise);
-         }
+   for(tp = GetNextTransient(np, NULL); tp; tp = GetNextTransient(np, tp)) {
+      if(tp->state.status & STAT_MINIMIZED) {
+         RestoreTransients(tp, raise);
       }
    }
 
@@ -483,68 +615,75 @@ void RestoreClient(ClientNode *np, char raise)
    RequireTaskUpdate();
 }
 
+/** Move a client to the top of a layer. */
+void MoveClientLayer(ClientNode *np, unsigned int layer)
+{
+
+   /* Remove from the old node list */
+   if(np->next) {
+      np->next->prev = np->prev;
+   } else {
+      nodeTail[np->state.layer] = np->prev;
+   }
+   if(np->prev) {
+      np->prev->next = np->next;
+   } else {
+      nodes[np->state.layer] = np->next;
+   }
+
+   /* Insert into the new node list */
+   np->prev = NULL;
+   np->next = nodes[layer];
+   if(nodes[layer]) {
+      nodes[layer]->prev = np;
+   } else {
+      nodeTail[layer] = np;
+   }
+   nodes[layer] = np;
+
+   /* Set the new layer */
+   np->state.layer = layer;
+   WriteState(np);
+
+}
+
 /** Set the client layer. This will affect transients. */
 void SetClientLayer(ClientNode *np, unsigned int layer)
 {
 
-   ClientNode *tp, *next;
+   ClientNode *tp;
 
    Assert(np);
    Assert(layer <= LAST_LAYER);
 
    if(np->state.layer != layer) {
-      int x;
-
-      /* Loop through all clients so we get transients. */
-      for(x = FIRST_LAYER; x <= LAST_LAYER; x++) {
-         tp = nodes[x];
-         while(tp) {
-            next = tp->next;
-            if(tp == np || tp->owner == np->window) {
-
-               /* Remove from the old node list */
-               if(next) {
-                  next->prev = tp->prev;
-               } else {
-                  nodeTail[tp->state.layer] = tp->prev;
-               }
-               if(tp->prev) {
-                  tp->prev->next = next;
-               } else {
-                  nodes[tp->state.layer] = next;
-               }
-
-               /* Insert into the new node list */
-               tp->prev = NULL;
-               tp->next = nodes[layer];
-               if(nodes[layer]) {
-                  nodes[layer]->prev = tp;
-               } else {
-                  nodeTail[layer] = tp;
-               }
-               nodes[layer] = tp;
-
-               /* Set the new layer */
-               tp->state.layer = layer;
-               WriteState(tp);
-
-            }
-            tp = next;
-         }
+      MoveClientLayer(np, layer);
+      for(tp = GetNextTransient(np, NULL); tp;
+          tp = GetNextTransient(np, tp)) {
+         MoveClientLayer(tp, layer);
       }
-
       RequireRestack();
-
    }
 
 }
 
+/** Set the sticky status of a client without updating transients. */
+void SetStickyHelper(ClientNode *np, char isSticky)
+{
+   if(isSticky) {
+      np->state.status |= STAT_STICKY;
+   } else {
+      np->state.status &= ~STAT_STICKY;
+   }
+   UpdateDesktopList(np);
+   WriteState(np);
+}
+
 /** Set a client's sticky status. This will update transients. */
 void SetClientSticky(ClientNode *np, char isSticky)
 {
 
    ClientNode *tp;
-   int x;
    char old;
 
    Assert(np);
@@ -559,29 +698,22 @@ void SetClientSticky(ClientNode *np, char isSticky)
    if(isSticky && !old) {
 
       /* Change from non-sticky to sticky. */
-
-      for(x = 0; x < LAYER_COUNT; x++) {
-         for(tp = nodes[x]; tp; tp = tp->next) {
-            if(tp == np || tp->owner == np->window) {
-               tp->state.status |= STAT_STICKY;
-               SetCardinalAtom(tp->window, ATOM_NET_WM_DESKTOP, ~0UL);
-               WriteState(tp);
-            }
-         }
+      SetStickyHelper(np, 1);
+      for(tp = GetNextTransient(np, NULL); tp;
+          tp = GetNextTransient(np, tp)) {
+         SetStickyHelper(tp, 1);
       }
+      InvalidateWorkarea();
 
    } else if(!isSticky && old) {
 
       /* Change from sticky to non-sticky. */
-
-      for(x = 0; x < LAYER_COUNT; x++) {
-         for(tp = nodes[x]; tp; tp = tp->next) {
-            if(tp == np || tp->owner == np->window) {
-               tp->state.status &= ~STAT_STICKY;
-               WriteState(tp);
-            }
-         }
+      SetStickyHelper(np, 0);
+      for(tp = GetNextTransient(np, NULL); tp;
+          tp = GetNextTransient(np, tp)) {
+         SetStickyHelper(tp, 0);
       }
+      InvalidateWorkarea();
 
       /* Since this client is no longer sticky, we need to assign
        * a desktop. Here we use the current desktop.
@@ -593,6 +725,21 @@ void SetClientSticky(ClientNode *np, char isSticky)
 
 }
 
+/** Set the desktop of a client without updating transients. */
+void SetDesktopHelper(ClientNode *np, unsigned int desktop)
+{
+   np->state.desktop = desktop;
+   UpdateDesktopList(np);
+
+   if(desktop == currentDesktop) {
+      ShowClient(np);
+   } else {
+      HideClient(np);
+   }
+
+   WriteState(np);
+}
+
 /** Set a client's desktop. This will update transients. */
 void SetClientDesktop(ClientNode *np, unsigned int desktop)
 {
@@ -606,26 +753,14 @@ void SetClientDesktop(ClientNode *np, unsigned int desktop)
    }
 
    if(!(np->state.status & STAT_STICKY)) {
-      int x;
-      for(x = 0; x < LAYER_COUNT; x++) {
-         for(tp = nodes[x]; tp; tp = tp->next) {
-            if(tp == np || tp->owner == np->window) {
-
-               tp->state.desktop = desktop;
-
-               if(desktop == currentDesktop) {
-                  ShowClient(tp);
-               } else {
-                  HideClient(tp);
-               }
-
-               SetCardinalAtom(tp->window, ATOM_NET_WM_DESKTOP,
-                               tp->state.desktop);
-            }
-         }
+      SetDesktopHelper(np, desktop);
+      for(tp = GetNextTransient(np, NULL); tp;
+          tp = GetNextTransient(np, tp)) {
+         SetDesktopHelper(tp, desktop);
       }
       RequirePagerUpdate();
       RequireTaskUpdate();
+      InvalidateWorkarea();
    }
 
 }
@@ -653,17 +788,22 @@ void ShowClient(ClientNode *np)
 {
    if(np->state.status & STAT_HIDDEN) {
       np->state.status &= ~STAT_HIDDEN;
-      if(np->state.status & (STAT_MAPPED | STAT_SHADED)) {
-         if(!(np->state.status & STAT_MINIMIZED)) {
-            if(np->parent != None) {
-               JXMapWindow(display, np->parent);
-            } else {
-               JXMapWindow(display, np->window);
-            }
-            if(np->state.status & STAT_ACTIVE) {
-               FocusClient(np);
-            }
-         }
+      MapShownClient(np);
+   }
+}
+
+/** Map a client that is no longer hidden. */
+void MapShownClient(ClientNode *np)
+{
+   if(  (np->state.status & (STAT_MAPPED | STAT_SHADED))
+      && !(np->state.status & (STAT_MINIMIZED | STAT_HIDDEN))) {
+      if(np->parent != None) {
+         JXMapWindow(display, np->parent);
+      } else {
+         JXMapWindow(display, np->window);
+      }
+      if(np->state.status & STAT_ACTIVE) {
+         FocusClient(np);
       }
    }
 }
@@ -774,7 +914,7 @@ void SetClientFullScreen(ClientNode *np, char fullScreen)
       sp = GetCurrentScreen(np->x, np->y);
       GetScreenBounds(sp, &box);
 
-      GetBorderSize(&np->state, &north, &south, &east, &west);
+      GetClientBorderSize(np, &north, &south, &east, &west);
       box.x += west;
       box.y += north;
       box.width -= east + west;
@@ -830,21 +970,29 @@ void FocusClient(ClientNode *np)
    }
 
    if(activeClient != np || !(np->state.status & STAT_ACTIVE)) {
+
+      /* A fullscreen client is only above the trays while active. */
+      if(   (np->state.status & STAT_FULLSCREEN)
+         || (activeClient && (activeClient->state.status & STAT_FULLSCREEN))) {
+         RequireRestack();
+      }
+
       if(activeClient) {
          activeClient->state.status &= ~STAT_ACTIVE;
          if(!(activeClient->state.status & STAT_OPACITY)) {
             SetOpacity(activeClient, settings.inactiveClientOpacity, 0);
          }
-         DrawBorder(activeClient);
-         WriteNetState(activeClient);
+         RequireBorderDraw(activeClient);
+         WriteState(activeClient);
       }
       np->state.status |= STAT_ACTIVE;
       activeClient = np;
+      UpdateFocusList(np);
       if(!(np->state.status & STAT_OPACITY)) {
          SetOpacity(np, settings.activeClientOpacity, 0);
       }
 
-      DrawBorder(np);
+      RequireBorderDraw(np);
       RequirePagerUpdate();
       RequireTaskUpdate();
    }
@@ -852,7 +1000,7 @@ void FocusClient(ClientNode *np)
    if(np->state.status & STAT_MAPPED) {
       UpdateClientColormap(np);
       SetWindowAtom(rootWindow, ATOM_NET_ACTIVE_WINDOW, np->window);
-      WriteNetState(np);
+      WriteState(np);
       if(np->state.status & STAT_CANFOCUS) {
          JXSetInputFocus(display, np->window, RevertToParent, eventTime);
       }
@@ -910,35 +1058,21 @@ void KillClient(ClientNode *np)
 void RestackTransients(const ClientNode *np)
 {
    ClientNode *tp;
-   unsigned int layer;
-
-   /* Place any transient windows on top of the owner */
-   for(layer = 0; layer < LAYER_COUNT; layer++) {
-      for(tp = nodes[layer]; tp; tp = tp->next) {
-         if(tp->owner == np->window && tp->prev) {
-
-            ClientNode *next = tp->next;
-
-            tp->prev->next = tp->next;
-            if(tp->next) {
-               tp->next->prev = tp->prev;
-            } else {
-               nodeTail[tp->state.layer] = tp->prev;
-            }
-            tp->next = nodes[tp->state.layer];
-            nodes[tp->state.layer]->prev = tp;
-            tp->prev = NULL;
-            nodes[tp->state.layer] = tp;
 
-            tp = next;
-
-         }
-
-         /* tp will be tp->next if the above code is executed. */
-         /* Thus, if it is NULL, we are done with this layer. */
-         if(!tp) {
-            break;
+   /* Place any transient windows on top of the owner.
+    * Later transients end up on top. */
+   for(tp = GetNextTransient(np, NULL); tp; tp = GetNextTransient(np, tp)) {
+      if(tp->prev) {
+         tp->prev->next = tp->next;
+         if(tp->next) {
+            tp->next->prev = tp->prev;
+         } else {
+            nodeTail[tp->state.layer] = tp->prev;
          }
+         tp->next = nodes[tp->state.layer];
+         nodes[tp->state.layer]->prev = tp;
+         tp->prev = NULL;
+         nodes[tp->state.layer] = tp;
       }
    }
 }
@@ -1082,20 +1216,44 @@ void RestackClient(ClientNode *np, Window above, int detail)
 void RestackClients(void)
 {
 
-   TrayType *tp;
-   ClientNode *np;
-   unsigned int layer, index;
-   int trayCount;
    Window *stack;
-   Window fw;
+   unsigned int count;
+   char changed;
+   TraceTime traceStart;
 
    if(JUNLIKELY(shouldExit)) {
       return;
    }
 
+   traceStart = StartTrace();
+
    /* Allocate memory for restacking. */
-   trayCount = GetTrayCount();
-   stack = AllocateStack((clientCount + trayCount) * sizeof(Window));
+   stack = AllocateStack((clientCount + GetTrayCount()) * sizeof(Window));
+   count = GetStackOrder(stack);
+
+   changed = SendStack(stack, count);
+   ReleaseStack(stack);
+
+   /* The client list and pager include hidden clients, so they must be
+    * updated if the client order changed even if the server stacking
+    * order did not. */
+   if(UpdateClientOrder() || changed) {
+      UpdateNetClientList();
+      RequirePagerUpdate();
+   }
+   UpdateTrayCoverage();
+   RecordTrace("RestackClients", -1, traceStart);
+
+}
+
+/** Get the stacking order we want (top to bottom). */
+unsigned int GetStackOrder(Window *stack)
+{
+
+   TrayType *tp;
+   ClientNode *np;
+   unsigned int layer, index;
+   Window fw;
 
    /* Prepare the stacking array. */
    fw = None;
@@ -1151,12 +1309,197 @@ void RestackClients(void)
 
    }
 
-   JXRestackWindows(display, stack, index);
+   return index;
 
-   ReleaseStack(stack);
-   UpdateNetClientList();
-   RequirePagerUpdate();
+}
+
+/** Force the next restack to send the full stacking order. */
+void InvalidateStack(void)
+{
+   sentStackValid = 0;
+}
+
+/** Sort stack positions by window. */
+int CompareStackPosition(const void *a, const void *b)
+{
+   const Window wa = ((const StackPosition*)a)->window;
+   const Window wb = ((const StackPosition*)b)->window;
+   if(wa < wb) {
+      return -1;
+   } else if(wa > wb) {
+      return 1;
+   } else {
+      return 0;
+   }
+}
+
+/** Send a stacking order (top to bottom) to the server.
+ * Only the windows that moved relative to the order that was last sent
+ * are restacked (see GetStackMoves).
+ * @return 1 if the stacking order changed, 0 otherwise.
+ */
+char SendStack(const Window *stack, unsigned int count)
+{
+   char *keep;
+   unsigned int x, moves, first;
+
+   if(sentStackValid && count == sentStackCount
+      && !memcmp(stack, sentStack, count * sizeof(Window))) {
+      return 0;
+   }
+
+   if(!sentStackValid || count < 2 || sentStackCount == 0) {
+      JXRestackWindows(display, (Window*)stack, count);
+      goto save;
+   }
+
+   keep = AllocateStack(count);
+   moves = GetStackMoves(sentStack, sentStackCount, stack, count, keep);
+
+   /* Moving most of the windows is cheaper with a single request. */
+   if(moves * 2 > count) {
+      JXRestackWindows(display, (Window*)stack, count);
+   } else {
+      XWindowChanges wc;
+      first = 0;
+      while(!keep[first]) {
+         first += 1;
+      }
+      for(x = 0; x < count; x++) {
+         if(keep[x]) {
+            continue;
+         }
+         if(x == 0) {
+            wc.sibling = stack[first];
+            wc.stack_mode = Above;
+         } else {
+            wc.sibling = stack[x - 1];
+            wc.stack_mode = Below;
+         }
+         JXConfigureWindow(display, stack[x], CWSibling | CWStackMode, &wc);
+      }
+   }
+
+   ReleaseStack(keep);
+
+save:
+
+   if(count > sentStackCount || !sentStack) {
+      if(sentStack) {
+         Release(sentStack);
+      }
+      sentStack = Allocate((count + 1) * sizeof(Window));
+   }
+   memcpy(sentStack, stack, count * sizeof(Window));
+   sentStackCount = count;
+   sentStackValid = 1;
+   return 1;
+
+}
+
+/** Determine which windows must move to change the stacking order.
+ * The longest run of windows that kept their relative order stays put
+ * and every other window is placed directly below its new upper
+ * neighbor.
+ */
+unsigned int GetStackMoves(const Window *oldStack, unsigned int oldCount,
+                           const Window *stack, unsigned int count,
+                           char *keep)
+{
+   StackPosition *positions;
+   unsigned int *oldIndex;
+   unsigned int *tails;
+   unsigned int *prev;
+   unsigned int x, length;
+
+   /* Look up the previous position of each window. */
+   positions = AllocateStack(oldCount * sizeof(StackPosition));
+   for(x = 0; x < oldCount; x++) {
+      positions[x].window = oldStack[x];
+      positions[x].index = x;
+   }
+   qsort(positions, oldCount, sizeof(StackPosition), CompareStackPosition);
+   oldIndex = AllocateStack(count * sizeof(unsigned int));
+   for(x = 0; x < count; x++) {
+      StackPosition key;
+      const StackPosition *pp;
+      key.window = stack[x];
+      pp = bsearch(&key, positions, oldCount, sizeof(StackPosition),
+                   CompareStackPosition);
+      oldIndex[x] = pp ? pp->index : UINT_MAX;
+   }
+   ReleaseStack(positions);
+
+   /* Find the longest increasing run of old positions. */
+   tails = AllocateStack(count * sizeof(unsigned int));
+   prev = AllocateStack(count * sizeof(unsigned int));
+   length = 0;
+   for(x = 0; x < count; x++) {
+      unsigned int low = 0;
+      unsigned int high = length;
+      keep[x] = 0;
+      if(oldIndex[x] == UINT_MAX) {
+         continue;
+      }
+      while(low < high) {
+         const unsigned int mid = (low + high) / 2;
+         if(oldIndex[tails[mid]] < oldIndex[x]) {
+            low = mid + 1;
+         } else {
+            high = mid;
+         }
+      }
+      prev[x] = low > 0 ? tails[low - 1] : UINT_MAX;
+      tails[low] = x;
+      if(low == length) {
+         length += 1;
+      }
+   }
+   if(length > 0) {
+      for(x = tails[length - 1]; x != UINT_MAX; x = prev[x]) {
+         keep[x] = 1;
+      }
+   }
+
+   ReleaseStack(prev);
+   ReleaseStack(tails);
+   ReleaseStack(oldIndex);
+
+   return count - length;
+}
+
+/** Record the current client order.
+ * @return 1 if the order changed since the last call, 0 otherwise.
+ */
+char UpdateClientOrder(void)
+{
+   ClientNode *np;
+   unsigned int layer, index;
+   char changed;
+
+   if(clientCount != sentOrderCount || !sentOrder) {
+      if(sentOrder) {
+         Release(sentOrder);
+      }
+      sentOrder = Allocate((clientCount + 1) * sizeof(Window));
+      sentOrderCount = clientCount;
+      changed = 1;
+   } else {
+      changed = 0;
+   }
 
+   index = 0;
+   for(layer = FIRST_LAYER; layer <= LAST_LAYER; layer++) {
+      for(np = nodes[layer]; np; np = np->next) {
+         Assert(index < clientCount);
+         if(sentOrder[index] != np->window) {
+            sentOrder[index] = np->window;
+            changed = 1;
+         }
+         index += 1;
+      }
+   }
+   return changed;
 }
 
 /** Send a client message to a window. */
@@ -1185,11 +1528,12 @@ void SendClientMessage(Window w, AtomType type, AtomType message)
 void RemoveClient(ClientNode *np)
 {
 
-   ColormapNode *cp;
-
    Assert(np);
    Assert(np->window != None);
 
+   /* Write any state changes made before the client was removed. */
+   FlushState(np);
+
    /* Remove this client from the client list */
    if(np->next) {
       np->next->prev = np->prev;
@@ -1202,13 +1546,14 @@ void RemoveClient(ClientNode *np)
       nodes[np->state.layer] = np->next;
    }
    clientCount -= 1;
-   XDeleteContext(display, np->window, clientContext);
-   if(np->parent != None) {
-      XDeleteContext(display, np->parent, frameContext);
-   }
+   RemoveDesktopList(np);
+   RemoveTransientList(np);
+   RemoveFocusList(np);
+   UnregisterWindow(np->window);
+   UnregisterWindow(np->parent);
 
    if(np->state.status & STAT_URGENT) {
-      UnregisterCallback(SignalUrgent, np);
+      StopUrgent();
    }
 
    /* Make sure this client isn't active */
@@ -1241,16 +1586,36 @@ void RemoveClient(ClientNode *np)
             && (np->state.status & (STAT_MINIMIZED | STAT_SHADED)))) {
          JXMapWindow(display, np->window);
       }
-      JXUngrabButton(display, AnyButton, AnyModifier, np->window);
+      /* The grab is released with the connection unless restarting. */
+      if(shouldRestart) {
+         JXUngrabButton(display, AnyButton, AnyModifier, np->window);
+      }
       JXReparentWindow(display, np->window, rootWindow, np->x, np->y);
       JXRemoveFromSaveSet(display, np->window);
    }
 
    /* Destroy the parent */
    if(np->parent) {
+      ReleasePreview(np);
+      ReleaseRenderTarget(np->parent);
+      ReleaseFontTarget(np->parent);
       JXDestroyWindow(display, np->parent);
    }
 
+   RemoveClientFromTaskBar(np);
+   RemoveClientStrut(np);
+   DestroyClientInfo(np);
+
+   RequireRestack();
+
+}
+
+/** Release the information read for a client and the client node. */
+void DestroyClientInfo(ClientNode *np)
+{
+
+   ColormapNode *cp;
+
    if(np->name) {
       Release(np->name);
    }
@@ -1264,9 +1629,6 @@ void RemoveClient(ClientNode *np)
       Release(np->machineName);
    }
 
-   RemoveClientFromTaskBar(np);
-   RemoveClientStrut(np);
-
    while(np->colormaps) {
       cp = np->colormaps->next;
       Release(np->colormaps);
@@ -1275,10 +1637,57 @@ void RemoveClient(ClientNode *np)
 
    DestroyIcon(np->icon);
 
-   Release(np);
+   ReleaseClient(np);
 
-   RequireRestack();
+}
+
+/** Data for MatchWithdrawEvent. */
+typedef struct WithdrawData {
+   Window window;
+   char found;
+} WithdrawData;
+
+/** Check that a window being added is still there to manage.
+ * This must be called with the server grabbed.
+ * @param w The client window.
+ * @param alreadyMapped 1 if the window was mapped when it was added.
+ * @return 1 if the window should be managed, 0 if it was destroyed,
+ *         unmapped, or withdrawn.
+ */
+char CheckClientWindow(Window w, char alreadyMapped)
+{
+   XWindowAttributes attr;
+   WithdrawData data;
+   XEvent e;
+
+   /* This round trip also gets any events sent before the grab. */
+   if(JXGetWindowAttributes(display, w, &attr) == 0) {
+      return 0;
+   }
+   if(alreadyMapped && attr.map_state == IsUnmapped) {
+      return 0;
+   }
 
+   /* Events for the window are left in the queue; they are ignored
+    * once the window is not a client. */
+   data.window = w;
+   data.found = 0;
+   JXCheckIfEvent(display, &e, MatchWithdrawEvent, (XPointer)&data);
+   return !data.found;
+}
+
+/** Predicate to find an unmap or destroy of a window.
+ * This never matches so the events stay in the queue.
+ */
+Bool MatchWithdrawEvent(Display *d, XEvent *e, XPointer arg)
+{
+   WithdrawData *data = (WithdrawData*)arg;
+   if(  (e->type == UnmapNotify && e->xunmap.window == data->window)
+      || (e->type == DestroyNotify
+         && e->xdestroywindow.window == data->window)) {
+      data->found = 1;
+   }
+   return False;
 }
 
 /** Get the active client (possibly NULL). */
@@ -1290,34 +1699,29 @@ ClientNode *GetActiveClient(void)
 /** Find a client by parent or window. */
 ClientNode *FindClient(Window w)
 {
-   ClientNode *np;
-   np = FindClientByWindow(w);
-   if(!np) {
-      np = FindClientByParent(w);
+   WindowKind kind;
+   ClientNode *np = LookupWindow(w, &kind);
+   if(kind == WINDOW_CLIENT || kind == WINDOW_FRAME) {
+      return np;
+   } else {
+      return NULL;
    }
-   return np;
 }
 
 /** Find a client by window. */
 ClientNode *FindClientByWindow(Window w)
 {
-   ClientNode *np;
-   if(!XFindContext(display, w, clientContext, (void*)&np)) {
-      return np;
-   } else {
-      return NULL;
-   }
+   WindowKind kind;
+   ClientNode *np = LookupWindow(w, &kind);
+   return kind == WINDOW_CLIENT ? np : NULL;
 }
 
 /** Find a client by its frame window. */
 ClientNode *FindClientByParent(Window p)
 {
-   ClientNode *np;
-   if(!XFindContext(display, p, frameContext, (void*)&np)) {
-      return np;
-   } else {
-      return NULL;
-   }
+   WindowKind kind;
+   ClientNode *np = LookupWindow(p, &kind);
+   return kind == WINDOW_FRAME ? np : NULL;
 }
 
 /** Reparent a client window. */
@@ -1336,9 +1740,12 @@ void ReparentClient(ClientNode *np)
       }
 
       JXReparentWindow(display, np->window, rootWindow, np->x, np->y);
-      XDeleteContext(display, np->parent, frameContext);
+      UnregisterWindow(np->parent);
+      ReleaseRenderTarget(np->parent);
+      ReleaseFontTarget(np->parent);
       JXDestroyWindow(display, np->parent);
       np->parent = None;
+      np->shape.valid = 0;
 
    } else {
 
@@ -1348,14 +1755,15 @@ void ReparentClient(ClientNode *np)
 
       attrMask = 0;
 
-      /* We can't use PointerMotionHint mask here since the exact location
-       * of the mouse on the frame is important. */
+      /* Motion hints are used so that moving over the frame sends one
+       * event until the pointer is queried again. */
       attrMask |= CWEventMask;
       attr.event_mask
          = ButtonPressMask
          | ButtonReleaseMask
          | ExposureMask
          | PointerMotionMask
+         | PointerMotionHintMask
          | SubstructureRedirectMask
          | SubstructureNotifyMask
          | EnterWindowMask
@@ -1376,7 +1784,7 @@ void ReparentClient(ClientNode *np)
       y = np->y;
       width = np->width;
       height = np->height;
-      GetBorderSize(&np->state, &north, &south, &east, &west);
+      GetClientBorderSize(np, &north, &south, &east, &west);
       x -= west;
       y -= north;
       width += east + west;
@@ -1386,7 +1794,7 @@ void ReparentClient(ClientNode *np)
       np->parent = JXCreateWindow(display, rootWindow, x, y, width, height,
                                   0, rootDepth, InputOutput,
                                   rootVisual, attrMask, &attr);
-      XSaveContext(display, np->parent, frameContext, (void*)np);
+      RegisterWindow(np->parent, WINDOW_FRAME, np);
 
       JXSetWindowBorderWidth(display, np->window, 0);
 
@@ -1470,21 +1878,59 @@ void UpdateClientColormap(ClientNode *np)
 
 }
 
-/** Update callback for clients with the urgency hint set. */
+/** Start flashing a client with the urgency hint. */
+void StartUrgent(void)
+{
+   if(urgentCount == 0) {
+      RegisterCallback(URGENCY_DELAY, SignalUrgent, NULL);
+   }
+   urgentCount += 1;
+}
+
+/** Stop flashing a client that no longer has the urgency hint. */
+void StopUrgent(void)
+{
+   Assert(urgentCount > 0);
+   urgentCount -= 1;
+   if(urgentCount == 0) {
+      UnregisterCallback(SignalUrgent, NULL);
+      urgentPhase = 0;
+   }
+}
+
+/** Update callback for clients with the urgency hint set.
+ * All urgent clients share one phase so that they flash together and
+ * the task bar and pager are updated once per flash.
+ */
 void SignalUrgent(const TimeType *now, int x, int y, Window w, void *data)
 {
 
-   ClientNode *np = (ClientNode*)data;
+   ClientNode *np;
+   unsigned int layer;
+   char changed = 0;
 
-   /* Redraw borders. */
-   if(np->state.status & STAT_FLASH) {
-      np->state.status &= ~STAT_FLASH;
-   } else if(!(np->state.status & STAT_NOTURGENT)) {
-      np->state.status |= STAT_FLASH;
+   urgentPhase = !urgentPhase;
+   for(layer = FIRST_LAYER; layer <= LAST_LAYER; layer++) {
+      for(np = nodes[layer]; np; np = np->next) {
+         const unsigned int status = np->state.status;
+         if(!(status & STAT_URGENT)) {
+            continue;
+         }
+         if(urgentPhase && !(status & STAT_NOTURGENT)) {
+            np->state.status |= STAT_FLASH;
+         } else {
+            np->state.status &= ~STAT_FLASH;
+         }
+         if(np->state.status != status) {
+            DrawBorder(np);
+            changed = 1;
+         }
+      }
+   }
+   if(changed) {
+      RequireTaskUpdate();
+      RequirePagerUpdate();
    }
-   DrawBorder(np);
-   RequireTaskUpdate();
-   RequirePagerUpdate();
 
 }
 
@@ -88,6 +88,7 @@ typedef unsigned int StatusFlags;
 #define STAT_AEROSNAP   (1 << 28)   /**< Enable Aero Snap. */
 #define STAT_NODRAG     (1 << 29)   /**< Disable mod1+drag/resize. */
 #define STAT_POSITION   (1 << 30)   /**< Config-specified position. */
+#define STAT_SYNC       (1U << 31)  /**< Client uses _NET_WM_SYNC_REQUEST. */
 
 /** Maximization flags. */
 typedef unsigned char MaxFlags;
@@ -148,12 +149,20 @@ typedef struct ClientNode {
    char *instanceName;        /**< Name of this window for properties. */
    char *className;           /**< Name of the window class. */
    char *machineName;         /**< Name of the machine. */
+   unsigned int nameSize;     /**< Bytes allocated for name. */
+   unsigned int machineSize;  /**< Bytes allocated for machineName. */
 
    ClientState state;         /**< Window state. */
+   HintCache hints;           /**< State properties last written. */
+   BorderShape shape;         /**< Frame shape last applied. */
+   BorderLayout layout;       /**< Title bar buttons last laid out. */
+   BorderExtents extents;     /**< Border sizes last computed. */
+   char drawPending;          /**< Set if the border is to be drawn. */
 
    MouseContextType mouseContext;
 
    struct IconNode *icon;     /**< Icon assigned to this window. */
+   struct PreviewNode *preview;  /**< Pager preview (NULL for none). */
 
    /** Callback to stop move/resize. */
    void (*controller)(int wasDestroyed);
@@ -161,6 +170,25 @@ typedef struct ClientNode {
    struct ClientNode *prev;   /**< The previous client in this layer. */
    struct ClientNode *next;   /**< The next client in this layer. */
 
+   /** The previous client on this desktop (see clientlist.h). */
+   struct ClientNode *desktopPrev;
+   /** The next client on this desktop (see clientlist.h). */
+   struct ClientNode *desktopNext;
+   /** The desktop list holding this client plus 1 (0 for none). */
+   unsigned int desktopList;
+
+   /** The previous transient in the owner index (see clientlist.h). */
+   struct ClientNode *transientPrev;
+   /** The next transient in the owner index (see clientlist.h). */
+   struct ClientNode *transientNext;
+   /** The owner this client is indexed under (None if not indexed). */
+   Window transientOwner;
+
+   /** The previously focused client (see clientlist.h). */
+   struct ClientNode *focusPrev;
+   /** The next most recently focused client (see clientlist.h). */
+   struct ClientNode *focusNext;
+
 } ClientNode;
 
 /** The number of clients (maintained in client.c). */
@@ -193,14 +221,16 @@ ClientNode *GetActiveClient(void);
 #define InitializeClients()   (void)(0)
 void StartupClients(void);
 void ShutdownClients(void);
-#define DestroyClients()      (void)(0)
+void DestroyClients(void);
 /*@}*/
 
 /** Add a window to management.
  * @param w The client window.
  * @param alreadyMapped 1 if the window is mapped, 0 if not.
  * @param notOwner 1 if JWM doesn't own this window, 0 if JWM is the owner.
- * @return The client window data.
+ * @return The client window data (NULL if the window is not managed).
+ *         Override-redirect and input-only windows are not managed and
+ *         are mapped if they were not mapped and JWM is not the owner.
  */
 ClientNode *AddClientWindow(Window w, char alreadyMapped, char notOwner);
 
@@ -292,6 +322,31 @@ void RestackClient(ClientNode *np, Window above, int detail);
  */
 void RestackClients(void);
 
+/** Get the stacking order of the clients and trays.
+ * @param stack The array to fill (top to bottom), which must have room
+ *              for clientCount + GetTrayCount() windows.
+ * @return The number of windows in the stacking order.
+ */
+unsigned int GetStackOrder(Window *stack);
+
+/** Determine which windows must move to change the stacking order.
+ * @param oldStack The previous stacking order (top to bottom).
+ * @param oldCount The number of windows in oldStack (at least 1).
+ * @param stack The new stacking order (top to bottom).
+ * @param count The number of windows in stack.
+ * @param keep Set to 1 for each window in stack that stays put.
+ * @return The number of windows that must move.
+ */
+unsigned int GetStackMoves(const Window *oldStack, unsigned int oldCount,
+                           const Window *stack, unsigned int count,
+                           char *keep);
+
+/** Force the next restack to send the full stacking order.
+ * This must be called after raising or lowering a frame or tray window
+ * without going through RestackClients.
+ */
+void InvalidateStack(void);
+
 /** Set the layer of a client.
  * @param np The client whose layer to set.
  * @param layer the layer to assign to the client.
@@ -323,6 +378,12 @@ void HideClient(ClientNode *np);
  */
 void ShowClient(ClientNode *np);
 
+/** Map a client that is no longer hidden.
+ * This is used to map a desktop after its clients are restacked.
+ * @param np The client to map.
+ */
+void MapShownClient(ClientNode *np);
+
 /** Update a client's colormap.
  * @param np The client.
  */
@@ -348,9 +409,13 @@ void SendConfigureEvent(ClientNode *np);
  */
 void SendClientMessage(Window w, AtomType type, AtomType message);
 
-/** Update callback for clients with the urgency hint set. */
-void SignalUrgent(const struct TimeType *now, int x, int y, Window w,
-                  void *data);
+/** Start flashing a client with the urgency hint.
+ * Call once for each client that gains STAT_URGENT.
+ */
+void StartUrgent(void);
+
+/** Stop flashing a client that loses STAT_URGENT or is removed. */
+void StopUrgent(void);
 
 #endif /* CLIENT_H */
 
@@ -18,12 +18,171 @@
 ClientNode *nodes[LAYER_COUNT];
 ClientNode *nodeTail[LAYER_COUNT];
 
-static Window *windowStack = NULL;  /**< Image of the window stack. */
-static int windowStackSize = 0;     /**< Size of the image. */
-static int windowStackCurrent = 0;  /**< Current location in the image. */
+static ClientNode *walkCurrent = NULL; /**< Current window in the walk. */
+static char walkingStack = 0;       /**< Are we walking the window stack? */
 static char walkingWindows = 0;     /**< Are we walking windows? */
 static char wasMinimized = 0;       /**< Was the current window minimized? */
 
+/** Clients from most to least recently focused. */
+static ClientNode *focusHead = NULL;
+static ClientNode *focusTail = NULL;
+
+/** Size of the owner index (must be a power of two). */
+#define TRANSIENT_HASH_SIZE 64
+
+/** Transient clients hashed by owner window. */
+static ClientNode *transientHash[TRANSIENT_HASH_SIZE];
+
+/** Clients by desktop; the last list holds sticky clients. */
+static ClientNode **desktopLists = NULL;
+static unsigned int desktopListCount = 0;
+
+/** Set up the per-desktop client lists. */
+void StartupDesktopLists(void)
+{
+   unsigned int x;
+   desktopListCount = settings.desktopCount + 1;
+   desktopLists = Allocate(sizeof(ClientNode*) * desktopListCount);
+   for(x = 0; x < desktopListCount; x++) {
+      desktopLists[x] = NULL;
+   }
+}
+
+/** Release the per-desktop client lists. */
+void ShutdownDesktopLists(void)
+{
+   if(desktopLists) {
+      Release(desktopLists);
+      desktopLists = NULL;
+   }
+   desktopListCount = 0;
+}
+
+/** Move a client to the desktop list matching its state. */
+void UpdateDesktopList(ClientNode *np)
+{
+   unsigned int list;
+
+   if(np->state.status & STAT_STICKY) {
+      list = desktopListCount;
+   } else if(np->state.desktop < desktopListCount - 1) {
+      list = np->state.desktop + 1;
+   } else {
+      list = 0;
+   }
+   if(list == np->desktopList) {
+      return;
+   }
+
+   RemoveDesktopList(np);
+   if(list > 0) {
+      np->desktopPrev = NULL;
+      np->desktopNext = desktopLists[list - 1];
+      if(np->desktopNext) {
+         np->desktopNext->desktopPrev = np;
+      }
+      desktopLists[list - 1] = np;
+      np->desktopList = list;
+   }
+}
+
+/** Remove a client from its desktop list. */
+void RemoveDesktopList(ClientNode *np)
+{
+   if(np->desktopList == 0) {
+      return;
+   }
+   if(np->desktopPrev) {
+      np->desktopPrev->desktopNext = np->desktopNext;
+   } else {
+      desktopLists[np->desktopList - 1] = np->desktopNext;
+   }
+   if(np->desktopNext) {
+      np->desktopNext->desktopPrev = np->desktopPrev;
+   }
+   np->desktopPrev = NULL;
+   np->desktopNext = NULL;
+   np->desktopList = 0;
+}
+
+/** Get the non-sticky clients on a desktop. */
+ClientNode *GetDesktopClients(unsigned int desktop)
+{
+   if(desktop + 1 < desktopListCount) {
+      return desktopLists[desktop];
+   } else {
+      return NULL;
+   }
+}
+
+/** Get the sticky clients. */
+ClientNode *GetStickyClients(void)
+{
+   return desktopListCount > 0 ? desktopLists[desktopListCount - 1] : NULL;
+}
+
+/** Index a client under its owner window. */
+void UpdateTransientList(ClientNode *np)
+{
+   ClientNode **lp;
+   ClientNode *prev;
+
+   if(np->owner == np->transientOwner) {
+      return;
+   }
+   RemoveTransientList(np);
+   if(np->owner == None || np->owner == np->window) {
+      return;
+   }
+
+   /* Append so that transients are kept in the order they appear. */
+   prev = NULL;
+   lp = &transientHash[np->owner & (TRANSIENT_HASH_SIZE - 1)];
+   while(*lp) {
+      prev = *lp;
+      lp = &prev->transientNext;
+   }
+   *lp = np;
+   np->transientPrev = prev;
+   np->transientNext = NULL;
+   np->transientOwner = np->owner;
+}
+
+/** Remove a client from the owner index. */
+void RemoveTransientList(ClientNode *np)
+{
+   if(np->transientOwner == None) {
+      return;
+   }
+   if(np->transientPrev) {
+      np->transientPrev->transientNext = np->transientNext;
+   } else {
+      const unsigned int index
+         = np->transientOwner & (TRANSIENT_HASH_SIZE - 1);
+      transientHash[index] = np->transientNext;
+   }
+   if(np->transientNext) {
+      np->transientNext->transientPrev = np->transientPrev;
+   }
+   np->transientPrev = NULL;
+   np->transientNext = NULL;
+   np->transientOwner = None;
+}
+
+/** Get the next transient of a client. */
+ClientNode *GetNextTransient(const ClientNode *np, ClientNode *tp)
+{
+   if(tp) {
+      tp = tp->transientNext;
+   } else {
+      tp = transientHash[np->window & (TRANSIENT_HASH_SIZE - 1)];
+   }
+   while(tp && tp->transientOwner != np->window) {
+      tp = tp->transientNext;
+   }
+   return tp;
+}
+
 /** Determine if a client is allowed focus. */
 char ShouldFocus(const ClientNode *np, char current)
 {
@@ -66,51 +225,23 @@ void StartWindowWalk(void)
 void StartWindowStackWalk(void)
 {
 
-   /* Get an image of the window stack.
-    * Here we get the Window IDs rather than client pointers so
-    * clients can be added/removed without disrupting the stack walk.
+   /* The walk is a cursor over the focus order. The order is frozen
+    * until the walk stops, so clients focused along the way keep their
+    * place and removed clients simply drop out of the walk.
     */
 
-   ClientNode *np;
-   int layer;
-   int count;
-
    /* If we are already walking the stack, just return. */
-   if(windowStack != NULL) {
+   if(walkingStack) {
       return;
    }
 
-   /* First determine how much space to allocate for windows. */
-   count = 0;
-   for(layer = LAST_LAYER; layer >= FIRST_LAYER; layer--) {
-      for(np = nodes[layer]; np; np = np->next) {
-         if(ShouldFocus(np, 1)) {
-            ++count;
-         }
-      }
-   }
-
-   /* If there were no windows to walk, don't even start. */
-   if(count == 0) {
+   /* If there are no windows to walk, don't even start. */
+   if(focusHead == NULL) {
       return;
    }
 
-   /* Allocate space for the windows. */
-   windowStack = Allocate(sizeof(Window) * count);
-
-   /* Copy windows into the array. */
-   windowStackSize = 0;
-   for(layer = LAST_LAYER; layer >= FIRST_LAYER; layer--) {
-      for(np = nodes[layer]; np; np = np->next) {
-         if(ShouldFocus(np, 1)) {
-            windowStack[windowStackSize++] = np->window;
-         }
-      }
-   }
-
-   Assert(windowStackSize == count);
-
-   windowStackCurrent = 0;
+   walkCurrent = focusHead;
+   walkingStack = 1;
 
    JXGrabKeyboard(display, rootWindow, False, GrabModeAsync,
                   GrabModeAsync, CurrentTime);
@@ -128,37 +259,34 @@ void WalkWindowStack(char forward)
 
    ClientNode *np;
 
-   if(windowStack != NULL) {
-      int x;
+   if(walkingStack) {
+      unsigned int x;
 
-      if(wasMinimized) {
-         np = FindClientByWindow(windowStack[windowStackCurrent]);
-         if(np) {
-            MinimizeClient(np, 1);
-         }
+      if(wasMinimized && walkCurrent) {
+         MinimizeClient(walkCurrent, 1);
       }
 
       /* Loop until we either raise a window or go through them all. */
-      for(x = 0; x < windowStackSize; x++) {
+      np = walkCurrent;
+      for(x = 0; x < clientCount; x++) {
 
          /* Move to the next/previous window (wrap if needed). */
          if(forward) {
-             windowStackCurrent = (windowStackCurrent + 1) % windowStackSize;
+            np = np ? np->focusNext : NULL;
+            if(np == NULL) {
+               np = focusHead;
+            }
          } else {
-             if(windowStackCurrent == 0) {
-                 windowStackCurrent = windowStackSize;
-             }
-             windowStackCurrent -= 1;
+            np = np ? np->focusPrev : NULL;
+            if(np == NULL) {
+               np = focusTail;
+            }
          }
 
-         /* Look up the window. */
-         np = FindClientByWindow(windowStack[windowStackCurrent]);
-
-         /* Skip this window if it no longer exists or is currently in
-          * a state that doesn't allow focus.
+         /* Skip this window if it is currently in a state that
+          * doesn't allow focus.
           */
-         if(np == NULL || !ShouldFocus(np, 1)
-            || (np->state.status & STAT_ACTIVE)) {
+         if(!ShouldFocus(np, 1) || (np->state.status & STAT_ACTIVE)) {
             continue;
          }
 
@@ -172,7 +300,9 @@ void WalkWindowStack(char forward)
             wasMinimized = 0;
          }
          JXRaiseWindow(display, np->parent ? np->parent : np->window);
+         InvalidateStack();
          FocusClient(np);
+         walkCurrent = np;
          break;
 
       }
@@ -187,25 +317,24 @@ void StopWindowWalk(void)
 
    ClientNode *np;
 
-   /* Raise the selected window and free the window array. */
-   if(windowStack != NULL) {
+   /* Raise the selected window and put it at the front of the
+    * focus order. */
+   if(walkingStack) {
 
-      /* Look up the current window. */
-      np = FindClientByWindow(windowStack[windowStackCurrent]);
+      np = walkCurrent;
+      walkCurrent = NULL;
+      walkingStack = 0;
       if(np) {
          if(np->state.status & STAT_MINIMIZED) {
             RestoreClient(np, 1);
          } else {
             RaiseClient(np);
          }
+         if(np->state.status & STAT_ACTIVE) {
+            UpdateFocusList(np);
+         }
       }
 
-      Release(windowStack);
-      windowStack = NULL;
-
-      windowStackSize = 0;
-      windowStackCurrent = 0;
-
    }
 
    if(walkingWindows) {
@@ -216,6 +345,51 @@ void StopWindowWalk(void)
 
 }
 
+/** Add a client to the front of the focus order. */
+void AddFocusList(ClientNode *np)
+{
+   np->focusPrev = NULL;
+   np->focusNext = focusHead;
+   if(focusHead) {
+      focusHead->focusPrev = np;
+   } else {
+      focusTail = np;
+   }
+   focusHead = np;
+}
+
+/** Remove a client from the focus order. */
+void RemoveFocusList(ClientNode *np)
+{
+   if(walkCurrent == np) {
+      /* Keep the walk going from the previous client. */
+      walkCurrent = np->focusPrev;
+      wasMinimized = 0;
+   }
+   if(np->focusPrev) {
+      np->focusPrev->focusNext = np->focusNext;
+   } else {
+      focusHead = np->focusNext;
+   }
+   if(np->focusNext) {
+      np->focusNext->focusPrev = np->focusPrev;
+   } else {
+      focusTail = np->focusPrev;
+   }
+   np->focusPrev = NULL;
+   np->focusNext = NULL;
+}
+
+/** Move a client to the front of the focus order. */
+void UpdateFocusList(ClientNode *np)
+{
+   if(walkingStack || focusHead == np) {
+      return;
+   }
+   RemoveFocusList(np);
+   AddFocusList(np);
+}
+
 /** Focus the next client in the stacking order. */
 void FocusNextStacked(ClientNode *np)
 {
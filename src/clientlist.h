@@ -20,6 +20,75 @@ extern struct ClientNode *nodes[LAYER_COUNT];
 /** Client windows in linked lists for each layer (pointer to the tail). */
 extern struct ClientNode *nodeTail[LAYER_COUNT];
 
+/** Set up the per-desktop client lists. */
+void StartupDesktopLists(void);
+
+/** Release the per-desktop client lists. */
+void ShutdownDesktopLists(void);
+
+/** Move a client to the desktop list matching its state.
+ * This must be called after changing the desktop or sticky status of
+ * a client that is in the layer lists.
+ * @param np The client.
+ */
+void UpdateDesktopList(struct ClientNode *np);
+
+/** Remove a client from its desktop list.
+ * @param np The client.
+ */
+void RemoveDesktopList(struct ClientNode *np);
+
+/** Get the non-sticky clients on a desktop.
+ * The list is linked with desktopNext and is not in stacking order.
+ * @param desktop The desktop.
+ * @return The first client or NULL.
+ */
+struct ClientNode *GetDesktopClients(unsigned int desktop);
+
+/** Get the sticky clients.
+ * The list is linked with desktopNext and is not in stacking order.
+ * @return The first client or NULL.
+ */
+struct ClientNode *GetStickyClients(void);
+
+/** Index a client under its owner window.
+ * This must be called after changing the owner of a client that is
+ * in the layer lists.
+ * @param np The client.
+ */
+void UpdateTransientList(struct ClientNode *np);
+
+/** Remove a client from the owner index.
+ * @param np The client.
+ */
+void RemoveTransientList(struct ClientNode *np);
+
+/** Get the next transient of a client.
+ * Transients are returned in the order they were indexed.
+ * @param np The owner.
+ * @param tp The previous transient (NULL for the first).
+ * @return The next transient or NULL.
+ */
+struct ClientNode *GetNextTransient(const struct ClientNode *np,
+                                    struct ClientNode *tp);
+
+/** Add a client to the front of the focus order.
+ * @param np The client.
+ */
+void AddFocusList(struct ClientNode *np);
+
+/** Remove a client from the focus order.
+ * @param np The client.
+ */
+void RemoveFocusList(struct ClientNode *np);
+
+/** Move a client to the front of the focus order.
+ * This must be called when a client is focused. The order does not
+ * change while walking the window stack.
+ * @param np The client.
+ */
+void UpdateFocusList(struct ClientNode *np);
+
 /** Determine if a client is on the current desktop.
  * @param np The client.
  * @return 1 if on the current desktop, 0 otherwise.
@@ -29,8 +29,12 @@ typedef struct ClockType {
 
    char *format;                 /**< The time format to use. */
    char *zone;                   /**< The time zone to use (NULL = local). */
+   unsigned int period;          /**< Seconds between changes of the time. */
    struct ActionNode *actions;   /**< Actions */
    TimeType lastTime;            /**< Currently displayed time. */
+   char *shown;                  /**< Currently displayed string. */
+   int textx;                    /**< Location of the displayed string. */
+   int textWidth;                /**< Width of the displayed string. */
 
    /* The following are used to control popups. */
    int mousex;                /**< Last mouse x-coordinate. */
@@ -38,6 +42,7 @@ typedef struct ClockType {
    TimeType mouseTime;        /**< Time of the last mouse motion. */
 
    int userWidth;             /**< User-specified clock width (or 0). */
+   char suspended;            /**< Set while the tray is not shown. */
 
    struct ClockType *next;    /**< Next clock in the list. */
 
@@ -51,6 +56,7 @@ static ClockType *clocks;
 static void Create(TrayComponentType *cp);
 static void Resize(TrayComponentType *cp);
 static void Destroy(TrayComponentType *cp);
+static void SetSuspended(TrayComponentType *cp, char suspended);
 static void ProcessClockButtonPress(TrayComponentType *cp,
                                     int x, int y, int button);
 static void ProcessClockButtonRelease(TrayComponentType *cp,
@@ -62,6 +68,8 @@ static void DrawClock(ClockType *clk, const TimeType *now);
 
 static void SignalClock(const struct TimeType *now, int x, int y, Window w,
                         void *data);
+static void ClockTimeout(const struct TimeType *now, int x, int y, Window w,
+                         void *data);
 
 
 /** Initialize clocks. */
@@ -96,12 +104,19 @@ void DestroyClock(void)
       if(clocks->zone) {
          Release(clocks->zone);
       }
+      if(clocks->shown) {
+         Release(clocks->shown);
+      }
       DestroyActions(clocks->actions);
-      UnregisterCallback(SignalClock, clocks);
+      if(!clocks->suspended) {
+         UnregisterCallback(SignalClock, clocks);
+      }
+      UnregisterTimeout(ClockTimeout, clocks);
 
       Release(clocks);
       clocks = cp;
    }
+   DestroyTimeZones();
 }
 
 /** Create a clock tray component. */
@@ -121,14 +136,17 @@ TrayComponentType *CreateClock(const char *format, const char *zone,
    clk->mouseTime.seconds = 0;
    clk->mouseTime.ms = 0;
    clk->userWidth = 0;
+   clk->suspended = 0;
 
    if(!format) {
       format = DEFAULT_FORMAT;
    }
    clk->format = CopyString(format);
    clk->zone = CopyString(zone);
+   clk->period = GetTimeStringPeriod(format);
    clk->actions = NULL;
    memset(&clk->lastTime, 0, sizeof(clk->lastTime));
+   clk->shown = NULL;
 
    cp = CreateTrayComponent();
    cp->object = clk;
@@ -145,11 +163,13 @@ TrayComponentType *CreateClock(const char *format, const char *zone,
    cp->Create = Create;
    cp->Resize = Resize;
    cp->Destroy = Destroy;
+   cp->SetSuspended = SetSuspended;
    cp->ProcessButtonPress = ProcessClockButtonPress;
    cp->ProcessButtonRelease = ProcessClockButtonRelease;
    cp->ProcessMotionEvent = ProcessClockMotionEvent;
 
    RegisterCallback(Min(900, settings.popupDelay / 2), SignalClock, clk);
+   RegisterTimeout(0, ClockTimeout, clk);
 
    return cp;
 }
@@ -166,8 +186,7 @@ void AddClockAction(TrayComponentType *cp,
 /** Initialize a clock tray component. */
 void Create(TrayComponentType *cp)
 {
-   cp->pixmap = JXCreatePixmap(display, rootWindow, cp->width, cp->height,
-                               rootDepth);
+   CreateTrayPixmap(cp);
 }
 
 /** Resize a clock tray component. */
@@ -183,14 +202,13 @@ void Resize(TrayComponentType *cp)
 
    Assert(clk);
 
-   if(cp->pixmap != None) {
-      JXFreePixmap(display, cp->pixmap);
-   }
-
-   cp->pixmap = JXCreatePixmap(display, rootWindow, cp->width, cp->height,
-                               rootDepth);
+   CreateTrayPixmap(cp);
 
    memset(&clk->lastTime, 0, sizeof(clk->lastTime));
+   if(clk->shown) {
+      Release(clk->shown);
+      clk->shown = NULL;
+   }
 
    GetCurrentTime(&now);
    DrawClock(clk, &now);
@@ -200,9 +218,27 @@ void Resize(TrayComponentType *cp)
 /** Destroy a clock tray component. */
 void Destroy(TrayComponentType *cp)
 {
+   ClockType *clk;
    Assert(cp);
-   if(cp->pixmap != None) {
-      JXFreePixmap(display, cp->pixmap);
+   clk = (ClockType*)cp->object;
+   ReleaseTrayPixmap(cp);
+   if(clk->shown) {
+      Release(clk->shown);
+      clk->shown = NULL;
+   }
+}
+
+/** Stop updating a clock while its tray is not shown. */
+void SetSuspended(TrayComponentType *cp, char suspended)
+{
+   ClockType *clk = (ClockType*)cp->object;
+   clk->suspended = suspended;
+   if(suspended) {
+      UnregisterCallback(SignalClock, clk);
+      UnregisterTimeout(ClockTimeout, clk);
+   } else {
+      RegisterCallback(Min(900, settings.popupDelay / 2), SignalClock, clk);
+      RegisterTimeout(0, ClockTimeout, clk);
    }
 }
 
@@ -229,14 +265,13 @@ void ProcessClockMotionEvent(TrayComponentType *cp,
    GetCurrentTime(&clk->mouseTime);
 }
 
-/** Update a clock tray component. */
+/** Show a popup for a clock tray component. */
 void SignalClock(const TimeType *now, int x, int y, Window w, void *data)
 {
 
    ClockType *cp = (ClockType*)data;
    const char *longTime;
 
-   DrawClock(cp, now);
    if(cp->cp->tray->window == w &&
       abs(cp->mousex - x) < settings.doubleClickDelta &&
       abs(cp->mousey - y) < settings.doubleClickDelta) {
@@ -248,6 +283,18 @@ void SignalClock(const TimeType *now, int x, int y, Window w, void *data)
 
 }
 
+/** Update a clock tray component.
+ * The next update is scheduled for when the displayed time changes.
+ */
+void ClockTimeout(const TimeType *now, int x, int y, Window w, void *data)
+{
+   ClockType *clk = (ClockType*)data;
+   const unsigned long elapsed = (now->seconds % clk->period) * 1000
+                               + now->ms;
+   DrawClock(clk, now);
+   RegisterTimeout(clk->period * 1000 - elapsed, ClockTimeout, clk);
+}
+
 /** Draw a clock tray component. */
 void DrawClock(ClockType *clk, const TimeType *now)
 {
@@ -256,43 +303,63 @@ void DrawClock(ClockType *clk, const TimeType *now)
    const char *timeString;
    int width;
    int rwidth;
+   int x;
 
    /* Only draw if the time changed. */
    if(now->seconds == clk->lastTime.seconds) {
       return;
    }
+   clk->lastTime = *now;
+
+   /* Only draw if the string changed. */
+   timeString = GetTimeString(clk->format, clk->zone);
+   if(clk->shown && !strcmp(clk->shown, timeString)) {
+      return;
+   }
 
    /* Clear the area. */
    cp = clk->cp;
    if(colors[COLOR_CLOCK_BG1] == colors[COLOR_CLOCK_BG2]) {
       JXSetForeground(display, rootGC, colors[COLOR_CLOCK_BG1]);
-      JXFillRectangle(display, cp->pixmap, rootGC, 0, 0,
-                      cp->width, cp->height);
+      JXFillRectangle(display, cp->pixmap, rootGC,
+                      cp->pixmapX, cp->pixmapY, cp->width, cp->height);
    } else {
       DrawHorizontalGradient(cp->pixmap, rootGC,
                              colors[COLOR_CLOCK_BG1], colors[COLOR_CLOCK_BG2],
-                             0, 0, cp->width, cp->height);
+                             cp->pixmapX, cp->pixmapY,
+                             cp->width, cp->height);
    }
 
    /* Determine if the clock is the right size. */
-   timeString = GetTimeString(clk->format, clk->zone);
    width = GetStringWidth(FONT_CLOCK, timeString);
    rwidth = width + 4;
    if(rwidth == clk->cp->requestedWidth || clk->userWidth) {
 
       /* Draw the clock. */
+      x = (cp->width - width) / 2;
       RenderString(cp->pixmap, FONT_CLOCK, COLOR_CLOCK_FG,
-                   (cp->width - width) / 2,
-                   (cp->height - GetStringHeight(FONT_CLOCK)) / 2,
+                   cp->pixmapX + x, cp->pixmapY
+                   + (cp->height - GetStringHeight(FONT_CLOCK)) / 2,
                    cp->width, timeString);
 
-      UpdateSpecificTray(clk->cp->tray, clk->cp);
+      /* Update only the columns covered by the old and new strings. */
+      if(clk->shown) {
+         const int x1 = Min(x, clk->textx);
+         const int x2 = Max(x + width, clk->textx + clk->textWidth);
+         UpdateTrayArea(cp->tray, cp, x1, 0, x2 - x1, cp->height);
+         Release(clk->shown);
+      } else {
+         UpdateSpecificTray(cp->tray, cp);
+      }
+      clk->shown = CopyString(timeString);
+      clk->textx = x;
+      clk->textWidth = width;
 
    } else {
 
       /* Wrong size. Resize. */
       clk->cp->requestedWidth = rwidth;
-      ResizeTray(clk->cp->tray);
+      ResizeTray(clk->cp);
 
    }
 
@@ -26,6 +26,9 @@ static unsigned long rgbColors[COLOR_COUNT];
 /* Map a linear 8-bit RGB space to pixel values. */
 static unsigned long *rgbToPixel;
 
+/* Set if rgbToPixel comes from a standard colormap we must not free. */
+static char rgbToPixelShared;
+
 /* Maximum number of colors to allocate for icons. */
 static const unsigned MAX_COLORS = 64;
 
@@ -160,6 +163,9 @@ static unsigned long GetRGBFromXColor(const XColor *c);
 
 static unsigned long GetDirectPixel(const XColor *c);
 static void GetMappedPixel(XColor *c);
+static unsigned short GetCubeComponent(unsigned long index,
+                                       unsigned shift);
+static void StartupColorCube(void);
 static void AllocateColor(ColorType type, XColor *c);
 
 static unsigned long ReadHex(const char *hex);
@@ -168,6 +174,8 @@ char ParseColorToRGB(const char *value, XColor *c);
 static void InitializeNames(void);
 
 static XColor GetXColorFromRGB(unsigned long rgb);
+static unsigned short GetPixelComponent(unsigned long pixel,
+                                        unsigned shift, unsigned bits);
 static void LightenColor(ColorType oldColor, ColorType newColor);
 static void DarkenColor(ColorType oldColor, ColorType newColor);
 
@@ -201,6 +209,7 @@ void StartupColors(void)
       alphaMask = 0;
       rgbToPixel = Allocate(sizeof(unsigned long) * MAX_COLORS);
       memset(rgbToPixel, 0xFF, sizeof(unsigned long) * MAX_COLORS);
+      StartupColorCube();
       break;
    }
 
@@ -268,7 +277,7 @@ void ShutdownColors(void)
 #endif
 
    if(rgbToPixel) {
-      for(x = 0; x < MAX_COLORS; x++) {
+      for(x = 0; x < MAX_COLORS && !rgbToPixelShared; x++) {
          if(rgbToPixel[x] != ULONG_MAX) {
             JXFreeColors(display, rootColormap, &rgbToPixel[x], 1, 0);
          }
@@ -424,6 +433,21 @@ unsigned long ReadHex(const char *hex)
    return value;
 }
 
+/** Get the layout of TrueColor pixels with 8-bit channels. */
+char GetPixelLayout(unsigned int *red, unsigned int *green,
+                    unsigned int *blue, unsigned long *alpha)
+{
+   if(rootVisual->class != TrueColor
+      || redBits != 8 || greenBits != 8 || blueBits != 8) {
+      return 0;
+   }
+   *red = redShift;
+   *green = greenShift;
+   *blue = blueShift;
+   *alpha = alphaMask;
+   return 1;
+}
+
 /** Compute the pixel value from RGB components. */
 unsigned long GetDirectPixel(const XColor *c)
 {
@@ -437,10 +461,11 @@ unsigned long GetDirectPixel(const XColor *c)
 void GetMappedPixel(XColor *c)
 {
    const unsigned long index = GetDirectPixel(c);
-   if(rgbToPixel[index] == ULONG_MAX) {
-      c->red   = (c->red   & 0xC000) | 0x0800;
-      c->green = (c->green & 0xC000) | 0x0800;
-      c->blue  = (c->blue  & 0xC000) | 0x0800;
+   if(JUNLIKELY(rgbToPixel[index] == ULONG_MAX)) {
+      /* The cube could not be allocated up front. */
+      c->red   = GetCubeComponent(index, redShift);
+      c->green = GetCubeComponent(index, greenShift);
+      c->blue  = GetCubeComponent(index, blueShift);
       JXAllocColor(display, rootColormap, c);
       rgbToPixel[index] = c->pixel;
    } else {
@@ -448,6 +473,74 @@ void GetMappedPixel(XColor *c)
    }
 }
 
+/** Get one channel (0-65535) of a color cube entry. */
+unsigned short GetCubeComponent(unsigned long index, unsigned shift)
+{
+   return (unsigned short)(((index >> shift) & 3) * 0x5555);
+}
+
+/** Fill the color cube used for icons on mapped visuals.
+ * A matching standard colormap is used if the server has one.
+ * Otherwise the cube is allocated with one request. If neither
+ * works, the cube is filled lazily by GetMappedPixel.
+ */
+void StartupColorCube(void)
+{
+   XStandardColormap *maps;
+   XColor cells[MAX_COLORS];
+   unsigned long pixels[MAX_COLORS];
+   unsigned long x;
+   int count;
+   int i;
+
+   rgbToPixelShared = 0;
+   if(JXGetRGBColormaps(display, rootWindow, &maps, &count,
+                        XA_RGB_DEFAULT_MAP)) {
+      for(i = 0; i < count; i++) {
+         const XStandardColormap *sp = &maps[i];
+         if(  sp->colormap != rootColormap
+            || sp->visualid != rootVisual->visualid
+            || sp->red_max == 0 || sp->green_max == 0
+            || sp->blue_max == 0) {
+            continue;
+         }
+         for(x = 0; x < MAX_COLORS; x++) {
+            const unsigned long red   = (x >> redShift  ) & 3;
+            const unsigned long green = (x >> greenShift) & 3;
+            const unsigned long blue  = (x >> blueShift ) & 3;
+            rgbToPixel[x] = sp->base_pixel
+               + ((red   * sp->red_max   + 1) / 3) * sp->red_mult
+               + ((green * sp->green_max + 1) / 3) * sp->green_mult
+               + ((blue  * sp->blue_max  + 1) / 3) * sp->blue_mult;
+         }
+         rgbToPixelShared = 1;
+         break;
+      }
+      JXFree(maps);
+      if(rgbToPixelShared) {
+         return;
+      }
+   }
+
+   /* Only dynamic visuals have writable cells. */
+   if(rootVisual->class != PseudoColor && rootVisual->class != GrayScale) {
+      return;
+   }
+   if(!JXAllocColorCells(display, rootColormap, False, NULL, 0,
+                         pixels, MAX_COLORS)) {
+      return;
+   }
+   for(x = 0; x < MAX_COLORS; x++) {
+      cells[x].pixel = pixels[x];
+      cells[x].red   = GetCubeComponent(x, redShift);
+      cells[x].green = GetCubeComponent(x, greenShift);
+      cells[x].blue  = GetCubeComponent(x, blueShift);
+      cells[x].flags = DoRed | DoGreen | DoBlue;
+      rgbToPixel[x] = pixels[x];
+   }
+   JXStoreColors(display, rootColormap, cells, MAX_COLORS);
+}
+
 /** Allocate a pixel from RGB components. */
 void AllocateColor(ColorType type, XColor *c)
 {
@@ -492,6 +585,58 @@ void GetColor(XColor *c)
    }
 }
 
+/** Get the RGB components of a pixel value.
+ * This avoids querying the server for colors that we allocated.
+ */
+void GetColorFromPixel(XColor *c)
+{
+   unsigned int x;
+
+   /* Use the requested value of configured colors. */
+   for(x = 0; x < COLOR_COUNT; x++) {
+      if(colors[x] == c->pixel && rgbColors[x] != ULONG_MAX) {
+         const unsigned long pixel = c->pixel;
+         *c = GetXColorFromRGB(rgbColors[x]);
+         c->pixel = pixel;
+         return;
+      }
+   }
+
+   switch(rootVisual->class) {
+   case DirectColor:
+   case TrueColor:
+      c->red = GetPixelComponent(c->pixel, redShift, redBits);
+      c->green = GetPixelComponent(c->pixel, greenShift, greenBits);
+      c->blue = GetPixelComponent(c->pixel, blueShift, blueBits);
+      c->flags = DoRed | DoGreen | DoBlue;
+      return;
+   default:
+      /* Pixels in the color cube don't need a round trip. */
+      for(x = 0; x < MAX_COLORS; x++) {
+         if(rgbToPixel[x] == c->pixel) {
+            c->red = GetCubeComponent(x, redShift);
+            c->green = GetCubeComponent(x, greenShift);
+            c->blue = GetCubeComponent(x, blueShift);
+            c->flags = DoRed | DoGreen | DoBlue;
+            return;
+         }
+      }
+      JXQueryColor(display, rootColormap, c);
+      return;
+   }
+}
+
+/** Scale one channel of a direct pixel to 0-65535. */
+unsigned short GetPixelComponent(unsigned long pixel,
+                                 unsigned shift, unsigned bits)
+{
+   const unsigned long mask = (1UL << bits) - 1;
+   if(JUNLIKELY(bits == 0)) {
+      return 0;
+   }
+   return (unsigned short)(((pixel >> shift) & mask) * 65535 / mask);
+}
+
 /** Get an XFT color for the specified component. */
 #ifdef USE_XFT
 XftColor *GetXftColor(ColorType type)
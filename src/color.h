@@ -105,6 +105,23 @@ char ParseColor(const char *value, XColor *c);
  */
 void GetColor(XColor *c);
 
+/** Get the red, green, and blue values of a color pixel.
+ * @param c The structure containing the pixel value.
+ */
+void GetColorFromPixel(XColor *c);
+
+/** Get the layout of TrueColor pixels with 8-bit channels.
+ * Pixels can then be packed as
+ * (red << *red) | (green << *green) | (blue << *blue) | *alpha.
+ * @param red Set to the shift of the red channel.
+ * @param green Set to the shift of the green channel.
+ * @param blue Set to the shift of the blue channel.
+ * @param alpha Set to the bits to set in every pixel.
+ * @return 1 if pixels can be packed this way, 0 otherwise.
+ */
+char GetPixelLayout(unsigned int *red, unsigned int *green,
+                    unsigned int *blue, unsigned long *alpha);
+
 #ifdef USE_XFT
 /** Get an XFT color.
  * @param type The color whose XFT color to get.
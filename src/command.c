@@ -13,22 +13,73 @@
 #include "main.h"
 #include "error.h"
 #include "timing.h"
+#include "trace.h"
+#include "event.h"
 
+#include <errno.h>
 #include <fcntl.h>
 
+#if defined(HAVE_SPAWN_H) && defined(HAVE_POSIX_SPAWN)
+#  define USE_POSIX_SPAWN
+#  include <spawn.h>
+extern char **environ;
+#  ifdef POSIX_SPAWN_SETSID
+#     define SPAWN_FLAGS POSIX_SPAWN_SETSID
+#  else
+#     define SPAWN_FLAGS POSIX_SPAWN_SETPGROUP
+#  endif
+#endif
+
+/** Characters that need the shell to run a command. */
+static const char SHELL_CHARS[] = "|&;<>()$`\\\"'*?[]#~{}!\n";
+
 /** Structure to represent a list of commands. */
 typedef struct CommandNode {
    char *command;             /**< The command. */
    struct CommandNode *next;  /**< The next command in the list. */
 } CommandNode;
 
+/** A process whose output is being read in the background. */
+typedef struct ProcessNode {
+   char *command;             /**< The command. */
+   char *buffer;              /**< Output read so far. */
+   unsigned length;           /**< Bytes of output read so far. */
+   unsigned capacity;         /**< Size of the buffer. */
+   unsigned timeout_ms;       /**< Timeout in milliseconds. */
+   char lines;                /**< Set to report each line as read. */
+   ProcessCallback callback;  /**< Callback to receive the output. */
+   void *data;                /**< Data to pass to the callback. */
+   pid_t pid;                 /**< Process ID. */
+   int fd;                    /**< Read end of the pipe. */
+   struct ProcessNode *next;  /**< The next process in the list. */
+} ProcessNode;
+
+/** Size of each read from a process. */
+#define BLOCK_SIZE 256
+
+/** Longest line reported by ReadLinesFromProcess. */
+#define MAX_LINE_LENGTH 1024
+
 static CommandNode *startupCommands = NULL;
 static CommandNode *shutdownCommands = NULL;
 static CommandNode *restartCommands = NULL;
+static ProcessNode *processes = NULL;
+static int preparedFd = -1;
 
 static void RunCommands(CommandNode *commands);
 static void ReleaseCommands(CommandNode **commands);
 static void AddCommand(CommandNode **commands, const char *command);
+static pid_t StartProcess(const char *command, int *fd);
+static void PrepareEnvironment(void);
+static char **SplitCommand(const char *command, char **buffer);
+static pid_t SpawnCommand(const char *command, int outFd);
+static void ProcessReadable(int fd, void *data);
+static void ProcessTimeout(const TimeType *now, int x, int y,
+                           Window w, void *data);
+static void FinishProcess(ProcessNode *np, char notify);
+static ProcessNode *CreateProcessNode(const char *command, pid_t pid, int fd,
+                                      ProcessCallback callback, void *data);
+static void ReportLine(ProcessNode *np, char final);
 
 /** Process startup/restart commands. */
 void StartupCommands(void)
@@ -54,6 +105,10 @@ void DestroyCommands(void)
    ReleaseCommands(&startupCommands);
    ReleaseCommands(&shutdownCommands);
    ReleaseCommands(&restartCommands);
+   while(processes) {
+      kill(processes->pid, SIGKILL);
+      FinishProcess(processes, 0);
+   }
 }
 
 /** Run the commands in a command list. */
@@ -117,69 +172,176 @@ void AddRestartCommand(const char *command) {
    AddCommand(&restartCommands, command);
 }
 
-/** Execute an external program. */
-void RunCommand(const char *command)
+/** Set up what started commands inherit.
+ * The X connection is closed on exec and DISPLAY is set to the display
+ * we are using. This is done once per connection.
+ */
+void PrepareEnvironment(void)
 {
-
    const char *displayString;
+   int fd;
 
-   if(JUNLIKELY(!command)) {
+   if(JUNLIKELY(!display)) {
       return;
    }
-
-   displayString = DisplayString(display);
-   if(!fork()) {
-      close(ConnectionNumber(display));
+   fd = ConnectionNumber(display);
+   if(JLIKELY(fd == preparedFd)) {
+      return;
+   }
+   fcntl(fd, F_SETFD, FD_CLOEXEC);
+   if(preparedFd == -1) {
+      displayString = DisplayString(display);
       if(displayString && displayString[0]) {
+         /* This stays in the environment for the life of the process. */
          const size_t var_len = strlen(displayString) + 9;
          char *str = malloc(var_len);
          snprintf(str, var_len, "DISPLAY=%s", displayString);
          putenv(str);
       }
-      setsid();
-      execl(SHELL_NAME, SHELL_NAME, "-c", command, NULL);
-      Warning(_("exec failed: (%s) %s"), SHELL_NAME, command);
-      exit(EXIT_SUCCESS);
    }
-
+   preparedFd = fd;
 }
 
-/** Reads the output of an exernal program. */
-char *ReadFromProcess(const char *command, unsigned timeout_ms)
+/** Split a command into arguments if it can be run without the shell.
+ * @param command The command.
+ * @param buffer Set to storage for the arguments.
+ * @return The arguments or NULL if the shell is needed.
+ */
+char **SplitCommand(const char *command, char **buffer)
 {
-   const unsigned BLOCK_SIZE = 256;
-   pid_t pid;
-   int fds[2];
+   const char *start;
+   char **argv;
+   char *ptr;
+   unsigned int count;
+   unsigned int x;
 
-   if(pipe(fds)) {
-      Warning(_("could not create pipe"));
+   if(command[strcspn(command, SHELL_CHARS)] != 0) {
       return NULL;
    }
-   if(fcntl(fds[0], F_SETFL, O_NONBLOCK) == -1) {
-      /* We don't return here since we can still process the output
-       * of the command, but the timeout won't work. */
-      Warning(_("could not set O_NONBLOCK"));
+
+   /* Count the arguments. */
+   count = 0;
+   for(x = 0; command[x]; x++) {
+      const char space = command[x] == ' ' || command[x] == '\t';
+      const char next = command[x + 1] == ' ' || command[x + 1] == '\t'
+                      || command[x + 1] == 0;
+      if(!space && next) {
+         count += 1;
+      }
+   }
+
+   /* Variable assignments need the shell. */
+   start = command + strspn(command, " \t");
+   if(count == 0 || memchr(start, '=', strcspn(start, " \t"))) {
+      return NULL;
+   }
+
+   *buffer = CopyString(command);
+   argv = Allocate(sizeof(char*) * (count + 1));
+   x = 0;
+   for(ptr = strtok(*buffer, " \t"); ptr; ptr = strtok(NULL, " \t")) {
+      argv[x++] = ptr;
    }
+   argv[x] = NULL;
+   return argv;
+}
 
+/** Start a command.
+ * @param command The command.
+ * @param outFd The descriptor for standard output (-1 to inherit).
+ * @return The process ID or -1 on error.
+ */
+pid_t SpawnCommand(const char *command, int outFd)
+{
+   char *buffer = NULL;
+   char **argv;
+   pid_t pid;
+
+   PrepareEnvironment();
+   argv = SplitCommand(command, &buffer);
+
+#ifdef USE_POSIX_SPAWN
+   {
+      posix_spawn_file_actions_t actions;
+      posix_spawnattr_t attr;
+      int rc;
+
+      posix_spawnattr_init(&attr);
+      posix_spawnattr_setflags(&attr, SPAWN_FLAGS);
+      posix_spawn_file_actions_init(&actions);
+      if(outFd >= 0) {
+         posix_spawn_file_actions_adddup2(&actions, outFd, 1);
+      }
+      if(argv) {
+         rc = posix_spawnp(&pid, argv[0], &actions, &attr, argv, environ);
+      } else {
+         char *shellArgv[4];
+         shellArgv[0] = (char*)SHELL_NAME;
+         shellArgv[1] = (char*)"-c";
+         shellArgv[2] = (char*)command;
+         shellArgv[3] = NULL;
+         rc = posix_spawn(&pid, SHELL_NAME, &actions, &attr,
+                          shellArgv, environ);
+      }
+      posix_spawn_file_actions_destroy(&actions);
+      posix_spawnattr_destroy(&attr);
+      if(rc != 0) {
+         Warning(_("exec failed: (%s) %s"), argv ? argv[0] : SHELL_NAME,
+                 command);
+         pid = -1;
+      }
+   }
+#else
    pid = fork();
    if(pid == 0) {
       /* The child process. */
       if(display) {
         close(ConnectionNumber(display));
       }
-      dup2(fds[1], 1);  /* stdout */
-      close(fds[0]);
-      close(fds[1]);
+      if(outFd >= 0) {
+         dup2(outFd, 1);  /* stdout */
+      }
       setsid();
-      execl(SHELL_NAME, SHELL_NAME, "-c", command, NULL);
-      Warning(_("exec failed: (%s) %s"), SHELL_NAME, command);
+      if(argv) {
+         execvp(argv[0], argv);
+      } else {
+         execl(SHELL_NAME, SHELL_NAME, "-c", command, NULL);
+      }
+      Warning(_("exec failed: (%s) %s"), argv ? argv[0] : SHELL_NAME,
+              command);
       exit(EXIT_SUCCESS);
-   } else if(pid > 0) {
+   }
+#endif
+
+   if(argv) {
+      Release(argv);
+      Release(buffer);
+   }
+   return pid;
+}
+
+/** Execute an external program. */
+void RunCommand(const char *command)
+{
+   if(JUNLIKELY(!command)) {
+      return;
+   }
+   SpawnCommand(command, -1);
+}
+
+/** Reads the output of an exernal program. */
+char *ReadFromProcess(const char *command, unsigned timeout_ms)
+{
+   const TraceTime traceStart = StartTrace();
+   pid_t pid;
+   int fd;
+
+   pid = StartProcess(command, &fd);
+   if(pid > 0) {
       char *buffer;
       unsigned buffer_size, max_size;
       TimeType start_time, current_time;
 
-      close(fds[1]);
       max_size = BLOCK_SIZE;
       buffer_size = 0;
       buffer = Allocate(max_size);
@@ -189,10 +351,10 @@ char *ReadFromProcess(const char *command, unsigned timeout_ms)
          struct timeval tv;
          unsigned long diff_ms;
          fd_set fs;
-         int rc, got_read;
+         int rc;
 
          FD_ZERO(&fs);
-         FD_SET(fds[0], &fs);
+         FD_SET(fd, &fs);
 
          /* Determine the max time to sit in select. */
          GetCurrentTime(&current_time);
@@ -202,9 +364,18 @@ char *ReadFromProcess(const char *command, unsigned timeout_ms)
          tv.tv_usec = (diff_ms % 1000) * 1000;
 
          /* Wait for data (or a timeout). */
-         rc = select(fds[0] + 1, &fs, NULL, &fs, &tv);
-         if(rc == 0) {
-            close(fds[0]);
+         rc = select(fd + 1, &fs, NULL, &fs, &tv);
+         if(rc < 0 && errno == EINTR) {
+            /* Interrupted by a signal (such as the watchdog timer). */
+            continue;
+         } else if(rc < 0) {
+            close(fd);
+            Warning(_("could not read the output of %s"), command);
+            kill(pid, SIGKILL);
+            waitpid(pid, NULL, 0);
+            break;
+         } else if(rc == 0) {
+            close(fd);
             /* Timeout */
             Warning(_("timeout: %s did not complete in %u milliseconds"),
                     command, timeout_ms);
@@ -213,27 +384,231 @@ char *ReadFromProcess(const char *command, unsigned timeout_ms)
             break;
          }
 
-         got_read = 0;
          do {
            /* Make sure we have room to read. */
            if(buffer_size + BLOCK_SIZE > max_size) {
               max_size *= 2;
               buffer = Reallocate(buffer, max_size);
            }
-           rc = read(fds[0], &buffer[buffer_size], BLOCK_SIZE);
+           rc = read(fd, &buffer[buffer_size], BLOCK_SIZE);
            buffer_size += (rc > 0) ? rc : 0;
-           got_read = got_read || rc > 0;
          } while(rc > 0);
-         if(!got_read) {
-            /* Process exited */
-            close(fds[0]);
+         if(rc == 0 || (errno != EAGAIN && errno != EINTR)) {
+            /* Process exited (or the pipe failed). */
+            close(fd);
             break;
          }
       }
-      close(fds[1]);
       buffer[buffer_size] = 0;
+      RecordTrace("ReadFromProcess", -1, traceStart);
       return buffer;
    }
 
+   RecordTrace("ReadFromProcess", -1, traceStart);
    return NULL;
 }
+
+/** Start a process with its output connected to a pipe. */
+pid_t StartProcess(const char *command, int *fd)
+{
+   pid_t pid;
+   int fds[2];
+
+   if(pipe(fds)) {
+      Warning(_("could not create pipe"));
+      return -1;
+   }
+   if(fcntl(fds[0], F_SETFL, O_NONBLOCK) == -1) {
+      /* We don't return here since we can still process the output
+       * of the command, but the timeout won't work. */
+      Warning(_("could not set O_NONBLOCK"));
+   }
+
+   /* Keep the pipe out of other processes; dup2 clears this for the
+    * standard output of the child. */
+   fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+   fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+
+   pid = SpawnCommand(command, fds[1]);
+
+   close(fds[1]);
+   if(pid < 0) {
+      close(fds[0]);
+      return -1;
+   }
+   *fd = fds[0];
+   return pid;
+}
+
+/** Start reading output from a process in the background. */
+void ReadFromProcessAsync(const char *command, unsigned timeout_ms,
+                          ProcessCallback callback, void *data)
+{
+   ProcessNode *np;
+   int fd;
+   const pid_t pid = StartProcess(command, &fd);
+   if(pid < 0) {
+      (callback)(NULL, data);
+      return;
+   }
+
+   np = CreateProcessNode(command, pid, fd, callback, data);
+   np->timeout_ms = timeout_ms;
+   RegisterFileWatch(fd, ProcessReadable, np);
+   RegisterTimeout(timeout_ms, ProcessTimeout, np);
+}
+
+/** Start reading lines from a long-lived process in the background. */
+void ReadLinesFromProcess(const char *command,
+                          ProcessCallback callback, void *data)
+{
+   ProcessNode *np;
+   int fd;
+   const pid_t pid = StartProcess(command, &fd);
+   if(pid < 0) {
+      (callback)(NULL, data);
+      return;
+   }
+   np = CreateProcessNode(command, pid, fd, callback, data);
+   np->lines = 1;
+   RegisterFileWatch(fd, ProcessReadable, np);
+}
+
+/** Create the record for a process read in the background. */
+ProcessNode *CreateProcessNode(const char *command, pid_t pid, int fd,
+                               ProcessCallback callback, void *data)
+{
+   ProcessNode *np = Allocate(sizeof(ProcessNode));
+   np->command = CopyString(command);
+   np->callback = callback;
+   np->data = data;
+   np->pid = pid;
+   np->fd = fd;
+   np->timeout_ms = 0;
+   np->lines = 0;
+   np->capacity = BLOCK_SIZE;
+   np->length = 0;
+   np->buffer = Allocate(np->capacity);
+   np->next = processes;
+   processes = np;
+   return np;
+}
+
+/** Cancel a background read started with ReadFromProcessAsync. */
+void CancelReadFromProcess(ProcessCallback callback, void *data)
+{
+   ProcessNode *np;
+   for(np = processes; np; np = np->next) {
+      if(np->callback == callback && np->data == data) {
+         kill(np->pid, SIGKILL);
+         FinishProcess(np, 0);
+         return;
+      }
+   }
+}
+
+/** Read available output from a background process. */
+void ProcessReadable(int fd, void *data)
+{
+   ProcessNode *np = (ProcessNode*)data;
+   for(;;) {
+      int rc;
+      if(np->length + BLOCK_SIZE >= np->capacity) {
+         np->capacity *= 2;
+         np->buffer = Reallocate(np->buffer, np->capacity);
+      }
+      rc = read(fd, &np->buffer[np->length], BLOCK_SIZE);
+      if(rc > 0) {
+         np->length += rc;
+         if(np->lines) {
+            /* One read per wakeup so a chatty process cannot hold
+             * up the event loop. */
+            ReportLine(np, 0);
+            return;
+         }
+      } else if(rc < 0 && (errno == EAGAIN || errno == EINTR)) {
+         return;
+      } else {
+         /* Process exited (or the pipe failed). */
+         if(np->lines) {
+            ReportLine(np, 1);
+         }
+         FinishProcess(np, 1);
+         return;
+      }
+   }
+}
+
+/** Pass the last complete line read from a process to its callback.
+ * Earlier lines in the same read are dropped since they would be
+ * replaced right away. A line without a newline is passed once the
+ * process exits or the line gets too long.
+ */
+void ReportLine(ProcessNode *np, char final)
+{
+   unsigned end;
+   unsigned start;
+
+   end = np->length;
+   while(end > 0 && np->buffer[end - 1] != '\n') {
+      end -= 1;
+   }
+   if(end == 0) {
+      if(np->length == 0 || (!final && np->length < MAX_LINE_LENGTH)) {
+         return;
+      }
+      np->buffer[np->length] = 0;
+      np->length = 0;
+      (np->callback)(np->buffer, np->data);
+      return;
+   }
+
+   np->buffer[end - 1] = 0;
+   start = end - 1;
+   while(start > 0 && np->buffer[start - 1] != '\n') {
+      start -= 1;
+   }
+   (np->callback)(&np->buffer[start], np->data);
+
+   /* Keep the start of the next line. */
+   np->length -= end;
+   memmove(np->buffer, &np->buffer[end], np->length);
+   if(final) {
+      ReportLine(np, 1);
+   }
+}
+
+/** Kill a background process that did not complete in time. */
+void ProcessTimeout(const TimeType *now, int x, int y, Window w, void *data)
+{
+   ProcessNode *np = (ProcessNode*)data;
+   Warning(_("timeout: %s did not complete in %u milliseconds"),
+           np->command, np->timeout_ms);
+   kill(np->pid, SIGKILL);
+   np->length = 0;
+   FinishProcess(np, 1);
+}
+
+/** Remove a background process and optionally report its output. */
+void FinishProcess(ProcessNode *np, char notify)
+{
+   ProcessNode **pp;
+   for(pp = &processes; *pp; pp = &(*pp)->next) {
+      if(*pp == np) {
+         *pp = np->next;
+         break;
+      }
+   }
+   UnregisterFileWatch(np->fd);
+   UnregisterTimeout(ProcessTimeout, np);
+   close(np->fd);
+   if(notify && np->lines) {
+      (np->callback)(NULL, np->data);
+   } else if(notify) {
+      np->buffer[np->length] = 0;
+      (np->callback)(np->length > 0 ? np->buffer : NULL, np->data);
+   }
+   Release(np->command);
+   Release(np->buffer);
+   Release(np);
+}
@@ -44,5 +44,40 @@ void RunCommand(const char *command);
  */
 char *ReadFromProcess(const char *command, unsigned timeout_ms);
 
+/** Callback to receive output from ReadFromProcessAsync.
+ * @param output The output (NULL on failure or timeout).
+ * @param data The data passed to ReadFromProcessAsync.
+ */
+typedef void (*ProcessCallback)(const char *output, void *data);
+
+/** Read output from a process without blocking.
+ * The callback runs from the event loop once the process exits.
+ * @param command The command to run (run in sh).
+ * @param timeout_ms The timeout in milliseconds.
+ * @param callback The callback to receive the output.
+ * @param data Data to pass to the callback.
+ */
+void ReadFromProcessAsync(const char *command, unsigned timeout_ms,
+                          ProcessCallback callback, void *data);
+
+/** Read lines from a long-lived process without blocking.
+ * The callback runs from the event loop with the last complete line
+ * (without the newline) each time the process writes, and with NULL
+ * once the process exits. The callback must not cancel the read.
+ * @param command The command to run (run in sh).
+ * @param callback The callback to receive the lines.
+ * @param data Data to pass to the callback.
+ */
+void ReadLinesFromProcess(const char *command,
+                          ProcessCallback callback, void *data);
+
+/** Cancel a read started with ReadFromProcessAsync or
+ * ReadLinesFromProcess.
+ * The process is killed and the callback does not run.
+ * @param callback The callback passed to ReadFromProcessAsync.
+ * @param data The data passed to ReadFromProcessAsync.
+ */
+void CancelReadFromProcess(ProcessCallback callback, void *data);
+
 #endif /* COMMAND_H */
 
@@ -0,0 +1,339 @@
+/**
+ * @file configcache.c
+ * @author Joe Wingbermuehle
+ * @date 2026
+ *
+ * @brief Cache of tokenized configuration files.
+ *
+ * The cache holds the token tree of each configuration file, keyed by
+ * the path and status of the file. It is mapped in one piece and the
+ * strings of cached tokens point into the mapping.
+ *
+ */
+
+#include "jwm.h"
+
+#ifdef USE_CONFIG_CACHE
+
+#include "configcache.h"
+#include "lex.h"
+#include "misc.h"
+#include "error.h"
+
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+
+/** Magic number and format of the cache file. */
+static const char CACHE_MAGIC[8] = { 'J', 'W', 'M', 'C', 'A', 'C', 'H', 'E' };
+#define CACHE_FORMAT 2
+
+/** Alignment of records in the cache file. */
+#define CACHE_ALIGNMENT 8
+
+/** Round a size up to the cache alignment. */
+#define CacheAlign( x ) \
+   (((x) + CACHE_ALIGNMENT - 1) & ~((size_t)CACHE_ALIGNMENT - 1))
+
+/** Header of the cache file. */
+typedef struct CacheHeader {
+   char magic[8];                /**< CACHE_MAGIC. */
+   unsigned int format;          /**< CACHE_FORMAT. */
+   unsigned int count;           /**< Number of entries. */
+   unsigned int tokens;          /**< GetTokenSignature(). */
+   unsigned int reserved;        /**< Zero. */
+   char version[16];             /**< PACKAGE_VERSION. */
+} CacheHeader;
+
+/** Status of a cached file.
+ * A cached entry is only used if all of these match.
+ */
+typedef struct CacheKey {
+   unsigned long long mtime;     /**< Modification time. */
+   unsigned long long ctime;     /**< Status change time. */
+   unsigned long long size;      /**< Size in bytes. */
+   unsigned long long inode;     /**< Inode number. */
+   unsigned int pathSize;        /**< Size of the path (padded). */
+   unsigned int dataSize;        /**< Size of the tokens. */
+} CacheKey;
+
+/** A cached file. */
+typedef struct CacheEntry {
+   CacheKey key;                 /**< Status of the file. */
+   char *path;                   /**< Expanded path of the file. */
+   char *data;                   /**< Serialized tokens. */
+   size_t size;                  /**< Size of the serialized tokens. */
+   char owned;                   /**< Set if path and data are allocated. */
+   char used;                    /**< Set if the entry was looked up. */
+   struct CacheEntry *next;      /**< The next entry. */
+} CacheEntry;
+
+static char *cachePath = NULL;
+static char *cacheData = NULL;
+static size_t cacheSize = 0;
+static CacheEntry *entries = NULL;
+static char cacheChanged = 0;
+
+static void ReadCacheEntries(void);
+static void WriteCache(void);
+static void WritePadded(FILE *fd, const void *data, size_t size);
+static void GetCacheKey(const struct stat *sbuf, CacheKey *key);
+static void ReleaseEntry(CacheEntry *ep);
+
+/** Open the cache for a configuration file. */
+void OpenConfigCache(const char *fileName)
+{
+   struct stat sbuf;
+   char *path;
+   int fd;
+
+   Assert(!cachePath);
+
+   path = CopyString(fileName);
+   ExpandPath(&path);
+   cachePath = Allocate(strlen(path) + 7);
+   sprintf(cachePath, "%s.cache", path);
+   Release(path);
+
+   cacheChanged = 0;
+   fd = open(cachePath, O_RDONLY);
+   if(fd < 0) {
+      return;
+   }
+   if(fstat(fd, &sbuf) == 0 && sbuf.st_size > (off_t)sizeof(CacheHeader)) {
+      cacheData = mmap(NULL, sbuf.st_size, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE, fd, 0);
+      if(cacheData != MAP_FAILED) {
+         cacheSize = sbuf.st_size;
+         ReadCacheEntries();
+      } else {
+         cacheData = NULL;
+      }
+   }
+   close(fd);
+}
+
+/** Read the entries from a mapped cache file. */
+void ReadCacheEntries(void)
+{
+   CacheHeader header;
+   CacheEntry **last;
+   size_t offset;
+   unsigned int x;
+
+   memcpy(&header, cacheData, sizeof(header));
+   if(memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC))
+      || header.format != CACHE_FORMAT
+      || header.tokens != GetTokenSignature()
+      || strncmp(header.version, PACKAGE_VERSION, sizeof(header.version))) {
+      Debug("ignoring config cache %s: wrong version", cachePath);
+      cacheChanged = 1;
+      return;
+   }
+
+   last = &entries;
+   offset = CacheAlign(sizeof(header));
+   for(x = 0; x < header.count; x++) {
+      CacheEntry *ep;
+      CacheKey key;
+      if(offset + sizeof(key) > cacheSize) {
+         break;
+      }
+      memcpy(&key, &cacheData[offset], sizeof(key));
+      offset += CacheAlign(sizeof(key));
+      if(key.pathSize == 0 || key.pathSize > cacheSize - offset
+         || CacheAlign(key.dataSize) > cacheSize - offset - key.pathSize
+         || cacheData[offset + key.pathSize - 1] != 0) {
+         break;
+      }
+      ep = Allocate(sizeof(CacheEntry));
+      ep->key = key;
+      ep->path = &cacheData[offset];
+      ep->data = &cacheData[offset + key.pathSize];
+      ep->size = key.dataSize;
+      ep->owned = 0;
+      ep->used = 0;
+      ep->next = NULL;
+      *last = ep;
+      last = &ep->next;
+      offset += key.pathSize + CacheAlign(key.dataSize);
+   }
+   if(JUNLIKELY(x < header.count)) {
+      Debug("config cache %s is truncated", cachePath);
+      cacheChanged = 1;
+   }
+}
+
+/** Close the cache, writing it if anything changed. */
+void CloseConfigCache(void)
+{
+   CacheEntry *ep;
+
+   if(!cachePath) {
+      return;
+   }
+
+   /* Drop files that are no longer included. */
+   for(ep = entries; ep; ep = ep->next) {
+      cacheChanged |= !ep->used;
+   }
+   if(cacheChanged) {
+      WriteCache();
+   }
+
+   while(entries) {
+      ep = entries->next;
+      ReleaseEntry(entries);
+      entries = ep;
+   }
+   if(cacheData) {
+      munmap(cacheData, cacheSize);
+      cacheData = NULL;
+      cacheSize = 0;
+   }
+   Release(cachePath);
+   cachePath = NULL;
+}
+
+/** Write the entries that were used to the cache file. */
+void WriteCache(void)
+{
+   CacheHeader header;
+   CacheEntry *ep;
+   char *tempPath;
+   FILE *fd;
+   char ok;
+
+   memset(&header, 0, sizeof(header));
+   memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+   header.format = CACHE_FORMAT;
+   header.tokens = GetTokenSignature();
+   strncpy(header.version, PACKAGE_VERSION, sizeof(header.version));
+   for(ep = entries; ep; ep = ep->next) {
+      header.count += ep->used;
+   }
+
+   /* Write to a temporary file so that readers never see a partial
+    * cache. The cache is optional, so failures are not reported. */
+   tempPath = Allocate(strlen(cachePath) + 5);
+   sprintf(tempPath, "%s.tmp", cachePath);
+   fd = fopen(tempPath, "wb");
+   if(!fd) {
+      Debug("could not write config cache %s", tempPath);
+      Release(tempPath);
+      return;
+   }
+
+   WritePadded(fd, &header, sizeof(header));
+   for(ep = entries; ep; ep = ep->next) {
+      if(ep->used) {
+         const size_t pathLen = strlen(ep->path) + 1;
+         ep->key.pathSize = CacheAlign(pathLen);
+         ep->key.dataSize = ep->size;
+         WritePadded(fd, &ep->key, sizeof(ep->key));
+         WritePadded(fd, ep->path, pathLen);
+         WritePadded(fd, ep->data, ep->size);
+      }
+   }
+   ok = !ferror(fd);
+   ok = (fclose(fd) == 0) && ok;
+
+   if(!ok || rename(tempPath, cachePath)) {
+      Debug("could not write config cache %s", cachePath);
+      unlink(tempPath);
+   }
+   Release(tempPath);
+}
+
+/** Write a record padded to the cache alignment. */
+void WritePadded(FILE *fd, const void *data, size_t size)
+{
+   static const char padding[CACHE_ALIGNMENT] = { 0 };
+   if(size > 0) {
+      fwrite(data, size, 1, fd);
+   }
+   if(CacheAlign(size) > size) {
+      fwrite(padding, CacheAlign(size) - size, 1, fd);
+   }
+}
+
+/** Get cached tokens for a file. */
+TokenNode *GetCachedTokens(const char *path, const struct stat *sbuf,
+                           const char *fileName)
+{
+   CacheKey key;
+   CacheEntry *ep;
+
+   if(!cachePath) {
+      return NULL;
+   }
+
+   GetCacheKey(sbuf, &key);
+   for(ep = entries; ep; ep = ep->next) {
+      if(!strcmp(ep->path, path)) {
+         TokenNode *tokens;
+         if(  ep->key.mtime != key.mtime || ep->key.ctime != key.ctime
+            || ep->key.size != key.size || ep->key.inode != key.inode) {
+            return NULL;
+         }
+         tokens = DeserializeTokens(ep->data, ep->size, fileName);
+         ep->used = tokens != NULL;
+         return tokens;
+      }
+   }
+   return NULL;
+}
+
+/** Add the tokens for a file to the cache. */
+void CacheTokens(const char *path, const struct stat *sbuf,
+                 const TokenNode *tokens)
+{
+   CacheEntry **epp;
+   CacheEntry *ep;
+
+   if(!cachePath) {
+      return;
+   }
+
+   /* Remove the out-of-date entry. */
+   for(epp = &entries; *epp; epp = &(*epp)->next) {
+      if(!strcmp((*epp)->path, path)) {
+         ep = *epp;
+         *epp = ep->next;
+         ReleaseEntry(ep);
+         break;
+      }
+   }
+
+   ep = Allocate(sizeof(CacheEntry));
+   GetCacheKey(sbuf, &ep->key);
+   ep->path = CopyString(path);
+   ep->data = SerializeTokens(tokens, &ep->size);
+   ep->owned = 1;
+   ep->used = 1;
+   ep->next = entries;
+   entries = ep;
+   cacheChanged = 1;
+}
+
+/** Get the key for a file. */
+void GetCacheKey(const struct stat *sbuf, CacheKey *key)
+{
+   memset(key, 0, sizeof(CacheKey));
+   key->mtime = (unsigned long long)sbuf->st_mtime;
+   key->ctime = (unsigned long long)sbuf->st_ctime;
+   key->size = (unsigned long long)sbuf->st_size;
+   key->inode = (unsigned long long)sbuf->st_ino;
+}
+
+/** Release a cache entry. */
+void ReleaseEntry(CacheEntry *ep)
+{
+   if(ep->owned) {
+      Release(ep->path);
+      Release(ep->data);
+   }
+   Release(ep);
+}
+
+#endif /* USE_CONFIG_CACHE */
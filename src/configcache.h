@@ -0,0 +1,55 @@
+/**
+ * @file configcache.h
+ * @author Joe Wingbermuehle
+ * @date 2026
+ *
+ * @brief Cache of tokenized configuration files.
+ *
+ */
+
+#ifndef CONFIGCACHE_H
+#define CONFIGCACHE_H
+
+struct stat;
+struct TokenNode;
+
+#ifdef USE_CONFIG_CACHE
+
+/** Open the cache for a configuration file.
+ * The cache is stored next to the file with a ".cache" suffix and
+ * holds the tokens of the file and of every file it includes.
+ * @param fileName The top-level configuration file.
+ */
+void OpenConfigCache(const char *fileName);
+
+/** Close the cache, writing it if anything changed. */
+void CloseConfigCache(void);
+
+/** Get cached tokens for a file.
+ * @param path The expanded path of the file.
+ * @param sbuf The status of the file.
+ * @param fileName The name of the file for error reporting.
+ * @return The tokens (NULL if not cached or out of date).
+ */
+struct TokenNode *GetCachedTokens(const char *path,
+                                  const struct stat *sbuf,
+                                  const char *fileName);
+
+/** Add the tokens for a file to the cache.
+ * @param path The expanded path of the file.
+ * @param sbuf The status of the file.
+ * @param tokens The tokens read from the file.
+ */
+void CacheTokens(const char *path, const struct stat *sbuf,
+                 const struct TokenNode *tokens);
+
+#else
+
+#define OpenConfigCache( f )        ((void)0)
+#define CloseConfigCache()          ((void)0)
+#define GetCachedTokens( p, s, f )  NULL
+#define CacheTokens( p, s, t )      ((void)0)
+
+#endif /* USE_CONFIG_CACHE */
+
+#endif /* CONFIGCACHE_H */
@@ -17,6 +17,8 @@
 #include "misc.h"
 #include "settings.h"
 #include "binding.h"
+#include "expose.h"
+#include "winpool.h"
 
 #ifndef DISABLE_CONFIRM
 
@@ -122,7 +124,9 @@ char HandleDialogExpose(const XExposeEvent *event)
 {
    Assert(event);
    if(dialog && dialog->node->window == event->window) {
-      ExposeConfirmDialog();
+      CopyExposedArea(dialog->pmap, dialog->node->window,
+                      GetExposeRegion(event->window),
+                      dialog->width, dialog->height);
       return 1;
    } else {
       return 0;
@@ -286,9 +290,7 @@ void ShowConfirmDialog(ClientNode *np, void (*action)(ClientNode*), ...)
    ComputeDimensions(np);
 
    /* Create the pixmap used for rendering. */
-   dialog->pmap = JXCreatePixmap(display, rootWindow,
-                                 dialog->width, dialog->height,
-                                 rootDepth);
+   dialog->pmap = AcquirePoolPixmap(dialog->width, dialog->height);
 
    /* Create the window. */
    attrs.background_pixel = colors[COLOR_MENU_BG];
@@ -349,7 +351,7 @@ void DestroyConfirmDialog(void)
    RemoveClient(dialog->node);
 
    /* Free the pixmap. */
-   JXFreePixmap(display, dialog->pmap);
+   ReleasePoolPixmap(dialog->pmap);
 
    /* Free the message. */
    for(x = 0; x < dialog->lineCount; x++) {
@@ -0,0 +1,756 @@
+/**
+ * @file control.c
+ * @author Joe Wingbermuehle
+ * @date 2026
+ *
+ * @brief Local control socket.
+ *
+ * Clients connect to a Unix-domain socket and send commands, one per
+ * line. A batch of commands ends with an empty line or when the client
+ * stops sending. Every command in a batch answers with its output
+ * followed by "ok" or "error: reason" and the reply to the batch ends
+ * with an empty line. Since the batch is applied from a single callback,
+ * clients are restacked once after the whole batch.
+ *
+ */
+
+#include "jwm.h"
+
+#ifdef USE_CONTROL
+
+#include "control.h"
+#include "client.h"
+#include "clientlist.h"
+#include "border.h"
+#include "desktop.h"
+#include "error.h"
+#include "event.h"
+#include "main.h"
+#include "misc.h"
+#include "place.h"
+#include "settings.h"
+#include "stats.h"
+#include "trace.h"
+#include "tray.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#ifndef MSG_NOSIGNAL
+#  define MSG_NOSIGNAL 0
+#endif
+
+/** Number of bytes to read at a time. */
+#define CONTROL_BLOCK_SIZE 1024
+
+/** Largest batch accepted from a client. */
+#define CONTROL_MAX_INPUT (64 * 1024)
+
+/** Milliseconds to wait before retrying a blocked reply. */
+#define CONTROL_RETRY 10
+
+/** Maximum number of arguments to a command. */
+#define CONTROL_MAX_ARGS 6
+
+/** A connection to the control socket. */
+typedef struct ControlConnection {
+   int fd;
+   char closing;           /**< 1 once the client has stopped sending. */
+   TextBuffer input;
+   TextBuffer output;
+   struct ControlConnection *next;
+} ControlConnection;
+
+/** Function to run a command.
+ * @param output The reply.
+ * @param argv The arguments (NULL terminated).
+ * @return NULL on success or a description of the error.
+ */
+typedef const char *(*ControlFunc)(TextBuffer *output, char **argv);
+
+/** A control command. */
+typedef struct ControlCommand {
+   const char *name;
+   unsigned int minArgs;
+   unsigned int maxArgs;
+   ControlFunc func;
+} ControlCommand;
+
+static int controlFd = -1;
+static char *controlPath = NULL;
+static ControlConnection *connections = NULL;
+
+static char *GetControlPath(const char *displayName);
+static void AcceptControl(int fd, void *data);
+static void ReadControl(int fd, void *data);
+static void FlushControl(ControlConnection *cp);
+static void FlushTimeout(const TimeType *now, int x, int y, Window w,
+                         void *data);
+static void CloseControl(ControlConnection *cp);
+static void ProcessInput(ControlConnection *cp);
+static void RunBatch(TextBuffer *output, char *batch);
+static void RunCommand(TextBuffer *output, char *line);
+static void AppendQuoted(TextBuffer *buffer, const char *str);
+static ClientNode *ParseClient(const char *arg);
+static char ParseInt(const char *arg, int *value);
+static void PrepareClient(ClientNode *np);
+static void UpdateClient(ClientNode *np);
+
+static const char *ControlClients(TextBuffer *output, char **argv);
+static const char *ControlTrays(TextBuffer *output, char **argv);
+static const char *ControlStats(TextBuffer *output, char **argv);
+static const char *ControlTrace(TextBuffer *output, char **argv);
+static const char *ControlDesktop(TextBuffer *output, char **argv);
+static const char *ControlMove(TextBuffer *output, char **argv);
+static const char *ControlResize(TextBuffer *output, char **argv);
+static const char *ControlFocus(TextBuffer *output, char **argv);
+static const char *ControlRaise(TextBuffer *output, char **argv);
+static const char *ControlSend(TextBuffer *output, char **argv);
+static const char *ControlClose(TextBuffer *output, char **argv);
+
+static const ControlCommand COMMANDS[] = {
+   { "clients",   0, 0, ControlClients },
+   { "close",     1, 1, ControlClose   },
+   { "desktop",   0, 1, ControlDesktop },
+   { "focus",     1, 1, ControlFocus   },
+   { "move",      3, 3, ControlMove    },
+   { "raise",     1, 1, ControlRaise   },
+   { "resize",    3, 3, ControlResize  },
+   { "send",      2, 2, ControlSend    },
+   { "stats",     0, 0, ControlStats   },
+   { "trace",     0, 0, ControlTrace   },
+   { "trays",     0, 0, ControlTrays   }
+};
+static const unsigned int COMMAND_COUNT = ARRAY_LENGTH(COMMANDS);
+
+/** Get the path of the control socket for a display. */
+char *GetControlPath(const char *displayName)
+{
+   const char *dir;
+   char *path;
+   size_t len;
+   size_t x;
+
+   if(!displayName) {
+      displayName = getenv("DISPLAY");
+   }
+   if(!displayName) {
+      displayName = "";
+   }
+
+   dir = getenv("XDG_RUNTIME_DIR");
+   len = strlen(displayName) + 64;
+   if(dir && dir[0]) {
+      len += strlen(dir);
+      path = Allocate(len);
+      snprintf(path, len, "%s/jwm-", dir);
+   } else {
+      path = Allocate(len);
+      snprintf(path, len, "/tmp/jwm-%u-", (unsigned int)getuid());
+   }
+
+   /* The display name may contain a host name; keep it in one file. */
+   x = strlen(path);
+   while(*displayName) {
+      path[x++] = *displayName == '/' ? '_' : *displayName;
+      displayName += 1;
+   }
+   path[x] = 0;
+   return path;
+}
+
+/** Start listening on the control socket. */
+void StartupControl(void)
+{
+   struct sockaddr_un addr;
+   mode_t mask;
+   int rc;
+
+   controlPath = GetControlPath(DisplayString(display));
+   if(JUNLIKELY(strlen(controlPath) >= sizeof(addr.sun_path))) {
+      Warning(_("control socket path too long: %s"), controlPath);
+      Release(controlPath);
+      controlPath = NULL;
+      return;
+   }
+
+   controlFd = socket(AF_UNIX, SOCK_STREAM, 0);
+   if(JUNLIKELY(controlFd < 0)) {
+      Warning(_("could not create control socket: %s"), strerror(errno));
+      Release(controlPath);
+      controlPath = NULL;
+      return;
+   }
+
+   memset(&addr, 0, sizeof(addr));
+   addr.sun_family = AF_UNIX;
+   strcpy(addr.sun_path, controlPath);
+
+   /* Only the owner may connect. Another JWM cannot be managing this
+    * display, so a socket left behind is stale. */
+   unlink(controlPath);
+   mask = umask(077);
+   rc = bind(controlFd, (struct sockaddr*)&addr, sizeof(addr));
+   umask(mask);
+   if(JUNLIKELY(rc < 0 || listen(controlFd, 4) < 0)) {
+      Warning(_("could not listen on %s: %s"), controlPath, strerror(errno));
+      close(controlFd);
+      controlFd = -1;
+      Release(controlPath);
+      controlPath = NULL;
+      return;
+   }
+
+   fcntl(controlFd, F_SETFL, fcntl(controlFd, F_GETFL) | O_NONBLOCK);
+   fcntl(controlFd, F_SETFD, FD_CLOEXEC);
+   RegisterFileWatch(controlFd, AcceptControl, NULL);
+}
+
+/** Close the control socket and all connections. */
+void ShutdownControl(void)
+{
+   while(connections) {
+      CloseControl(connections);
+   }
+   if(controlFd >= 0) {
+      UnregisterFileWatch(controlFd);
+      close(controlFd);
+      controlFd = -1;
+   }
+   if(controlPath) {
+      unlink(controlPath);
+      Release(controlPath);
+      controlPath = NULL;
+   }
+}
+
+/** Accept new connections. */
+void AcceptControl(int fd, void *data)
+{
+   for(;;) {
+      ControlConnection *cp;
+      const int cfd = accept(fd, NULL, NULL);
+      if(cfd < 0) {
+         return;
+      }
+      fcntl(cfd, F_SETFL, fcntl(cfd, F_GETFL) | O_NONBLOCK);
+      fcntl(cfd, F_SETFD, FD_CLOEXEC);
+
+      cp = Allocate(sizeof(ControlConnection));
+      memset(cp, 0, sizeof(ControlConnection));
+      cp->fd = cfd;
+      InitializeTextBuffer(&cp->input, CONTROL_BLOCK_SIZE + 1);
+      InitializeTextBuffer(&cp->output, CONTROL_BLOCK_SIZE);
+      cp->next = connections;
+      connections = cp;
+      RegisterFileWatch(cfd, ReadControl, cp);
+   }
+}
+
+/** Read commands from a connection. */
+void ReadControl(int fd, void *data)
+{
+   ControlConnection *cp = (ControlConnection*)data;
+   for(;;) {
+      ssize_t rc;
+      if(cp->input.length + CONTROL_BLOCK_SIZE + 1 > cp->input.capacity) {
+         cp->input.capacity *= 2;
+         cp->input.data = Reallocate(cp->input.data, cp->input.capacity);
+      }
+      rc = read(fd, &cp->input.data[cp->input.length], CONTROL_BLOCK_SIZE);
+      if(rc > 0) {
+         cp->input.length += rc;
+         if(JUNLIKELY(cp->input.length > CONTROL_MAX_INPUT)) {
+            AppendText(&cp->output, "error: request too large\n\n");
+            cp->input.length = 0;
+            cp->closing = 1;
+            break;
+         }
+      } else if(rc < 0 && (errno == EAGAIN || errno == EINTR)) {
+         break;
+      } else {
+         cp->closing = 1;
+         break;
+      }
+   }
+   cp->input.data[cp->input.length] = 0;
+
+   ProcessInput(cp);
+   if(cp->closing) {
+      UnregisterFileWatch(cp->fd);
+   }
+   FlushControl(cp);
+}
+
+/** Run the complete batches received on a connection. */
+void ProcessInput(ControlConnection *cp)
+{
+   char *batch = cp->input.data;
+   char *line = batch;
+   for(;;) {
+      char *end = strchr(line, '\n');
+      if(end && (end == line || (end == line + 1 && *line == '\r'))) {
+         /* An empty line ends the batch. */
+         *line = 0;
+         if(*batch) {
+            RunBatch(&cp->output, batch);
+         }
+         batch = end + 1;
+         line = batch;
+      } else if(end) {
+         line = end + 1;
+      } else {
+         break;
+      }
+   }
+   if(cp->closing) {
+      if(*batch) {
+         RunBatch(&cp->output, batch);
+      }
+      batch += strlen(batch);
+   }
+   cp->input.length -= batch - cp->input.data;
+   memmove(cp->input.data, batch, cp->input.length + 1);
+}
+
+/** Run a batch of commands. */
+void RunBatch(TextBuffer *output, char *batch)
+{
+   while(*batch) {
+      char *end = strchr(batch, '\n');
+      if(end) {
+         *end = 0;
+         RunCommand(output, batch);
+         batch = end + 1;
+      } else {
+         RunCommand(output, batch);
+         break;
+      }
+   }
+   AppendText(output, "\n");
+}
+
+/** Run a single command. */
+void RunCommand(TextBuffer *output, char *line)
+{
+   char *argv[CONTROL_MAX_ARGS + 2];
+   const char *error;
+   unsigned int argc;
+   unsigned int x;
+
+   argc = 0;
+   for(;;) {
+      while(*line == ' ' || *line == '\t' || *line == '\r') {
+         line += 1;
+      }
+      if(*line == 0) {
+         break;
+      }
+      if(argc == CONTROL_MAX_ARGS + 1) {
+         AppendText(output, "error: too many arguments\n");
+         return;
+      }
+      argv[argc++] = line;
+      while(*line && *line != ' ' && *line != '\t' && *line != '\r') {
+         line += 1;
+      }
+      if(*line) {
+         *line++ = 0;
+      }
+   }
+   argv[argc] = NULL;
+   if(argc == 0) {
+      AppendText(output, "error: empty command\n");
+      return;
+   }
+
+   error = "unknown command";
+   for(x = 0; x < COMMAND_COUNT; x++) {
+      if(!strcmp(argv[0], COMMANDS[x].name)) {
+         if(  argc - 1 < COMMANDS[x].minArgs
+            || argc - 1 > COMMANDS[x].maxArgs) {
+            error = "wrong number of arguments";
+         } else {
+            error = (COMMANDS[x].func)(output, &argv[1]);
+         }
+         break;
+      }
+   }
+   if(error) {
+      AppendText(output, "error: %s: %s\n", argv[0], error);
+   } else {
+      AppendText(output, "ok\n");
+   }
+}
+
+/** Write as much of the reply as possible. */
+void FlushControl(ControlConnection *cp)
+{
+   size_t offset = 0;
+   while(offset < cp->output.length) {
+      const ssize_t rc = send(cp->fd, &cp->output.data[offset],
+                              cp->output.length - offset, MSG_NOSIGNAL);
+      if(rc > 0) {
+         offset += rc;
+      } else if(rc < 0 && errno == EINTR) {
+         continue;
+      } else if(rc < 0 && errno == EAGAIN) {
+         break;
+      } else {
+         CloseControl(cp);
+         return;
+      }
+   }
+   cp->output.length -= offset;
+   memmove(cp->output.data, &cp->output.data[offset], cp->output.length);
+
+   if(cp->output.length > 0) {
+      RegisterTimeout(CONTROL_RETRY, FlushTimeout, cp);
+   } else if(cp->closing) {
+      CloseControl(cp);
+   }
+}
+
+/** Retry a reply that did not fit in the socket buffer. */
+void FlushTimeout(const TimeType *now, int x, int y, Window w, void *data)
+{
+   FlushControl((ControlConnection*)data);
+}
+
+/** Close a connection. */
+void CloseControl(ControlConnection *cp)
+{
+   ControlConnection **cpp;
+   for(cpp = &connections; *cpp; cpp = &(*cpp)->next) {
+      if(*cpp == cp) {
+         *cpp = cp->next;
+         break;
+      }
+   }
+   UnregisterFileWatch(cp->fd);
+   UnregisterTimeout(FlushTimeout, cp);
+   close(cp->fd);
+   Release(cp->input.data);
+   Release(cp->output.data);
+   Release(cp);
+}
+
+/** Append a quoted string to a reply. */
+void AppendQuoted(TextBuffer *buffer, const char *str)
+{
+   AppendText(buffer, "\"");
+   if(str) {
+      while(*str) {
+         switch(*str) {
+         case '"':
+         case '\\':
+            AppendText(buffer, "\\%c", *str);
+            break;
+         case '\n':
+            AppendText(buffer, "\\n");
+            break;
+         default:
+            AppendText(buffer, "%c", *str);
+            break;
+         }
+         str += 1;
+      }
+   }
+   AppendText(buffer, "\"");
+}
+
+/** Find the client for a window argument. */
+ClientNode *ParseClient(const char *arg)
+{
+   char *end;
+   const unsigned long w = strtoul(arg, &end, 0);
+   if(*end || w == None) {
+      return NULL;
+   }
+   return FindClient((Window)w);
+}
+
+/** Parse an integer argument. */
+char ParseInt(const char *arg, int *value)
+{
+   char *end;
+   *value = (int)strtol(arg, &end, 10);
+   return *arg && !*end;
+}
+
+/** Prepare to move or resize a client. */
+void PrepareClient(ClientNode *np)
+{
+   if(np->controller) {
+      (np->controller)(0);
+   }
+   if(JUNLIKELY(np->state.status & STAT_FULLSCREEN)) {
+      SetClientFullScreen(np, 0);
+   }
+   if(JUNLIKELY(np->state.maxFlags)) {
+      MaximizeClient(np, MAX_NONE);
+   }
+}
+
+/** Apply the new geometry of a client. */
+void UpdateClient(ClientNode *np)
+{
+   ResetBorder(np);
+   SendConfigureEvent(np);
+   RequirePagerUpdate();
+}
+
+/** List clients from top to bottom. */
+const char *ControlClients(TextBuffer *output, char **argv)
+{
+   static const struct {
+      unsigned int flag;
+      const char *name;
+   } STATES[] = {
+      { STAT_ACTIVE,       "active"       },
+      { STAT_HIDDEN,       "hidden"       },
+      { STAT_MINIMIZED,    "minimized"    },
+      { STAT_SHADED,       "shaded"       },
+      { STAT_FULLSCREEN,   "fullscreen"   },
+      { STAT_URGENT,       "urgent"       }
+   };
+   ClientNode *np;
+   int layer;
+
+   for(layer = LAYER_COUNT - 1; layer >= 0; layer--) {
+      for(np = nodes[layer]; np; np = np->next) {
+         const char *sep = "";
+         unsigned int x;
+         AppendText(output,
+                    "client window=0x%lx frame=0x%lx x=%d y=%d "
+                    "width=%d height=%d desktop=%d layer=%d state=",
+                    (unsigned long)np->window, (unsigned long)np->parent,
+                    np->x, np->y, np->width, np->height,
+                    (np->state.status & STAT_STICKY)
+                       ? -1 : (int)np->state.desktop, layer);
+         for(x = 0; x < ARRAY_LENGTH(STATES); x++) {
+            if(np->state.status & STATES[x].flag) {
+               AppendText(output, "%s%s", sep, STATES[x].name);
+               sep = ",";
+            }
+         }
+         if(np->state.maxFlags) {
+            AppendText(output, "%smaximized", sep);
+            sep = ",";
+         }
+         AppendText(output, "%s name=", *sep ? "" : "none");
+         AppendQuoted(output, np->name);
+         AppendText(output, " class=");
+         AppendQuoted(output, np->className);
+         AppendText(output, " instance=");
+         AppendQuoted(output, np->instanceName);
+         AppendText(output, "\n");
+      }
+   }
+   return NULL;
+}
+
+/** List trays. */
+const char *ControlTrays(TextBuffer *output, char **argv)
+{
+   TrayType *tp;
+   for(tp = GetTrays(); tp; tp = tp->next) {
+      AppendText(output,
+                 "tray window=0x%lx x=%d y=%d width=%d height=%d "
+                 "layer=%d hidden=%d\n",
+                 (unsigned long)tp->window, tp->x, tp->y,
+                 tp->width, tp->height, (int)tp->layer, tp->hidden);
+   }
+   return NULL;
+}
+
+/** Show run-time statistics. */
+const char *ControlStats(TextBuffer *output, char **argv)
+{
+#ifdef USE_STATS
+   char *report = GetStatsReport();
+   AppendText(output, "%s", report);
+   Release(report);
+   return NULL;
+#else
+   return "statistics are not available";
+#endif
+}
+
+/** Show the recorded trace spans. */
+const char *ControlTrace(TextBuffer *output, char **argv)
+{
+#ifdef USE_TRACE
+   char *report = GetTraceReport();
+   AppendText(output, "%s", report);
+   Release(report);
+   return NULL;
+#else
+   return "tracing is not available";
+#endif
+}
+
+/** Show or change the current desktop. */
+const char *ControlDesktop(TextBuffer *output, char **argv)
+{
+   int desktop;
+   if(!argv[0]) {
+      AppendText(output, "desktop current=%u count=%u\n",
+                 currentDesktop, settings.desktopCount);
+      return NULL;
+   }
+   if(  !ParseInt(argv[0], &desktop)
+      || desktop < 0 || desktop >= (int)settings.desktopCount) {
+      return "invalid desktop";
+   }
+   ChangeDesktop((unsigned int)desktop);
+   return NULL;
+}
+
+/** Move a client window to a location. */
+const char *ControlMove(TextBuffer *output, char **argv)
+{
+   ClientNode *np = ParseClient(argv[0]);
+   int x, y;
+   if(!np) {
+      return "no such client";
+   }
+   if(!ParseInt(argv[1], &x) || !ParseInt(argv[2], &y)) {
+      return "invalid location";
+   }
+   PrepareClient(np);
+   np->x = x;
+   np->y = y;
+   UpdateClient(np);
+   return NULL;
+}
+
+/** Resize a client window. */
+const char *ControlResize(TextBuffer *output, char **argv)
+{
+   ClientNode *np = ParseClient(argv[0]);
+   int width, height;
+   if(!np) {
+      return "no such client";
+   }
+   if(  !ParseInt(argv[1], &width) || !ParseInt(argv[2], &height)
+      || width <= 0 || height <= 0) {
+      return "invalid size";
+   }
+   PrepareClient(np);
+   np->width = width;
+   np->height = height;
+   ConstrainSize(np);
+   UpdateClient(np);
+   return NULL;
+}
+
+/** Focus a client. */
+const char *ControlFocus(TextBuffer *output, char **argv)
+{
+   ClientNode *np = ParseClient(argv[0]);
+   if(!np) {
+      return "no such client";
+   }
+   RestoreClient(np, 1);
+   UnshadeClient(np);
+   FocusClient(np);
+   return NULL;
+}
+
+/** Raise a client. */
+const char *ControlRaise(TextBuffer *output, char **argv)
+{
+   ClientNode *np = ParseClient(argv[0]);
+   if(!np) {
+      return "no such client";
+   }
+   RaiseClient(np);
+   return NULL;
+}
+
+/** Send a client to a desktop (-1 for all desktops). */
+const char *ControlSend(TextBuffer *output, char **argv)
+{
+   ClientNode *np = ParseClient(argv[0]);
+   int desktop;
+   if(!np) {
+      return "no such client";
+   }
+   if(  !ParseInt(argv[1], &desktop)
+      || desktop < -1 || desktop >= (int)settings.desktopCount) {
+      return "invalid desktop";
+   }
+   if(desktop < 0) {
+      SetClientSticky(np, 1);
+   } else {
+      if(np->controller) {
+         (np->controller)(0);
+      }
+      np->state.status &= ~STAT_STICKY;
+      UpdateDesktopList(np);
+      SetClientDesktop(np, (unsigned int)desktop);
+   }
+   return NULL;
+}
+
+/** Ask a client to close. */
+const char *ControlClose(TextBuffer *output, char **argv)
+{
+   ClientNode *np = ParseClient(argv[0]);
+   if(!np) {
+      return "no such client";
+   }
+   DeleteClient(np);
+   return NULL;
+}
+
+/** Send commands read from standard input to a running JWM. */
+int RunControlClient(const char *displayName)
+{
+   struct sockaddr_un addr;
+   char buffer[CONTROL_BLOCK_SIZE];
+   char *path;
+   ssize_t rc;
+   int fd;
+
+   path = GetControlPath(displayName);
+   memset(&addr, 0, sizeof(addr));
+   addr.sun_family = AF_UNIX;
+   strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+
+   fd = socket(AF_UNIX, SOCK_STREAM, 0);
+   if(fd < 0 || connect(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+      printf("error: could not connect to %s: %s\n", path, strerror(errno));
+      if(fd >= 0) {
+         close(fd);
+      }
+      Release(path);
+      return 1;
+   }
+   Release(path);
+
+   while((rc = read(0, buffer, sizeof(buffer))) > 0) {
+      ssize_t offset = 0;
+      while(offset < rc) {
+         const ssize_t written = send(fd, &buffer[offset], rc - offset,
+                                      MSG_NOSIGNAL);
+         if(written <= 0) {
+            close(fd);
+            return 1;
+         }
+         offset += written;
+      }
+   }
+   shutdown(fd, SHUT_WR);
+
+   while((rc = read(fd, buffer, sizeof(buffer))) > 0) {
+      fwrite(buffer, 1, rc, stdout);
+   }
+   close(fd);
+   return 0;
+}
+
+#endif /* USE_CONTROL */
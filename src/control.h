@@ -0,0 +1,35 @@
+/**
+ * @file control.h
+ * @author Joe Wingbermuehle
+ * @date 2026
+ *
+ * @brief Local control socket.
+ *
+ */
+
+#ifndef CONTROL_H
+#define CONTROL_H
+
+#ifdef USE_CONTROL
+
+/** Start listening on the control socket. */
+void StartupControl(void);
+
+/** Close the control socket and all connections. */
+void ShutdownControl(void);
+
+/** Send commands read from standard input to a running JWM.
+ * The replies are written to standard output.
+ * @param displayName The display (NULL for the default).
+ * @return The exit status.
+ */
+int RunControlClient(const char *displayName);
+
+#else
+
+#define StartupControl()         ((void)0)
+#define ShutdownControl()        ((void)0)
+
+#endif /* USE_CONTROL */
+
+#endif /* CONTROL_H */
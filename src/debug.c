@@ -10,6 +10,7 @@
 #include "debug.h"
 #include <stdarg.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 /** Emit a message (if compiled with -DDEBUG). */
@@ -28,19 +29,300 @@ void Debug(const char *str, ...)
 #endif /* DEBUG */
 }
 
+#if defined(DEBUG) || defined(PROFILE_MEMORY)
+
+/** One in this many allocations is recorded by the profiler.
+ * Debug builds record every allocation to find leaks.
+ */
 #ifdef DEBUG
+#  define MEMORY_SAMPLE_RATE 1
+#else
+#  define MEMORY_SAMPLE_RATE 64
+#endif
 
-#define CHECKPOINT_LIST_SIZE 8
+/** Allocations made from one source line. */
+typedef struct AllocationSite {
+   const char *file;       /**< Source file (NULL for an empty slot). */
+   unsigned int line;      /**< Source line. */
+   unsigned long count;    /**< Live allocations. */
+   unsigned long total;    /**< Allocations made. */
+   size_t bytes;           /**< Live bytes. */
+   size_t peak;            /**< Most live bytes seen. */
+} AllocationSite;
 
+/** A live allocation. */
 typedef struct MemoryType {
-   const char *file;
-   unsigned int line;
+   AllocationSite *site;
    size_t size;
    char *pointer;
-   struct MemoryType *next;
+   struct MemoryType *next;   /**< Next allocation in the hash bucket. */
 } MemoryType;
 
-static MemoryType *allocations = NULL;
+static AllocationSite *allocationSites = NULL;
+static unsigned int allocationSiteSize = 0;
+static unsigned int allocationSiteCount = 0;
+
+/** Live allocations hashed by pointer. */
+static MemoryType **memoryTable = NULL;
+static size_t memoryTableSize = 0;
+static size_t memoryCount = 0;
+static size_t memoryBytes = 0;
+static size_t memoryPeak = 0;
+
+static unsigned int GetSiteHash(const char *file, unsigned int line);
+static AllocationSite *GetAllocationSite(const char *file,
+                                         unsigned int line);
+static size_t GetMemoryHash(const void *pointer);
+static void InsertMemory(MemoryType *mp);
+static MemoryType *RemoveMemory(const void *pointer);
+static void TrackMemory(MemoryType *mp, AllocationSite *site, size_t size);
+static void UntrackMemory(MemoryType *mp);
+static int CompareAllocationSites(const void *a, const void *b);
+
+/** Hash a call site.
+ * File names are string literals, so they are keyed by pointer.
+ */
+unsigned int GetSiteHash(const char *file, unsigned int line)
+{
+   return (unsigned int)(((size_t)file >> 3) * 31 + line)
+        & (allocationSiteSize - 1);
+}
+
+/** Get the counters for a call site. */
+AllocationSite *GetAllocationSite(const char *file, unsigned int line)
+{
+   unsigned int index;
+   if(allocationSiteCount * 2 >= allocationSiteSize) {
+      AllocationSite *old = allocationSites;
+      const unsigned int oldSize = allocationSiteSize;
+      unsigned int x;
+      allocationSiteSize = oldSize ? oldSize * 2 : 512;
+      allocationSites = calloc(allocationSiteSize, sizeof(AllocationSite));
+      Assert(allocationSites);
+      for(x = 0; x < oldSize; x++) {
+         if(old[x].file) {
+            index = GetSiteHash(old[x].file, old[x].line);
+            while(allocationSites[index].file) {
+               index = (index + 1) & (allocationSiteSize - 1);
+            }
+            allocationSites[index] = old[x];
+         }
+      }
+      free(old);
+   }
+
+   index = GetSiteHash(file, line);
+   while(allocationSites[index].file) {
+      AllocationSite *sp = &allocationSites[index];
+      if(sp->file == file && sp->line == line) {
+         return sp;
+      }
+      index = (index + 1) & (allocationSiteSize - 1);
+   }
+   allocationSites[index].file = file;
+   allocationSites[index].line = line;
+   allocationSiteCount += 1;
+   return &allocationSites[index];
+}
+
+/** Hash a pointer. */
+size_t GetMemoryHash(const void *pointer)
+{
+   return (((size_t)pointer >> 4) * 2654435761UL) & (memoryTableSize - 1);
+}
+
+/** Add a live allocation to the table. */
+void InsertMemory(MemoryType *mp)
+{
+   size_t index;
+   if(memoryCount >= memoryTableSize) {
+      MemoryType **old = memoryTable;
+      const size_t oldSize = memoryTableSize;
+      size_t x;
+      memoryTableSize = oldSize ? oldSize * 2 : 1024;
+      memoryTable = calloc(memoryTableSize, sizeof(MemoryType*));
+      Assert(memoryTable);
+      for(x = 0; x < oldSize; x++) {
+         while(old[x]) {
+            MemoryType *next = old[x]->next;
+            index = GetMemoryHash(old[x]->pointer);
+            old[x]->next = memoryTable[index];
+            memoryTable[index] = old[x];
+            old[x] = next;
+         }
+      }
+      free(old);
+   }
+   index = GetMemoryHash(mp->pointer);
+   mp->next = memoryTable[index];
+   memoryTable[index] = mp;
+   memoryCount += 1;
+}
+
+/** Remove a live allocation from the table.
+ * @return The allocation or NULL if the pointer is not in the table.
+ */
+MemoryType *RemoveMemory(const void *pointer)
+{
+   MemoryType **mpp;
+   if(memoryCount == 0) {
+      return NULL;
+   }
+   for(mpp = &memoryTable[GetMemoryHash(pointer)]; *mpp;
+       mpp = &(*mpp)->next) {
+      if((*mpp)->pointer == pointer) {
+         MemoryType *mp = *mpp;
+         *mpp = mp->next;
+         memoryCount -= 1;
+         return mp;
+      }
+   }
+   return NULL;
+}
+
+/** Attribute an allocation to a call site. */
+void TrackMemory(MemoryType *mp, AllocationSite *site, size_t size)
+{
+   mp->site = site;
+   mp->size = size;
+   site->count += 1;
+   site->total += 1;
+   site->bytes += size;
+   if(site->bytes > site->peak) {
+      site->peak = site->bytes;
+   }
+   memoryBytes += size;
+   if(memoryBytes > memoryPeak) {
+      memoryPeak = memoryBytes;
+   }
+}
+
+/** Remove an allocation from its call site. */
+void UntrackMemory(MemoryType *mp)
+{
+   mp->site->count -= 1;
+   mp->site->bytes -= mp->size;
+   memoryBytes -= mp->size;
+}
+
+/** Sort call sites by live bytes, then by peak bytes. */
+int CompareAllocationSites(const void *a, const void *b)
+{
+   const AllocationSite *sa = (const AllocationSite*)a;
+   const AllocationSite *sb = (const AllocationSite*)b;
+   if(sa->bytes != sb->bytes) {
+      return sa->bytes > sb->bytes ? -1 : 1;
+   } else if(sa->peak != sb->peak) {
+      return sa->peak > sb->peak ? -1 : 1;
+   } else {
+      return sa->line < sb->line ? -1 : (sa->line > sb->line);
+   }
+}
+
+/** Get a report of live allocations by call site. */
+char *DEBUG_GetAllocationReport(void)
+{
+   AllocationSite *sites;
+   unsigned int x, count;
+   size_t len, capacity;
+   char *report;
+
+   sites = malloc((allocationSiteCount + 1) * sizeof(AllocationSite));
+   Assert(sites);
+   count = 0;
+   capacity = 128;
+   for(x = 0; x < allocationSiteSize; x++) {
+      if(allocationSites[x].file) {
+         sites[count++] = allocationSites[x];
+         capacity += strlen(allocationSites[x].file) + 128;
+      }
+   }
+   qsort(sites, count, sizeof(AllocationSite), CompareAllocationSites);
+
+   report = malloc(capacity);
+   Assert(report);
+   len = snprintf(report, capacity,
+                  "memory count=%lu bytes=%lu peak_bytes=%lu "
+                  "sample_rate=%u\n",
+                  (unsigned long)memoryCount, (unsigned long)memoryBytes,
+                  (unsigned long)memoryPeak, MEMORY_SAMPLE_RATE);
+   for(x = 0; x < count; x++) {
+      len += snprintf(&report[len], capacity - len,
+                      "allocation_site %s:%u count=%lu bytes=%lu "
+                      "peak_bytes=%lu total=%lu\n",
+                      sites[x].file, sites[x].line, sites[x].count,
+                      (unsigned long)sites[x].bytes,
+                      (unsigned long)sites[x].peak, sites[x].total);
+   }
+   free(sites);
+   return report;
+}
+
+#endif /* DEBUG || PROFILE_MEMORY */
+
+#if defined(PROFILE_MEMORY) && !defined(DEBUG)
+
+static unsigned int sampleCountdown = MEMORY_SAMPLE_RATE;
+
+/** Allocate memory, recording one allocation in MEMORY_SAMPLE_RATE. */
+void *PROFILE_Allocate(size_t size, const char *file, unsigned int line)
+{
+   void *ptr = malloc(size);
+   sampleCountdown -= 1;
+   if(sampleCountdown == 0 && ptr) {
+      MemoryType *mp = malloc(sizeof(MemoryType));
+      sampleCountdown = MEMORY_SAMPLE_RATE;
+      if(mp) {
+         mp->pointer = ptr;
+         TrackMemory(mp, GetAllocationSite(file, line), size);
+         InsertMemory(mp);
+      }
+   }
+   return ptr;
+}
+
+/** Reallocate memory, moving a sampled allocation to the new site. */
+void *PROFILE_Reallocate(void *ptr, size_t size,
+                         const char *file, unsigned int line)
+{
+   MemoryType *mp;
+   void *result;
+   if(!ptr) {
+      return PROFILE_Allocate(size, file, line);
+   }
+   mp = RemoveMemory(ptr);
+   result = realloc(ptr, size);
+   if(mp) {
+      if(result) {
+         UntrackMemory(mp);
+         mp->pointer = result;
+         TrackMemory(mp, GetAllocationSite(file, line), size);
+      }
+      InsertMemory(mp);
+   }
+   return result;
+}
+
+/** Release memory. */
+void PROFILE_Release(void *ptr)
+{
+   if(ptr && memoryCount > 0) {
+      MemoryType *mp = RemoveMemory(ptr);
+      if(mp) {
+         UntrackMemory(mp);
+         free(mp);
+      }
+   }
+   free(ptr);
+}
+
+#endif /* PROFILE_MEMORY && !DEBUG */
+
+#ifdef DEBUG
+
+#define CHECKPOINT_LIST_SIZE 8
+
+static unsigned long allocationCount = 0;
 
 static const char *checkpointFile[CHECKPOINT_LIST_SIZE];
 static unsigned int checkpointLine[CHECKPOINT_LIST_SIZE];
@@ -62,19 +344,21 @@ void DEBUG_StartDebug(const char *file, unsigned int line)
 void DEBUG_StopDebug(const char *file, unsigned int line)
 {
    Debug("%s[%u]: debug mode stopped", file, line);
-   if(allocations) {
-      MemoryType *mp;
-      unsigned int count = 0;
+   if(memoryCount > 0) {
+      const size_t count = memoryCount;
+      size_t x;
       Debug("MEMORY: memory leaks follow");
-      for(mp = allocations; mp; mp = mp->next) {
-         Debug("        %u bytes in %s at line %u",
-            mp->size, mp->file, mp->line);
-         ++count;
+      for(x = 0; x < memoryTableSize; x++) {
+         MemoryType *mp;
+         for(mp = memoryTable[x]; mp; mp = mp->next) {
+            Debug("        %u bytes in %s at line %u",
+                  (unsigned int)mp->size, mp->site->file, mp->site->line);
+         }
       }
       if(count == 1) {
          Debug("MEMORY: 1 memory leak");
       } else {
-         Debug("MEMORY: %u memory leaks", count);
+         Debug("MEMORY: %u memory leaks", (unsigned int)count);
       }
    } else {
       Debug("MEMORY: no memory leaks");
@@ -110,9 +394,6 @@ void *DEBUG_Allocate(size_t size, const char *file, unsigned int line)
    MemoryType *mp;
    mp = (MemoryType*)malloc(sizeof(MemoryType));
    Assert(mp);
-   mp->file = file;
-   mp->line = line;
-   mp->size = size;
    mp->pointer = malloc(size + sizeof(char) + 8);
    if(!mp->pointer) {
       Debug("MEMORY: %s[%u]: Memory allocation failed (%d bytes)",
@@ -127,11 +408,18 @@ void *DEBUG_Allocate(size_t size, const char *file, unsigned int line)
    mp->pointer[7] = 42;
    mp->pointer[size + 8] = 42;
 
-   mp->next = allocations;
-   allocations = mp;
+   TrackMemory(mp, GetAllocationSite(file, line), size);
+   InsertMemory(mp);
+   allocationCount += 1;
    return mp->pointer + 8;
 }
 
+/** Get the number of allocations made so far. */
+unsigned long DEBUG_GetAllocationCount(void)
+{
+   return allocationCount;
+}
+
 /** Reallocate memory and log. */
 void *DEBUG_Reallocate(void *ptr, size_t size,
                        const char *file,
@@ -144,38 +432,34 @@ void *DEBUG_Reallocate(void *ptr, size_t size,
       return DEBUG_Allocate(size, file, line);
    } else {
       char *cptr = (char*)ptr - 8;
-      for(mp = allocations; mp; mp = mp->next) {
-         if(mp->pointer == cptr) {
-            if(cptr[mp->size + 8] != 42) {
-               Debug("MEMORY: %s[%u]: The canary is dead (overflow).",
-                     file, line);
-            }
-            if(cptr[7] != 42) {
-               Debug("MEMORY: %s[%u]: The canary is dead (underflow).",
-                     file, line);
-            }
-            mp->file = file;
-            mp->line = line;
-            mp->size = size;
-            mp->pointer = realloc(cptr, size + sizeof(char) + 8);
-            if(!mp->pointer) {
-               Debug("MEMORY: %s[%u]: Failed to reallocate %d bytes.",
-                     file, line, (int)size);
-               Assert(0);
-            }
-            mp->pointer[7] = 42;
-            mp->pointer[size + 8] = 42;
-            return mp->pointer + 8;
+      mp = RemoveMemory(cptr);
+      if(mp) {
+         if(cptr[mp->size + 8] != 42) {
+            Debug("MEMORY: %s[%u]: The canary is dead (overflow).",
+                  file, line);
+         }
+         if(cptr[7] != 42) {
+            Debug("MEMORY: %s[%u]: The canary is dead (underflow).",
+                  file, line);
+         }
+         UntrackMemory(mp);
+         mp->pointer = realloc(cptr, size + sizeof(char) + 8);
+         if(!mp->pointer) {
+            Debug("MEMORY: %s[%u]: Failed to reallocate %d bytes.",
+                  file, line, (int)size);
+            Assert(0);
          }
+         mp->pointer[7] = 42;
+         mp->pointer[size + 8] = 42;
+         TrackMemory(mp, GetAllocationSite(file, line), size);
+         InsertMemory(mp);
+         return mp->pointer + 8;
       }
 
       Debug("MEMORY: %s[%u]: Attempt to reallocate unallocated pointer",
             file, line);
       mp = malloc(sizeof(MemoryType));
       Assert(mp);
-      mp->file = file;
-      mp->line = line;
-      mp->size = size;
       mp->pointer = malloc(size + sizeof(char) + 8);
       if(!mp->pointer) {
          Debug("MEMORY: %s[%u]: Failed to reallocate %d bytes.",
@@ -185,8 +469,8 @@ void *DEBUG_Reallocate(void *ptr, size_t size,
       memset(mp->pointer, 85, size);
       mp->pointer[7] = 42;
       mp->pointer[size + 8] = 42;
-      mp->next = allocations;
-      allocations = mp;
+      TrackMemory(mp, GetAllocationSite(file, line), size);
+      InsertMemory(mp);
       return mp->pointer + 8;
    }
 }
@@ -194,7 +478,7 @@ void *DEBUG_Reallocate(void *ptr, size_t size,
 /** Release memory and log. */
 void DEBUG_Release(void **ptr, const char *file, unsigned int line)
 {
-   MemoryType *mp, *last;
+   MemoryType *mp;
    if(!ptr) {
       Debug("MEMORY: %s[%u]: Invalid attempt to release", file, line);
    } else if(!*ptr) {
@@ -202,31 +486,23 @@ void DEBUG_Release(void **ptr, const char *file, unsigned int line)
             file, line);
    } else {
       char *cptr = (char*)*ptr - 8;
-      last = NULL;
-      for(mp = allocations; mp; mp = mp->next) {
-         if(mp->pointer == cptr) {
-            if(last) {
-               last->next = mp->next;
-            } else {
-               allocations = mp->next;
-            }
-
-            if(cptr[mp->size + 8] != 42) {
-               Debug("MEMORY: %s[%u]: The canary is dead (overflow).",
-                     file, line);
-            }
-            if(cptr[7] != 42) {
-               Debug("MEMORY: %s[%u]: The canary is dead (underflow).",
-                     file, line);
-            }
-
-            memset(cptr, 0xFF, mp->size + 8 + sizeof(char));
-            free(mp);
-            free(cptr);
-            *ptr = NULL;
-            return;
+      mp = RemoveMemory(cptr);
+      if(mp) {
+         if(cptr[mp->size + 8] != 42) {
+            Debug("MEMORY: %s[%u]: The canary is dead (overflow).",
+                  file, line);
+         }
+         if(cptr[7] != 42) {
+            Debug("MEMORY: %s[%u]: The canary is dead (underflow).",
+                  file, line);
          }
-         last = mp;
+
+         UntrackMemory(mp);
+         memset(cptr, 0xFF, mp->size + 8 + sizeof(char));
+         free(mp);
+         free(cptr);
+         *ptr = NULL;
+         return;
       }
       Debug("MEMORY: %s[%u]: Attempt to delete unallocated pointer",
             file, line);
@@ -242,3 +518,206 @@ void DEBUG_Release(void **ptr, const char *file, unsigned int line)
 
 #endif
 
+
+#ifdef PROFILE_X
+
+/** Per call site X call counter. */
+typedef struct XProfileType {
+   const char *name;       /**< Name of the X function. */
+   const char *file;       /**< Source file making the call. */
+   unsigned long count;    /**< Number of calls. */
+   char roundTrip;         /**< Set if the call waits for a reply. */
+} XProfileType;
+
+/** X calls that wait for a reply from the server (sorted). */
+static const char * const ROUND_TRIP_CALLS[] = {
+   "XAllocColor",
+   "XAllocNamedColor",
+   "XFetchName",
+   "XGetClassHint",
+   "XGetGeometry",
+   "XGetIconName",
+   "XGetImage",
+   "XGetInputFocus",
+   "XGetSelectionOwner",
+   "XGetTextProperty",
+   "XGetTransientForHint",
+   "XGetWMColormapWindows",
+   "XGetWMHints",
+   "XGetWMNormalHints",
+   "XGetWindowAttributes",
+   "XGetWindowProperty",
+   "XGrabKeyboard",
+   "XGrabPointer",
+   "XInternAtom",
+   "XInternAtoms",
+   "XLoadQueryFont",
+   "XQueryColor",
+   "XQueryColors",
+   "XQueryPointer",
+   "XQueryTree",
+   "XRenderQueryExtension",
+   "XShapeGetRectangles",
+   "XShapeQueryExtension",
+   "XShmQueryExtension",
+   "XSync",
+   "XTranslateCoordinates",
+   "XineramaQueryScreens"
+};
+
+static XProfileType *xprofile = NULL;
+static unsigned int xprofileSize = 0;
+static unsigned int xprofileCount = 0;
+
+static char IsRoundTrip(const char *name);
+static void GrowXProfile(void);
+static int CompareXProfile(const void *a, const void *b);
+
+/** Determine if an X call waits for a reply. */
+char IsRoundTrip(const char *name)
+{
+   unsigned int low = 0;
+   unsigned int high = sizeof(ROUND_TRIP_CALLS) / sizeof(ROUND_TRIP_CALLS[0]);
+   while(low < high) {
+      const unsigned int mid = (low + high) / 2;
+      const int cmp = strcmp(name, ROUND_TRIP_CALLS[mid]);
+      if(cmp == 0) {
+         return 1;
+      } else if(cmp < 0) {
+         high = mid;
+      } else {
+         low = mid + 1;
+      }
+   }
+   return 0;
+}
+
+/** Double the size of the call site table. */
+void GrowXProfile(void)
+{
+   XProfileType *old = xprofile;
+   const unsigned int oldSize = xprofileSize;
+   unsigned int x;
+
+   xprofileSize = oldSize ? oldSize * 2 : 256;
+   xprofile = calloc(xprofileSize, sizeof(XProfileType));
+   Assert(xprofile);
+   for(x = 0; x < oldSize; x++) {
+      if(old[x].name) {
+         unsigned int index = (((size_t)old[x].name >> 3)
+                              ^ ((size_t)old[x].file >> 3) * 31)
+                            & (xprofileSize - 1);
+         while(xprofile[index].name) {
+            index = (index + 1) & (xprofileSize - 1);
+         }
+         xprofile[index] = old[x];
+      }
+   }
+   free(old);
+}
+
+/** Count an X call.
+ * The name and file are string literals, so call sites are keyed by
+ * pointer. Identical names from different files are merged in reports.
+ */
+void DEBUG_ProfileXCall(const char *name, const char *file)
+{
+   unsigned int index;
+   if(xprofileCount * 2 >= xprofileSize) {
+      GrowXProfile();
+   }
+   index = (((size_t)name >> 3) ^ ((size_t)file >> 3) * 31)
+         & (xprofileSize - 1);
+   while(xprofile[index].name) {
+      if(xprofile[index].name == name && xprofile[index].file == file) {
+         xprofile[index].count += 1;
+         return;
+      }
+      index = (index + 1) & (xprofileSize - 1);
+   }
+   xprofile[index].name = name;
+   xprofile[index].file = file;
+   xprofile[index].count = 1;
+   xprofile[index].roundTrip = IsRoundTrip(name);
+   xprofileCount += 1;
+}
+
+/** Sort call sites by function name, then by count. */
+int CompareXProfile(const void *a, const void *b)
+{
+   const XProfileType *pa = (const XProfileType*)a;
+   const XProfileType *pb = (const XProfileType*)b;
+   const int cmp = strcmp(pa->name, pb->name);
+   if(cmp) {
+      return cmp;
+   } else if(pa->count != pb->count) {
+      return pa->count > pb->count ? -1 : 1;
+   } else {
+      return strcmp(pa->file, pb->file);
+   }
+}
+
+/** Get a report of X calls by function and source file. */
+char *DEBUG_GetXProfileReport(void)
+{
+   XProfileType *sites;
+   unsigned long total, roundTrips;
+   unsigned int x, y, count;
+   size_t len, capacity;
+   char *report;
+
+   sites = malloc((xprofileCount + 1) * sizeof(XProfileType));
+   Assert(sites);
+   count = 0;
+   total = 0;
+   roundTrips = 0;
+   for(x = 0; x < xprofileSize; x++) {
+      if(xprofile[x].name) {
+         sites[count++] = xprofile[x];
+         total += xprofile[x].count;
+         if(xprofile[x].roundTrip) {
+            roundTrips += xprofile[x].count;
+         }
+      }
+   }
+   qsort(sites, count, sizeof(XProfileType), CompareXProfile);
+
+   capacity = 128;
+   for(x = 0; x < count; x++) {
+      capacity += 2 * strlen(sites[x].name) + strlen(sites[x].file) + 96;
+   }
+   report = malloc(capacity);
+   Assert(report);
+   len = snprintf(report, capacity, "xcalls total=%lu round_trips=%lu\n",
+                  total, roundTrips);
+   for(x = 0; x < count; x = y) {
+      unsigned long sum = 0;
+      for(y = x; y < count && !strcmp(sites[y].name, sites[x].name); y++) {
+         sum += sites[y].count;
+      }
+      len += snprintf(&report[len], capacity - len,
+                      "xcall %s count=%lu round_trip=%d\n",
+                      sites[x].name, sum, sites[x].roundTrip);
+      for(y = x; y < count && !strcmp(sites[y].name, sites[x].name); y++) {
+         len += snprintf(&report[len], capacity - len,
+                         "xcall_site %s %s count=%lu\n",
+                         sites[y].name, sites[y].file, sites[y].count);
+      }
+   }
+   free(sites);
+   return report;
+}
+
+/** Write the X call report to stderr. */
+void DEBUG_ShowXProfile(void)
+{
+   char *report;
+   if(xprofileCount == 0) {
+      return;
+   }
+   report = DEBUG_GetXProfileReport();
+   fputs(report, stderr);
+   free(report);
+}
+
+#endif /* PROFILE_X */
@@ -77,6 +77,11 @@ void Debug(const char *str, ...);
    void *DEBUG_Reallocate(void*, size_t, const char*, unsigned int);
    void DEBUG_Release(void**, const char*, unsigned int);
 
+#   define GetAllocationCount() \
+      DEBUG_GetAllocationCount()
+
+   unsigned long DEBUG_GetAllocationCount(void);
+
 #else /* DEBUG */
 
 #   define Assert( x )           ((void)0)
@@ -87,11 +92,56 @@ void Debug(const char *str, ...);
 #   define StartDebug()          ((void)0)
 #   define StopDebug()           ((void)0)
 
-#   define Allocate( x )         malloc( (x) )
-#   define Reallocate( x, y )    realloc( (x), (y) )
-#   define Release( x )          free( (x) )
+#   ifdef PROFILE_MEMORY
+
+#      define Allocate( x ) \
+         PROFILE_Allocate( (x), __FILE__, __LINE__ )
+#      define Reallocate( x, y ) \
+         PROFILE_Reallocate( (x), (y), __FILE__, __LINE__ )
+#      define Release( x ) \
+         PROFILE_Release( (x) )
+
+   void *PROFILE_Allocate(size_t, const char*, unsigned int);
+   void *PROFILE_Reallocate(void*, size_t, const char*, unsigned int);
+   void PROFILE_Release(void*);
+
+#   else /* PROFILE_MEMORY */
+
+#      define Allocate( x )         malloc( (x) )
+#      define Reallocate( x, y )    realloc( (x), (y) )
+#      define Release( x )          free( (x) )
+
+#   endif /* PROFILE_MEMORY */
 
 #endif /* DEBUG */
 
+#if defined(DEBUG) || defined(PROFILE_MEMORY)
+
+#   define GetAllocationReport() \
+      DEBUG_GetAllocationReport()
+
+   char *DEBUG_GetAllocationReport(void);
+
+#endif /* DEBUG || PROFILE_MEMORY */
+
+#ifdef PROFILE_X
+
+#   define ProfileXCall( name ) \
+      DEBUG_ProfileXCall( (name), __FILE__ )
+#   define ShowXProfile() \
+      DEBUG_ShowXProfile()
+#   define GetXProfileReport() \
+      DEBUG_GetXProfileReport()
+
+   void DEBUG_ProfileXCall(const char*, const char*);
+   void DEBUG_ShowXProfile(void);
+   char *DEBUG_GetXProfileReport(void);
+
+#else /* PROFILE_X */
+
+#   define ShowXProfile()        ((void)0)
+
+#endif /* PROFILE_X */
+
 #endif /* DEBUG_H */
 
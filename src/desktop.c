@@ -155,7 +155,6 @@ void ChangeDesktop(unsigned int desktop)
 {
 
    ClientNode *np;
-   unsigned int x;
 
    if(JUNLIKELY(desktop >= settings.desktopCount)) {
       return;
@@ -165,44 +164,35 @@ void ChangeDesktop(unsigned int desktop)
       return;
    }
 
-   /* Hide clients from the old desktop.
-    * Note that we show clients in a separate loop to prevent an issue
+   /* Stack the clients of the new desktop first and map them over the
+    * old ones, so the root and the trays are not exposed in between.
+    * Clients are shown and hidden in separate loops to prevent an issue
     * with clients losing focus.
     */
-   for(x = 0; x < LAYER_COUNT; x++) {
-      for(np = nodes[x]; np; np = np->next) {
-         if(np->state.status & STAT_STICKY) {
-            continue;
-         }
-         if(np->state.desktop == currentDesktop) {
-            HideClient(np);
-         }
-      }
+   for(np = GetDesktopClients(desktop); np; np = np->desktopNext) {
+      np->state.status &= ~STAT_HIDDEN;
+   }
+   RestackClients();
+   for(np = GetDesktopClients(desktop); np; np = np->desktopNext) {
+      MapShownClient(np);
    }
 
-   /* Show clients on the new desktop. */
-   for(x = 0; x < LAYER_COUNT; x++) {
-      for(np = nodes[x]; np; np = np->next) {
-         if(np->state.status & STAT_STICKY) {
-            continue;
-         }
-         if(np->state.desktop == desktop) {
-            ShowClient(np);
-         }
-      }
+   /* Hide clients from the old desktop. */
+   for(np = GetDesktopClients(currentDesktop); np; np = np->desktopNext) {
+      HideClient(np);
    }
 
    previousDesktop = currentDesktop;
    currentDesktop = desktop;
 
+   LoadBackground(desktop);
+
+   /* State properties are written once the switch is done. */
    SetCardinalAtom(rootWindow, ATOM_NET_CURRENT_DESKTOP, currentDesktop);
    SetCardinalAtom(rootWindow, ATOM_NET_SHOWING_DESKTOP,
                    showingDesktop[currentDesktop]);
-
-   RequireRestack();
    RequireTaskUpdate();
-
-   LoadBackground(desktop);
+   JXFlush(display);
 
 }
 
@@ -269,28 +259,27 @@ void ShowDesktop(void)
 
    ClientNode *np;
    int layer;
+   int pass;
 
    GrabServer();
-   for(layer = 0; layer < LAYER_COUNT; layer++) {
-      for(np = nodes[layer]; np; np = np->next) {
+   for(pass = 0; pass < 2; pass++) {
+      np = pass == 0 ? GetDesktopClients(currentDesktop) : GetStickyClients();
+      for(; np; np = np->desktopNext) {
          if(np->state.status & STAT_NOLIST) {
             continue;
          }
-         if((np->state.desktop == currentDesktop) ||
-            (np->state.status & STAT_STICKY)) {
-            if(showingDesktop[currentDesktop]) {
-               if(np->state.status & STAT_SDESKTOP) {
-                  RestoreClient(np, 0);
-               }
-            } else {
-               if(np->state.status & STAT_ACTIVE) {
-                  JXSetInputFocus(display, rootWindow, RevertToParent,
-                                  CurrentTime);
-               }
-               if(np->state.status & (STAT_MAPPED | STAT_SHADED)) {
-                  MinimizeClient(np, 0);
-                  np->state.status |= STAT_SDESKTOP;
-               }
+         if(showingDesktop[currentDesktop]) {
+            if(np->state.status & STAT_SDESKTOP) {
+               RestoreClient(np, 0);
+            }
+         } else {
+            if(np->state.status & STAT_ACTIVE) {
+               JXSetInputFocus(display, rootWindow, RevertToParent,
+                               CurrentTime);
+            }
+            if(np->state.status & (STAT_MAPPED | STAT_SHADED)) {
+               MinimizeClient(np, 0);
+               np->state.status |= STAT_SDESKTOP;
             }
          }
       }
@@ -299,9 +288,11 @@ void ShowDesktop(void)
    RequireTaskUpdate();
    JXSync(display, True);
 
+   /* Only the unmapping and mapping needs the grab. */
+   UngrabServer();
+
    if(showingDesktop[currentDesktop]) {
       char first = 1;
-      JXSync(display, False);
       for(layer = 0; layer < LAYER_COUNT; layer++) {
          for(np = nodes[layer]; np; np = np->next) {
             if(np->state.status & STAT_NOLIST) {
@@ -323,7 +314,6 @@ void ShowDesktop(void)
    }
    SetCardinalAtom(rootWindow, ATOM_NET_SHOWING_DESKTOP,
                    showingDesktop[currentDesktop]);
-   UngrabServer();
    DrawTray();
 
 }
@@ -15,6 +15,7 @@
 #include "color.h"
 #include "misc.h"
 #include "settings.h"
+#include "event.h"
 
 #define SYSTEM_TRAY_REQUEST_DOCK    0
 #define SYSTEM_TRAY_BEGIN_MESSAGE   1
@@ -40,16 +41,15 @@ typedef struct DockType {
 
    Window window;
    int itemSize;
+   int iconSize;        /**< _NET_SYSTEM_TRAY_ICON_SIZE last set. */
+   char resizePending;  /**< Set if the dock size must be recomputed. */
 
    DockNode *nodes;
 
 } DockType;
 
-static const char BASE_SELECTION_NAME[] = "_NET_SYSTEM_TRAY_S%d";
-
 static DockType *dock = NULL;
 static char owner;
-static Atom dockAtom;
 static unsigned long orientation;
 
 static void SetSize(TrayComponentType *cp, int width, int height);
@@ -58,6 +58,7 @@ static void Resize(TrayComponentType *cp);
 
 static void DockWindow(Window win);
 static void UpdateDock(void);
+static void SetDockIconSize(int size);
 static void GetDockItemSize(int *size);
 static void GetDockSize(int *width, int *height);
 
@@ -71,8 +72,6 @@ void InitializeDock(void)
 void StartupDock(void)
 {
 
-   char *selectionName;
-
    if(!dock) {
       /* No dock has been requested. */
       return;
@@ -82,13 +81,6 @@ void StartupDock(void)
 
       /* No dock yet. */
 
-      /* Get the selection atom. */
-      selectionName = AllocateStack(sizeof(BASE_SELECTION_NAME));
-      snprintf(selectionName, sizeof(BASE_SELECTION_NAME),
-               BASE_SELECTION_NAME, rootScreen);
-      dockAtom = JXInternAtom(display, selectionName, False);
-      ReleaseStack(selectionName);
-
       /* The location and size of the window doesn't matter here. */
       dock->window = JXCreateSimpleWindow(display, rootWindow,
          /* x, y, width, height */ 0, 0, 1, 1,
@@ -123,7 +115,8 @@ void ShutdownDock(void)
 
       /* Release the selection. */
       if(owner) {
-         JXSetSelectionOwner(display, dockAtom, None, CurrentTime);
+         JXSetSelectionOwner(display, atoms[ATOM_NET_SYSTEM_TRAY_SELECTION],
+                             None, CurrentTime);
       }
 
       /* Destroy the dock window. */
@@ -155,6 +148,8 @@ TrayComponentType *CreateDock(int width)
       dock->nodes = NULL;
       dock->window = None;
    }
+   dock->iconSize = 0;
+   dock->resizePending = 0;
 
    cp = CreateTrayComponent();
    cp->object = dock;
@@ -204,6 +199,7 @@ void Create(TrayComponentType *cp)
 {
 
    XEvent event;
+   int itemSize;
 
    Assert(cp);
 
@@ -213,9 +209,12 @@ void Create(TrayComponentType *cp)
       JXMapRaised(display, cp->window);
    }
 
-   /* Set the orientation atom. */
+   /* Set the orientation atom and the icon size before any icons
+    * are docked so they can start at the right size. */
    SetCardinalAtom(dock->cp->window, ATOM_NET_SYSTEM_TRAY_ORIENTATION,
                    orientation);
+   GetDockItemSize(&itemSize);
+   SetDockIconSize(itemSize);
 
    /* Get the selection if we don't already own it.
     * If we did already own it, getting it again would cause problems
@@ -224,8 +223,10 @@ void Create(TrayComponentType *cp)
    if(!owner) {
 
       owner = 1;
-      JXSetSelectionOwner(display, dockAtom, dock->cp->window, CurrentTime);
-      if(JUNLIKELY(JXGetSelectionOwner(display, dockAtom)
+      JXSetSelectionOwner(display, atoms[ATOM_NET_SYSTEM_TRAY_SELECTION],
+                          dock->cp->window, CurrentTime);
+      if(JUNLIKELY(JXGetSelectionOwner(display,
+                                       atoms[ATOM_NET_SYSTEM_TRAY_SELECTION])
                    != dock->cp->window)) {
 
          owner = 0;
@@ -239,7 +240,7 @@ void Create(TrayComponentType *cp)
          event.xclient.message_type = atoms[ATOM_MANAGER];
          event.xclient.format = 32;
          event.xclient.data.l[0] = CurrentTime;
-         event.xclient.data.l[1] = dockAtom;
+         event.xclient.data.l[1] = atoms[ATOM_NET_SYSTEM_TRAY_SELECTION];
          event.xclient.data.l[2] = dock->cp->window;
          event.xclient.data.l[3] = 0;
          event.xclient.data.l[4] = 0;
@@ -290,7 +291,7 @@ char HandleDockResizeRequest(const XResizeRequestEvent *event)
 
    for(np = dock->nodes; np; np = np->next) {
       if(np->window == event->window) {
-         UpdateDock();
+         RequireDockUpdate();
          return 1;
       }
    }
@@ -312,7 +313,7 @@ char HandleDockConfigureRequest(const XConfigureRequestEvent *event)
 
    for(np = dock->nodes; np; np = np->next) {
       if(np->window == event->window) {
-         UpdateDock();
+         RequireDockUpdate();
          return 1;
       }
    }
@@ -353,7 +354,7 @@ char HandleDockReparentNotify(const XReparentEvent *event)
 
    /* Layout the stuff on the dock again if something happened. */
    if(handled) {
-      UpdateDock();
+      RequireDockUpdate();
    }
 
    return handled;
@@ -363,7 +364,7 @@ char HandleDockReparentNotify(const XReparentEvent *event)
 /** Handle a selection clear event. */
 char HandleDockSelectionClear(const XSelectionClearEvent *event)
 {
-   if(event->selection == dockAtom) {
+   if(event->selection == atoms[ATOM_NET_SYSTEM_TRAY_SELECTION]) {
       Debug("lost _NET_SYSTEM_TRAY selection");
       owner = 0;
    }
@@ -374,6 +375,7 @@ char HandleDockSelectionClear(const XSelectionClearEvent *event)
 void DockWindow(Window win)
 {
    DockNode *np;
+   int itemSize;
 
    /* If no dock is running, just return. */
    if(!dock) {
@@ -399,18 +401,19 @@ void DockWindow(Window win)
    np->next = dock->nodes;
    dock->nodes = np;
 
-   /* Update the requested size. */
-   GetDockSize(&dock->cp->requestedWidth, &dock->cp->requestedHeight);
-
-   /* It's safe to reparent at (0, 0) since we call
-    * ResizeTray which will invoke the Resize callback.
+   /* Give the icon its final size right away.
+    * It's safe to reparent at (0, 0) since the dock is laid out again
+    * before waiting for the next event.
     */
+   GetDockItemSize(&itemSize);
    JXAddToSaveSet(display, win);
+   JXResizeWindow(display, win, itemSize, itemSize);
    JXReparentWindow(display, win, dock->cp->window, 0, 0);
    JXMapRaised(display, win);
 
    /* Resize the tray containing the dock. */
-   ResizeTray(dock->cp->tray);
+   dock->resizePending = 1;
+   RequireDockUpdate();
 
 }
 
@@ -432,11 +435,9 @@ char HandleDockDestroy(Window win)
          *np = dp->next;
          Release(dp);
 
-         /* Update the requested size. */
-         GetDockSize(&dock->cp->requestedWidth, &dock->cp->requestedHeight);
-
          /* Resize the tray. */
-         ResizeTray(dock->cp->tray);
+         dock->resizePending = 1;
+         RequireDockUpdate();
          return 1;
       }
    }
@@ -444,6 +445,30 @@ char HandleDockDestroy(Window win)
    return 0;
 }
 
+/** Apply the dock changes made since the last event. */
+void FlushDock(void)
+{
+   if(!dock || dock->cp->window == None) {
+      return;
+   }
+   if(dock->resizePending) {
+      /* This lays out the dock from the Resize callback. */
+      dock->resizePending = 0;
+      ResizeTray(dock->cp);
+   } else {
+      UpdateDock();
+   }
+}
+
+/** Set _NET_SYSTEM_TRAY_ICON_SIZE if the icon size changed. */
+void SetDockIconSize(int size)
+{
+   if(size != dock->iconSize) {
+      SetCardinalAtom(dock->cp->window, ATOM_NET_SYSTEM_TRAY_ICON_SIZE, size);
+      dock->iconSize = size;
+   }
+}
+
 /** Layout items on the dock. */
 void UpdateDock(void)
 {
@@ -457,6 +482,7 @@ void UpdateDock(void)
 
    /* Determine the size of items in the dock. */
    GetDockItemSize(&itemSize);
+   SetDockIconSize(itemSize);
 
    x = 0;
    y = 0;
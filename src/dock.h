@@ -25,6 +25,11 @@ void DestroyDock(void);
  */
 struct TrayComponentType *CreateDock(int width);
 
+/** Apply the dock changes made since the last event.
+ * Docked icons and their size changes are laid out at once.
+ */
+void FlushDock(void);
+
 /** Handle a client message sent to the dock window.
  * @param event The event.
  */
@@ -71,6 +71,14 @@ int ErrorHandler(Display *d, XErrorEvent *e) {
 
 #endif
 
+#ifdef USE_BULK
+   /* Errors on the bulk connection come from the worker thread and are
+    * expected (windows go away); the failed request reports them. */
+   if(d != display) {
+      return 0;
+   }
+#endif
+
    if(initializing) {
       if(e->request_code == X_ChangeWindowAttributes
          && e->error_code == BadAccess) {
@@ -10,6 +10,7 @@
 #include "jwm.h"
 #include "event.h"
 
+#include "background.h"
 #include "client.h"
 #include "clientlist.h"
 #include "confirm.h"
@@ -27,19 +28,40 @@
 #include "timing.h"
 #include "winmenu.h"
 #include "settings.h"
+#include "expose.h"
 #include "tray.h"
 #include "popup.h"
 #include "pager.h"
+#include "preview.h"
 #include "grab.h"
+#include "misc.h"
 #include "screen.h"
+#include "stats.h"
+#include "trace.h"
 
+/** Minimum interval for callbacks registered with a frequency of 0. */
 #define MIN_TIME_DELTA 50
 
+/** Heap index of a callback that is not in the timer heap. */
+#define NOT_QUEUED ((unsigned int)-1)
+
+#if defined(HAVE_SYS_EPOLL_H) && defined(HAVE_SYS_TIMERFD_H) \
+   && defined(HAVE_EPOLL_CREATE1) && defined(HAVE_TIMERFD_CREATE)
+#  define USE_TIMERFD
+#endif
+
 Time eventTime = CurrentTime;
 
+/** A registered callback.
+ * All callbacks are kept in a linked list for lookup and queued in a
+ * binary min-heap ordered by their next deadline for dispatch.
+ */
 typedef struct CallbackNode {
-   TimeType last;
-   int freq;
+   TimeType deadline;         /**< Time the callback should run next. */
+   int freq;                  /**< Frequency in milliseconds. */
+   char oneShot;              /**< Set to remove after the first run. */
+   char removed;              /**< Set if removed while running. */
+   unsigned int index;        /**< Heap index or NOT_QUEUED if running. */
    SignalCallback callback;
    void *data;
    struct CallbackNode *next;
@@ -47,11 +69,126 @@ typedef struct CallbackNode {
 
 static CallbackNode *callbacks = NULL;
 
-static char restack_pending = 0;
-static char task_update_pending = 0;
-static char pager_update_pending = 0;
+static CallbackNode **timerHeap = NULL;
+static unsigned int timerCount = 0;
+static unsigned int timerCapacity = 0;
+
+/** File descriptor watched by the event loop. */
+typedef struct FileWatch {
+   int fd;
+   FileCallback callback;
+   void *data;
+} FileWatch;
+
+static FileWatch *fileWatches = NULL;
+static unsigned int fileWatchCount = 0;
+static unsigned int fileWatchCapacity = 0;
+
+/** Maximum number of events to read from epoll at once. */
+#define EPOLL_EVENTS    8
+
+#ifdef USE_TIMERFD
+static int epollFd = -1;
+static int timerFd = -1;
+static int epollDisplayFd = -1;
+static char timerFdFailed = 0;
+#endif
+
+/** Milliseconds deferred work may wait while events keep arriving. */
+#define WORK_BUDGET     16
+
+/** A stage of deferred work. */
+typedef struct WorkStage {
+   void (*Flush)(void);       /**< Function to do the work. */
+   StatsSection section;      /**< Section to record (or SECTION_COUNT). */
+} WorkStage;
+
+static void ReconfigureScreens(void);
+
+/** Deferred work in the order of WorkType. */
+static const WorkStage WORK_STAGES[WORK_COUNT] = {
+   { ReconfigureScreens,   SECTION_COUNT     },
+   { FlushStates,          SECTION_COUNT     },
+   { FlushDock,            SECTION_COUNT     },
+#ifdef USE_SHAPE
+   { FlushBorderShapes,    SECTION_COUNT     },
+#else
+   { NULL,                 SECTION_COUNT     },
+#endif
+   { RestackClients,       SECTION_RESTACK   },
+   { FlushBorders,         SECTION_COUNT     },
+   { UpdateTaskBar,        SECTION_TASKBAR   },
+   { UpdatePager,          SECTION_PAGER     }
+};
+
+static unsigned int pendingWork = 0;
+static TimeType lastWork = ZERO_TIME;
+static char root_resize_pending = 0;
+
+/* Motion held back by DeferMotionEvent. */
+static XEvent deferredMotion;
+static char motionDeferred = 0;
+static TimeType lastMotionFrame = ZERO_TIME;
+
+/* Client to focus once the mouse rests on it (see FocusDelay). */
+static Window focusPendingWindow = None;
+
+/** Point before which events of a kind are discarded.
+ * The serial of an event is the last request the server processed
+ * before generating it, so events with an older serial than a request
+ * sent after the point of interest were already on their way.
+ */
+typedef struct DiscardMark {
+   unsigned long serial;      /**< First request after the point. */
+   char active;               /**< Set while older events may arrive. */
+} DiscardMark;
+
+static DiscardMark buttonDiscard = { 0, 0 };
+static DiscardMark enterDiscard = { 0, 0 };
+
+/** State for matching superseded events in the event queue. */
+typedef struct CoalesceData {
+   const XEvent *event;       /**< The event being dispatched. */
+   char blocked;              /**< Set once an unrelated event is seen. */
+} CoalesceData;
+
+/** Number of windows with queued work an input event may pass. */
+#define PRIORITY_WINDOWS   8
+
+/** Events taken in order between scans of the queue for input.
+ * This also limits how many input events in a row may go first. */
+#define PRIORITY_BATCH     16
+
+/** State for finding an input event to take ahead of other events. */
+typedef struct PriorityData {
+   Window windows[PRIORITY_WINDOWS];   /**< Windows with queued work. */
+   unsigned int count;                 /**< Number of windows. */
+   char blocked;                       /**< Set once no input may pass. */
+} PriorityData;
+
+static unsigned int priorityBatch = 0;
+static unsigned int priorityTaken = 0;
 
 static void Signal(void);
+static void DoWork(void);
+static void NextEvent(XEvent *event);
+static Bool MatchInputEvent(Display *d, XEvent *e, XPointer arg);
+static void CoalesceEvent(XEvent *event);
+static Bool MatchPropertyEvent(Display *d, XEvent *e, XPointer arg);
+static Bool MatchConfigureEvent(Display *d, XEvent *e, XPointer arg);
+static Window GetEventWindow(const XEvent *e);
+static char WaitForInput(int fd);
+static long GetTimerTimeout(void);
+static void PushTimer(CallbackNode *cp);
+static void RemoveTimer(CallbackNode *cp);
+static void SiftTimerUp(unsigned int index);
+static void SiftTimerDown(unsigned int index);
+static void SwapTimers(unsigned int a, unsigned int b);
+static FileWatch *FindFileWatch(int fd);
+static void RunFileWatch(int fd);
+static CallbackNode *FindCallback(SignalCallback callback, void *data);
+static char RemoveCallback(SignalCallback callback, void *data);
+static void UnlinkCallback(CallbackNode *cp);
 
 static void ProcessBinding(MouseContextType context, ClientNode *np,
                            unsigned state, int code, int x, int y);
@@ -62,6 +199,7 @@ static char HandleExpose(const XExposeEvent *event);
 static char HandlePropertyNotify(const XPropertyEvent *event);
 static void HandleClientMessage(const XClientMessageEvent *event);
 static void HandleColormapChange(const XColormapEvent *event);
+static void HandleMappingNotify(XMappingEvent *event);
 static char HandleDestroyNotify(const XDestroyWindowEvent *event);
 static void HandleMapRequest(const XMapEvent *event);
 static void HandleUnmapNotify(const XUnmapEvent *event);
@@ -84,6 +222,12 @@ static void HandleNetWMState(const XClientMessageEvent *event,
 static void HandleFrameExtentsRequest(const XClientMessageEvent *event);
 static void UpdateState(ClientNode *np);
 static void DiscardEnterEvents();
+static void MarkDiscard(DiscardMark *mp);
+static char IsDiscarded(DiscardMark *mp, const XEvent *event);
+static void MotionTimeout(const TimeType *now, int x, int y, Window w,
+                          void *data);
+static void FocusTimeout(const TimeType *now, int x, int y, Window w,
+                         void *data);
 
 #ifdef USE_SHAPE
 static void HandleShapeEvent(const XShapeEvent *event);
@@ -92,10 +236,9 @@ static void HandleShapeEvent(const XShapeEvent *event);
 /** Wait for an event and process it. */
 char WaitForEvent(XEvent *event)
 {
-   struct timeval timeout;
-   CallbackNode *cp;
-   fd_set fds;
-   long sleepTime;
+   StatsTime start;
+   StatsTime sectionStart;
+   TraceTime traceStart;
    int fd;
    char handled;
 
@@ -105,32 +248,32 @@ char WaitForEvent(XEvent *event)
    fd = JXConnectionNumber(display);
 #endif
 
-   /* Compute how long we should sleep. */
-   sleepTime = 10 * 1000;  /* 10 seconds. */
-   for(cp = callbacks; cp; cp = cp->next) {
-      if(cp->freq > 0 && cp->freq < sleepTime) {
-         sleepTime = cp->freq;
-      }
-   }
-
    do {
 
+      /* Copy tray updates before blocking; JXPending flushes them. */
+      FlushTrayDamage();
       while(JXPending(display) == 0) {
-         FD_ZERO(&fds);
-         FD_SET(fd, &fds);
-         timeout.tv_sec = sleepTime / 1000;
-         timeout.tv_usec = (sleepTime % 1000) * 1000;
-         if(select(fd + 1, &fds, NULL, NULL, &timeout) <= 0) {
+         if(pendingWork) {
+            DoWork();
+            FlushTrayDamage();
+            continue;
+         }
+         if(!WaitForInput(fd)) {
             Signal();
          }
          if(JUNLIKELY(shouldExit)) {
             return 0;
          }
+         FlushTrayDamage();
       }
 
       Signal();
 
-      JXNextEvent(display, event);
+      NextEvent(event);
+      start = StartStats();
+      traceStart = StartTrace();
+      EnterWatchdog("Event", event->type, event->xany.window);
+      CoalesceEvent(event);
       UpdateTime(event);
 
       switch(event->type) {
@@ -178,12 +321,12 @@ char WaitForEvent(XEvent *event)
       case ButtonRelease:
          SetMousePosition(event->xbutton.x_root, event->xbutton.y_root,
                           event->xbutton.window);
-         handled = 0;
+         handled = IsDiscarded(&buttonDiscard, event);
          break;
       case EnterNotify:
          SetMousePosition(event->xcrossing.x_root, event->xcrossing.y_root,
                           event->xcrossing.window);
-         handled = 0;
+         handled = IsDiscarded(&enterDiscard, event);
          break;
       case LeaveNotify:
          SetMousePosition(event->xcrossing.x_root, event->xcrossing.y_root,
@@ -194,6 +337,10 @@ char WaitForEvent(XEvent *event)
          HandleDockReparentNotify(&event->xreparent);
          handled = 1;
          break;
+      case MappingNotify:
+         HandleMappingNotify(&event->xmapping);
+         handled = 1;
+         break;
       case ConfigureNotify:
          handled = HandleConfigureNotify(&event->xconfigure);
          break;
@@ -209,6 +356,20 @@ char WaitForEvent(XEvent *event)
          } else if(haveShape && event->type == shapeEvent) {
             HandleShapeEvent((XShapeEvent*)event);
             handled = 1;
+#endif
+#ifdef USE_XCOMPOSITE
+         } else if(HandlePreviewEvent(event)) {
+            handled = 1;
+#endif
+#ifdef USE_XRANDR
+         } else if(haveRandR
+                   && event->type == randrEvent + RRScreenChangeNotify) {
+            JXRRUpdateConfiguration(event);
+            RequireWork(WORK_SCREENS);
+            handled = 1;
+         } else if(haveRandR && event->type == randrEvent + RRNotify) {
+            RequireWork(WORK_SCREENS);
+            handled = 1;
 #endif
          } else {
             handled = 0;
@@ -217,17 +378,28 @@ char WaitForEvent(XEvent *event)
       }
 
       if(!handled) {
+         sectionStart = StartStats();
          handled = ProcessTrayEvent(event);
+         RecordSectionStats(SECTION_TRAY_EVENT, sectionStart);
       }
       if(!handled) {
+         sectionStart = StartStats();
          handled = ProcessDialogEvent(event);
+         RecordSectionStats(SECTION_DIALOG_EVENT, sectionStart);
       }
       if(!handled) {
+         sectionStart = StartStats();
          handled = ProcessSwallowEvent(event);
+         RecordSectionStats(SECTION_SWALLOW_EVENT, sectionStart);
       }
       if(!handled) {
+         sectionStart = StartStats();
          handled = ProcessPopupEvent(event);
+         RecordSectionStats(SECTION_POPUP_EVENT, sectionStart);
       }
+      RecordEventStats(event->type, start);
+      LeaveWatchdog();
+      RecordTrace("Event", event->type, traceStart);
 
    } while(handled && JLIKELY(!shouldExit));
 
@@ -235,47 +407,469 @@ char WaitForEvent(XEvent *event)
 
 }
 
+/** Wait until the X connection is readable or the next timer is due.
+ * @return 1 if the connection is readable, 0 on timeout or interrupt.
+ */
+char WaitForInput(int fd)
+{
+   struct timeval timeout;
+   fd_set fds;
+   long sleepTime;
+   unsigned int x;
+   int maxFd;
+   int count;
+
+   sleepTime = GetTimerTimeout();
+
+#ifdef USE_TIMERFD
+   if(JUNLIKELY(epollFd < 0 && !timerFdFailed)) {
+      struct epoll_event ev;
+      epollFd = epoll_create1(EPOLL_CLOEXEC);
+      timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+      memset(&ev, 0, sizeof(ev));
+      ev.events = EPOLLIN;
+      ev.data.fd = timerFd;
+      if(epollFd < 0 || timerFd < 0
+         || epoll_ctl(epollFd, EPOLL_CTL_ADD, timerFd, &ev) < 0) {
+         Debug("timerfd unavailable; falling back to select");
+         if(epollFd >= 0) {
+            close(epollFd);
+            epollFd = -1;
+         }
+         if(timerFd >= 0) {
+            close(timerFd);
+            timerFd = -1;
+         }
+         timerFdFailed = 1;
+      } else {
+         for(x = 0; x < fileWatchCount; x++) {
+            ev.data.fd = fileWatches[x].fd;
+            epoll_ctl(epollFd, EPOLL_CTL_ADD, fileWatches[x].fd, &ev);
+         }
+      }
+   }
+   if(JLIKELY(epollFd >= 0)) {
+      struct epoll_event events[EPOLL_EVENTS];
+      struct itimerspec spec;
+      int i;
+      char ready;
+
+      if(JUNLIKELY(epollDisplayFd != fd)) {
+         struct epoll_event ev;
+         if(epollDisplayFd >= 0) {
+            epoll_ctl(epollFd, EPOLL_CTL_DEL, epollDisplayFd, NULL);
+         }
+         memset(&ev, 0, sizeof(ev));
+         ev.events = EPOLLIN;
+         ev.data.fd = fd;
+         epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev);
+         epollDisplayFd = fd;
+      }
+
+      /* Arm the timer for the next deadline (or disarm it if there is
+       * nothing to wait for). A zero it_value disarms the timer, so
+       * deadlines that are already due use the smallest interval. */
+      memset(&spec, 0, sizeof(spec));
+      if(sleepTime > 0) {
+         spec.it_value.tv_sec = sleepTime / 1000;
+         spec.it_value.tv_nsec = (sleepTime % 1000) * 1000000;
+      } else if(sleepTime == 0) {
+         spec.it_value.tv_nsec = 1;
+      }
+      timerfd_settime(timerFd, 0, &spec, NULL);
+
+      SetWatchdogIdle(1);
+      count = epoll_wait(epollFd, events, EPOLL_EVENTS, -1);
+      SetWatchdogIdle(0);
+      ready = 0;
+      for(i = 0; i < count; i++) {
+         if(events[i].data.fd == timerFd) {
+            unsigned long long expirations;
+            if(read(timerFd, &expirations, sizeof(expirations)) < 0) {
+               /* Nothing to do; the timer is non-blocking. */
+            }
+         } else if(events[i].data.fd == fd) {
+            ready = 1;
+         } else {
+            RunFileWatch(events[i].data.fd);
+         }
+      }
+      return ready;
+   }
+#endif
+
+   FD_ZERO(&fds);
+   FD_SET(fd, &fds);
+   maxFd = fd;
+   for(x = 0; x < fileWatchCount; x++) {
+      FD_SET(fileWatches[x].fd, &fds);
+      maxFd = Max(maxFd, fileWatches[x].fd);
+   }
+   SetWatchdogIdle(1);
+   if(sleepTime >= 0) {
+      timeout.tv_sec = sleepTime / 1000;
+      timeout.tv_usec = (sleepTime % 1000) * 1000;
+      count = select(maxFd + 1, &fds, NULL, NULL, &timeout);
+   } else {
+      count = select(maxFd + 1, &fds, NULL, NULL, NULL);
+   }
+   SetWatchdogIdle(0);
+   if(count <= 0) {
+      return 0;
+   }
+
+   /* Callbacks may change the watch list, so collect the ready
+    * descriptors first. */
+   if(fileWatchCount > 0) {
+      int *readyFds = AllocateStack(fileWatchCount * sizeof(int));
+      unsigned int readyCount = 0;
+      for(x = 0; x < fileWatchCount; x++) {
+         if(FD_ISSET(fileWatches[x].fd, &fds)) {
+            readyFds[readyCount] = fileWatches[x].fd;
+            readyCount += 1;
+         }
+      }
+      for(x = 0; x < readyCount; x++) {
+         RunFileWatch(readyFds[x]);
+      }
+      ReleaseStack(readyFds);
+   }
+   return FD_ISSET(fd, &fds) != 0;
+}
+
+/** Find the watch for a file descriptor. */
+FileWatch *FindFileWatch(int fd)
+{
+   unsigned int x;
+   for(x = 0; x < fileWatchCount; x++) {
+      if(fileWatches[x].fd == fd) {
+         return &fileWatches[x];
+      }
+   }
+   return NULL;
+}
+
+/** Run the callback for a file descriptor that is ready. */
+void RunFileWatch(int fd)
+{
+   FileWatch *wp = FindFileWatch(fd);
+   if(wp) {
+      StatsTime start = StartStats();
+      TraceTime traceStart = StartTrace();
+      EnterWatchdog("FileWatch", fd, None);
+      (wp->callback)(fd, wp->data);
+      LeaveWatchdog();
+      RecordSectionStats(SECTION_CALLBACK, start);
+      RecordTrace("FileWatch", fd, traceStart);
+   }
+}
+
+/** Watch a file descriptor from the event loop. */
+void RegisterFileWatch(int fd, FileCallback callback, void *data)
+{
+   FileWatch *wp = FindFileWatch(fd);
+   if(!wp) {
+      if(!fileWatches) {
+         fileWatchCapacity = 4;
+         fileWatches = Allocate(fileWatchCapacity * sizeof(FileWatch));
+      } else if(fileWatchCount == fileWatchCapacity) {
+         fileWatchCapacity *= 2;
+         fileWatches = Reallocate(fileWatches,
+                                  fileWatchCapacity * sizeof(FileWatch));
+      }
+      wp = &fileWatches[fileWatchCount];
+      fileWatchCount += 1;
+      wp->fd = fd;
+#ifdef USE_TIMERFD
+      if(epollFd >= 0) {
+         struct epoll_event ev;
+         memset(&ev, 0, sizeof(ev));
+         ev.events = EPOLLIN;
+         ev.data.fd = fd;
+         epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev);
+      }
+#endif
+   }
+   wp->callback = callback;
+   wp->data = data;
+}
+
+/** Stop watching a file descriptor. */
+void UnregisterFileWatch(int fd)
+{
+   FileWatch *wp = FindFileWatch(fd);
+   if(wp) {
+#ifdef USE_TIMERFD
+      if(epollFd >= 0) {
+         epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, NULL);
+      }
+#endif
+      fileWatchCount -= 1;
+      *wp = fileWatches[fileWatchCount];
+      if(fileWatchCount == 0) {
+         Release(fileWatches);
+         fileWatches = NULL;
+         fileWatchCapacity = 0;
+      }
+   }
+}
+
+/** Get the number of milliseconds until the next timer is due.
+ * @return The timeout, 0 if a timer is due, or -1 if there are no timers.
+ */
+long GetTimerTimeout(void)
+{
+   TimeType now;
+   if(timerCount == 0) {
+      return -1;
+   }
+   GetCurrentTime(&now);
+   if(CompareTime(&timerHeap[0]->deadline, &now) <= 0) {
+      return 0;
+   }
+   return GetTimeDifference(&now, &timerHeap[0]->deadline);
+}
+
 /** Wake up components that need to run at certain times. */
 void Signal(void)
 {
-   static TimeType last = ZERO_TIME;
-
-   CallbackNode *cp;   
+   CallbackNode *cp;
+   StatsTime start;
+   TraceTime traceStart;
    TimeType now;
    Window w;
    int x, y;
 
-   if(restack_pending) {
-      RestackClients();
-      restack_pending = 0;
-   }
-   if(task_update_pending) {
-      UpdateTaskBar();
-      task_update_pending = 0;
-   }
-   if(pager_update_pending) {
-      UpdatePager();
-      pager_update_pending = 0;
+   ProcessTraceRequest();
+
+   /* Events are still queued; deferred work only runs here once it has
+    * waited for the budget. */
+   if(pendingWork) {
+      GetCurrentTime(&now);
+      if(GetTimeDifference(&now, &lastWork) >= WORK_BUDGET) {
+         DoWork();
+      }
    }
 
+   if(timerCount == 0) {
+      return;
+   }
    GetCurrentTime(&now);
-   if(GetTimeDifference(&now, &last) < MIN_TIME_DELTA) {
+   if(CompareTime(&timerHeap[0]->deadline, &now) > 0) {
       return;
    }
-   last = now;
 
    GetMousePosition(&x, &y, &w);
-   for(cp = callbacks; cp; cp = cp->next) {
-      if(cp->freq == 0 || GetTimeDifference(&now, &cp->last) >= cp->freq) {
-         cp->last = now;
-         (cp->callback)(&now, x, y, w, cp->data);
+   while(timerCount > 0 && CompareTime(&timerHeap[0]->deadline, &now) <= 0) {
+
+      /* Take the callback off the heap while it runs so that it can
+       * safely register or unregister callbacks (including itself). */
+      cp = timerHeap[0];
+      RemoveTimer(cp);
+      start = StartStats();
+      traceStart = StartTrace();
+      EnterWatchdog("Signal", -1, None);
+      (cp->callback)(&now, x, y, w, cp->data);
+      LeaveWatchdog();
+      RecordSectionStats(SECTION_CALLBACK, start);
+      RecordTrace("Signal", -1, traceStart);
+
+      if(cp->removed) {
+         Release(cp);
+      } else if(cp->oneShot) {
+         UnlinkCallback(cp);
+         Release(cp);
+      } else {
+         cp->deadline = now;
+         AdvanceTime(&cp->deadline, cp->freq > 0 ? cp->freq : MIN_TIME_DELTA);
+         PushTimer(cp);
+      }
+
+   }
+}
+
+/** Get the next event to process.
+ * With InputPriority, queued input is taken ahead of other work. Input
+ * never passes an event for the same window or another input event, so
+ * the order seen by each window is kept. Once no input is found, or
+ * after a run of input events, a batch of events is taken in order
+ * before the queue is scanned again so other work is not starved.
+ */
+void NextEvent(XEvent *event)
+{
+   PriorityData data;
+
+   if(settings.inputPriority) {
+      if(priorityBatch > 0) {
+         priorityBatch -= 1;
+      } else if(JXQLength(display) > 1) {
+         data.count = 0;
+         data.blocked = 0;
+         if(JXCheckIfEvent(display, event, MatchInputEvent,
+                           (XPointer)&data)) {
+            priorityTaken += 1;
+            if(priorityTaken == PRIORITY_BATCH) {
+               priorityTaken = 0;
+               priorityBatch = PRIORITY_BATCH;
+            }
+            return;
+         }
+         priorityTaken = 0;
+         priorityBatch = PRIORITY_BATCH;
       }
    }
+   JXNextEvent(display, event);
+}
+
+/** Predicate to find an input event that may be taken early. */
+Bool MatchInputEvent(Display *d, XEvent *e, XPointer arg)
+{
+   PriorityData *data = (PriorityData*)arg;
+   Window w;
+   unsigned int x;
+
+   if(data->blocked) {
+      return False;
+   }
+   w = GetEventWindow(e);
+   switch(e->type) {
+   case KeyPress:
+   case KeyRelease:
+   case ButtonPress:
+   case ButtonRelease:
+      break;
+   case MotionNotify:
+      /* Only motion from a grab such as a move or resize: other motion
+       * uses hints and is cheap to handle in order. */
+      if(!e->xmotion.is_hint) {
+         break;
+      }
+      /* Fall through. */
+   default:
+      if(  e->type == DestroyNotify || e->type == UnmapNotify
+         || e->type == MapRequest || e->type == ReparentNotify
+         || data->count == PRIORITY_WINDOWS) {
+         /* Input may refer to the windows these change. */
+         data->blocked = 1;
+      } else {
+         for(x = 0; x < data->count; x++) {
+            if(data->windows[x] == w) {
+               return False;
+            }
+         }
+         data->windows[data->count] = w;
+         data->count += 1;
+      }
+      return False;
+   }
+
+   /* The first input event is taken unless work for its window is
+    * queued ahead of it; later input waits its turn behind it. */
+   data->blocked = 1;
+   for(x = 0; x < data->count; x++) {
+      if(data->windows[x] == w) {
+         return False;
+      }
+   }
+   return True;
+}
+
+/** Collapse queued events that are superseded by the event being handled.
+ * XPending has already read everything available into the Xlib queue, so
+ * this only looks at events that are queued locally.
+ * Duplicate PropertyNotify events for the same window and atom are
+ * removed since the handler reads the current property value anyway.
+ * A ConfigureRequest is replaced by a later request for the same window
+ * as long as the later request sets at least the same fields and no other
+ * event for that window is queued in between.
+ */
+void CoalesceEvent(XEvent *event)
+{
+   CoalesceData data;
+   XEvent temp;
+
+   if(event->type == PropertyNotify) {
+      data.event = event;
+      data.blocked = 0;
+      while(JXCheckIfEvent(display, &temp, MatchPropertyEvent,
+                           (XPointer)&data)) {
+         UpdateTime(&temp);
+      }
+   } else if(event->type == ConfigureRequest) {
+      for(;;) {
+         data.event = event;
+         data.blocked = 0;
+         if(!JXCheckIfEvent(display, &temp, MatchConfigureEvent,
+                            (XPointer)&data)) {
+            break;
+         }
+         *event = temp;
+      }
+   }
+}
+
+/** Predicate to find a duplicate PropertyNotify event. */
+Bool MatchPropertyEvent(Display *d, XEvent *e, XPointer arg)
+{
+   const CoalesceData *data = (const CoalesceData*)arg;
+   return e->type == PropertyNotify
+      && e->xproperty.window == data->event->xproperty.window
+      && e->xproperty.atom == data->event->xproperty.atom;
+}
+
+/** Predicate to find a ConfigureRequest that supersedes another. */
+Bool MatchConfigureEvent(Display *d, XEvent *e, XPointer arg)
+{
+   CoalesceData *data = (CoalesceData*)arg;
+   const XConfigureRequestEvent *current = &data->event->xconfigurerequest;
+   if(data->blocked) {
+      return False;
+   }
+   if(e->type == ConfigureRequest
+      && e->xconfigurerequest.window == current->window) {
+      if((current->value_mask & ~e->xconfigurerequest.value_mask) == 0) {
+         return True;
+      }
+      data->blocked = 1;
+   } else if(GetEventWindow(e) == current->window) {
+      data->blocked = 1;
+   }
+   return False;
+}
+
+/** Get the window an event refers to.
+ * For events selected with SubstructureNotifyMask or
+ * SubstructureRedirectMask, xany.window is the parent rather than the
+ * window the event is about.
+ */
+Window GetEventWindow(const XEvent *e)
+{
+   switch(e->type) {
+   case MapRequest:
+      return e->xmaprequest.window;
+   case ConfigureRequest:
+      return e->xconfigurerequest.window;
+   case CreateNotify:
+      return e->xcreatewindow.window;
+   case DestroyNotify:
+      return e->xdestroywindow.window;
+   case MapNotify:
+      return e->xmap.window;
+   case UnmapNotify:
+      return e->xunmap.window;
+   case ReparentNotify:
+      return e->xreparent.window;
+   case ConfigureNotify:
+      return e->xconfigure.window;
+   default:
+      return e->xany.window;
+   }
 }
 
 /** Process an event. */
 void ProcessEvent(XEvent *event)
 {
+   const StatsTime start = StartStats();
    switch(event->type) {
    case ButtonPress:
    case ButtonRelease:
@@ -304,24 +898,22 @@ void ProcessEvent(XEvent *event)
       Debug("Unknown event type: %d", event->type);
       break;
    }
+   RecordProcessStats(event->type, start);
 }
 
 /** Discard button events for the specified windows. */
 void DiscardButtonEvents()
 {
-   XEvent event;
-   JXSync(display, False);
-   while(JXCheckMaskEvent(display, ButtonPressMask | ButtonReleaseMask,
-			  &event)) {
-      UpdateTime(&event);
-   }
+   MarkDiscard(&buttonDiscard);
 }
 
-/** Discard motion events for the specified window. */
+/** Discard motion events for the specified window.
+ * Only the events already received are merged; there is no need to
+ * wait for more.
+ */
 void DiscardMotionEvents(XEvent *event, Window w)
 {
    XEvent temp;
-   JXSync(display, False);
    while(JXCheckTypedEvent(display, MotionNotify, &temp)) {
       UpdateTime(&temp);
       SetMousePosition(temp.xmotion.x_root, temp.xmotion.y_root,
@@ -332,10 +924,78 @@ void DiscardMotionEvents(XEvent *event, Window w)
    }
 }
 
+/** Limit motion events to a frame rate. */
+char DeferMotionEvent(const XEvent *event, unsigned int rate)
+{
+   TimeType now;
+   unsigned long interval;
+   unsigned long elapsed;
+
+   if(rate == 0) {
+      return 0;
+   }
+
+   interval = 1000 / rate;
+   GetCurrentTime(&now);
+   elapsed = GetTimeDifference(&now, &lastMotionFrame);
+   if(elapsed >= interval) {
+      lastMotionFrame = now;
+      if(motionDeferred) {
+         motionDeferred = 0;
+         UnregisterTimeout(MotionTimeout, NULL);
+      }
+      return 0;
+   }
+
+   /* Keep only the latest position; the timeout delivers it at the
+    * start of the next frame. */
+   deferredMotion = *event;
+   if(!motionDeferred) {
+      motionDeferred = 1;
+      RegisterTimeout(interval - elapsed, MotionTimeout, NULL);
+   }
+   return 1;
+}
+
+/** Deliver deferred motion ahead of another event. */
+char ReplayMotionEvent(const XEvent *event)
+{
+   XEvent temp;
+   if(!motionDeferred) {
+      return 0;
+   }
+   UnregisterTimeout(MotionTimeout, NULL);
+   temp = *event;
+   JXPutBackEvent(display, &temp);
+   MotionTimeout(NULL, 0, 0, None, NULL);
+   return 1;
+}
+
+/** Drop deferred motion. */
+void CancelMotionEvents(void)
+{
+   if(motionDeferred) {
+      motionDeferred = 0;
+      UnregisterTimeout(MotionTimeout, NULL);
+   }
+}
+
+/** Put deferred motion back on the queue.
+ * The frame time is cleared so that the event is not deferred again.
+ */
+void MotionTimeout(const TimeType *now, int x, int y, Window w, void *data)
+{
+   const TimeType zeroTime = ZERO_TIME;
+   if(motionDeferred) {
+      motionDeferred = 0;
+      lastMotionFrame = zeroTime;
+      JXPutBackEvent(display, &deferredMotion);
+   }
+}
+
 /** Discard key events for the specified window. */
 void DiscardKeyEvents(XEvent *event, Window w)
 {
-   JXSync(display, False);
    while(JXCheckTypedWindowEvent(display, w, KeyPress, event)) {
       UpdateTime(event);
    }
@@ -344,19 +1004,39 @@ void DiscardKeyEvents(XEvent *event, Window w)
 /** Discard enter notify events. */
 void DiscardEnterEvents()
 {
-   XEvent event;
-   JXSync(display, False);
-   while(JXCheckMaskEvent(display, EnterWindowMask, &event)) {
-      UpdateTime(&event);
-      SetMousePosition(event.xmotion.x_root, event.xmotion.y_root,
-                       event.xmotion.window);
+   MarkDiscard(&enterDiscard);
+}
+
+/** Discard events generated before now without waiting for them.
+ * Events are dropped by WaitForEvent as they arrive. The no-op request
+ * gives later events a newer serial than the mark.
+ */
+void MarkDiscard(DiscardMark *mp)
+{
+   mp->serial = NextRequest(display);
+   mp->active = 1;
+   JXNoOp(display);
+}
+
+/** Determine if an event is older than a discard mark.
+ * Events arrive in order, so the mark is cleared by the first newer one.
+ */
+char IsDiscarded(DiscardMark *mp, const XEvent *event)
+{
+   if(JLIKELY(!mp->active)) {
+      return 0;
    }
+   if((long)(event->xany.serial - mp->serial) < 0) {
+      return 1;
+   }
+   mp->active = 0;
+   return 0;
 }
 
 /** Process a selection clear event. */
 char HandleSelectionClear(const XSelectionClearEvent *event)
 {
-   if(event->selection == managerSelection) {
+   if(event->selection == atoms[ATOM_WM_SELECTION]) {
       /* Lost WM selection. */
       shouldExit = 1;
       return 1;
@@ -437,13 +1117,13 @@ void HandleButtonEvent(const XButtonEvent *event)
                RaiseClient(np);
             }
             if(move_resize) {
-               GetBorderSize(&np->state, &north, &south, &east, &west);
+               GetClientBorderSize(np, &north, &south, &east, &west);
                MoveClient(np, event->x + west, event->y + north);
             }
             break;
          case Button3:
             if(move_resize) {
-               GetBorderSize(&np->state, &north, &south, &east, &west);
+               GetClientBorderSize(np, &north, &south, &east, &west);
                ResizeClient(np, MC_BORDER | MC_BORDER_E | MC_BORDER_S,
                             event->x + west, event->y + north);
             } else {
@@ -843,7 +1523,7 @@ void HandleConfigureRequest(const XConfigureRequestEvent *event)
       } else {
          /* Only the position changed; move the client. */
          int north, south, east, west;
-         GetBorderSize(&np->state, &north, &south, &east, &west);
+         GetClientBorderSize(np, &north, &south, &east, &west);
 
          if(np->parent != None) {
             JXMoveWindow(display, np->parent, np->x - west, np->y - north);
@@ -881,12 +1561,46 @@ char HandleConfigureNotify(const XConfigureEvent *event)
    if(rootWidth != event->width || rootHeight != event->height) {
       rootWidth = event->width;
       rootHeight = event->height;
-      shouldRestart = 1;
-      shouldExit = 1;
+      RequireWork(WORK_SCREENS);
+      root_resize_pending = 1;
    }
    return 1;
 }
 
+/** Apply a change to the monitor configuration.
+ * Only the trays, backgrounds, and clients affected by the new geometry
+ * are updated.
+ */
+void ReconfigureScreens(void)
+{
+   const char resized = root_resize_pending;
+
+   root_resize_pending = 0;
+   if(!UpdateScreens()) {
+      return;
+   }
+   Debug("screens changed: %d screen(s), %dx%d",
+         GetScreenCount(), rootWidth, rootHeight);
+
+   ReconfigureTrays();
+   ReconfigurePlacement();
+   if(resized) {
+      WriteDesktopGeometry();
+      UpdateBackgrounds();
+   }
+   RequirePagerUpdate();
+}
+
+/** Focus the client the mouse has rested on. */
+void FocusTimeout(const TimeType *now, int x, int y, Window w, void *data)
+{
+   ClientNode *np = FindClientByWindow(focusPendingWindow);
+   focusPendingWindow = None;
+   if(np && !(np->state.status & STAT_ACTIVE) && FindClient(w) == np) {
+      FocusClient(np);
+   }
+}
+
 /** Process an enter notify event. */
 void HandleEnterNotify(const XCrossingEvent *event)
 {
@@ -894,10 +1608,22 @@ void HandleEnterNotify(const XCrossingEvent *event)
    Cursor cur;
    np = FindClient(event->window);
    if(np) {
-      if(  !(np->state.status & STAT_ACTIVE)
-         && (settings.focusModel == FOCUS_SLOPPY
-            || settings.focusModel == FOCUS_SLOPPY_TITLE)) {
-         FocusClient(np);
+      if(  settings.focusModel == FOCUS_SLOPPY
+         || settings.focusModel == FOCUS_SLOPPY_TITLE) {
+         if(np->state.status & STAT_ACTIVE) {
+            /* Focus would not change. */
+            if(focusPendingWindow != None) {
+               UnregisterTimeout(FocusTimeout, NULL);
+               focusPendingWindow = None;
+            }
+         } else if(settings.focusDelay > 0) {
+            if(focusPendingWindow != np->window) {
+               focusPendingWindow = np->window;
+               RegisterTimeout(settings.focusDelay, FocusTimeout, NULL);
+            }
+         } else {
+            FocusClient(np);
+         }
       }
       if(np->parent == event->window) {
          np->mouseContext = GetBorderContext(np, event->x, event->y);
@@ -917,26 +1643,22 @@ char HandleExpose(const XExposeEvent *event)
    ClientNode *np;
    np = FindClientByParent(event->window);
    if(np) {
-      if(event->count == 0) {
-         DrawBorder(np);
+      if(AddExposeArea(event)) {
+         ExposeBorder(np, GetExposeRegion(event->window));
       }
       return 1;
    } else {
       np = FindClientByWindow(event->window);
-      if(np) {
-         if(np->state.status & STAT_WMDIALOG) {
-
-            /* Dialog expose events are handled elsewhere. */
-            return 0;
-
-         } else {
+      if(np && !(np->state.status & STAT_WMDIALOG)) {
 
-            /* Ignore other expose events for client windows. */
-            return 1;
+         /* Ignore other expose events for client windows. */
+         return 1;
 
-         }
       }
-      return event->count ? 1 : 0;
+
+      /* Dialogs, trays, menus, and popups are handled elsewhere once
+       * the whole exposed region is known. */
+      return AddExposeArea(event) ? 0 : 1;
    }
 }
 
@@ -948,8 +1670,7 @@ char HandlePropertyNotify(const XPropertyEvent *event)
       char changed = 0;
       switch(event->atom) {
       case XA_WM_NAME:
-         ReadWMName(np);
-         changed = 1;
+         changed = ReadWMName(np);
          break;
       case XA_WM_NORMAL_HINTS:
          ReadWMNormalHints(np);
@@ -960,22 +1681,24 @@ char HandlePropertyNotify(const XPropertyEvent *event)
          break;
       case XA_WM_HINTS:
          if(np->state.status & STAT_URGENT) {
-            UnregisterCallback(SignalUrgent, np);
+            StopUrgent();
          }
          ReadWMHints(np->window, &np->state, 1);
          if(np->state.status & STAT_URGENT) {
-            RegisterCallback(URGENCY_DELAY, SignalUrgent, np);
+            StartUrgent();
          }
          WriteState(np);
          break;
       case XA_WM_TRANSIENT_FOR:
-         JXGetTransientForHint(display, np->window, &np->owner);
+         if(!JXGetTransientForHint(display, np->window, &np->owner)) {
+            np->owner = None;
+         }
+         UpdateTransientList(np);
          break;
       case XA_WM_ICON_NAME:
          break;
       case XA_WM_CLIENT_MACHINE:
-         ReadWMMachine(np);
-         changed = 1;
+         changed = ReadWMMachine(np);
          break;
       default:
          if(event->atom == atoms[ATOM_WM_COLORMAP_WINDOWS]) {
@@ -984,11 +1707,12 @@ char HandlePropertyNotify(const XPropertyEvent *event)
          } else if(event->atom == atoms[ATOM_WM_PROTOCOLS]) {
             ReadWMProtocols(np->window, &np->state);
          } else if(event->atom == atoms[ATOM_NET_WM_ICON]) {
-            LoadIcon(np);
-            changed = 1;
+            if(LoadIcon(np)) {
+               InvalidateTaskBar();
+               changed = 1;
+            }
          } else if(event->atom == atoms[ATOM_NET_WM_NAME]) {
-            ReadWMName(np);
-            changed = 1;
+            changed = ReadWMName(np);
          } else if(event->atom == atoms[ATOM_NET_WM_STRUT_PARTIAL]) {
             ReadClientStrut(np);
          } else if(event->atom == atoms[ATOM_NET_WM_STRUT]) {
@@ -1008,7 +1732,7 @@ char HandlePropertyNotify(const XPropertyEvent *event)
       }
 
       if(changed) {
-         DrawBorder(np);
+         RequireBorderDraw(np);
          RequireTaskUpdate();
          RequirePagerUpdate();
       }
@@ -1022,6 +1746,16 @@ char HandlePropertyNotify(const XPropertyEvent *event)
    return 1;
 }
 
+/** Handle a change to the keyboard or modifier mapping. */
+void HandleMappingNotify(XMappingEvent *event)
+{
+   JXRefreshKeyboardMapping(event);
+   if(event->request == MappingKeyboard
+      || event->request == MappingModifier) {
+      UpdateBindings();
+   }
+}
+
 /** Handle a client message. */
 void HandleClientMessage(const XClientMessageEvent *event)
 {
@@ -1072,6 +1806,7 @@ void HandleClientMessage(const XClientMessageEvent *event)
             if(   event->data.l[0] >= 0
                && event->data.l[0] < (long)settings.desktopCount) {
                np->state.status &= ~STAT_STICKY;
+               UpdateDesktopList(np);
                SetClientDesktop(np, event->data.l[0]);
             }
          }
@@ -1110,10 +1845,14 @@ void HandleClientMessage(const XClientMessageEvent *event)
 
       if(event->message_type == atoms[ATOM_JWM_RESTART]) {
          Restart();
+      } else if(event->message_type == atoms[ATOM_JWM_REEXEC]) {
+         Reexec();
       } else if(event->message_type == atoms[ATOM_JWM_EXIT]) {
          Exit(0);
       } else if(event->message_type == atoms[ATOM_JWM_RELOAD]) {
          ReloadMenu();
+      } else if(event->message_type == atoms[ATOM_JWM_STATS]) {
+         PublishStats();
       } else if(event->message_type == atoms[ATOM_NET_CURRENT_DESKTOP]) {
          ChangeDesktop(event->data.l[0]);
       } else if(event->message_type == atoms[ATOM_NET_SHOWING_DESKTOP]) {
@@ -1498,14 +2237,25 @@ void HandleMotionNotify(const XMotionEvent *event)
 
    ClientNode *np;
    Cursor cur;
-
-   if(event->is_hint) {
-      return;
-   }
+   int x, y;
 
    np = FindClientByParent(event->window);
    if(np) {
-      const MouseContextType context = GetBorderContext(np, event->x, event->y);
+      MouseContextType context;
+      x = event->x;
+      y = event->y;
+      if(event->is_hint) {
+         /* Frames use motion hints: get the current location, which
+          * also asks for the next hint. */
+         Window rootReturn, childReturn;
+         int rootx, rooty;
+         unsigned int mask;
+         if(!JXQueryPointer(display, np->parent, &rootReturn, &childReturn,
+                            &rootx, &rooty, &x, &y, &mask)) {
+            return;
+         }
+      }
+      context = GetBorderContext(np, x, y);
       if(np->mouseContext != context) {
          np->mouseContext = context;
          cur = GetFrameCursor(context);
@@ -1521,9 +2271,15 @@ void HandleShapeEvent(const XShapeEvent *event)
 {
    ClientNode *np;
    np = FindClientByWindow(event->window);
-   if(np) {
-      np->state.status |= STAT_SHAPED;
-      ResetBorder(np);
+   if(np && event->kind == ShapeBounding) {
+      /* Shape changes are applied once per batch of events. */
+      if(event->shaped) {
+         np->state.status |= STAT_SHAPED;
+      } else {
+         np->state.status &= ~STAT_SHAPED;
+      }
+      np->shape.pending = 1;
+      RequireWork(WORK_SHAPES);
    }
 }
 #endif /* USE_SHAPE */
@@ -1546,21 +2302,20 @@ void HandleMapRequest(const XMapEvent *event)
 {
    ClientNode *np;
    Assert(event);
-   if(CheckSwallowMap(event->window)) {
-      return;
-   }
    np = FindClientByWindow(event->window);
    if(!np) {
-      GrabServer();
-      np = AddClientWindow(event->window, 0, 1);
-      if(np) {
-         if(!(np->state.status & STAT_NOFOCUS)) {
-            FocusClient(np);
+      if(IsSwallowPending()) {
+         const char *name = ReadWindowClass(event->window);
+         if(name && CheckSwallowMap(event->window, name)) {
+            ReleaseWindowClass();
+            return;
          }
-      } else {
-         JXMapWindow(display, event->window);
       }
-      UngrabServer();
+      np = AddClientWindow(event->window, 0, 1);
+      if(np && !(np->state.status & STAT_NOFOCUS)) {
+         FocusClient(np);
+      }
+      ReleaseWindowClass();
    } else {
       if(!(np->state.status & STAT_MAPPED)) {
          UpdateState(np);
@@ -1571,6 +2326,7 @@ void HandleMapRequest(const XMapEvent *event)
          }
          if(!(np->state.status & STAT_STICKY)) {
             np->state.desktop = currentDesktop;
+            UpdateDesktopList(np);
          }
          if(!(np->state.status & STAT_NOFOCUS)) {
             FocusClient(np);
@@ -1667,11 +2423,12 @@ void UpdateState(ClientNode *np)
 
    /* Read the state (and new layer). */
    if(np->state.status & STAT_URGENT) {
-      UnregisterCallback(SignalUrgent, np);
+      StopUrgent();
    }
    np->state = ReadWindowState(np->window, alreadyMapped);
+   UpdateDesktopList(np);
    if(np->state.status & STAT_URGENT) {
-      RegisterCallback(URGENCY_DELAY, SignalUrgent, np);
+      StartUrgent();
    }
 
    /* We don't handle mapping the window, so restore its mapped state. */
@@ -1743,44 +2500,213 @@ void RegisterCallback(int freq, SignalCallback callback, void *data)
 {
    CallbackNode *cp;
    cp = Allocate(sizeof(CallbackNode));
-   cp->last.seconds = 0;
-   cp->last.ms = 0;
+   GetCurrentTime(&cp->deadline);
    cp->freq = freq;
+   cp->oneShot = 0;
+   cp->removed = 0;
    cp->callback = callback;
    cp->data = data;
    cp->next = callbacks;
    callbacks = cp;
+   PushTimer(cp);
+}
+
+/** Register a one-shot timer. */
+void RegisterTimeout(int delay, SignalCallback callback, void *data)
+{
+   CallbackNode *cp = FindCallback(callback, data);
+   if(cp && cp->oneShot && cp->index != NOT_QUEUED) {
+      /* Already pending; re-arm it. */
+      RemoveTimer(cp);
+   } else {
+      cp = Allocate(sizeof(CallbackNode));
+      cp->freq = delay;
+      cp->oneShot = 1;
+      cp->removed = 0;
+      cp->callback = callback;
+      cp->data = data;
+      cp->next = callbacks;
+      callbacks = cp;
+   }
+   GetCurrentTime(&cp->deadline);
+   AdvanceTime(&cp->deadline, delay > 0 ? delay : 0);
+   PushTimer(cp);
+}
+
+/** Cancel a one-shot timer. */
+void UnregisterTimeout(SignalCallback callback, void *data)
+{
+   RemoveCallback(callback, data);
 }
 
 /** Unregister a callback. */
 void UnregisterCallback(SignalCallback callback, void *data)
+{
+   if(!RemoveCallback(callback, data)) {
+      Assert(0);
+   }
+}
+
+/** Find a registered callback. */
+CallbackNode *FindCallback(SignalCallback callback, void *data)
+{
+   CallbackNode *cp;
+   for(cp = callbacks; cp; cp = cp->next) {
+      if(cp->callback == callback && cp->data == data) {
+         return cp;
+      }
+   }
+   return NULL;
+}
+
+/** Remove a callback.
+ * Callbacks that are currently running are released by Signal.
+ * @return 1 if the callback was found, 0 otherwise.
+ */
+char RemoveCallback(SignalCallback callback, void *data)
 {
    CallbackNode **cp;
    for(cp = &callbacks; *cp; cp = &(*cp)->next) {
       if((*cp)->callback == callback && (*cp)->data == data) {
          CallbackNode *temp = *cp;
          *cp = (*cp)->next;
-         Release(temp);
+         if(temp->index != NOT_QUEUED) {
+            RemoveTimer(temp);
+            Release(temp);
+         } else {
+            temp->removed = 1;
+         }
+         return 1;
+      }
+   }
+   return 0;
+}
+
+/** Remove a specific callback from the callback list. */
+void UnlinkCallback(CallbackNode *cp)
+{
+   CallbackNode **np;
+   for(np = &callbacks; *np; np = &(*np)->next) {
+      if(*np == cp) {
+         *np = cp->next;
          return;
       }
    }
-   Assert(0);
 }
 
-/** Restack clients before waiting for an event. */
-void RequireRestack()
+/** Insert a callback into the timer heap. */
+void PushTimer(CallbackNode *cp)
 {
-   restack_pending = 1;
+   if(!timerHeap) {
+      timerCapacity = 16;
+      timerHeap = Allocate(timerCapacity * sizeof(CallbackNode*));
+   } else if(JUNLIKELY(timerCount == timerCapacity)) {
+      timerCapacity *= 2;
+      timerHeap = Reallocate(timerHeap, timerCapacity * sizeof(CallbackNode*));
+   }
+   cp->index = timerCount;
+   timerHeap[timerCount] = cp;
+   timerCount += 1;
+   SiftTimerUp(cp->index);
 }
 
-/** Update the task bar before waiting for an event. */
-void RequireTaskUpdate()
+/** Remove a callback from the timer heap. */
+void RemoveTimer(CallbackNode *cp)
 {
-   task_update_pending = 1;
+   const unsigned int index = cp->index;
+   Assert(index < timerCount && timerHeap[index] == cp);
+   timerCount -= 1;
+   if(index != timerCount) {
+      SwapTimers(index, timerCount);
+      SiftTimerUp(index);
+      SiftTimerDown(index);
+   }
+   cp->index = NOT_QUEUED;
+   if(timerCount == 0 && timerHeap) {
+      Release(timerHeap);
+      timerHeap = NULL;
+      timerCapacity = 0;
+   }
 }
 
-/** Update the pager before waiting for an event. */
-void RequirePagerUpdate()
+/** Move a timer towards the root of the heap. */
+void SiftTimerUp(unsigned int index)
 {
-   pager_update_pending = 1;
+   while(index > 0) {
+      const unsigned int parent = (index - 1) / 2;
+      if(CompareTime(&timerHeap[index]->deadline,
+                     &timerHeap[parent]->deadline) >= 0) {
+         break;
+      }
+      SwapTimers(index, parent);
+      index = parent;
+   }
+}
+
+/** Move a timer towards the leaves of the heap. */
+void SiftTimerDown(unsigned int index)
+{
+   for(;;) {
+      const unsigned int left = index * 2 + 1;
+      const unsigned int right = left + 1;
+      unsigned int best = index;
+      if(left < timerCount && CompareTime(&timerHeap[left]->deadline,
+                                          &timerHeap[best]->deadline) < 0) {
+         best = left;
+      }
+      if(right < timerCount && CompareTime(&timerHeap[right]->deadline,
+                                           &timerHeap[best]->deadline) < 0) {
+         best = right;
+      }
+      if(best == index) {
+         break;
+      }
+      SwapTimers(index, best);
+      index = best;
+   }
+}
+
+/** Swap two entries in the timer heap. */
+void SwapTimers(unsigned int a, unsigned int b)
+{
+   CallbackNode *temp = timerHeap[a];
+   timerHeap[a] = timerHeap[b];
+   timerHeap[b] = temp;
+   timerHeap[a]->index = a;
+   timerHeap[b]->index = b;
+}
+
+/** Do some work once the event queue is drained. */
+void RequireWork(WorkType type)
+{
+   if(!pendingWork) {
+      GetCurrentTime(&lastWork);
+   }
+   pendingWork |= 1 << type;
+}
+
+/** Do the pending deferred work in order.
+ * Work requested by a stage is done in the same pass if the stage for
+ * it comes later and in the next pass otherwise.
+ */
+void DoWork(void)
+{
+   StatsTime start;
+   unsigned int type;
+   for(type = 0; type < WORK_COUNT; type++) {
+      const unsigned int mask = 1 << type;
+      const WorkStage *sp = &WORK_STAGES[type];
+      if(!(pendingWork & mask)) {
+         continue;
+      }
+      pendingWork &= ~mask;
+      if(JUNLIKELY(!sp->Flush)) {
+         continue;
+      }
+      start = StartStats();
+      (sp->Flush)();
+      if(sp->section != SECTION_COUNT) {
+         RecordSectionStats(sp->section, start);
+      }
+   }
 }
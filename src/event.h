@@ -17,6 +17,12 @@ typedef void (*SignalCallback)(const struct TimeType *now,
                                Window w,
                                void *data);
 
+/** Callback for a file descriptor that is ready to read.
+ * @param fd The file descriptor.
+ * @param data The data passed to RegisterFileWatch.
+ */
+typedef void (*FileCallback)(int fd, void *data);
+
 /** Last event time. */
 extern Time eventTime;
 
@@ -39,6 +45,26 @@ void DiscardButtonEvents(void);
  */
 void DiscardMotionEvents(XEvent *event, Window w);
 
+/** Limit motion events to a frame rate.
+ * Events arriving within a frame of the last one are held back and the
+ * latest of them is put back on the queue when the frame ends.
+ * @param event The motion event.
+ * @param rate The maximum number of events per second (0 for no limit).
+ * @return 1 if the event was held back and should be ignored.
+ */
+char DeferMotionEvent(const XEvent *event, unsigned int rate);
+
+/** Deliver held back motion ahead of another event.
+ * If motion is held back, both are put back on the queue with the
+ * motion first.
+ * @param event The event that should follow the motion.
+ * @return 1 if the event was put back and should be ignored.
+ */
+char ReplayMotionEvent(const XEvent *event);
+
+/** Drop held back motion. */
+void CancelMotionEvents(void);
+
 /** Discard excess key events.
  * @param event The event to return.
  * @param w The window whose events to discard.
@@ -50,8 +76,9 @@ void DiscardKeyEvents(XEvent *event, Window w);
  */
 void UpdateTime(const XEvent *event);
 
-/** Register a callback.
- * @param freq The frequency in milliseconds.
+/** Register a periodic callback.
+ * The callback runs as soon as possible and then every freq milliseconds.
+ * @param freq The frequency in milliseconds (0 for as often as possible).
  * @param callback The callback function.
  * @param data Data to pass to the callback.
  */
@@ -63,14 +90,73 @@ void RegisterCallback(int freq, SignalCallback callback, void *data);
  */
 void UnregisterCallback(SignalCallback callback, void *data);
 
+/** Register a one-shot timer.
+ * The callback runs once after the delay and is then removed.
+ * Registering a timer that is already pending re-arms it.
+ * @param delay The delay in milliseconds.
+ * @param callback The callback function.
+ * @param data Data to pass to the callback.
+ */
+void RegisterTimeout(int delay, SignalCallback callback, void *data);
+
+/** Cancel a one-shot timer.
+ * It is safe to call this for a timer that has already run.
+ * @param callback The callback to cancel.
+ * @param data The data passed to the register function.
+ */
+void UnregisterTimeout(SignalCallback callback, void *data);
+
+/** Watch a file descriptor from the event loop.
+ * The callback runs whenever the descriptor is ready to read.
+ * Registering a descriptor that is already watched replaces the callback.
+ * @param fd The file descriptor.
+ * @param callback The callback function.
+ * @param data Data to pass to the callback.
+ */
+void RegisterFileWatch(int fd, FileCallback callback, void *data);
+
+/** Stop watching a file descriptor.
+ * This must be called before the descriptor is closed.
+ * @param fd The file descriptor.
+ */
+void UnregisterFileWatch(int fd);
+
+/** Work deferred until the event queue is drained.
+ * Pending work is done in this order.
+ */
+typedef enum {
+   WORK_SCREENS,     /**< Apply a monitor configuration change. */
+   WORK_STATES,      /**< Write client state properties. */
+   WORK_DOCK,        /**< Lay out the dock. */
+   WORK_SHAPES,      /**< Apply client shape changes. */
+   WORK_RESTACK,     /**< Restack clients. */
+   WORK_BORDERS,     /**< Draw client borders. */
+   WORK_TASKBAR,     /**< Update the task bar. */
+   WORK_PAGER,       /**< Update the pager. */
+   WORK_COUNT
+} WorkType;
+
+/** Do some work once the event queue is drained.
+ * If events keep arriving, the work is done at least every
+ * WORK_BUDGET milliseconds.
+ * @param type The work to do.
+ */
+void RequireWork(WorkType type);
+
+/** Write client state properties before waiting for an event. */
+#define RequireStateUpdate()  RequireWork(WORK_STATES)
+
+/** Lay out the dock before waiting for an event. */
+#define RequireDockUpdate()   RequireWork(WORK_DOCK)
+
 /** Restack clients before waiting for an event. */
-void RequireRestack();
+#define RequireRestack()      RequireWork(WORK_RESTACK)
 
 /** Update the task bar before waiting for an event. */
-void RequireTaskUpdate();
+#define RequireTaskUpdate()   RequireWork(WORK_TASKBAR)
 
 /** Update the pager before waiting for an event. */
-void RequirePagerUpdate();
+#define RequirePagerUpdate()  RequireWork(WORK_PAGER)
 
 #endif /* EVENT_H */
 
@@ -0,0 +1,108 @@
+/**
+ * @file expose.c
+ * @author Joe Wingbermuehle
+ * @date 2026
+ *
+ * @brief Accumulation of exposed areas.
+ *
+ * The areas of a sequence of expose events are collected into a region
+ * so that windows backed by a pixmap can copy or redraw only the union
+ * once the last event of the sequence arrives.
+ *
+ */
+
+#include "jwm.h"
+#include "expose.h"
+#include "main.h"
+
+/** Region being exposed in a window. */
+typedef struct ExposeNode {
+   Window window;
+   Region region;
+   char complete;             /**< Set once the last event was added. */
+   struct ExposeNode *next;
+} ExposeNode;
+
+static ExposeNode *exposes = NULL;
+
+/** Release regions that are still being accumulated. */
+void ShutdownExpose(void)
+{
+   while(exposes) {
+      ExposeNode *ep = exposes->next;
+      JXDestroyRegion(exposes->region);
+      Release(exposes);
+      exposes = ep;
+   }
+}
+
+/** Add the area of an expose event to the region exposed in its window. */
+char AddExposeArea(const XExposeEvent *event)
+{
+   ExposeNode **prev;
+   ExposeNode *ep;
+   XRectangle rect;
+
+   /* Regions completed by earlier events have been used by now. */
+   ep = NULL;
+   prev = &exposes;
+   while(*prev) {
+      ExposeNode *np = *prev;
+      if(np->complete) {
+         *prev = np->next;
+         JXDestroyRegion(np->region);
+         Release(np);
+      } else {
+         if(np->window == event->window) {
+            ep = np;
+         }
+         prev = &np->next;
+      }
+   }
+
+   if(!ep) {
+      ep = Allocate(sizeof(ExposeNode));
+      ep->window = event->window;
+      ep->region = JXCreateRegion();
+      ep->complete = 0;
+      ep->next = exposes;
+      exposes = ep;
+   }
+
+   rect.x = event->x;
+   rect.y = event->y;
+   rect.width = event->width;
+   rect.height = event->height;
+   JXUnionRectWithRegion(&rect, ep->region, ep->region);
+
+   if(event->count == 0) {
+      ep->complete = 1;
+      return 1;
+   }
+   return 0;
+}
+
+/** Get the region exposed in a window by the last complete sequence. */
+Region GetExposeRegion(Window w)
+{
+   ExposeNode *ep;
+   for(ep = exposes; ep; ep = ep->next) {
+      if(ep->window == w && ep->complete) {
+         return ep->region;
+      }
+   }
+   return NULL;
+}
+
+/** Copy the exposed part of a pixmap to a window. */
+void CopyExposedArea(Pixmap pixmap, Window w, Region region,
+                     unsigned int width, unsigned int height)
+{
+   if(region) {
+      JXSetRegion(display, rootGC, region);
+   }
+   JXCopyArea(display, pixmap, w, rootGC, 0, 0, width, height, 0, 0);
+   if(region) {
+      JXSetClipMask(display, rootGC, None);
+   }
+}
@@ -0,0 +1,39 @@
+/**
+ * @file expose.h
+ * @author Joe Wingbermuehle
+ * @date 2026
+ *
+ * @brief Accumulation of exposed areas.
+ *
+ */
+
+#ifndef EXPOSE_H
+#define EXPOSE_H
+
+/** Release regions that are still being accumulated. */
+void ShutdownExpose(void);
+
+/** Add the area of an expose event to the region exposed in its window.
+ * @param event The expose event.
+ * @return 1 if this was the last event of the sequence, 0 otherwise.
+ */
+char AddExposeArea(const XExposeEvent *event);
+
+/** Get the region exposed in a window by the last complete sequence.
+ * The region is only valid until the next call to AddExposeArea.
+ * @param w The window.
+ * @return The region (NULL if unknown, in which case redraw everything).
+ */
+Region GetExposeRegion(Window w);
+
+/** Copy the exposed part of a pixmap to a window.
+ * @param pixmap The pixmap holding the window contents.
+ * @param w The window.
+ * @param region The exposed region (NULL to copy everything).
+ * @param width The width of the pixmap.
+ * @param height The height of the pixmap.
+ */
+void CopyExposedArea(Pixmap pixmap, Window w, Region region,
+                     unsigned int width, unsigned int height);
+
+#endif /* EXPOSE_H */
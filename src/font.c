@@ -48,8 +48,68 @@ static const struct {
    { FONT_TRAY, FONT_TRAYBUTTON  }
 };
 
+/** Number of strings to keep laid out. */
+#define TEXT_CACHE_SIZE 256
+
+/** Number of hash buckets for laid out strings. */
+#define TEXT_HASH_SIZE 128
+
+/** A string laid out in a font.
+ * These are kept in a hash table and in least recently used order.
+ */
+typedef struct TextNode {
+   char *text;                   /**< The string as passed in. */
+#ifdef USE_PANGO
+   PangoLayout *layout;          /**< Layout of the string. */
+   PangoLayoutLine *line;        /**< The line to render. */
+#else
+   char *utf8;                   /**< The string in UTF-8. */
+   int length;                   /**< Length of the UTF-8 string. */
+#endif
+   int width;                    /**< Maximum width (-1 for no limit). */
+   int extent;                   /**< Width of the string in pixels. */
+   unsigned int hash;            /**< Hash of the font, width, and text. */
+   FontType font;                /**< The font. */
+   struct TextNode *next;        /**< Next node in the hash bucket. */
+   struct TextNode *newer;       /**< More recently used node. */
+   struct TextNode *older;       /**< Less recently used node. */
+} TextNode;
+
+#ifdef USE_PANGO
+
+/** Number of drawables to keep Xft draw handles for. */
+#define FONT_TARGET_COUNT 4
+
+/** Xft draw handle for a drawable. */
+typedef struct FontTarget {
+   Drawable drawable;
+   XftDraw *xd;
+} FontTarget;
+
+static FontTarget fontTargets[FONT_TARGET_COUNT];
+static unsigned int nextFontTarget = 0;
+
+static XftDraw *GetFontTarget(Drawable d);
+
+#else
+
+static GC fontGC = None;
+
+#endif
+
+static TextNode *textHash[TEXT_HASH_SIZE];
+static TextNode *newestText = NULL;
+static TextNode *oldestText = NULL;
+static unsigned int textCount = 0;
+
 static char *GetUTF8String(const char *str);
+#ifdef USE_PANGO
 static void ReleaseUTF8String(char *utf8String);
+#endif
+static TextNode *GetTextNode(FontType ft, const char *str, int width);
+static unsigned int GetTextHash(FontType ft, const char *str, int width);
+static void LayoutText(TextNode *tp);
+static void DestroyTextNode(TextNode *tp);
 
 #ifdef USE_ICONV
 static const char *UTF8_CODESET = "UTF-8";
@@ -68,9 +128,18 @@ static XFontStruct *fonts[FONT_COUNT];
 #endif
 static char *fontNames[FONT_COUNT];
 
+/* Fonts are loaded on first use. Components with the same font
+ * description share the handle of the first one loaded. */
+static FontType fontOwners[FONT_COUNT];
+
 #ifdef USE_PANGO
 static int IsXlfd(const char *str);
 #endif
+static void LoadFont(FontType ft);
+
+/** Make sure a font is loaded before it is used. */
+#define RequireFont( ft ) \
+   do { if(JUNLIKELY(!fonts[ft])) { LoadFont(ft); } } while(0)
 
 /** Initialize font data. */
 void InitializeFonts(void)
@@ -83,7 +152,14 @@ void InitializeFonts(void)
    for(x = 0; x < FONT_COUNT; x++) {
       fonts[x] = NULL;
       fontNames[x] = NULL;
+      fontOwners[x] = x;
    }
+   for(x = 0; x < TEXT_HASH_SIZE; x++) {
+      textHash[x] = NULL;
+   }
+   newestText = NULL;
+   oldestText = NULL;
+   textCount = 0;
 
    /* Allocate a conversion descriptor if we're not using UTF-8. */
 #ifdef USE_ICONV
@@ -114,96 +190,157 @@ void StartupFonts(void)
       }
    }
 
-#ifdef USE_PANGO
-   font_map = pango_xft_get_font_map(display, rootScreen);
-#  if PANGO_VERSION_CHECK(1, 22, 0)
-   font_context = pango_font_map_create_context(font_map);
-#  else
-   font_context = pango_context_new();
-   pango_context_set_font_map(font_context, font_map);
-#  endif
+#ifndef USE_PANGO
+   {
+      XGCValues gcValues;
+      gcValues.graphics_exposures = False;
+      fontGC = JXCreateGC(display, rootWindow, GCGraphicsExposures,
+                          &gcValues);
+   }
 #endif
 
-   for(x = 0; x < FONT_COUNT; x++) {
-#ifdef USE_PANGO
-      XftFont *font = NULL;
-      if(fontNames[x]) {
-         if(IsXlfd(fontNames[x])) {
-            font = JXftFontOpenXlfd(display, rootScreen, fontNames[x]);
-         }
-         if(!font) {
-            font = JXftFontOpenName(display, rootScreen, fontNames[x]);
-         }
-         if(JUNLIKELY(!font)) {
-            Warning(_("could not load font: %s"), fontNames[x]);
-         }
-      }
-      if(!font) {
-         font = JXftFontOpenName(display, rootScreen, DEFAULT_FONT);
-      }
-      if(JLIKELY(font)) {
-         PangoFontMetrics *metrics;
-         PangoFontDescription *desc;
-
-         desc = pango_fc_font_description_from_pattern(font->pattern, TRUE);
-         JXftFontClose(display, font);
-
-         fonts[x] = pango_layout_new(font_context);
-         pango_layout_set_font_description(fonts[x], desc);
+}
 
-         pango_layout_set_single_paragraph_mode(fonts[x], TRUE);
-         pango_layout_set_width(fonts[x], -1);
-         pango_layout_set_ellipsize(fonts[x], PANGO_ELLIPSIZE_MIDDLE);
+/** Shutdown font support. */
+void ShutdownFonts(void)
+{
+   unsigned int x;
 
-         metrics = pango_context_get_metrics(font_context, desc, NULL);
-         font_ascents[x] = pango_font_metrics_get_ascent(metrics);
-         font_heights[x] = font_ascents[x]
-            + pango_font_metrics_get_descent(metrics);
+   while(oldestText) {
+      DestroyTextNode(oldestText);
+   }
+   Assert(textCount == 0);
 
-         pango_font_description_free(desc);
-         pango_font_metrics_unref(metrics);
-        
-      } else {
-        font_ascents[x] = 0;
-        font_heights[x] = 0;
-      }
-#else /* USE_PANGO */
-      if(fontNames[x]) {
-         fonts[x] = JXLoadQueryFont(display, fontNames[x]);
-         if(JUNLIKELY(!fonts[x] && fontNames[x])) {
-            Warning(_("could not load font: %s"), fontNames[x]);
-         }
-      }
-      if(!fonts[x]) {
-         fonts[x] = JXLoadQueryFont(display, DEFAULT_FONT);
+#ifdef USE_PANGO
+   for(x = 0; x < FONT_TARGET_COUNT; x++) {
+      if(fontTargets[x].xd) {
+         JXftDrawDestroy(fontTargets[x].xd);
+         fontTargets[x].xd = NULL;
+         fontTargets[x].drawable = None;
       }
-#endif /* USE_PANGO */
-      if(JUNLIKELY(!fonts[x])) {
-         FatalError(_("could not load the default font: %s"), DEFAULT_FONT);
+   }
+#else
+   if(fontGC != None) {
+      JXFreeGC(display, fontGC);
+      fontGC = None;
+   }
+#endif
+
+   for(x = 0; x < FONT_COUNT; x++) {
+      if(fonts[x] && fontOwners[x] == x) {
+#ifdef USE_PANGO
+         g_object_unref(fonts[x]);
+#else
+         JXFreeFont(display, fonts[x]);
+#endif
       }
+      fonts[x] = NULL;
+      fontOwners[x] = x;
    }
 
+#ifdef USE_PANGO
+   if(font_context) {
+      g_object_unref(font_context);
+      font_context = NULL;
+   }
+#endif
 }
 
-/** Shutdown font support. */
-void ShutdownFonts(void)
+/** Load the font for a component.
+ * This shares the font of another component with the same description
+ * if that has already been loaded.
+ */
+void LoadFont(FontType ft)
 {
+   const char *name = fontNames[ft];
    unsigned int x;
+#ifdef USE_PANGO
+   XftFont *font = NULL;
+#endif
+
+   Assert(!fonts[ft]);
+
    for(x = 0; x < FONT_COUNT; x++) {
-      if(fonts[x]) {
+      if(fonts[x] && fontOwners[x] == x) {
+         const char *other = fontNames[x];
+         if(name == other || (name && other && !strcmp(name, other))) {
+            fonts[ft] = fonts[x];
+            fontOwners[ft] = x;
 #ifdef USE_PANGO
-         g_object_unref(fonts[x]);
-         fonts[x] = NULL;
-#else
-         JXFreeFont(display, fonts[x]);
-         fonts[x] = NULL;
+            font_ascents[ft] = font_ascents[x];
+            font_heights[ft] = font_heights[x];
 #endif
+            return;
+         }
       }
    }
+   fontOwners[ft] = ft;
 
 #ifdef USE_PANGO
-   g_object_unref(font_context);
-#endif
+   if(!font_context) {
+      font_map = pango_xft_get_font_map(display, rootScreen);
+#  if PANGO_VERSION_CHECK(1, 22, 0)
+      font_context = pango_font_map_create_context(font_map);
+#  else
+      font_context = pango_context_new();
+      pango_context_set_font_map(font_context, font_map);
+#  endif
+   }
+
+   if(name) {
+      if(IsXlfd(name)) {
+         font = JXftFontOpenXlfd(display, rootScreen, name);
+      }
+      if(!font) {
+         font = JXftFontOpenName(display, rootScreen, name);
+      }
+      if(JUNLIKELY(!font)) {
+         Warning(_("could not load font: %s"), name);
+      }
+   }
+   if(!font) {
+      font = JXftFontOpenName(display, rootScreen, DEFAULT_FONT);
+   }
+   if(JLIKELY(font)) {
+      PangoFontMetrics *metrics;
+      PangoFontDescription *desc;
+
+      desc = pango_fc_font_description_from_pattern(font->pattern, TRUE);
+      JXftFontClose(display, font);
+
+      fonts[ft] = pango_layout_new(font_context);
+      pango_layout_set_font_description(fonts[ft], desc);
+
+      pango_layout_set_single_paragraph_mode(fonts[ft], TRUE);
+      pango_layout_set_width(fonts[ft], -1);
+      pango_layout_set_ellipsize(fonts[ft], PANGO_ELLIPSIZE_MIDDLE);
+
+      metrics = pango_context_get_metrics(font_context, desc, NULL);
+      font_ascents[ft] = pango_font_metrics_get_ascent(metrics);
+      font_heights[ft] = font_ascents[ft]
+         + pango_font_metrics_get_descent(metrics);
+
+      pango_font_description_free(desc);
+      pango_font_metrics_unref(metrics);
+
+   } else {
+      font_ascents[ft] = 0;
+      font_heights[ft] = 0;
+   }
+#else /* USE_PANGO */
+   if(name) {
+      fonts[ft] = JXLoadQueryFont(display, name);
+      if(JUNLIKELY(!fonts[ft])) {
+         Warning(_("could not load font: %s"), name);
+      }
+   }
+   if(!fonts[ft]) {
+      fonts[ft] = JXLoadQueryFont(display, DEFAULT_FONT);
+   }
+#endif /* USE_PANGO */
+   if(JUNLIKELY(!fonts[ft])) {
+      FatalError(_("could not load the default font: %s"), DEFAULT_FONT);
+   }
 }
 
 /** Destroy font data. */
@@ -301,6 +438,7 @@ char *GetUTF8String(const char *str)
 }
 
 /** Release a UTF-8 string. */
+#ifdef USE_PANGO
 void ReleaseUTF8String(char *utf8String)
 {
 #ifdef USE_ICONV
@@ -309,38 +447,155 @@ void ReleaseUTF8String(char *utf8String)
    }
 #endif
 }
+#endif
 
-/** Get the width of a string. */
-int GetStringWidth(FontType ft, const char *str)
+/** Get a string laid out in a font, laying it out if needed. */
+TextNode *GetTextNode(FontType ft, const char *str, int width)
 {
-   char *utf8String;
-   int result;
+   const unsigned int hash = GetTextHash(ft, str, width);
+   TextNode **tpp = &textHash[hash % TEXT_HASH_SIZE];
+   TextNode *tp;
+
+   RequireFont(ft);
+   for(tp = *tpp; tp; tp = tp->next) {
+      if(  tp->hash == hash && tp->font == ft && tp->width == width
+         && !strcmp(tp->text, str)) {
+
+         /* Move to the front of the list. */
+         if(tp->newer) {
+            tp->newer->older = tp->older;
+            if(tp->older) {
+               tp->older->newer = tp->newer;
+            } else {
+               oldestText = tp->newer;
+            }
+            tp->older = newestText;
+            tp->newer = NULL;
+            newestText->newer = tp;
+            newestText = tp;
+         }
+         return tp;
+
+      }
+   }
 
+   if(textCount >= TEXT_CACHE_SIZE) {
+      DestroyTextNode(oldestText);
+   }
+
+   tp = Allocate(sizeof(TextNode));
+   tp->text = CopyString(str);
+   tp->font = ft;
+   tp->width = width;
+   tp->hash = hash;
+   LayoutText(tp);
+
+   tp->next = *tpp;
+   *tpp = tp;
+   tp->newer = NULL;
+   tp->older = newestText;
+   if(newestText) {
+      newestText->newer = tp;
+   } else {
+      oldestText = tp;
+   }
+   newestText = tp;
+   textCount += 1;
+
+   return tp;
+}
+
+/** Get the hash of a string laid out in a font. */
+unsigned int GetTextHash(FontType ft, const char *str, int width)
+{
+   unsigned int hash = 2166136261U;
+   while(*str) {
+      hash = (hash ^ (unsigned char)*str) * 16777619U;
+      str += 1;
+   }
+   hash = (hash ^ ft) * 16777619U;
+   hash = (hash ^ (unsigned int)width) * 16777619U;
+   return hash;
+}
+
+/** Lay out a string and measure it. */
+void LayoutText(TextNode *tp)
+{
+   char *utf8String;
 #ifdef USE_PANGO
    PangoRectangle rect;
 #endif
 
    /* Convert to UTF-8 if necessary. */
-   utf8String = GetUTF8String(str);
+   utf8String = GetUTF8String(tp->text);
 
 #ifdef USE_PANGO
-   pango_layout_set_text(fonts[ft], utf8String, -1);
-   pango_layout_set_width(fonts[ft], -1);
-   pango_layout_get_extents(fonts[ft], NULL, &rect);
-   result = (rect.width + PANGO_SCALE - 1) / PANGO_SCALE;
+   tp->layout = pango_layout_copy(fonts[tp->font]);
+   pango_layout_set_width(tp->layout,
+                          tp->width < 0 ? -1 : tp->width * PANGO_SCALE);
+   pango_layout_set_text(tp->layout, utf8String, -1);
+   pango_layout_get_extents(tp->layout, NULL, &rect);
+   tp->extent = (rect.width + PANGO_SCALE - 1) / PANGO_SCALE;
+#  if PANGO_VERSION_CHECK(1, 16, 0)
+   tp->line = pango_layout_get_line_readonly(tp->layout, 0);
+#  else
+   tp->line = pango_layout_get_line(tp->layout, 0);
+#  endif
+   ReleaseUTF8String(utf8String);
 #else
-   result = XTextWidth(fonts[ft], utf8String, strlen(utf8String));
+   /* Keep the converted string for rendering. */
+   if(utf8String == tp->text) {
+      tp->utf8 = tp->text;
+   } else {
+      tp->utf8 = utf8String;
+   }
+   tp->length = strlen(tp->utf8);
+   tp->extent = XTextWidth(fonts[tp->font], tp->utf8, tp->length);
 #endif
+}
 
-   /* Clean up. */
-   ReleaseUTF8String(utf8String);
+/** Remove a string from the cache. */
+void DestroyTextNode(TextNode *tp)
+{
+   TextNode **tpp;
 
-   return result;
+   for(tpp = &textHash[tp->hash % TEXT_HASH_SIZE]; *tpp != tp;
+       tpp = &(*tpp)->next);
+   *tpp = tp->next;
+
+   if(tp->newer) {
+      tp->newer->older = tp->older;
+   } else {
+      newestText = tp->older;
+   }
+   if(tp->older) {
+      tp->older->newer = tp->newer;
+   } else {
+      oldestText = tp->newer;
+   }
+   textCount -= 1;
+
+#ifdef USE_PANGO
+   g_object_unref(tp->layout);
+#else
+   if(tp->utf8 != tp->text) {
+      Release(tp->utf8);
+   }
+#endif
+   Release(tp->text);
+   Release(tp);
+}
+
+/** Get the width of a string. */
+int GetStringWidth(FontType ft, const char *str)
+{
+   return GetTextNode(ft, str, -1)->extent;
 }
 
 /** Get the height of a string. */
 int GetStringHeight(FontType ft)
 {
+   RequireFont(ft);
 #ifdef USE_PANGO
    return PANGO_PIXELS(font_heights[ft]);
 #else
@@ -366,17 +621,9 @@ void RenderString(Drawable d, FontType font, ColorType color,
                   int x, int y, int width, const char *str)
 {
    XRectangle rect;
-   Region renderRegion;
-   int len;
-   char *utf8String;
+   const TextNode *tp;
 #ifdef USE_PANGO
    XftDraw *xd;
-   PangoLayoutLine *line;
-   XftColor *xc;
-#else
-   XGCValues gcValues;
-   unsigned long gcMask;
-   GC gc;
 #endif
 
    /* Early return for empty strings. */
@@ -384,55 +631,75 @@ void RenderString(Drawable d, FontType font, ColorType color,
       return;
    }
 
-   /* Convert to UTF-8 if necessary. */
-   utf8String = GetUTF8String(str);
-   len = strlen(utf8String);
-
    /* Get the bounds for the string based on the specified width. */
    rect.x = x;
    rect.y = y;
    rect.height = GetStringHeight(font);
    rect.width = width + 2;
 
-   /* Combine the width bounds with the region to use. */
-   renderRegion = XCreateRegion();
-   XUnionRectWithRegion(&rect, renderRegion, renderRegion);
-
 #ifdef USE_PANGO
 
-   pango_layout_set_text(fonts[font], str, -1);
-   pango_layout_set_width(fonts[font], width * PANGO_SCALE);
-
-   xd = XftDrawCreate(display, d, rootVisual, rootColormap);
-   JXftDrawSetClip(xd, renderRegion);
-   xc = GetXftColor(color);
-#  if PANGO_VERSION_CHECK(1, 16, 0)
-   line = pango_layout_get_line_readonly(fonts[font], 0);
-#  else
-   line = pango_layout_get_line(fonts[font], 0);
-#  endif
-   pango_xft_render_layout_line(xd, xc, line, x * PANGO_SCALE,
-      y * PANGO_SCALE + font_ascents[font]);
+   tp = GetTextNode(font, str, width);
+   xd = GetFontTarget(d);
+   JXftDrawSetClipRectangles(xd, 0, 0, &rect, 1);
+   pango_xft_render_layout_line(xd, GetXftColor(color), tp->line,
+      x * PANGO_SCALE, y * PANGO_SCALE + font_ascents[font]);
 
-   JXftDrawDestroy(xd);
 #else
 
-   gcMask = GCGraphicsExposures;
-   gcValues.graphics_exposures = False;
-   gc = JXCreateGC(display, d, gcMask, &gcValues);
+   /* The width of core fonts does not depend on the limit. */
+   tp = GetTextNode(font, str, -1);
 
    /* Display the string. */
-   JXSetForeground(display, gc, colors[color]);
-   JXSetRegion(display, gc, renderRegion);
-   JXSetFont(display, gc, fonts[font]->fid);
-   JXDrawString(display, d, gc, x, y + fonts[font]->ascent, utf8String, len);
+   JXSetForeground(display, fontGC, colors[color]);
+   JXSetClipRectangles(display, fontGC, 0, 0, &rect, 1, Unsorted);
+   JXSetFont(display, fontGC, fonts[font]->fid);
+   JXDrawString(display, d, fontGC, x, y + fonts[font]->ascent,
+                tp->utf8, tp->length);
 
-   JXFreeGC(display, gc);
 #endif
 
-   XDestroyRegion(renderRegion);
+}
 
-   /* Free any memory used for UTF conversion. */
-   ReleaseUTF8String(utf8String);
+#ifdef USE_PANGO
 
+/** Get the Xft draw handle for a drawable.
+ * Handles are kept for the most recently used drawables, so drawables
+ * must be released with ReleaseFontTarget before they are freed.
+ */
+XftDraw *GetFontTarget(Drawable d)
+{
+   FontTarget *tp;
+   unsigned int x;
+
+   for(x = 0; x < FONT_TARGET_COUNT; x++) {
+      if(fontTargets[x].drawable == d && fontTargets[x].xd) {
+         return fontTargets[x].xd;
+      }
+   }
+
+   tp = &fontTargets[nextFontTarget];
+   nextFontTarget = (nextFontTarget + 1) % FONT_TARGET_COUNT;
+   if(tp->xd) {
+      JXftDrawChange(tp->xd, d);
+   } else {
+      tp->xd = JXftDrawCreate(display, d, rootVisual, rootColormap);
+   }
+   tp->drawable = d;
+   return tp->xd;
 }
+
+/** Release the Xft draw handle for a drawable. */
+void ReleaseFontTarget(Drawable d)
+{
+   unsigned int x;
+   for(x = 0; x < FONT_TARGET_COUNT; x++) {
+      if(fontTargets[x].drawable == d && fontTargets[x].xd) {
+         JXftDrawDestroy(fontTargets[x].xd);
+         fontTargets[x].drawable = None;
+         fontTargets[x].xd = NULL;
+      }
+   }
+}
+
+#endif /* USE_PANGO */
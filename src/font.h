@@ -47,6 +47,16 @@ void SetFont(FontType type, const char *name);
 void RenderString(Drawable d, FontType font, ColorType color,
                   int x, int y, int width, const char *str);
 
+/** Release the resources used to render text on a drawable.
+ * This must be called before freeing a drawable that text was rendered on.
+ * @param d The drawable.
+ */
+#ifdef USE_PANGO
+void ReleaseFontTarget(Drawable d);
+#else
+#define ReleaseFontTarget( d ) ((void)0)
+#endif
+
 /** Get the width of a string.
  * @param ft The font used to determine the width.
  * @param str The string whose width to get.
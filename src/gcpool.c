@@ -0,0 +1,146 @@
+/**
+ * @file gcpool.c
+ * @author Joe Wingbermuehle
+ * @date 2026
+ *
+ * @brief Pool of graphics contexts.
+ *
+ * Creating a graphics context is a server request, so contexts used
+ * while drawing are kept and handed out again to users that need the
+ * same depth and attributes.
+ *
+ */
+
+#include "jwm.h"
+#include "gcpool.h"
+#include "main.h"
+
+/** Maximum number of pooled graphics contexts. */
+#define GC_POOL_SIZE 16
+
+/** Attributes restored when a graphics context is released. */
+#define GC_RESTORE_MASK (GC_POOL_MASK | GCLineStyle | GCCapStyle \
+                         | GCJoinStyle | GCFillStyle)
+
+/** A pooled graphics context. */
+typedef struct PooledGC {
+   GC gc;               /**< The graphics context. */
+   int depth;           /**< Depth of the drawables it works with. */
+   int function;        /**< GCFunction value. */
+   int subwindowMode;   /**< GCSubwindowMode value. */
+   int lineWidth;       /**< GCLineWidth value. */
+   char used;           /**< Set if acquired. */
+} PooledGC;
+
+static PooledGC pool[GC_POOL_SIZE];
+static unsigned int poolCount = 0;
+
+static GC CreatePooledGC(int depth, XGCValues *values);
+static void RestorePooledGC(const PooledGC *pp);
+
+/** Release the pooled graphics contexts. */
+void ShutdownGCPool(void)
+{
+   unsigned int x;
+   for(x = 0; x < poolCount; x++) {
+      Assert(!pool[x].used);
+      JXFreeGC(display, pool[x].gc);
+   }
+   poolCount = 0;
+}
+
+/** Get a graphics context from the pool. */
+GC AcquireGC(int depth, unsigned long mask, const XGCValues *values)
+{
+   XGCValues key;
+   PooledGC *pp;
+   unsigned int x;
+
+   Assert(!(mask & ~GC_POOL_MASK));
+
+   /* Fill in the defaults for attributes that were not given. */
+   key.function = (mask & GCFunction) ? values->function : GXcopy;
+   key.subwindow_mode = (mask & GCSubwindowMode)
+                      ? values->subwindow_mode : ClipByChildren;
+   key.line_width = (mask & GCLineWidth) ? values->line_width : 0;
+
+   for(x = 0; x < poolCount; x++) {
+      pp = &pool[x];
+      if(  !pp->used && pp->depth == depth
+         && pp->function == key.function
+         && pp->subwindowMode == key.subwindow_mode
+         && pp->lineWidth == key.line_width) {
+         pp->used = 1;
+         return pp->gc;
+      }
+   }
+
+   /* When the pool is full, the context is freed on release. */
+   if(JUNLIKELY(poolCount >= GC_POOL_SIZE)) {
+      return CreatePooledGC(depth, &key);
+   }
+
+   pp = &pool[poolCount];
+   poolCount += 1;
+   pp->gc = CreatePooledGC(depth, &key);
+   pp->depth = depth;
+   pp->function = key.function;
+   pp->subwindowMode = key.subwindow_mode;
+   pp->lineWidth = key.line_width;
+   pp->used = 1;
+   return pp->gc;
+}
+
+/** Return a graphics context to the pool. */
+void ReleaseGC(GC gc)
+{
+   unsigned int x;
+   for(x = 0; x < poolCount; x++) {
+      if(pool[x].gc == gc) {
+         Assert(pool[x].used);
+         RestorePooledGC(&pool[x]);
+         pool[x].used = 0;
+         return;
+      }
+   }
+   JXFreeGC(display, gc);
+}
+
+/** Restore the attributes of a pooled graphics context.
+ * The values are cached by Xlib, so checking them is not a round trip.
+ */
+void RestorePooledGC(const PooledGC *pp)
+{
+   XGCValues values;
+   JXGetGCValues(display, pp->gc, GC_RESTORE_MASK, &values);
+   if(  values.function != pp->function
+      || values.subwindow_mode != pp->subwindowMode
+      || values.line_width != pp->lineWidth
+      || values.line_style != LineSolid || values.cap_style != CapButt
+      || values.join_style != JoinMiter || values.fill_style != FillSolid) {
+      values.function = pp->function;
+      values.subwindow_mode = pp->subwindowMode;
+      values.line_width = pp->lineWidth;
+      values.line_style = LineSolid;
+      values.cap_style = CapButt;
+      values.join_style = JoinMiter;
+      values.fill_style = FillSolid;
+      JXChangeGC(display, pp->gc, GC_RESTORE_MASK, &values);
+   }
+}
+
+/** Create a graphics context for drawables of a depth. */
+GC CreatePooledGC(int depth, XGCValues *values)
+{
+   GC gc;
+   if(depth == rootDepth) {
+      gc = JXCreateGC(display, rootWindow, GC_POOL_MASK, values);
+   } else {
+      /* A context can be used with any drawable of the depth it was
+       * created for, so the pixmap is not needed afterwards. */
+      const Pixmap temp = JXCreatePixmap(display, rootWindow, 1, 1, depth);
+      gc = JXCreateGC(display, temp, GC_POOL_MASK, values);
+      JXFreePixmap(display, temp);
+   }
+   return gc;
+}
@@ -0,0 +1,36 @@
+/**
+ * @file gcpool.h
+ * @author Joe Wingbermuehle
+ * @date 2026
+ *
+ * @brief Pool of graphics contexts.
+ *
+ */
+
+#ifndef GCPOOL_H
+#define GCPOOL_H
+
+/** Attributes that select a pooled graphics context. */
+#define GC_POOL_MASK (GCFunction | GCSubwindowMode | GCLineWidth)
+
+/** Release the pooled graphics contexts. */
+void ShutdownGCPool(void);
+
+/** Get a graphics context from the pool.
+ * Colors are left as the last user set them, so they must be set before
+ * drawing. Users that set a clip must remove it before releasing the
+ * context.
+ * @param depth The depth of the drawables to be used.
+ * @param mask The attributes to set (a subset of GC_POOL_MASK).
+ * @param values The attribute values.
+ * @return The graphics context, which must be released with ReleaseGC.
+ */
+GC AcquireGC(int depth, unsigned long mask, const XGCValues *values);
+
+/** Return a graphics context to the pool.
+ * Line and fill attributes changed by the user are restored.
+ * @param gc The graphics context from AcquireGC.
+ */
+void ReleaseGC(GC gc);
+
+#endif /* GCPOOL_H */
@@ -9,13 +9,16 @@
 
 #include "jwm.h"
 #include "main.h"
+#include "stats.h"
 
 static unsigned int grabCount = 0;
+static StatsTime grabStart;
 
 /** Grab the server and sync. */
 void GrabServer(void)
 {
    if(grabCount == 0) {
+      grabStart = StartStats();
       JXGrabServer(display);
       JXSync(display, False);
    }
@@ -29,6 +32,7 @@ void UngrabServer(void)
    grabCount -= 1;
    if(grabCount == 0) {
       JXUngrabServer(display);
+      RecordSectionStats(SECTION_GRAB, grabStart);
    }
 }
 
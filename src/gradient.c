@@ -11,6 +11,45 @@
 #include "gradient.h"
 #include "color.h"
 #include "main.h"
+#include "misc.h"
+#include "render.h"
+#include "stats.h"
+
+/** Number of gradient strips to keep. */
+#define STRIP_CACHE_SIZE 32
+
+/** A gradient drawn one pixel wide.
+ * These are tiled to fill the area of a gradient.
+ */
+typedef struct GradientStrip {
+   Pixmap pixmap;             /**< The strip (None if unused). */
+   long fromColor;            /**< The starting color pixel value. */
+   long toColor;              /**< The ending color pixel value. */
+   unsigned int height;       /**< Height of the strip. */
+   unsigned long stamp;       /**< Last use, for replacement. */
+} GradientStrip;
+
+static GradientStrip strips[STRIP_CACHE_SIZE];
+static unsigned long stripStamp = 0;
+
+static Pixmap GetGradientStrip(GC g, long fromColor, long toColor,
+                               unsigned int height);
+static void DrawGradientLines(Drawable d, GC g,
+                              long fromColor, long toColor,
+                              int x, int y,
+                              unsigned int width, unsigned int height);
+static void ReleaseGradientStrip(GradientStrip *sp);
+
+/** Release gradient strips. */
+void ShutdownGradients(void)
+{
+   unsigned int i;
+   for(i = 0; i < STRIP_CACHE_SIZE; i++) {
+      ReleaseGradientStrip(&strips[i]);
+   }
+   stripStamp = 0;
+   ReleaseRenderGradients();
+}
 
 /** Draw a horizontal gradient. */
 void DrawHorizontalGradient(Drawable d, GC g,
@@ -18,17 +57,22 @@ void DrawHorizontalGradient(Drawable d, GC g,
                             int x, int y,
                             unsigned int width, unsigned int height)
 {
+   DrawPartialGradient(d, g, fromColor, toColor, x, y, width, height,
+                       0, height);
+}
 
-   const int shift = 15;
-   unsigned int line;
-   XColor colors[2];
-   int red, green, blue;
-   int ared, agreen, ablue;
-   int bred, bgreen, bblue;
-   int redStep, greenStep, blueStep;
+/** Draw part of a horizontal gradient. */
+void DrawPartialGradient(Drawable d, GC g,
+                         long fromColor, long toColor,
+                         int x, int y,
+                         unsigned int width, unsigned int height,
+                         int offset, unsigned int span)
+{
+
+   Pixmap strip;
 
    /* Return if there's nothing to do. */
-   if(width == 0 || height == 0) {
+   if(width == 0 || height == 0 || span == 0) {
       return;
    }
 
@@ -37,10 +81,102 @@ void DrawHorizontalGradient(Drawable d, GC g,
       return;
    }
 
-   /* Query the from/to colors. */
+   /* Let the server draw it if it can. */
+   if(PutRenderGradient(d, fromColor, toColor, x, y, width, height,
+                        offset, span)) {
+      return;
+   }
+
+   /* A strip would be no smaller than the gradient. */
+   if(width == 1 && offset == 0 && height == span) {
+      DrawGradientLines(d, g, fromColor, toColor, x, y, width, height);
+      return;
+   }
+
+   /* Tile the strip over the area. */
+   strip = GetGradientStrip(g, fromColor, toColor, span);
+   JXSetTile(display, g, strip);
+   JXSetTSOrigin(display, g, x, y - offset);
+   JXSetFillStyle(display, g, FillTiled);
+   JXFillRectangle(display, d, g, x, y, width, height);
+   JXSetFillStyle(display, g, FillSolid);
+
+}
+
+/** Get the strip for a gradient, drawing it if needed. */
+Pixmap GetGradientStrip(GC g, long fromColor, long toColor,
+                        unsigned int height)
+{
+   GradientStrip *sp;
+   GradientStrip *best;
+   unsigned int i;
+
+   stripStamp += 1;
+   best = &strips[0];
+   for(i = 0; i < STRIP_CACHE_SIZE; i++) {
+      sp = &strips[i];
+      if(  sp->pixmap != None && sp->height == height
+         && sp->fromColor == fromColor && sp->toColor == toColor) {
+         sp->stamp = stripStamp;
+         return sp->pixmap;
+      }
+      if(sp->stamp < best->stamp) {
+         best = sp;
+      }
+   }
+
+   sp = best;
+   ReleaseGradientStrip(sp);
+   sp->pixmap = JXCreatePixmap(display, rootWindow, 1, height, rootDepth);
+   sp->fromColor = fromColor;
+   sp->toColor = toColor;
+   sp->height = height;
+   sp->stamp = stripStamp;
+   RecordPixmapStats(PIXMAP_GRADIENT,
+                     (long)GetPixmapSize(1, height, rootDepth));
+   DrawGradientLines(sp->pixmap, g, fromColor, toColor, 0, 0, 1, height);
+   return sp->pixmap;
+}
+
+/** Draw a gradient one line at a time. */
+void DrawGradientLines(Drawable d, GC g,
+                       long fromColor, long toColor,
+                       int x, int y,
+                       unsigned int width, unsigned int height)
+{
+
+   const StatsTime start = StartStats();
+   unsigned long *pixels;
+   unsigned int line;
+
+   pixels = AllocateStack(height * sizeof(unsigned long));
+   GetGradientPixels(fromColor, toColor, height, pixels);
+   for(line = 0; line < height; line++) {
+      JXSetForeground(display, g, pixels[line]);
+      JXDrawLine(display, d, g, x, y + line, x + width - 1, y + line);
+   }
+   ReleaseStack(pixels);
+   RecordSectionStats(SECTION_GRADIENT, start);
+}
+
+/** Compute the pixel value of each line of a gradient. */
+void GetGradientPixels(long fromColor, long toColor,
+                       unsigned int height, unsigned long *pixels)
+{
+
+   const int shift = 15;
+   unsigned int line;
+   XColor colors[2];
+   int red, green, blue;
+   int ared, agreen, ablue;
+   int bred, bgreen, bblue;
+   int redStep, greenStep, blueStep;
+
+   /* Look up the from/to colors. */
    colors[0].pixel = fromColor;
    colors[1].pixel = toColor;
-   JXQueryColors(display, rootColormap, colors, 2);
+   GetColorFromPixel(&colors[0]);
+   GetColorFromPixel(&colors[1]);
 
    /* Set the "from" color. */
    ared = (unsigned int)colors[0].red << shift;
@@ -69,10 +205,7 @@ void DrawHorizontalGradient(Drawable d, GC g,
       colors[0].blue = (unsigned short)(blue >> shift);
 
       GetColor(&colors[0]);
-
-      /* Draw the line. */
-      JXSetForeground(display, g, colors[0].pixel);
-      JXDrawLine(display, d, g, x, y + line, x + width - 1, y + line);
+      pixels[line] = colors[0].pixel;
 
       red += redStep;
       green += greenStep;
@@ -80,3 +213,14 @@ void DrawHorizontalGradient(Drawable d, GC g,
 
    }
 }
+
+/** Release the pixmap of a gradient strip. */
+void ReleaseGradientStrip(GradientStrip *sp)
+{
+   if(sp->pixmap != None) {
+      JXFreePixmap(display, sp->pixmap);
+      RecordPixmapStats(PIXMAP_GRADIENT,
+                        -(long)GetPixmapSize(1, sp->height, rootDepth));
+      sp->pixmap = None;
+   }
+}
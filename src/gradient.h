@@ -10,8 +10,12 @@
 #ifndef GRADIENT_H
 #define GRADIENT_H
 
+/** Release cached gradients. */
+void ShutdownGradients(void);
+
 /** Draw a horizontal gradient.
  * Note that no action is taken if fromColor == toColor.
+ * This changes the foreground, tile, and fill style of the GC.
  * @param d The drawable on which to draw the gradient.
  * @param g The graphics context to use.
  * @param fromColor The starting color pixel value.
@@ -26,5 +30,34 @@ void DrawHorizontalGradient(Drawable d, GC g,
                             int x, int y,
                             unsigned int width, unsigned int height);
 
+/** Draw part of a horizontal gradient.
+ * The area gets rows offset to offset + height of a gradient that is
+ * span rows tall. This changes the GC like DrawHorizontalGradient.
+ * @param d The drawable on which to draw the gradient.
+ * @param g The graphics context to use.
+ * @param fromColor The starting color pixel value.
+ * @param toColor The ending color pixel value.
+ * @param x The x-coordinate.
+ * @param y The y-coordinate.
+ * @param width The width of the area to fill.
+ * @param height The height of the area to fill.
+ * @param offset The first row of the gradient to draw.
+ * @param span The height of the whole gradient.
+ */
+void DrawPartialGradient(Drawable d, GC g,
+                         long fromColor, long toColor,
+                         int x, int y,
+                         unsigned int width, unsigned int height,
+                         int offset, unsigned int span);
+
+/** Compute the pixel value of each line of a gradient.
+ * @param fromColor The starting color pixel value.
+ * @param toColor The ending color pixel value.
+ * @param height The number of lines.
+ * @param pixels The array to fill with a pixel for each line.
+ */
+void GetGradientPixels(long fromColor, long toColor,
+                       unsigned int height, unsigned long *pixels);
+
 #endif /* GRADIENT_H */
 
@@ -26,6 +26,7 @@ typedef unsigned int MatchType;
 /** List of match patterns for a group. */
 typedef struct PatternListType {
    char *pattern;
+   struct MatchPattern *compiled;   /**< NULL if the pattern is invalid. */
    MatchType match;
    struct PatternListType *next;
 } PatternListType;
@@ -45,16 +46,144 @@ typedef struct OptionListType {
 typedef struct GroupType {
    PatternListType *patterns;
    OptionListType *options;
+   unsigned int order;        /**< Position in the group list. */
    struct GroupType *next;
 } GroupType;
 
+/** Number of buckets in the group index (must be a power of 2). */
+#define GROUP_INDEX_SIZE 256
+
+/** Group index entry.
+ * Groups whose class (or name) patterns are all exact literals can only
+ * match clients with one of those values, so they are stored under each
+ * literal. All other groups are checked for every client.
+ */
+typedef struct GroupIndexType {
+   const char *key;                 /**< The literal (owned by a pattern). */
+   MatchType match;                 /**< MATCH_CLASS or MATCH_NAME. */
+   const GroupType *group;          /**< The group. */
+   struct GroupIndexType *next;     /**< Next entry in the bucket. */
+} GroupIndexType;
+
 static GroupType *groups = NULL;
+static unsigned int groupCount = 0;
+static GroupIndexType *groupIndex[GROUP_INDEX_SIZE];
+static const GroupType **wildcardGroups = NULL;
+static unsigned int wildcardCount = 0;
+static unsigned int indexCount = 0;
 
 static void ReleasePatternList(PatternListType *lp);
 static void ReleaseOptionList(OptionListType *lp);
 static void AddPattern(PatternListType **lp, const char *pattern,
                        MatchType match);
 static void ApplyGroup(const GroupType *gp, ClientNode *np);
+static char MatchesGroup(const GroupType *gp, const ClientNode *np);
+static char IndexGroup(const GroupType *gp, MatchType match);
+static unsigned int HashGroupKey(const char *key);
+static int CompareGroupOrder(const void *a, const void *b);
+
+/** Build the group index. */
+void StartupGroups(void)
+{
+   GroupType *gp;
+   unsigned int x;
+
+   for(x = 0; x < GROUP_INDEX_SIZE; x++) {
+      groupIndex[x] = NULL;
+   }
+
+   /* Groups are applied in list order. */
+   x = 0;
+   for(gp = groups; gp; gp = gp->next) {
+      gp->order = x;
+      x += 1;
+   }
+
+   wildcardCount = 0;
+   wildcardGroups = Allocate(sizeof(GroupType*) * (groupCount + 1));
+   for(gp = groups; gp; gp = gp->next) {
+      if(!IndexGroup(gp, MATCH_CLASS) && !IndexGroup(gp, MATCH_NAME)) {
+         wildcardGroups[wildcardCount] = gp;
+         wildcardCount += 1;
+      }
+   }
+   qsort(wildcardGroups, wildcardCount, sizeof(GroupType*),
+         CompareGroupOrder);
+}
+
+/** Release the group index. */
+void ShutdownGroups(void)
+{
+   unsigned int x;
+   for(x = 0; x < GROUP_INDEX_SIZE; x++) {
+      while(groupIndex[x]) {
+         GroupIndexType *ip = groupIndex[x]->next;
+         Release(groupIndex[x]);
+         groupIndex[x] = ip;
+      }
+   }
+   if(wildcardGroups) {
+      Release(wildcardGroups);
+      wildcardGroups = NULL;
+   }
+   wildcardCount = 0;
+   indexCount = 0;
+}
+
+/** Hash a class or instance name. */
+unsigned int HashGroupKey(const char *key)
+{
+   unsigned int h = 5381;
+   while(*key) {
+      h = h * 33 + (unsigned char)*key;
+      key += 1;
+   }
+   return h & (GROUP_INDEX_SIZE - 1);
+}
+
+/** Sort groups by their position in the configuration. */
+int CompareGroupOrder(const void *a, const void *b)
+{
+   const GroupType *ga = *(const GroupType**)a;
+   const GroupType *gb = *(const GroupType**)b;
+   return (ga->order > gb->order) - (ga->order < gb->order);
+}
+
+/** Add a group to the index if all its patterns of a type are literals.
+ * @return 1 if the group was indexed, 0 otherwise.
+ */
+char IndexGroup(const GroupType *gp, MatchType match)
+{
+   const PatternListType *lp;
+   char found = 0;
+
+   for(lp = gp->patterns; lp; lp = lp->next) {
+      if(lp->match == match) {
+         if(!lp->compiled || !GetExactMatch(lp->compiled)) {
+            return 0;
+         }
+         found = 1;
+      }
+   }
+   if(!found) {
+      return 0;
+   }
+
+   for(lp = gp->patterns; lp; lp = lp->next) {
+      if(lp->match == match) {
+         const char *key = GetExactMatch(lp->compiled);
+         const unsigned int index = HashGroupKey(key);
+         GroupIndexType *ip = Allocate(sizeof(GroupIndexType));
+         ip->key = key;
+         ip->match = match;
+         ip->group = gp;
+         ip->next = groupIndex[index];
+         groupIndex[index] = ip;
+         indexCount += 1;
+      }
+   }
+   return 1;
+}
 
 /** Destroy group data. */
 void DestroyGroups(void)
@@ -67,6 +196,7 @@ void DestroyGroups(void)
       Release(groups);
       groups = gp;
    }
+   groupCount = 0;
 }
 
 /** Release a group pattern list. */
@@ -76,6 +206,7 @@ void ReleasePatternList(PatternListType *lp)
    while(lp) {
       tp = lp->next;
       Release(lp->pattern);
+      DestroyMatchPattern(lp->compiled);
       Release(lp);
       lp = tp;
    }
@@ -102,8 +233,10 @@ GroupType *CreateGroup(void)
    tp = Allocate(sizeof(GroupType));
    tp->patterns = NULL;
    tp->options = NULL;
+   tp->order = 0;
    tp->next = groups;
    groups = tp;
+   groupCount += 1;
    return tp;
 }
 
@@ -162,6 +295,14 @@ void AddPattern(PatternListType **lp, const char *pattern, MatchType match)
    *lp = tp;
    tp->pattern = CopyString(pattern);
    tp->match = match;
+   if(match == MATCH_TYPE) {
+      tp->compiled = NULL;
+   } else {
+      tp->compiled = CreateMatchPattern(pattern);
+      if(JUNLIKELY(!tp->compiled)) {
+         Warning(_("invalid group pattern: %s"), pattern);
+      }
+   }
 }
 
 /** Add an option to a group. */
@@ -216,19 +357,71 @@ void AddGroupOptionSigned(GroupType *gp, OptionType option,
    gp->options = lp;
 }
 
-/** Apply groups to a client. */
+/** Apply groups to a client.
+ * Groups are applied in list order. Only the wildcard groups and the
+ * indexed groups for the class and instance name of the client are
+ * considered since no other group can match.
+ */
 void ApplyGroups(ClientNode *np)
 {
-   PatternListType *lp;
-   GroupType *gp;
-   char hasClass;
-   char hasName;
-   char hasType;
-   char hasMachine;
-   char matchesClass;
-   char matchesName;
-   char matchesType;
-   char matchesMachine;
+   const GroupType **candidates;
+   const GroupIndexType *ip;
+   unsigned int count, x;
+
+   Assert(np);
+
+   if(groupCount == 0) {
+      return;
+   }
+
+   candidates = AllocateStack(sizeof(GroupType*)
+                            * (wildcardCount + indexCount + 1));
+   memcpy(candidates, wildcardGroups, sizeof(GroupType*) * wildcardCount);
+   count = wildcardCount;
+   if(np->className) {
+      ip = groupIndex[HashGroupKey(np->className)];
+      for(; ip; ip = ip->next) {
+         if(ip->match == MATCH_CLASS && !strcmp(ip->key, np->className)) {
+            candidates[count++] = ip->group;
+         }
+      }
+   }
+   if(np->instanceName) {
+      ip = groupIndex[HashGroupKey(np->instanceName)];
+      for(; ip; ip = ip->next) {
+         if(ip->match == MATCH_NAME && !strcmp(ip->key, np->instanceName)) {
+            candidates[count++] = ip->group;
+         }
+      }
+   }
+   Assert(count <= wildcardCount + indexCount);
+
+   /* A group is listed once per literal, so sort and skip repeats. */
+   qsort(candidates, count, sizeof(GroupType*), CompareGroupOrder);
+   for(x = 0; x < count; x++) {
+      if(x > 0 && candidates[x] == candidates[x - 1]) {
+         continue;
+      }
+      if(MatchesGroup(candidates[x], np)) {
+         ApplyGroup(candidates[x], np);
+      }
+   }
+   ReleaseStack(candidates);
+
+}
+
+/** Determine if a client matches a group. */
+char MatchesGroup(const GroupType *gp, const ClientNode *np)
+{
+   const PatternListType *lp;
+   char hasClass = 0;
+   char hasName = 0;
+   char hasType = 0;
+   char hasMachine = 0;
+   char matchesClass = 0;
+   char matchesName = 0;
+   char matchesType = 0;
+   char matchesMachine = 0;
 
    static const StringMappingType windowTypeMapping[] = {
       { "desktop",      WINDOW_TYPE_DESKTOP      },
@@ -242,48 +435,34 @@ void ApplyGroups(ClientNode *np)
       { "utility",      WINDOW_TYPE_UTILITY      }
    };
 
-   Assert(np);
-   for(gp = groups; gp; gp = gp->next) {
-      hasClass = 0;
-      hasName = 0;
-      hasType = 0;
-      hasMachine = 0;
-      matchesClass = 0;
-      matchesName = 0;
-      matchesType = 0;
-      matchesMachine = 0;
-      for(lp = gp->patterns; lp; lp = lp->next) {
-         if(lp->match == MATCH_CLASS) {
-            if(Match(lp->pattern, np->className)) {
-               matchesClass = 1;
-            }
-            hasClass = 1;
-         } else if(lp->match == MATCH_NAME) {
-            if(Match(lp->pattern, np->instanceName)) {
-               matchesName = 1;
-            }
-            hasName = 1;
-         } else if(lp->match == MATCH_TYPE) {
-             if(FindValue(windowTypeMapping, WINDOW_TYPE_COUNT, lp->pattern)
-             == np->state.windowType) {
-                matchesType = 1;
-             }
-             hasType = 1;
-         } else if(lp->match == MATCH_MACHINE) {
-            if(Match(lp->pattern, np->machineName)) {
-               matchesMachine = 1;
-            }
-             hasMachine = 1;
-         } else {
-            Debug("invalid match in ApplyGroups: %d", lp->match);
+   for(lp = gp->patterns; lp; lp = lp->next) {
+      if(lp->match == MATCH_CLASS) {
+         if(lp->compiled && MatchCompiled(lp->compiled, np->className)) {
+            matchesClass = 1;
          }
-      }
-      if(hasName == matchesName && hasClass == matchesClass
-      && hasType == matchesType && hasMachine == matchesMachine) {
-         ApplyGroup(gp, np);
+         hasClass = 1;
+      } else if(lp->match == MATCH_NAME) {
+         if(lp->compiled && MatchCompiled(lp->compiled, np->instanceName)) {
+            matchesName = 1;
+         }
+         hasName = 1;
+      } else if(lp->match == MATCH_TYPE) {
+          if(FindValue(windowTypeMapping, WINDOW_TYPE_COUNT, lp->pattern)
+          == np->state.windowType) {
+             matchesType = 1;
+          }
+          hasType = 1;
+      } else if(lp->match == MATCH_MACHINE) {
+         if(lp->compiled && MatchCompiled(lp->compiled, np->machineName)) {
+            matchesMachine = 1;
+         }
+          hasMachine = 1;
+      } else {
+         Debug("invalid match in ApplyGroups: %d", lp->match);
       }
    }
-
+   return hasName == matchesName && hasClass == matchesClass
+       && hasType == matchesType && hasMachine == matchesMachine;
 }
 
 /** Apply a group to a client. */
@@ -426,7 +605,7 @@ void ApplyGroup(const GroupType *gp, ClientNode *np)
       case OPTION_X:
          if(lp->value.s < 0) {
             int north, south, east, west;
-            GetBorderSize(&np->state, &north, &south, &east, &west);
+            GetClientBorderSize(np, &north, &south, &east, &west);
             np->x = rootWidth + lp->value.s - np->width - east - west;
          } else {
             np->x = lp->value.s;
@@ -436,7 +615,7 @@ void ApplyGroup(const GroupType *gp, ClientNode *np)
       case OPTION_Y:
          if(lp->value.s < 0) {
             int north, south, east, west;
-            GetBorderSize(&np->state, &north, &south, &east, &west);
+            GetClientBorderSize(np, &north, &south, &east, &west);
             np->y = rootHeight + lp->value.s - np->height - north - south;
          } else {
             np->y = lp->value.s;
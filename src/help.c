@@ -23,18 +23,36 @@ void DisplayAbout(void)
 void DisplayCompileOptions(void)
 {
    printf("compiled options: "
+#ifdef USE_BENCH
+          "bench "
+#endif
+#ifdef USE_BULK
+          "bulk "
+#endif
+#ifdef USE_CONFIG_CACHE
+          "config-cache "
+#endif
 #ifndef DISABLE_CONFIRM
           "confirm "
 #endif
+#ifdef USE_CONTROL
+          "control "
+#endif
 #ifdef DEBUG
           "debug "
 #endif
+#ifdef USE_ICON_CACHE
+          "icon-cache "
+#endif
 #ifdef USE_ICONS
           "icons "
 #endif
 #ifdef USE_JPEG
           "jpeg "
 #endif
+#ifdef PROFILE_MEMORY
+          "memprofile "
+#endif
 #ifdef ENABLE_NLS
           "nls "
 #endif
@@ -47,21 +65,39 @@ void DisplayCompileOptions(void)
 #ifdef USE_SHAPE
           "shape "
 #endif
+#ifdef USE_SHM
+          "shm "
+#endif
+#ifdef USE_STATS
+          "stats "
+#endif
 #if defined(USE_CAIRO) && defined(USE_RSVG)
           "svg "
 #endif
+#ifdef USE_TRACE
+          "trace "
+#endif
 #ifdef USE_XBM
           "xbm "
 #endif
+#ifdef USE_XCB
+          "xcb "
+#endif
 #ifdef USE_XFT
           "xft "
 #endif
 #ifdef USE_XINERAMA
           "xinerama "
 #endif
+#ifdef PROFILE_X
+          "xprofile "
+#endif
 #ifdef USE_XPM
           "xpm "
 #endif
+#ifdef USE_XRANDR
+          "xrandr "
+#endif
 #ifdef USE_XRENDER
           "xrender "
 #endif
@@ -72,13 +108,23 @@ void DisplayCompileOptions(void)
 void DisplayHelp(void)
 {
    DisplayUsage();
-   printf("  -display X  Set the X display to use\n"
+   printf(
+#ifdef USE_BENCH
+          "  -bench-render Time rendering on the display and exit\n"
+#endif
+#ifdef USE_CONTROL
+          "  -control    Send commands from standard input to the control "
+          "socket\n"
+#endif
+          "  -display X  Set the X display to use\n"
           "  -exit       Exit JWM (send _JWM_EXIT to the root)\n"
           "  -f file     Use specified configuration file\n"
           "  -h          Display this help message\n"
           "  -p          Parse the configuration file and exit\n"
+          "  -reexec     Run JWM again in place (send _JWM_REEXEC)\n"
           "  -reload     Reload menu (send _JWM_RELOAD to the root)\n"
           "  -restart    Restart JWM (send _JWM_RESTART to the root)\n"
+          "  -stats      Print run-time statistics (send _JWM_STATS)\n"
           "  -v          Display version information\n");
 }
 
@@ -14,6 +14,8 @@
 #include "misc.h"
 #include "font.h"
 #include "settings.h"
+#include "event.h"
+#include "clientlist.h"
 
 #include <X11/Xlibint.h>
 
@@ -68,16 +70,28 @@ typedef struct {
 Atom atoms[ATOM_COUNT];
 
 const char jwmRestart[]       = "_JWM_RESTART";
+const char jwmReexec[]        = "_JWM_REEXEC";
 const char jwmExit[]          = "_JWM_EXIT";
 const char jwmReload[]        = "_JWM_RELOAD";
+const char jwmStats[]         = "_JWM_STATS";
 const char managerProperty[]  = "MANAGER";
 
+/** Class hint read before a window is managed (see ReadWindowClass). */
+static Window classWindow = None;
+static XClassHint classHint;
+
+static char wmSelection[32];
+static char traySelection[40];
+
 static const AtomNode atomList[] = {
 
    { &atoms[ATOM_COMPOUND_TEXT],             "COMPOUND_TEXT"               },
    { &atoms[ATOM_UTF8_STRING],               "UTF8_STRING"                 },
    { &atoms[ATOM_XROOTPMAP_ID],              "_XROOTPMAP_ID"               },
+   { &atoms[ATOM_ESETROOT_PMAP_ID],          "ESETROOT_PMAP_ID"            },
    { &atoms[ATOM_MANAGER],                   &managerProperty[0]           },
+   { &atoms[ATOM_WM_SELECTION],              &wmSelection[0]               },
+   { &atoms[ATOM_NET_SYSTEM_TRAY_SELECTION], &traySelection[0]             },
 
    { &atoms[ATOM_WM_STATE],                  "WM_STATE"                    },
    { &atoms[ATOM_WM_PROTOCOLS],              "WM_PROTOCOLS"                },
@@ -155,16 +169,24 @@ static const AtomNode atomList[] = {
    { &atoms[ATOM_NET_WM_STRUT_PARTIAL],      "_NET_WM_STRUT_PARTIAL"       },
    { &atoms[ATOM_NET_WM_STRUT],              "_NET_WM_STRUT"               },
    { &atoms[ATOM_NET_WM_WINDOW_OPACITY],     "_NET_WM_WINDOW_OPACITY"      },
+   { &atoms[ATOM_NET_WM_SYNC_REQUEST],       "_NET_WM_SYNC_REQUEST"        },
+   { &atoms[ATOM_NET_WM_SYNC_REQUEST_COUNTER],
+      "_NET_WM_SYNC_REQUEST_COUNTER" },
    { &atoms[ATOM_NET_WM_MOVERESIZE],         "_NET_WM_MOVERESIZE"          },
    { &atoms[ATOM_NET_SYSTEM_TRAY_OPCODE],    "_NET_SYSTEM_TRAY_OPCODE"     },
    { &atoms[ATOM_NET_SYSTEM_TRAY_ORIENTATION],
       "_NET_SYSTEM_TRAY_ORIENTATION" },
+   { &atoms[ATOM_NET_SYSTEM_TRAY_ICON_SIZE],
+      "_NET_SYSTEM_TRAY_ICON_SIZE" },
 
    { &atoms[ATOM_MOTIF_WM_HINTS],            "_MOTIF_WM_HINTS"             },
 
    { &atoms[ATOM_JWM_RESTART],               &jwmRestart[0]                },
+   { &atoms[ATOM_JWM_REEXEC],                &jwmReexec[0]                 },
+   { &atoms[ATOM_JWM_RESTART_STATE],         "_JWM_RESTART_STATE"          },
    { &atoms[ATOM_JWM_EXIT],                  &jwmExit[0]                   },
    { &atoms[ATOM_JWM_RELOAD],                &jwmReload[0]                 },
+   { &atoms[ATOM_JWM_STATS],                 &jwmStats[0]                  },
    { &atoms[ATOM_JWM_WM_STATE_MAXIMIZED_TOP],
       "_JWM_WM_STATE_MAXIMIZED_TOP" },
    { &atoms[ATOM_JWM_WM_STATE_MAXIMIZED_BOTTOM],
@@ -177,11 +199,37 @@ static const AtomNode atomList[] = {
 };
 
 static char CheckShape(Window win);
+static void WriteNetState(ClientNode *np);
+static void WriteNetDesktop(ClientNode *np);
+static void WriteClientExtents(ClientNode *np);
 static void WriteNetAllowed(ClientNode *np);
 static void ReadWMState(Window win, ClientState *state);
 static void ReadMotifHints(Window win, ClientState *state);
 
-/** Set root hints and intern atoms. */
+/** Intern all atoms used by JWM with a single request. */
+void InternAtoms(void)
+{
+   char *names[ATOM_COUNT];
+   Atom values[ATOM_COUNT];
+   unsigned int x;
+
+   Assert(sizeof(atomList) / sizeof(atomList[0]) == ATOM_COUNT);
+
+   /* Selections are per-screen. */
+   snprintf(wmSelection, sizeof(wmSelection), "WM_S%d", rootScreen);
+   snprintf(traySelection, sizeof(traySelection),
+            "_NET_SYSTEM_TRAY_S%d", rootScreen);
+
+   for(x = 0; x < ATOM_COUNT; x++) {
+      names[x] = (char*)atomList[x].name;
+   }
+   JXInternAtoms(display, names, ATOM_COUNT, False, values);
+   for(x = 0; x < ATOM_COUNT; x++) {
+      *atomList[x].atom = values[x];
+   }
+}
+
+/** Set root hints. */
 void StartupHints(void)
 {
 
@@ -207,11 +255,6 @@ void StartupHints(void)
    array = (unsigned long*)data;
    supported = (Atom*)data;
 
-   /* Intern the atoms */
-   for(x = 0; x < ATOM_COUNT; x++) {
-      *atomList[x].atom = JXInternAtom(display, atomList[x].name, False);
-   }
-
    /* _NET_SUPPORTED */
    for(x = FIRST_NET_ATOM; x <= LAST_NET_ATOM; x++) {
       supported[x - FIRST_NET_ATOM] = atoms[x];
@@ -237,11 +280,7 @@ void StartupHints(void)
                     (unsigned char*)data, count);
 
    /* _NET_DESKTOP_GEOMETRY */
-   array[0] = rootWidth;
-   array[1] = rootHeight;
-   JXChangeProperty(display, rootWindow, atoms[ATOM_NET_DESKTOP_GEOMETRY],
-                    XA_CARDINAL, 32, PropModeReplace,
-                    (unsigned char*)array, 2);
+   WriteDesktopGeometry();
 
    /* _NET_DESKTOP_VIEWPORT */
    array[0] = 0;
@@ -270,6 +309,17 @@ void StartupHints(void)
 
 }
 
+/** Write the size of the desktop (_NET_DESKTOP_GEOMETRY). */
+void WriteDesktopGeometry(void)
+{
+   unsigned long array[2];
+   array[0] = rootWidth;
+   array[1] = rootHeight;
+   JXChangeProperty(display, rootWindow, atoms[ATOM_NET_DESKTOP_GEOMETRY],
+                    XA_CARDINAL, 32, PropModeReplace,
+                    (unsigned char*)array, 2);
+}
+
 /** Determine the current desktop. */
 void ReadCurrentDesktop(void)
 {
@@ -326,11 +376,24 @@ void ReadClientInfo(ClientNode *np, char alreadyMapped)
 
 }
 
-/** Write the window state hint for a client. */
+/** Set the state properties of a client window. */
 void WriteState(ClientNode *np)
 {
+   np->hints.pending = 1;
+   RequireStateUpdate();
+}
+
+/** Write the state properties of a client now if a write is pending. */
+void FlushState(ClientNode *np)
+{
+   HintCache *cp = &np->hints;
    unsigned long data[2];
 
+   if(!cp->pending) {
+      return;
+   }
+   cp->pending = 0;
+
    if(np->state.status & STAT_MAPPED) {
       data[0] = NormalState;
    } else if(np->state.status & STAT_MINIMIZED) {
@@ -342,19 +405,36 @@ void WriteState(ClientNode *np)
    }
    data[1] = None;
 
-   if(data[0] == WithdrawnState) {
-      JXDeleteProperty(display, np->window, atoms[ATOM_WM_STATE]);
-   } else {
-      JXChangeProperty(display, np->window, atoms[ATOM_WM_STATE],
-                       atoms[ATOM_WM_STATE], 32, PropModeReplace,
-                       (unsigned char*)data, 2);
+   if(!(cp->valid & HINT_WM_STATE) || cp->wmState != data[0]) {
+      if(data[0] == WithdrawnState) {
+         JXDeleteProperty(display, np->window, atoms[ATOM_WM_STATE]);
+      } else {
+         JXChangeProperty(display, np->window, atoms[ATOM_WM_STATE],
+                          atoms[ATOM_WM_STATE], 32, PropModeReplace,
+                          (unsigned char*)data, 2);
+      }
+      cp->wmState = data[0];
+      cp->valid |= HINT_WM_STATE;
    }
 
    WriteNetState(np);
-   WriteFrameExtents(np->window, &np->state);
+   WriteNetDesktop(np);
+   WriteClientExtents(np);
    WriteNetAllowed(np);
 }
 
+/** Write the state properties of all clients with a pending write. */
+void FlushStates(void)
+{
+   ClientNode *np;
+   unsigned int x;
+   for(x = 0; x < LAYER_COUNT; x++) {
+      for(np = nodes[x]; np; np = np->next) {
+         FlushState(np);
+      }
+   }
+}
+
 /** Set the opacity of a client. */
 void SetOpacity(ClientNode *np, unsigned int opacity, char force)
 {
@@ -375,17 +455,23 @@ void SetOpacity(ClientNode *np, unsigned int opacity, char force)
 /** Write the net state hint for a client. */
 void WriteNetState(ClientNode *np)
 {
-   unsigned long values[16];
+   HintCache *cp = &np->hints;
+   unsigned long values[HINT_STATE_COUNT];
    int index;
 
    Assert(np);
 
    /* We remove the _NET_WM_STATE and _NET_WM_DESKTOP for withdrawn windows. */
    if(!(np->state.status & (STAT_MAPPED | STAT_MINIMIZED | STAT_SHADED))) {
-      JXDeleteProperty(display, np->window, atoms[ATOM_NET_WM_STATE]);
-      JXDeleteProperty(display, np->window, atoms[ATOM_NET_WM_DESKTOP]);
+      if(!(cp->valid & HINT_NET_STATE) || !cp->withdrawn) {
+         JXDeleteProperty(display, np->window, atoms[ATOM_NET_WM_STATE]);
+         JXDeleteProperty(display, np->window, atoms[ATOM_NET_WM_DESKTOP]);
+         cp->withdrawn = 1;
+         cp->valid |= HINT_NET_STATE;
+         cp->valid &= ~HINT_DESKTOP;
+      }
       return;
-   } 
+   }
 
    index = 0;
    if(np->state.status & STAT_MINIMIZED) {
@@ -446,9 +532,62 @@ void WriteNetState(ClientNode *np)
       values[index++] = atoms[ATOM_NET_WM_STATE_FOCUSED];
    }
 
+   if(  (cp->valid & HINT_NET_STATE) && !cp->withdrawn
+      && cp->netStateCount == index
+      && !memcmp(cp->netState, values, index * sizeof(values[0]))) {
+      return;
+   }
    JXChangeProperty(display, np->window, atoms[ATOM_NET_WM_STATE],
                     XA_ATOM, 32, PropModeReplace,
                     (unsigned char*)values, index);
+   memcpy(cp->netState, values, index * sizeof(values[0]));
+   cp->netStateCount = index;
+   cp->withdrawn = 0;
+   cp->valid |= HINT_NET_STATE;
+}
+
+/** Write _NET_WM_DESKTOP for a client that is not withdrawn. */
+void WriteNetDesktop(ClientNode *np)
+{
+   HintCache *cp = &np->hints;
+   unsigned long desktop;
+
+   if(cp->withdrawn) {
+      return;
+   }
+   if(np->state.status & STAT_STICKY) {
+      desktop = ~0UL;
+   } else {
+      desktop = np->state.desktop;
+   }
+   if(!(cp->valid & HINT_DESKTOP) || cp->desktop != desktop) {
+      SetCardinalAtom(np->window, ATOM_NET_WM_DESKTOP, desktop);
+      cp->desktop = desktop;
+      cp->valid |= HINT_DESKTOP;
+   }
+}
+
+/** Write _NET_FRAME_EXTENTS for a client. */
+void WriteClientExtents(ClientNode *np)
+{
+   HintCache *cp = &np->hints;
+   unsigned long values[4];
+   int north, south, east, west;
+
+   GetClientBorderSize(np, &north, &south, &east, &west);
+   values[0] = west;
+   values[1] = east;
+   values[2] = north;
+   values[3] = south;
+
+   if(  !(cp->valid & HINT_EXTENTS)
+      || memcmp(cp->extents, values, sizeof(values))) {
+      JXChangeProperty(display, np->window, atoms[ATOM_NET_FRAME_EXTENTS],
+                       XA_CARDINAL, 32, PropModeReplace,
+                       (unsigned char*)values, 4);
+      memcpy(cp->extents, values, sizeof(values));
+      cp->valid |= HINT_EXTENTS;
+   }
 }
 
 /** Set _NET_FRAME_EXTENTS. */
@@ -475,7 +614,8 @@ void WriteFrameExtents(Window win, const ClientState *state)
 void WriteNetAllowed(ClientNode *np)
 {
 
-   unsigned long values[12];
+   HintCache *cp = &np->hints;
+   unsigned long values[HINT_ALLOWED_COUNT];
    unsigned int index;
 
    Assert(np);
@@ -516,9 +656,16 @@ void WriteNetAllowed(ClientNode *np)
    values[index++] = atoms[ATOM_NET_WM_ACTION_BELOW];
    values[index++] = atoms[ATOM_NET_WM_ACTION_ABOVE];
 
+   if(  (cp->valid & HINT_ALLOWED) && cp->allowedCount == index
+      && !memcmp(cp->allowed, values, index * sizeof(values[0]))) {
+      return;
+   }
    JXChangeProperty(display, np->window, atoms[ATOM_NET_WM_ALLOWED_ACTIONS],
                     XA_ATOM, 32, PropModeReplace,
                     (unsigned char*)values, index);
+   memcpy(cp->allowed, values, index * sizeof(values[0]));
+   cp->allowedCount = index;
+   cp->valid |= HINT_ALLOWED;
 
 }
 
@@ -721,7 +868,7 @@ ClientState ReadWindowState(Window win, char alreadyMapped)
 }
 
 /** Determine the title to display for a client. */
-void ReadWMName(ClientNode *np)
+char ReadWMName(ClientNode *np)
 {
 
    unsigned long count;
@@ -730,85 +877,89 @@ void ReadWMName(ClientNode *np)
    Atom realType;
    int realFormat;
    unsigned char *name;
+   char *temp;
+   char changed;
 
-   if(np->name) {
-      Release(np->name);
-   }
-
+   /* The new name is compared against the old one so that title updates
+    * that don't change anything are ignored. */
    status = JXGetWindowProperty(display, np->window,
                                 atoms[ATOM_NET_WM_NAME], 0, 1024, False,
                                 atoms[ATOM_UTF8_STRING], &realType,
                                 &realFormat, &count, &extra, &name);
-   if(status != Success || realFormat == 0) {
-      np->name = NULL;
-   } else {
-      np->name = Allocate(count + 1);
-      memcpy(np->name, name, count);
-      np->name[count] = 0;
+   if(status == Success && realFormat != 0) {
+#ifdef USE_ICONV
+      temp = Allocate(count + 1);
+      memcpy(temp, name, count);
+      temp[count] = 0;
+      temp = ConvertFromUTF8(temp);
+      changed = ReplaceString(&np->name, &np->nameSize, temp, strlen(temp));
+      Release(temp);
+#else
+      changed = ReplaceString(&np->name, &np->nameSize,
+                              (const char*)name, count);
+#endif
       JXFree(name);
-      np->name = ConvertFromUTF8(np->name);
+      return changed;
    }
 
 #ifdef USE_XUTF8
-   if(!np->name) {
-      status = JXGetWindowProperty(display, np->window,
-                                   XA_WM_NAME, 0, 1024, False,
-                                   atoms[ATOM_COMPOUND_TEXT],
-                                   &realType, &realFormat, &count,
-                                   &extra, &name);
-      if(status == Success && realFormat != 0) {
-         char **tlist;
-         XTextProperty tprop;
-         int tcount;
-         tprop.value = name;
-         tprop.encoding = atoms[ATOM_COMPOUND_TEXT];
-         tprop.format = realFormat;
-         tprop.nitems = count;
-         if(XmbTextPropertyToTextList(display, &tprop, &tlist, &tcount)
-            == Success && tcount > 0) {
-            const size_t len = strlen(tlist[0]) + 1;
-            np->name = Allocate(len);
-            memcpy(np->name, tlist[0], len);
-            XFreeStringList(tlist);
-         }
-         JXFree(name);
+   status = JXGetWindowProperty(display, np->window,
+                                XA_WM_NAME, 0, 1024, False,
+                                atoms[ATOM_COMPOUND_TEXT],
+                                &realType, &realFormat, &count,
+                                &extra, &name);
+   if(status == Success && realFormat != 0) {
+      char **tlist;
+      XTextProperty tprop;
+      int tcount;
+      char found = 0;
+      tprop.value = name;
+      tprop.encoding = atoms[ATOM_COMPOUND_TEXT];
+      tprop.format = realFormat;
+      tprop.nitems = count;
+      changed = 0;
+      if(XmbTextPropertyToTextList(display, &tprop, &tlist, &tcount)
+         == Success && tcount > 0) {
+         changed = ReplaceString(&np->name, &np->nameSize,
+                                 tlist[0], strlen(tlist[0]));
+         XFreeStringList(tlist);
+         found = 1;
+      }
+      JXFree(name);
+      if(found) {
+         return changed;
       }
    }
 #endif
 
-   if(!np->name) {
-      char *temp = NULL;
-      if(JXFetchName(display, np->window, &temp)) {
-         const size_t len = strlen(temp) + 1;
-         np->name = Allocate(len);
-         memcpy(np->name, temp, len);
-         JXFree(temp);
-      }
+   temp = NULL;
+   if(JXFetchName(display, np->window, &temp)) {
+      changed = ReplaceString(&np->name, &np->nameSize, temp, strlen(temp));
+      JXFree(temp);
+      return changed;
    }
+   return ReplaceString(&np->name, &np->nameSize, NULL, 0);
 
 }
 
 /** Read the machine for a client. */
-void ReadWMMachine(ClientNode *np)
+char ReadWMMachine(ClientNode *np)
 {
    XTextProperty tprop;
    char **tlist;
    int tcount;
-
-   if(np->machineName) {
-      Release(np->machineName);
-   }
+   char changed;
 
    XGetWMClientMachine(display, np->window, &tprop);
    if(XmbTextPropertyToTextList(display, &tprop, &tlist, &tcount)
       == Success && tcount > 0) {
-      const size_t len = strlen(tlist[0]) + 1;
-      np->machineName = Allocate(len);
-      memcpy(np->machineName, tlist[0], len);
+      changed = ReplaceString(&np->machineName, &np->machineSize,
+                              tlist[0], strlen(tlist[0]));
       XFreeStringList(tlist);
    } else {
-      np->machineName = NULL;
+      changed = ReplaceString(&np->machineName, &np->machineSize, NULL, 0);
    }
+   return changed;
 }
 
 /** Read the window class for a client. */
@@ -816,12 +967,37 @@ void ReadWMClass(ClientNode *np)
 {
    XClassHint hint;
    Assert(np);
-   if(JXGetClassHint(display, np->window, &hint)) {
+   if(np->window == classWindow) {
+      np->instanceName = classHint.res_name;
+      np->className = classHint.res_class;
+      classWindow = None;
+   } else if(JXGetClassHint(display, np->window, &hint)) {
       np->instanceName = hint.res_name;
       np->className = hint.res_class;
    }
 }
 
+/** Read the instance name of a window that is not yet managed. */
+const char *ReadWindowClass(Window w)
+{
+   ReleaseWindowClass();
+   if(JXGetClassHint(display, w, &classHint)) {
+      classWindow = w;
+      return classHint.res_name;
+   }
+   return NULL;
+}
+
+/** Release a class hint that was not used by ReadWMClass. */
+void ReleaseWindowClass(void)
+{
+   if(classWindow != None) {
+      JXFree(classHint.res_name);
+      JXFree(classHint.res_class);
+      classWindow = None;
+   }
+}
+
 /** Read the protocols hint for a window. */
 void ReadWMProtocols(Window w, ClientState *state)
 {
@@ -838,6 +1014,7 @@ void ReadWMProtocols(Window w, ClientState *state)
 
    state->status &= ~STAT_TAKEFOCUS;
    state->status &= ~STAT_DELETE;
+   state->status &= ~STAT_SYNC;
    status = JXGetWindowProperty(display, w, atoms[ATOM_WM_PROTOCOLS],
                                 0, 32, False, XA_ATOM, &realType, &realFormat,
                                 &count, &extra, &temp);
@@ -851,6 +1028,8 @@ void ReadWMProtocols(Window w, ClientState *state)
          state->status |= STAT_DELETE;
       } else if(p[x] == atoms[ATOM_WM_TAKE_FOCUS]) {
          state->status |= STAT_TAKEFOCUS;
+      } else if(p[x] == atoms[ATOM_NET_WM_SYNC_REQUEST]) {
+         state->status |= STAT_SYNC;
       }
    }
 
@@ -1180,6 +1359,38 @@ char GetWindowAtom(Window window, AtomType atom, Window *value)
 
 }
 
+/** Read a pixmap atom. */
+char GetPixmapAtom(Window window, AtomType atom, Pixmap *value)
+{
+
+   unsigned long count;
+   int status;
+   unsigned long extra;
+   Atom realType;
+   int realFormat;
+   unsigned char *data;
+   char ret;
+
+   Assert(window != None);
+   Assert(value);
+
+   count = 0;
+   status = JXGetWindowProperty(display, window, atoms[atom], 0, 1, False,
+                                XA_PIXMAP, &realType, &realFormat,
+                                &count, &extra, &data);
+   ret = 0;
+   if(status == Success && realFormat != 0 && data) {
+      if(JLIKELY(count == 1)) {
+         *value = *(Pixmap*)data;
+         ret = 1;
+      }
+      JXFree(data);
+   }
+
+   return ret;
+
+}
+
 /** Set a window atom. */
 void SetWindowAtom(Window window, AtomType atom, unsigned long value)
 {
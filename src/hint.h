@@ -19,7 +19,10 @@ typedef enum {
    ATOM_COMPOUND_TEXT,
    ATOM_UTF8_STRING,
    ATOM_XROOTPMAP_ID,
+   ATOM_ESETROOT_PMAP_ID,
    ATOM_MANAGER,
+   ATOM_WM_SELECTION,
+   ATOM_NET_SYSTEM_TRAY_SELECTION,
 
    /* Standard atoms */
    ATOM_WM_STATE,
@@ -101,19 +104,25 @@ typedef enum {
 
    ATOM_NET_WM_STRUT_PARTIAL,
    ATOM_NET_WM_WINDOW_OPACITY,
+   ATOM_NET_WM_SYNC_REQUEST,
+   ATOM_NET_WM_SYNC_REQUEST_COUNTER,
    ATOM_NET_WM_STRUT,
    ATOM_NET_WM_MOVERESIZE,
 
    ATOM_NET_SYSTEM_TRAY_OPCODE,
    ATOM_NET_SYSTEM_TRAY_ORIENTATION,
+   ATOM_NET_SYSTEM_TRAY_ICON_SIZE,
 
    /* MWM atoms */
    ATOM_MOTIF_WM_HINTS,
 
    /* JWM-specific atoms. */
    ATOM_JWM_RESTART,
+   ATOM_JWM_REEXEC,
+   ATOM_JWM_RESTART_STATE,
    ATOM_JWM_EXIT,
    ATOM_JWM_RELOAD,
+   ATOM_JWM_STATS,
    ATOM_JWM_WM_STATE_MAXIMIZED_TOP,
    ATOM_JWM_WM_STATE_MAXIMIZED_BOTTOM,
    ATOM_JWM_WM_STATE_MAXIMIZED_LEFT,
@@ -123,8 +132,10 @@ typedef enum {
 } AtomType;
 
 extern const char jwmRestart[];
+extern const char jwmReexec[];
 extern const char jwmExit[];
 extern const char jwmReload[];
+extern const char jwmStats[];
 extern const char managerProperty[];
 
 #define FIRST_NET_ATOM ATOM_NET_SUPPORTED
@@ -170,15 +181,54 @@ typedef struct ClientState {
    unsigned char windowType;     /**< Window type. */
 } ClientState;
 
+/** Maximum number of _NET_WM_STATE atoms written for a client. */
+#define HINT_STATE_COUNT      16
+
+/** Maximum number of _NET_WM_ALLOWED_ACTIONS atoms written. */
+#define HINT_ALLOWED_COUNT    12
+
+/** Flags for the properties held in a HintCache. */
+#define HINT_WM_STATE         (1 << 0)    /**< WM_STATE. */
+#define HINT_NET_STATE        (1 << 1)    /**< _NET_WM_STATE. */
+#define HINT_DESKTOP          (1 << 2)    /**< _NET_WM_DESKTOP. */
+#define HINT_EXTENTS          (1 << 3)    /**< _NET_FRAME_EXTENTS. */
+#define HINT_ALLOWED          (1 << 4)    /**< _NET_WM_ALLOWED_ACTIONS. */
+
+/** The state properties last written for a client.
+ * Writes that would not change a property are skipped.
+ */
+typedef struct HintCache {
+   unsigned long netState[HINT_STATE_COUNT];    /**< _NET_WM_STATE. */
+   unsigned long allowed[HINT_ALLOWED_COUNT];   /**< Allowed actions. */
+   unsigned long extents[4];     /**< _NET_FRAME_EXTENTS. */
+   unsigned long desktop;        /**< _NET_WM_DESKTOP. */
+   unsigned char netStateCount;  /**< Number of _NET_WM_STATE atoms. */
+   unsigned char allowedCount;   /**< Number of allowed actions. */
+   unsigned char wmState;        /**< WM_STATE (WithdrawnState if deleted). */
+   unsigned char valid;          /**< Properties held (HINT_*). */
+   char withdrawn;               /**< Set if _NET_WM_STATE was deleted. */
+   char pending;                 /**< Set if a write is pending. */
+} HintCache;
+
 extern Atom atoms[ATOM_COUNT];
 
 /*@{*/
+/** Intern all atoms used by JWM with a single request.
+ * This must be called once the display is open.
+ */
+void InternAtoms(void);
+
 #define InitializeHints()  (void)(0)
 void StartupHints(void);
 #define ShutdownHints()    (void)(0)
 #define DestroyHints()     (void)(0)
 /*@}*/
 
+/** Write the size of the desktop (_NET_DESKTOP_GEOMETRY).
+ * This must be called when the size of the root window changes.
+ */
+void WriteDesktopGeometry(void);
+
 /** Determine the current desktop. */
 void ReadCurrentDesktop(void);
 
@@ -190,19 +240,32 @@ void ReadClientInfo(struct ClientNode *np, char alreadyMapped);
 
 /** Read a client's name.
  * @param np The client.
+ * @return 1 if the name changed, 0 if it is the same.
  */
-void ReadWMName(struct ClientNode *np);
+char ReadWMName(struct ClientNode *np);
 
 /** Read a client's machine.
  * @param np The client.
+ * @return 1 if the machine changed, 0 if it is the same.
  */
-void ReadWMMachine(struct ClientNode *np);
+char ReadWMMachine(struct ClientNode *np);
 
 /** Read a client's class.
  * @param np The client.
  */
 void ReadWMClass(struct ClientNode *np);
 
+/** Read the instance name of a window that is not yet managed.
+ * The class hint is kept for ReadWMClass so that it is read only once
+ * if the window is then managed.
+ * @param w The window.
+ * @return The instance name (NULL if not set).
+ */
+const char *ReadWindowClass(Window w);
+
+/** Release a class hint read by ReadWindowClass that was not used. */
+void ReleaseWindowClass(void);
+
 /** Read normal hints for a client.
  * @param np The client.
  */
@@ -244,16 +307,21 @@ void ReadWMHints(Window win, ClientState *state, char alreadyMapped);
  */
 void ReadWMOpacity(Window win, unsigned *opacity);
 
-/** Set the state of a client window.
- * Note that this will call WriteNetState.
+/** Set the state properties of a client window.
+ * This sets WM_STATE, _NET_WM_STATE, _NET_WM_DESKTOP, _NET_FRAME_EXTENTS,
+ * and _NET_WM_ALLOWED_ACTIONS. The properties are written before waiting
+ * for the next event and only if they changed.
  * @param np The client.
  */
 void WriteState(struct ClientNode *np);
 
-/** Set _NET_WM_STATE.
+/** Write the state properties of a client now if a write is pending.
  * @param np The client.
  */
-void WriteNetState(struct ClientNode *np);
+void FlushState(struct ClientNode *np);
+
+/** Write the state properties of all clients with a pending write. */
+void FlushStates(void);
 
 /** Set the opacity of a client window.
  * @param np The client.
@@ -298,6 +366,14 @@ char GetWindowAtom(Window window, AtomType atom, Window *value);
  */
 void SetWindowAtom(Window window, AtomType atom, unsigned long value);
 
+/** Read a pixmap atom.
+ * @param window The window.
+ * @param atom The atom to read.
+ * @param value A pointer to the location to save the pixmap.
+ * @return 1 on success, 0 on failure.
+ */
+char GetPixmapAtom(Window window, AtomType atom, Pixmap *value);
+
 /** Set a pixmap atom.
  * @param window The window.
  * @param atom The atom to set.
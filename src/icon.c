@@ -18,17 +18,65 @@
 #include "color.h"
 #include "settings.h"
 #include "border.h"
+#include "iconcache.h"
+#include "icontheme.h"
+#include "clientlist.h"
+#include "event.h"
+#include "menu.h"
+#include "taskbar.h"
+#include "timing.h"
+#include "stats.h"
+#include "shm.h"
+#include "bulk.h"
+#include "gcpool.h"
 
 IconNode emptyIcon;
 
 #ifdef USE_ICONS
 
+#include <dirent.h>
+#include <sys/stat.h>
+
 /* Must be a power of two. */
 #define HASH_SIZE 128
 
+/** Longs of _NET_WM_ICON read at once.
+ * Properties that fit are read in one request. Larger ones are read
+ * image by image so that huge images can be skipped.
+ */
+#define NET_ICON_CHUNK 4096
+
+/** Longs of _NET_WM_ICON read on the bulk connection.
+ * Larger properties are read image by image on the main connection.
+ */
+#define NET_ICON_BULK_LENGTH (1 << 20)
+
+/** Maximum number of images considered in a _NET_WM_ICON property. */
+#define NET_ICON_MAX_IMAGES 32
+
+/** Initial size limit for images kept from _NET_WM_ICON. */
+#define NET_ICON_LIMIT 128
+
+/** Limit in kilobytes for scaled icons with LowMemory. */
+#define LOW_MEMORY_ICON_LIMIT 512
+
+/** File names in an icon directory.
+ * Each file is indexed under its full name and, if it ends in one of
+ * ICON_EXTENSIONS, under its name without the extension.
+ */
+typedef struct IconFileNode {
+   struct IconFileNode *next;    /**< Next file in the hash chain. */
+   unsigned int extensions;      /**< Bit i set for ICON_EXTENSIONS[i]. */
+   char *name;                   /**< Name without the extension. */
+} IconFileNode;
+
 /** Linked list of icon paths. */
 typedef struct IconPathNode {
    char *path;
+   IconFileNode **files;         /**< Index of the directory. */
+   unsigned int fileMask;        /**< Hash mask for the index. */
+   time_t mtime;                 /**< Directory mtime when indexed. */
+   time_t checked;               /**< Last time the mtime was checked. */
    struct IconPathNode *next;
 } IconPathNode;
 
@@ -61,28 +109,119 @@ const char *ICON_EXTENSIONS[] = {
 static const unsigned EXTENSION_COUNT = ARRAY_LENGTH(ICON_EXTENSIONS);
 static const unsigned MAX_EXTENSION_LENGTH = 5;
 
+/** Initial size of the scaled icon hash (must be a power of two). */
+#define SCALED_HASH_SIZE 64
+
+/** Time to spend decoding deferred icons per pass in microseconds. */
+#define DEFERRED_ICON_BUDGET 10000
+
+/** An icon waiting to be decoded. */
+typedef struct PendingIconNode {
+   IconNode *icon;                  /**< The icon (loading is set). */
+   IconPathNode *ip;                /**< Icon path (NULL if absolute). */
+   char *name;                      /**< Name passed to LoadDeferredIcon. */
+   unsigned int extensions;         /**< Extensions known to exist. */
+   struct PendingIconNode *next;    /**< The next icon to decode. */
+} PendingIconNode;
+
 static IconNode **iconHash;
 static IconPathNode *iconPaths;
 static IconPathNode *iconPathsTail;
 static GC iconGC;
 static char iconSizeSet = 0;
 static char *defaultIconName;
+static PendingIconNode *pendingIcons;
+static PendingIconNode *pendingIconsTail;
+
+/* Icons read from _NET_WM_ICON, hashed by content and shared between
+ * clients with the same icon. */
+static IconNode *binaryHash[HASH_SIZE];
+
+/* Images larger than this are skipped when reading a large _NET_WM_ICON.
+ * This grows if icons are ever drawn larger. */
+static unsigned int binaryIconLimit;
+
+/* Scaled icons of all icons, hashed by icon and size and kept in
+ * least recently used order. */
+static ScaledIconNode **scaledHash;
+static unsigned int scaledHashSize;
+static unsigned int scaledCount;
+static ScaledIconNode *scaledNewest;
+static ScaledIconNode *scaledOldest;
+static size_t scaledBytes;
 
 static void DoDestroyIcon(int index, IconNode *icon);
+static char SetClientIcon(ClientNode *np, IconNode *icon);
+static IconNode *ReadClientIcon(const ClientNode *np);
+static IconNode *ReadFallbackIcon(const ClientNode *np);
 static IconNode *ReadNetWMIcon(Window win);
+static IconNode *GetBinaryIcon(const unsigned long *input,
+                               unsigned long count);
+#ifdef USE_BULK
+static void ReadBulkIcon(const BulkProperty *result, void *data);
+#endif
+static unsigned long *ReadNetWMIconRange(Window win, long offset,
+                                         long length,
+                                         unsigned long *count,
+                                         unsigned long *extra);
+static unsigned long *SelectNetWMIcon(Window win,
+                                      const unsigned long *first,
+                                      unsigned long firstCount,
+                                      unsigned long total,
+                                      unsigned long *length);
+static unsigned long GetBinaryDigest(const unsigned long *input,
+                                     unsigned long length);
+static char MatchBinaryIcon(const IconNode *icon,
+                            const unsigned long *input,
+                            unsigned int length);
+static void RemoveBinaryIcon(IconNode *icon);
 static IconNode *ReadWMHintIcon(Window win);
 static IconNode *CreateIcon(const ImageNode *image);
 static IconNode *CreateIconFromDrawable(Drawable d, Pixmap mask);
-static IconNode *CreateIconFromBinary(const unsigned long *data,
-                                      unsigned int length);
-static IconNode *LoadNamedIconHelper(const char *name, const char *path,
-                                     char save, char preserveAspect);
+static IconNode *LoadIconFile(const char *name, char save,
+                              char preserveAspect, char defer);
+static IconNode *LoadNamedIconHelper(const char *name, IconPathNode *ip,
+                                     char save, char preserveAspect,
+                                     char defer);
+static IconNode *DoLoadNamedIcon(const char *name, char save,
+                                 char preserveAspect, char defer);
+static ImageNode *LoadIconImage(const char *name, IconPathNode *ip,
+                                unsigned int extensions, char **path);
+static IconNode *QueueIcon(const char *name, IconPathNode *ip,
+                           unsigned int extensions, char preserveAspect);
+static void FinishIcon(PendingIconNode *pp);
+static void FinishPendingIcon(IconNode *icon);
+static void LoadPendingIcons(const TimeType *now, int x, int y, Window w,
+                             void *data);
+static void ReleasePendingIcons(void);
+static void RedrawIcons(void);
+static unsigned int FindIconFile(IconPathNode *ip, const char *name);
+static void IndexIconPath(IconPathNode *ip);
+static void AddIconFile(IconPathNode *ip, const char *name,
+                        size_t length, unsigned int extensions);
+static void ReleaseIconIndex(IconPathNode *ip);
+static unsigned int GetFileHash(const char *str, size_t length);
 
 static ImageNode *GetBestImage(IconNode *icon, int rwidth, int rheight);
 static ScaledIconNode *GetScaledIcon(IconNode *icon, long fg,
                                      int rwidth, int rheight);
+static ScaledIconNode *FindScaledIcon(IconNode *icon, int rwidth,
+                                      int rheight, long fg);
+static void ReleaseSourceImage(IconNode *icon, ImageNode *image);
+static void GetScaledSize(const IconNode *icon, int *width, int *height);
+static void AddScaledIcon(IconNode *icon, ScaledIconNode *np,
+                          int rwidth, int rheight);
+static void TouchScaledIcon(ScaledIconNode *np);
+static void DestroyScaledIcon(ScaledIconNode *np);
+static void TrimScaledIcons(const ScaledIconNode *keep);
+static void ResizeScaledHash(void);
+static unsigned int GetScaledHash(const IconNode *icon, int rwidth,
+                                  int rheight, long fg);
+static void ScaleBitmapImage(const ImageNode *src, long fg,
+                             XImage *image, XImage *mask);
 
 static void InsertIcon(IconNode *icon);
+static void RemoveIcon(unsigned int index, IconNode *icon);
 static IconNode *FindIcon(const char *name);
 static unsigned int GetHash(const char *str);
 
@@ -100,7 +239,10 @@ void InitializeIcons(void)
    }
    memset(&emptyIcon, 0, sizeof(emptyIcon));
    iconSizeSet = 0;
+   binaryIconLimit = NET_ICON_LIMIT;
    defaultIconName = NULL;
+   pendingIcons = NULL;
+   pendingIconsTail = NULL;
 }
 
 /** Startup icon support. */
@@ -120,18 +262,32 @@ void StartupIcons(void)
    iconSize.width_inc = 1;
    iconSize.height_inc = 1;
    JXSetIconSizes(display, rootWindow, &iconSize, 1);
+
+   scaledHashSize = SCALED_HASH_SIZE;
+   scaledHash = Allocate(sizeof(ScaledIconNode*) * scaledHashSize);
+   memset(scaledHash, 0, sizeof(ScaledIconNode*) * scaledHashSize);
+   scaledCount = 0;
+   scaledNewest = NULL;
+   scaledOldest = NULL;
+   scaledBytes = 0;
 }
 
 /** Shutdown icon support. */
 void ShutdownIcons(void)
 {
    unsigned int x;
+   ReleasePendingIcons();
    for(x = 0; x < HASH_SIZE; x++) {
       while(iconHash[x]) {
          DoDestroyIcon(x, iconHash[x]);
       }
+      Assert(binaryHash[x] == NULL);
    }
+   Assert(scaledCount == 0);
+   Release(scaledHash);
+   scaledHash = NULL;
    JXFreeGC(display, iconGC);
+   ShutdownIconTheme();
 }
 
 /** Destroy icon data. */
@@ -140,6 +296,7 @@ void DestroyIcons(void)
    IconPathNode *pn;
    while(iconPaths) {
       pn = iconPaths->next;
+      ReleaseIconIndex(iconPaths);
       Release(iconPaths->path);
       Release(iconPaths);
       iconPaths = pn;
@@ -153,6 +310,8 @@ void DestroyIcons(void)
       Release(defaultIconName);
       defaultIconName = NULL;
    }
+   DestroyIconCache();
+   DestroyIconTheme();
 }
 
 /** Add an icon search path. */
@@ -184,6 +343,10 @@ void AddIconPath(char *path)
       ip->path[length + 1] = 0;
    }
    ExpandPath(&ip->path);
+   ip->files = NULL;
+   ip->fileMask = 0;
+   ip->mtime = 0;
+   ip->checked = 0;
    ip->next = NULL;
 
    if(iconPathsTail) {
@@ -248,49 +411,139 @@ void PutIcon(IconNode *icon, Drawable d, long fg,
 }
 
 /** Load the icon for a client. */
-void LoadIcon(ClientNode *np)
+char LoadIcon(ClientNode *np)
+{
+#ifdef USE_BULK
+   /* _NET_WM_ICON can be large, so read it on the bulk connection. */
+   if(ReadBulkProperty(np->window, atoms[ATOM_NET_WM_ICON], XA_CARDINAL,
+                       NET_ICON_BULK_LENGTH, ReadBulkIcon, NULL)) {
+      return 0;
+   }
+#endif
+   return SetClientIcon(np, ReadClientIcon(np));
+}
+
+/** Set the icon for a client.
+ * @return 1 if the icon changed, 0 otherwise.
+ */
+char SetClientIcon(ClientNode *np, IconNode *icon)
 {
-   /* If client already has an icon, destroy it first. */
+   /* The new icon is read before the old one is released so that an
+    * unchanged shared icon is kept rather than rebuilt. */
+   if(icon == np->icon) {
+      DestroyIcon(icon);
+      return 0;
+   }
    DestroyIcon(np->icon);
-   np->icon = NULL;
+   np->icon = icon;
+   return 1;
+}
 
-   /* Attempt to read _NET_WM_ICON for an icon. */
-   np->icon = ReadNetWMIcon(np->window);
-   if(np->icon) {
+#ifdef USE_BULK
+/** Finish loading the icon for a client once _NET_WM_ICON is read. */
+void ReadBulkIcon(const BulkProperty *result, void *data)
+{
+   ClientNode *np;
+   IconNode *icon = NULL;
+
+   np = FindClientByWindow(result->window);
+   if(!np) {
       return;
    }
+
+   if(result->extra > 0) {
+      /* Too big to read at once; only read the images we can use. */
+      icon = ReadNetWMIcon(np->window);
+   } else if(result->data && result->format == 32 && result->count > 0) {
+      const unsigned long *input = (const unsigned long*)result->data;
+      unsigned long count = result->count;
+      if(count > NET_ICON_CHUNK) {
+         /* Drop images too large to use, as when read in pieces. */
+         unsigned long *selected;
+         selected = SelectNetWMIcon(np->window, input, count, count, &count);
+         if(selected) {
+            icon = GetBinaryIcon(selected, count);
+            Release(selected);
+         }
+      } else {
+         icon = GetBinaryIcon(input, count);
+      }
+   }
+   if(!icon) {
+      icon = ReadFallbackIcon(np);
+   }
+
+   if(SetClientIcon(np, icon)) {
+      InvalidateTaskBar();
+      RequireBorderDraw(np);
+      RequireTaskUpdate();
+      RequirePagerUpdate();
+   }
+}
+#endif
+
+/** Read the icon for a client. */
+IconNode *ReadClientIcon(const ClientNode *np)
+{
+   IconNode *icon;
+
+   /* Attempt to read _NET_WM_ICON for an icon. */
+   icon = ReadNetWMIcon(np->window);
+   if(icon) {
+      return icon;
+   }
+   return ReadFallbackIcon(np);
+}
+
+/** Read the icon for a client that does not set _NET_WM_ICON. */
+IconNode *ReadFallbackIcon(const ClientNode *np)
+{
+   IconNode *icon;
+
    if(np->owner != None) {
-      np->icon = ReadNetWMIcon(np->owner);
-      if(np->icon) {
-         return;
+      icon = ReadNetWMIcon(np->owner);
+      if(icon) {
+         return icon;
       }
    }
 
    /* Attempt to read an icon from XWMHints. */
-   np->icon = ReadWMHintIcon(np->window);
-   if(np->icon) {
-      return;
+   icon = ReadWMHintIcon(np->window);
+   if(icon) {
+      return icon;
    }
    if(np->owner != None) {
-      np->icon = ReadNetWMIcon(np->owner);
-      if(np->icon) {
-         return;
+      icon = ReadNetWMIcon(np->owner);
+      if(icon) {
+         return icon;
       }
    }
 
    /* Attempt to read an icon based on the window name. */
    if(np->instanceName) {
-      np->icon = LoadNamedIcon(np->instanceName, 1, 1);
-      if(np->icon) {
-         return;
-      }
+      return LoadDeferredIcon(np->instanceName, 1);
    }
+   return NULL;
 }
 
 /** Load an icon from a file. */
 IconNode *LoadNamedIcon(const char *name, char save, char preserveAspect)
+{
+   return DoLoadNamedIcon(name, save, preserveAspect, 0);
+}
+
+/** Load an icon, decoding it later from the event loop. */
+IconNode *LoadDeferredIcon(const char *name, char preserveAspect)
+{
+   return DoLoadNamedIcon(name, 1, preserveAspect, 1);
+}
+
+/** Helper for LoadNamedIcon and LoadDeferredIcon. */
+IconNode *DoLoadNamedIcon(const char *name, char save,
+                          char preserveAspect, char defer)
 {
 
+   const ThemeIcon *theme;
    IconNode *icon;
    IconPathNode *ip;
 
@@ -304,29 +557,37 @@ IconNode *LoadNamedIcon(const char *name, char save, char preserveAspect)
    /* See if this icon has already been loaded. */
    icon = FindIcon(name);
    if(icon) {
+      if(icon->loading && !defer) {
+         FinishPendingIcon(icon);
+      }
       return icon;
    }
 
    /* Check for an absolute file name. */
    if(name[0] == '/') {
-      ImageNode *image = LoadImage(name, 0, 0, 1);
-      if(image) {
-         icon = CreateIcon(image);
-         icon->preserveAspect = preserveAspect;
-         icon->name = CopyString(name);
-         if(save) {
-            InsertIcon(icon);
-         }
-         DestroyImage(image);
+      return LoadIconFile(name, save, preserveAspect, defer);
+   }
+
+   /* Try the icon theme.
+    * The icon is saved under its largest file and the file for each
+    * size is chosen when the icon is drawn. */
+   theme = FindThemeIcon(name);
+   if(theme) {
+      char *path = GetThemeIconPath(theme, 0);
+      icon = FindIcon(path);
+      if(!icon) {
+         icon = LoadIconFile(path, save, preserveAspect, defer);
+      }
+      Release(path);
+      if(icon != &emptyIcon) {
+         icon->theme = theme;
          return icon;
-      } else {
-         return &emptyIcon;
       }
    }
 
    /* Try icon paths. */
    for(ip = iconPaths; ip; ip = ip->next) {
-      icon = LoadNamedIconHelper(name, ip->path, save, preserveAspect);
+      icon = LoadNamedIconHelper(name, ip, save, preserveAspect, defer);
       if(icon) {
          return icon;
       }
@@ -336,183 +597,833 @@ IconNode *LoadNamedIcon(const char *name, char save, char preserveAspect)
    return NULL;
 }
 
+/** Load an icon from an absolute file name. */
+IconNode *LoadIconFile(const char *name, char save,
+                       char preserveAspect, char defer)
+{
+   ImageNode *image;
+   IconNode *icon;
+
+   if(defer) {
+      if(access(name, R_OK) < 0) {
+         return &emptyIcon;
+      }
+      return QueueIcon(name, NULL, 1, preserveAspect);
+   }
+   image = LoadImageHeader(name);
+   if(image) {
+      icon = CreateIcon(image);
+      icon->preserveAspect = preserveAspect;
+      icon->name = CopyString(name);
+      if(save) {
+         InsertIcon(icon);
+      }
+      DestroyImage(image);
+      return icon;
+   } else {
+      return &emptyIcon;
+   }
+}
+
 /** Helper for loading icons by name. */
-IconNode *LoadNamedIconHelper(const char *name, const char *path,
-                              char save, char preserveAspect)
+IconNode *LoadNamedIconHelper(const char *name, IconPathNode *ip,
+                              char save, char preserveAspect, char defer)
+{
+   ImageNode *image;
+   IconNode *result;
+   char *path;
+   unsigned int extensions;
+
+   /* Only consider files known to exist.
+    * Names in subdirectories are not indexed, so try them all. */
+   if(strchr(name, '/')) {
+      extensions = (unsigned int)-1;
+   } else {
+      extensions = FindIconFile(ip, name);
+      if(!extensions) {
+         return NULL;
+      }
+   }
+
+   if(defer) {
+      return QueueIcon(name, ip, extensions, preserveAspect);
+   }
+
+   /* Create the icon if we were able to load the image. */
+   image = LoadIconImage(name, ip, extensions, &path);
+   if(!image) {
+      return NULL;
+   }
+   result = CreateIcon(image);
+   result->preserveAspect = preserveAspect;
+   result->name = path;
+   if(save) {
+      InsertIcon(result);
+   }
+   DestroyImage(image);
+   return result;
+}
+
+/** Load the image for an icon name.
+ * The candidates are tried in the order of ICON_EXTENSIONS.
+ * @param name The icon name (or absolute file name if ip is NULL).
+ * @param ip The icon path containing the file.
+ * @param extensions Bit i set to try ICON_EXTENSIONS[i].
+ * @param path Set to the file that was loaded (to be released).
+ * @return The image (NULL if none of the candidates could be loaded).
+ */
+ImageNode *LoadIconImage(const char *name, IconPathNode *ip,
+                         unsigned int extensions, char **path)
 {
    ImageNode *image;
    char *temp;
    const unsigned nameLength = strlen(name);
-   const unsigned pathLength = strlen(path);
+   const unsigned pathLength = ip ? strlen(ip->path) : 0;
    const char hasExtension = strchr(name, '.') != NULL;
    unsigned i;
 
+   if(!ip) {
+      image = LoadImageHeader(name);
+      *path = image ? CopyString(name) : NULL;
+      return image;
+   }
+
    /* Full file name. */
    temp = AllocateStack(nameLength + pathLength + MAX_EXTENSION_LENGTH + 1);
-   memcpy(&temp[0], path, pathLength);
+   memcpy(&temp[0], ip->path, pathLength);
    memcpy(&temp[pathLength], name, nameLength + 1);
 
    /* Attempt to load the image. */
    image = NULL;
-   if(hasExtension) {
-      image = LoadImage(temp, 0, 0, 1);
+   if(hasExtension && (extensions & 1)) {
+      image = LoadImageHeader(temp);
    }
    if(!image) {
       for(i = 0; i < EXTENSION_COUNT; i++) {
          const unsigned len = strlen(ICON_EXTENSIONS[i]);
+         if(!(extensions & (1 << i))) {
+            continue;
+         }
          memcpy(&temp[pathLength + nameLength], ICON_EXTENSIONS[i], len + 1);
-         image = LoadImage(temp, 0, 0, 1);
+         image = LoadImageHeader(temp);
          if(image) {
             break;
          }
       }
    }
+
+   *path = image ? CopyString(temp) : NULL;
    ReleaseStack(temp);
+   return image;
+}
 
-   /* Create the icon if we were able to load the image. */
-   if(image) {
-      IconNode *result = CreateIcon(image);
-      result->preserveAspect = preserveAspect;
-      result->name = CopyString(temp);
-      if(save) {
-         InsertIcon(result);
+/** Queue an icon to be decoded from the event loop.
+ * The icon is saved under the name of its first candidate file and has
+ * no size until it is decoded.
+ */
+IconNode *QueueIcon(const char *name, IconPathNode *ip,
+                    unsigned int extensions, char preserveAspect)
+{
+   PendingIconNode *pp;
+   IconNode *icon;
+   unsigned int first;
+
+   icon = CreateIcon(NULL);
+   icon->preserveAspect = preserveAspect;
+   icon->loading = 1;
+   if(ip) {
+      const size_t pathLength = strlen(ip->path);
+      const size_t nameLength = strlen(name);
+      const char *ext;
+      for(first = 0; first < EXTENSION_COUNT - 1; first++) {
+         if(extensions & (1 << first)) {
+            break;
+         }
       }
-      DestroyImage(image);
-      return result;
+      ext = ICON_EXTENSIONS[first];
+      icon->name = Allocate(pathLength + nameLength + strlen(ext) + 1);
+      memcpy(icon->name, ip->path, pathLength);
+      memcpy(&icon->name[pathLength], name, nameLength);
+      strcpy(&icon->name[pathLength + nameLength], ext);
+   } else {
+      icon->name = CopyString(name);
+   }
+   InsertIcon(icon);
+
+   pp = Allocate(sizeof(PendingIconNode));
+   pp->icon = icon;
+   pp->ip = ip;
+   pp->name = CopyString(name);
+   pp->extensions = extensions;
+   pp->next = NULL;
+   if(pendingIconsTail) {
+      pendingIconsTail->next = pp;
+   } else {
+      pendingIcons = pp;
+      RegisterTimeout(0, LoadPendingIcons, NULL);
    }
+   pendingIconsTail = pp;
 
-   return NULL;
+   return icon;
 }
 
-/** Read the icon property from a client. */
-IconNode *ReadNetWMIcon(Window win)
+/** Decode a deferred icon.
+ * The pending node is released. If none of the candidates can be loaded,
+ * the icon keeps a size of zero and is never drawn.
+ */
+void FinishIcon(PendingIconNode *pp)
 {
-   static const long MAX_LENGTH = 1 << 20;
-   IconNode *icon = NULL;
-   unsigned long count;
-   int status;
-   unsigned long extra;
-   Atom realType;
-   int realFormat;
-   unsigned char *data;
-   status = JXGetWindowProperty(display, win, atoms[ATOM_NET_WM_ICON],
-                                0, MAX_LENGTH, False, XA_CARDINAL,
-                                &realType, &realFormat, &count, &extra, &data);
-   if(status == Success && realFormat != 0 && data) {
-      icon = CreateIconFromBinary((unsigned long*)data, count);
-      JXFree(data);
+   IconNode *icon = pp->icon;
+   ImageNode *image;
+   char *path;
+
+   image = LoadIconImage(pp->name, pp->ip, pp->extensions, &path);
+   icon->loading = 0;
+   if(image) {
+      if(strcmp(path, icon->name)) {
+         RemoveIcon(GetHash(icon->name), icon);
+         Release(icon->name);
+         icon->name = path;
+         InsertIcon(icon);
+      } else {
+         Release(path);
+      }
+      icon->width = image->width;
+      icon->height = image->height;
+      icon->bitmap = image->bitmap;
+#ifdef USE_XRENDER
+      icon->render = image->render;
+#endif
+      DestroyImage(image);
    }
-   return icon;
+   Release(pp->name);
+   Release(pp);
 }
 
-/** Read the icon WMHint property from a client. */
-IconNode *ReadWMHintIcon(Window win)
+/** Decode a deferred icon now. */
+void FinishPendingIcon(IconNode *icon)
 {
-   IconNode *icon = NULL;
-   XWMHints *hints = JXGetWMHints(display, win);
-   if(hints) {
-      Drawable d = None;
-      Pixmap mask = None;
-      if(hints->flags & IconMaskHint) {
-         mask = hints->icon_mask;
-      }
-      if(hints->flags & IconPixmapHint) {
-         d = hints->icon_pixmap;
-      }
-      if(d != None) {
-         icon = CreateIconFromDrawable(d, mask);
+   PendingIconNode **ppp;
+   PendingIconNode *last = NULL;
+   for(ppp = &pendingIcons; *ppp; ppp = &(*ppp)->next) {
+      PendingIconNode *pp = *ppp;
+      if(pp->icon == icon) {
+         *ppp = pp->next;
+         if(pendingIconsTail == pp) {
+            pendingIconsTail = last;
+         }
+         FinishIcon(pp);
+         return;
       }
-      JXFree(hints);
+      last = pp;
    }
-   return icon;
 }
 
-/** Create an icon from XPM image data. */
-IconNode *GetDefaultIcon(void)
+/** Decode deferred icons for a while and redraw what shows them. */
+void LoadPendingIcons(const TimeType *now, int x, int y, Window w,
+                      void *data)
 {
-   static const char * const name = "default";
-   const unsigned width = 8;
-   const unsigned height = 8;
-   const unsigned border = 1;
-   ImageNode *image;
-   IconNode *result;
-   unsigned bytes;
-   unsigned x, y;
-
-   /* Load the specified default, if configured. */
-   if(defaultIconName) {
-      result = LoadNamedIcon(defaultIconName, 1, 1);
-      return result ? result : &emptyIcon;
-   }
-
-   /* Check if this icon has already been loaded */
-   result = FindIcon(name);
-   if(result) {
-      return result;
+   const unsigned long long start = GetMonotonicTime();
+   char loaded = 0;
+
+   while(pendingIcons) {
+      PendingIconNode *pp = pendingIcons;
+      pendingIcons = pp->next;
+      if(!pendingIcons) {
+         pendingIconsTail = NULL;
+      }
+      FinishIcon(pp);
+      loaded = 1;
+      if(GetMonotonicTime() - start >= DEFERRED_ICON_BUDGET) {
+         break;
+      }
    }
 
-   /* Allocate image data. */
-   bytes = (width * height + 7) / 8;
-   image = CreateImage(width, height, 1);
-   memset(image->data, 0, bytes);
-#ifdef USE_XRENDER
-   image->render = 0;
-#endif
-
-   /* Allocate the icon node. */
-   result = CreateIcon(image);
-   result->name = CopyString(name);
-   result->images = image;
-   InsertIcon(result);
-
-   /* Draw the icon. */
-   for(y = border; y < height - border; y++) {
-      const unsigned pixel_left = y * width + border;
-      const unsigned pixel_right = y * width + width - 1 - border;
-      const unsigned offset_left = pixel_left / 8;
-      const unsigned mask_left = 1 << (pixel_left % 8);
-      const unsigned offset_right = pixel_right / 8;
-      const unsigned mask_right = 1 << (pixel_right % 8);
-      image->data[offset_left] |= mask_left;
-      image->data[offset_right] |= mask_right;
+   /* Let events through before decoding the rest. */
+   if(pendingIcons) {
+      RegisterTimeout(0, LoadPendingIcons, NULL);
    }
-   for(x = border; x < width - border; x++) {
-      const unsigned pixel_top = x + border * width;
-      const unsigned pixel_bottom = x + width * (height - 1 - border);
-      const unsigned offset_top = pixel_top / 8;
-      const unsigned mask_top = 1 << (pixel_top % 8);
-      const unsigned offset_bottom = pixel_bottom / 8;
-      const unsigned mask_bottom = 1 << (pixel_bottom % 8);
-      image->data[offset_top] |= mask_top;
-      image->data[offset_bottom] |= mask_bottom;
+   if(loaded) {
+      RedrawIcons();
    }
+}
 
-   return result;
+/** Drop icons that are still waiting to be decoded. */
+void ReleasePendingIcons(void)
+{
+   UnregisterTimeout(LoadPendingIcons, NULL);
+   while(pendingIcons) {
+      PendingIconNode *pp = pendingIcons->next;
+      pendingIcons->icon->loading = 0;
+      Release(pendingIcons->name);
+      Release(pendingIcons);
+      pendingIcons = pp;
+   }
+   pendingIconsTail = NULL;
 }
 
-IconNode *CreateIconFromDrawable(Drawable d, Pixmap mask)
+/** Redraw everything that may show a deferred icon. */
+void RedrawIcons(void)
 {
-   ImageNode *image;
+   ClientNode *np;
+   unsigned int layer;
 
-   image = LoadImageFromDrawable(d, mask);
-   if(image) {
-      IconNode *result = CreateIcon(image);
-      result->images = image;
-      return result;
-   } else {
-      return NULL;
+   for(layer = 0; layer < LAYER_COUNT; layer++) {
+      for(np = nodes[layer]; np; np = np->next) {
+         if(np->icon) {
+            DrawBorder(np);
+         }
+      }
    }
+   InvalidateTaskBar();
+   RequirePagerUpdate();
+   RedrawMenus();
 }
 
-/** Get the best image for the requested size. */
-ImageNode *GetBestImage(IconNode *icon, int rwidth, int rheight)
+/** Determine which extensions of a name exist in an icon directory.
+ * The directory is indexed on first use and again when it changes.
+ * Bit i of the result is set if name + ICON_EXTENSIONS[i] exists.
+ */
+unsigned int FindIconFile(IconPathNode *ip, const char *name)
 {
-   ImageNode *best;
-   ImageNode *ip;
-
-   /* If we don't have an image loaded, load one. */
-   if(icon->images == NULL) {
-      return LoadImage(icon->name, rwidth, rheight, icon->preserveAspect);
+   const size_t length = strlen(name);
+   const time_t now = time(NULL);
+   IconFileNode *fp;
+
+   /* Check the directory at most once a second. */
+   if(ip->checked != now) {
+      struct stat sbuf;
+      const time_t mtime = stat(ip->path, &sbuf) ? 0 : sbuf.st_mtime;
+      ip->checked = now;
+      if(!ip->files || mtime != ip->mtime) {
+         ReleaseIconIndex(ip);
+         ip->mtime = mtime;
+         IndexIconPath(ip);
+      }
+   }
+
+   fp = ip->files[GetFileHash(name, length) & ip->fileMask];
+   for(; fp; fp = fp->next) {
+      if(!strcmp(fp->name, name)) {
+         return fp->extensions;
+      }
+   }
+   return 0;
+}
+
+/** Build the index of an icon directory. */
+void IndexIconPath(IconPathNode *ip)
+{
+   DIR *dir;
+   struct dirent *entry;
+   unsigned int count, size;
+
+   /* Size the table for the number of entries. */
+   count = 0;
+   dir = opendir(ip->path);
+   if(dir) {
+      while(readdir(dir)) {
+         count += 1;
+      }
+      rewinddir(dir);
+   }
+   size = 16;
+   while(size < count) {
+      size <<= 1;
+   }
+   ip->fileMask = size - 1;
+   ip->files = Allocate(size * sizeof(IconFileNode*));
+   memset(ip->files, 0, size * sizeof(IconFileNode*));
+   if(!dir) {
+      return;
+   }
+
+   while((entry = readdir(dir)) != NULL) {
+      const size_t length = strlen(entry->d_name);
+      unsigned i;
+      AddIconFile(ip, entry->d_name, length, 1);
+      for(i = 1; i < EXTENSION_COUNT; i++) {
+         const size_t len = strlen(ICON_EXTENSIONS[i]);
+         if(length > len
+            && !strcmp(&entry->d_name[length - len], ICON_EXTENSIONS[i])) {
+            AddIconFile(ip, entry->d_name, length - len, 1 << i);
+         }
+      }
+   }
+   closedir(dir);
+}
+
+/** Add a file name to the index of an icon directory. */
+void AddIconFile(IconPathNode *ip, const char *name,
+                 size_t length, unsigned int extensions)
+{
+   const unsigned int index = GetFileHash(name, length) & ip->fileMask;
+   IconFileNode *fp;
+   for(fp = ip->files[index]; fp; fp = fp->next) {
+      if(!strncmp(fp->name, name, length) && fp->name[length] == 0) {
+         fp->extensions |= extensions;
+         return;
+      }
+   }
+   fp = Allocate(sizeof(IconFileNode) + length + 1);
+   fp->name = (char*)(fp + 1);
+   memcpy(fp->name, name, length);
+   fp->name[length] = 0;
+   fp->extensions = extensions;
+   fp->next = ip->files[index];
+   ip->files[index] = fp;
+}
+
+/** Release the index of an icon directory. */
+void ReleaseIconIndex(IconPathNode *ip)
+{
+   unsigned int x;
+   if(!ip->files) {
+      return;
+   }
+   for(x = 0; x <= ip->fileMask; x++) {
+      while(ip->files[x]) {
+         IconFileNode *next = ip->files[x]->next;
+         Release(ip->files[x]);
+         ip->files[x] = next;
+      }
+   }
+   Release(ip->files);
+   ip->files = NULL;
+}
+
+/** Get the hash for part of a file name. */
+unsigned int GetFileHash(const char *str, size_t length)
+{
+   unsigned int hash = 0;
+   size_t x;
+   for(x = 0; x < length; x++) {
+      hash = (hash + (hash << 5)) ^ (unsigned int)str[x];
+   }
+   return hash;
+}
+
+/** Read the icon property from a client. */
+IconNode *ReadNetWMIcon(Window win)
+{
+   IconNode *icon;
+   unsigned long *input;
+   unsigned long count;
+   unsigned long extra;
+
+   input = ReadNetWMIconRange(win, 0, NET_ICON_CHUNK, &count, &extra);
+   if(!input) {
+      return NULL;
+   }
+   if(extra > 0) {
+      /* Too big to read at once; only read the images we can use. */
+      unsigned long *selected;
+      selected = SelectNetWMIcon(win, input, count,
+                                 count + extra / 4, &count);
+      JXFree(input);
+      if(!selected) {
+         return NULL;
+      }
+      input = selected;
+   }
+
+   icon = GetBinaryIcon(input, count);
+
+   if(extra > 0) {
+      Release(input);
+   } else {
+      JXFree(input);
+   }
+   return icon;
+}
+
+/** Get the icon for _NET_WM_ICON data.
+ * The icon of another client with the same data is shared.
+ */
+IconNode *GetBinaryIcon(const unsigned long *input, unsigned long count)
+{
+   IconNode *icon;
+   unsigned long digest;
+   unsigned int index;
+
+   digest = GetBinaryDigest(input, count);
+   index = digest & (HASH_SIZE - 1);
+
+   /* Share the icon of another client with the same data. */
+   for(icon = binaryHash[index]; icon; icon = icon->next) {
+      if(icon->digest == digest && MatchBinaryIcon(icon, input, count)) {
+         icon->refs += 1;
+         break;
+      }
+   }
+
+   if(!icon) {
+      const StatsTime start = StartStats();
+      icon = CreateIconFromBinary(input, count);
+      RecordSectionStats(SECTION_ICON_BINARY, start);
+      if(icon) {
+         icon->digest = digest;
+         icon->refs = 1;
+         icon->next = binaryHash[index];
+         if(binaryHash[index]) {
+            binaryHash[index]->prev = icon;
+         }
+         binaryHash[index] = icon;
+      }
+   }
+   return icon;
+}
+
+/** Read part of _NET_WM_ICON.
+ * The result must be freed with JXFree.
+ */
+unsigned long *ReadNetWMIconRange(Window win, long offset, long length,
+                                  unsigned long *count,
+                                  unsigned long *extra)
+{
+   int status;
+   Atom realType;
+   int realFormat;
+   unsigned char *data;
+   status = JXGetWindowProperty(display, win, atoms[ATOM_NET_WM_ICON],
+                                offset, length, False, XA_CARDINAL,
+                                &realType, &realFormat, count, extra, &data);
+   if(status != Success || !data) {
+      return NULL;
+   }
+   if(realFormat != 32) {
+      JXFree(data);
+      return NULL;
+   }
+   return (unsigned long*)data;
+}
+
+/** Read the images from a large _NET_WM_ICON that we can use.
+ * The image headers are read first. Then every image no larger than
+ * binaryIconLimit is read, or only the smallest image if all of them
+ * are larger. The result uses the property format and must be released
+ * with Release.
+ */
+unsigned long *SelectNetWMIcon(Window win, const unsigned long *first,
+                               unsigned long firstCount,
+                               unsigned long total,
+                               unsigned long *length)
+{
+   unsigned long offsets[NET_ICON_MAX_IMAGES];
+   unsigned long sizes[NET_ICON_MAX_IMAGES];
+   unsigned long *result;
+   unsigned long offset;
+   unsigned long smallest;
+   unsigned int count;
+   unsigned int best;
+   unsigned int x;
+   char found;
+
+   /* Walk the image headers. */
+   count = 0;
+   offset = 0;
+   while(offset + 2 <= total && count < NET_ICON_MAX_IMAGES) {
+      unsigned long width, height;
+      if(offset + 2 <= firstCount) {
+         width = first[offset + 0];
+         height = first[offset + 1];
+      } else {
+         unsigned long *header;
+         unsigned long got, extra;
+         header = ReadNetWMIconRange(win, offset, 2, &got, &extra);
+         if(!header) {
+            break;
+         } else if(got < 2) {
+            JXFree(header);
+            break;
+         }
+         width = header[0];
+         height = header[1];
+         JXFree(header);
+      }
+      if(  width == 0 || height == 0 || width > 0xFFFF || height > 0xFFFF
+         || width * height + 2 > total - offset) {
+         break;
+      }
+      offsets[count] = offset;
+      sizes[count] = Max(width, height);
+      count += 1;
+      offset += width * height + 2;
+   }
+   if(count == 0) {
+      return NULL;
+   }
+
+   /* Pick the images to keep. */
+   found = 0;
+   best = 0;
+   smallest = sizes[0];
+   for(x = 0; x < count; x++) {
+      if(sizes[x] <= binaryIconLimit) {
+         found = 1;
+      }
+      if(sizes[x] < smallest) {
+         smallest = sizes[x];
+         best = x;
+      }
+   }
+
+   /* Read the images. */
+   *length = 0;
+   for(x = 0; x < count; x++) {
+      if(found ? sizes[x] <= binaryIconLimit : x == best) {
+         const unsigned long end = x + 1 < count ? offsets[x + 1] : total;
+         *length += end - offsets[x];
+      }
+   }
+   result = Allocate(sizeof(unsigned long) * *length);
+   *length = 0;
+   for(x = 0; x < count; x++) {
+      const unsigned long end = x + 1 < count ? offsets[x + 1] : total;
+      const unsigned long size = end - offsets[x];
+      if(found ? sizes[x] > binaryIconLimit : x != best) {
+         continue;
+      }
+      if(end <= firstCount) {
+         memcpy(&result[*length], &first[offsets[x]],
+                sizeof(unsigned long) * size);
+      } else {
+         unsigned long *data;
+         unsigned long got, extra;
+         data = ReadNetWMIconRange(win, offsets[x], size, &got, &extra);
+         if(!data) {
+            break;
+         } else if(got < size) {
+            JXFree(data);
+            break;
+         }
+         memcpy(&result[*length], data, sizeof(unsigned long) * size);
+         JXFree(data);
+      }
+      *length += size;
+   }
+   if(*length == 0) {
+      Release(result);
+      return NULL;
+   }
+   return result;
+}
+
+/** Get the hash of _NET_WM_ICON data. */
+unsigned long GetBinaryDigest(const unsigned long *input,
+                              unsigned long length)
+{
+   unsigned long hash = 2166136261UL;
+   unsigned long x;
+   for(x = 0; x < length; x++) {
+      hash = (hash ^ (input[x] & 0xFFFFFFFFUL)) * 16777619UL;
+   }
+   return hash;
+}
+
+/** Determine if an icon was created from the same _NET_WM_ICON data.
+ * This compares the images CreateIconFromBinary would make, which
+ * are stored in reverse order.
+ */
+char MatchBinaryIcon(const IconNode *icon, const unsigned long *input,
+                     unsigned int length)
+{
+   const ImageNode *image;
+   unsigned int *offsets;
+   unsigned int offset;
+   unsigned int count;
+   unsigned int x;
+   char result;
+
+   count = 0;
+   for(image = icon->images; image; image = image->next) {
+      count += 1;
+   }
+
+   /* Find the images in the data. */
+   offsets = AllocateStack(sizeof(unsigned int) * count);
+   offset = 0;
+   x = 0;
+   while(offset < length) {
+      const unsigned width = input[offset + 0];
+      const unsigned height = input[offset + 1];
+      if(  width * height + 2 > length - offset
+         || width == 0 || height == 0) {
+         break;
+      }
+      if(x == count) {
+         x += 1;
+         break;
+      }
+      offsets[x] = offset;
+      x += 1;
+      offset += width * height + 2;
+   }
+   result = x == count;
+
+   /* Compare the pixels. */
+   for(image = icon->images; result && image; image = image->next) {
+      const unsigned char *data = image->data;
+      const unsigned long *pixels;
+      unsigned int size;
+      unsigned int p;
+
+      x -= 1;
+      pixels = &input[offsets[x]];
+      if(  pixels[0] != (unsigned)image->width
+         || pixels[1] != (unsigned)image->height) {
+         result = 0;
+         break;
+      }
+      size = image->width * image->height;
+      pixels += 2;
+      for(p = 0; p < size; p++) {
+         const unsigned long value = ((unsigned long)data[0] << 24)
+                                   | ((unsigned long)data[1] << 16)
+                                   | ((unsigned long)data[2] << 8)
+                                   | ((unsigned long)data[3] << 0);
+         if(value != (pixels[p] & 0xFFFFFFFFUL)) {
+            result = 0;
+            break;
+         }
+         data += 4;
+      }
+   }
+
+   ReleaseStack(offsets);
+   return result;
+}
+
+/** Remove an icon from the shared _NET_WM_ICON icons. */
+void RemoveBinaryIcon(IconNode *icon)
+{
+   if(icon->prev) {
+      icon->prev->next = icon->next;
+   } else {
+      binaryHash[icon->digest & (HASH_SIZE - 1)] = icon->next;
+   }
+   if(icon->next) {
+      icon->next->prev = icon->prev;
+   }
+   icon->next = NULL;
+   icon->prev = NULL;
+}
+
+/** Read the icon WMHint property from a client. */
+IconNode *ReadWMHintIcon(Window win)
+{
+   IconNode *icon = NULL;
+   XWMHints *hints = JXGetWMHints(display, win);
+   if(hints) {
+      Drawable d = None;
+      Pixmap mask = None;
+      if(hints->flags & IconMaskHint) {
+         mask = hints->icon_mask;
+      }
+      if(hints->flags & IconPixmapHint) {
+         d = hints->icon_pixmap;
+      }
+      if(d != None) {
+         icon = CreateIconFromDrawable(d, mask);
+      }
+      JXFree(hints);
+   }
+   return icon;
+}
+
+/** Create an icon from XPM image data. */
+IconNode *GetDefaultIcon(void)
+{
+   static const char * const name = "default";
+   const unsigned width = 8;
+   const unsigned height = 8;
+   const unsigned border = 1;
+   ImageNode *image;
+   IconNode *result;
+   unsigned bytes;
+   unsigned x, y;
+
+   /* Load the specified default, if configured. */
+   if(defaultIconName) {
+      result = LoadNamedIcon(defaultIconName, 1, 1);
+      return result ? result : &emptyIcon;
+   }
+
+   /* Check if this icon has already been loaded */
+   result = FindIcon(name);
+   if(result) {
+      return result;
+   }
+
+   /* Allocate image data. */
+   bytes = (width * height + 7) / 8;
+   image = CreateImage(width, height, 1);
+   memset(image->data, 0, bytes);
+#ifdef USE_XRENDER
+   image->render = 0;
+#endif
+
+   /* Allocate the icon node. */
+   result = CreateIcon(image);
+   result->name = CopyString(name);
+   result->images = image;
+   InsertIcon(result);
+
+   /* Draw the icon. */
+   for(y = border; y < height - border; y++) {
+      const unsigned pixel_left = y * width + border;
+      const unsigned pixel_right = y * width + width - 1 - border;
+      const unsigned offset_left = pixel_left / 8;
+      const unsigned mask_left = 1 << (pixel_left % 8);
+      const unsigned offset_right = pixel_right / 8;
+      const unsigned mask_right = 1 << (pixel_right % 8);
+      image->data[offset_left] |= mask_left;
+      image->data[offset_right] |= mask_right;
+   }
+   for(x = border; x < width - border; x++) {
+      const unsigned pixel_top = x + border * width;
+      const unsigned pixel_bottom = x + width * (height - 1 - border);
+      const unsigned offset_top = pixel_top / 8;
+      const unsigned mask_top = 1 << (pixel_top % 8);
+      const unsigned offset_bottom = pixel_bottom / 8;
+      const unsigned mask_bottom = 1 << (pixel_bottom % 8);
+      image->data[offset_top] |= mask_top;
+      image->data[offset_bottom] |= mask_bottom;
+   }
+
+   return result;
+}
+
+IconNode *CreateIconFromDrawable(Drawable d, Pixmap mask)
+{
+   ImageNode *image;
+
+   image = LoadImageFromDrawable(d, mask);
+   if(image) {
+      IconNode *result = CreateIcon(image);
+      result->images = image;
+      return result;
+   } else {
+      return NULL;
+   }
+}
+
+/** Get the best image for the requested size. */
+ImageNode *GetBestImage(IconNode *icon, int rwidth, int rheight)
+{
+   ImageNode *best;
+   ImageNode *ip;
+
+   /* If we don't have an image loaded, load one.
+    * Icons from a theme use the file made for the closest size. */
+   if(icon->images == NULL) {
+      if(icon->theme) {
+         char *path = GetThemeIconPath(icon->theme, Max(rwidth, rheight));
+         best = LoadImage(path, rwidth, rheight, icon->preserveAspect);
+         Release(path);
+         return best;
+      }
+      return LoadImage(icon->name, rwidth, rheight, icon->preserveAspect);
    }
 
    /* Find the best image to use.
@@ -557,18 +1468,13 @@ ScaledIconNode *GetScaledIcon(IconNode *icon, long fg,
                               int rwidth, int rheight)
 {
 
-   XColor color;
    XImage *image;
-   XPoint *points;
+   XImage *maskImage;
    ImageNode *imageNode;
    ScaledIconNode *np;
+   StatsTime start;
    GC maskGC;
-   int x, y;
-   int scalex, scaley;     /* Fixed point. */
-   int srcx, srcy;         /* Fixed point. */
    int nwidth, nheight;
-   unsigned char *data;
-   unsigned perLine;
 
    if(rwidth == 0) {
       rwidth = icon->width;
@@ -576,38 +1482,37 @@ ScaledIconNode *GetScaledIcon(IconNode *icon, long fg,
    if(rheight == 0) {
       rheight = icon->height;
    }
-
-   if(icon->preserveAspect) {
-      const int ratio = (icon->width << 16) / icon->height;
-      nwidth = Min(rwidth, (rheight * ratio) >> 16);
-      nheight = Min(rheight, (nwidth << 16) / ratio);
-      nwidth = (nheight * ratio) >> 16;
-   } else {
-      nheight = rheight;
-      nwidth = rwidth;
+   if(JUNLIKELY(!icon->name
+      && (unsigned int)Max(rwidth, rheight) > binaryIconLimit)) {
+      /* Keep larger images from _NET_WM_ICON from now on. */
+      binaryIconLimit = Max(rwidth, rheight);
    }
-   nwidth = Max(1, nwidth);
-   nheight = Max(1, nheight);
+
+   nwidth = rwidth;
+   nheight = rheight;
+   GetScaledSize(icon, &nwidth, &nheight);
 
    /* Check if this size already exists. */
-   for(np = icon->nodes; np; np = np->next) {
-      if(!icon->bitmap || np->fg == fg) {
 #ifdef USE_XRENDER
-         /* If we are using xrender and only have one image size
-          * available, we can simply scale the existing icon. */
-         if(icon->render) {
-            if(icon->images == NULL || icon->images->next == NULL) {
-               return np;
-            }
-         }
-#endif
-         if(np->width == nwidth && np->height == nheight) {
+   /* If we are using xrender and only have one image size
+    * available, we can simply scale the existing icon. */
+   if(icon->render && !icon->theme
+      && (icon->images == NULL || icon->images->next == NULL)) {
+      for(np = icon->nodes; np; np = np->next) {
+         if(!icon->bitmap || np->fg == fg) {
+            TouchScaledIcon(np);
             return np;
          }
       }
    }
+#endif
+   np = FindScaledIcon(icon, nwidth, nheight, fg);
+   if(np) {
+      return np;
+   }
 
    /* Need to load the image. */
+   start = StartStats();
    imageNode = GetBestImage(icon, nwidth, nheight);
    if(JUNLIKELY(!imageNode)) {
       return NULL;
@@ -617,14 +1522,9 @@ ScaledIconNode *GetScaledIcon(IconNode *icon, long fg,
 #ifdef USE_XRENDER
    if(icon->render) {
       np = CreateScaledRenderIcon(imageNode, fg);
-      np->next = icon->nodes;
-      icon->nodes = np;
-
-      /* Don't keep the image data around after creating the icon. */
-      if(icon->images == NULL) {
-         DestroyImage(imageNode);
-      }
-
+      AddScaledIcon(icon, np, nwidth, nheight);
+      ReleaseSourceImage(icon, imageNode);
+      RecordSectionStats(SECTION_ICON_SCALE, start);
       return np;
    }
 #endif
@@ -634,92 +1534,418 @@ ScaledIconNode *GetScaledIcon(IconNode *icon, long fg,
    np->fg = fg;
    np->width = nwidth;
    np->height = nheight;
-   np->next = icon->nodes;
-   icon->nodes = np;
 
-   /* Create a mask. */
+   /* Scale into client-side images so that the pixels and the mask
+    * are each uploaded with a single request. */
+   image = CreateUploadImage(rootDepth, nwidth, nheight);
+   maskImage = JXCreateImage(display, rootVisual, 1, ZPixmap,
+                             0, NULL, nwidth, nheight, 8, 0);
+   maskImage->bitmap_unit = 8;
+   maskImage->bitmap_bit_order = LSBFirst;
+   maskImage->data = Allocate(maskImage->bytes_per_line * nheight);
+   memset(maskImage->data, 0, maskImage->bytes_per_line * nheight);
+   if(imageNode->bitmap) {
+      ScaleBitmapImage(imageNode, fg, image, maskImage);
+   } else {
+      ScaleColorImage(imageNode, image, maskImage);
+   }
+
+   /* Create the mask. */
    np->mask = JXCreatePixmap(display, rootWindow, nwidth, nheight, 1);
-   maskGC = JXCreateGC(display, np->mask, 0, NULL);
-   JXSetForeground(display, maskGC, 0);
-   JXFillRectangle(display, np->mask, maskGC, 0, 0, nwidth, nheight);
-   JXSetForeground(display, maskGC, 1);
-
-   /* Create a temporary XImage for scaling. */
-   image = JXCreateImage(display, rootVisual, rootDepth,
-                         ZPixmap, 0, NULL, nwidth, nheight, 8, 0);
-   image->data = Allocate(sizeof(unsigned long) * nwidth * nheight);
-
-   /* Determine the scale factor. */
-   scalex = (imageNode->width << 16) / nwidth;
-   scaley = (imageNode->height << 16) / nheight;
-
-   points = Allocate(sizeof(XPoint) * nwidth);
-   data = imageNode->data;
+   maskGC = AcquireGC(1, 0, NULL);
+   JXPutImage(display, np->mask, maskGC, maskImage,
+              0, 0, 0, 0, nwidth, nheight);
+   ReleaseGC(maskGC);
+   Release(maskImage->data);
+   maskImage->data = NULL;
+   JXDestroyImage(maskImage);
+
+   /* Create the color data pixmap. */
+   np->image = JXCreatePixmap(display, rootWindow, nwidth, nheight,
+                              rootDepth);
+
+   /* Render the image to the color data pixmap. */
+   PutUploadImage(np->image, rootGC, image, 0, 0);
+
+   /* Release the XImage. */
+   DestroyUploadImage(image);
+
+   AddScaledIcon(icon, np, nwidth, nheight);
+   ReleaseSourceImage(icon, imageNode);
+   RecordSectionStats(SECTION_ICON_SCALE, start);
+
+   return np;
+
+}
+
+/** Release image data no longer needed after scaling.
+ * Images loaded from a file are always released since they can be loaded
+ * again. With LowMemory, only the image just scaled is kept of the images
+ * read from the client.
+ */
+void ReleaseSourceImage(IconNode *icon, ImageNode *image)
+{
+   ImageNode **ipp;
+   if(icon->images == NULL) {
+      DestroyImage(image);
+      return;
+   }
+   if(!settings.lowMemory) {
+      return;
+   }
+   ipp = &icon->images;
+   while(*ipp) {
+      ImageNode *ip = *ipp;
+      if(ip == image) {
+         ipp = &ip->next;
+      } else {
+         *ipp = ip->next;
+         ip->next = NULL;
+         DestroyImage(ip);
+      }
+   }
+}
+
+/** Get the size of an icon scaled to fit a size. */
+void GetScaledSize(const IconNode *icon, int *width, int *height)
+{
+   if(icon->preserveAspect) {
+      const int ratio = (icon->width << 16) / icon->height;
+      const int rwidth = *width;
+      const int rheight = *height;
+      *width = Min(rwidth, (rheight * ratio) >> 16);
+      *height = Min(rheight, (*width << 16) / ratio);
+      *width = (*height * ratio) >> 16;
+   }
+   *width = Max(1, *width);
+   *height = Max(1, *height);
+}
+
+/** Scale an icon into an image for upload. */
+XImage *CreateIconImage(IconNode *icon, int width, int height)
+{
+   ImageNode *imageNode;
+   XImage *image;
+   XImage *maskImage;
+
+   if(!icon->width || !icon->height) {
+      return NULL;
+   }
+   GetScaledSize(icon, &width, &height);
+   imageNode = GetBestImage(icon, width, height);
+   if(JUNLIKELY(!imageNode)) {
+      return NULL;
+   }
    if(imageNode->bitmap) {
-      perLine = (imageNode->width >> 3) + ((imageNode->width & 7) ? 1 : 0);
+      ReleaseSourceImage(icon, imageNode);
+      return NULL;
+   }
+
+   image = CreateUploadImage(rootDepth, width, height);
+   maskImage = JXCreateImage(display, rootVisual, 1, ZPixmap,
+                             0, NULL, width, height, 8, 0);
+   maskImage->data = Allocate(maskImage->bytes_per_line * height);
+   memset(maskImage->data, 0, maskImage->bytes_per_line * height);
+   ScaleColorImage(imageNode, image, maskImage);
+   Release(maskImage->data);
+   maskImage->data = NULL;
+   JXDestroyImage(maskImage);
+
+   ReleaseSourceImage(icon, imageNode);
+   return image;
+}
+
+/** Find a scaled icon and mark it as most recently used. */
+ScaledIconNode *FindScaledIcon(IconNode *icon, int rwidth, int rheight,
+                               long fg)
+{
+   ScaledIconNode *np;
+   const unsigned int index = GetScaledHash(icon, rwidth, rheight, fg);
+   for(np = scaledHash[index]; np; np = np->hashNext) {
+      if(np->icon == icon && np->rwidth == rwidth && np->rheight == rheight
+         && (!icon->bitmap || np->fg == fg)) {
+         TouchScaledIcon(np);
+         return np;
+      }
+   }
+   return NULL;
+}
+
+/** Add a new scaled icon.
+ * Scaled icons are keyed by the requested size, which differs from
+ * the size of the node when XRender does the scaling.
+ */
+void AddScaledIcon(IconNode *icon, ScaledIconNode *np,
+                   int rwidth, int rheight)
+{
+   unsigned int index;
+
+   np->icon = icon;
+   np->rwidth = rwidth;
+   np->rheight = rheight;
+   np->next = icon->nodes;
+   icon->nodes = np;
+
+#ifdef USE_XRENDER
+   if(icon->render) {
+      np->bytes = GetPixmapSize(np->width, np->height, 32);
+   } else
+#endif
+   {
+      np->bytes = GetPixmapSize(np->width, np->height, rootDepth)
+                + GetPixmapSize(np->width, np->height, 1);
+   }
+   scaledBytes += np->bytes;
+   RecordPixmapStats(PIXMAP_ICON, (long)np->bytes);
+
+   scaledCount += 1;
+   if(scaledCount > scaledHashSize) {
+      ResizeScaledHash();
+   }
+   index = GetScaledHash(icon, rwidth, rheight, np->fg);
+   np->hashNext = scaledHash[index];
+   scaledHash[index] = np;
+
+   np->older = scaledNewest;
+   np->newer = NULL;
+   if(scaledNewest) {
+      scaledNewest->newer = np;
    } else {
-      perLine = imageNode->width;
+      scaledOldest = np;
+   }
+   scaledNewest = np;
+
+   TrimScaledIcons(np);
+}
+
+/** Mark a scaled icon as most recently used. */
+void TouchScaledIcon(ScaledIconNode *np)
+{
+   if(np == scaledNewest) {
+      return;
+   }
+   np->newer->older = np->older;
+   if(np->older) {
+      np->older->newer = np->newer;
+   } else {
+      scaledOldest = np->newer;
+   }
+   np->older = scaledNewest;
+   np->newer = NULL;
+   scaledNewest->newer = np;
+   scaledNewest = np;
+}
+
+/** Free a scaled icon and remove it from its icon. */
+void DestroyScaledIcon(ScaledIconNode *np)
+{
+   IconNode *icon = np->icon;
+   ScaledIconNode **npp;
+
+   for(npp = &icon->nodes; *npp != np; npp = &(*npp)->next);
+   *npp = np->next;
+
+   npp = &scaledHash[GetScaledHash(icon, np->rwidth, np->rheight, np->fg)];
+   for(; *npp != np; npp = &(*npp)->hashNext);
+   *npp = np->hashNext;
+   scaledCount -= 1;
+
+   if(np->newer) {
+      np->newer->older = np->older;
+   } else {
+      scaledNewest = np->older;
+   }
+   if(np->older) {
+      np->older->newer = np->newer;
+   } else {
+      scaledOldest = np->newer;
+   }
+   scaledBytes -= np->bytes;
+   RecordPixmapStats(PIXMAP_ICON, -(long)np->bytes);
+
+#ifdef USE_XRENDER
+   if(icon->render) {
+      ReleaseScaledRenderIcon(np);
+   } else
+#endif
+   {
+      if(np->image != None) {
+         JXFreePixmap(display, np->image);
+      }
+      if(np->mask != None) {
+         JXFreePixmap(display, np->mask);
+      }
+   }
+   Release(np);
+}
+
+/** Free least recently used scaled icons until within the budget.
+ * Scaled icons are only used while drawing, so any but the one being
+ * returned can be freed.
+ */
+void TrimScaledIcons(const ScaledIconNode *keep)
+{
+   size_t limit = (size_t)settings.iconMemory * 1024;
+   if(  settings.lowMemory
+      && (limit == 0 || limit > LOW_MEMORY_ICON_LIMIT * 1024)) {
+      limit = LOW_MEMORY_ICON_LIMIT * 1024;
    }
+   if(limit == 0) {
+      return;
+   }
+   while(scaledBytes > limit && scaledOldest && scaledOldest != keep) {
+      DestroyScaledIcon(scaledOldest);
+   }
+}
+
+/** Double the size of the scaled icon hash. */
+void ResizeScaledHash(void)
+{
+   ScaledIconNode **oldHash = scaledHash;
+   const unsigned int oldSize = scaledHashSize;
+   unsigned int x;
+
+   scaledHashSize *= 2;
+   scaledHash = Allocate(sizeof(ScaledIconNode*) * scaledHashSize);
+   memset(scaledHash, 0, sizeof(ScaledIconNode*) * scaledHashSize);
+   for(x = 0; x < oldSize; x++) {
+      while(oldHash[x]) {
+         ScaledIconNode *np = oldHash[x];
+         const unsigned int index = GetScaledHash(np->icon, np->rwidth,
+                                                  np->rheight, np->fg);
+         oldHash[x] = np->hashNext;
+         np->hashNext = scaledHash[index];
+         scaledHash[index] = np;
+      }
+   }
+   Release(oldHash);
+}
+
+/** Get the hash for a scaled icon.
+ * The foreground color only matters for bitmaps.
+ */
+unsigned int GetScaledHash(const IconNode *icon, int rwidth, int rheight,
+                           long fg)
+{
+   unsigned long hash = (unsigned long)icon / sizeof(void*);
+   hash = hash * 31 + (unsigned long)rwidth;
+   hash = hash * 31 + (unsigned long)rheight;
+   if(icon->bitmap) {
+      hash = hash * 31 + (unsigned long)fg;
+   }
+   hash ^= hash >> 16;
+   return (unsigned int)hash & (scaledHashSize - 1);
+}
+
+/** Scale a bitmap image (nearest neighbour).
+ * Set bits become fg and are set in the mask.
+ */
+void ScaleBitmapImage(const ImageNode *src, long fg,
+                      XImage *image, XImage *mask)
+{
+   const unsigned perLine = (src->width >> 3) + ((src->width & 7) ? 1 : 0);
+   const int scalex = (src->width << 16) / image->width;
+   const int scaley = (src->height << 16) / image->height;
+   int x, y;
+   int srcx, srcy;         /* Fixed point. */
+
    srcy = 0;
-   for(y = 0; y < nheight; y++) {
-      const int yindex = (srcy >> 16) * perLine;
-      int pindex = 0;
+   for(y = 0; y < image->height; y++) {
+      const unsigned char *row = &src->data[(srcy >> 16) * perLine];
+      unsigned char *maskRow = (unsigned char*)&mask->data[
+         y * mask->bytes_per_line];
       srcx = 0;
-      for(x = 0; x < nwidth; x++) {
-         if(imageNode->bitmap) {
-            const int tx = srcx >> 16;
-            const int offset = yindex + (tx >> 3);
-            const int mask = 1 << (tx & 7);
-            if(data[offset] & mask) {
-               points[pindex].x = x;
-               points[pindex].y = y;
-               XPutPixel(image, x, y, fg);
-               pindex += 1;
-            }
-         } else {
-            const int yindex = (srcy >> 16) * imageNode->width;
-            const int index = 4 * (yindex + (srcx >> 16));
-            color.red = data[index + 1];
-            color.red |= color.red << 8;
-            color.green = data[index + 2];
-            color.green |= color.green << 8;
-            color.blue = data[index + 3];
-            color.blue |= color.blue << 8;
-            GetColor(&color);
-            XPutPixel(image, x, y, color.pixel);
-            if(data[index] >= 128) {
-               points[pindex].x = x;
-               points[pindex].y = y;
-               pindex += 1;
-            }
+      for(x = 0; x < image->width; x++) {
+         const int tx = srcx >> 16;
+         if(row[tx >> 3] & (1 << (tx & 7))) {
+            maskRow[x >> 3] |= 1 << (x & 7);
+            XPutPixel(image, x, y, fg);
          }
          srcx += scalex;
       }
-      JXDrawPoints(display, np->mask, maskGC, points, pindex, CoordModeOrigin);
       srcy += scaley;
    }
-   Release(points);
+}
 
-   /* Release the mask GC. */
-   JXFreeGC(display, maskGC);
- 
-   /* Create the color data pixmap. */
-   np->image = JXCreatePixmap(display, rootWindow, nwidth, nheight,
-                              rootDepth);
+/** Scale an ARGB image with a box filter.
+ * Each pixel is the alpha-weighted average of the source pixels it
+ * covers, which is nearest neighbour when enlarging. Pixels at least
+ * half opaque are set in the mask. For TrueColor visuals with 8-bit
+ * channels and 32-bit pixels, pixels are packed directly into the image
+ * in host byte order and Xlib converts them if needed.
+ */
+void ScaleColorImage(const ImageNode *src, XImage *image, XImage *mask)
+{
+   static const unsigned int one = 1;
+   const int nwidth = image->width;
+   const int nheight = image->height;
+   unsigned int redShift, greenShift, blueShift;
+   unsigned long alpha;
+   int *columns;
+   char direct;
+   int x, y;
 
-   /* Render the image to the color data pixmap. */
-   JXPutImage(display, np->image, rootGC, image, 0, 0, 0, 0, nwidth, nheight);   
-   /* Release the XImage. */
-   Release(image->data);
-   image->data = NULL;
-   JXDestroyImage(image);
+   direct = image->bits_per_pixel == 32
+         && GetPixelLayout(&redShift, &greenShift, &blueShift, &alpha);
+   if(direct) {
+      image->byte_order = *(const char*)&one ? LSBFirst : MSBFirst;
+   }
 
-   if(icon->images == NULL) {
-      DestroyImage(imageNode);
+   /* Source columns covered by each destination column. */
+   columns = AllocateStack(sizeof(int) * (nwidth + 1));
+   for(x = 0; x <= nwidth; x++) {
+      columns[x] = (x * src->width) / nwidth;
    }
 
-   return np;
+   for(y = 0; y < nheight; y++) {
+      const int y0 = (y * src->height) / nheight;
+      const int y1 = Max(y0 + 1, ((y + 1) * src->height) / nheight);
+      unsigned int *row = (unsigned int*)&image->data[
+         y * image->bytes_per_line];
+      unsigned char *maskRow = (unsigned char*)&mask->data[
+         y * mask->bytes_per_line];
+      for(x = 0; x < nwidth; x++) {
+         const int x0 = columns[x];
+         const int x1 = Max(x0 + 1, columns[x + 1]);
+         const unsigned long count = (x1 - x0) * (y1 - y0);
+         unsigned long long red = 0, green = 0, blue = 0;
+         unsigned long a = 0;
+         int sx, sy;
+
+         for(sy = y0; sy < y1; sy++) {
+            const unsigned char *p = &src->data[4 * (sy * src->width + x0)];
+            for(sx = x0; sx < x1; sx++) {
+               a += p[0];
+               red += p[0] * p[1];
+               green += p[0] * p[2];
+               blue += p[0] * p[3];
+               p += 4;
+            }
+         }
+         if(a) {
+            red /= a;
+            green /= a;
+            blue /= a;
+         }
+         if(a / count >= 128) {
+            maskRow[x >> 3] |= 1 << (x & 7);
+         }
 
+         if(direct) {
+            row[x] = (unsigned int)((red << redShift) | (green << greenShift)
+                                    | (blue << blueShift) | alpha);
+         } else {
+            XColor color;
+            color.red = (unsigned short)(red | (red << 8));
+            color.green = (unsigned short)(green | (green << 8));
+            color.blue = (unsigned short)(blue | (blue << 8));
+            GetColor(&color);
+            XPutPixel(image, x, y, color.pixel);
+         }
+      }
+   }
+
+   ReleaseStack(columns);
 }
 
 /** Create an icon from binary data (as specified via window properties). */
@@ -775,24 +2001,39 @@ IconNode *CreateIconFromBinary(const unsigned long *input,
    return result;
 }
 
-/** Create an empty icon node. */
+/** Create an empty icon node.
+ * The image may be NULL for an icon that is still loading.
+ */
 IconNode *CreateIcon(const ImageNode *image)
 {
    IconNode *icon;
    icon = Allocate(sizeof(IconNode));
    icon->nodes = NULL;
    icon->name = NULL;
+   icon->theme = NULL;
    icon->images = NULL;
    icon->next = NULL;
    icon->prev = NULL;
-   icon->width = image->width;
-   icon->height = image->height;
-   icon->bitmap = image->bitmap;
+   if(image) {
+      icon->width = image->width;
+      icon->height = image->height;
+      icon->bitmap = image->bitmap;
+#ifdef USE_XRENDER
+      icon->render = image->render;
+#endif
+   } else {
+      icon->width = 0;
+      icon->height = 0;
+      icon->bitmap = 0;
 #ifdef USE_XRENDER
-   icon->render = image->render;
+      icon->render = haveRender;
 #endif
+   }
    icon->preserveAspect = 1;
    icon->transient = 1;
+   icon->loading = 0;
+   icon->digest = 0;
+   icon->refs = 0;
    return icon;
 }
 
@@ -801,42 +2042,13 @@ void DoDestroyIcon(int index, IconNode *icon)
 {
    if(icon && icon != &emptyIcon) {
       while(icon->nodes) {
-         ScaledIconNode *np = icon->nodes;
-#ifdef USE_XRENDER
-         if(icon->render) {
-            if(np->image != None) {
-               JXRenderFreePicture(display, np->image);
-            }
-            if(np->mask != None) {
-               JXRenderFreePicture(display, np->mask);
-            }
-#else
-         if(0) {
-#endif
-         } else {
-            if(np->image != None) {
-               JXFreePixmap(display, np->image);
-            }
-            if(np->mask != None) {
-               JXFreePixmap(display, np->mask);
-            }
-         }
-         icon->nodes = np->next;
-         Release(np);
+         DestroyScaledIcon(icon->nodes);
       }
       DestroyImage(icon->images);
       if(icon->name) {
          Release(icon->name);
       }
-
-      if(icon->prev) {
-         icon->prev->next = icon->next;
-      } else {
-         iconHash[index] = icon->next;
-      }
-      if(icon->next) {
-         icon->next->prev = icon->prev;
-      }
+      RemoveIcon(index, icon);
       Release(icon);
    }
 }
@@ -845,7 +2057,15 @@ void DoDestroyIcon(int index, IconNode *icon)
 void DestroyIcon(IconNode *icon)
 {
    if(icon && icon->transient) {
-      const unsigned int index = GetHash(icon->name);
+      unsigned int index;
+      if(icon->refs > 0) {
+         icon->refs -= 1;
+         if(icon->refs > 0) {
+            return;
+         }
+         RemoveBinaryIcon(icon);
+      }
+      index = GetHash(icon->name);
       DoDestroyIcon(index, icon);
    }
 }
@@ -866,6 +2086,19 @@ void InsertIcon(IconNode *icon)
    iconHash[index] = icon;
 }
 
+/** Remove an icon from the icon hash table. */
+void RemoveIcon(unsigned int index, IconNode *icon)
+{
+   if(icon->prev) {
+      icon->prev->next = icon->next;
+   } else if(iconHash[index] == icon) {
+      iconHash[index] = icon->next;
+   }
+   if(icon->next) {
+      icon->next->prev = icon->prev;
+   }
+}
+
 /** Find a icon in the icon hash table. */
 IconNode *FindIcon(const char *name)
 {
@@ -11,6 +11,7 @@
 #define ICON_H
 
 struct ClientNode;
+struct ThemeIcon;
 
 /** Structure to hold a scaled icon. */
 typedef struct ScaledIconNode {
@@ -22,6 +23,20 @@ typedef struct ScaledIconNode {
    XID image;
    XID mask;
 
+   int xscale;  /**< Transform set on the image (XRender only). */
+   int yscale;  /**< Transform set on the image (XRender only). */
+   int atlas;   /**< Render atlas holding the image (-1 for none). */
+   int atlasX;  /**< Position of the image in its atlas. */
+   int atlasY;  /**< Position of the image in its atlas. */
+
+   int rwidth;                      /**< Requested width. */
+   int rheight;                     /**< Requested height. */
+   size_t bytes;                    /**< Estimated server memory. */
+   struct IconNode *icon;           /**< The icon this belongs to. */
+   struct ScaledIconNode *hashNext; /**< Next in the scaled icon hash. */
+   struct ScaledIconNode *newer;    /**< Next more recently used. */
+   struct ScaledIconNode *older;    /**< Next less recently used. */
+
    struct ScaledIconNode *next;
 
 } ScaledIconNode;
@@ -30,6 +45,8 @@ typedef struct ScaledIconNode {
 typedef struct IconNode {
 
    char *name;                    /**< The name of the icon. */
+   const struct ThemeIcon *theme; /**< Theme files for each size (NULL if
+                                   *   not from an icon theme). */
    struct ImageNode *images;      /**< Images associated with this icon. */
    struct ScaledIconNode *nodes;  /**< Scaled icons. */
    int width;                     /**< Natural width. */
@@ -38,10 +55,15 @@ typedef struct IconNode {
    struct IconNode *next;         /**< The next icon in the list. */
    struct IconNode *prev;         /**< The previous icon in the list. */
 
+   unsigned long digest;          /**< Hash of the _NET_WM_ICON data. */
+   unsigned int refs;             /**< Clients sharing this icon
+                                   *   (0 if not shared). */
+
    char preserveAspect;           /**< Set to preserve the aspect ratio
                                    *   of the icon when scaling. */
    char bitmap;                   /**< Set if this is a bitmap. */
    char transient;                /**< Set if this icon is transient. */
+   char loading;                  /**< Set if waiting to be decoded. */
 #ifdef USE_XRENDER
    char render;                   /**< Set to use render. */
 #endif
@@ -79,10 +101,23 @@ void AddIconPath(char *path);
 void PutIcon(IconNode *icon, Drawable d,
              long fg, int x, int y, int width, int height);
 
+/** Scale an icon into an image for upload.
+ * The aspect ratio is preserved if set for the icon. Only color icons
+ * are supported; transparent pixels are black.
+ * @param icon The icon.
+ * @param width The width to fit.
+ * @param height The height to fit.
+ * @return An image to destroy with DestroyUploadImage (NULL on error).
+ */
+XImage *CreateIconImage(IconNode *icon, int width, int height);
+
 /** Load an icon for a client.
+ * With a bulk connection, _NET_WM_ICON is read in the background and
+ * the client is redrawn once the icon is loaded.
  * @param np The client.
+ * @return 1 if the icon changed, 0 otherwise.
  */
-void LoadIcon(struct ClientNode *np);
+char LoadIcon(struct ClientNode *np);
 
 /** Load an icon.
  * @param name The name of the icon to load.
@@ -92,6 +127,25 @@ void LoadIcon(struct ClientNode *np);
  */
 IconNode *LoadNamedIcon(const char *name, char save, char preserveAspect);
 
+/** Load an icon, decoding it later from the event loop.
+ * The icon is saved in the icon hash and has a size of zero until it
+ * has been decoded, at which point menus, borders and the task bar
+ * are redrawn.
+ * @param name The name of the icon to load.
+ * @param preserveAspect Set to preserve the aspect ratio when scaling.
+ * @return A pointer to the icon (NULL if not found).
+ */
+IconNode *LoadDeferredIcon(const char *name, char preserveAspect);
+
+/** Create an icon from binary data (as specified via window properties).
+ * The icon is transient and is not saved in the icon hash.
+ * @param input The _NET_WM_ICON data.
+ * @param length The number of items in the data.
+ * @return The icon (NULL if the data is invalid).
+ */
+IconNode *CreateIconFromBinary(const unsigned long *input,
+                               unsigned int length);
+
 /** Load the default icon.
  * @return The default icon.
  */
@@ -102,6 +156,14 @@ IconNode *GetDefaultIcon(void);
  */
 void DestroyIcon(IconNode *icon);
 
+/** Scale a color image into client-side images for upload.
+ * @param src The image to scale.
+ * @param image The image to fill, which has the scaled size.
+ * @param mask The cleared 1-bit mask to fill.
+ */
+void ScaleColorImage(const struct ImageNode *src, XImage *image,
+                     XImage *mask);
+
 /** Set the default icon. */
 void SetDefaultIcon(const char *name);
 
@@ -115,9 +177,11 @@ void SetDefaultIcon(const char *name);
 #define DestroyIcons()                     ICON_DUMMY_FUNCTION
 #define AddIconPath( a )                   ICON_DUMMY_FUNCTION
 #define PutIcon( a, b, c, d, e, f, g )     ICON_DUMMY_FUNCTION
-#define LoadIcon( a )                      ICON_DUMMY_FUNCTION
+#define CreateIconImage( a, b, c )         NULL
+#define LoadIcon( a )                      0
 #define GetDefaultIcon()                   NULL
 #define LoadNamedIcon( a, b, c )           NULL
+#define LoadDeferredIcon( a, b )           NULL
 #define DestroyIcon( a )                   ICON_DUMMY_FUNCTION
 #define SetDefaultIcon( a )                ICON_DUMMY_FUNCTION
 
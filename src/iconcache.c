@@ -0,0 +1,308 @@
+/**
+ * @file iconcache.c
+ * @author Joe Wingbermuehle
+ * @date 2026
+ *
+ * @brief Cache of decoded images.
+ *
+ * Each decoded image is stored in its own file in the cache directory,
+ * named by a hash of the source path and requested size. An entry is
+ * only used if the status of the source file matches. Entries are
+ * mapped and the image data points directly into the mapping.
+ *
+ */
+
+#include "jwm.h"
+
+#ifdef USE_ICON_CACHE
+
+#include "iconcache.h"
+#include "image.h"
+#include "main.h"
+#include "misc.h"
+#include "error.h"
+
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <errno.h>
+
+/** Magic number and format of cache entries. */
+static const char CACHE_MAGIC[8] = { 'J', 'W', 'M', 'I', 'M', 'A', 'G', 'E' };
+#define CACHE_FORMAT 1
+
+/** Space reserved for the header.
+ * This keeps the image data aligned within the mapping.
+ */
+#define HEADER_SIZE 64
+
+/** Header of a cache entry.
+ * The header is followed by the image data and the source path.
+ */
+typedef struct ImageHeader {
+   char magic[8];                /**< CACHE_MAGIC. */
+   unsigned int format;          /**< CACHE_FORMAT. */
+   unsigned int pathSize;        /**< Size of the path including the NUL. */
+   unsigned long long mtime;     /**< Modification time of the source. */
+   unsigned long long size;      /**< Size of the source in bytes. */
+   int rwidth;                   /**< Requested width. */
+   int rheight;                  /**< Requested height. */
+   int width;                    /**< Width of the image. */
+   int height;                   /**< Height of the image. */
+   unsigned int dataSize;        /**< Size of the image data. */
+   char bitmap;                  /**< 1 if a bitmap, 0 otherwise. */
+   char preserveAspect;          /**< Set if the aspect was preserved. */
+} ImageHeader;
+
+static char *cacheDirectory = NULL;
+static char cacheDisabled = 0;
+
+static const char *GetCacheDirectory(void);
+static char *GetEntryPath(const char *fileName, int rwidth, int rheight,
+                          char preserveAspect);
+static void CreateCacheDirectory(char *path);
+static unsigned int GetImageSize(int width, int height, char bitmap);
+static void GetImageHeader(ImageHeader *header, const char *fileName,
+                           const struct stat *sbuf, int rwidth, int rheight,
+                           char preserveAspect);
+
+/** Get a cached image. */
+ImageNode *GetCachedImage(const char *fileName, const struct stat *sbuf,
+                          int rwidth, int rheight, char preserveAspect)
+{
+   ImageHeader expected;
+   ImageHeader header;
+   struct stat ebuf;
+   ImageNode *image;
+   char *entryPath;
+   char *data;
+   size_t size;
+   int fd;
+
+   entryPath = GetEntryPath(fileName, rwidth, rheight, preserveAspect);
+   if(!entryPath) {
+      return NULL;
+   }
+   fd = open(entryPath, O_RDONLY);
+   Release(entryPath);
+   if(fd < 0) {
+      return NULL;
+   }
+   if(fstat(fd, &ebuf) != 0 || ebuf.st_size <= HEADER_SIZE) {
+      close(fd);
+      return NULL;
+   }
+   size = ebuf.st_size;
+   data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+   close(fd);
+   if(data == MAP_FAILED) {
+      return NULL;
+   }
+
+   /* The entry may belong to another file with the same hash or to an
+    * older version of this file. */
+   GetImageHeader(&expected, fileName, sbuf, rwidth, rheight,
+                  preserveAspect);
+   memcpy(&header, data, sizeof(header));
+   if(  memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC))
+      || header.format != CACHE_FORMAT
+      || header.pathSize != expected.pathSize
+      || header.mtime != expected.mtime || header.size != expected.size
+      || header.rwidth != rwidth || header.rheight != rheight
+      || header.preserveAspect != preserveAspect
+      || header.width <= 0 || header.height <= 0
+      || header.dataSize != GetImageSize(header.width, header.height,
+                                         header.bitmap)
+      || size != HEADER_SIZE + (size_t)header.dataSize + header.pathSize
+      || memcmp(&data[HEADER_SIZE + header.dataSize], fileName,
+                header.pathSize)) {
+      munmap(data, size);
+      return NULL;
+   }
+
+   image = Allocate(sizeof(ImageNode));
+   image->next = NULL;
+   image->data = (unsigned char*)&data[HEADER_SIZE];
+   image->width = header.width;
+   image->height = header.height;
+   image->bitmap = header.bitmap;
+#ifdef USE_XRENDER
+   image->render = haveRender;
+#endif
+   image->mapSize = size;
+   return image;
+}
+
+/** Add a decoded image to the cache. */
+void CacheImage(const char *fileName, const struct stat *sbuf,
+                int rwidth, int rheight, char preserveAspect,
+                const ImageNode *image)
+{
+   static const char padding[HEADER_SIZE] = { 0 };
+   ImageHeader header;
+   char *entryPath;
+   char *tempPath;
+   FILE *fd;
+   char ok;
+
+   /* Only single images are cached; loaders never return more. */
+   if(image->next || image->width <= 0 || image->height <= 0) {
+      return;
+   }
+
+   entryPath = GetEntryPath(fileName, rwidth, rheight, preserveAspect);
+   if(!entryPath) {
+      return;
+   }
+   CreateCacheDirectory(entryPath);
+
+   GetImageHeader(&header, fileName, sbuf, rwidth, rheight, preserveAspect);
+   header.width = image->width;
+   header.height = image->height;
+   header.bitmap = image->bitmap;
+   header.dataSize = GetImageSize(image->width, image->height,
+                                  image->bitmap);
+
+   /* Write to a temporary file so that readers never see a partial
+    * entry. The cache is optional, so failures are not reported. */
+   tempPath = Allocate(strlen(entryPath) + 16);
+   sprintf(tempPath, "%s.%d", entryPath, (int)getpid());
+   fd = fopen(tempPath, "wb");
+   if(!fd) {
+      Debug("could not write icon cache %s", tempPath);
+      Release(tempPath);
+      Release(entryPath);
+      return;
+   }
+   fwrite(&header, sizeof(header), 1, fd);
+   fwrite(padding, HEADER_SIZE - sizeof(header), 1, fd);
+   fwrite(image->data, header.dataSize, 1, fd);
+   fwrite(fileName, header.pathSize, 1, fd);
+   ok = !ferror(fd);
+   ok = (fclose(fd) == 0) && ok;
+
+   if(!ok || rename(tempPath, entryPath)) {
+      Debug("could not write icon cache %s", entryPath);
+      unlink(tempPath);
+   }
+   Release(tempPath);
+   Release(entryPath);
+}
+
+/** Unmap the data of a cached image. */
+void ReleaseCachedImage(ImageNode *image)
+{
+   Assert(image->mapSize > 0);
+   munmap(image->data - HEADER_SIZE, image->mapSize);
+   image->data = NULL;
+   image->mapSize = 0;
+}
+
+/** Release the cache state. */
+void DestroyIconCache(void)
+{
+   if(cacheDirectory) {
+      Release(cacheDirectory);
+      cacheDirectory = NULL;
+   }
+   cacheDisabled = 0;
+}
+
+/** Get the cache directory.
+ * This is $XDG_CACHE_HOME/jwm/icons or ~/.cache/jwm/icons.
+ */
+const char *GetCacheDirectory(void)
+{
+   const char *base;
+   const char *suffix;
+
+   if(cacheDirectory || cacheDisabled) {
+      return cacheDirectory;
+   }
+
+   base = getenv("XDG_CACHE_HOME");
+   suffix = "/jwm/icons";
+   if(!base || base[0] != '/') {
+      base = getenv("HOME");
+      suffix = "/.cache/jwm/icons";
+   }
+   if(!base || base[0] == 0) {
+      cacheDisabled = 1;
+      return NULL;
+   }
+   cacheDirectory = Allocate(strlen(base) + strlen(suffix) + 1);
+   strcpy(cacheDirectory, base);
+   strcat(cacheDirectory, suffix);
+   return cacheDirectory;
+}
+
+/** Get the path of the cache entry for an image. */
+char *GetEntryPath(const char *fileName, int rwidth, int rheight,
+                   char preserveAspect)
+{
+   const char *directory;
+   unsigned long long hash;
+   char *path;
+   size_t x;
+
+   directory = GetCacheDirectory();
+   if(!directory) {
+      return NULL;
+   }
+
+   /* 64-bit FNV-1a over the path and the requested size. */
+   hash = 14695981039346656037ULL;
+   for(x = 0; fileName[x]; x++) {
+      hash = (hash ^ (unsigned char)fileName[x]) * 1099511628211ULL;
+   }
+   hash = (hash ^ (unsigned int)rwidth) * 1099511628211ULL;
+   hash = (hash ^ (unsigned int)rheight) * 1099511628211ULL;
+   hash = (hash ^ (unsigned char)preserveAspect) * 1099511628211ULL;
+
+   path = Allocate(strlen(directory) + 18);
+   sprintf(path, "%s/%016llx", directory, hash);
+   return path;
+}
+
+/** Create the directories leading up to a cache entry. */
+void CreateCacheDirectory(char *path)
+{
+   char *sep;
+   for(sep = strchr(path + 1, '/'); sep; sep = strchr(sep + 1, '/')) {
+      *sep = 0;
+      if(mkdir(path, 0700) != 0 && errno != EEXIST) {
+         Debug("could not create icon cache directory %s", path);
+         *sep = '/';
+         return;
+      }
+      *sep = '/';
+   }
+}
+
+/** Get the size of the data for an image. */
+unsigned int GetImageSize(int width, int height, char bitmap)
+{
+   if(bitmap) {
+      return (width * height + 7) / 8;
+   } else {
+      return 4 * width * height;
+   }
+}
+
+/** Fill in the fields of a header derived from the source file. */
+void GetImageHeader(ImageHeader *header, const char *fileName,
+                    const struct stat *sbuf, int rwidth, int rheight,
+                    char preserveAspect)
+{
+   memset(header, 0, sizeof(ImageHeader));
+   memcpy(header->magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+   header->format = CACHE_FORMAT;
+   header->pathSize = strlen(fileName) + 1;
+   header->mtime = (unsigned long long)sbuf->st_mtime;
+   header->size = (unsigned long long)sbuf->st_size;
+   header->rwidth = rwidth;
+   header->rheight = rheight;
+   header->preserveAspect = preserveAspect;
+}
+
+#endif /* USE_ICON_CACHE */
@@ -0,0 +1,59 @@
+/**
+ * @file iconcache.h
+ * @author Joe Wingbermuehle
+ * @date 2026
+ *
+ * @brief Cache of decoded images.
+ *
+ */
+
+#ifndef ICONCACHE_H
+#define ICONCACHE_H
+
+struct stat;
+struct ImageNode;
+
+#ifdef USE_ICON_CACHE
+
+/** Get a cached image.
+ * The image data points into a mapping of the cache entry, which is
+ * released by DestroyImage.
+ * @param fileName The file containing the image.
+ * @param sbuf The status of the file.
+ * @param rwidth The requested width.
+ * @param rheight The requested height.
+ * @param preserveAspect Set if the aspect ratio is preserved.
+ * @return The image (NULL if not cached or out of date).
+ */
+struct ImageNode *GetCachedImage(const char *fileName,
+                                 const struct stat *sbuf,
+                                 int rwidth, int rheight,
+                                 char preserveAspect);
+
+/** Add a decoded image to the cache.
+ * @param fileName The file containing the image.
+ * @param sbuf The status of the file.
+ * @param rwidth The requested width.
+ * @param rheight The requested height.
+ * @param preserveAspect Set if the aspect ratio is preserved.
+ * @param image The decoded image.
+ */
+void CacheImage(const char *fileName, const struct stat *sbuf,
+                int rwidth, int rheight, char preserveAspect,
+                const struct ImageNode *image);
+
+/** Unmap the data of a cached image.
+ * @param image The image returned by GetCachedImage.
+ */
+void ReleaseCachedImage(struct ImageNode *image);
+
+/** Release the cache state. */
+void DestroyIconCache(void);
+
+#else
+
+#define DestroyIconCache() ((void)0)
+
+#endif /* USE_ICON_CACHE */
+
+#endif /* ICONCACHE_H */
@@ -0,0 +1,803 @@
+/**
+ * @file icontheme.c
+ * @author Joe Wingbermuehle
+ * @date 2026
+ *
+ * @brief XDG icon theme lookup.
+ *
+ * The index.theme files of the configured theme, the themes it inherits,
+ * and hicolor are read once. Each directory they list is then read to
+ * build an index from icon names to the files available for each size,
+ * so looking up an icon opens no files.
+ *
+ */
+
+#include "jwm.h"
+
+#ifdef USE_ICONS
+
+#include "icontheme.h"
+#include "misc.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+/* Must be a power of two. */
+#define THEME_HASH_SIZE 1024
+
+/** Maximum number of themes followed through Inherits. */
+#define MAX_THEMES 16
+
+/** Theme searched after all others. */
+static const char *FALLBACK_THEME = "hicolor";
+
+/** Types of theme directories. */
+#define THEME_FIXED        0
+#define THEME_SCALABLE     1
+#define THEME_THRESHOLD    2
+
+/** A directory of an icon theme. */
+typedef struct ThemeDirectory {
+   char *path;                /**< Full path ending in '/'. */
+   unsigned int theme;        /**< Position of the theme in the search. */
+   int size;                  /**< Nominal size of the icons. */
+   int minSize;               /**< Smallest size (scalable). */
+   int maxSize;               /**< Largest size (scalable). */
+   int threshold;             /**< Allowed difference (threshold). */
+   char type;                 /**< THEME_FIXED, etc. */
+} ThemeDirectory;
+
+/** A file that provides an icon. */
+typedef struct ThemeFile {
+   struct ThemeFile *next;    /**< Next file for the same name. */
+   unsigned int directory;    /**< Index into themeDirectories. */
+   unsigned int extension;    /**< Index into THEME_EXTENSIONS. */
+} ThemeFile;
+
+/** An icon name and the files that provide it. */
+struct ThemeIcon {
+   struct ThemeIcon *next;    /**< Next in the hash chain. */
+   ThemeFile *files;          /**< Files in any theme directory. */
+   char *name;                /**< Name without the extension. */
+};
+
+/** A directory section of index.theme. */
+typedef struct ThemeSection {
+   char *name;
+   int size;
+   int minSize;
+   int maxSize;
+   int threshold;
+   int scale;
+   char type;
+} ThemeSection;
+
+/* Extensions of theme icons. Bitmaps are listed before SVG. */
+static const char * const THEME_EXTENSIONS[] = {
+#ifdef USE_PNG
+   ".png",
+#endif
+#ifdef USE_XPM
+   ".xpm",
+#endif
+#if defined(USE_CAIRO) && defined(USE_RSVG)
+   ".svg",
+#endif
+   NULL
+};
+static const unsigned int THEME_EXTENSION_COUNT
+   = ARRAY_LENGTH(THEME_EXTENSIONS) - 1;
+
+static char *themeName = NULL;
+static char themeIndexed = 0;
+static ThemeIcon **themeHash = NULL;
+static ThemeDirectory *themeDirectories = NULL;
+static unsigned int themeDirectoryCount = 0;
+static unsigned int themeDirectoryCapacity = 0;
+
+static void IndexThemes(void);
+static char **GetBaseDirectories(unsigned int *count);
+static char *ReadThemeFile(char **bases, unsigned int baseCount,
+                           const char *name);
+static void ReadTheme(char **bases, unsigned int baseCount,
+                      char **names, unsigned int *nameCount,
+                      unsigned int theme);
+static ThemeSection *ParseThemeIndex(char *buffer, unsigned int *count,
+                                     char **inherits, char **directories);
+static void AddThemeNames(char *list, char **names, unsigned int *count);
+static void IndexThemeDirectory(const char *path, unsigned int theme,
+                                const ThemeSection *sp);
+static void AddThemeFile(const char *name, size_t length,
+                         unsigned int directory, unsigned int extension);
+static ThemeIcon *FindThemeName(const char *name, size_t length);
+static int GetDirectoryDistance(const ThemeDirectory *dp, int size);
+static char IsScalableExtension(unsigned int extension);
+static unsigned int GetThemeHash(const char *str, size_t length);
+static char *NextThemeToken(char **str);
+static char *NextThemeField(char **str, char sep);
+
+/** Set the icon theme to search. */
+void SetIconTheme(const char *name)
+{
+   if(themeName) {
+      Release(themeName);
+      themeName = NULL;
+   }
+   if(name) {
+      themeName = CopyString(name);
+      Trim(themeName);
+      if(!themeName[0]) {
+         Release(themeName);
+         themeName = NULL;
+      }
+   }
+}
+
+/** Release the theme index. */
+void ShutdownIconTheme(void)
+{
+   unsigned int x;
+   if(themeHash) {
+      for(x = 0; x < THEME_HASH_SIZE; x++) {
+         while(themeHash[x]) {
+            ThemeIcon *ip = themeHash[x]->next;
+            while(themeHash[x]->files) {
+               ThemeFile *fp = themeHash[x]->files->next;
+               Release(themeHash[x]->files);
+               themeHash[x]->files = fp;
+            }
+            Release(themeHash[x]);
+            themeHash[x] = ip;
+         }
+      }
+      Release(themeHash);
+      themeHash = NULL;
+   }
+   for(x = 0; x < themeDirectoryCount; x++) {
+      Release(themeDirectories[x].path);
+   }
+   if(themeDirectories) {
+      Release(themeDirectories);
+      themeDirectories = NULL;
+   }
+   themeDirectoryCount = 0;
+   themeDirectoryCapacity = 0;
+   themeIndexed = 0;
+}
+
+/** Release the theme index and the theme name. */
+void DestroyIconTheme(void)
+{
+   ShutdownIconTheme();
+   SetIconTheme(NULL);
+}
+
+/** Look up an icon name in the icon themes. */
+const ThemeIcon *FindThemeIcon(const char *name)
+{
+   const size_t length = strlen(name);
+   ThemeIcon *ip;
+   unsigned int i;
+
+   if(!themeName || name[0] == 0 || strchr(name, '/')) {
+      return NULL;
+   }
+   if(!themeIndexed) {
+      IndexThemes();
+   }
+
+   ip = FindThemeName(name, length);
+   if(ip) {
+      return ip;
+   }
+
+   /* Names from the configuration may include the extension. */
+   for(i = 0; i < THEME_EXTENSION_COUNT; i++) {
+      const size_t len = strlen(THEME_EXTENSIONS[i]);
+      if(length > len
+         && !StrCmpNoCase(&name[length - len], THEME_EXTENSIONS[i])) {
+         return FindThemeName(name, length - len);
+      }
+   }
+   return NULL;
+}
+
+/** Get the file of a theme icon best suited to a size. */
+char *GetThemeIconPath(const ThemeIcon *icon, int size)
+{
+   const ThemeFile *best = NULL;
+   const ThemeFile *scalable = NULL;
+   const ThemeFile *fp;
+   const ThemeDirectory *dp;
+   const char *ext;
+   unsigned int theme;
+   int bestDistance = 0;
+   char *path;
+   size_t pathLength, nameLength;
+
+   /* Only the first theme that has the icon is used. */
+   theme = (unsigned int)-1;
+   for(fp = icon->files; fp; fp = fp->next) {
+      theme = Min(theme, themeDirectories[fp->directory].theme);
+   }
+
+   for(fp = icon->files; fp; fp = fp->next) {
+      int distance;
+      dp = &themeDirectories[fp->directory];
+      if(dp->theme != theme) {
+         continue;
+      }
+      if(IsScalableExtension(fp->extension)) {
+         if(!scalable) {
+            scalable = fp;
+         }
+         continue;
+      }
+      distance = size > 0 ? GetDirectoryDistance(dp, size) : 0;
+      if(  !best || distance < bestDistance
+         || (distance == bestDistance
+            && dp->size > themeDirectories[best->directory].size)) {
+         best = fp;
+         bestDistance = distance;
+      }
+   }
+
+   /* Scalable images only replace bitmaps made for other sizes. */
+   if(scalable && (!best || bestDistance > 0)) {
+      best = scalable;
+   }
+
+   Assert(best);
+   dp = &themeDirectories[best->directory];
+   ext = THEME_EXTENSIONS[best->extension];
+   pathLength = strlen(dp->path);
+   nameLength = strlen(icon->name);
+   path = Allocate(pathLength + nameLength + strlen(ext) + 1);
+   memcpy(path, dp->path, pathLength);
+   memcpy(&path[pathLength], icon->name, nameLength);
+   strcpy(&path[pathLength + nameLength], ext);
+   return path;
+}
+
+/** Build the index of the icon themes. */
+void IndexThemes(void)
+{
+   char *names[MAX_THEMES];
+   char **bases;
+   unsigned int baseCount;
+   unsigned int nameCount;
+   unsigned int x;
+   char haveFallback = 0;
+
+   themeIndexed = 1;
+   themeHash = Allocate(sizeof(ThemeIcon*) * THEME_HASH_SIZE);
+   memset(themeHash, 0, sizeof(ThemeIcon*) * THEME_HASH_SIZE);
+
+   bases = GetBaseDirectories(&baseCount);
+   names[0] = CopyString(themeName);
+   nameCount = 1;
+   for(x = 0; ; x++) {
+      if(x == nameCount) {
+         if(haveFallback || nameCount == MAX_THEMES) {
+            break;
+         }
+         names[nameCount] = CopyString(FALLBACK_THEME);
+         nameCount += 1;
+      }
+      if(!strcmp(names[x], FALLBACK_THEME)) {
+         haveFallback = 1;
+      }
+      ReadTheme(bases, baseCount, names, &nameCount, x);
+   }
+
+   for(x = 0; x < nameCount; x++) {
+      Release(names[x]);
+   }
+   for(x = 0; x < baseCount; x++) {
+      Release(bases[x]);
+   }
+   Release(bases);
+}
+
+/** Get the directories that may contain icon themes.
+ * These are ~/.icons followed by the icons directory of each XDG data
+ * directory.
+ */
+char **GetBaseDirectories(unsigned int *count)
+{
+   const char *home = getenv("HOME");
+   const char *dataHome = getenv("XDG_DATA_HOME");
+   const char *dataDirs = getenv("XDG_DATA_DIRS");
+   char **result;
+   char *dirs;
+   char *dir;
+   char *temp;
+   size_t len;
+   unsigned int capacity;
+
+   if(!dataDirs || !dataDirs[0]) {
+      dataDirs = "/usr/local/share:/usr/share";
+   }
+   capacity = 3;
+   for(len = 0; dataDirs[len]; len++) {
+      if(dataDirs[len] == ':') {
+         capacity += 1;
+      }
+   }
+   result = Allocate(sizeof(char*) * capacity);
+   *count = 0;
+
+   if(home && home[0]) {
+      len = strlen(home);
+      temp = Allocate(len + 8);
+      memcpy(temp, home, len);
+      strcpy(&temp[len], "/.icons");
+      result[(*count)++] = temp;
+      if(!dataHome || !dataHome[0]) {
+         temp = Allocate(len + 20);
+         memcpy(temp, home, len);
+         strcpy(&temp[len], "/.local/share/icons");
+         result[(*count)++] = temp;
+      }
+   }
+   if(dataHome && dataHome[0]) {
+      len = strlen(dataHome);
+      temp = Allocate(len + 7);
+      memcpy(temp, dataHome, len);
+      strcpy(&temp[len], "/icons");
+      result[(*count)++] = temp;
+   }
+
+   dirs = CopyString(dataDirs);
+   temp = dirs;
+   while((dir = NextThemeField(&temp, ':')) != NULL) {
+      if(dir[0] && *count < capacity) {
+         len = strlen(dir);
+         result[*count] = Allocate(len + 7);
+         memcpy(result[*count], dir, len);
+         strcpy(&result[*count][len], "/icons");
+         *count += 1;
+      }
+   }
+   Release(dirs);
+   return result;
+}
+
+/** Read the index.theme of a theme.
+ * @param bases The base directories.
+ * @param baseCount The number of base directories.
+ * @param name The name of the theme.
+ * @return The contents (NULL if the theme was not found).
+ */
+char *ReadThemeFile(char **bases, unsigned int baseCount,
+                    const char *name)
+{
+   struct stat sbuf;
+   char *buffer;
+   char *path;
+   size_t offset;
+   unsigned int x;
+   int fd;
+
+   for(x = 0; x < baseCount; x++) {
+      const size_t baseLength = strlen(bases[x]);
+      const size_t nameLength = strlen(name);
+      path = Allocate(baseLength + nameLength + 14);
+      memcpy(path, bases[x], baseLength);
+      path[baseLength] = '/';
+      memcpy(&path[baseLength + 1], name, nameLength);
+      strcpy(&path[baseLength + nameLength + 1], "/index.theme");
+      fd = open(path, O_RDONLY);
+      if(fd < 0) {
+         Release(path);
+         continue;
+      }
+      if(JUNLIKELY(fstat(fd, &sbuf) < 0)) {
+         close(fd);
+         Release(path);
+         continue;
+      }
+      buffer = Allocate(sbuf.st_size + 1);
+      offset = 0;
+      while(offset < (size_t)sbuf.st_size) {
+         const ssize_t rc = read(fd, &buffer[offset], sbuf.st_size - offset);
+         if(rc <= 0) {
+            break;
+         }
+         offset += rc;
+      }
+      buffer[offset] = 0;
+      close(fd);
+      Release(path);
+      return buffer;
+   }
+   return NULL;
+}
+
+/** Read a theme and index its directories.
+ * Themes it inherits are added to the names to search.
+ */
+void ReadTheme(char **bases, unsigned int baseCount,
+               char **names, unsigned int *nameCount,
+               unsigned int theme)
+{
+   ThemeSection *sections;
+   char *buffer;
+   char *inherits;
+   char *directories;
+   char *dir;
+   unsigned int sectionCount;
+   unsigned int x, b;
+
+   buffer = ReadThemeFile(bases, baseCount, names[theme]);
+   if(!buffer) {
+      return;
+   }
+
+   sections = ParseThemeIndex(buffer, &sectionCount,
+                              &inherits, &directories);
+   if(inherits) {
+      AddThemeNames(inherits, names, nameCount);
+   }
+
+   /* The directories of a theme may be split across base directories. */
+   while(directories && (dir = NextThemeToken(&directories)) != NULL) {
+      for(x = 0; x < sectionCount; x++) {
+         if(!strcmp(sections[x].name, dir)) {
+            break;
+         }
+      }
+      if(x == sectionCount || sections[x].scale != 1) {
+         continue;
+      }
+      for(b = 0; b < baseCount; b++) {
+         const size_t baseLength = strlen(bases[b]);
+         const size_t nameLength = strlen(names[theme]);
+         const size_t dirLength = strlen(dir);
+         char *path = Allocate(baseLength + nameLength + dirLength + 4);
+         memcpy(path, bases[b], baseLength);
+         path[baseLength] = '/';
+         memcpy(&path[baseLength + 1], names[theme], nameLength);
+         path[baseLength + nameLength + 1] = '/';
+         memcpy(&path[baseLength + nameLength + 2], dir, dirLength);
+         strcpy(&path[baseLength + nameLength + dirLength + 2], "/");
+         IndexThemeDirectory(path, theme, &sections[x]);
+         Release(path);
+      }
+   }
+
+   Release(sections);
+   Release(buffer);
+}
+
+/** Parse an index.theme file.
+ * The buffer is modified so that the names and values point into it.
+ * @param buffer The contents of the file.
+ * @param count Set to the number of directory sections.
+ * @param inherits Set to the Inherits value (NULL if none).
+ * @param directories Set to the Directories value (NULL if none).
+ * @return The directory sections (to be released with Release).
+ */
+ThemeSection *ParseThemeIndex(char *buffer, unsigned int *count,
+                              char **inherits, char **directories)
+{
+   ThemeSection *sections;
+   ThemeSection *sp;
+   unsigned int capacity;
+   char *line;
+   char inTheme;
+
+   *inherits = NULL;
+   *directories = NULL;
+   *count = 0;
+   capacity = 16;
+   sections = Allocate(sizeof(ThemeSection) * capacity);
+   sp = NULL;
+   inTheme = 0;
+
+   while((line = NextThemeField(&buffer, '\n')) != NULL) {
+      char *value;
+      char *end;
+
+      while(*line == ' ' || *line == '\t') {
+         line += 1;
+      }
+      end = line + strlen(line);
+      while(end > line && (end[-1] == '\r' || end[-1] == ' '
+                           || end[-1] == '\t')) {
+         end -= 1;
+      }
+      *end = 0;
+      if(line[0] == 0 || line[0] == '#') {
+         continue;
+      }
+
+      if(line[0] == '[') {
+         if(end[-1] != ']') {
+            sp = NULL;
+            inTheme = 0;
+            continue;
+         }
+         end[-1] = 0;
+         line += 1;
+         inTheme = !strcmp(line, "Icon Theme");
+         sp = NULL;
+         if(!inTheme) {
+            if(*count == capacity) {
+               capacity *= 2;
+               sections = Reallocate(sections,
+                                     sizeof(ThemeSection) * capacity);
+            }
+            sp = &sections[*count];
+            *count += 1;
+            sp->name = line;
+            sp->size = 0;
+            sp->minSize = -1;
+            sp->maxSize = -1;
+            sp->threshold = 2;
+            sp->scale = 1;
+            sp->type = THEME_THRESHOLD;
+         }
+         continue;
+      }
+
+      value = strchr(line, '=');
+      if(!value) {
+         continue;
+      }
+      end = value;
+      while(end > line && (end[-1] == ' ' || end[-1] == '\t')) {
+         end -= 1;
+      }
+      *end = 0;
+      value += 1;
+      while(*value == ' ' || *value == '\t') {
+         value += 1;
+      }
+
+      if(inTheme) {
+         if(!strcmp(line, "Inherits")) {
+            *inherits = value;
+         } else if(!strcmp(line, "Directories")) {
+            *directories = value;
+         }
+      } else if(sp) {
+         if(!strcmp(line, "Size")) {
+            sp->size = atoi(value);
+         } else if(!strcmp(line, "MinSize")) {
+            sp->minSize = atoi(value);
+         } else if(!strcmp(line, "MaxSize")) {
+            sp->maxSize = atoi(value);
+         } else if(!strcmp(line, "Threshold")) {
+            sp->threshold = atoi(value);
+         } else if(!strcmp(line, "Scale")) {
+            sp->scale = atoi(value);
+         } else if(!strcmp(line, "Type")) {
+            if(!strcmp(value, "Fixed")) {
+               sp->type = THEME_FIXED;
+            } else if(!strcmp(value, "Scalable")) {
+               sp->type = THEME_SCALABLE;
+            } else {
+               sp->type = THEME_THRESHOLD;
+            }
+         }
+      }
+   }
+
+   for(sp = sections; sp < &sections[*count]; sp++) {
+      if(sp->minSize < 0) {
+         sp->minSize = sp->size;
+      }
+      if(sp->maxSize < 0) {
+         sp->maxSize = sp->size;
+      }
+   }
+   return sections;
+}
+
+/** Add the themes in a comma separated list to the search. */
+void AddThemeNames(char *list, char **names, unsigned int *count)
+{
+   char *name;
+   unsigned int x;
+   while((name = NextThemeToken(&list)) != NULL) {
+      if(*count == MAX_THEMES) {
+         return;
+      }
+      for(x = 0; x < *count; x++) {
+         if(!strcmp(names[x], name)) {
+            break;
+         }
+      }
+      if(x == *count) {
+         names[*count] = CopyString(name);
+         *count += 1;
+      }
+   }
+}
+
+/** Add the icons in a theme directory to the index. */
+void IndexThemeDirectory(const char *path, unsigned int theme,
+                         const ThemeSection *sp)
+{
+   ThemeDirectory *dp;
+   struct dirent *entry;
+   DIR *dir;
+   unsigned int directory;
+
+   dir = opendir(path);
+   if(!dir) {
+      return;
+   }
+
+   if(!themeDirectories) {
+      themeDirectoryCapacity = 32;
+      themeDirectories = Allocate(sizeof(ThemeDirectory)
+                                  * themeDirectoryCapacity);
+   } else if(themeDirectoryCount == themeDirectoryCapacity) {
+      themeDirectoryCapacity *= 2;
+      themeDirectories = Reallocate(themeDirectories,
+                                    sizeof(ThemeDirectory)
+                                    * themeDirectoryCapacity);
+   }
+   directory = themeDirectoryCount;
+   themeDirectoryCount += 1;
+   dp = &themeDirectories[directory];
+   dp->path = CopyString(path);
+   dp->theme = theme;
+   dp->size = sp->size;
+   dp->minSize = sp->minSize;
+   dp->maxSize = sp->maxSize;
+   dp->threshold = sp->threshold;
+   dp->type = sp->type;
+
+   while((entry = readdir(dir)) != NULL) {
+      const size_t length = strlen(entry->d_name);
+      unsigned int i;
+      for(i = 0; i < THEME_EXTENSION_COUNT; i++) {
+         const size_t len = strlen(THEME_EXTENSIONS[i]);
+         if(length > len
+            && !strcmp(&entry->d_name[length - len], THEME_EXTENSIONS[i])) {
+            AddThemeFile(entry->d_name, length - len, directory, i);
+            break;
+         }
+      }
+   }
+   closedir(dir);
+}
+
+/** Add a file to the index. */
+void AddThemeFile(const char *name, size_t length,
+                  unsigned int directory, unsigned int extension)
+{
+   ThemeIcon *ip;
+   ThemeFile *fp;
+
+   ip = FindThemeName(name, length);
+   if(!ip) {
+      const unsigned int index
+         = GetThemeHash(name, length) & (THEME_HASH_SIZE - 1);
+      ip = Allocate(sizeof(ThemeIcon) + length + 1);
+      ip->name = (char*)(ip + 1);
+      memcpy(ip->name, name, length);
+      ip->name[length] = 0;
+      ip->files = NULL;
+      ip->next = themeHash[index];
+      themeHash[index] = ip;
+   }
+
+   fp = Allocate(sizeof(ThemeFile));
+   fp->directory = directory;
+   fp->extension = extension;
+   fp->next = ip->files;
+   ip->files = fp;
+}
+
+/** Find a name in the index. */
+ThemeIcon *FindThemeName(const char *name, size_t length)
+{
+   const unsigned int index
+      = GetThemeHash(name, length) & (THEME_HASH_SIZE - 1);
+   ThemeIcon *ip;
+   for(ip = themeHash[index]; ip; ip = ip->next) {
+      if(!strncmp(ip->name, name, length) && ip->name[length] == 0) {
+         return ip;
+      }
+   }
+   return NULL;
+}
+
+/** Determine how far the icons of a directory are from a size.
+ * @return 0 if the directory is made for the size.
+ */
+int GetDirectoryDistance(const ThemeDirectory *dp, int size)
+{
+   int low, high;
+   switch(dp->type) {
+   case THEME_FIXED:
+      low = dp->size;
+      high = dp->size;
+      break;
+   case THEME_SCALABLE:
+      low = dp->minSize;
+      high = dp->maxSize;
+      break;
+   default:
+      low = dp->size - dp->threshold;
+      high = dp->size + dp->threshold;
+      break;
+   }
+   if(size < low) {
+      return low - size;
+   } else if(size > high) {
+      return size - high;
+   } else {
+      return 0;
+   }
+}
+
+/** Determine if an extension is for scalable images. */
+char IsScalableExtension(unsigned int extension)
+{
+   return !strcmp(THEME_EXTENSIONS[extension], ".svg");
+}
+
+/** Get the hash for part of a name. */
+unsigned int GetThemeHash(const char *str, size_t length)
+{
+   unsigned int hash = 5381;
+   size_t x;
+   for(x = 0; x < length; x++) {
+      hash = hash * 33 + (unsigned char)str[x];
+   }
+   return hash;
+}
+
+/** Get the next entry of a comma separated list.
+ * @param str The rest of the list (updated).
+ * @return The entry without surrounding space (NULL at the end).
+ */
+char *NextThemeToken(char **str)
+{
+   char *token;
+   char *end;
+   while((token = NextThemeField(str, ',')) != NULL) {
+      while(*token == ' ' || *token == '\t') {
+         token += 1;
+      }
+      end = token + strlen(token);
+      while(end > token && (end[-1] == ' ' || end[-1] == '\t')) {
+         end -= 1;
+      }
+      *end = 0;
+      if(token[0]) {
+         return token;
+      }
+   }
+   return NULL;
+}
+
+/** Split a string at a separator.
+ * @param str The rest of the string (updated, NULL at the end).
+ * @param sep The separator.
+ * @return The next field (NULL at the end).
+ */
+char *NextThemeField(char **str, char sep)
+{
+   char *field = *str;
+   char *end;
+   if(!field) {
+      return NULL;
+   }
+   end = strchr(field, sep);
+   if(end) {
+      *end = 0;
+      *str = end + 1;
+   } else {
+      *str = NULL;
+   }
+   return field;
+}
+
+#endif /* USE_ICONS */
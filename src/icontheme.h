@@ -0,0 +1,54 @@
+/**
+ * @file icontheme.h
+ * @author Joe Wingbermuehle
+ * @date 2026
+ *
+ * @brief XDG icon theme lookup.
+ *
+ */
+
+#ifndef ICONTHEME_H
+#define ICONTHEME_H
+
+#ifdef USE_ICONS
+
+/** Files available for an icon name in the icon themes. */
+typedef struct ThemeIcon ThemeIcon;
+
+/** Set the icon theme to search.
+ * Themes inherited by this theme and hicolor are searched as well.
+ * @param name The name of the theme (NULL for none).
+ */
+void SetIconTheme(const char *name);
+
+/** Release the theme index.
+ * The index is built again on the next lookup.
+ */
+void ShutdownIconTheme(void);
+
+/** Release the theme index and the theme name. */
+void DestroyIconTheme(void);
+
+/** Look up an icon name in the icon themes.
+ * The index is built on first use.
+ * @param name The icon name (an image extension is ignored).
+ * @return The files for the name (NULL if not in any theme).
+ */
+const ThemeIcon *FindThemeIcon(const char *name);
+
+/** Get the file of a theme icon best suited to a size.
+ * Bitmaps made for the size are preferred, then scalable images, then
+ * the bitmap closest to the size.
+ * @param icon The icon returned by FindThemeIcon.
+ * @param size The size in pixels (0 for the largest bitmap).
+ * @return The path of the file (to be released with Release).
+ */
+char *GetThemeIconPath(const ThemeIcon *icon, int size);
+
+#else
+
+#define SetIconTheme( a )  ((void)0)
+
+#endif /* USE_ICONS */
+
+#endif /* ICONTHEME_H */
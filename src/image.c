@@ -33,22 +33,45 @@
 #include "error.h"
 #include "color.h"
 #include "misc.h"
+#include "iconcache.h"
+#include "trace.h"
+#include "stats.h"
+
+#ifdef USE_ICON_CACHE
+#  include <sys/stat.h>
+#endif
 
 typedef ImageNode *(*ImageLoader)(const char *fileName,
                                   int rwidth, int rheight,
                                   char preserveAspect);
 
+/** Read the size of an image without decoding it.
+ * @return 1 on success, 0 if the size could not be determined.
+ */
+typedef char (*ImageProbe)(const char *fileName, int *width, int *height);
+
+static ImageNode *DecodeImage(const char *fileName, int rwidth, int rheight,
+                              char preserveAspect);
+
 #ifdef USE_CAIRO
 #ifdef USE_RSVG
 static ImageNode *LoadSVGImage(const char *fileName, int rwidth, int rheight,
                                char preserveAspect);
+static char ProbeSVGImage(const char *fileName, int *width, int *height);
+static RsvgHandle *OpenSVGImage(const char *fileName);
+static void GetSVGDimensions(RsvgHandle *rh, int rwidth, int rheight,
+                             RsvgDimensionData *dim);
 #endif
 #endif
 #ifdef USE_JPEG
 static ImageNode *LoadJPEGImage(const char *fileName, int rwidth, int rheight,
                                 char preserveAspect);
+static char ProbeJPEGImage(const char *fileName, int *width, int *height);
 #endif
 #ifdef USE_PNG
+static char ProbePNGImage(const char *fileName, int *width, int *height);
+static unsigned int GetReduction(unsigned int width, unsigned int height,
+                                 int rwidth, int rheight);
 static ImageNode *LoadPNGImage(const char *fileName, int rwidth, int rheight,
                                char preserveAspect);
 #endif
@@ -63,36 +86,39 @@ static ImageNode *LoadXBMImage(const char *fileName, int rwidth, int rheight,
 #ifdef USE_ICONS
 static ImageNode *CreateImageFromXImages(XImage *image, XImage *shape);
 #endif
+static size_t GetImageDataSize(const ImageNode *image);
 
 #ifdef USE_XPM
-static int AllocateColor(Display *d, Colormap cmap, char *name,
-                         XColor *c, void *closure);
-static int FreeColors(Display *d, Colormap cmap, Pixel *pixels, int n,
-                      void *closure);
+static char ParseXPMColor(const char *value, unsigned char *argb);
+static char IsColorName(const char *value, const char *name);
 #endif
 
-/* File extension to image loader mapping. */
+/* File extension to image loader mapping.
+ * Formats that can be decoded at a reduced size have a probe to read
+ * the natural size without decoding the image.
+ */
 static const struct {
    const char *extension;
    ImageLoader loader;
+   ImageProbe probe;
 } IMAGE_LOADERS[] = {
 #ifdef USE_PNG
-   {".png",       LoadPNGImage      },
+   {".png",       LoadPNGImage,     ProbePNGImage     },
 #endif
 #ifdef USE_JPEG
-   {".jpg",       LoadJPEGImage     },
-   {".jpeg",      LoadJPEGImage     },
+   {".jpg",       LoadJPEGImage,    ProbeJPEGImage    },
+   {".jpeg",      LoadJPEGImage,    ProbeJPEGImage    },
 #endif
 #ifdef USE_CAIRO
 #ifdef USE_RSVG
-   {".svg",       LoadSVGImage      },
+   {".svg",       LoadSVGImage,     ProbeSVGImage     },
 #endif
 #endif
 #ifdef USE_XPM
-   {".xpm",       LoadXPMImage      },
+   {".xpm",       LoadXPMImage,     NULL              },
 #endif
 #ifdef USE_XBM
-   {".xbm",       LoadXBMImage      },
+   {".xbm",       LoadXBMImage,     NULL              },
 #endif
 };
 static const unsigned IMAGE_LOADER_COUNT = ARRAY_LENGTH(IMAGE_LOADERS);
@@ -101,9 +127,12 @@ static const unsigned IMAGE_LOADER_COUNT = ARRAY_LENGTH(IMAGE_LOADERS);
 ImageNode *LoadImage(const char *fileName, int rwidth, int rheight,
                      char preserveAspect)
 {
-   unsigned i;
    unsigned name_length;
    ImageNode *result = NULL;
+   TraceTime traceStart;
+#ifdef USE_ICON_CACHE
+   struct stat sbuf;
+#endif
 
    /* Make sure we have a reasonable file name. */
    if(!fileName) {
@@ -119,6 +148,76 @@ ImageNode *LoadImage(const char *fileName, int rwidth, int rheight,
       return result;
    }
 
+   traceStart = StartTrace();
+#ifdef USE_ICON_CACHE
+   if(stat(fileName, &sbuf) == 0) {
+      result = GetCachedImage(fileName, &sbuf, rwidth, rheight,
+                              preserveAspect);
+      if(!result) {
+         result = DecodeImage(fileName, rwidth, rheight, preserveAspect);
+         if(result) {
+            CacheImage(fileName, &sbuf, rwidth, rheight, preserveAspect,
+                       result);
+         }
+      }
+   } else {
+      result = DecodeImage(fileName, rwidth, rheight, preserveAspect);
+   }
+#else
+   result = DecodeImage(fileName, rwidth, rheight, preserveAspect);
+#endif
+   RecordTrace("LoadImage", -1, traceStart);
+
+   return result;
+}
+
+/** Load the size of an image from the specified file. */
+ImageNode *LoadImageHeader(const char *fileName)
+{
+   const unsigned name_length = fileName ? strlen(fileName) : 0;
+   unsigned i;
+
+   for(i = 0; i < IMAGE_LOADER_COUNT; i++) {
+      const char *ext = IMAGE_LOADERS[i].extension;
+      const unsigned ext_length = strlen(ext);
+      if(name_length >= ext_length
+         && !StrCmpNoCase(&fileName[name_length - ext_length], ext)) {
+         ImageNode *result;
+         int width, height;
+         if(!IMAGE_LOADERS[i].probe
+            || access(fileName, R_OK) < 0
+            || !(IMAGE_LOADERS[i].probe)(fileName, &width, &height)
+            || width <= 0 || height <= 0) {
+            break;
+         }
+         result = Allocate(sizeof(ImageNode));
+         result->next = NULL;
+         result->data = NULL;
+         result->width = width;
+         result->height = height;
+         result->bitmap = 0;
+#ifdef USE_XRENDER
+         result->render = haveRender;
+#endif
+#ifdef USE_ICON_CACHE
+         result->mapSize = 0;
+#endif
+         return result;
+      }
+   }
+
+   /* Other formats are decoded to get their size. */
+   return LoadImage(fileName, 0, 0, 1);
+}
+
+/** Decode an image from the specified file. */
+ImageNode *DecodeImage(const char *fileName, int rwidth, int rheight,
+                       char preserveAspect)
+{
+   const unsigned name_length = strlen(fileName);
+   unsigned i;
+   ImageNode *result = NULL;
+
    /* First we attempt to use the extension to determine the type
     * to avoid trying all loaders. */
    for(i = 0; i < IMAGE_LOADER_COUNT; i++) {
@@ -188,6 +287,8 @@ ImageNode *LoadImageFromDrawable(Drawable pmap, Pixmap mask)
 /** Load a PNG image from the given file name.
  * Since libpng uses longjmp, this function is not reentrant to simplify
  * the issues surrounding longjmp and local variables.
+ * Images much larger than the requested size are reduced by an integer
+ * factor as rows are decoded, so the full image is never held.
  */
 #ifdef USE_PNG
 ImageNode *LoadPNGImage(const char *fileName, int rwidth, int rheight,
@@ -197,14 +298,17 @@ ImageNode *LoadPNGImage(const char *fileName, int rwidth, int rheight,
    static ImageNode *result;
    static FILE *fd;
    static unsigned char **rows;
+   static unsigned char *line;
+   static unsigned long *sums;
    static png_structp pngData;
    static png_infop pngInfo;
    static png_infop pngEndInfo;
 
    unsigned char header[8];
    unsigned long rowBytes;
-   int bitDepth, colorType;
+   int bitDepth, colorType, interlaceType;
    unsigned int x, y;
+   unsigned int factor;
    png_uint_32 width;
    png_uint_32 height;
 
@@ -213,6 +317,8 @@ ImageNode *LoadPNGImage(const char *fileName, int rwidth, int rheight,
    result = NULL;
    fd = NULL;
    rows = NULL;
+   line = NULL;
+   sums = NULL;
    pngData = NULL;
    pngInfo = NULL;
    pngEndInfo = NULL;
@@ -243,6 +349,12 @@ ImageNode *LoadPNGImage(const char *fileName, int rwidth, int rheight,
       if(rows) {
          ReleaseStack(rows);
       }
+      if(line) {
+         Release(line);
+      }
+      if(sums) {
+         Release(sums);
+      }
       DestroyImage(result);
       Warning(_("error reading PNG image: %s"), fileName);
       return NULL;
@@ -270,8 +382,7 @@ ImageNode *LoadPNGImage(const char *fileName, int rwidth, int rheight,
    png_read_info(pngData, pngInfo);
 
    png_get_IHDR(pngData, pngInfo, &width, &height,
-                &bitDepth, &colorType, NULL, NULL, NULL);
-   result = CreateImage(width, height, 0);
+                &bitDepth, &colorType, &interlaceType, NULL, NULL);
 
    png_set_expand(pngData);
 
@@ -290,28 +401,138 @@ ImageNode *LoadPNGImage(const char *fileName, int rwidth, int rheight,
    }
 
    png_read_update_info(pngData, pngInfo);
-
    rowBytes = png_get_rowbytes(pngData, pngInfo);
-   rows = AllocateStack(result->height * sizeof(result->data));
-   y = 0;
-   for(x = 0; x < result->height; x++) {
-      rows[x] = &result->data[y];
-      y += rowBytes;
+
+   /* Interlaced images need every pass before a row is complete. */
+   factor = 1;
+   if(interlaceType == PNG_INTERLACE_NONE) {
+      factor = GetReduction(width, height, rwidth, rheight);
    }
 
-   png_read_image(pngData, rows);
+   if(factor == 1) {
+
+      /* Decode directly into the image. */
+      result = CreateImage(width, height, 0);
+      rows = AllocateStack(result->height * sizeof(result->data));
+      y = 0;
+      for(x = 0; x < result->height; x++) {
+         rows[x] = &result->data[y];
+         y += rowBytes;
+      }
+      png_read_image(pngData, rows);
+      ReleaseStack(rows);
+      rows = NULL;
+
+   } else {
+
+      /* Average each block of factor x factor pixels as rows arrive.
+       * Color is weighted by alpha so that transparent pixels do not
+       * darken the edges. */
+      const unsigned int outWidth = (width + factor - 1) / factor;
+      const unsigned int outHeight = (height + factor - 1) / factor;
+      unsigned char *dest;
+      unsigned int band = 0;
+
+      result = CreateImage(outWidth, outHeight, 0);
+      line = Allocate(rowBytes);
+      sums = Allocate(4 * outWidth * sizeof(unsigned long));
+      memset(sums, 0, 4 * outWidth * sizeof(unsigned long));
+      dest = result->data;
+      for(y = 0; y < height; y++) {
+         const unsigned char *src = line;
+         unsigned long *sp = sums;
+         png_read_row(pngData, line, NULL);
+         for(x = 0; x < width; x++) {
+            const unsigned long alpha = src[0];
+            sp[0] += alpha;
+            sp[1] += alpha * src[1];
+            sp[2] += alpha * src[2];
+            sp[3] += alpha * src[3];
+            src += 4;
+            if((x + 1) % factor == 0) {
+               sp += 4;
+            }
+         }
+         band += 1;
+         if(band == factor || y + 1 == height) {
+            sp = sums;
+            for(x = 0; x < outWidth; x++) {
+               const unsigned int columns = Min(factor, width - x * factor);
+               const unsigned long alpha = sp[0];
+               if(alpha) {
+                  dest[0] = alpha / (band * columns);
+                  dest[1] = sp[1] / alpha;
+                  dest[2] = sp[2] / alpha;
+                  dest[3] = sp[3] / alpha;
+               } else {
+                  dest[0] = dest[1] = dest[2] = dest[3] = 0;
+               }
+               dest += 4;
+               sp += 4;
+            }
+            memset(sums, 0, 4 * outWidth * sizeof(unsigned long));
+            band = 0;
+         }
+      }
+      Release(line);
+      line = NULL;
+      Release(sums);
+      sums = NULL;
+
+   }
 
    png_read_end(pngData, pngInfo);
    png_destroy_read_struct(&pngData, &pngInfo, &pngEndInfo);
 
    fclose(fd);
 
-   ReleaseStack(rows);
-   rows = NULL;
-
    return result;
 
 }
+
+/** Read the size of a PNG image from its header. */
+char ProbePNGImage(const char *fileName, int *width, int *height)
+{
+   unsigned char header[24];
+   FILE *fd;
+   size_t count;
+
+   fd = fopen(fileName, "rb");
+   if(!fd) {
+      return 0;
+   }
+   count = fread(header, 1, sizeof(header), fd);
+   fclose(fd);
+
+   /* The signature is followed by the IHDR chunk. */
+   if(count != sizeof(header) || png_sig_cmp(header, 0, 8)
+      || memcmp(&header[12], "IHDR", 4)) {
+      return 0;
+   }
+   *width = (header[16] << 24) | (header[17] << 16)
+          | (header[18] << 8) | header[19];
+   *height = (header[20] << 24) | (header[21] << 16)
+           | (header[22] << 8) | header[23];
+   return 1;
+}
+
+/** Get the largest integer reduction that still covers a size.
+ * A requested dimension of 0 places no limit on that dimension.
+ */
+unsigned int GetReduction(unsigned int width, unsigned int height,
+                          int rwidth, int rheight)
+{
+   unsigned int factor = 1;
+   if(rwidth <= 0 && rheight <= 0) {
+      return 1;
+   }
+   while((width + factor) / (factor + 1) >= (unsigned int)Max(rwidth, 1)
+         && (height + factor) / (factor + 1) >= (unsigned int)Max(rheight, 1)
+         && factor < 64) {
+      factor += 1;
+   }
+   return factor;
+}
 #endif /* USE_PNG */
 
 /** Load a JPEG image from the specified file. */
@@ -371,25 +592,24 @@ ImageNode *LoadJPEGImage(const char *fileName,
    jpeg_read_header(&cinfo, TRUE);
 
    /* Pick an appropriate scale for the image.
-    * We scale the image by the scale value for the dimension with
-    * the smallest absolute change.
+    * The DCT can reduce the image by 1/2, 1/4, or 1/8 while decoding.
+    * We use the largest reduction that still covers the requested size
+    * so that the remaining scaling only ever shrinks the image.
     */
-   jpeg_calc_output_dimensions(&cinfo);
-   if(rwidth != 0 && rheight != 0 &&
-      (!( (rwidth == cinfo.output_width) &&
-          (rheight == cinfo.output_height) ))
-      ) {
-      /* Scale using n/8 with n in [1..8]. */
-      int ratio;
-      if(abs((int)cinfo.output_width - rwidth)
-            < abs((int)cinfo.output_height - rheight)) {
-         ratio = (rwidth << 4) / cinfo.output_width;
-      } else {
-         ratio = (rheight << 4) / cinfo.output_height;
+   if(rwidth != 0 || rheight != 0) {
+      unsigned int denom = 8;
+      while(denom > 1) {
+         const unsigned int w = (cinfo.image_width + denom - 1) / denom;
+         const unsigned int h = (cinfo.image_height + denom - 1) / denom;
+         if(w >= (unsigned int)rwidth && h >= (unsigned int)rheight) {
+            break;
+         }
+         denom /= 2;
       }
-      cinfo.scale_num = Max(1, Min(8, (ratio >> 2)));
-      cinfo.scale_denom = 8;
+      cinfo.scale_num = 1;
+      cinfo.scale_denom = denom;
    }
+   jpeg_calc_output_dimensions(&cinfo);
 
    /* Start decompression. */
    jpeg_start_decompress(&cinfo);
@@ -431,6 +651,37 @@ ImageNode *LoadJPEGImage(const char *fileName,
    return result;
 
 }
+
+/** Read the size of a JPEG image from its header. */
+char ProbeJPEGImage(const char *fileName, int *width, int *height)
+{
+   static struct jpeg_decompress_struct cinfo;
+   static FILE *fd;
+   static JPEGErrorStruct jerr;
+
+   fd = fopen(fileName, "rb");
+   if(fd == NULL) {
+      return 0;
+   }
+
+   cinfo.err = jpeg_std_error(&jerr.pub);
+   jerr.pub.error_exit = JPEGErrorHandler;
+   if(setjmp(jerr.jbuffer)) {
+      jpeg_destroy_decompress(&cinfo);
+      fclose(fd);
+      return 0;
+   }
+
+   jpeg_create_decompress(&cinfo);
+   jpeg_stdio_src(&cinfo, fd);
+   jpeg_read_header(&cinfo, TRUE);
+   *width = cinfo.image_width;
+   *height = cinfo.image_height;
+
+   jpeg_destroy_decompress(&cinfo);
+   fclose(fd);
+   return 1;
+}
 #endif /* USE_JPEG */
 
 #ifdef USE_CAIRO
@@ -439,18 +690,12 @@ ImageNode *LoadSVGImage(const char *fileName, int rwidth, int rheight,
                         char preserveAspect)
 {
 
-#if !GLIB_CHECK_VERSION(2, 35, 0)
-   static char initialized = 0;
-#endif
 #if LIBRSVG_CHECK_VERSION(2, 46, 0)
    RsvgRectangle viewbox;
-   RsvgLength pwidth, pheight;
-   gboolean has_width, has_height, has_viewbox;
 #endif
    ImageNode *result = NULL;
    RsvgHandle *rh;
    RsvgDimensionData dim;
-   GError *e;
    cairo_surface_t *target;
    cairo_t *context;
    int stride;
@@ -459,37 +704,13 @@ ImageNode *LoadSVGImage(const char *fileName, int rwidth, int rheight,
 
    Assert(fileName);
 
-#if !GLIB_CHECK_VERSION(2, 35, 0)
-   if(!initialized) {
-      initialized = 1;
-      g_type_init();
-   }
-#endif
-
    /* Load the image from the file. */
-   e = NULL;
-   rh = rsvg_handle_new_from_file(fileName, &e);
+   rh = OpenSVGImage(fileName);
    if(!rh) {
-      g_error_free(e);
       return NULL;
    }
 
-#if LIBRSVG_CHECK_VERSION(2, 46, 0)
-   rsvg_handle_get_intrinsic_dimensions(rh, &has_width, &pwidth, &has_height, &pheight,
-      &has_viewbox, &viewbox);
-   if(has_width && has_height && pwidth.unit == RSVG_UNIT_PX && pheight.unit == RSVG_UNIT_PX) {
-      dim.width = pwidth.length;
-      dim.height = pheight.length;
-   } else if(has_viewbox) {
-      dim.width = viewbox.width;
-      dim.height = viewbox.height;
-   } else {
-      dim.width = rwidth;
-      dim.height = rheight;
-   }
-#else
-   rsvg_handle_get_dimensions(rh, &dim);
-#endif
+   GetSVGDimensions(rh, rwidth, rheight, &dim);
    if(rwidth == 0 && rheight == 0) {
       rwidth = dim.width;
       rheight = dim.height;
@@ -558,40 +779,235 @@ ImageNode *LoadSVGImage(const char *fileName, int rwidth, int rheight,
    return result;
 
 }
+
+/** Read the size of an SVG image without rendering it. */
+char ProbeSVGImage(const char *fileName, int *width, int *height)
+{
+   RsvgDimensionData dim;
+   RsvgHandle *rh = OpenSVGImage(fileName);
+   if(!rh) {
+      return 0;
+   }
+   GetSVGDimensions(rh, 0, 0, &dim);
+   g_object_unref(rh);
+   *width = dim.width;
+   *height = dim.height;
+   return 1;
+}
+
+/** Parse an SVG image. */
+RsvgHandle *OpenSVGImage(const char *fileName)
+{
+#if !GLIB_CHECK_VERSION(2, 35, 0)
+   static char initialized = 0;
+#endif
+   RsvgHandle *rh;
+   GError *e;
+
+#if !GLIB_CHECK_VERSION(2, 35, 0)
+   if(!initialized) {
+      initialized = 1;
+      g_type_init();
+   }
+#endif
+
+   e = NULL;
+   rh = rsvg_handle_new_from_file(fileName, &e);
+   if(!rh) {
+      g_error_free(e);
+   }
+   return rh;
+}
+
+/** Get the natural size of an SVG image.
+ * The requested size is used if the image does not specify one.
+ */
+void GetSVGDimensions(RsvgHandle *rh, int rwidth, int rheight,
+                      RsvgDimensionData *dim)
+{
+#if LIBRSVG_CHECK_VERSION(2, 46, 0)
+   RsvgRectangle viewbox;
+   RsvgLength pwidth, pheight;
+   gboolean has_width, has_height, has_viewbox;
+
+   rsvg_handle_get_intrinsic_dimensions(rh, &has_width, &pwidth, &has_height, &pheight,
+      &has_viewbox, &viewbox);
+   if(has_width && has_height && pwidth.unit == RSVG_UNIT_PX && pheight.unit == RSVG_UNIT_PX) {
+      dim->width = pwidth.length;
+      dim->height = pheight.length;
+   } else if(has_viewbox) {
+      dim->width = viewbox.width;
+      dim->height = viewbox.height;
+   } else {
+      dim->width = rwidth;
+      dim->height = rheight;
+   }
+#else
+   rsvg_handle_get_dimensions(rh, dim);
+#endif
+}
 #endif /* USE_RSVG */
 #endif /* USE_CAIRO */
 
-/** Load an XPM image from the specified file. */
+/** Load an XPM image from the specified file.
+ * The image is decoded here rather than through an XImage so that colors
+ * need not be allocated on the server and read back.
+ */
 #ifdef USE_XPM
 ImageNode *LoadXPMImage(const char *fileName, int rwidth, int rheight,
                         char preserveAspect)
 {
 
-   ImageNode *result = NULL;
-
-   XpmAttributes attr;
-   XImage *image;
-   XImage *shape;
-   int rc;
+   ImageNode *result;
+   XpmImage xpm;
+   unsigned char *palette;
+   unsigned char *dest;
+   unsigned int x;
 
    Assert(fileName);
 
-   attr.valuemask = XpmAllocColor | XpmFreeColors | XpmColorClosure;
-   attr.alloc_color = AllocateColor;
-   attr.free_colors = FreeColors;
-   attr.color_closure = NULL;
-   rc = XpmReadFileToImage(display, (char*)fileName, &image, &shape, &attr);
-   if(rc == XpmSuccess) {
-      result = CreateImageFromXImages(image, shape);
-      JXDestroyImage(image);
-      if(shape) {
-         JXDestroyImage(shape);
+   if(XpmReadFileToXpmImage((char*)fileName, &xpm, NULL) != XpmSuccess) {
+      return NULL;
+   }
+
+   palette = AllocateStack(4 * xpm.ncolors);
+   for(x = 0; x < xpm.ncolors; x++) {
+      const XpmColor *cp = &xpm.colorTable[x];
+      const char *value = cp->c_color;
+      if(!value) {
+         value = cp->g_color ? cp->g_color : cp->g4_color;
+      }
+      if(!value) {
+         value = cp->m_color;
+      }
+      if(!value || !ParseXPMColor(value, &palette[4 * x])) {
+         palette[4 * x + 0] = 255;
+         palette[4 * x + 1] = 0;
+         palette[4 * x + 2] = 0;
+         palette[4 * x + 3] = 0;
       }
    }
 
+   result = CreateImage(xpm.width, xpm.height, 0);
+   dest = result->data;
+   for(x = 0; x < xpm.width * xpm.height; x++) {
+      const unsigned int index = xpm.data[x];
+      if(JLIKELY(index < xpm.ncolors)) {
+         memcpy(dest, &palette[4 * index], 4);
+      } else {
+         memset(dest, 0, 4);
+      }
+      dest += 4;
+   }
+
+   ReleaseStack(palette);
+   XpmFreeXpmImage(&xpm);
    return result;
 
 }
+
+/** Parse an XPM color to ARGB.
+ * Hex colors and common names are handled here. Other names are looked
+ * up on the server.
+ */
+char ParseXPMColor(const char *value, unsigned char *argb)
+{
+   static const struct {
+      const char *name;
+      unsigned char rgb[3];
+   } COLOR_NAMES[] = {
+      { "black",     {   0,   0,   0 } },
+      { "white",     { 255, 255, 255 } },
+      { "gray",      { 190, 190, 190 } },
+      { "grey",      { 190, 190, 190 } },
+      { "red",       { 255,   0,   0 } },
+      { "green",     {   0, 255,   0 } },
+      { "blue",      {   0,   0, 255 } },
+      { "yellow",    { 255, 255,   0 } },
+      { "cyan",      {   0, 255, 255 } },
+      { "magenta",   { 255,   0, 255 } },
+      { "orange",    { 255, 165,   0 } },
+      { "brown",     { 165,  42,  42 } },
+      { "darkgray",  { 169, 169, 169 } },
+      { "darkgrey",  { 169, 169, 169 } },
+      { "lightgray", { 211, 211, 211 } },
+      { "lightgrey", { 211, 211, 211 } }
+   };
+   XColor c;
+   unsigned int x;
+
+   argb[0] = 255;
+   if(IsColorName(value, "none")) {
+      memset(argb, 0, 4);
+      return 1;
+   }
+
+   if(value[0] == '#') {
+      const unsigned int digits = strspn(&value[1], "0123456789abcdefABCDEF");
+      const unsigned int width = digits / 3;
+      if(value[digits + 1] == 0 && digits % 3 == 0 && width >= 1
+         && width <= 4) {
+         for(x = 0; x < 3; x++) {
+            char hex[5];
+            unsigned long component;
+            memcpy(hex, &value[1 + x * width], width);
+            hex[width] = 0;
+            component = strtoul(hex, NULL, 16);
+            if(width == 1) {
+               component *= 17;
+            } else {
+               component >>= 4 * (width - 2);
+            }
+            argb[x + 1] = (unsigned char)component;
+         }
+         return 1;
+      }
+   }
+
+   /* grayN and greyN range from black at 0 to white at 100. */
+   if(   (!strncmp(value, "gray", 4) || !strncmp(value, "grey", 4))
+      && value[4] >= '0' && value[4] <= '9') {
+      char *end;
+      const unsigned long level = strtoul(&value[4], &end, 10);
+      if(*end == 0 && level <= 100) {
+         memset(&argb[1], (level * 255 + 50) / 100, 3);
+         return 1;
+      }
+   }
+
+   for(x = 0; x < ARRAY_LENGTH(COLOR_NAMES); x++) {
+      if(IsColorName(value, COLOR_NAMES[x].name)) {
+         memcpy(&argb[1], COLOR_NAMES[x].rgb, 3);
+         return 1;
+      }
+   }
+
+   if(JXParseColor(display, rootColormap, value, &c)) {
+      argb[1] = (unsigned char)(c.red >> 8);
+      argb[2] = (unsigned char)(c.green >> 8);
+      argb[3] = (unsigned char)(c.blue >> 8);
+      return 1;
+   }
+
+   return 0;
+}
+
+/** Compare a color to a lower case name ignoring case and spaces. */
+char IsColorName(const char *value, const char *name)
+{
+   for(;;) {
+      while(*value == ' ') {
+         value += 1;
+      }
+      if(tolower((unsigned char)*value) != *name) {
+         return 0;
+      } else if(*name == 0) {
+         return 1;
+      }
+      value += 1;
+      name += 1;
+   }
+}
 #endif /* USE_XPM */
 
 /** Load an XBM image from the specified file. */
@@ -658,59 +1074,45 @@ ImageNode *CreateImageFromXImages(XImage *image, XImage *shape)
 
 ImageNode *CreateImage(unsigned width, unsigned height, char bitmap)
 {
-   unsigned image_size;
-   if(bitmap) {
-      image_size = (width * height + 7) / 8;
-   } else {
-      image_size = 4 * width * height;
-   }
    ImageNode *image = Allocate(sizeof(ImageNode));
-   image->data = Allocate(image_size);
+   size_t image_size;
    image->next = NULL;
    image->bitmap = bitmap;
    image->width = width;
    image->height = height;
+   image_size = GetImageDataSize(image);
+   image->data = Allocate(image_size);
+   RecordImageStats((long)image_size);
 #ifdef USE_XRENDER
    image->render = haveRender;
+#endif
+#ifdef USE_ICON_CACHE
+   image->mapSize = 0;
 #endif
    return image;
 }
 
+/** Get the size of the data of an image in bytes. */
+size_t GetImageDataSize(const ImageNode *image)
+{
+   const size_t pixels = (size_t)image->width * image->height;
+   return image->bitmap ? (pixels + 7) / 8 : 4 * pixels;
+}
+
 /** Destroy an image node. */
 void DestroyImage(ImageNode *image) {
    while(image) {
       ImageNode *next = image->next;
+#ifdef USE_ICON_CACHE
+      if(image->mapSize) {
+         ReleaseCachedImage(image);
+      }
+#endif
       if(image->data) {
+         RecordImageStats(-(long)GetImageDataSize(image));
          Release(image->data);
       }
       Release(image);
       image = next;
    }
 }
-
-/** Callback to allocate a color for libxpm. */
-#ifdef USE_XPM
-int AllocateColor(Display *d, Colormap cmap, char *name,
-                  XColor *c, void *closure)
-{
-   if(name) {
-      if(!JXParseColor(d, cmap, name, c)) {
-         return -1;
-      }
-   }
-
-   GetColor(c);
-   return 1;
-}
-#endif /* USE_XPM */
-
-/** Callback to free colors allocated by libxpm.
- * We don't need to do anything here since color.c takes care of this.
- */
-#ifdef USE_XPM
-int FreeColors(Display *d, Colormap cmap, Pixel *pixels, int n,
-               void *closure)
-{
-   return 1;
-}
-#endif /* USE_XPM */
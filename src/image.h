@@ -21,6 +21,9 @@ typedef struct ImageNode {
 #ifdef USE_XRENDER
    char render;                  /**< 1 to use render, 0 otherwise. */
 #endif
+#ifdef USE_ICON_CACHE
+   size_t mapSize;               /**< Size of the cache mapping (0 if none). */
+#endif
 
 } ImageNode;
 
@@ -34,6 +37,14 @@ typedef struct ImageNode {
 ImageNode *LoadImage(const char *fileName, int rwidth, int rheight,
                      char preserveAspect);
 
+/** Load the size of an image from a file.
+ * For formats that can be decoded at any size, only the header is read
+ * and the data of the image is NULL. Other formats are fully decoded.
+ * @param fileName The file containing the image.
+ * @return A new image node (NULL if the image could not be loaded).
+ */
+ImageNode *LoadImageHeader(const char *fileName);
+
 /** Load an image from a Drawable.
  * @param pmap The drawable.
  * @param mask The mask (may be None).
@@ -59,6 +59,12 @@
 #  ifdef HAVE_SYS_SELECT_H
 #     include <sys/select.h>
 #  endif
+#  ifdef HAVE_SYS_EPOLL_H
+#     include <sys/epoll.h>
+#  endif
+#  ifdef HAVE_SYS_TIMERFD_H
+#     include <sys/timerfd.h>
+#  endif
 
 #  include <X11/Xlib.h>
 #  ifdef HAVE_X11_XUTIL_H
@@ -84,6 +90,16 @@
 #     include <X11/extensions/shape.h>
 #  endif
 
+#  ifdef USE_SHM
+#     include <sys/ipc.h>
+#     include <sys/shm.h>
+#     include <X11/extensions/XShm.h>
+#  endif
+
+#  ifdef USE_XSYNC
+#     include <X11/extensions/sync.h>
+#  endif
+
 #  ifdef USE_XMU
 #     include <X11/Xmu/Xmu.h>
 #  endif
@@ -91,6 +107,16 @@
 #  ifdef USE_XINERAMA
 #     include <X11/extensions/Xinerama.h>
 #  endif
+#  ifdef USE_XRANDR
+#     include <X11/extensions/Xrandr.h>
+#  endif
+#  ifdef USE_XCOMPOSITE
+#     include <X11/extensions/Xcomposite.h>
+#     include <X11/extensions/Xdamage.h>
+#  endif
+#  ifdef USE_XCB
+#     include <X11/Xlib-xcb.h>
+#  endif
 #  ifdef USE_XFT
 #     ifdef HAVE_FT2BUILD_H
 #        include <ft2build.h>
@@ -145,6 +171,7 @@
 #endif
 
 #include "debug.h"
+#include "prefetch.h"
 #include "jxlib.h"
 
 #endif /* JWM_H */
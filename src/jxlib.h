@@ -12,6 +12,7 @@
 
 #ifdef UNIT_TEST
 
+#  define JFUNC0(name) Mock_##name()
 #  define JFUNC1(name, a) Mock_##name(a)
 #  define JFUNC2(name, a, b) Mock_##name(a, b)
 #  define JFUNC3(name, a, b, c) Mock_##name(a, b, c)
@@ -34,27 +35,35 @@
 
 #else
 
-#  define JFUNC1(name, a) (SetCheckpoint(), name(a))
-#  define JFUNC2(name, a, b) (SetCheckpoint(), name(a, b))
-#  define JFUNC3(name, a, b, c) (SetCheckpoint(), name(a, b, c))
-#  define JFUNC4(name, a, b, c, d) (SetCheckpoint(), name(a, b, c, d))
-#  define JFUNC5(name, a, b, c, d, e) (SetCheckpoint(), name(a, b, c, d, e))
+   /* Hook run before every X call. */
+#  ifdef PROFILE_X
+#     define JPROBE(name) (ProfileXCall(#name), SetCheckpoint())
+#  else
+#     define JPROBE(name) SetCheckpoint()
+#  endif
+
+#  define JFUNC0(name) (JPROBE(name), name())
+#  define JFUNC1(name, a) (JPROBE(name), name(a))
+#  define JFUNC2(name, a, b) (JPROBE(name), name(a, b))
+#  define JFUNC3(name, a, b, c) (JPROBE(name), name(a, b, c))
+#  define JFUNC4(name, a, b, c, d) (JPROBE(name), name(a, b, c, d))
+#  define JFUNC5(name, a, b, c, d, e) (JPROBE(name), name(a, b, c, d, e))
 #  define JFUNC6(name, a, b, c, d, e, f) \
-   (SetCheckpoint(), name(a, b, c, d, e, f))
+   (JPROBE(name), name(a, b, c, d, e, f))
 #  define JFUNC7(name, a, b, c, d, e, f, g) \
-   (SetCheckpoint(), name(a, b, c, d, e, f, g))
+   (JPROBE(name), name(a, b, c, d, e, f, g))
 #  define JFUNC8(name, a, b, c, d, e, f, g, h) \
-   (SetCheckpoint(), name(a, b, c, d, e, f, g, h))
+   (JPROBE(name), name(a, b, c, d, e, f, g, h))
 #  define JFUNC9(name, a, b, c, d, e, f, g, h, i) \
-   (SetCheckpoint(), name(a, b, c, d, e, f, g, h, i))
+   (JPROBE(name), name(a, b, c, d, e, f, g, h, i))
 #  define JFUNC10(name, a, b, c, d, e, f, g, h, i, j) \
-   (SetCheckpoint(), name(a, b, c, d, e, f, g, h, i, j))
+   (JPROBE(name), name(a, b, c, d, e, f, g, h, i, j))
 #  define JFUNC11(name, a, b, c, d, e, f, g, h, i, j, k) \
-   (SetCheckpoint(), name(a, b, c, d, e, f, g, h, i, j, k))
+   (JPROBE(name), name(a, b, c, d, e, f, g, h, i, j, k))
 #  define JFUNC12(name, a, b, c, d, e, f, g, h, i, j, k, l) \
-   (SetCheckpoint(), name(a, b, c, d, e, f, g, h, i, j, k, l))
+   (JPROBE(name), name(a, b, c, d, e, f, g, h, i, j, k, l))
 #  define JFUNC13(name, a, b, c, d, e, f, g, h, i, j, k, l, m) \
-   (SetCheckpoint(), name(a, b, c, d, e, f, g, h, i, j, k, l, m))
+   (JPROBE(name), name(a, b, c, d, e, f, g, h, i, j, k, l, m))
 
 #endif
 
@@ -62,6 +71,9 @@
 
 #define JXAllocColor( a, b, c ) JFUNC3(XAllocColor, a, b, c)
 
+#define JXAllocColorCells( a, b, c, d, e, f, g ) \
+   JFUNC7(XAllocColorCells, a, b, c, d, e, f, g)
+
 #define JXGetRGBColormaps( a, b, c, d, e ) \
    JFUNC5(XGetRGBColormaps, a, b, c, d, e)
 
@@ -71,10 +83,17 @@
 
 #define JXAllowEvents( a, b, c ) JFUNC3(XAllowEvents, a, b, c)
 
-#define JXChangeProperty( a, b, c, d, e, f, g, h ) \
-   JFUNC8(XChangeProperty, a, b, c, d, e, f, g, h)
-
-#define JXDeleteProperty( a, b, c ) JFUNC3(XDeleteProperty, a, b, c)
+#if defined(USE_XCB) && !defined(UNIT_TEST)
+#  define JXChangeProperty( a, b, c, d, e, f, g, h ) \
+      (ForgetPrefetchedProperty(b, c), \
+       JFUNC8(XChangeProperty, a, b, c, d, e, f, g, h))
+#  define JXDeleteProperty( a, b, c ) \
+      (ForgetPrefetchedProperty(b, c), JFUNC3(XDeleteProperty, a, b, c))
+#else
+#  define JXChangeProperty( a, b, c, d, e, f, g, h ) \
+      JFUNC8(XChangeProperty, a, b, c, d, e, f, g, h)
+#  define JXDeleteProperty( a, b, c ) JFUNC3(XDeleteProperty, a, b, c)
+#endif
 
 #define JXChangeWindowAttributes( a, b, c, d ) \
    JFUNC4(XChangeWindowAttributes, a, b, c, d)
@@ -84,6 +103,8 @@
 #define JXCheckTypedWindowEvent( a, b, c, d ) \
    JFUNC4(XCheckTypedWindowEvent, a, b, c, d)
 
+#define JXChangeGC( a, b, c, d ) JFUNC4(XChangeGC, a, b, c, d)
+
 #define JXClearWindow( a, b ) JFUNC2(XClearWindow, a, b)
 
 #define JXClearArea( a, b, c, d, e, f, g ) \
@@ -190,8 +211,14 @@
 
 #define JXGetWindowAttributes( a, b, c ) JFUNC3(XGetWindowAttributes, a, b, c)
 
-#define JXGetWindowProperty( a, b, c, d, e, f, g, h, i, j, k, l ) \
-   JFUNC12(XGetWindowProperty, a, b, c, d, e, f, g, h, i, j, k, l)
+#if defined(USE_XCB) && !defined(UNIT_TEST)
+#  define JXGetWindowProperty( a, b, c, d, e, f, g, h, i, j, k, l ) \
+      (SetCheckpoint(), \
+       GetPrefetchedProperty(a, b, c, d, e, f, g, h, i, j, k, l))
+#else
+#  define JXGetWindowProperty( a, b, c, d, e, f, g, h, i, j, k, l ) \
+      JFUNC12(XGetWindowProperty, a, b, c, d, e, f, g, h, i, j, k, l)
+#endif
 
 #define JXGetWMColormapWindows( a, b, c, d ) \
    JFUNC4(XGetWMColormapWindows, a, b, c, d)
@@ -200,6 +227,8 @@
 
 #define JXSetIconSizes( a, b, c, d ) JFUNC4(XSetIconSizes, a, b, c, d)
 
+#define JXStoreColors( a, b, c, d ) JFUNC4(XStoreColors, a, b, c, d)
+
 #define JXSetWindowBorder( a, b, c ) JFUNC3(XSetWindowBorder, a, b, c)
 
 #define JXGetWMHints( a, b ) JFUNC2(XGetWMHints, a, b)
@@ -209,6 +238,9 @@
 
 #define JXKeycodeToKeysym( a, b, c ) JFUNC3(XKeycodeToKeysym, a, b, c)
 
+#define JXLookupString( a, b, c, d, e ) \
+   JFUNC5(XLookupString, a, b, c, d, e)
+
 #define JXGrabKey( a, b, c, d, e, f, g ) \
    JFUNC7(XGrabKey, a, b, c, d, e, f, g)
 
@@ -226,6 +258,8 @@
 
 #define JXInternAtom( a, b, c ) JFUNC3(XInternAtom, a, b, c)
 
+#define JXInternAtoms( a, b, c, d, e ) JFUNC5(XInternAtoms, a, b, c, d, e)
+
 #define JXKeysymToKeycode( a, b ) JFUNC2(XKeysymToKeycode, a, b)
 
 #define JXKillClient( a, b ) JFUNC2(XKillClient, a, b)
@@ -247,12 +281,18 @@
 
 #define JXCheckMaskEvent( a, b, c ) JFUNC3(XCheckMaskEvent, a, b, c)
 
+#define JXCheckIfEvent( a, b, c, d ) JFUNC4(XCheckIfEvent, a, b, c, d)
+
 #define JXOpenDisplay( a ) JFUNC1(XOpenDisplay, a)
 
+#define JXInitThreads() JFUNC0(XInitThreads)
+
 #define JXParseColor( a, b, c, d ) JFUNC4(XParseColor, a, b, c, d)
 
 #define JXPending( a ) JFUNC1(XPending, a)
 
+#define JXQLength( a ) JFUNC1(XQLength, a)
+
 #define JXPutBackEvent( a, b ) JFUNC2(XPutBackEvent, a, b)
 
 #define JXGetImage( a, b, c, d, e, f, g, h ) \
@@ -277,6 +317,8 @@
 
 #define JXRaiseWindow( a, b ) JFUNC2(XRaiseWindow, a, b)
 
+#define JXRefreshKeyboardMapping( a ) JFUNC1(XRefreshKeyboardMapping, a)
+
 #define JXSelectInput( a, b, c ) JFUNC3(XSelectInput, a, b, c)
 
 #define JXSendEvent( a, b, c, d, e ) JFUNC5(XSendEvent, a, b, c, d, e)
@@ -292,6 +334,8 @@
 
 #define JXSetErrorHandler( a ) JFUNC1(XSetErrorHandler, a)
 
+#define JXSetFillStyle( a, b, c ) JFUNC3(XSetFillStyle, a, b, c)
+
 #define JXSetFont( a, b, c ) JFUNC3(XSetFont, a, b, c)
 
 #define JXSetForeground( a, b, c ) JFUNC3(XSetForeground, a, b, c)
@@ -300,6 +344,10 @@
 
 #define JXSetInputFocus( a, b, c, d ) JFUNC4(XSetInputFocus, a, b, c, d)
 
+#define JXSetTile( a, b, c ) JFUNC3(XSetTile, a, b, c)
+
+#define JXSetTSOrigin( a, b, c, d ) JFUNC4(XSetTSOrigin, a, b, c, d)
+
 #define JXSetWindowBackground( a, b, c ) JFUNC3(XSetWindowBackground, a, b, c)
 
 #define JXSetWindowBorderWidth( a, b, c ) \
@@ -319,6 +367,19 @@
 #define JXShapeQueryExtension( a, b, c ) \
    JFUNC3(XShapeQueryExtension, a, b, c)
 
+#define JXSyncQueryExtension( a, b, c ) \
+   JFUNC3(XSyncQueryExtension, a, b, c)
+
+#define JXSyncInitialize( a, b, c ) JFUNC3(XSyncInitialize, a, b, c)
+
+#define JXSyncQueryCounter( a, b, c ) JFUNC3(XSyncQueryCounter, a, b, c)
+
+#define JXSyncCreateAlarm( a, b, c ) JFUNC3(XSyncCreateAlarm, a, b, c)
+
+#define JXSyncChangeAlarm( a, b, c, d ) JFUNC4(XSyncChangeAlarm, a, b, c, d)
+
+#define JXSyncDestroyAlarm( a, b ) JFUNC2(XSyncDestroyAlarm, a, b)
+
 #define JXQueryExtension( a, b, c, d, e ) \
    JFUNC5(XQueryExtension, a, b, c, d, e)
 
@@ -330,12 +391,70 @@
 
 #define JXShapeSelectInput( a, b, c ) JFUNC3(XShapeSelectInput, a, b, c)
 
+#define JXCompositeQueryExtension( a, b, c ) \
+   JFUNC3(XCompositeQueryExtension, a, b, c)
+
+#define JXCompositeRedirectSubwindows( a, b, c ) \
+   JFUNC3(XCompositeRedirectSubwindows, a, b, c)
+
+#define JXCompositeUnredirectSubwindows( a, b, c ) \
+   JFUNC3(XCompositeUnredirectSubwindows, a, b, c)
+
+#define JXCompositeNameWindowPixmap( a, b ) \
+   JFUNC2(XCompositeNameWindowPixmap, a, b)
+
+#define JXDamageQueryExtension( a, b, c ) \
+   JFUNC3(XDamageQueryExtension, a, b, c)
+
+#define JXDamageCreate( a, b, c ) JFUNC3(XDamageCreate, a, b, c)
+
+#define JXDamageDestroy( a, b ) JFUNC2(XDamageDestroy, a, b)
+
+#define JXDamageSubtract( a, b, c, d ) JFUNC4(XDamageSubtract, a, b, c, d)
+
+#define JXRRQueryExtension( a, b, c ) JFUNC3(XRRQueryExtension, a, b, c)
+
+#define JXRRQueryVersion( a, b, c ) JFUNC3(XRRQueryVersion, a, b, c)
+
+#define JXRRSelectInput( a, b, c ) JFUNC3(XRRSelectInput, a, b, c)
+
+#define JXRRUpdateConfiguration( a ) JFUNC1(XRRUpdateConfiguration, a)
+
+#define JXRRGetScreenResourcesCurrent( a, b ) \
+   JFUNC2(XRRGetScreenResourcesCurrent, a, b)
+
+#define JXRRFreeScreenResources( a ) JFUNC1(XRRFreeScreenResources, a)
+
+#define JXRRGetCrtcInfo( a, b, c ) JFUNC3(XRRGetCrtcInfo, a, b, c)
+
+#define JXRRFreeCrtcInfo( a ) JFUNC1(XRRFreeCrtcInfo, a)
+
+#define JXRRGetOutputPrimary( a, b ) JFUNC2(XRRGetOutputPrimary, a, b)
+
+#define JXRRGetOutputInfo( a, b, c ) JFUNC3(XRRGetOutputInfo, a, b, c)
+
+#define JXRRFreeOutputInfo( a ) JFUNC1(XRRFreeOutputInfo, a)
+
+#define JXShmAttach( a, b ) JFUNC2(XShmAttach, a, b)
+
+#define JXShmCreateImage( a, b, c, d, e, f, g, h ) \
+   JFUNC8(XShmCreateImage, a, b, c, d, e, f, g, h)
+
+#define JXShmDetach( a, b ) JFUNC2(XShmDetach, a, b)
+
+#define JXShmPutImage( a, b, c, d, e, f, g, h, i, j, k ) \
+   JFUNC11(XShmPutImage, a, b, c, d, e, f, g, h, i, j, k)
+
+#define JXShmQueryExtension( a ) JFUNC1(XShmQueryExtension, a)
+
 #define JXStoreName( a, b, c ) JFUNC3(XStoreName, a, b, c)
 
 #define JXStringToKeysym( a ) JFUNC1(XStringToKeysym, a)
 
 #define JXSync( a, b ) JFUNC2(XSync, a, b)
 
+#define JXNoOp( a ) JFUNC1(XNoOp, a)
+
 #define JXTextWidth( a, b, c ) JFUNC3(XTextWidth, a, b, c)
 
 #define JXUngrabButton( a, b, c, d ) JFUNC4(XUngrabButton, a, b, c, d)
@@ -358,6 +477,22 @@
 
 #define JXSetRegion( a, b, c ) JFUNC3(XSetRegion, a, b, c)
 
+#define JXCreateRegion() JFUNC0(XCreateRegion)
+
+#define JXDestroyRegion( a ) JFUNC1(XDestroyRegion, a)
+
+#define JXUnionRectWithRegion( a, b, c ) \
+   JFUNC3(XUnionRectWithRegion, a, b, c)
+
+#define JXIntersectRegion( a, b, c ) JFUNC3(XIntersectRegion, a, b, c)
+
+#define JXClipBox( a, b ) JFUNC2(XClipBox, a, b)
+
+#define JXRectInRegion( a, b, c, d, e ) \
+   JFUNC5(XRectInRegion, a, b, c, d, e)
+
+#define JXGetGCValues( a, b, c, d ) JFUNC4(XGetGCValues, a, b, c, d)
+
 #define JXGetGeometry( a, b, c, d, e, f, g, h, i ) \
    JFUNC9(XGetGeometry, a, b, c, d, e, f, g, h, i)
 
@@ -396,6 +531,9 @@
 #define JXRenderQueryExtension( a, b, c ) \
    JFUNC3(XRenderQueryExtension, a, b, c)
 
+#define JXRenderQueryVersion( a, b, c ) \
+   JFUNC3(XRenderQueryVersion, a, b, c)
+
 #define JXRenderFindVisualFormat( a, b ) \
    JFUNC2(XRenderFindVisualFormat, a, b)
 
@@ -410,7 +548,13 @@
 
 #define JXRenderFreePicture( a, b ) JFUNC2(XRenderFreePicture, a, b)
 
+#define JXRenderCreateLinearGradient( a, b, c, d, e ) \
+   JFUNC5(XRenderCreateLinearGradient, a, b, c, d, e)
+
 #define JXRenderComposite( a, b, c, d, e, f, g, h, i, j, k, l, m ) \
    JFUNC13(XRenderComposite, a, b, c, d, e, f, g, h, i, j, k, l, m)
 
+#define JXRenderFillRectangle( a, b, c, d, e, f, g, h ) \
+   JFUNC8(XRenderFillRectangle, a, b, c, d, e, f, g, h)
+
 #endif /* JXLIB_H */
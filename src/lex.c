@@ -12,8 +12,42 @@
 #include "error.h"
 #include "misc.h"
 
-/** Amount to increase allocations by when reading text. */
-static const int BLOCK_SIZE = 16;
+/** Minimum size of a block used to allocate tokens. */
+#define TOKEN_BLOCK_SIZE   16384
+
+/** Alignment of token allocations. */
+#define TOKEN_ALIGNMENT    sizeof(void*)
+
+/** Block of memory used to allocate a token tree.
+ * Everything allocated while tokenizing a buffer comes from a list of
+ * these blocks so that the tree can be released all at once.
+ */
+typedef struct TokenBlock {
+   struct TokenBlock *next;   /**< The previous block. */
+   size_t used;               /**< Bytes allocated from this block. */
+   size_t size;               /**< Bytes available in this block. */
+} TokenBlock;
+
+/** Buffer used to serialize tokens. */
+typedef struct TokenWriter {
+   char *data;
+   size_t length;
+   size_t capacity;
+} TokenWriter;
+
+/** State used to deserialize tokens. */
+typedef struct TokenReader {
+   char *data;
+   size_t offset;
+   size_t size;
+   const char *fileName;
+} TokenReader;
+
+/** The top-level token along with the memory for the tree. */
+typedef struct TokenTree {
+   TokenNode node;            /**< The top-level token (must be first). */
+   TokenBlock *blocks;        /**< Blocks allocated for the tree. */
+} TokenTree;
 
 /** Mapping between token names and tokens.
  * These must be sorted.
@@ -40,17 +74,23 @@ static const StringMappingType TOKEN_MAP[] = {
    { "DoubleClickSpeed",   TOK_DOUBLECLICKSPEED },
    { "Dynamic",            TOK_DYNAMIC          },
    { "Exit",               TOK_EXIT             },
+   { "FocusDelay",         TOK_FOCUSDELAY       },
    { "FocusModel",         TOK_FOCUSMODEL       },
    { "Font",               TOK_FONT             },
    { "Foreground",         TOK_FOREGROUND       },
    { "Group",              TOK_GROUP            },
    { "Height",             TOK_HEIGHT           },
+   { "IconFilter",         TOK_ICONFILTER       },
+   { "IconMemory",         TOK_ICONMEMORY       },
    { "IconPath",           TOK_ICONPATH         },
+   { "IconTheme",          TOK_ICONTHEME        },
    { "Include",            TOK_INCLUDE          },
+   { "InputPriority",      TOK_INPUTPRIORITY    },
    { "JWM",                TOK_JWM              },
    { "Key",                TOK_KEY              },
    { "Kill",               TOK_KILL             },
    { "Layer",              TOK_LAYER            },
+   { "LowMemory",          TOK_LOWMEMORY        },
    { "Machine",            TOK_MACHINE          },
    { "Maximize",           TOK_MAXIMIZE         },
    { "Menu",               TOK_MENU             },
@@ -79,7 +119,9 @@ static const StringMappingType TOKEN_MAP[] = {
    { "ShutdownCommand",    TOK_SHUTDOWNCOMMAND  },
    { "SnapMode",           TOK_SNAPMODE         },
    { "Spacer",             TOK_SPACER           },
+   { "StallTimeout",       TOK_STALLTIMEOUT     },
    { "StartupCommand",     TOK_STARTUPCOMMAND   },
+   { "StartupMode",        TOK_STARTUPMODE      },
    { "Stick",              TOK_STICK            },
    { "Swallow",            TOK_SWALLOW          },
    { "TaskList",           TOK_TASKLIST         },
@@ -90,6 +132,7 @@ static const StringMappingType TOKEN_MAP[] = {
    { "TrayButton",         TOK_TRAYBUTTON       },
    { "TrayButtonStyle",    TOK_TRAYBUTTONSTYLE  },
    { "TrayStyle",          TOK_TRAYSTYLE        },
+   { "TrayText",           TOK_TRAYTEXT         },
    { "Type",               TOK_TYPE             },
    { "Width",              TOK_WIDTH            },
    { "WindowStyle",        TOK_WINDOWSTYLE      }
@@ -97,19 +140,31 @@ static const StringMappingType TOKEN_MAP[] = {
 static const unsigned int TOKEN_MAP_COUNT = ARRAY_LENGTH(TOKEN_MAP);
 
 static TokenNode *head;
+static TokenBlock *blocks;
+static TokenNode *appendNode;
+static size_t appendSize;
 
 static TokenNode *CreateNode(TokenNode *current,
                              const char *file,
                              unsigned int line);
 static AttributeNode *CreateAttribute(TokenNode *np); 
-
-static char IsElementEnd(char ch);
-static char IsValueEnd(char ch);
-static char IsAttributeEnd(char ch);
+static void *AllocateToken(size_t size);
+static void ReleaseBlocks(TokenBlock *bp);
+static void AppendValue(TokenNode *np, const char *value, unsigned len);
+static void WriteToken(TokenWriter *wp, const TokenNode *np);
+static void WriteWord(TokenWriter *wp, unsigned int value);
+static void WriteString(TokenWriter *wp, const char *str);
+static char ReadToken(TokenReader *rp, TokenNode *np);
+static char ReadWord(TokenReader *rp, unsigned int *value);
+static char ReadString(TokenReader *rp, char **str);
+
+static unsigned int CountLines(const char *str, size_t len);
+static size_t SkipPast(const char *str, const char *end,
+                       unsigned int *lineNumber);
 static char *ReadElementName(const char *line);
 static char *ReadValue(const char *line,
                        const char *file,
-                       char (*IsEnd)(char),
+                       const char *ends,
                        unsigned int *offset,
                        unsigned int *lineNumber);
 static char *ReadElementValue(const char *line,
@@ -122,7 +177,7 @@ static char *ReadAttributeValue(const char *line,
                                 unsigned int *lineNumber);
 static int ParseEntity(const char *entity, char *ch,
                        const char *file, unsigned int line);
-static TokenType LookupType(const char *name, TokenNode *np);
+static TokenType LookupType(char *name, TokenNode *np);
 
 /** Tokenize data. */
 TokenNode *Tokenize(const char *line, const char *fileName)
@@ -135,6 +190,8 @@ TokenNode *Tokenize(const char *line, const char *fileName)
    char inElement;
 
    head = NULL;
+   blocks = NULL;
+   appendNode = NULL;
    current = NULL;
    inElement = 0;
    lineNumber = 1;
@@ -146,17 +203,8 @@ TokenNode *Tokenize(const char *line, const char *fileName)
    }
 
    /* Skip any XML stuff. */
-   if(!strncmp(line + x, "<?", 2)) {
-      while(line[x]) {
-         if(line[x] == '\n') {
-            lineNumber += 1;
-         }
-         if(!strncmp(line + x, "?>", 2)) {
-            x += 2;
-            break;
-         }
-         x += 1;
-      }
+   if(line[x] == '<' && line[x + 1] == '?') {
+      x += SkipPast(line + x, "?>", &lineNumber);
    }
 
    /* Process the XML data. */
@@ -173,16 +221,9 @@ TokenNode *Tokenize(const char *line, const char *fileName)
 
          /* Skip comments */
          found = 0;
-         if(!strncmp(line + x, "<!--", 4)) {
-            while(line[x]) {
-               lineNumber += line[x] == '\n';
-               if(!strncmp(line + x, "-->", 3)) {
-                  x += 3;
-                  found = 1;
-                  break;
-               }
-               x += 1;
-            }
+         if(line[x] == '<' && !strncmp(line + x, "<!--", 4)) {
+            x += SkipPast(line + x, "-->", &lineNumber);
+            found = 1;
          }
 
       } while(found);
@@ -218,7 +259,6 @@ TokenNode *Tokenize(const char *line, const char *fileName)
             }
             if(temp) {
                x += strlen(temp);
-               Release(temp);
             }
 
          } else if(current && !strncmp(line + x, "![CDATA[", 8)) {
@@ -228,27 +268,10 @@ TokenNode *Tokenize(const char *line, const char *fileName)
             /* CDATA */
             x += 8;
             start = x;
-            while(line[x]) {
-               lineNumber += line[x] == '\n';
-               if(!strncmp(line + x, "]]>", 3)) {
-                  x += 3;
-                  break;
-               }
-               x += 1;
-            }
+            x += SkipPast(line + x, "]]>", &lineNumber);
             stop = x - 3;
             if(JLIKELY(stop > start)) {
-               const unsigned new_len = stop - start;
-               unsigned value_len = 0;
-               if(current->value) {
-                  value_len = strlen(current->value);
-                  current->value = Reallocate(current->value,
-                                              value_len + new_len + 1);
-               } else {
-                  current->value = Allocate(new_len + 1);
-               }
-               memcpy(&current->value[value_len], &line[start], new_len);
-               current->value[value_len + new_len] = 0;
+               AppendValue(current, &line[start], stop - start);
             }
 
          } else {
@@ -259,7 +282,6 @@ TokenNode *Tokenize(const char *line, const char *fileName)
             if(JLIKELY(temp)) {
                x += strlen(temp);
                LookupType(temp, current);
-               Release(temp);
             } else {
                Warning(_("%s[%u]: invalid open tag"), fileName, lineNumber);
             }
@@ -324,12 +346,9 @@ ReadDefault:
             if(temp) {
                if(current) {
                   if(current->value) {
-                     const unsigned value_len = strlen(current->value);
-                     const unsigned temp_len = strlen(temp);
-                     current->value = Reallocate(current->value,
-                                                 value_len + temp_len + 1);
-                     memcpy(&current->value[value_len], temp, temp_len + 1);
-                     Release(temp);
+                     if(temp[0]) {
+                        AppendValue(current, temp, strlen(temp));
+                     }
                   } else {
                      current->value = temp;
                   }
@@ -338,7 +357,6 @@ ReadDefault:
                      Warning(_("%s[%u]: unexpected text: \"%s\""),
                              fileName, lineNumber, temp);
                   }
-                  Release(temp);
                }
             }
          }
@@ -346,9 +364,65 @@ ReadDefault:
       }
    }
 
+   if(head) {
+      ((TokenTree*)head)->blocks = blocks;
+   } else {
+      ReleaseBlocks(blocks);
+   }
+   blocks = NULL;
    return head;
 }
 
+/** Allocate memory for the token tree being built. */
+void *AllocateToken(size_t size)
+{
+   void *result;
+   size = (size + TOKEN_ALIGNMENT - 1) & ~(TOKEN_ALIGNMENT - 1);
+   if(!blocks || blocks->used + size > blocks->size) {
+      const size_t blockSize = Max(size, TOKEN_BLOCK_SIZE);
+      TokenBlock *bp = Allocate(sizeof(TokenBlock) + blockSize);
+      bp->next = blocks;
+      bp->used = 0;
+      bp->size = blockSize;
+      blocks = bp;
+   }
+   result = (char*)(blocks + 1) + blocks->used;
+   blocks->used += size;
+   return result;
+}
+
+/** Release the blocks of a token tree. */
+void ReleaseBlocks(TokenBlock *bp)
+{
+   while(bp) {
+      TokenBlock *next = bp->next;
+      Release(bp);
+      bp = next;
+   }
+}
+
+/** Append text to the body of a tag. */
+void AppendValue(TokenNode *np, const char *value, unsigned len)
+{
+   const size_t valueLen = np->value ? strlen(np->value) : 0;
+   const size_t required = valueLen + len + 1;
+
+   /* Values that are appended to get room to grow so that repeated
+    * appends to the same tag do not copy the value each time. */
+   if(np != appendNode || required > appendSize) {
+      char *buffer;
+      appendNode = np;
+      appendSize = required * 2;
+      buffer = AllocateToken(appendSize);
+      if(valueLen) {
+         memcpy(buffer, np->value, valueLen);
+      }
+      np->value = buffer;
+   }
+   memcpy(&np->value[valueLen], value, len);
+   np->value[valueLen + len] = 0;
+}
+
 /** Parse an entity reference.
  * The entity value is returned in ch and the length of the entity
  * is returned as the value of the function.
@@ -402,48 +476,41 @@ int ParseEntity(const char *entity, char *ch, const char *file,
    }
 }
 
-/** Determine if ch is the end of a tag/attribute name. */
-char IsElementEnd(char ch)
+/** Count the line breaks in a string. */
+unsigned int CountLines(const char *str, size_t len)
 {
-   switch(ch) {
-   case ' ':
-   case '\t':
-   case '\n':
-   case '\r':
-   case '\"':
-   case '>':
-   case '<':
-   case '/':
-   case '=':
-   case 0:
-      return 1;
-   default:
-      return 0;
+   const char *const stop = str + len;
+   unsigned int count = 0;
+   for(;;) {
+      str = memchr(str, '\n', stop - str);
+      if(!str) {
+         return count;
+      }
+      count += 1;
+      str += 1;
    }
 }
 
-/** Determine if ch is the end of an attribute value. */
-char IsAttributeEnd(char ch)
+/** Get the length of a string up to and including a terminator.
+ * Line breaks that are skipped are counted. Without the terminator,
+ * this returns the length of the whole string.
+ * @param str The string to skip.
+ * @param end The terminator.
+ * @param lineNumber The line number to update.
+ * @return The number of characters to skip.
+ */
+size_t SkipPast(const char *str, const char *end, unsigned int *lineNumber)
 {
-   switch(ch) {
-   case 0:
-   case '\"':
-      return 1;
-   default:
-      return 0;
-   }
-}
+   const char *found = strstr(str, end);
+   size_t len;
 
-/** Determine if ch is the end of tag data. */
-char IsValueEnd(char ch)
-{
-   switch(ch) {
-   case 0:
-   case '<':
-      return 1;
-   default:
-      return 0;
+   if(found) {
+      len = (found - str) + strlen(end);
+   } else {
+      len = strlen(str);
    }
+   *lineNumber += CountLines(str, len);
+   return len;
 }
 
 /** Get the name of the next element. */
@@ -454,10 +521,10 @@ char *ReadElementName(const char *line)
    unsigned int len;
 
    /* Get the length of the element. */
-   for(len = 0; !IsElementEnd(line[len]); len++);
+   len = strcspn(line, " \t\n\r\"></=");
 
    /* Allocate space for the element. */
-   buffer = Allocate(len + 1);
+   buffer = AllocateToken(len + 1);
    memcpy(buffer, line, len);
    buffer[len] = 0;
 
@@ -465,44 +532,55 @@ char *ReadElementName(const char *line)
 
 }
 
-/** Read the value of an element or attribute. */
+/** Read the value of an element or attribute.
+ * Text is copied a run at a time between entity references.
+ * @param ends The characters that end the value.
+ */
 char *ReadValue(const char *line,
                 const char *file,
-                char (*IsEnd)(char),
+                const char *ends,
                 unsigned int *offset,
                 unsigned int *lineNumber)
 {
    char *buffer;
-   char ch;
+   const char *amp;
    unsigned int len, max;
    unsigned int x;
 
+   /* The decoded value is never longer than the input. */
+   max = strcspn(line, ends);
+   buffer = AllocateToken(max + 1);
+
    len = 0;
-   max = BLOCK_SIZE;
-   buffer = Allocate(max + 1);
-
-   for(x = 0; !(IsEnd)(line[x]); x++) {
-      if(line[x] == '&') {
-         x += ParseEntity(line + x, &ch, file, *lineNumber) - 1;
-         if(ch) {
-            buffer[len] = ch;
-         } else {
-            buffer[len] = line[x];
-         }
-      } else {
-         if(line[x] == '\n') {
-            *lineNumber += 1;
-         }
-         buffer[len] = line[x];
+   x = 0;
+   while(x < max) {
+      char ch;
+
+      /* Copy up to the next entity. */
+      amp = memchr(line + x, '&', max - x);
+      if(!amp) {
+         const unsigned int run = max - x;
+         memcpy(&buffer[len], line + x, run);
+         *lineNumber += CountLines(line + x, run);
+         len += run;
+         x = max;
+         break;
       }
-      len += 1;
-      if(len >= max) {
-         max += BLOCK_SIZE;
-         buffer = Reallocate(buffer, max + 1);
-         if(JUNLIKELY(buffer == NULL)) {
-            FatalError(_("out of memory"));
-         }
+      if(amp > line + x) {
+         const unsigned int run = amp - (line + x);
+         memcpy(&buffer[len], line + x, run);
+         *lineNumber += CountLines(line + x, run);
+         len += run;
+         x += run;
       }
+
+      /* Decode the entity. */
+      x += ParseEntity(line + x, &ch, file, *lineNumber);
+      if(JUNLIKELY(x > max)) {
+         x = max;
+      }
+      buffer[len] = ch ? ch : line[x - 1];
+      len += 1;
    }
    buffer[len] = 0;
    Trim(buffer);
@@ -517,7 +595,7 @@ char *ReadElementValue(const char *line,
                        unsigned int *offset,
                        unsigned int *lineNumber)
 {
-   return ReadValue(line, file, IsValueEnd, offset, lineNumber);
+   return ReadValue(line, file, "<", offset, lineNumber);
 }
 
 /** Get the value of the current attribute. */
@@ -526,11 +604,11 @@ char *ReadAttributeValue(const char *line,
                          unsigned int *offset,
                          unsigned int *lineNumber)
 {
-   return ReadValue(line, file, IsAttributeEnd, offset, lineNumber);
+   return ReadValue(line, file, "\"", offset, lineNumber);
 }
 
 /** Get the token for a tag name. */
-TokenType LookupType(const char *name, TokenNode *np)
+TokenType LookupType(char *name, TokenNode *np)
 {
    const int x = FindValue(TOKEN_MAP, TOKEN_MAP_COUNT, name);
    if(x >= 0) {
@@ -542,7 +620,7 @@ TokenType LookupType(const char *name, TokenNode *np)
 
    if(JUNLIKELY(np)) {
       np->type = TOK_INVALID;
-      np->invalidName = CopyString(name);
+      np->invalidName = name;
    }
 
    return TOK_INVALID;
@@ -571,7 +649,20 @@ TokenNode *CreateNode(TokenNode *current, const char *file,
 {
    TokenNode *np;
 
-   np = Allocate(sizeof(TokenNode));
+   if(!current && head) {
+
+      /* A duplicate top-level node.
+       * This is probably a configuration error.
+       */
+      return head->subnodeTail ? head->subnodeTail : head;
+
+   }
+
+   if(current) {
+      np = AllocateToken(sizeof(TokenNode));
+   } else {
+      np = AllocateToken(sizeof(TokenTree));
+   }
    np->type = TOK_INVALID;
    np->value = NULL;
    np->attributes = NULL;
@@ -594,19 +685,11 @@ TokenNode *CreateNode(TokenNode *current, const char *file,
       }
       current->subnodeTail = np;
 
-   } else if(!head) {
+   } else {
 
       /* The top-level node. */
       head = np;
 
-   } else {
-
-      /* A duplicate top-level node.
-       * This is probably a configuration error.
-       */
-      ReleaseTokens(np);
-      np = head->subnodeTail ? head->subnodeTail : head;
-
    }
 
    return np;
@@ -616,7 +699,7 @@ TokenNode *CreateNode(TokenNode *current, const char *file,
 AttributeNode *CreateAttribute(TokenNode *np)
 {
    AttributeNode *ap;
-   ap = Allocate(sizeof(AttributeNode));
+   ap = AllocateToken(sizeof(AttributeNode));
    ap->name = NULL;
    ap->value = NULL;
    ap->next = np->attributes;
@@ -627,39 +710,212 @@ AttributeNode *CreateAttribute(TokenNode *np)
 /** Release a token list. */
 void ReleaseTokens(TokenNode *np)
 {
+   if(np) {
+      ReleaseBlocks(((TokenTree*)np)->blocks);
+   }
+}
 
-   AttributeNode *ap;
-   TokenNode *tp;
+/** Get a signature of the token types. */
+unsigned int GetTokenSignature(void)
+{
+   unsigned int hash = 2166136261U;
+   unsigned int x;
+   size_t i;
+   for(x = 0; x < TOKEN_MAP_COUNT; x++) {
+      const char *name = TOKEN_MAP[x].key;
+      for(i = 0; name[i]; i++) {
+         hash = (hash ^ (unsigned char)name[i]) * 16777619U;
+      }
+      hash = (hash ^ (unsigned int)TOKEN_MAP[x].value) * 16777619U;
+   }
+   return hash;
+}
 
-   while(np) {
-      tp = np->next;
+/** Serialize a token tree. */
+char *SerializeTokens(const TokenNode *np, size_t *size)
+{
+   TokenWriter writer;
+   writer.capacity = 4096;
+   writer.length = 0;
+   writer.data = Allocate(writer.capacity);
+   WriteToken(&writer, np);
+   *size = writer.length;
+   return writer.data;
+}
 
-      while(np->attributes) {
-         ap = np->attributes->next;
-         if(np->attributes->name) {
-            Release(np->attributes->name);
-         }
-         if(np->attributes->value) {
-            Release(np->attributes->value);
-         }
-         Release(np->attributes);
-         np->attributes = ap;
-      }
+/** Serialize a token and its children. */
+void WriteToken(TokenWriter *wp, const TokenNode *np)
+{
+   const AttributeNode *ap;
+   const TokenNode *tp;
+   unsigned int count;
+
+   WriteWord(wp, np->type);
+   WriteWord(wp, np->line);
+   WriteString(wp, np->invalidName);
+   WriteString(wp, np->value);
+
+   count = 0;
+   for(ap = np->attributes; ap; ap = ap->next) {
+      count += 1;
+   }
+   WriteWord(wp, count);
+   for(ap = np->attributes; ap; ap = ap->next) {
+      WriteString(wp, ap->name);
+      WriteString(wp, ap->value);
+   }
 
-      if(np->subnodeHead) {
-         ReleaseTokens(np->subnodeHead);
-      }
+   count = 0;
+   for(tp = np->subnodeHead; tp; tp = tp->next) {
+      count += 1;
+   }
+   WriteWord(wp, count);
+   for(tp = np->subnodeHead; tp; tp = tp->next) {
+      WriteToken(wp, tp);
+   }
+}
+
+/** Serialize a word. */
+void WriteWord(TokenWriter *wp, unsigned int value)
+{
+   if(wp->length + sizeof(value) > wp->capacity) {
+      wp->capacity *= 2;
+      wp->data = Reallocate(wp->data, wp->capacity);
+   }
+   memcpy(&wp->data[wp->length], &value, sizeof(value));
+   wp->length += sizeof(value);
+}
+
+/** Serialize a string.
+ * Strings are stored as a length (0 for NULL) followed by the
+ * zero-terminated string padded to a word.
+ */
+void WriteString(TokenWriter *wp, const char *str)
+{
+   const size_t len = str ? strlen(str) + 1 : 0;
+   const size_t padded = (len + sizeof(unsigned int) - 1)
+                       & ~(sizeof(unsigned int) - 1);
+   WriteWord(wp, len);
+   while(wp->length + padded > wp->capacity) {
+      wp->capacity *= 2;
+      wp->data = Reallocate(wp->data, wp->capacity);
+   }
+   memcpy(&wp->data[wp->length], str, len);
+   memset(&wp->data[wp->length + len], 0, padded - len);
+   wp->length += padded;
+}
+
+/** Rebuild a token tree serialized with SerializeTokens. */
+TokenNode *DeserializeTokens(char *data, size_t size, const char *fileName)
+{
+   TokenReader reader;
+   TokenNode *np;
+
+   reader.data = data;
+   reader.offset = 0;
+   reader.size = size;
+   reader.fileName = fileName;
+
+   blocks = NULL;
+   np = AllocateToken(sizeof(TokenTree));
+   np->parent = NULL;
+   np->next = NULL;
+   if(JUNLIKELY(!ReadToken(&reader, np) || reader.offset != size)) {
+      ReleaseBlocks(blocks);
+      blocks = NULL;
+      return NULL;
+   }
+   ((TokenTree*)np)->blocks = blocks;
+   blocks = NULL;
+   return np;
+}
+
+/** Deserialize a token and its children. */
+char ReadToken(TokenReader *rp, TokenNode *np)
+{
+   AttributeNode **ap;
+   TokenNode *last;
+   unsigned int type, count;
 
-      if(np->value) {
-         Release(np->value);
+   np->fileName = rp->fileName;
+   np->attributes = NULL;
+   np->subnodeHead = NULL;
+   np->subnodeTail = NULL;
+   if(!ReadWord(rp, &type) || type > TOKEN_MAP_COUNT
+      || !ReadWord(rp, &np->line)
+      || !ReadString(rp, &np->invalidName)
+      || !ReadString(rp, &np->value)
+      || !ReadWord(rp, &count)) {
+      return 0;
+   }
+   np->type = type;
+
+   ap = &np->attributes;
+   while(count > 0) {
+      *ap = AllocateToken(sizeof(AttributeNode));
+      (*ap)->next = NULL;
+      if(!ReadString(rp, &(*ap)->name) || !ReadString(rp, &(*ap)->value)) {
+         return 0;
       }
+      ap = &(*ap)->next;
+      count -= 1;
+   }
 
-      if(np->invalidName) {
-         Release(np->invalidName);
+   if(!ReadWord(rp, &count)) {
+      return 0;
+   }
+   last = NULL;
+   while(count > 0) {
+      TokenNode *tp = AllocateToken(sizeof(TokenNode));
+      tp->parent = np;
+      tp->next = NULL;
+      if(last) {
+         last->next = tp;
+      } else {
+         np->subnodeHead = tp;
+      }
+      np->subnodeTail = tp;
+      last = tp;
+      if(!ReadToken(rp, tp)) {
+         return 0;
       }
+      count -= 1;
+   }
+   return 1;
+}
 
-      Release(np);
-      np = tp;
+/** Deserialize a word. */
+char ReadWord(TokenReader *rp, unsigned int *value)
+{
+   if(JUNLIKELY(rp->offset + sizeof(*value) > rp->size)) {
+      return 0;
    }
+   memcpy(value, &rp->data[rp->offset], sizeof(*value));
+   rp->offset += sizeof(*value);
+   return 1;
+}
 
+/** Deserialize a string.
+ * The result points into the serialized data.
+ */
+char ReadString(TokenReader *rp, char **str)
+{
+   unsigned int len;
+   size_t padded;
+   if(JUNLIKELY(!ReadWord(rp, &len))) {
+      return 0;
+   }
+   padded = (len + sizeof(unsigned int) - 1) & ~(sizeof(unsigned int) - 1);
+   if(JUNLIKELY(rp->offset + padded > rp->size)) {
+      return 0;
+   }
+   if(len == 0) {
+      *str = NULL;
+   } else if(JUNLIKELY(rp->data[rp->offset + len - 1] != 0)) {
+      return 0;
+   } else {
+      *str = &rp->data[rp->offset];
+   }
+   rp->offset += padded;
+   return 1;
 }
@@ -36,17 +36,23 @@ typedef enum {
    TOK_DOUBLECLICKSPEED,
    TOK_DYNAMIC,
    TOK_EXIT,
+   TOK_FOCUSDELAY,
    TOK_FOCUSMODEL,
    TOK_FONT,
    TOK_FOREGROUND,
    TOK_GROUP,
    TOK_HEIGHT,
+   TOK_ICONFILTER,
+   TOK_ICONMEMORY,
    TOK_ICONPATH,
+   TOK_ICONTHEME,
    TOK_INCLUDE,
+   TOK_INPUTPRIORITY,
    TOK_JWM,
    TOK_KEY,
    TOK_KILL,
    TOK_LAYER,
+   TOK_LOWMEMORY,
    TOK_MACHINE,
    TOK_MAXIMIZE,
    TOK_MENU,
@@ -75,7 +81,9 @@ typedef enum {
    TOK_SHUTDOWNCOMMAND,
    TOK_SNAPMODE,
    TOK_SPACER,
+   TOK_STALLTIMEOUT,
    TOK_STARTUPCOMMAND,
+   TOK_STARTUPMODE,
    TOK_STICK,
    TOK_SWALLOW,
    TOK_TASKLIST,
@@ -86,6 +94,7 @@ typedef enum {
    TOK_TRAYBUTTON,
    TOK_TRAYBUTTONSTYLE,
    TOK_TRAYSTYLE,
+   TOK_TRAYTEXT,
    TOK_TYPE,
    TOK_WIDTH,
    TOK_WINDOWSTYLE
@@ -120,7 +129,8 @@ typedef struct TokenNode {
 /** Tokenize a buffer.
  * @param line The buffer to tokenize.
  * @param fileName The name of the file for error reporting.
- * @return A linked list of tokens from the buffer.
+ * @return A linked list of tokens from the buffer, to be released with
+ *         ReleaseTokens.
  */
 TokenNode *Tokenize(const char *line, const char *fileName);
 
@@ -138,8 +148,32 @@ const char *GetTokenName(const TokenNode *tp);
 const char *GetTokenTypeName(TokenType type);
 
 /** Release token nodes.
- * @param np The top-level token to release.
+ * All tokens returned by Tokenize are released together.
+ * @param np The top-level token returned by Tokenize.
  */
 void ReleaseTokens(TokenNode *np);
 
+/** Serialize a token tree.
+ * @param np The top-level token returned by Tokenize.
+ * @param size Set to the size of the result in bytes.
+ * @return The serialized tokens (to be released by the caller).
+ */
+char *SerializeTokens(const TokenNode *np, size_t *size);
+
+/** Rebuild a token tree serialized with SerializeTokens.
+ * Strings in the tree point into the data, which must remain valid
+ * until the tree is released.
+ * @param data The serialized tokens.
+ * @param size The size of the data in bytes.
+ * @param fileName The name of the file for error reporting.
+ * @return The top-level token (NULL if the data is invalid).
+ */
+TokenNode *DeserializeTokens(char *data, size_t size, const char *fileName);
+
+/** Get a signature of the token types.
+ * Serialized tokens are only valid for the same signature.
+ * @return A hash of the names of all token types in order.
+ */
+unsigned int GetTokenSignature(void);
+
 #endif /* LEX_H */
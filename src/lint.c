@@ -0,0 +1,351 @@
+/**
+ * @file lint.c
+ * @author Joe Wingbermuehle
+ * @date 2026
+ *
+ * @brief Checks for configuration with a runtime cost.
+ *
+ * These checks only run for "jwm -p". They look for settings that work
+ * but make JWM slow to start, to reload, or to respond, and report the
+ * time taken to parse each file.
+ *
+ */
+
+#include "jwm.h"
+#include "lint.h"
+#include "lex.h"
+#include "menu.h"
+#include "match.h"
+#include "image.h"
+#include "binding.h"
+#include "tray.h"
+#include "timing.h"
+#include "error.h"
+#include "misc.h"
+
+#include <dirent.h>
+#include <sys/stat.h>
+#ifdef HAVE_SYS_VFS_H
+#  include <sys/vfs.h>
+#endif
+
+/** Longest timeout for a program before warning. */
+#define LINT_TIMEOUT_MS       MENU_TIMEOUT_MS
+
+/** Most items in a menu before warning. */
+#define LINT_MENU_ITEMS       100
+
+/** Longest time to list an icon path before warning. */
+#define LINT_LIST_MS          50
+
+/** Most pixels in a background image before warning. */
+#define LINT_IMAGE_PIXELS     (3840UL * 2160UL)
+
+/** Most key grabs before warning. */
+#define LINT_KEY_GRABS        1024
+
+#ifdef HAVE_SYS_VFS_H
+/** File systems reached over the network (from statfs). */
+static const struct {
+   unsigned long magic;
+   const char *name;
+} NETWORK_FILESYSTEMS[] = {
+   { 0x6969UL,       "nfs"    },
+   { 0x517BUL,       "smb"    },
+   { 0xFF534D42UL,   "cifs"   },
+   { 0xFE534D42UL,   "smb2"   },
+   { 0x5346414FUL,   "afs"    },
+   { 0x73757245UL,   "coda"   },
+   { 0x01021997UL,   "9p"     },
+   { 0x00C36400UL,   "ceph"   },
+   { 0x65735546UL,   "fuse"   }
+};
+#endif
+
+char lintConfig = 0;
+
+static void LintWarning(const TokenNode *tp, const char *str, ...);
+static char HasAttribute(const TokenNode *tp, const char *name);
+static void LintMenuItems(const TokenNode *tp, const Menu *menu,
+                          const char *name);
+static const char *GetNetworkFilesystem(const char *path);
+
+/** Get the start time for RecordParseTime. */
+LintTime StartLintTime(void)
+{
+   return lintConfig ? GetMonotonicTime() : 0;
+}
+
+/** Report the time taken to read and parse an included file. */
+void RecordParseTime(const char *name, int depth, LintTime start)
+{
+   unsigned long long elapsed;
+   if(!lintConfig) {
+      return;
+   }
+   elapsed = GetMonotonicTime() - start;
+   printf("parse: %6llu.%03llu ms  %*s%s\n", elapsed / 1000, elapsed % 1000,
+          depth > 1 ? (depth - 1) * 2 : 0, "", name);
+}
+
+/** Check a group pattern for a form that needs the regex engine. */
+void LintPattern(const TokenNode *tp)
+{
+   unsigned int count;
+   char *literal;
+
+   if(!lintConfig || !tp->value) {
+      return;
+   }
+
+   literal = GetLiteralPattern(tp->value);
+   if(literal) {
+      LintWarning(tp, _("pattern \"%s\" uses the regex engine;"
+                        " \"%s\" matches the same without it"),
+                  tp->value, literal);
+      Release(literal);
+      return;
+   }
+
+   count = CountLiteralAlternatives(tp->value);
+   if(count > 0) {
+      LintWarning(tp, _("pattern \"%s\" uses the regex engine;"
+                        " %u %s tags match the same without it"),
+                  tp->value, count, GetTokenName(tp));
+   }
+}
+
+/** Check the timeout of an include read from a program. */
+void LintInclude(const TokenNode *tp, unsigned timeout_ms)
+{
+   if(!lintConfig) {
+      return;
+   }
+   if(!HasAttribute(tp, "timeout")) {
+      LintWarning(tp, _("include has no timeout and can block for %u ms"),
+                  timeout_ms);
+   } else if(timeout_ms > LINT_TIMEOUT_MS) {
+      LintWarning(tp, _("include can block for %u ms"), timeout_ms);
+   }
+}
+
+/** Check the timeout and ttl of a dynamic menu. */
+void LintDynamicMenu(const TokenNode *tp, const char *command,
+                     unsigned timeout_ms, unsigned ttl_ms)
+{
+   if(!lintConfig || !command || strncmp(command, "exec:", 5)) {
+      return;
+   }
+   if(!HasAttribute(tp, "timeout")) {
+      LintWarning(tp, _("dynamic menu has no timeout;"
+                        " a stalled program runs for %u ms"), timeout_ms);
+   } else if(timeout_ms > LINT_TIMEOUT_MS) {
+      LintWarning(tp, _("dynamic menu program can run for %u ms"),
+                  timeout_ms);
+   }
+   if(ttl_ms == 0) {
+      LintWarning(tp, _("dynamic menu program runs each time the menu"
+                        " is shown; set a ttl to reuse its output"));
+   }
+}
+
+/** Check the size of a menu and its submenus. */
+void LintMenu(const TokenNode *tp, const Menu *menu)
+{
+   if(lintConfig && menu) {
+      LintMenuItems(tp, menu, GetTokenName(tp));
+   }
+}
+
+/** Check the size of a menu and then its submenus. */
+void LintMenuItems(const TokenNode *tp, const Menu *menu, const char *name)
+{
+   const MenuItem *ip;
+   unsigned int count;
+
+   count = 0;
+   for(ip = menu->items; ip; ip = ip->next) {
+      if(ip->type != MENU_ITEM_SEPARATOR) {
+         count += 1;
+      }
+   }
+   if(count > LINT_MENU_ITEMS) {
+      LintWarning(tp, _("menu \"%s\" has %u items; split it into submenus"),
+                  name, count);
+   }
+
+   for(ip = menu->items; ip; ip = ip->next) {
+      if(ip->type == MENU_ITEM_SUBMENU && ip->submenu) {
+         LintMenuItems(tp, ip->submenu, ip->name ? ip->name : name);
+      }
+   }
+}
+
+/** Check that an icon path exists and is quick to list. */
+void LintIconPath(const TokenNode *tp)
+{
+   struct stat st;
+   LintTime start;
+   unsigned long long elapsed;
+   const char *fsName;
+   char *path;
+   DIR *dir;
+   unsigned int count;
+
+   if(!lintConfig || !tp->value) {
+      return;
+   }
+
+   path = CopyString(tp->value);
+   Trim(path);
+   ExpandPath(&path);
+   if(stat(path, &st) < 0 || !S_ISDIR(st.st_mode)) {
+      LintWarning(tp, _("icon path \"%s\" is not a directory;"
+                        " it is still checked when icons are loaded"), path);
+      Release(path);
+      return;
+   }
+
+   fsName = GetNetworkFilesystem(path);
+   if(fsName) {
+      LintWarning(tp, _("icon path \"%s\" is on a network file system (%s)"),
+                  path, fsName);
+   }
+
+   /* Icon paths are listed once when the first icon is loaded. */
+   start = GetMonotonicTime();
+   count = 0;
+   dir = opendir(path);
+   if(dir) {
+      while(readdir(dir)) {
+         count += 1;
+      }
+      closedir(dir);
+   }
+   elapsed = GetMonotonicTime() - start;
+   if(elapsed > LINT_LIST_MS * 1000ULL) {
+      LintWarning(tp, _("listing icon path \"%s\" (%u files) took %llu ms"),
+                  path, count, elapsed / 1000);
+   }
+
+   Release(path);
+}
+
+/** Check the size of a background image. */
+void LintBackground(const TokenNode *tp, const char *type)
+{
+   ImageNode *image;
+   char *path;
+
+   if(!lintConfig || !tp->value || !type) {
+      return;
+   }
+   if(strcmp(type, "image") && strcmp(type, "scale")
+      && strcmp(type, "tile")) {
+      return;
+   }
+
+   /* Relative names are found through the icon paths at startup. */
+   path = CopyString(tp->value);
+   ExpandPath(&path);
+   if(path[0] != '/') {
+      Release(path);
+      return;
+   }
+
+   image = LoadImageHeader(path);
+   if(!image) {
+      LintWarning(tp, _("background image not found: \"%s\""), path);
+   } else {
+      const unsigned long pixels = (unsigned long)image->width
+                                 * (unsigned long)image->height;
+      if(pixels > LINT_IMAGE_PIXELS) {
+         LintWarning(tp, _("background image \"%s\" is %dx%d and is decoded"
+                           " at full size (%lu MiB)"),
+                     path, image->width, image->height,
+                     (pixels * 4) >> 20);
+      }
+      DestroyImage(image);
+   }
+   Release(path);
+}
+
+/** Check the number of key grabs. */
+void LintBindings(void)
+{
+   TrayType *tp;
+   unsigned int windows;
+   unsigned int keys;
+   unsigned int grabs;
+
+   if(!lintConfig) {
+      return;
+   }
+
+   windows = 1;
+   for(tp = GetTrays(); tp; tp = tp->next) {
+      windows += 1;
+   }
+   grabs = CountKeyGrabs(&keys) * windows;
+   if(grabs > LINT_KEY_GRABS) {
+      LintWarning(NULL, _("%u keys on %u windows take %u key grabs"),
+                  keys, windows, grabs);
+   }
+}
+
+/** Report a runtime cost. */
+void LintWarning(const TokenNode *tp, const char *str, ...)
+{
+   static const char FILE_MESSAGE[] = "%s[%u]: performance";
+
+   va_list ap;
+   char *msg;
+
+   va_start(ap, str);
+   if(tp) {
+      const size_t msg_len = sizeof(FILE_MESSAGE) + strlen(tp->fileName)
+                           + 10;
+      msg = Allocate(msg_len);
+      snprintf(msg, msg_len, FILE_MESSAGE, tp->fileName, tp->line);
+   } else {
+      msg = CopyString(_("performance"));
+   }
+   WarningVA(msg, str, ap);
+   Release(msg);
+   va_end(ap);
+}
+
+/** Determine if a tag has an attribute. */
+char HasAttribute(const TokenNode *tp, const char *name)
+{
+   const AttributeNode *ap;
+   for(ap = tp->attributes; ap; ap = ap->next) {
+      if(!strcmp(ap->name, name)) {
+         return 1;
+      }
+   }
+   return 0;
+}
+
+/** Get the name of the network file system containing a path.
+ * @return The name or NULL if the file system is local or unknown.
+ */
+const char *GetNetworkFilesystem(const char *path)
+{
+#ifdef HAVE_SYS_VFS_H
+   struct statfs sfs;
+   unsigned long magic;
+   unsigned int x;
+
+   if(statfs(path, &sfs) < 0) {
+      return NULL;
+   }
+   magic = (unsigned long)sfs.f_type & 0xFFFFFFFFUL;
+   for(x = 0; x < ARRAY_LENGTH(NETWORK_FILESYSTEMS); x++) {
+      if(NETWORK_FILESYSTEMS[x].magic == magic) {
+         return NETWORK_FILESYSTEMS[x].name;
+      }
+   }
+#endif
+   return NULL;
+}
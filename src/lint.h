@@ -0,0 +1,76 @@
+/**
+ * @file lint.h
+ * @author Joe Wingbermuehle
+ * @date 2026
+ *
+ * @brief Checks for configuration with a runtime cost.
+ *
+ */
+
+#ifndef LINT_H
+#define LINT_H
+
+struct TokenNode;
+struct Menu;
+
+/** Time passed to RecordParseTime. */
+typedef unsigned long long LintTime;
+
+/** Set to check the configuration while it is parsed (jwm -p). */
+extern char lintConfig;
+
+/** Get the start time for RecordParseTime.
+ * @return The current time if checking, otherwise 0.
+ */
+LintTime StartLintTime(void);
+
+/** Report the time taken to read and parse an included file.
+ * @param name The file or command.
+ * @param depth The include depth.
+ * @param start The time returned by StartLintTime.
+ */
+void RecordParseTime(const char *name, int depth, LintTime start);
+
+/** Check a group pattern for a form that needs the regex engine.
+ * @param tp The Class, Name, or Machine tag.
+ */
+void LintPattern(const struct TokenNode *tp);
+
+/** Check the timeout of an include read from a program.
+ * @param tp The include tag.
+ * @param timeout_ms The timeout in milliseconds.
+ */
+void LintInclude(const struct TokenNode *tp, unsigned timeout_ms);
+
+/** Check the timeout and ttl of a dynamic menu.
+ * @param tp The dynamic menu tag.
+ * @param command The menu file or command.
+ * @param timeout_ms The timeout in milliseconds.
+ * @param ttl_ms The ttl in milliseconds.
+ */
+void LintDynamicMenu(const struct TokenNode *tp, const char *command,
+                     unsigned timeout_ms, unsigned ttl_ms);
+
+/** Check the size of a menu and its submenus.
+ * @param tp The root menu tag.
+ * @param menu The parsed menu.
+ */
+void LintMenu(const struct TokenNode *tp, const struct Menu *menu);
+
+/** Check that an icon path exists and is quick to list.
+ * @param tp The icon path tag.
+ */
+void LintIconPath(const struct TokenNode *tp);
+
+/** Check the size of a background image.
+ * @param tp The background tag.
+ * @param type The background type (may be NULL).
+ */
+void LintBackground(const struct TokenNode *tp, const char *type);
+
+/** Check the number of key grabs.
+ * This is called once the configuration is parsed.
+ */
+void LintBindings(void);
+
+#endif /* LINT_H */
@@ -13,34 +13,51 @@
 #include "help.h"
 #include "error.h"
 #include "event.h"
+#include "expose.h"
 
 #include "border.h"
 #include "client.h"
 #include "color.h"
 #include "command.h"
+#include "control.h"
 #include "cursor.h"
 #include "confirm.h"
 #include "font.h"
 #include "group.h"
 #include "binding.h"
+#include "gcpool.h"
+#include "gradient.h"
+#include "outline.h"
 #include "icon.h"
 #include "taskbar.h"
 #include "tray.h"
 #include "traybutton.h"
 #include "popup.h"
 #include "pager.h"
+#include "preview.h"
 #include "swallow.h"
 #include "screen.h"
 #include "root.h"
 #include "desktop.h"
 #include "place.h"
 #include "clock.h"
+#include "traytext.h"
 #include "dock.h"
 #include "misc.h"
 #include "background.h"
 #include "settings.h"
 #include "timing.h"
 #include "grab.h"
+#include "winmap.h"
+#include "hint.h"
+#include "shm.h"
+#include "bulk.h"
+#include "lint.h"
+#include "stats.h"
+#include "trace.h"
+#include "restart.h"
+#include "winpool.h"
+#include "bench.h"
 
 #include <errno.h>
 
@@ -54,21 +71,20 @@ int rootDepth;
 GC rootGC;
 int colormapCount;
 Window supportingWindow;
-Atom managerSelection;
 
 char shouldExit = 0;
 char shouldRestart = 0;
+char shouldReexec = 0;
 char isRestarting = 0;
 char initializing = 0;
 char shouldReload = 0;
+char shouldHotReload = 0;
 
 unsigned int currentDesktop = 0;
 unsigned int previousDesktop = 0;
 
 char *exitCommand = NULL;
 
-XContext clientContext;
-XContext frameContext;
 
 #ifdef USE_SHAPE
 char haveShape;
@@ -77,11 +93,24 @@ int shapeEvent;
 #ifdef USE_XRENDER
 char haveRender;
 #endif
+#ifdef USE_XSYNC
+char haveSync;
+int syncEvent;
+#endif
+#ifdef USE_XRANDR
+char haveRandR;
+int randrEvent;
+#endif
+#ifdef USE_XCOMPOSITE
+char haveComposite;
+int damageEvent;
+#endif
 
 static void Initialize(void);
 static void Startup(void);
 static void Shutdown(void);
 static void Destroy(void);
+static char HotReload(void);
 
 static void OpenConnection(void);
 static void CloseConnection(void);
@@ -91,26 +120,43 @@ static void ShutdownConnection(void);
 static void EventLoop(void);
 static void HandleExit(int sig);
 static void HandleChild(int sig);
+#ifdef USE_TRACE
+static void HandleTrace(int sig);
+#endif
 static void DoExit(int code);
 static void SendRestart(void);
+static void SendReexec(void);
+static void ExecRestart(char *argv[]);
 static void SendExit(void);
 static void SendReload(void);
 static void SendJWMMessage(const char *message);
+static int QueryStats(void);
+#ifdef USE_BENCH
+static int RunBenchmark(void);
+#endif
+static void StartPhase(void);
+static void EndPhase(const char *name);
 
 static char *displayString = NULL;
+static StatsTime phaseStats;
+static TraceTime phaseTrace;
 
 char *configPath = NULL;
 
 /** The main entry point. */
-#ifndef UNIT_TEST
+#if !defined(UNIT_TEST) && !defined(MICROBENCH)
 int main(int argc, char *argv[])
 {
    int x;
    enum {
       COMMAND_RUN,
       COMMAND_RESTART,
+      COMMAND_REEXEC,
       COMMAND_EXIT,
       COMMAND_RELOAD,
+      COMMAND_STATS,
+      COMMAND_CONTROL,
+      COMMAND_BENCH,
       COMMAND_PARSE
    } action;
 
@@ -129,10 +175,22 @@ int main(int argc, char *argv[])
          action = COMMAND_PARSE;
       } else if(!strcmp(argv[x], "-restart")) {
          action = COMMAND_RESTART;
+      } else if(!strcmp(argv[x], "-reexec")) {
+         action = COMMAND_REEXEC;
       } else if(!strcmp(argv[x], "-exit")) {
          action = COMMAND_EXIT;
       } else if(!strcmp(argv[x], "-reload")) {
          action = COMMAND_RELOAD;
+      } else if(!strcmp(argv[x], "-stats")) {
+         action = COMMAND_STATS;
+#ifdef USE_CONTROL
+      } else if(!strcmp(argv[x], "-control")) {
+         action = COMMAND_CONTROL;
+#endif
+#ifdef USE_BENCH
+      } else if(!strcmp(argv[x], "-bench-render")) {
+         action = COMMAND_BENCH;
+#endif
       } else if(!strcmp(argv[x], "-display") && x + 1 < argc) {
          displayString = argv[++x];
       } else if(!strcmp(argv[x], "-f") && x + 1 < argc) {
@@ -149,18 +207,32 @@ int main(int argc, char *argv[])
 
    switch(action) {
    case COMMAND_PARSE:
+      lintConfig = 1;
       Initialize();
       ParseConfig(configPath);
       DoExit(0);
    case COMMAND_RESTART:
       SendRestart();
       DoExit(0);
+   case COMMAND_REEXEC:
+      SendReexec();
+      DoExit(0);
    case COMMAND_EXIT:
       SendExit();
       DoExit(0);
    case COMMAND_RELOAD:
       SendReload();
       DoExit(0);
+   case COMMAND_STATS:
+      DoExit(QueryStats());
+#ifdef USE_CONTROL
+   case COMMAND_CONTROL:
+      DoExit(RunControlClient(displayString));
+#endif
+#ifdef USE_BENCH
+   case COMMAND_BENCH:
+      DoExit(RunBenchmark());
+#endif
    default:
       break;
    }
@@ -173,8 +245,10 @@ int main(int argc, char *argv[])
    textdomain("jwm");
 #endif
 
-   /* The main loop. */
+   /* The main loop.
+    * State left by an exec restart makes this a restart as well. */
    StartupConnection();
+   shouldRestart = HaveRestartState();
    do {
 
       isRestarting = shouldRestart;
@@ -183,16 +257,22 @@ int main(int argc, char *argv[])
       shouldReload = 0;
 
       /* Prepare JWM components. */
+      StartPhase();
       Initialize();
+      EndPhase("initialize");
 
       /* Parse the configuration file. */
       ParseConfig(configPath);
+      EndPhase("config");
 
       /* Start up the JWM components. */
       Startup();
 
-      /* The main event loop. */
-      EventLoop();
+      /* The main event loop.
+       * Configuration changes are applied in place when possible. */
+      do {
+         EventLoop();
+      } while(HotReload());
 
       /* Shutdown JWM components. */
       Shutdown();
@@ -200,6 +280,11 @@ int main(int argc, char *argv[])
       /* Perform any extra cleanup. */
       Destroy();
 
+      /* Run the executable again; this returns only if exec fails. */
+      if(shouldReexec) {
+         ExecRestart(argv);
+      }
+
    } while(shouldRestart);
    ShutdownConnection();
 
@@ -233,6 +318,7 @@ void DoExit(int code)
       exitCommand = NULL;
    }
 
+   ShowXProfile();
    StopDebug();
    exit(code);
 }
@@ -242,7 +328,6 @@ void EventLoop(void)
 {
 
    XEvent event;
-   TimeType start;
 
    /* Loop processing events until it's time to exit. */
    while(JLIKELY(!shouldExit)) {
@@ -251,20 +336,10 @@ void EventLoop(void)
       }
    }
 
-   /* Process events one last time. */
-   GetCurrentTime(&start);
-   for(;;) {
-      if(JXPending(display) == 0) {
-         if(!IsSwallowPending()) {
-            break;
-         } else {
-            TimeType now;
-            GetCurrentTime(&now);
-            if(GetTimeDifference(&start, &now) > RESTART_DELAY) {
-               break;
-            }
-         }
-      }
+   /* Process events one last time.
+    * Programs still to be swallowed are not waited for; after a restart
+    * they are swallowed when they map their windows. */
+   while(JXPending(display) > 0) {
       if(WaitForEvent(&event)) {
          ProcessEvent(&event);
       }
@@ -276,6 +351,11 @@ void EventLoop(void)
 void OpenConnection(void)
 {
 
+#ifdef USE_BULK
+   /* The bulk worker uses Xlib from a second thread. */
+   JXInitThreads();
+#endif
+
    display = JXOpenDisplay(displayString);
    if(JUNLIKELY(!display)) {
       if(displayString) {
@@ -321,9 +401,20 @@ void StartupConnection(void)
 #ifdef USE_XRENDER
    int renderEvent;
    int renderError;
+#endif
+#ifdef USE_XSYNC
+   int syncError;
+   int syncMajor, syncMinor;
+#endif
+#ifdef USE_XRANDR
+   int randrError;
+   int randrMajor, randrMinor;
+#endif
+#ifdef USE_XCOMPOSITE
+   int compositeEvent, compositeError;
+   int damageError;
 #endif
    struct sigaction sa;
-   char name[32];
    Window win;
    XEvent event;
    int revert;
@@ -339,17 +430,16 @@ void StartupConnection(void)
    supportingWindow = JXCreateSimpleWindow(display, rootWindow,
                                            0, 0, 1, 1, 0, 0, 0);
 
-   /* Get the atom used for the window manager selection. */
-   snprintf(name, 32, "WM_S%d", rootScreen);
-   managerSelection = JXInternAtom(display, name, False);
+   /* Get the atoms, including the window manager selection. */
+   InternAtoms();
 
    /* Get the current window manager and take the selection. */
    GrabServer();
-   win = JXGetSelectionOwner(display, managerSelection);
+   win = JXGetSelectionOwner(display, atoms[ATOM_WM_SELECTION]);
    if(win != None) {
       JXSelectInput(display, win, StructureNotifyMask);
    }
-   JXSetSelectionOwner(display, managerSelection,
+   JXSetSelectionOwner(display, atoms[ATOM_WM_SELECTION],
                        supportingWindow, CurrentTime);
    UngrabServer();
 
@@ -364,10 +454,10 @@ void StartupConnection(void)
    event.xclient.display = display;
    event.xclient.type = ClientMessage;
    event.xclient.window = rootWindow;
-   event.xclient.message_type = JXInternAtom(display, managerProperty, False);
+   event.xclient.message_type = atoms[ATOM_MANAGER];
    event.xclient.format = 32;
    event.xclient.data.l[0] = CurrentTime;
-   event.xclient.data.l[1] = managerSelection;
+   event.xclient.data.l[1] = atoms[ATOM_WM_SELECTION];
    event.xclient.data.l[2] = supportingWindow;
    event.xclient.data.l[3] = 2;
    event.xclient.data.l[4] = 0;
@@ -376,9 +466,6 @@ void StartupConnection(void)
 
    JXSetErrorHandler(ErrorHandler);
 
-   clientContext = XUniqueContext();
-   frameContext = XUniqueContext();
-
    /* Set the events we want for the root window.
     * Note that asking for SubstructureRedirect will fail
     * if another window manager is already running.
@@ -404,6 +491,11 @@ void StartupConnection(void)
    sa.sa_handler = HandleChild;
    sigaction(SIGCHLD, &sa, NULL);
 
+#ifdef USE_TRACE
+   sa.sa_handler = HandleTrace;
+   sigaction(SIGUSR1, &sa, NULL);
+#endif
+
 #ifdef USE_SHAPE
    haveShape = JXShapeQueryExtension(display, &shapeEvent, &shapeError);
    if (haveShape) {
@@ -422,6 +514,40 @@ void StartupConnection(void)
    }
 #endif
 
+#ifdef USE_XSYNC
+   haveSync = JXSyncQueryExtension(display, &syncEvent, &syncError)
+           && JXSyncInitialize(display, &syncMajor, &syncMinor);
+   if(haveSync) {
+      Debug("sync extension enabled");
+   } else {
+      Debug("sync extension disabled");
+   }
+#endif
+
+#ifdef USE_XRANDR
+   /* Monitors are read from CRTCs, which needs RandR 1.3. */
+   haveRandR = JXRRQueryExtension(display, &randrEvent, &randrError)
+            && JXRRQueryVersion(display, &randrMajor, &randrMinor)
+            && (randrMajor > 1 || (randrMajor == 1 && randrMinor >= 3));
+   if(haveRandR) {
+      Debug("randr extension enabled");
+   } else {
+      Debug("randr extension disabled");
+   }
+#endif
+
+#ifdef USE_XCOMPOSITE
+   haveComposite = JXCompositeQueryExtension(display, &compositeEvent,
+                                             &compositeError)
+                && JXDamageQueryExtension(display, &damageEvent,
+                                          &damageError);
+   if(haveComposite) {
+      Debug("composite extension enabled");
+   } else {
+      Debug("composite extension disabled");
+   }
+#endif
+
    /* Make sure we have input focus. */
    win = None;
    JXGetInputFocus(display, &win, &revert);
@@ -460,6 +586,14 @@ void HandleChild(int sig)
    errno = savedErrno;
 }
 
+#ifdef USE_TRACE
+/** Signal handler for SIGUSR1. */
+void HandleTrace(int sig)
+{
+   RequestTrace();
+}
+#endif
+
 /** Initialize data structures.
  * This is called before the X connection is opened.
  */
@@ -471,6 +605,7 @@ void Initialize(void)
    InitializeBorders();
    InitializeClients();
    InitializeClock();
+   InitializeTrayText();
    InitializeColors();
    InitializeCommands();
    InitializeCursors();
@@ -486,6 +621,7 @@ void Initialize(void)
    InitializePager();
    InitializePlacement();
    InitializePopup();
+   InitializePreviews();
    InitializeRootMenu();
    InitializeScreens();
    InitializeSettings();
@@ -508,34 +644,46 @@ void Startup(void)
    GrabServer();
 
    StartupSettings();
+   StartupWatchdog();
    StartupScreens();
+   EndPhase("screens");
 
    StartupGroups();
    StartupColors();
    StartupFonts();
+   StartupShm();
+   StartupBulk();
    StartupIcons();
    StartupBackgrounds();
    StartupCursors();
+   EndPhase("resources");
 
    StartupPager();
    StartupClock();
+   StartupTrayText();
    StartupTaskBar();
    StartupTrayButtons();
    StartupDesktops();
    StartupHints();
    StartupDock();
    StartupTray();
+   StartupPreviews();
+   EndPhase("trays");
+
    StartupBindings();
    StartupBorders();
    StartupPlacement();
    StartupClients();
+   EndPhase("clients");
 
 #  ifndef DISABLE_CONFIRM
       StartupDialogs();
 #  endif
    StartupPopup();
 
+   /* In fast startup mode, this only schedules the root menus. */
    StartupRootMenu();
+   EndPhase("menus");
 
    SetDefaultCursor(rootWindow);
    ReadCurrentDesktop();
@@ -546,8 +694,10 @@ void Startup(void)
    /* Allow clients to do their thing. */
    JXSync(display, True);
    UngrabServer();
+   EndPhase("sync");
 
    StartupSwallow();
+   EndPhase("swallow");
 
    DrawTray();
 
@@ -556,10 +706,32 @@ void Startup(void)
 
    /* Draw the background (if backgrounds are used). */
    LoadBackground(currentDesktop);
+   EndPhase("draw");
 
    /* Run any startup commands. */
    StartupCommands();
 
+   /* Accept commands from the control socket. */
+   StartupControl();
+   EndPhase("commands");
+
+}
+
+/** Start timing a startup phase. */
+void StartPhase(void)
+{
+   phaseStats = StartStats();
+   phaseTrace = StartTrace();
+}
+
+/** Record the time since the last phase and start the next one.
+ * @param name The name of the phase (must be a string literal).
+ */
+void EndPhase(const char *name)
+{
+   RecordStartupStats(name, phaseStats);
+   RecordTrace(name, -1, phaseTrace);
+   StartPhase();
 }
 
 /** Shutdown the various JWM components.
@@ -570,6 +742,7 @@ void Shutdown(void)
 
    /* This order is important. */
 
+   ShutdownControl();
    ShutdownSwallow();
 
 #  ifndef DISABLE_CONFIRM
@@ -584,13 +757,24 @@ void Shutdown(void)
    ShutdownTrayButtons();
    ShutdownTaskBar();
    ShutdownClock();
+   ShutdownTrayText();
    ShutdownBorders();
+   ShutdownExpose();
+   if(shouldRestart || shouldReexec) {
+      SaveRestartState();
+   }
+   ShutdownBulk();
    ShutdownClients();
+   ShutdownPreviews();
    ShutdownBackgrounds();
    ShutdownIcons();
+   ShutdownGradients();
+   ShutdownOutline();
+   ShutdownWindowPool();
    ShutdownCursors();
    ShutdownFonts();
    ShutdownColors();
+   ShutdownGCPool();
    ShutdownGroups();
    ShutdownDesktops();
 
@@ -598,6 +782,7 @@ void Shutdown(void)
    ShutdownHints();
    ShutdownScreens();
    ShutdownSettings();
+   ShutdownWatchdog();
 
    ShutdownCommands();
 
@@ -613,6 +798,7 @@ void Destroy(void)
    DestroyBorders();
    DestroyClients();
    DestroyClock();
+   DestroyTrayText();
    DestroyColors();
    DestroyCommands();
    DestroyCursors();
@@ -625,6 +811,7 @@ void Destroy(void)
    DestroyGroups();
    DestroyHints();
    DestroyIcons();
+   DestroyIncludes();
    DestroyBindings();
    DestroyPager();
    DestroyPlacement();
@@ -636,6 +823,65 @@ void Destroy(void)
    DestroyTaskBar();
    DestroyTray();
    DestroyTrayButtons();
+   DestroyWindowMap();
+}
+
+/** Apply a new configuration without restarting.
+ * Only root menus, bindings, and groups can be replaced in place; any
+ * other change falls back to a full restart. Group changes apply to
+ * windows mapped after the reload.
+ * @return 1 if the configuration was applied, 0 to exit the event loop.
+ */
+char HotReload(void)
+{
+   ConfigMask changes;
+
+   if(!shouldHotReload) {
+      return 0;
+   }
+   shouldHotReload = 0;
+   if(shouldRestart) {
+      return 0;
+   }
+
+   /* Menus are always reloaded since they may include dynamic content. */
+   changes = GetConfigChanges(configPath) | CONFIG_MENUS;
+   if(changes & CONFIG_OTHER) {
+      shouldRestart = 1;
+      return 0;
+   }
+
+   if(changes & CONFIG_MENUS) {
+      ShutdownRootMenu();
+      DestroyRootMenu();
+      InitializeRootMenu();
+   }
+   if(changes & CONFIG_BINDINGS) {
+      /* Grabs are kept so that only the changed ones are sent. */
+      DestroyBindings();
+      InitializeBindings();
+   }
+   if(changes & CONFIG_GROUPS) {
+      ShutdownGroups();
+      DestroyGroups();
+      InitializeGroups();
+   }
+
+   ReloadConfig(configPath, changes);
+
+   if(changes & CONFIG_GROUPS) {
+      StartupGroups();
+   }
+   if(changes & CONFIG_BINDINGS) {
+      StartupBindings();
+   }
+   if(changes & CONFIG_MENUS) {
+      StartupRootMenu();
+   }
+
+   shouldExit = 0;
+   shouldReload = 0;
+   return 1;
 }
 
 /** Send _JWM_RESTART to the root window. */
@@ -644,6 +890,26 @@ void SendRestart(void)
    SendJWMMessage(jwmRestart);
 }
 
+/** Send _JWM_REEXEC to the root window. */
+void SendReexec(void)
+{
+   SendJWMMessage(jwmReexec);
+}
+
+/** Replace this process with a new instance of JWM.
+ * Client state has already been saved by Shutdown. If exec fails,
+ * the connection is opened again for an in-process restart.
+ */
+void ExecRestart(char *argv[])
+{
+   shouldReexec = 0;
+   ShutdownConnection();
+   execvp(argv[0], argv);
+   Warning(_("exec failed: %s"), argv[0]);
+   StartupConnection();
+   shouldRestart = 1;
+}
+
 /** Send _JWM_EXIT to the root window. */
 void SendExit(void)
 {
@@ -656,6 +922,87 @@ void SendReload(void)
    SendJWMMessage(jwmReload);
 }
 
+/** Request statistics from the running JWM and print them.
+ * This sends _JWM_STATS to the root window and waits for JWM to
+ * publish the report in the _JWM_STATS property.
+ * @return The exit status.
+ */
+int QueryStats(void)
+{
+   XEvent event;
+   TimeType start, now;
+   char *names[2];
+   Atom values[2];
+   Atom statsAtom;
+   Atom utf8Atom;
+   Atom realType;
+   int realFormat;
+   unsigned long count;
+   unsigned long extra;
+   unsigned char *data;
+   int fd;
+   char done;
+
+   OpenConnection();
+   names[0] = (char*)jwmStats;
+   names[1] = "UTF8_STRING";
+   JXInternAtoms(display, names, 2, False, values);
+   statsAtom = values[0];
+   utf8Atom = values[1];
+   JXSelectInput(display, rootWindow, PropertyChangeMask);
+
+   memset(&event, 0, sizeof(event));
+   event.xclient.type = ClientMessage;
+   event.xclient.window = rootWindow;
+   event.xclient.message_type = statsAtom;
+   event.xclient.format = 32;
+   JXSendEvent(display, rootWindow, False, SubstructureRedirectMask, &event);
+   JXFlush(display);
+
+#ifdef ConnectionNumber
+   fd = ConnectionNumber(display);
+#else
+   fd = JXConnectionNumber(display);
+#endif
+   GetCurrentTime(&start);
+   done = 0;
+   while(!done) {
+      struct timeval timeout;
+      fd_set fds;
+      while(JXPending(display) > 0) {
+         JXNextEvent(display, &event);
+         if(event.type == PropertyNotify && event.xproperty.atom == statsAtom
+            && event.xproperty.state == PropertyNewValue) {
+            done = 1;
+         }
+      }
+      GetCurrentTime(&now);
+      if(done || GetTimeDifference(&start, &now) > RESTART_DELAY) {
+         break;
+      }
+      FD_ZERO(&fds);
+      FD_SET(fd, &fds);
+      timeout.tv_sec = 0;
+      timeout.tv_usec = 100000;
+      select(fd + 1, &fds, NULL, NULL, &timeout);
+   }
+   if(!done) {
+      printf("error: no statistics received (is JWM running with stats?)\n");
+      CloseConnection();
+      return 1;
+   }
+
+   data = NULL;
+   if(JXGetWindowProperty(display, rootWindow, statsAtom, 0, LONG_MAX,
+                          False, utf8Atom, &realType, &realFormat,
+                          &count, &extra, &data) == Success && data) {
+      fwrite(data, 1, count, stdout);
+      JXFree(data);
+   }
+   CloseConnection();
+   return 0;
+}
+
 /** Send a JWM message to the root window. */
 void SendJWMMessage(const char *message)
 {
@@ -670,3 +1017,67 @@ void SendJWMMessage(const char *message)
    CloseConnection();
 }
 
+#ifdef USE_BENCH
+/** Run the rendering benchmark.
+ * This does not manage windows, so it can run alongside another window
+ * manager. The benchmark is repeated with XRender and MIT-SHM turned off
+ * when the server supports them so the results can be compared.
+ */
+int RunBenchmark(void)
+{
+#ifdef USE_XRENDER
+   int renderEvent;
+   int renderError;
+#endif
+   char renderAvailable = 0;
+   char shmAvailable = 0;
+   int variant;
+
+   OpenConnection();
+   JXSetErrorHandler(ErrorHandler);
+   InternAtoms();
+#ifdef USE_XRENDER
+   renderAvailable = JXRenderQueryExtension(display, &renderEvent,
+                                            &renderError);
+#endif
+
+   /* Bit 0 turns off XRender and bit 1 turns off MIT-SHM. */
+   for(variant = 0; variant < 4; variant++) {
+      if((variant & 1) && !renderAvailable) {
+         continue;
+      }
+      if((variant & 2) && !shmAvailable) {
+         continue;
+      }
+#ifdef USE_XRENDER
+      haveRender = renderAvailable && !(variant & 1);
+#endif
+
+      Initialize();
+      ParseConfig(configPath);
+      StartupSettings();
+      StartupColors();
+      StartupFonts();
+      StartupShm();
+#ifdef USE_SHM
+      if(variant == 0) {
+         shmAvailable = haveShm;
+      }
+      haveShm = haveShm && !(variant & 2);
+#endif
+      StartupIcons();
+
+      RunRenderBenchmark();
+
+      ShutdownIcons();
+      ShutdownGradients();
+      ShutdownFonts();
+      ShutdownColors();
+      ShutdownGCPool();
+      Destroy();
+   }
+
+   CloseConnection();
+   return 0;
+}
+#endif
@@ -20,7 +20,6 @@ extern int rootDepth;
 extern GC rootGC;
 extern int colormapCount;
 extern Window supportingWindow;
-extern Atom managerSelection;
 
 extern char *exitCommand;
 
@@ -29,13 +28,12 @@ extern unsigned int previousDesktop;
 
 extern char shouldExit;
 extern char shouldRestart;
+extern char shouldReexec;
 extern char isRestarting;
 extern char shouldReload;
+extern char shouldHotReload;
 extern char initializing;
 
-extern XContext clientContext;
-extern XContext frameContext;
-
 #ifdef USE_SHAPE
 extern char haveShape;
 extern int shapeEvent;
@@ -43,6 +41,18 @@ extern int shapeEvent;
 #ifdef USE_XRENDER
 extern char haveRender;
 #endif
+#ifdef USE_XSYNC
+extern char haveSync;
+extern int syncEvent;
+#endif
+#ifdef USE_XRANDR
+extern char haveRandR;
+extern int randrEvent;
+#endif
+#ifdef USE_XCOMPOSITE
+extern char haveComposite;
+extern int damageEvent;
+#endif
 
 extern char *configPath;
 
@@ -12,6 +12,28 @@
 
 #include <regex.h>
 
+/** How a compiled pattern is matched. */
+typedef unsigned char MatchMode;
+#define MATCH_REGEX     0  /**< Use the regex engine. */
+#define MATCH_CONTAINS  1  /**< Literal anywhere in the expression. */
+#define MATCH_PREFIX    2  /**< Literal at the start (^literal). */
+#define MATCH_SUFFIX    3  /**< Literal at the end (literal$). */
+#define MATCH_EXACT     4  /**< The whole expression (^literal$). */
+
+/** A compiled pattern. */
+typedef struct MatchPattern {
+   MatchMode mode;      /**< How to match. */
+   size_t length;       /**< Length of the literal. */
+   char *literal;       /**< The literal for the fast paths. */
+   regex_t re;          /**< The compiled expression for MATCH_REGEX. */
+} MatchPattern;
+
+/** Characters that make a pattern need the regex engine. */
+static const char METACHARS[] = ".[]()*+?{}|^$\\";
+
+static unsigned int CountAlternatives(const char *str, size_t length,
+                                      char anchors);
+
 /** Determine if expression matches pattern. */
 char Match(const char *pattern, const char *expression)
 {
@@ -38,3 +60,220 @@ char Match(const char *pattern, const char *expression)
 
 }
 
+/** Compile a pattern for repeated matching. */
+MatchPattern *CreateMatchPattern(const char *pattern)
+{
+
+   MatchPattern *mp;
+   const char *start;
+   size_t len;
+   char anchored;
+   char terminated;
+
+   Assert(pattern);
+
+   mp = Allocate(sizeof(MatchPattern));
+   mp->literal = NULL;
+
+   /* Check for a literal with optional anchors. */
+   anchored = pattern[0] == '^';
+   start = anchored ? &pattern[1] : pattern;
+   len = strcspn(start, METACHARS);
+   terminated = start[len] == '$' && start[len + 1] == 0;
+   if(start[len] == 0 || terminated) {
+      mp->literal = Allocate(len + 1);
+      memcpy(mp->literal, start, len);
+      mp->literal[len] = 0;
+      mp->length = len;
+      if(anchored && terminated) {
+         mp->mode = MATCH_EXACT;
+      } else if(anchored) {
+         mp->mode = MATCH_PREFIX;
+      } else if(terminated) {
+         mp->mode = MATCH_SUFFIX;
+      } else {
+         mp->mode = MATCH_CONTAINS;
+      }
+      return mp;
+   }
+
+   mp->mode = MATCH_REGEX;
+   if(regcomp(&mp->re, pattern, REG_EXTENDED | REG_NOSUB) != 0) {
+      Release(mp);
+      return NULL;
+   }
+   return mp;
+
+}
+
+/** Release a compiled pattern. */
+void DestroyMatchPattern(MatchPattern *mp)
+{
+   if(mp) {
+      if(mp->mode == MATCH_REGEX) {
+         regfree(&mp->re);
+      } else {
+         Release(mp->literal);
+      }
+      Release(mp);
+   }
+}
+
+/** Check if an expression matches a compiled pattern. */
+char MatchCompiled(const MatchPattern *mp, const char *expression)
+{
+
+   size_t len;
+
+   Assert(mp);
+
+   if(!expression) {
+      return 0;
+   }
+
+   switch(mp->mode) {
+   case MATCH_CONTAINS:
+      return strstr(expression, mp->literal) != NULL;
+   case MATCH_PREFIX:
+      return !strncmp(expression, mp->literal, mp->length);
+   case MATCH_SUFFIX:
+      len = strlen(expression);
+      return len >= mp->length
+          && !strcmp(&expression[len - mp->length], mp->literal);
+   case MATCH_EXACT:
+      return !strcmp(expression, mp->literal);
+   default:
+      return regexec(&mp->re, expression, 0, NULL, 0) == 0;
+   }
+
+}
+
+/** Get the literal matched by an exact pattern. */
+const char *GetExactMatch(const MatchPattern *mp)
+{
+   Assert(mp);
+   return mp->mode == MATCH_EXACT ? mp->literal : NULL;
+}
+
+/** Get a literal pattern that matches the same as a regular expression. */
+char *GetLiteralPattern(const char *pattern)
+{
+
+   const char *start;
+   const char *end;
+   char *result;
+   size_t len;
+   char anchored;
+   char terminated;
+   char stripped;
+
+   Assert(pattern);
+
+   start = pattern;
+   end = &pattern[strlen(pattern)];
+   anchored = 0;
+   terminated = 0;
+   stripped = 0;
+   if(start[0] == '^') {
+      anchored = 1;
+      start += 1;
+   }
+   if(!strncmp(start, ".*", 2)) {
+      anchored = 0;
+      stripped = 1;
+      start += 2;
+   }
+   if(end > start && end[-1] == '$') {
+      terminated = 1;
+      end -= 1;
+   }
+   if(end - start >= 2 && !strncmp(end - 2, ".*", 2)) {
+      terminated = 0;
+      stripped = 1;
+      end -= 2;
+   }
+
+   /* Without a wildcard to drop, the pattern is a literal already or
+    * needs the regex engine. */
+   len = end > start ? (size_t)(end - start) : 0;
+   if(!stripped || len == 0 || strcspn(start, METACHARS) < len) {
+      return NULL;
+   }
+
+   result = Allocate(len + 3);
+   len = 0;
+   if(anchored) {
+      result[len++] = '^';
+   }
+   memcpy(&result[len], start, end - start);
+   len += end - start;
+   if(terminated) {
+      result[len++] = '$';
+   }
+   result[len] = 0;
+   return result;
+
+}
+
+/** Count the literals of a pattern that is an alternation of literals. */
+unsigned int CountLiteralAlternatives(const char *pattern)
+{
+
+   const char *start;
+   const char *close;
+
+   Assert(pattern);
+
+   start = pattern[0] == '^' ? &pattern[1] : pattern;
+   if(start[0] != '(') {
+      return CountAlternatives(pattern, strlen(pattern), 1);
+   }
+
+   /* A group with optional anchors around it: ^(a|b)$ */
+   close = strchr(start, ')');
+   if(!close || !(close[1] == 0 || (close[1] == '$' && close[2] == 0))) {
+      return 0;
+   }
+   return CountAlternatives(&start[1], close - start - 1, 0);
+
+}
+
+/** Count literals separated by '|'.
+ * @param str The alternatives.
+ * @param length The length of str.
+ * @param anchors Set to allow each literal to be anchored.
+ * @return The number of literals (0 if not all are literals or there is
+ *         only one).
+ */
+unsigned int CountAlternatives(const char *str, size_t length, char anchors)
+{
+
+   const char *end = &str[length];
+   unsigned int count = 0;
+
+   for(;;) {
+      const char *next = memchr(str, '|', end - str);
+      const char *altEnd = next ? next : end;
+      const char *altStart = str;
+      if(anchors) {
+         if(altStart < altEnd && altStart[0] == '^') {
+            altStart += 1;
+         }
+         if(altEnd > altStart && altEnd[-1] == '$') {
+            altEnd -= 1;
+         }
+      }
+      if(  altEnd == altStart
+         || strcspn(altStart, METACHARS) < (size_t)(altEnd - altStart)) {
+         return 0;
+      }
+      count += 1;
+      if(!next) {
+         break;
+      }
+      str = next + 1;
+   }
+
+   return count > 1 ? count : 0;
+
+}
@@ -10,6 +10,8 @@
 #ifndef MATCH_H
 #define MATCH_H
 
+struct MatchPattern;
+
 /** Check if an expression matches a pattern.
  * @param pattern The pattern to match against.
  * @param expression The expression to check.
@@ -17,5 +19,47 @@
  */
 char Match(const char *pattern, const char *expression);
 
-#endif /* MATCH_H */
+/** Compile a pattern for repeated matching.
+ * @param pattern The pattern (an extended regular expression).
+ * @return The compiled pattern or NULL if the pattern is invalid.
+ */
+struct MatchPattern *CreateMatchPattern(const char *pattern);
+
+/** Release a compiled pattern.
+ * @param mp The compiled pattern (may be NULL).
+ */
+void DestroyMatchPattern(struct MatchPattern *mp);
+
+/** Check if an expression matches a compiled pattern.
+ * This gives the same result as Match with the original pattern.
+ * @param mp The compiled pattern.
+ * @param expression The expression to check.
+ * @return 1 if there is a match, 0 otherwise.
+ */
+char MatchCompiled(const struct MatchPattern *mp, const char *expression);
+
+/** Get the literal matched by an exact pattern.
+ * @param mp The compiled pattern.
+ * @return The literal if the pattern only matches that string (^literal$),
+ *         otherwise NULL.
+ */
+const char *GetExactMatch(const struct MatchPattern *mp);
+
+/** Get a literal pattern that matches the same as a regular expression.
+ * This drops a leading or trailing ".*" so that the pattern can be
+ * matched without the regex engine, for example ".*term.*" gives "term".
+ * @param pattern The pattern.
+ * @return The literal pattern, to be released, or NULL if the pattern is
+ *         a literal already or has no literal form.
+ */
+char *GetLiteralPattern(const char *pattern);
+
+/** Count the literals of a pattern that is an alternation of literals.
+ * Such a pattern, for example "^(xterm|urxvt)$", needs the regex engine
+ * but matches the same as one pattern for each literal.
+ * @param pattern The pattern.
+ * @return The number of literals (0 if the pattern is not of this form).
+ */
+unsigned int CountLiteralAlternatives(const char *pattern);
 
+#endif /* MATCH_H */
@@ -16,6 +16,7 @@
 #include "binding.h"
 #include "button.h"
 #include "event.h"
+#include "expose.h"
 #include "root.h"
 #include "settings.h"
 #include "desktop.h"
@@ -25,15 +26,57 @@
 #include "hint.h"
 #include "misc.h"
 #include "popup.h"
+#include "command.h"
+#include "render.h"
+#include "stats.h"
+#include "winpool.h"
 
 #define BASE_ICON_OFFSET   3
 #define MENU_BORDER_SIZE   1
 
+/** Maximum length of the type-ahead text. */
+#define MENU_SEARCH_SIZE   32
+
+/** Milliseconds between keys before the type-ahead text is cleared. */
+#define MENU_SEARCH_DELAY  1000
+
+/** Rows to draw before checking for input while rendering a menu. */
+#define MENU_DRAW_BATCH    32
+
 typedef unsigned char MenuSelectionType;
 #define MENU_NOSELECTION   0
 #define MENU_LEAVE         1
 #define MENU_SUBSELECT     2
 
+/** Cached output of a dynamic menu command. */
+typedef struct DynamicMenuNode {
+   char *command;                   /**< The command (with "exec:"). */
+   char *output;                    /**< The last output (or NULL). */
+   TimeType time;                   /**< When the output was read. */
+   char pending;                    /**< Set while the command runs. */
+   struct DynamicMenuNode *next;    /**< The next command. */
+} DynamicMenuNode;
+
+/** Menu item in the type-ahead index. */
+typedef struct MenuSearchEntry {
+   const char *name;                /**< The name of the item. */
+   int index;                       /**< The index of the item. */
+} MenuSearchEntry;
+
+static DynamicMenuNode *dynamicMenus = NULL;
+static Menu *openMenu = NULL;
+
+/** Text typed to find a menu item. */
+static char searchText[MENU_SEARCH_SIZE];
+static unsigned int searchLength = 0;
+static const Menu *searchMenu = NULL;
+static TimeType searchTime = ZERO_TIME;
+
+/** Generation of menu pixmaps.
+ * A rendered menu is reused until this changes.
+ */
+static unsigned int menuGeneration = 1;
+
 static char ShowSubmenu(Menu *menu, Menu *parent,
                         RunMenuCommandType runner,
                         int x, int y, char keyboard);
@@ -41,8 +84,16 @@ static char ShowSubmenu(Menu *menu, Menu *parent,
 static void PatchMenu(Menu *menu);
 static void UnpatchMenu(Menu *menu);
 static void MapMenu(Menu *menu, int x, int y, char keyboard);
+static void PlaceMenu(Menu *menu, int x, int y);
+static DynamicMenuNode *StartDynamicMenu(const char *command,
+                                         unsigned timeout_ms,
+                                         unsigned ttl_ms);
+static void DynamicMenuCallback(const char *output, void *data);
+static void ReloadShownMenu(Menu *menu, const DynamicMenuNode *np);
 static void HideMenu(Menu *menu);
 static void DrawMenu(Menu *menu);
+static void ContinueMenu(Menu *menu);
+static void ExposeMenu(Menu *menu, Region region);
 
 static char MenuLoop(Menu *menu, RunMenuCommandType runner);
 static void MenuCallback(const TimeType *now, int x, int y,
@@ -52,11 +103,18 @@ static MenuSelectionType UpdateMotion(Menu *menu,
                                       XEvent *event);
 
 static void UpdateMenu(Menu *menu);
+static void DrawMenuRow(Menu *menu, int index);
 static void DrawMenuItem(Menu *menu, MenuItem *item, int index);
 static MenuItem *GetMenuItem(Menu *menu, int index);
 static int GetNextMenuIndex(Menu *menu);
 static int GetPreviousMenuIndex(Menu *menu);
 static int GetMenuIndex(Menu *menu, int index);
+static int SearchMenu(Menu *menu, XKeyEvent *event);
+static int FindMenuPrefix(Menu *menu, size_t length, int start);
+static void BuildSearchIndex(Menu *menu);
+static void ReleaseSearchIndex(Menu *menu);
+static int CompareSearchEntries(const void *a, const void *b);
+static int CompareNoCase(const char *a, const char *b, size_t length);
 static void SetPosition(Menu *tp, int index);
 static char IsMenuValid(const Menu *menu);
 
@@ -70,7 +128,18 @@ Menu *CreateMenu()
    menu->items = NULL;
    menu->label = NULL;
    menu->dynamic = NULL;
+   menu->offsets = NULL;
+   menu->itemTable = NULL;
+   menu->search = NULL;
+   menu->searchCount = 0;
    menu->timeout_ms = MENU_TIMEOUT_MS;
+   menu->ttl_ms = 0;
+   menu->loading = 0;
+   menu->initialized = 0;
+   menu->pixmap = None;
+   menu->generation = 0;
+   menu->drawnIndex = -1;
+   menu->nextRow = -1;
    return menu;
 }
 
@@ -93,6 +162,8 @@ void InitializeMenu(Menu *menu)
    int hasSubmenu;
    char hasIcon;
 
+   Assert(!menu->initialized);
+   menu->initialized = 1;
    menu->textOffset = 0;
    menu->itemCount = 0;
 
@@ -105,7 +176,7 @@ void InitializeMenu(Menu *menu)
    menu->itemHeight = GetStringHeight(FONT_MENU);
    for(np = menu->items; np; np = np->next) {
       if(np->iconName) {
-         np->icon = LoadNamedIcon(np->iconName, 1, 1);
+         np->icon = LoadDeferredIcon(np->iconName, 1);
          if(np->icon) {
             hasIcon = 1;
          }
@@ -146,10 +217,12 @@ void InitializeMenu(Menu *menu)
    }
 
    menu->offsets = Allocate(sizeof(int) * menu->itemCount);
+   menu->itemTable = Allocate(sizeof(MenuItem*) * menu->itemCount);
 
    hasSubmenu = 0;
    index = 0;
    for(np = menu->items; np; np = np->next) {
+      menu->itemTable[index] = np;
       menu->offsets[index++] = menu->height;
       if(np->type == MENU_ITEM_SEPARATOR) {
          menu->height += 6;
@@ -167,7 +240,6 @@ void InitializeMenu(Menu *menu)
       }
       if(np->submenu) {
          hasSubmenu = (menu->itemHeight + 3) / 4;
-         InitializeMenu(np->submenu);
       }
    }
    menu->width += hasSubmenu + menu->textOffset;
@@ -193,6 +265,9 @@ char ShowMenu(Menu *menu, RunMenuCommandType runner,
    if(JUNLIKELY(shouldExit)) {
       return 0;
    }
+   if(!menu->initialized) {
+      InitializeMenu(menu);
+   }
 
    if(x < 0 && y < 0) {
       Window w;
@@ -210,6 +285,8 @@ char ShowMenu(Menu *menu, RunMenuCommandType runner,
       return 0;
    }
 
+   searchLength = 0;
+   searchMenu = NULL;
    RegisterCallback(settings.popupDelay, MenuCallback, menu);
    ShowSubmenu(menu, NULL, runner, x, y, keyboard);
    UnregisterCallback(MenuCallback, menu);
@@ -277,6 +354,13 @@ void DestroyMenu(Menu *menu)
       if(menu->offsets) {
          Release(menu->offsets);
       }
+      if(menu->itemTable) {
+         Release(menu->itemTable);
+      }
+      ReleaseSearchIndex(menu);
+      if(menu->pixmap != None) {
+         ReleaseMenuPixmaps(menu);
+      }
       Release(menu);
    }
 }
@@ -287,23 +371,66 @@ char ShowSubmenu(Menu *menu, Menu *parent,
                  int x, int y, char keyboard)
 {
 
+   Menu *lastOpen;
    char status;
 
+   if(!menu->initialized) {
+      InitializeMenu(menu);
+   }
    PatchMenu(menu);
    menu->parent = parent;
    MapMenu(menu, x, y, keyboard);
 
+   lastOpen = openMenu;
+   openMenu = menu;
    menuShown += 1;
    status = MenuLoop(menu, runner);
    menuShown -= 1;
-
-   JXDestroyWindow(display, menu->window);
-   JXFreePixmap(display, menu->pixmap);
+   openMenu = lastOpen;
+
+   /* The pixmap is kept so the menu need not be drawn next time
+    * unless saving memory. The window goes back to the pool. */
+   ReleasePoolWindow(menu->window);
+   menu->window = None;
+   if(settings.lowMemory) {
+      ReleaseMenuPixmaps(menu);
+   }
 
    return status;
 
 }
 
+/** Release the rendered pixmaps of a menu and its submenus. */
+void ReleaseMenuPixmaps(Menu *menu)
+{
+   MenuItem *ip;
+   if(menu->pixmap != None) {
+      ReleaseRenderTarget(menu->pixmap);
+      ReleaseFontTarget(menu->pixmap);
+      JXFreePixmap(display, menu->pixmap);
+      RecordPixmapStats(PIXMAP_MENU,
+                        -(long)GetPixmapSize(menu->width, menu->height,
+                                             rootDepth));
+      menu->pixmap = None;
+      menu->generation = 0;
+   }
+   for(ip = menu->items; ip; ip = ip->next) {
+      if(ip->submenu) {
+         ReleaseMenuPixmaps(ip->submenu);
+      }
+   }
+}
+
+/** Redraw the menus that are shown. */
+void RedrawMenus(void)
+{
+   Menu *mp;
+   menuGeneration += 1;
+   for(mp = openMenu; mp; mp = mp->parent) {
+      DrawMenu(mp);
+   }
+}
+
 /** Prepare a menu to be shown. */
 void PatchMenu(Menu *menu)
 {
@@ -325,9 +452,9 @@ void PatchMenu(Menu *menu)
          break;
       case MA_DYNAMIC:
          if(!item->submenu) {
-            submenu = ParseDynamicMenu(
-               item->action.timeout_ms,
-               item->action.str);
+            submenu = CreateDynamicMenu(item->action.str,
+                                        item->action.timeout_ms,
+                                        item->action.ttl_ms);
             if(JLIKELY(submenu)) {
                submenu->itemHeight = item->action.value;
             }
@@ -365,6 +492,233 @@ void UnpatchMenu(Menu *menu)
    }
 }
 
+/** Find the cache entry for a command and run it if it is stale. */
+DynamicMenuNode *StartDynamicMenu(const char *command, unsigned timeout_ms,
+                                  unsigned ttl_ms)
+{
+   DynamicMenuNode *np;
+   TimeType now;
+   char fresh;
+
+   for(np = dynamicMenus; np; np = np->next) {
+      if(!strcmp(np->command, command)) {
+         break;
+      }
+   }
+   if(!np) {
+      np = Allocate(sizeof(DynamicMenuNode));
+      np->command = CopyString(command);
+      np->output = NULL;
+      np->pending = 0;
+      np->next = dynamicMenus;
+      dynamicMenus = np;
+   }
+
+   GetCurrentTime(&now);
+   fresh = np->output && ttl_ms > 0
+         && GetTimeDifference(&np->time, &now) < ttl_ms;
+   if(!fresh && !np->pending) {
+      char *path = CopyString(&command[5]);
+      ExpandPath(&path);
+      np->pending = 1;
+      ReadFromProcessAsync(path, timeout_ms, DynamicMenuCallback, np);
+      Release(path);
+   }
+   return np;
+}
+
+/** Create a menu from a dynamic menu command. */
+Menu *CreateDynamicMenu(const char *command, unsigned timeout_ms,
+                        unsigned ttl_ms)
+{
+   DynamicMenuNode *np;
+   Menu *menu;
+
+   /* Only commands are read in the background. */
+   if(strncmp(command, "exec:", 5)) {
+      return ParseDynamicMenu(timeout_ms, command);
+   }
+
+   np = StartDynamicMenu(command, timeout_ms, ttl_ms);
+   menu = NULL;
+   if(np->output) {
+      menu = ParseDynamicMenuOutput(command, np->output);
+   }
+   if(!menu) {
+      menu = CreateMenu();
+      menu->items = CreateMenuItem(MENU_ITEM_NORMAL);
+      menu->items->name = CopyString(_("Loading..."));
+   }
+   if(np->pending) {
+      menu->loading = 1;
+      menu->dynamic = CopyString(command);
+   }
+   return menu;
+}
+
+/** Start reading the dynamic menus reachable from a menu. */
+void PrefetchDynamicMenus(const Menu *menu)
+{
+   const MenuItem *ip;
+
+   if(menu->dynamic && !strncmp(menu->dynamic, "exec:", 5)) {
+      StartDynamicMenu(menu->dynamic, menu->timeout_ms, menu->ttl_ms);
+   }
+   for(ip = menu->items; ip; ip = ip->next) {
+      if((ip->action.type & MA_ACTION_MASK) == MA_DYNAMIC) {
+         if(!strncmp(ip->action.str, "exec:", 5)) {
+            StartDynamicMenu(ip->action.str, ip->action.timeout_ms,
+                             ip->action.ttl_ms);
+         }
+      } else if(ip->submenu) {
+         PrefetchDynamicMenus(ip->submenu);
+      }
+   }
+}
+
+/** Release cached dynamic menu output. */
+void DestroyDynamicMenus(void)
+{
+   while(dynamicMenus) {
+      DynamicMenuNode *np = dynamicMenus->next;
+      if(dynamicMenus->pending) {
+         CancelReadFromProcess(DynamicMenuCallback, dynamicMenus);
+      }
+      if(dynamicMenus->output) {
+         Release(dynamicMenus->output);
+      }
+      Release(dynamicMenus->command);
+      Release(dynamicMenus);
+      dynamicMenus = np;
+   }
+}
+
+/** Receive the output of a dynamic menu command. */
+void DynamicMenuCallback(const char *output, void *data)
+{
+   DynamicMenuNode *np = (DynamicMenuNode*)data;
+   Menu *mp, *child;
+   MenuItem *ip;
+   char changed;
+
+   np->pending = 0;
+   changed = 0;
+   if(output) {
+      if(!np->output || strcmp(np->output, output)) {
+         if(np->output) {
+            Release(np->output);
+         }
+         np->output = CopyString(output);
+         changed = 1;
+      }
+      GetCurrentTime(&np->time);
+   }
+
+   /* Update open menus that are waiting for this command.
+    * Only the innermost open menu can be changed in place; submenus
+    * that are not shown are simply replaced. */
+   child = NULL;
+   for(mp = openMenu; mp; mp = mp->parent) {
+      if(mp == openMenu && mp->loading && !strcmp(mp->dynamic, np->command)) {
+         mp->loading = 0;
+         if(changed) {
+            ReloadShownMenu(mp, np);
+         }
+      }
+      for(ip = mp->items; ip; ip = ip->next) {
+         Menu *submenu = ip->submenu;
+         if(  submenu == NULL || submenu == child || !submenu->loading
+            || (ip->action.type & MA_ACTION_MASK) != MA_DYNAMIC
+            || strcmp(ip->action.str, np->command)) {
+            continue;
+         }
+         submenu->loading = 0;
+         if(changed) {
+            submenu = ParseDynamicMenuOutput(np->command, np->output);
+            if(JLIKELY(submenu)) {
+               submenu->itemHeight = ip->action.value;
+               InitializeMenu(submenu);
+               DestroyMenu(ip->submenu);
+               ip->submenu = submenu;
+            }
+         }
+      }
+      child = mp;
+   }
+}
+
+/** Replace the contents of a menu while it is shown. */
+void ReloadShownMenu(Menu *menu, const DynamicMenuNode *np)
+{
+   Menu *update;
+   MenuItem *items;
+   MenuItem **itemTable;
+   char *label;
+   int *offsets;
+   int x;
+
+   update = ParseDynamicMenuOutput(np->command, np->output);
+   if(JUNLIKELY(!update)) {
+      return;
+   }
+   if(menu->parent) {
+      for(items = menu->parent->items; items; items = items->next) {
+         if(items->submenu == menu) {
+            update->itemHeight = items->action.value;
+            break;
+         }
+      }
+   }
+   InitializeMenu(update);
+   PatchMenu(update);
+
+   /* Swap the contents so that the old items are released with update. */
+   items = menu->items;
+   menu->items = update->items;
+   update->items = items;
+   label = menu->label;
+   menu->label = update->label;
+   update->label = label;
+   offsets = menu->offsets;
+   menu->offsets = update->offsets;
+   update->offsets = offsets;
+   itemTable = menu->itemTable;
+   menu->itemTable = update->itemTable;
+   update->itemTable = itemTable;
+   ReleaseSearchIndex(menu);
+   menu->itemHeight = update->itemHeight;
+   menu->itemCount = update->itemCount;
+   menu->textOffset = update->textOffset;
+   ReleaseRenderTarget(menu->pixmap);
+   ReleaseFontTarget(menu->pixmap);
+   JXFreePixmap(display, menu->pixmap);
+   RecordPixmapStats(PIXMAP_MENU,
+                     -(long)GetPixmapSize(menu->width, menu->height,
+                                          rootDepth));
+   menu->generation = 0;
+   menu->width = update->width;
+   menu->height = update->height;
+   DestroyMenu(update);
+
+   if(menu->parent) {
+      x = menu->parent->x + menu->parent->width
+        - (settings.menuDecorations == DECO_MOTIF ? 0 : 1);
+   } else {
+      x = menu->x;
+   }
+   PlaceMenu(menu, x, menu->y + menu->parentOffset);
+   JXMoveResizeWindow(display, menu->window, menu->x, menu->y,
+                      menu->width, menu->height);
+   menu->pixmap = JXCreatePixmap(display, rootWindow,
+                                 menu->width, menu->height, rootDepth);
+   RecordPixmapStats(PIXMAP_MENU,
+                     (long)GetPixmapSize(menu->width, menu->height,
+                                         rootDepth));
+   menu->lastIndex = -1;
+   menu->currentIndex = -1;
+   DrawMenu(menu);
+}
+
 /** Menu process loop.
  * Returns 0 if no selection was made or 1 if a selection was made.
  */
@@ -373,6 +727,7 @@ char MenuLoop(Menu *menu, RunMenuCommandType runner)
 
    XEvent event;
    MenuItem *ip;
+   Menu *mp;
    Window pressw;
    int pressx, pressy;
    char hadMotion;
@@ -383,15 +738,22 @@ char MenuLoop(Menu *menu, RunMenuCommandType runner)
 
    for(;;) {
 
+      /* Finish rendering large menus while there is no input. */
+      for(mp = menu; mp; mp = mp->parent) {
+         if(mp->nextRow >= 0) {
+            ContinueMenu(mp);
+         }
+      }
+
       WaitForEvent(&event);
 
       switch(event.type) {
       case Expose:
          if(event.xexpose.count == 0) {
-            Menu *mp = menu;
+            mp = menu;
             while(mp) {
                if(mp->window == event.xexpose.window) {
-                  DrawMenu(mp);
+                  ExposeMenu(mp, GetExposeRegion(mp->window));
                   break;
                }
                mp = mp->parent;
@@ -528,15 +890,45 @@ void MenuCallback(const TimeType *now, int x, int y, Window w, void *data)
 /** Create and map a menu. */
 void MapMenu(Menu *menu, int x, int y, char keyboard)
 {
-   XSetWindowAttributes attr;
-   unsigned long attrMask;
-   int temp;
-
    if(menu->parent) {
       menu->screen = menu->parent->screen;
    } else {
       menu->screen = GetCurrentScreen(x, y);
    }
+   PlaceMenu(menu, x, y);
+   x = menu->x;
+   y = menu->y;
+
+   menu->window = AcquirePoolWindow(POOL_WINDOW_MENU, x, y,
+                                    menu->width, menu->height);
+   if(menu->pixmap == None) {
+      menu->pixmap = JXCreatePixmap(display, rootWindow,
+                                    menu->width, menu->height, rootDepth);
+      RecordPixmapStats(PIXMAP_MENU,
+                        (long)GetPixmapSize(menu->width, menu->height,
+                                            rootDepth));
+      menu->generation = 0;
+   }
+
+   JXMapRaised(display, menu->window);
+
+   if(keyboard && menu->itemCount != 0) {
+      const int y = menu->offsets[0] + menu->itemHeight / 2;
+      menu->lastIndex = 0;
+      menu->currentIndex = 0;
+      MoveMouse(menu->window, menu->itemHeight / 2, y);
+   } else {
+      menu->lastIndex = -1;
+      menu->currentIndex = -1;
+   }
+
+}
+
+/** Position a menu on its screen. */
+void PlaceMenu(Menu *menu, int x, int y)
+{
+   int temp;
+
    if(x + menu->width > menu->screen->x + menu->screen->width) {
       if(menu->parent) {
          x = menu->parent->x - menu->width;
@@ -555,53 +947,50 @@ void MapMenu(Menu *menu, int x, int y, char keyboard)
    menu->x = x;
    menu->y = y;
    menu->parentOffset = temp - y;
+}
 
-   attrMask = 0;
-
-   attrMask |= CWEventMask;
-   attr.event_mask = ExposureMask;
-
-   attrMask |= CWBackPixel;
-   attr.background_pixel = colors[COLOR_MENU_BG];
-
-   attrMask |= CWSaveUnder;
-   attr.save_under = True;
-
-   menu->window = JXCreateWindow(display, rootWindow, x, y,
-                                 menu->width, menu->height, 0,
-                                 CopyFromParent, InputOutput,
-                                 CopyFromParent, attrMask, &attr);
-   SetAtomAtom(menu->window, ATOM_NET_WM_WINDOW_TYPE,
-               ATOM_NET_WM_WINDOW_TYPE_MENU);
-   menu->pixmap = JXCreatePixmap(display, menu->window,
-                                 menu->width, menu->height, rootDepth);
-
-   if(settings.menuOpacity < UINT_MAX) {
-      SetCardinalAtom(menu->window, ATOM_NET_WM_WINDOW_OPACITY,
-                      settings.menuOpacity);
-   }
-
-   JXMapRaised(display, menu->window); 
-
-   if(keyboard && menu->itemCount != 0) {
-      const int y = menu->offsets[0] + menu->itemHeight / 2;
-      menu->lastIndex = 0;
-      menu->currentIndex = 0;
-      MoveMouse(menu->window, menu->itemHeight / 2, y);
+/** Redraw the exposed part of a menu.
+ * If the pixmap is current, only the exposed region is copied.
+ */
+void ExposeMenu(Menu *menu, Region region)
+{
+   if(  region && menu->generation == menuGeneration
+      && menu->drawnIndex == menu->currentIndex && menu->nextRow < 0) {
+      CopyExposedArea(menu->pixmap, menu->window, region,
+                      menu->width, menu->height);
    } else {
-      menu->lastIndex = -1;
-      menu->currentIndex = -1;
+      DrawMenu(menu);
    }
-
 }
 
-/** Draw a menu. */
+/** Draw a menu.
+ * The pixmap is only rendered in full the first time; after that only
+ * the rows whose selection changed are drawn.
+ */
 void DrawMenu(Menu *menu)
 {
 
-   MenuItem *np;
    int x;
 
+   if(menu->generation == menuGeneration) {
+      if(menu->drawnIndex != menu->currentIndex) {
+         x = menu->drawnIndex;
+         menu->drawnIndex = menu->currentIndex;
+         DrawMenuItem(menu, GetMenuItem(menu, x), x);
+         DrawMenuItem(menu, GetMenuItem(menu, menu->currentIndex),
+                      menu->currentIndex);
+      }
+      if(menu->nextRow >= 0) {
+         ContinueMenu(menu);
+      } else {
+         JXCopyArea(display, menu->pixmap, menu->window, rootGC,
+                    0, 0, menu->width, menu->height, 0, 0);
+      }
+      return;
+   }
+   menu->generation = menuGeneration;
+   menu->drawnIndex = menu->currentIndex;
+
    JXSetForeground(display, rootGC, colors[COLOR_MENU_BG]);
    JXFillRectangle(display, menu->pixmap, rootGC, 0, 0,
                    menu->width, menu->height);
@@ -628,14 +1017,34 @@ void DrawMenu(Menu *menu)
       DrawMenuItem(menu, NULL, -1);
    }
 
-   x = 0;
-   for(np = menu->items; np; np = np->next) {
-      DrawMenuItem(menu, np, x);
-      ++x;
+   menu->nextRow = 0;
+   ContinueMenu(menu);
+
+}
+
+/** Render the items of a menu that have not been drawn yet.
+ * Large menus are drawn a batch of rows at a time. If input arrives,
+ * the rows drawn so far are shown and the rest are drawn later so that
+ * the menu stays responsive.
+ */
+void ContinueMenu(Menu *menu)
+{
+   int height;
+
+   while(menu->nextRow < menu->itemCount) {
+      DrawMenuItem(menu, GetMenuItem(menu, menu->nextRow), menu->nextRow);
+      menu->nextRow += 1;
+      if(  menu->nextRow % MENU_DRAW_BATCH == 0
+         && menu->nextRow < menu->itemCount && JXPending(display) > 0) {
+         height = menu->offsets[menu->nextRow];
+         JXCopyArea(display, menu->pixmap, menu->window, rootGC,
+                    0, 0, menu->width, height, 0, 0);
+         return;
+      }
    }
+   menu->nextRow = -1;
    JXCopyArea(display, menu->pixmap, menu->window, rootGC,
               0, 0, menu->width, menu->height, 0, 0);
-
 }
 
 /** Determine the action to take given an event. */
@@ -721,6 +1130,7 @@ MenuSelectionType UpdateMotion(Menu *menu,
          }
          return MENU_SUBSELECT;
       default:
+         y = SearchMenu(tp, &event->xkey);
          break;
       }
 
@@ -813,25 +1223,30 @@ MenuSelectionType UpdateMotion(Menu *menu,
 
 }
 
-/** Update the menu selection. */
+/** Update the menu selection.
+ * Only the rows of the old and new selection are drawn and copied.
+ */
 void UpdateMenu(Menu *menu)
 {
-
-   MenuItem *ip;
-
-   /* Clear the old selection. */
-   ip = GetMenuItem(menu, menu->lastIndex);
-   DrawMenuItem(menu, ip, menu->lastIndex);
-
-   /* Highlight the new selection. */
-   ip = GetMenuItem(menu, menu->currentIndex);
-   if(ip != NULL) {
-      DrawMenuItem(menu, ip, menu->currentIndex);
+   const int last = menu->drawnIndex;
+   menu->drawnIndex = menu->currentIndex;
+   if(last != menu->currentIndex) {
+      DrawMenuRow(menu, last);
    }
+   DrawMenuRow(menu, menu->currentIndex);
+}
 
+/** Draw a menu item and copy its row to the menu window. */
+void DrawMenuRow(Menu *menu, int index)
+{
+   MenuItem *ip = GetMenuItem(menu, index);
+   if(ip == NULL) {
+      return;
+   }
+   DrawMenuItem(menu, ip, index);
    JXCopyArea(display, menu->pixmap, menu->window, rootGC,
-              0, 0, menu->width, menu->height, 0, 0);
-
+              0, menu->offsets[index], menu->width, menu->itemHeight,
+              0, menu->offsets[index]);
 }
 
 /** Draw a menu item. */
@@ -969,43 +1384,194 @@ int GetPreviousMenuIndex(Menu *menu)
    return menu->currentIndex;
 }
 
-/** Get the item in the menu given a y-coordinate. */
+/** Get the item in the menu given a y-coordinate.
+ * The offsets are increasing, so this looks for the last item that
+ * starts at or above y.
+ */
 int GetMenuIndex(Menu *menu, int y)
 {
 
-   int x;
+   int low, high;
 
-   if(y < menu->offsets[0]) {
+   if(menu->itemCount == 0 || y < menu->offsets[0]) {
       return -1;
    }
-   for(x = 0; x < menu->itemCount - 1; x++) {
-      if(y >= menu->offsets[x] && y < menu->offsets[x + 1]) {
-         return x;
+   low = 0;
+   high = menu->itemCount - 1;
+   while(low < high) {
+      const int mid = (low + high + 1) / 2;
+      if(menu->offsets[mid] <= y) {
+         low = mid;
+      } else {
+         high = mid - 1;
       }
    }
-   return x;
+   return low;
 
 }
 
 /** Get the menu item associated with an index. */
 MenuItem *GetMenuItem(Menu *menu, int index)
 {
+   if(index >= 0 && index < menu->itemCount) {
+      return menu->itemTable[index];
+   }
+   return NULL;
+}
 
-   MenuItem *ip;
+/** Add a key to the type-ahead text and find the item it selects.
+ * @return The index of the item to select (-1 for no change).
+ */
+int SearchMenu(Menu *menu, XKeyEvent *event)
+{
 
-   if(index >= 0) {
-      for(ip = menu->items; ip; ip = ip->next) {
-         if(!index) {
-            return ip;
-         }
-         --index;
+   TimeType now;
+   KeySym sym;
+   char buffer[8];
+   int length;
+   int index;
+   unsigned int x;
+
+   length = JXLookupString(event, buffer, sizeof(buffer), &sym, NULL);
+
+   GetCurrentTime(&now);
+   if(  menu != searchMenu
+      || GetTimeDifference(&now, &searchTime) > MENU_SEARCH_DELAY) {
+      searchLength = 0;
+   }
+   searchMenu = menu;
+   searchTime = now;
+
+   if(sym == XK_BackSpace) {
+      if(searchLength > 0) {
+         searchLength -= 1;
       }
-   } else {
-      ip = NULL;
+      return searchLength > 0 ? FindMenuPrefix(menu, searchLength,
+                                               menu->currentIndex) : -1;
    }
+   if(  length != 1 || (unsigned char)buffer[0] > 0x7E
+      || !isprint((unsigned char)buffer[0])
+      || (searchLength == 0 && buffer[0] == ' ')
+      || searchLength == MENU_SEARCH_SIZE) {
+      return -1;
+   }
+   searchText[searchLength++] = buffer[0];
+
+   /* Stay on the current item while it still matches. */
+   if(searchLength > 1) {
+      index = FindMenuPrefix(menu, searchLength, menu->currentIndex);
+      if(index >= 0) {
+         return index;
+      }
+   }
+
+   /* Typing the same letter again moves to the next item with it. */
+   for(x = 1; x < searchLength; x++) {
+      if(  tolower((unsigned char)searchText[x])
+         != tolower((unsigned char)searchText[0])) {
+         return -1;
+      }
+   }
+   searchLength = 1;
+   return FindMenuPrefix(menu, 1, menu->currentIndex + 1);
 
-   return ip;
+}
 
+/** Find the first item at or after start (wrapping) that begins with
+ * the type-ahead text.
+ * Matching items are next to each other in the search index, so they
+ * are found with a binary search.
+ * @return The index of the item (-1 if none match).
+ */
+int FindMenuPrefix(Menu *menu, size_t length, int start)
+{
+
+   unsigned int low, high;
+   int first, next;
+
+   if(menu->search == NULL) {
+      BuildSearchIndex(menu);
+   }
+
+   low = 0;
+   high = menu->searchCount;
+   while(low < high) {
+      const unsigned int mid = (low + high) / 2;
+      if(CompareNoCase(menu->search[mid].name, searchText, length) < 0) {
+         low = mid + 1;
+      } else {
+         high = mid;
+      }
+   }
+
+   first = -1;
+   next = -1;
+   while(  low < menu->searchCount
+         && !CompareNoCase(menu->search[low].name, searchText, length)) {
+      const int index = menu->search[low].index;
+      if(first < 0 || index < first) {
+         first = index;
+      }
+      if(index >= start && (next < 0 || index < next)) {
+         next = index;
+      }
+      low += 1;
+   }
+   return next >= 0 ? next : first;
+
+}
+
+/** Build the type-ahead index of a menu. */
+void BuildSearchIndex(Menu *menu)
+{
+   unsigned int x;
+   menu->search = Allocate(sizeof(MenuSearchEntry) * (menu->itemCount + 1));
+   menu->searchCount = 0;
+   for(x = 0; x < menu->itemCount; x++) {
+      const MenuItem *ip = menu->itemTable[x];
+      if(ip->name && ip->type != MENU_ITEM_SEPARATOR) {
+         menu->search[menu->searchCount].name = ip->name;
+         menu->search[menu->searchCount].index = x;
+         menu->searchCount += 1;
+      }
+   }
+   qsort(menu->search, menu->searchCount, sizeof(MenuSearchEntry),
+         CompareSearchEntries);
+}
+
+/** Release the type-ahead index of a menu. */
+void ReleaseSearchIndex(Menu *menu)
+{
+   if(menu->search) {
+      Release(menu->search);
+      menu->search = NULL;
+   }
+   menu->searchCount = 0;
+}
+
+/** Compare type-ahead entries by name and then by position. */
+int CompareSearchEntries(const void *a, const void *b)
+{
+   const MenuSearchEntry *ea = (const MenuSearchEntry*)a;
+   const MenuSearchEntry *eb = (const MenuSearchEntry*)b;
+   const int rc = CompareNoCase(ea->name, eb->name, (size_t)-1);
+   return rc ? rc : ea->index - eb->index;
+}
+
+/** Compare up to length characters ignoring case. */
+int CompareNoCase(const char *a, const char *b, size_t length)
+{
+   while(length > 0) {
+      const int ca = tolower((unsigned char)*a);
+      const int cb = tolower((unsigned char)*b);
+      if(ca != cb || ca == 0) {
+         return ca - cb;
+      }
+      a += 1;
+      b += 1;
+      length -= 1;
+   }
+   return 0;
 }
 
 /** Set the active menu item. */
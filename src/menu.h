@@ -13,6 +13,7 @@
 #include "timing.h"
 
 struct ScreenType;
+struct MenuSearchEntry;
 
 /** Enumeration of menu action types. */
 typedef unsigned char MenuActionType;
@@ -50,6 +51,7 @@ typedef struct MenuAction {
    char *str;
    unsigned value;
    unsigned timeout_ms;
+   unsigned ttl_ms;
 
    MenuActionType type;          /**< Type of action. */
 
@@ -86,11 +88,15 @@ typedef struct Menu {
    char *label;            /**< Menu label (NULL for no label). */
    char *dynamic;          /**< Generating command of dynamic menu. */
    unsigned timeout_ms;    /**< Timeout in milliseconds for dynamic menus. */
+   unsigned ttl_ms;        /**< Cache lifetime for dynamic menus. */
    int itemHeight;         /**< User-specified menu item height. */
 
    /* These fields are handled by menu.c */
    Window window;          /**< The menu window. */
    Pixmap pixmap;          /**< Pixmap where the menu is rendered. */
+   unsigned int generation;   /**< Generation of the pixmap contents. */
+   int drawnIndex;         /**< The selection shown in the pixmap. */
+   int nextRow;            /**< Next item to render (-1 when done). */
    int x;                  /**< The x-coordinate of the menu. */
    int y;                  /**< The y-coordinate of the menu. */
    int width;              /**< The width of the menu. */
@@ -101,10 +107,16 @@ typedef struct Menu {
    int parentOffset;       /**< y-offset of this menu wrt the parent. */
    int textOffset;         /**< x-offset of text in the menu. */
    int *offsets;           /**< y-offsets of menu items. */
+   struct MenuItem **itemTable;     /**< Menu items by index. */
+   struct MenuSearchEntry *search;  /**< Items sorted by name for
+                                     *   type-ahead (NULL until used). */
+   unsigned int searchCount;        /**< Number of entries in search. */
    struct Menu *parent;    /**< The parent menu (or NULL). */
    const struct ScreenType *screen;
    int mousex, mousey;
    TimeType lastTime;
+   char loading;           /**< Set while waiting for dynamic output. */
+   char initialized;       /**< Set once InitializeMenu has run. */
 
 } Menu;
 
@@ -117,10 +129,16 @@ Menu *CreateMenu();
 MenuItem *CreateMenuItem(MenuItemType type);
 
 /** Initialize a menu structure to be shown.
+ * Submenus are initialized when they are first shown.
  * @param menu The menu to initialize.
  */
 void InitializeMenu(Menu *menu);
 
+/** Release the rendered pixmaps of a menu and its submenus.
+ * @param menu The menu.
+ */
+void ReleaseMenuPixmaps(Menu *menu);
+
 /** Show a menu.
  * @param menu The menu to show.
  * @param runner Callback executed when an item is selected.
@@ -137,6 +155,33 @@ char ShowMenu(Menu *menu, RunMenuCommandType runner,
  */
 void DestroyMenu(Menu *menu);
 
+/** Create a menu from a dynamic menu command.
+ * Output from "exec:" commands is read in the background: the last
+ * output (or a placeholder) is returned immediately and the menu is
+ * updated in place while shown once the command completes.
+ * @param command The command ("exec:" or a file name).
+ * @param timeout_ms The timeout in milliseconds.
+ * @param ttl_ms How long to reuse output without running the command.
+ * @return The menu (NULL on error), to be released with DestroyMenu.
+ */
+Menu *CreateDynamicMenu(const char *command, unsigned timeout_ms,
+                        unsigned ttl_ms);
+
+/** Start reading the dynamic menus reachable from a menu.
+ * Only "exec:" commands are read; the output is cached for when the
+ * menus are shown.
+ * @param menu The menu.
+ */
+void PrefetchDynamicMenus(const Menu *menu);
+
+/** Release cached dynamic menu output and cancel pending commands. */
+void DestroyDynamicMenus(void);
+
+/** Redraw the menus that are shown.
+ * Menus that are not shown are redrawn the next time they are shown.
+ */
+void RedrawMenus(void);
+
 /** The number of open menus. */
 extern int menuShown;
 
@@ -0,0 +1,756 @@
+/**
+ * @file microbench.c
+ * @author Joe Wingbermuehle
+ * @date 2026
+ *
+ * @brief Micro-benchmarks for the paths that run without a display.
+ *
+ * This is built as jwm-bench by "make bench". It is linked with the
+ * JWM objects, but never connects to an X server. Each benchmark runs
+ * a fixed number of iterations so results can be compared across
+ * builds, and the results are printed as JSON.
+ *
+ */
+
+#include "jwm.h"
+#include "lex.h"
+#include "match.h"
+#include "group.h"
+#include "client.h"
+#include "clientlist.h"
+#include "color.h"
+#include "gradient.h"
+#include "icon.h"
+#include "image.h"
+#include "main.h"
+#include "move.h"
+#include "place.h"
+#include "render.h"
+#include "screen.h"
+#include "settings.h"
+#include "taskbar.h"
+#include "tray.h"
+#include "timing.h"
+#include "misc.h"
+
+/** Number of blocks in the generated configuration. */
+#define BENCH_CONFIG_BLOCKS   500
+
+/** Size of the buffer for one block of the configuration. */
+#define BENCH_BLOCK_SIZE      1024
+
+/** Number of groups for the group benchmark. */
+#define BENCH_GROUPS          400
+
+/** Number of clients for the window benchmarks. */
+#define BENCH_CLIENTS         500
+
+/** Number of desktops the clients are spread over. */
+#define BENCH_DESKTOPS        4
+
+/** Number of snapped moves in one drag. */
+#define BENCH_DRAG_STEPS      32
+
+/** Number of lines in the gradient benchmark. */
+#define BENCH_GRADIENT_LINES  1080
+
+/** Size of the source image for the icon scaling benchmarks. */
+#define BENCH_IMAGE_SIZE      128
+
+/** Size icons are scaled to (the size of a task bar icon). */
+#define BENCH_SCALED_SIZE     20
+
+/** A micro-benchmark. */
+typedef struct BenchType {
+   const char *name;          /**< The name in the output. */
+   unsigned int iterations;   /**< Number of iterations to time. */
+   void (*run)(void);         /**< Run one iteration. */
+} BenchType;
+
+/** One block of the generated configuration. */
+static const char CONFIG_BLOCK[] =
+   "<Group><Class>app%u</Class><Option>sticky</Option>"
+   "<Option>layer:above</Option></Group>\n"
+   "<Group><Name>^tool%u$</Name><Option>nolist</Option></Group>\n"
+   "<RootMenu onroot=\"%u\" label=\"Menu %u\">"
+   "<Program icon=\"terminal\" label=\"Terminal\">xterm -e top</Program>"
+   "<Menu label=\"Tools\"><Program label=\"Edit\">xedit</Program>"
+   "<Separator/><Restart label=\"Restart\"/></Menu></RootMenu>\n"
+   "<Key mask=\"4\" key=\"F%u\">desktop#</Key>\n"
+   "<Tray x=\"0\" y=\"-1\" height=\"%u\"><TrayButton label=\"%u\">"
+   "exec:xterm</TrayButton><TaskList maxwidth=\"256\"/><Clock/></Tray>\n"
+   "<!-- block %u -->\n";
+
+/** Patterns for the match benchmarks. */
+static const char *PATTERNS[] = {
+   "xterm",
+   "^Firefox$",
+   "^(xterm|rxvt|urxvt)$",
+   ".*[Tt]erm.*",
+   "^app[0-9]+$",
+   "Navigator",
+   "^.*chrom(e|ium)$",
+   "[Gg]imp"
+};
+
+/** Names for the match and group benchmarks. */
+static const char *NAMES[] = {
+   "xterm",
+   "Firefox",
+   "urxvt",
+   "gnome-terminal",
+   "app42",
+   "tool7",
+   "chromium",
+   "Gimp-2.10",
+   "Navigator",
+   "XClock"
+};
+
+static void RunTokenize(void);
+static void RunSerializeTokens(void);
+static void RunDeserializeTokens(void);
+static void RunMatch(void);
+static void RunMatchCompiled(void);
+static void RunCompilePattern(void);
+static void RunApplyGroups(void);
+static void RunTileClient(void);
+static void RunSnapBorder(void);
+static void RunRestackClients(void);
+static void RunUpdateTaskBar(void);
+static void RunGradientPixels(void);
+#ifdef USE_ICONS
+static void RunCreateIconFromBinary(void);
+static void RunScaleColorImage(void);
+#endif
+#if defined(USE_ICONS) && defined(USE_XRENDER)
+static void RunConvertRenderImage(void);
+#endif
+
+/** The benchmarks in the order they are run. */
+static const BenchType BENCHMARKS[] = {
+   { "tokenize",                 50,      RunTokenize                },
+   { "serialize_tokens",         200,     RunSerializeTokens         },
+   { "deserialize_tokens",       200,     RunDeserializeTokens       },
+   { "match",                    500,     RunMatch                   },
+   { "match_compiled",           20000,   RunMatchCompiled           },
+   { "compile_pattern",          2000,    RunCompilePattern          },
+   { "apply_groups",             500,     RunApplyGroups             },
+   { "tile_client",              50,      RunTileClient              },
+   { "snap_border",              2000,    RunSnapBorder              },
+   { "restack_clients",          5000,    RunRestackClients          },
+   { "update_task_bar",          5000,    RunUpdateTaskBar           },
+   { "gradient_pixels",          5000,    RunGradientPixels          },
+#ifdef USE_ICONS
+   { "create_icon_from_binary",  2000,    RunCreateIconFromBinary    },
+   { "scale_color_image",        5000,    RunScaleColorImage         },
+#endif
+#if defined(USE_ICONS) && defined(USE_XRENDER)
+   { "convert_render_image",     5000,    RunConvertRenderImage      },
+#endif
+};
+
+static char *configText;
+static TokenNode *configTokens;
+static char *serialData;
+static size_t serialSize;
+static struct MatchPattern *compiledPatterns[ARRAY_LENGTH(PATTERNS)];
+static ClientNode benchClients[ARRAY_LENGTH(NAMES)];
+static ClientNode *windowClients;
+static ClientNode movingClient;
+static Window *stackOrder;
+static Window *lastStackOrder;
+static unsigned int lastStackCount;
+static char *stackKeep;
+static unsigned int raiseIndex;
+static unsigned int activeIndex;
+static TrayComponentType *taskBar;
+static Visual benchVisual;
+static unsigned long gradientPixels[BENCH_GRADIENT_LINES];
+#ifdef USE_ICONS
+static IconNode *windowIcon;
+static ImageNode *sourceImage;
+static XImage scaledImage;
+static XImage scaledMask;
+#endif
+#if defined(USE_ICONS) && defined(USE_XRENDER)
+static XImage renderImage;
+#endif
+#ifdef USE_ICONS
+static unsigned long *iconData;
+static unsigned int iconLength;
+#endif
+
+/** Results that are kept so the compiler cannot drop the work. */
+static volatile unsigned long benchSink;
+
+static void SetupBenchmarks(void);
+static void TeardownBenchmarks(void);
+static void CreateConfig(void);
+static void CreateGroups(void);
+static void CreateWindows(void);
+static void DestroyWindows(void);
+static void CreateVisual(void);
+#ifdef USE_ICONS
+static void CreateIconData(void);
+static void CreateImages(void);
+static void DestroyImages(void);
+#endif
+static void RunBenchmark(const BenchType *bp, char last);
+
+/** The entry point for jwm-bench. */
+int main(void)
+{
+   unsigned int x;
+
+   StartDebug();
+   SetupBenchmarks();
+
+   printf("{\n");
+   printf("  \"version\": \"%s\",\n", PACKAGE_VERSION);
+   printf("  \"benchmarks\": [\n");
+   for(x = 0; x < ARRAY_LENGTH(BENCHMARKS); x++) {
+      RunBenchmark(&BENCHMARKS[x], x + 1 == ARRAY_LENGTH(BENCHMARKS));
+   }
+   printf("  ]\n");
+   printf("}\n");
+
+   TeardownBenchmarks();
+   StopDebug();
+   return 0;
+}
+
+/** Time a benchmark and print the result. */
+void RunBenchmark(const BenchType *bp, char last)
+{
+   unsigned long long start, elapsed;
+   unsigned int x;
+
+   /* Run once first so allocations and caches are warm. */
+   (bp->run)();
+
+   start = GetMonotonicTime();
+   for(x = 0; x < bp->iterations; x++) {
+      (bp->run)();
+   }
+   elapsed = GetMonotonicTime() - start;
+
+   printf("    { \"name\": \"%s\", \"iterations\": %u,"
+          " \"total_us\": %llu, \"ns_per_iteration\": %llu }%s\n",
+          bp->name, bp->iterations, elapsed,
+          elapsed * 1000ULL / bp->iterations, last ? "" : ",");
+}
+
+/** Create the data used by the benchmarks. */
+void SetupBenchmarks(void)
+{
+   unsigned int x;
+
+   CreateConfig();
+   configTokens = Tokenize(configText, "microbench");
+   serialData = SerializeTokens(configTokens, &serialSize);
+
+   for(x = 0; x < ARRAY_LENGTH(PATTERNS); x++) {
+      compiledPatterns[x] = CreateMatchPattern(PATTERNS[x]);
+   }
+
+   CreateGroups();
+   for(x = 0; x < ARRAY_LENGTH(NAMES); x++) {
+      memset(&benchClients[x], 0, sizeof(ClientNode));
+      benchClients[x].className = CopyString(NAMES[x]);
+      benchClients[x].instanceName = CopyString(NAMES[x]);
+   }
+
+   CreateVisual();
+
+#ifdef USE_ICONS
+   InitializeIcons();
+   CreateIconData();
+   CreateImages();
+#endif
+
+   CreateWindows();
+}
+
+/** Release the data used by the benchmarks. */
+void TeardownBenchmarks(void)
+{
+   unsigned int x;
+
+   DestroyWindows();
+
+#ifdef USE_ICONS
+   DestroyImages();
+   Release(iconData);
+   DestroyIcons();
+#endif
+
+   ShutdownColors();
+   DestroyColors();
+
+   for(x = 0; x < ARRAY_LENGTH(NAMES); x++) {
+      Release(benchClients[x].className);
+      Release(benchClients[x].instanceName);
+   }
+   ShutdownGroups();
+   DestroyGroups();
+
+   for(x = 0; x < ARRAY_LENGTH(PATTERNS); x++) {
+      DestroyMatchPattern(compiledPatterns[x]);
+   }
+
+   Release(serialData);
+   ReleaseTokens(configTokens);
+   Release(configText);
+}
+
+/** Generate a large configuration. */
+void CreateConfig(void)
+{
+   static const char HEADER[] = "<?xml version=\"1.0\"?>\n<JWM>\n";
+   static const char FOOTER[] = "</JWM>\n";
+   char block[BENCH_BLOCK_SIZE];
+   size_t len;
+   unsigned int x;
+
+   configText = Allocate(sizeof(HEADER) + sizeof(FOOTER)
+                         + BENCH_CONFIG_BLOCKS * BENCH_BLOCK_SIZE);
+   memcpy(configText, HEADER, sizeof(HEADER));
+   len = sizeof(HEADER) - 1;
+   for(x = 0; x < BENCH_CONFIG_BLOCKS; x++) {
+      const int count = snprintf(block, sizeof(block), CONFIG_BLOCK,
+                                 x, x, x % 3 + 1, x, x % 12 + 1,
+                                 x % 16 + 24, x, x);
+      memcpy(&configText[len], block, count);
+      len += count;
+   }
+   memcpy(&configText[len], FOOTER, sizeof(FOOTER));
+}
+
+/** Create groups matched by class, by name, and by expression. */
+void CreateGroups(void)
+{
+   char pattern[32];
+   unsigned int x;
+
+   for(x = 0; x < BENCH_GROUPS; x++) {
+      struct GroupType *gp = CreateGroup();
+      switch(x % 4) {
+      case 0:
+         snprintf(pattern, sizeof(pattern), "app%u", x);
+         AddGroupClass(gp, pattern);
+         AddGroupOption(gp, OPTION_STICKY);
+         break;
+      case 1:
+         snprintf(pattern, sizeof(pattern), "tool%u", x % 10);
+         AddGroupName(gp, pattern);
+         AddGroupOption(gp, OPTION_NOLIST);
+         break;
+      case 2:
+         snprintf(pattern, sizeof(pattern), "^(x|u)?term%u$", x);
+         AddGroupClass(gp, pattern);
+         AddGroupOptionUnsigned(gp, OPTION_LAYER, LAYER_ABOVE);
+         break;
+      default:
+         snprintf(pattern, sizeof(pattern), ".*[Tt]erm.*%u", x);
+         AddGroupName(gp, pattern);
+         AddGroupOption(gp, OPTION_NOPAGER);
+         break;
+      }
+   }
+   StartupGroups();
+}
+
+/** Create clients spread over the desktops and add them to a task bar.
+ * Clients on other desktops are hidden, as they would be by JWM.
+ */
+void CreateWindows(void)
+{
+   char name[32];
+   unsigned long seed;
+   unsigned int x;
+
+   /* Set the sizes that normally come from the display and fonts. */
+   InitializeSettings();
+   StartupSettings();
+   settings.titleHeight = 20;
+   rootWidth = 1920;
+   rootHeight = 1080;
+   currentDesktop = 0;
+   StartupScreens();
+
+   InitializeTaskBar();
+   HoldNetClientList(1);
+   taskBar = CreateTaskBar();
+   taskBar->width = rootWidth;
+   taskBar->height = 24;
+
+   /* The default icon needs a display, so clients share their own. */
+#ifdef USE_ICONS
+   windowIcon = CreateIconFromBinary(iconData, iconLength);
+#endif
+
+   windowClients = Allocate(sizeof(ClientNode) * BENCH_CLIENTS);
+   memset(windowClients, 0, sizeof(ClientNode) * BENCH_CLIENTS);
+   seed = 1;
+   for(x = 0; x < BENCH_CLIENTS; x++) {
+      ClientNode *np = &windowClients[x];
+      seed = (seed * 1103515245UL + 12345UL) & 0x7FFFFFFFUL;
+      np->window = 0x200000 + x * 2;
+      np->parent = np->window + 1;
+      np->owner = None;
+      np->width = 160 + (int)(seed % 481);
+      np->height = 120 + (int)((seed >> 9) % 361);
+      np->x = (int)((seed >> 3) % (rootWidth - np->width));
+      np->y = 20 + (int)((seed >> 13) % (rootHeight - np->height - 40));
+      np->maxWidth = rootWidth;
+      np->maxHeight = rootHeight;
+      np->xinc = 1;
+      np->yinc = 1;
+      np->state.status = STAT_MAPPED;
+      np->state.desktop = x % BENCH_DESKTOPS;
+      if(np->state.desktop != currentDesktop) {
+         np->state.status |= STAT_HIDDEN;
+      }
+      np->state.layer = LAYER_NORMAL;
+      np->state.border = BORDER_OUTLINE | BORDER_TITLE;
+      snprintf(name, sizeof(name), "window %u", x);
+      np->name = CopyString(name);
+      np->className = CopyString(NAMES[x % ARRAY_LENGTH(NAMES)]);
+#ifdef USE_ICONS
+      np->icon = windowIcon;
+#endif
+
+      np->prev = nodeTail[LAYER_NORMAL];
+      np->next = NULL;
+      if(nodeTail[LAYER_NORMAL]) {
+         nodeTail[LAYER_NORMAL]->next = np;
+      } else {
+         nodes[LAYER_NORMAL] = np;
+      }
+      nodeTail[LAYER_NORMAL] = np;
+      clientCount += 1;
+      AddClientToTaskBar(np);
+   }
+
+   /* The client that is placed and dragged. */
+   memset(&movingClient, 0, sizeof(movingClient));
+   movingClient.owner = None;
+   movingClient.maxWidth = rootWidth;
+   movingClient.maxHeight = rootHeight;
+   movingClient.xinc = 1;
+   movingClient.yinc = 1;
+   movingClient.state.status = STAT_MAPPED;
+   movingClient.state.layer = LAYER_NORMAL;
+   movingClient.state.border = BORDER_OUTLINE | BORDER_TITLE;
+
+   stackOrder = Allocate(sizeof(Window) * (clientCount + 1));
+   lastStackOrder = Allocate(sizeof(Window) * (clientCount + 1));
+   stackKeep = Allocate(clientCount + 1);
+   lastStackCount = GetStackOrder(lastStackOrder);
+   raiseIndex = 0;
+   activeIndex = 0;
+   windowClients[activeIndex].state.status |= STAT_ACTIVE;
+}
+
+/** Release the clients. */
+void DestroyWindows(void)
+{
+   unsigned int x;
+
+   DestroySnapIndex();
+   Release(stackKeep);
+   Release(lastStackOrder);
+   Release(stackOrder);
+
+   for(x = 0; x < BENCH_CLIENTS; x++) {
+      RemoveClientFromTaskBar(&windowClients[x]);
+      Release(windowClients[x].name);
+      Release(windowClients[x].className);
+   }
+   Release(windowClients);
+#ifdef USE_ICONS
+   DestroyIcon(windowIcon);
+#endif
+   nodes[LAYER_NORMAL] = NULL;
+   nodeTail[LAYER_NORMAL] = NULL;
+   clientCount = 0;
+
+   /* The client list is left held since publishing it needs a display. */
+   DestroyTaskBar();
+   Release(taskBar);
+   ShutdownScreens();
+}
+
+/** Set up a 24-bit TrueColor visual so colors need no server. */
+void CreateVisual(void)
+{
+   memset(&benchVisual, 0, sizeof(benchVisual));
+   benchVisual.class = TrueColor;
+   benchVisual.red_mask = 0xFF0000;
+   benchVisual.green_mask = 0x00FF00;
+   benchVisual.blue_mask = 0x0000FF;
+   benchVisual.bits_per_rgb = 8;
+   rootVisual = &benchVisual;
+   rootDepth = 24;
+   InitializeColors();
+   StartupColors();
+}
+
+#ifdef USE_ICONS
+/** Create _NET_WM_ICON data with the sizes applications usually set. */
+void CreateIconData(void)
+{
+   static const unsigned int SIZES[] = { 16, 24, 32, 48, 64, 128 };
+   unsigned int offset;
+   unsigned int x, i;
+
+   iconLength = 0;
+   for(x = 0; x < ARRAY_LENGTH(SIZES); x++) {
+      iconLength += SIZES[x] * SIZES[x] + 2;
+   }
+   iconData = Allocate(sizeof(unsigned long) * iconLength);
+
+   offset = 0;
+   for(x = 0; x < ARRAY_LENGTH(SIZES); x++) {
+      const unsigned int pixels = SIZES[x] * SIZES[x];
+      iconData[offset++] = SIZES[x];
+      iconData[offset++] = SIZES[x];
+      for(i = 0; i < pixels; i++) {
+         iconData[offset++] = 0xFF000000UL | ((i * 2654435761UL) & 0xFFFFFF);
+      }
+   }
+}
+#endif
+
+#ifdef USE_ICONS
+/** Create the source image and the client-side images to scale into. */
+void CreateImages(void)
+{
+   const unsigned int pixels = BENCH_IMAGE_SIZE * BENCH_IMAGE_SIZE;
+   unsigned int i;
+
+   sourceImage = CreateImage(BENCH_IMAGE_SIZE, BENCH_IMAGE_SIZE, 0);
+   for(i = 0; i < pixels; i++) {
+      const unsigned long value = i * 2654435761UL;
+      sourceImage->data[i * 4 + 0] = (i % 7) ? 255 : (unsigned char)value;
+      sourceImage->data[i * 4 + 1] = (unsigned char)(value >> 8);
+      sourceImage->data[i * 4 + 2] = (unsigned char)(value >> 16);
+      sourceImage->data[i * 4 + 3] = (unsigned char)(value >> 24);
+   }
+
+   memset(&scaledImage, 0, sizeof(scaledImage));
+   scaledImage.width = BENCH_SCALED_SIZE;
+   scaledImage.height = BENCH_SCALED_SIZE;
+   scaledImage.bits_per_pixel = 32;
+   scaledImage.bytes_per_line = BENCH_SCALED_SIZE * 4;
+   scaledImage.data = Allocate(scaledImage.bytes_per_line
+                               * BENCH_SCALED_SIZE);
+
+   memset(&scaledMask, 0, sizeof(scaledMask));
+   scaledMask.width = BENCH_SCALED_SIZE;
+   scaledMask.height = BENCH_SCALED_SIZE;
+   scaledMask.bits_per_pixel = 1;
+   scaledMask.bytes_per_line = (BENCH_SCALED_SIZE + 7) / 8;
+   scaledMask.data = Allocate(scaledMask.bytes_per_line
+                              * BENCH_SCALED_SIZE);
+
+#ifdef USE_XRENDER
+   memset(&renderImage, 0, sizeof(renderImage));
+   renderImage.width = BENCH_IMAGE_SIZE;
+   renderImage.height = BENCH_IMAGE_SIZE;
+   renderImage.bits_per_pixel = 32;
+   renderImage.bytes_per_line = BENCH_IMAGE_SIZE * 4;
+   renderImage.byte_order = LSBFirst;
+   renderImage.data = Allocate(renderImage.bytes_per_line
+                               * BENCH_IMAGE_SIZE);
+#endif
+}
+
+/** Release the images. */
+void DestroyImages(void)
+{
+#ifdef USE_XRENDER
+   Release(renderImage.data);
+#endif
+   Release(scaledMask.data);
+   Release(scaledImage.data);
+   DestroyImage(sourceImage);
+}
+#endif
+
+/** Tokenize the generated configuration. */
+void RunTokenize(void)
+{
+   TokenNode *tokens = Tokenize(configText, "microbench");
+   ReleaseTokens(tokens);
+}
+
+/** Serialize the tokens of the configuration (for the config cache). */
+void RunSerializeTokens(void)
+{
+   size_t size;
+   char *data = SerializeTokens(configTokens, &size);
+   benchSink += size;
+   Release(data);
+}
+
+/** Rebuild the tokens of the configuration from the config cache. */
+void RunDeserializeTokens(void)
+{
+   TokenNode *tokens = DeserializeTokens(serialData, serialSize,
+                                         "microbench");
+   ReleaseTokens(tokens);
+}
+
+/** Match each name against each pattern. */
+void RunMatch(void)
+{
+   unsigned int p, n;
+   for(p = 0; p < ARRAY_LENGTH(PATTERNS); p++) {
+      for(n = 0; n < ARRAY_LENGTH(NAMES); n++) {
+         benchSink += Match(PATTERNS[p], NAMES[n]);
+      }
+   }
+}
+
+/** Match each name against each compiled pattern. */
+void RunMatchCompiled(void)
+{
+   unsigned int p, n;
+   for(p = 0; p < ARRAY_LENGTH(PATTERNS); p++) {
+      for(n = 0; n < ARRAY_LENGTH(NAMES); n++) {
+         benchSink += MatchCompiled(compiledPatterns[p], NAMES[n]);
+      }
+   }
+}
+
+/** Compile and release each pattern. */
+void RunCompilePattern(void)
+{
+   unsigned int p;
+   for(p = 0; p < ARRAY_LENGTH(PATTERNS); p++) {
+      DestroyMatchPattern(CreateMatchPattern(PATTERNS[p]));
+   }
+}
+
+/** Apply the groups to each client. */
+void RunApplyGroups(void)
+{
+   unsigned int x;
+   for(x = 0; x < ARRAY_LENGTH(NAMES); x++) {
+      benchClients[x].state.status = STAT_NONE;
+      ApplyGroups(&benchClients[x]);
+      benchSink += benchClients[x].state.status;
+   }
+}
+
+/** Place a client with the fewest overlaps among the visible clients. */
+void RunTileClient(void)
+{
+   BoundingBox box;
+
+   box.x = 0;
+   box.y = 0;
+   box.width = rootWidth;
+   box.height = rootHeight;
+   movingClient.x = 0;
+   movingClient.y = 0;
+   movingClient.width = 320;
+   movingClient.height = 240;
+   benchSink += TileClient(&box, &movingClient);
+   benchSink += movingClient.x + movingClient.y;
+}
+
+/** Drag a client across the screen, snapping to the other clients. */
+void RunSnapBorder(void)
+{
+   unsigned int x;
+
+   movingClient.width = 320;
+   movingClient.height = 240;
+   for(x = 0; x < BENCH_DRAG_STEPS; x++) {
+      movingClient.x = 40 + x * 53;
+      movingClient.y = 30 + x * 23;
+      DoSnapBorder(&movingClient);
+      benchSink += movingClient.x + movingClient.y;
+   }
+   DestroySnapIndex();
+}
+
+/** Raise a client and work out how to restack the windows. */
+void RunRestackClients(void)
+{
+   ClientNode *np;
+   Window *temp;
+   unsigned int count;
+
+   /* Move a client to the top of its layer (as RaiseClient does). */
+   np = &windowClients[raiseIndex];
+   raiseIndex = (raiseIndex + 7 * BENCH_DESKTOPS) % BENCH_CLIENTS;
+   if(np->prev) {
+      np->prev->next = np->next;
+      if(np->next) {
+         np->next->prev = np->prev;
+      } else {
+         nodeTail[LAYER_NORMAL] = np->prev;
+      }
+      np->prev = NULL;
+      np->next = nodes[LAYER_NORMAL];
+      nodes[LAYER_NORMAL]->prev = np;
+      nodes[LAYER_NORMAL] = np;
+   }
+
+   count = GetStackOrder(stackOrder);
+   benchSink += GetStackMoves(lastStackOrder, lastStackCount,
+                              stackOrder, count, stackKeep);
+
+   temp = lastStackOrder;
+   lastStackOrder = stackOrder;
+   stackOrder = temp;
+   lastStackCount = count;
+}
+
+/** Move the focus and work out which task bar items must be drawn. */
+void RunUpdateTaskBar(void)
+{
+   windowClients[activeIndex].state.status &= ~STAT_ACTIVE;
+   activeIndex = (activeIndex + BENCH_DESKTOPS) % BENCH_CLIENTS;
+   windowClients[activeIndex].state.status |= STAT_ACTIVE;
+   benchSink += UpdateTaskBarSlots(taskBar);
+}
+
+/** Compute the colors of each line of a screen-high gradient. */
+void RunGradientPixels(void)
+{
+   GetGradientPixels(0x203040, 0xE0D0C0, BENCH_GRADIENT_LINES,
+                     gradientPixels);
+   benchSink += gradientPixels[BENCH_GRADIENT_LINES / 2];
+}
+
+#ifdef USE_ICONS
+/** Decode the _NET_WM_ICON data. */
+void RunCreateIconFromBinary(void)
+{
+   IconNode *icon = CreateIconFromBinary(iconData, iconLength);
+   benchSink += icon->width;
+   DestroyIcon(icon);
+}
+
+/** Scale an image down to a task bar icon (as GetScaledIcon does). */
+void RunScaleColorImage(void)
+{
+   memset(scaledMask.data, 0, scaledMask.bytes_per_line * BENCH_SCALED_SIZE);
+   ScaleColorImage(sourceImage, &scaledImage, &scaledMask);
+   benchSink += (unsigned char)scaledMask.data[0];
+}
+#endif
+
+#if defined(USE_ICONS) && defined(USE_XRENDER)
+/** Convert an image for upload (as CreateScaledRenderIcon does). */
+void RunConvertRenderImage(void)
+{
+   ConvertRenderImage(sourceImage, 0, &renderImage);
+   benchSink += (unsigned char)renderImage.data[0];
+}
+#endif
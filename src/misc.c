@@ -11,6 +11,9 @@
 #include "misc.h"
 #include "debug.h"
 
+/** Allocation granularity for strings that are replaced in place. */
+#define STRING_BLOCK_SIZE 32
+
 static char ToLower(char ch);
 static char IsSymbolic(char ch);
 static char *GetSymbolName(const char *str);
@@ -225,6 +228,35 @@ char *CopyString(const char *str)
 
 }
 
+/** Replace a string, reusing its buffer when it is large enough. */
+char ReplaceString(char **dest, unsigned int *size,
+                   const char *value, size_t length)
+{
+   if(!value) {
+      if(!*dest) {
+         return 0;
+      }
+      Release(*dest);
+      *dest = NULL;
+      *size = 0;
+      return 1;
+   }
+   if(  *dest && strlen(*dest) == length
+      && !memcmp(*dest, value, length)) {
+      return 0;
+   }
+   if(!*dest || length + 1 > *size) {
+      if(*dest) {
+         Release(*dest);
+      }
+      *size = (length + STRING_BLOCK_SIZE) & ~(STRING_BLOCK_SIZE - 1);
+      *dest = Allocate(*size);
+   }
+   memcpy(*dest, value, length);
+   (*dest)[length] = 0;
+   return 1;
+}
+
 /** Parse a float. */
 float ParseFloat(const char *str)
 {
@@ -281,3 +313,49 @@ int StrCmpNoCase(const char *a, const char *b)
    }
    return *b - *a;
 }
+
+/** Estimate the server memory used by a pixmap. */
+size_t GetPixmapSize(unsigned int width, unsigned int height,
+                     unsigned int depth)
+{
+   if(depth == 1) {
+      return (size_t)((width + 7) / 8) * height;
+   } else if(depth <= 8) {
+      return (size_t)width * height;
+   } else if(depth <= 16) {
+      return (size_t)width * height * 2;
+   } else {
+      return (size_t)width * height * 4;
+   }
+}
+
+/** Initialize an empty text buffer. */
+void InitializeTextBuffer(TextBuffer *buffer, size_t capacity)
+{
+   buffer->capacity = capacity;
+   buffer->length = 0;
+   buffer->data = Allocate(capacity);
+   buffer->data[0] = 0;
+}
+
+/** Append formatted text to a text buffer. */
+void AppendText(TextBuffer *buffer, const char *format, ...)
+{
+   va_list ap;
+   int len;
+
+   for(;;) {
+      const size_t avail = buffer->capacity - buffer->length;
+      va_start(ap, format);
+      len = vsnprintf(&buffer->data[buffer->length], avail, format, ap);
+      va_end(ap);
+      if(JUNLIKELY(len < 0)) {
+         return;
+      } else if((size_t)len < avail) {
+         buffer->length += len;
+         return;
+      }
+      buffer->capacity = buffer->capacity * 2 + len;
+      buffer->data = Reallocate(buffer->data, buffer->capacity);
+   }
+}
@@ -19,6 +19,13 @@ typedef struct {
     int value;
 } StringMappingType;
 
+/** Growable buffer for building text. */
+typedef struct TextBuffer {
+   char *data;          /**< The text (always nul-terminated). */
+   size_t length;       /**< Length of the text in bytes. */
+   size_t capacity;     /**< Size of the data in bytes. */
+} TextBuffer;
+
 /** Get the length of an array. */
 #define ARRAY_LENGTH( a ) (sizeof(a) / sizeof(a[0]))
 
@@ -51,6 +58,18 @@ void Trim(char *str);
  */
 char *CopyString(const char *str);
 
+/** Replace a string, reusing its buffer when it is large enough.
+ * Buffers are allocated in blocks so that strings which change length
+ * slightly (such as window titles) keep the same buffer.
+ * @param dest The string to replace (NULL for none).
+ * @param size The number of bytes allocated for the string.
+ * @param value The new value (NULL for none).
+ * @param length The length of the new value.
+ * @return 1 if the string changed, 0 if it was the same.
+ */
+char ReplaceString(char **dest, unsigned int *size,
+                   const char *value, size_t length);
+
 /** Read a float in a locale-independent way.
  * @param str The string containing the float.
  * @return The float.
@@ -78,4 +97,26 @@ const char *FindKey(const StringMappingType *mapping, int count, int value);
 /** Case insensitive string compare. */
 int StrCmpNoCase(const char *a, const char *b);
 
+/** Estimate the server memory used by a pixmap.
+ * @param width The width of the pixmap.
+ * @param height The height of the pixmap.
+ * @param depth The depth of the pixmap.
+ * @return The size in bytes.
+ */
+size_t GetPixmapSize(unsigned int width, unsigned int height,
+                     unsigned int depth);
+
+/** Initialize an empty text buffer.
+ * The data is released by the caller with Release.
+ * @param buffer The buffer to initialize.
+ * @param capacity The initial size in bytes (at least 1).
+ */
+void InitializeTextBuffer(TextBuffer *buffer, size_t capacity);
+
+/** Append formatted text to a text buffer, growing it as needed.
+ * @param buffer The buffer.
+ * @param format The printf format.
+ */
+void AppendText(TextBuffer *buffer, const char *format, ...);
+
 #endif /* MISC_H */
@@ -24,6 +24,7 @@
 #include "desktop.h"
 #include "settings.h"
 #include "timing.h"
+#include "stats.h"
 
 typedef struct {
    int left, right;
@@ -31,6 +32,15 @@ typedef struct {
    char valid;
 } RectangleType;
 
+/** Edges used to index snap rectangles. */
+typedef enum {
+   SNAP_LEFT,
+   SNAP_RIGHT,
+   SNAP_TOP,
+   SNAP_BOTTOM,
+   SNAP_EDGE_COUNT
+} SnapEdgeType;
+
 static char shouldStopMove;
 static char atLeft;
 static char atRight;
@@ -40,13 +50,23 @@ static char atSideFirst;
 static ClientNode *currentClient;
 static TimeType moveTime;
 
+/* Snapshot of snap targets taken when a move starts. */
+static RectangleType *snapRects = NULL;
+static int *snapIndex[SNAP_EDGE_COUNT];
+static int snapCount = 0;
+static SnapEdgeType snapSortEdge;
+
 static void StopMove(ClientNode *np, int doMove, int oldx, int oldy);
 static void RestartMove(ClientNode *np, int *doMove);
 static void MoveController(int wasDestroyed);
 
 static void DoSnap(ClientNode *np);
 static void DoSnapScreen(ClientNode *np);
-static void DoSnapBorder(ClientNode *np);
+static void CreateSnapIndex(const ClientNode *np);
+static int GetSnapEdge(int index);
+static int CompareSnapEdge(const void *a, const void *b);
+static int FindSnapCandidate(unsigned int edge, int value,
+                             const RectangleType *client);
 static char ShouldSnap(const ClientNode *np);
 static void GetClientRectangle(const ClientNode *np, RectangleType *r);
 
@@ -82,6 +102,8 @@ void MoveController(int wasDestroyed)
    JXUngrabKeyboard(display, CurrentTime);
 
    DestroyMoveWindow();
+   DestroySnapIndex();
+   CancelMotionEvents();
    shouldStopMove = 1;
    atTop = 0;
    atBottom = 0;
@@ -97,6 +119,7 @@ char MoveClient(ClientNode *np, int startx, int starty)
    const ScreenType *sp;
    MaxFlags flags;
    int oldx, oldy;
+   int lastx, lasty;
    int doMove;
    int north, south, east, west;
    int height;
@@ -120,13 +143,15 @@ char MoveClient(ClientNode *np, int startx, int starty)
 
    oldx = np->x;
    oldy = np->y;
+   lastx = oldx;
+   lasty = oldy;
 
    if(!(GetMouseMask() & (Button1Mask | Button2Mask))) {
       StopMove(np, 0, oldx, oldy);
       return 0;
    }
 
-   GetBorderSize(&np->state, &north, &south, &east, &west);
+   GetClientBorderSize(np, &north, &south, &east, &west);
    startx -= west;
    starty -= north;
 
@@ -148,6 +173,9 @@ char MoveClient(ClientNode *np, int startx, int starty)
       case ButtonRelease:
          if(event.xbutton.button == Button1
             || event.xbutton.button == Button2) {
+            if(ReplayMotionEvent(&event)) {
+               break;
+            }
             StopMove(np, doMove, oldx, oldy);
             return doMove;
          }
@@ -155,6 +183,9 @@ char MoveClient(ClientNode *np, int startx, int starty)
       case MotionNotify:
 
          DiscardMotionEvents(&event, np->window);
+         if(DeferMotionEvent(&event, settings.moveRate)) {
+            break;
+         }
 
          np->x = event.xmotion.x_root - startx;
          np->y = event.xmotion.y_root - starty;
@@ -253,11 +284,14 @@ char MoveClient(ClientNode *np, int startx, int starty)
 
             CreateMoveWindow(np);
             doMove = 1;
+            lastx = np->x + 1;
          }
 
-         if(doMove) {
+         /* Only update once the position changes. */
+         if(doMove && (np->x != lastx || np->y != lasty)) {
+            lastx = np->x;
+            lasty = np->y;
             if(settings.moveMode == MOVE_OUTLINE) {
-               ClearOutline();
                height = north + south;
                if(!(np->state.status & STAT_SHADED)) {
                   height += np->height;
@@ -318,7 +352,7 @@ char MoveClientKeyboard(ClientNode *np)
       return 0;
    }
 
-   GetBorderSize(&np->state, &north, &south, &east, &west);
+   GetClientBorderSize(np, &north, &south, &east, &west);
 
    oldx = np->x;
    oldy = np->y;
@@ -408,7 +442,6 @@ char MoveClientKeyboard(ClientNode *np)
       if(moved) {
 
          if(settings.moveMode == MOVE_OUTLINE) {
-            ClearOutline();
             DrawOutline(np->x - west, np->y - west,
                         np->width + west + east, height + north + west);
          } else {
@@ -446,7 +479,7 @@ void StopMove(ClientNode *np, int doMove, int oldx, int oldy)
       return;
    }
 
-   GetBorderSize(&np->state, &north, &south, &east, &west);
+   GetClientBorderSize(np, &north, &south, &east, &west);
    if(np->parent != None) {
       JXMoveWindow(display, np->parent, np->x - west, np->y - north);
    } else {
@@ -462,7 +495,7 @@ void RestartMove(ClientNode *np, int *doMove)
       int north, south, east, west;
       *doMove = 0;
       DestroyMoveWindow();
-      GetBorderSize(&np->state, &north, &south, &east, &west);
+      GetClientBorderSize(np, &north, &south, &east, &west);
       if(np->parent != None) {
          JXMoveWindow(display, np->parent, np->x - west, np->y - north);
       } else {
@@ -477,7 +510,11 @@ void DoSnap(ClientNode *np)
 {
    switch(settings.snapMode) {
    case SNAP_BORDER:
-      DoSnapBorder(np);
+      {
+         const StatsTime start = StartStats();
+         DoSnapBorder(np);
+         RecordSectionStats(SECTION_SNAP, start);
+      }
       DoSnapScreen(np);
       break;
    case SNAP_SCREEN:
@@ -500,7 +537,7 @@ void DoSnapScreen(ClientNode *np)
 
    GetClientRectangle(np, &client);
 
-   GetBorderSize(&np->state, &north, &south, &east, &west);
+   GetClientBorderSize(np, &north, &south, &east, &west);
 
    screenCount = GetScreenCount();
    for(screen = 0; screen < screenCount; screen++) {
@@ -527,100 +564,214 @@ void DoSnapScreen(ClientNode *np)
 
 }
 
-/** Snap to window borders. */
-void DoSnapBorder(ClientNode *np)
+/** Sort snap rectangle indexes by edge. */
+int CompareSnapEdge(const void *a, const void *b)
 {
+   const int ea = GetSnapEdge(*(const int*)a);
+   const int eb = GetSnapEdge(*(const int*)b);
+   return ea - eb;
+}
+
+/** Get the edge used to sort the current snap index. */
+int GetSnapEdge(int index)
+{
+   const RectangleType *r = &snapRects[index];
+   switch(snapSortEdge) {
+   case SNAP_LEFT:
+      return r->left;
+   case SNAP_RIGHT:
+      return r->right;
+   case SNAP_TOP:
+      return r->top;
+   default:
+      return r->bottom;
+   }
+}
 
+/** Take a snapshot of the rectangles we can snap to.
+ * The rectangles are stored in the order DoSnapBorder visits them
+ * (bottom of the stack to the top), with an index sorted by each edge.
+ */
+void CreateSnapIndex(const ClientNode *np)
+{
    const ClientNode *tp;
    const TrayType *tray;
-   RectangleType client, other;
-   RectangleType left = { 0 };
-   RectangleType right = { 0 };
-   RectangleType top = { 0 };
-   RectangleType bottom = { 0 };
    int layer;
-   int north, south, east, west;
+   int count;
+   unsigned int edge;
 
-   GetClientRectangle(np, &client);
+   DestroySnapIndex();
 
-   GetBorderSize(&np->state, &north, &south, &east, &west);
-
-   other.valid = 1;
+   count = 0;
+   for(layer = 0; layer < LAYER_COUNT; layer++) {
+      for(tray = GetTrays(); tray; tray = tray->next) {
+         count += 1;
+      }
+      for(tp = nodeTail[layer]; tp; tp = tp->prev) {
+         count += 1;
+      }
+   }
+   snapRects = Allocate(sizeof(RectangleType) * (count + 1));
+   for(edge = 0; edge < SNAP_EDGE_COUNT; edge++) {
+      snapIndex[edge] = Allocate(sizeof(int) * (count + 1));
+   }
 
-   /* Work from the bottom of the window stack to the top. */
+   count = 0;
    for(layer = 0; layer < LAYER_COUNT; layer++) {
 
-      /* Check tray windows. */
+      /* Tray windows are checked with each layer. */
       for(tray = GetTrays(); tray; tray = tray->next) {
-
          if(tray->hidden) {
             continue;
          }
-
-         other.left = tray->x;
-         other.right = tray->x + tray->width;
-         other.top = tray->y;
-         other.bottom = tray->y + tray->height;
-
-         left.valid = CheckLeftValid(&client, &other, &left);
-         right.valid = CheckRightValid(&client, &other, &right);
-         top.valid = CheckTopValid(&client, &other, &top);
-         bottom.valid = CheckBottomValid(&client, &other, &bottom);
-
-         if(CheckOverlapTopBottom(&client, &other)) {
-            if(abs(client.left - other.right) <= settings.snapDistance) {
-               left = other;
-            }
-            if(abs(client.right - other.left) <= settings.snapDistance) {
-               right = other;
-            }
-         }
-         if(CheckOverlapLeftRight(&client, &other)) {
-            if(abs(client.top - other.bottom) <= settings.snapDistance) {
-               top = other;
-            }
-            if(abs(client.bottom - other.top) <= settings.snapDistance) {
-               bottom = other;
-            }
-         }
-
+         snapRects[count].left = tray->x;
+         snapRects[count].right = tray->x + tray->width;
+         snapRects[count].top = tray->y;
+         snapRects[count].bottom = tray->y + tray->height;
+         snapRects[count].valid = 1;
+         count += 1;
       }
 
-      /* Check client windows. */
       for(tp = nodeTail[layer]; tp; tp = tp->prev) {
-
          if(tp == np || !ShouldSnap(tp)) {
             continue;
          }
+         GetClientRectangle(tp, &snapRects[count]);
+         count += 1;
+      }
 
-         GetClientRectangle(tp, &other);
+   }
+   snapCount = count;
 
-         /* Check if this border invalidates any previous value. */
-         left.valid = CheckLeftValid(&client, &other, &left);
-         right.valid = CheckRightValid(&client, &other, &right);
-         top.valid = CheckTopValid(&client, &other, &top);
-         bottom.valid = CheckBottomValid(&client, &other, &bottom);
+   for(edge = 0; edge < SNAP_EDGE_COUNT; edge++) {
+      int x;
+      for(x = 0; x < count; x++) {
+         snapIndex[edge][x] = x;
+      }
+      snapSortEdge = edge;
+      qsort(snapIndex[edge], count, sizeof(int), CompareSnapEdge);
+   }
+}
 
-         /* Compute the new snap values. */
-         if(CheckOverlapTopBottom(&client, &other)) {
-            if(abs(client.left - other.right) <= settings.snapDistance) {
-               left = other;
-            }
-            if(abs(client.right - other.left) <= settings.snapDistance) {
-               right = other;
-            }
+/** Release the snap snapshot. */
+void DestroySnapIndex(void)
+{
+   unsigned int edge;
+   if(snapRects) {
+      Release(snapRects);
+      snapRects = NULL;
+   }
+   for(edge = 0; edge < SNAP_EDGE_COUNT; edge++) {
+      if(snapIndex[edge]) {
+         Release(snapIndex[edge]);
+         snapIndex[edge] = NULL;
+      }
+   }
+   snapCount = 0;
+}
+
+/** Find the highest rectangle with an edge near a value.
+ * @param edge The edge to check.
+ * @param value The position of the edge of the client.
+ * @param client The client rectangle (for the overlap check).
+ * @return The index of the rectangle or -1 if there is none.
+ */
+int FindSnapCandidate(unsigned int edge, int value,
+                      const RectangleType *client)
+{
+   const int *index = snapIndex[edge];
+   int low, high, best;
+
+   /* Find the first edge that is within snapDistance. */
+   snapSortEdge = edge;
+   low = 0;
+   high = snapCount;
+   while(low < high) {
+      const int mid = (low + high) / 2;
+      if(GetSnapEdge(index[mid]) < value - settings.snapDistance) {
+         low = mid + 1;
+      } else {
+         high = mid;
+      }
+   }
+
+   best = -1;
+   for(; low < snapCount; low++) {
+      const int x = index[low];
+      const RectangleType *other = &snapRects[x];
+      if(GetSnapEdge(x) > value + settings.snapDistance) {
+         break;
+      }
+      if(x <= best) {
+         continue;
+      }
+      if(edge == SNAP_LEFT || edge == SNAP_RIGHT) {
+         if(CheckOverlapTopBottom(client, other)) {
+            best = x;
          }
-         if(CheckOverlapLeftRight(&client, &other)) {
-            if(abs(client.top - other.bottom) <= settings.snapDistance) {
-               top = other;
-            }
-            if(abs(client.bottom - other.top) <= settings.snapDistance) {
-               bottom = other;
-            }
+      } else {
+         if(CheckOverlapLeftRight(client, other)) {
+            best = x;
          }
-
       }
+   }
+   return best;
+}
 
+/** Snap to window borders.
+ * A snap position is taken from the highest window with a matching
+ * edge and is dropped if any window above it covers that edge.
+ */
+void DoSnapBorder(ClientNode *np)
+{
+
+   RectangleType client;
+   RectangleType left, right, top, bottom;
+   int leftIndex, rightIndex, topIndex, bottomIndex;
+   int north, south, east, west;
+   int x;
+
+   if(!snapRects) {
+      CreateSnapIndex(np);
+   }
+
+   GetClientRectangle(np, &client);
+
+   GetClientBorderSize(np, &north, &south, &east, &west);
+
+   /* The left edge of the client snaps to the right edge of others. */
+   leftIndex = FindSnapCandidate(SNAP_RIGHT, client.left, &client);
+   rightIndex = FindSnapCandidate(SNAP_LEFT, client.right, &client);
+   topIndex = FindSnapCandidate(SNAP_BOTTOM, client.top, &client);
+   bottomIndex = FindSnapCandidate(SNAP_TOP, client.bottom, &client);
+
+   left.valid = 0;
+   if(leftIndex >= 0) {
+      left = snapRects[leftIndex];
+      for(x = leftIndex + 1; x < snapCount && left.valid; x++) {
+         left.valid = CheckLeftValid(&client, &snapRects[x], &left);
+      }
+   }
+   right.valid = 0;
+   if(rightIndex >= 0) {
+      right = snapRects[rightIndex];
+      for(x = rightIndex + 1; x < snapCount && right.valid; x++) {
+         right.valid = CheckRightValid(&client, &snapRects[x], &right);
+      }
+   }
+   top.valid = 0;
+   if(topIndex >= 0) {
+      top = snapRects[topIndex];
+      for(x = topIndex + 1; x < snapCount && top.valid; x++) {
+         top.valid = CheckTopValid(&client, &snapRects[x], &top);
+      }
+   }
+   bottom.valid = 0;
+   if(bottomIndex >= 0) {
+      bottom = snapRects[bottomIndex];
+      for(x = bottomIndex + 1; x < snapCount && bottom.valid; x++) {
+         bottom.valid = CheckBottomValid(&client, &snapRects[x], &bottom);
+      }
    }
 
    if(right.valid) {
@@ -659,7 +810,7 @@ void GetClientRectangle(const ClientNode *np, RectangleType *r)
 
    int north, south, east, west;
 
-   GetBorderSize(&np->state, &north, &south, &east, &west);
+   GetClientBorderSize(np, &north, &south, &east, &west);
 
    r->left = np->x - west;
    r->right = np->x + np->width + east;
@@ -862,4 +1013,7 @@ void UpdateDesktop(const TimeType *now)
       RequireRestack();
    }
    currentClient->state.status &= ~STAT_HIDDEN;
+
+   /* Windows on the new desktop are now visible. */
+   DestroySnapIndex();
 }
@@ -26,5 +26,15 @@ char MoveClient(struct ClientNode *np, int startx, int starty);
  */
 char MoveClientKeyboard(struct ClientNode *np);
 
+/** Snap a client to the borders of other windows.
+ * The positions of the other windows are taken the first time this is
+ * called and kept until DestroySnapIndex is called.
+ * @param np The client being moved.
+ */
+void DoSnapBorder(struct ClientNode *np);
+
+/** Release the window positions kept by DoSnapBorder. */
+void DestroySnapIndex(void);
+
 #endif /* MOVE_H */
 
@@ -5,44 +5,102 @@
  *
  * @brief Outlines for moving and resizing client windows.
  *
+ * The outline is made of four thin override-redirect windows, so the
+ * server does not need to be grabbed while it is shown.
+ *
  */
 
 #include "jwm.h"
 #include "outline.h"
 #include "main.h"
-#include "grab.h"
+#include "color.h"
+#include "misc.h"
+
+/** Width of the outline in pixels. */
+#define OUTLINE_WIDTH 2
+
+/** Number of windows making up the outline. */
+#define OUTLINE_COUNT 4
+
+static Window outlineWindows[OUTLINE_COUNT] = { None, None, None, None };
+static char outlineShown = 0;
+
+static void CreateOutline(void);
 
-static GC outlineGC = None;
-static int lastX, lastY;
-static int lastWidth, lastHeight;
+/** Release the outline windows. */
+void ShutdownOutline(void)
+{
+   unsigned int i;
+   for(i = 0; i < OUTLINE_COUNT; i++) {
+      if(outlineWindows[i] != None) {
+         JXDestroyWindow(display, outlineWindows[i]);
+         outlineWindows[i] = None;
+      }
+   }
+   outlineShown = 0;
+}
+
+/** Create the outline windows. */
+void CreateOutline(void)
+{
+   XSetWindowAttributes attr;
+   unsigned int i;
+
+   attr.override_redirect = True;
+   attr.background_pixel = colors[COLOR_TITLE_ACTIVE_BG1];
+   attr.save_under = True;
+   for(i = 0; i < OUTLINE_COUNT; i++) {
+      outlineWindows[i] = JXCreateWindow(display, rootWindow, 0, 0, 1, 1, 0,
+                                         CopyFromParent, InputOutput,
+                                         CopyFromParent,
+                                         CWOverrideRedirect | CWBackPixel
+                                         | CWSaveUnder, &attr);
+   }
+}
 
 /** Draw an outline. */
 void DrawOutline(int x, int y, int width, int height)
 {
-   XGCValues gcValues;
-   gcValues.function = GXinvert;
-   gcValues.subwindow_mode = IncludeInferiors;
-   gcValues.line_width = 2;
-   outlineGC = JXCreateGC(display, rootWindow,
-                          GCFunction | GCSubwindowMode | GCLineWidth,
-                          &gcValues);
-   GrabServer();
-   JXDrawRectangle(display, rootWindow, outlineGC, x, y, width, height);
-   lastX = x;
-   lastY = y;
-   lastWidth = width;
-   lastHeight = height;
+   XWindowChanges wc;
+   const unsigned int mask = CWX | CWY | CWWidth | CWHeight;
+   const int side = Max(1, height - 2 * OUTLINE_WIDTH);
+   unsigned int i;
+
+   if(outlineWindows[0] == None) {
+      CreateOutline();
+   }
+
+   /* Top, bottom, left, and right. */
+   wc.x = x;
+   wc.y = y;
+   wc.width = Max(1, width);
+   wc.height = OUTLINE_WIDTH;
+   JXConfigureWindow(display, outlineWindows[0], mask, &wc);
+   wc.y = y + height - OUTLINE_WIDTH;
+   JXConfigureWindow(display, outlineWindows[1], mask, &wc);
+   wc.y = y + OUTLINE_WIDTH;
+   wc.width = OUTLINE_WIDTH;
+   wc.height = side;
+   JXConfigureWindow(display, outlineWindows[2], mask, &wc);
+   wc.x = x + width - OUTLINE_WIDTH;
+   JXConfigureWindow(display, outlineWindows[3], mask, &wc);
+
+   if(!outlineShown) {
+      for(i = 0; i < OUTLINE_COUNT; i++) {
+         JXMapRaised(display, outlineWindows[i]);
+      }
+      outlineShown = 1;
+   }
 }
 
 /** Clear the last outline. */
 void ClearOutline(void)
 {
-   if(outlineGC != None) {
-      JXDrawRectangle(display, rootWindow, outlineGC,
-                      lastX, lastY, lastWidth, lastHeight);
-      UngrabServer();
-      JXFreeGC(display, outlineGC);
-      outlineGC = None;
+   unsigned int i;
+   if(outlineShown) {
+      for(i = 0; i < OUTLINE_COUNT; i++) {
+         JXUnmapWindow(display, outlineWindows[i]);
+      }
+      outlineShown = 0;
    }
 }
-
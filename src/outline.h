@@ -10,7 +10,11 @@
 #ifndef OUTLINE_H
 #define OUTLINE_H
 
+/** Release the outline windows. */
+void ShutdownOutline(void);
+
 /** Draw an outline.
+ * This replaces the last outline if it is still shown.
  * @param x The x-coordinate.
  * @param y The y-coordinate.
  * @param width The width of the outline.
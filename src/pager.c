@@ -21,6 +21,33 @@
 #include "popup.h"
 #include "font.h"
 #include "settings.h"
+#include "misc.h"
+#include "stats.h"
+#include "trace.h"
+#include "preview.h"
+#include "render.h"
+
+/** A client as drawn on a desktop of a pager. */
+typedef struct PagerRect {
+   const ClientNode *client;  /**< The client. */
+   int x, y;               /**< Location within the desktop. */
+   int width, height;      /**< Size of the outline. */
+   unsigned int preview;   /**< Preview contents serial (0 for none). */
+   ColorType fill;         /**< Fill color (COLOR_COUNT for none). */
+} PagerRect;
+
+/** The contents of a desktop shown on a pager.
+ * Two rectangle lists are kept so the list being built can be compared
+ * to the one that was last drawn.
+ */
+typedef struct PagerCell {
+   PagerRect *rects[2];          /**< Rectangle lists. */
+   unsigned int count[2];        /**< Number of rectangles in each list. */
+   unsigned int capacity[2];     /**< Capacity of each list. */
+   char current;                 /**< The list that was last drawn. */
+   char active;                  /**< Set if drawn as the current desktop. */
+   char valid;                   /**< Set if the cell has been drawn. */
+} PagerCell;
 
 /** Structure to represent a pager tray component. */
 typedef struct PagerType {
@@ -32,8 +59,12 @@ typedef struct PagerType {
    int scalex;             /**< Horizontal scale factor (fixed point). */
    int scaley;             /**< Vertical scale factor (fixed point). */
    char labeled;           /**< Set to label the pager. */
+   char preview;           /**< Set to show window previews. */
+   char suspended;         /**< Set while the tray is not shown. */
 
    Pixmap buffer;          /**< Buffer for rendering the pager. */
+   Pixmap background[2];   /**< Labeled backgrounds (inactive, active). */
+   PagerCell *cells;       /**< Contents of each desktop. */
 
    TimeType mouseTime;     /**< Timestamp of last mouse movement. */
    int mousex, mousey;     /**< Coordinates of last mouse location. */
@@ -46,9 +77,13 @@ static PagerType *pagers = NULL;
 
 static char shouldStopMove;
 
+static TimeType lastPagerUpdate = ZERO_TIME;
+static char pagerUpdatePending = 0;
+
 static void Create(TrayComponentType *cp);
 
 static void SetSize(TrayComponentType *cp, int width, int height);
+static void Resize(TrayComponentType *cp);
 
 static int GetPagerDesktop(PagerType *pp, int x, int y);
 
@@ -65,10 +100,23 @@ static void StopPagerMove(ClientNode *np,
 
 static void PagerMoveController(int wasDestroyed);
 
-static void DrawPager(const PagerType *pp);
+static void DrawPager(PagerType *pp);
+
+static void DrawPagerCells(PagerType *pp);
+
+static void DrawPagerCell(const PagerType *pp, unsigned int desktop);
 
-static void DrawPagerClient(const PagerType *pp, const ClientNode *np);
+static void CreatePagerBackgrounds(PagerType *pp);
 
+static void ReleasePagerBackgrounds(PagerType *pp);
+
+static int GetPagerRect(const PagerType *pp, ClientNode *np,
+                        PagerRect *rp);
+
+static void PagerTimeout(const TimeType *now, int x, int y, Window w,
+                         void *data);
+
+static void SetSuspended(TrayComponentType *cp, char suspended);
 static void SignalPager(const TimeType *now, int x, int y, Window w,
                         void *data);
 
@@ -77,8 +125,27 @@ static void SignalPager(const TimeType *now, int x, int y, Window w,
 void ShutdownPager(void)
 {
    PagerType *pp;
+   unsigned int x;
+
+   UnregisterTimeout(PagerTimeout, NULL);
+   pagerUpdatePending = 0;
+
    for(pp = pagers; pp; pp = pp->next) {
-      JXFreePixmap(display, pp->buffer);
+      ReleaseTrayPixmap(pp->cp);
+      pp->buffer = None;
+      ReleasePagerBackgrounds(pp);
+      if(pp->cells) {
+         for(x = 0; x < settings.desktopCount; x++) {
+            if(pp->cells[x].rects[0]) {
+               Release(pp->cells[x].rects[0]);
+            }
+            if(pp->cells[x].rects[1]) {
+               Release(pp->cells[x].rects[1]);
+            }
+         }
+         Release(pp->cells);
+         pp->cells = NULL;
+      }
    }
 }
 
@@ -87,7 +154,9 @@ void DestroyPager(void)
 {
    PagerType *pp;
    while(pagers) {
-      UnregisterCallback(SignalPager, pagers);
+      if(!pagers->suspended) {
+         UnregisterCallback(SignalPager, pagers);
+      }
       pp = pagers->next;
       Release(pagers);
       pagers = pp;
@@ -95,7 +164,7 @@ void DestroyPager(void)
 }
 
 /** Create a new pager tray component. */
-TrayComponentType *CreatePager(char labeled)
+TrayComponentType *CreatePager(char labeled, char preview)
 {
 
    TrayComponentType *cp;
@@ -105,19 +174,29 @@ TrayComponentType *CreatePager(char labeled)
    pp->next = pagers;
    pagers = pp;
    pp->labeled = labeled;
+   pp->preview = preview;
+   pp->suspended = 0;
+   if(preview) {
+      EnablePreviews();
+   }
    pp->mousex = -settings.doubleClickDelta;
    pp->mousey = -settings.doubleClickDelta;
    pp->mouseTime.seconds = 0;
    pp->mouseTime.ms = 0;
    pp->buffer = None;
+   pp->background[0] = None;
+   pp->background[1] = None;
+   pp->cells = NULL;
 
    cp = CreateTrayComponent();
    cp->object = pp;
    pp->cp = cp;
    cp->Create = Create;
    cp->SetSize = SetSize;
+   cp->Resize = Resize;
    cp->ProcessButtonPress = ProcessPagerButtonEvent;
    cp->ProcessMotionEvent = ProcessPagerMotionEvent;
+   cp->SetSuspended = SetSuspended;
 
    RegisterCallback(settings.popupDelay / 2, SignalPager, pp);
 
@@ -139,10 +218,13 @@ void Create(TrayComponentType *cp)
    Assert(cp->width > 0);
    Assert(cp->height > 0);
 
-   cp->pixmap = JXCreatePixmap(display, rootWindow, cp->width,
-                               cp->height, rootDepth);
+   CreateTrayPixmap(cp);
    pp->buffer = cp->pixmap;
 
+   pp->cells = Allocate(sizeof(PagerCell) * settings.desktopCount);
+   memset(pp->cells, 0, sizeof(PagerCell) * settings.desktopCount);
+   CreatePagerBackgrounds(pp);
+
 }
 
 /** Set the size of a pager tray component. */
@@ -177,19 +259,24 @@ void SetSize(TrayComponentType *cp, int width, int height)
       Assert(0);
    }
 
-   if(pp->buffer != None) {
-      JXFreePixmap(display, pp->buffer);
-      pp->buffer = JXCreatePixmap(display, rootWindow, cp->width,
-                                  cp->height, rootDepth);
-      cp->pixmap = pp->buffer;
-      DrawPager(pp);
-   }
-
    pp->scalex = ((pp->deskWidth - 2) << 16) / rootWidth;
    pp->scaley = ((pp->deskHeight - 2) << 16) / rootHeight;
 
 }
 
+/** Resize a pager tray component. */
+void Resize(TrayComponentType *cp)
+{
+   PagerType *pp = (PagerType*)cp->object;
+   if(pp->buffer != None) {
+      CreateTrayPixmap(cp);
+      pp->buffer = cp->pixmap;
+      ReleasePagerBackgrounds(pp);
+      CreatePagerBackgrounds(pp);
+      DrawPager(pp);
+   }
+}
+
 /** Get the desktop for a pager given a set of coordinates. */
 int GetPagerDesktop(PagerType *pp, int x, int y)
 {
@@ -259,10 +346,9 @@ void StartPagerMove(TrayComponentType *cp, int x, int y)
    XEvent event;
    PagerType *pp;
    ClientNode *np;
+   PagerRect rect;
    int layer;
    int desktop;
-   int cx, cy;
-   int cwidth, cheight;
 
    int north, south, east, west;
    int oldx, oldy;
@@ -281,59 +367,18 @@ void StartPagerMove(TrayComponentType *cp, int x, int y)
    for(layer = LAST_LAYER; layer >= FIRST_LAYER; layer--) {
       for(np = nodes[layer]; np; np = np->next) {
 
-         /* Skip this client if it isn't mapped. */
-         if(!(np->state.status & STAT_MAPPED)) {
-            continue;
-         }
-         if(np->state.status & STAT_NOPAGER) {
-            continue;
-         }
-
-         /* Skip this client if it isn't on the selected desktop. */
-         if(np->state.status & STAT_STICKY) {
-            if(currentDesktop != desktop) {
-               continue;
-            }
-         } else {
-            if(np->state.desktop != desktop) {
-               continue;
-            }
-         }
-
-         /* Get the offset and size of the client on the pager. */
-         cx = 1 + ((np->x * pp->scalex) >> 16);
-         cy = 1 + ((np->y * pp->scaley) >> 16);
-         cwidth = (np->width * pp->scalex) >> 16;
-         cheight = (np->height * pp->scaley) >> 16;
-
-         /* Normalize the offset and size. */
-         if(cx + cwidth > pp->deskWidth) {
-            cwidth = pp->deskWidth - cx;
-         }
-         if(cy + cheight > pp->deskHeight) {
-            cheight = pp->deskHeight - cy;
-         }
-         if(cx < 0) {
-            cwidth += cx;
-            cx = 0;
-         }
-         if(cy < 0) {
-            cheight += cy;
-            cy = 0;
-         }
-
-         /* Skip the client if we are no longer in bounds. */
-         if(cwidth <= 0 || cheight <= 0) {
+         /* Skip this client if it isn't shown on the selected desktop. */
+         if(GetPagerRect(pp, np, &rect) != desktop) {
             continue;
          }
 
          /* Check the y-coordinate. */
-         if(y < cy || y > cy + cheight) {
+         if(y < rect.y || y > rect.y + rect.height) {
             continue;
          }
 
          /* Check the x-coordinate. */
-         if(x < cx || x > cx + cwidth) {
+         if(x < rect.x || x > rect.x + rect.width) {
             continue;
          }
 
@@ -366,7 +411,7 @@ ClientFound:
       MaximizeClient(np, MAX_NONE);
    }
 
-   GetBorderSize(&np->state, &north, &south, &east, &west);
+   GetClientBorderSize(np, &north, &south, &east, &west);
 
    np->controller = PagerMoveController;
    shouldStopMove = 0;
@@ -473,7 +518,7 @@ void StopPagerMove(ClientNode *np,
    np->x = x;
    np->y = y;
 
-   GetBorderSize(&np->state, &north, &south, &east, & west);
+   GetClientBorderSize(np, &north, &south, &east, & west);
    JXMoveWindow(display, np->parent, np->x - west, np->y - north);
    SendConfigureEvent(np);
 
@@ -497,79 +542,219 @@ void PagerMoveController(int wasDestroyed)
 
 }
 
-/** Draw a pager. */
-void DrawPager(const PagerType *pp)
+/** Draw all desktops of a pager. */
+void DrawPager(PagerType *pp)
+{
+   unsigned int x;
+
+   for(x = 0; x < settings.desktopCount; x++) {
+      pp->cells[x].valid = 0;
+   }
+   DrawPagerCells(pp);
+}
+
+/** Draw the desktops of a pager that changed and update the tray. */
+void DrawPagerCells(PagerType *pp)
 {
    ClientNode *np;
-   Pixmap buffer;
-   int width, height;
-   int deskWidth, deskHeight;
+   PagerCell *cell;
+   PagerRect rect;
    unsigned int x;
-   const char *name;
-   int xc, yc;
-   int textWidth, textHeight;
-   int dx, dy;
+   const TraceTime traceStart = StartTrace();
 
-   buffer = pp->cp->pixmap;
-   width = pp->cp->width;
-   height = pp->cp->height;
-   deskWidth = pp->deskWidth;
-   deskHeight = pp->deskHeight;
-
-   /* Draw the background. */
-   JXSetForeground(display, rootGC, colors[COLOR_PAGER_BG]);
-   JXFillRectangle(display, buffer, rootGC, 0, 0, width, height);
-
-   /* Highlight the current desktop. */
-   JXSetForeground(display, rootGC, colors[COLOR_PAGER_ACTIVE_BG]);
-   dx = currentDesktop % settings.desktopWidth;
-   dy = currentDesktop / settings.desktopWidth;
-   JXFillRectangle(display, buffer, rootGC,
-                   dx * (deskWidth + 1), dy * (deskHeight + 1),
-                   deskWidth, deskHeight);
-
-   /* Draw the labels. */
-   if(pp->labeled) {
-      textHeight = GetStringHeight(FONT_PAGER);
-      if(textHeight < deskHeight) {
-         for(x = 0; x < settings.desktopCount; x++) {
-            dx = x % settings.desktopWidth;
-            dy = x / settings.desktopWidth;
-            name = GetDesktopName(x);
-            textWidth = GetStringWidth(FONT_PAGER, name);
-            if(textWidth < deskWidth) {
-               xc = dx * (deskWidth + 1) + (deskWidth - textWidth) / 2;
-               yc = dy * (deskHeight + 1) + (deskHeight - textHeight) / 2;
-               RenderString(buffer, FONT_PAGER,
-                            COLOR_PAGER_TEXT, xc, yc, deskWidth, name);
-            }
+   /* Build the new contents of each desktop. */
+   for(x = 0; x < settings.desktopCount; x++) {
+      cell = &pp->cells[x];
+      cell->count[!cell->current] = 0;
+   }
+   for(x = FIRST_LAYER; x <= LAST_LAYER; x++) {
+      for(np = nodeTail[x]; np; np = np->prev) {
+         const int desktop = GetPagerRect(pp, np, &rect);
+         unsigned int index;
+         if(desktop < 0) {
+            continue;
+         }
+         cell = &pp->cells[desktop];
+         index = !cell->current;
+         if(!cell->rects[index]) {
+            cell->capacity[index] = 4;
+            cell->rects[index] = Allocate(sizeof(PagerRect)
+                                          * cell->capacity[index]);
+         } else if(cell->count[index] == cell->capacity[index]) {
+            cell->capacity[index] *= 2;
+            cell->rects[index] = Reallocate(cell->rects[index],
+               sizeof(PagerRect) * cell->capacity[index]);
          }
+         cell->rects[index][cell->count[index]] = rect;
+         cell->count[index] += 1;
       }
    }
 
+   /* Redraw the desktops that differ from what was drawn last. */
+   for(x = 0; x < settings.desktopCount; x++) {
+      const char active = x == currentDesktop;
+      const unsigned int last = pp->cells[x].current;
+      const unsigned int next = !last;
+      cell = &pp->cells[x];
+      if(cell->valid && cell->active == active
+         && cell->count[next] == cell->count[last]
+         && (cell->count[next] == 0
+         || !memcmp(cell->rects[next], cell->rects[last],
+                    sizeof(PagerRect) * cell->count[next]))) {
+         continue;
+      }
+      cell->current = next;
+      cell->active = active;
+      cell->valid = 1;
+      DrawPagerCell(pp, x);
+      UpdateTrayArea(pp->cp->tray, pp->cp,
+                     (x % settings.desktopWidth) * (pp->deskWidth + 1),
+                     (x / settings.desktopWidth) * (pp->deskHeight + 1),
+                     pp->deskWidth + 1, pp->deskHeight + 1);
+   }
+   RecordTrace("DrawPager", -1, traceStart);
+}
+
+/** Draw one desktop of a pager. */
+void DrawPagerCell(const PagerType *pp, unsigned int desktop)
+{
+   const PagerCell *cell = &pp->cells[desktop];
+   const PagerRect *rp;
+   const Pixmap buffer = pp->cp->pixmap;
+   const int dx = desktop % settings.desktopWidth;
+   const int dy = desktop / settings.desktopWidth;
+   const int cellx = dx * (pp->deskWidth + 1);
+   const int celly = dy * (pp->deskHeight + 1);
+   const int offx = pp->cp->pixmapX + cellx;
+   const int offy = pp->cp->pixmapY + celly;
+   unsigned int x;
+
+   /* Start from the labeled background.
+    * This includes the dividers to the right and below, which the last
+    * row and column do not have room for. */
+   JXCopyArea(display, pp->background[(int)cell->active], buffer, rootGC,
+              cellx, celly,
+              Min(pp->deskWidth + 1, pp->cp->width - cellx),
+              Min(pp->deskHeight + 1, pp->cp->height - celly),
+              offx, offy);
+
    /* Draw the clients. */
-   for(x = FIRST_LAYER; x <= LAST_LAYER; x++) {
-      for(np = nodeTail[x]; np; np = np->prev) {
-         DrawPagerClient(pp, np);
+   for(x = 0; x < cell->count[(int)cell->current]; x++) {
+      rp = &cell->rects[(int)cell->current][x];
+      JXSetForeground(display, rootGC, colors[COLOR_PAGER_OUTLINE]);
+      JXDrawRectangle(display, buffer, rootGC, offx + rp->x, offy + rp->y,
+                      rp->width, rp->height);
+      if(rp->preview
+         && PutPreview(rp->client, buffer, offx + rp->x + 1,
+                       offy + rp->y + 1, rp->width - 1, rp->height - 1)) {
+         continue;
+      }
+      if(rp->fill != COLOR_COUNT) {
+         JXSetForeground(display, rootGC, colors[rp->fill]);
+         JXFillRectangle(display, buffer, rootGC,
+                         offx + rp->x + 1, offy + rp->y + 1,
+                         rp->width - 1, rp->height - 1);
       }
    }
 
-   /* Draw the desktop dividers. */
+   /* Client outlines may cover the dividers, so restore them. */
    JXSetForeground(display, rootGC, colors[COLOR_PAGER_OUTLINE]);
-   for(x = 1; x < settings.desktopHeight; x++) {
+   if(dx + 1 < settings.desktopWidth) {
       JXDrawLine(display, buffer, rootGC,
-                 0, (deskHeight + 1) * x - 1,
-                 width, (deskHeight + 1) * x - 1);
+                 offx + pp->deskWidth, offy,
+                 offx + pp->deskWidth, offy + pp->deskHeight);
    }
-   for(x = 1; x < settings.desktopWidth; x++) {
+   if(dy + 1 < settings.desktopHeight) {
       JXDrawLine(display, buffer, rootGC,
-                 (deskWidth + 1) * x - 1, 0,
-                 (deskWidth + 1) * x - 1, height);
+                 offx, offy + pp->deskHeight,
+                 offx + pp->deskWidth, offy + pp->deskHeight);
    }
+}
 
+/** Create the labeled backgrounds of a pager.
+ * The first background shows every desktop as inactive and the second
+ * shows every desktop as active; cells are copied from one or the other.
+ */
+void CreatePagerBackgrounds(PagerType *pp)
+{
+   const int width = pp->cp->width;
+   const int height = pp->cp->height;
+   const int deskWidth = pp->deskWidth;
+   const int deskHeight = pp->deskHeight;
+   unsigned int index;
+   unsigned int x;
+   const char *name;
+   int xc, yc;
+   int textWidth, textHeight;
+   int dx, dy;
+
+   for(index = 0; index < 2; index++) {
+      const Pixmap buffer = JXCreatePixmap(display, rootWindow,
+                                           width, height, rootDepth);
+      pp->background[index] = buffer;
+      RecordPixmapStats(PIXMAP_PAGER,
+                        (long)GetPixmapSize(width, height, rootDepth));
+
+      /* Draw the background. */
+      JXSetForeground(display, rootGC,
+                      colors[index ? COLOR_PAGER_ACTIVE_BG : COLOR_PAGER_BG]);
+      JXFillRectangle(display, buffer, rootGC, 0, 0, width, height);
+
+      /* Draw the labels. */
+      if(pp->labeled) {
+         textHeight = GetStringHeight(FONT_PAGER);
+         if(textHeight < deskHeight) {
+            for(x = 0; x < settings.desktopCount; x++) {
+               dx = x % settings.desktopWidth;
+               dy = x / settings.desktopWidth;
+               name = GetDesktopName(x);
+               textWidth = GetStringWidth(FONT_PAGER, name);
+               if(textWidth < deskWidth) {
+                  xc = dx * (deskWidth + 1) + (deskWidth - textWidth) / 2;
+                  yc = dy * (deskHeight + 1)
+                     + (deskHeight - textHeight) / 2;
+                  RenderString(buffer, FONT_PAGER,
+                               COLOR_PAGER_TEXT, xc, yc, deskWidth, name);
+               }
+            }
+         }
+      }
+
+      /* Draw the desktop dividers. */
+      JXSetForeground(display, rootGC, colors[COLOR_PAGER_OUTLINE]);
+      for(x = 1; x < settings.desktopHeight; x++) {
+         JXDrawLine(display, buffer, rootGC,
+                    0, (deskHeight + 1) * x - 1,
+                    width, (deskHeight + 1) * x - 1);
+      }
+      for(x = 1; x < settings.desktopWidth; x++) {
+         JXDrawLine(display, buffer, rootGC,
+                    (deskWidth + 1) * x - 1, 0,
+                    (deskWidth + 1) * x - 1, height);
+      }
+   }
+}
+
+/** Release the labeled backgrounds of a pager. */
+void ReleasePagerBackgrounds(PagerType *pp)
+{
+   unsigned int index;
+   for(index = 0; index < 2; index++) {
+      if(pp->background[index] != None) {
+         ReleaseFontTarget(pp->background[index]);
+         JXFreePixmap(display, pp->background[index]);
+         RecordPixmapStats(PIXMAP_PAGER,
+                           -(long)GetPixmapSize(pp->cp->width,
+                                                pp->cp->height, rootDepth));
+         pp->background[index] = None;
+      }
+   }
 }
 
-/** Update the pager. */
+/** Update the pager.
+ * Redraws are limited to settings.pagerRate per second; updates that
+ * arrive sooner are combined into one redraw when the interval expires.
+ */
 void UpdatePager(void)
 {
 
@@ -579,16 +764,54 @@ void UpdatePager(void)
       return;
    }
 
+   if(settings.pagerRate > 0) {
+      const unsigned long interval = 1000 / settings.pagerRate;
+      TimeType now;
+      unsigned long elapsed;
+      GetCurrentTime(&now);
+      elapsed = GetTimeDifference(&now, &lastPagerUpdate);
+      if(elapsed < interval) {
+         if(!pagerUpdatePending) {
+            pagerUpdatePending = 1;
+            RegisterTimeout(interval - elapsed, PagerTimeout, NULL);
+         }
+         return;
+      }
+      lastPagerUpdate = now;
+   }
+   if(pagerUpdatePending) {
+      UnregisterTimeout(PagerTimeout, NULL);
+      pagerUpdatePending = 0;
+   }
+
    for(pp = pagers; pp; pp = pp->next) {
+      if(pp->buffer != None && !pp->suspended) {
+         DrawPagerCells(pp);
+      }
+   }
 
-      /* Draw the pager. */
-      DrawPager(pp);
+}
 
-      /* Tell the tray to redraw. */
-      UpdateSpecificTray(pp->cp->tray, pp->cp);
+/** Run a pager update that was deferred by UpdatePager. */
+void PagerTimeout(const TimeType *now, int x, int y, Window w, void *data)
+{
+   pagerUpdatePending = 0;
+   UpdatePager();
+}
 
+/** Stop updating a pager while its tray is not shown. */
+void SetSuspended(TrayComponentType *cp, char suspended)
+{
+   PagerType *pp = (PagerType*)cp->object;
+   pp->suspended = suspended;
+   if(suspended) {
+      UnregisterCallback(SignalPager, pp);
+   } else {
+      RegisterCallback(settings.popupDelay / 2, SignalPager, pp);
+      if(pp->buffer != None) {
+         DrawPagerCells(pp);
+      }
    }
-
 }
 
 /** Signal pagers (for popups). */
@@ -612,32 +835,36 @@ void SignalPager(const TimeType *now, int x, int y, Window w, void *data)
    }
 }
 
-/** Draw a client on the pager. */
-void DrawPagerClient(const PagerType *pp, const ClientNode *np)
+/** Get the rectangle used to show a client on the pager.
+ * @return The desktop the client is shown on or -1 if it is not shown.
+ */
+int GetPagerRect(const PagerType *pp, ClientNode *np, PagerRect *rp)
 {
 
    int x, y;
    int width, height;
-   int offx, offy;
+   unsigned int desktop;
 
-   /* Don't draw the client if it isn't mapped. */
+   /* Rectangles are compared with memcmp, so clear the padding. */
+   memset(rp, 0, sizeof(PagerRect));
+
+   /* Don't show the client if it isn't mapped. */
    if(!(np->state.status & STAT_MAPPED)) {
-      return;
+      return -1;
    }
    if(np->state.status & STAT_NOPAGER) {
-      return;
+      return -1;
    }
 
    /* Determine the desktop for the client. */
    if(np->state.status & STAT_STICKY) {
-      offx = currentDesktop % settings.desktopWidth;
-      offy = currentDesktop / settings.desktopWidth;
+      desktop = currentDesktop;
    } else {
-      offx = np->state.desktop % settings.desktopWidth;
-      offy = np->state.desktop / settings.desktopWidth;
+      desktop = np->state.desktop;
+   }
+   if(JUNLIKELY(desktop >= settings.desktopCount)) {
+      return -1;
    }
-   offx *= pp->deskWidth + 1;
-   offy *= pp->deskHeight + 1;
 
    /* Determine the location and size of the client on the pager. */
    x = 1 + ((np->x * pp->scalex) >> 16);
@@ -661,35 +888,36 @@ void DrawPagerClient(const PagerType *pp, const ClientNode *np)
       y = 0;
    }
 
-   /* Return if there's nothing to do. */
+   /* Return if there's nothing to show. */
    if(width <= 0 || height <= 0) {
-      return;
+      return -1;
    }
 
-   /* Move to the correct desktop on the pager. */
-   x += offx;
-   y += offy;
-
-   /* Draw the client outline. */
-   JXSetForeground(display, rootGC, colors[COLOR_PAGER_OUTLINE]);
-   JXDrawRectangle(display, pp->cp->pixmap, rootGC, x, y, width, height);
+   rp->client = np;
+   rp->x = x;
+   rp->y = y;
+   rp->width = width;
+   rp->height = height;
 
    /* Fill the client if there's room. */
    if(width > 1 && height > 1) {
-      ColorType fillColor;
       if((np->state.status & STAT_ACTIVE)
          && (np->state.desktop == currentDesktop
          || (np->state.status & STAT_STICKY))) {
-         fillColor = COLOR_PAGER_ACTIVE_FG;
+         rp->fill = COLOR_PAGER_ACTIVE_FG;
       } else if(np->state.status & STAT_FLASH) {
-         fillColor = COLOR_PAGER_ACTIVE_FG;
+         rp->fill = COLOR_PAGER_ACTIVE_FG;
       } else {
-         fillColor = COLOR_PAGER_FG;
+         rp->fill = COLOR_PAGER_FG;
+      }
+      if(pp->preview) {
+         rp->preview = UpdatePreview(np, width - 1, height - 1,
+                                     !pp->cp->tray->suspended);
       }
-      JXSetForeground(display, rootGC, colors[fillColor]);
-      JXFillRectangle(display, pp->cp->pixmap, rootGC, x + 1, y + 1,
-                      width - 1, height - 1);
+   } else {
+      rp->fill = COLOR_COUNT;
    }
 
-}
+   return (int)desktop;
 
+}
@@ -21,9 +21,10 @@ void DestroyPager(void);
 
 /** Create a pager tray component.
  * @param labeled Set to label the pager.
+ * @param preview Set to show live previews of windows.
  * @return A new pager tray component.
  */
-struct TrayComponentType *CreatePager(char labeled);
+struct TrayComponentType *CreatePager(char labeled, char preview);
 
 /** Update pagers. */
 void UpdatePager(void);
@@ -10,6 +10,7 @@
 #include "jwm.h"
 #include "parse.h"
 #include "lex.h"
+#include "configcache.h"
 #include "settings.h"
 #include "menu.h"
 #include "root.h"
@@ -23,19 +24,25 @@
 #include "main.h"
 #include "font.h"
 #include "icon.h"
+#include "icontheme.h"
 #include "command.h"
 #include "taskbar.h"
 #include "traybutton.h"
 #include "clock.h"
+#include "traytext.h"
 #include "dock.h"
 #include "background.h"
 #include "spacer.h"
 #include "desktop.h"
 #include "border.h"
 #include "default.h"
+#include "trace.h"
+#include "stats.h"
+#include "lint.h"
 
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include <fcntl.h>
 #include <errno.h>
 
@@ -159,7 +166,9 @@ static const char *SCREEN_ATTRIBUTE = "screen";
 static const char *DYNAMIC_ATTRIBUTE = "dynamic";
 static const char *SPACING_ATTRIBUTE = "spacing";
 static const char *TIMEOUT_ATTRIBUTE = "timeout";
+static const char *TTL_ATTRIBUTE = "ttl";
 static const char *POPUP_ATTRIBUTE = "popup";
+static const char *PREVIEW_ATTRIBUTE = "preview";
 
 static const char *FALSE_VALUE = "false";
 static const char *TRUE_VALUE = "true";
@@ -172,10 +181,63 @@ static const char * const CONFIG_FILES[] = {
 };
 static const unsigned CONFIG_FILE_COUNT = ARRAY_LENGTH(CONFIG_FILES);
 
+/** Number of bits in ConfigMask that are used. */
+#define CONFIG_SECTION_COUNT 4
+
+/** Sections to apply while parsing. */
+static ConfigMask parseMask = CONFIG_ALL;
+
+/** Hashes of the sections read by the current parse. */
+static unsigned long parseHashes[CONFIG_SECTION_COUNT];
+
+/** Hashes of the sections that are currently applied. */
+static unsigned long configHashes[CONFIG_SECTION_COUNT];
+
+/** Tokens of a menu include.
+ * Includes are read once per parse. The output of a program with a ttl
+ * is also kept for later parses until it expires.
+ */
+typedef struct IncludeNode {
+   char *name;                   /**< The file or "exec:" command. */
+   TokenNode *tokens;            /**< The tokens (NULL if invalid). */
+   TimeType time;                /**< When the tokens were read. */
+   unsigned ttl_ms;              /**< How long to keep the tokens. */
+   char current;                 /**< Set if read during this parse. */
+   struct IncludeNode *next;     /**< The next include. */
+} IncludeNode;
+
+static IncludeNode *includes = NULL;
+
+/** Tokens read while checking a reload for changes.
+ * The same files and programs are read again, in the same order, when
+ * the changes are applied, so the tokens are kept to read each of them
+ * once per reload.
+ */
+typedef struct SavedTokensNode {
+   char *name;                      /**< The file or "exec:" command. */
+   TokenNode *tokens;               /**< The tokens (NULL on error). */
+   struct SavedTokensNode *next;    /**< The next file or command read. */
+} SavedTokensNode;
+
+static SavedTokensNode *savedTokens = NULL;
+
+/** Set while checking for changes to save tokens and hide errors. */
+static char checkingChanges = 0;
+
+static void ParseSections(const char *fileName, ConfigMask mask);
+static void SaveHashes(ConfigMask mask);
+static ConfigMask GetTokenSection(TokenType type);
+static unsigned long HashString(unsigned long hash, const char *str);
+static unsigned long HashTokens(unsigned long hash, const TokenNode *tp);
+static void UpdateHash(ConfigMask section, const TokenNode *tp);
 static void ParseInternal(const char *config);
 static char ParseFile(const char *fileName, int depth);
 static TokenNode *TokenizeFile(const char *fileName);
 static TokenNode *TokenizePipe(const char *command, unsigned timeout_ms);
+static void PrefetchIncludes(const TokenNode *tp);
+static char TakeSavedTokens(const char *name, TokenNode **tokens);
+static void DoneWithTokens(const char *name, TokenNode *tokens);
+static void ReleaseSavedTokens(void);
 
 /* Misc. */
 static void Parse(const TokenNode *start, int depth);
@@ -195,6 +257,8 @@ static MenuItem *ParseMenuInclude(const TokenNode *tp, Menu *menu,
 static TokenNode *ParseMenuIncludeHelper(const TokenNode *tp,
                                          unsigned timeout_ms,
                                          const char *command);
+static const TokenNode *GetMenuIncludeTokens(const TokenNode *tp);
+static void ReleaseIncludes(char all);
 
 /* Tray. */
 typedef void (*AddTrayActionFunc)(TrayComponentType*, const char*, int);
@@ -204,6 +268,7 @@ static void ParseTaskList(const TokenNode *tp, TrayType *tray);
 static void ParseSwallow(const TokenNode *tp, TrayType *tray);
 static void ParseTrayButton(const TokenNode *tp, TrayType *tray);
 static void ParseClock(const TokenNode *tp, TrayType *tray);
+static void ParseTrayText(const TokenNode *tp, TrayType *tray);
 static void ParseTrayComponentActions(const TokenNode *tp,
                                       TrayComponentType *cp,
                                       AddTrayActionFunc func);
@@ -237,6 +302,9 @@ static void ParseSnapMode(const TokenNode *tp);
 static void ParseMoveMode(const TokenNode *tp);
 static void ParseResizeMode(const TokenNode *tp);
 static void ParseFocusModel(const TokenNode *tp);
+static void ParseIconFilter(const TokenNode *tp);
+static void ParseStartupMode(const TokenNode *tp);
+static void ParseStallTimeout(const TokenNode *tp);
 
 static AlignmentType ParseTextAlignment(const TokenNode *tp);
 static void ParseDecorations(const TokenNode *tp, DecorationsType *deco);
@@ -250,6 +318,7 @@ static int ParseAttribute(const StringMappingType *mapping, int count,
 static int ParseSigned(const TokenNode *tp, const char *str);
 static unsigned ParseUnsigned(const TokenNode *tp, const char *str);
 static unsigned ParseTimeout(const TokenNode *tp, unsigned timeout_ms);
+static unsigned ParseTTL(const TokenNode *tp);
 static unsigned int ParseOpacity(const TokenNode *tp, const char *str);
 static WinLayerType ParseLayer(const TokenNode *tp, const char *str);
 static StatusWindowType ParseStatusWindowType(const TokenNode *tp);
@@ -267,6 +336,63 @@ void ParseInternal(const char *config)
 /** Parse the JWM configuration. */
 void ParseConfig(const char *fileName)
 {
+   const TraceTime traceStart = StartTrace();
+   ReleaseSavedTokens();
+   ParseSections(fileName, CONFIG_ALL);
+   SaveHashes(CONFIG_ALL);
+   ReleaseIncludes(0);
+   RecordTrace("ParseConfig", -1, traceStart);
+}
+
+/** Parse only some sections of a configuration file. */
+void ReloadConfig(const char *fileName, ConfigMask mask)
+{
+   ParseSections(fileName, mask);
+   SaveHashes(mask);
+   ReleaseIncludes(0);
+   ReleaseSavedTokens();
+}
+
+/** Release the tokens of menu includes. */
+void DestroyIncludes(void)
+{
+   ReleaseIncludes(1);
+   ReleaseSavedTokens();
+}
+
+/** Determine which sections of a configuration file changed.
+ * The tokens read are kept for ReloadConfig, and errors are left for
+ * it to report.
+ */
+ConfigMask GetConfigChanges(const char *fileName)
+{
+   ConfigMask changes;
+   unsigned int x;
+
+   ReleaseSavedTokens();
+   checkingChanges = 1;
+   ParseSections(fileName, CONFIG_NONE);
+   checkingChanges = 0;
+   changes = CONFIG_NONE;
+   for(x = 0; x < CONFIG_SECTION_COUNT; x++) {
+      if(parseHashes[x] != configHashes[x]) {
+         changes |= 1 << x;
+      }
+   }
+   return changes;
+}
+
+/** Parse the selected sections of the configuration. */
+void ParseSections(const char *fileName, ConfigMask mask)
+{
+   const StatsTime start = StartStats();
+   unsigned int x;
+
+   parseMask = mask;
+   for(x = 0; x < CONFIG_SECTION_COUNT; x++) {
+      parseHashes[x] = 5381;
+   }
+
    ParseInternal(BASE_CONFIG);
    if(fileName) {
       if(!ParseFile(fileName, 0)) {
@@ -285,8 +411,82 @@ void ParseConfig(const char *fileName)
       ParseInternal(DEFAULT_CONFIG);
    }
 ConfigFileFound:
-   ValidateTrayButtons();
-   ValidateKeys();
+   if(mask != CONFIG_NONE) {
+      ValidateTrayButtons();
+      ValidateKeys();
+      LintBindings();
+   }
+   parseMask = CONFIG_ALL;
+   RecordSectionStats(SECTION_PARSE, start);
+}
+
+/** Record the hashes for sections that were applied. */
+void SaveHashes(ConfigMask mask)
+{
+   unsigned int x;
+   for(x = 0; x < CONFIG_SECTION_COUNT; x++) {
+      if(mask & (1 << x)) {
+         configHashes[x] = parseHashes[x];
+      }
+   }
+}
+
+/** Get the configuration section for a top-level tag. */
+ConfigMask GetTokenSection(TokenType type)
+{
+   switch(type) {
+   case TOK_ROOTMENU:
+      return CONFIG_MENUS;
+   case TOK_KEY:
+   case TOK_MOUSE:
+      return CONFIG_BINDINGS;
+   case TOK_GROUP:
+      return CONFIG_GROUPS;
+   default:
+      return CONFIG_OTHER;
+   }
+}
+
+/** Add a string to a hash. */
+unsigned long HashString(unsigned long hash, const char *str)
+{
+   if(str) {
+      while(*str) {
+         hash = (hash * 33) ^ (unsigned char)*str;
+         str += 1;
+      }
+   }
+   return (hash * 33) ^ 0xFF;
+}
+
+/** Add a tag, its attributes, and its children to a hash. */
+unsigned long HashTokens(unsigned long hash, const TokenNode *tp)
+{
+   const AttributeNode *ap;
+   const TokenNode *np;
+
+   hash = (hash * 33) ^ (unsigned long)tp->type;
+   hash = HashString(hash, tp->invalidName);
+   hash = HashString(hash, tp->value);
+   for(ap = tp->attributes; ap; ap = ap->next) {
+      hash = HashString(hash, ap->name);
+      hash = HashString(hash, ap->value);
+   }
+   for(np = tp->subnodeHead; np; np = np->next) {
+      hash = HashTokens(hash, np);
+   }
+   return (hash * 33) ^ 0xFE;
+}
+
+/** Add a top-level tag to the hash for its section. */
+void UpdateHash(ConfigMask section, const TokenNode *tp)
+{
+   unsigned int x;
+   for(x = 0; x < CONFIG_SECTION_COUNT; x++) {
+      if(section & (1 << x)) {
+         parseHashes[x] = HashTokens(parseHashes[x], tp);
+      }
+   }
 }
 
 /**
@@ -295,6 +495,7 @@ ConfigFileFound:
  */
 char ParseFile(const char *fileName, int depth)
 {
+   LintTime lintStart;
    TokenNode *tokens;
 
    depth += 1;
@@ -304,15 +505,24 @@ char ParseFile(const char *fileName, int depth)
       return 0;
    }
 
-   tokens = TokenizeFile(fileName);
-   if(!tokens) {
-      return 0;
+   /* The cache covers the top-level file and everything it includes. */
+   if(depth == 1) {
+      OpenConfigCache(fileName);
+   }
+   lintStart = StartLintTime();
+   if(!TakeSavedTokens(fileName, &tokens)) {
+      tokens = TokenizeFile(fileName);
+   }
+   if(tokens) {
+      Parse(tokens, depth);
+      RecordParseTime(fileName, depth, lintStart);
+   }
+   DoneWithTokens(fileName, tokens);
+   if(depth == 1) {
+      CloseConfigCache();
    }
 
-   Parse(tokens, depth);
-   ReleaseTokens(tokens);
-
-   return 1;
+   return tokens != NULL;
 }
 
 /** Parse a token list. */
@@ -325,122 +535,145 @@ void Parse(const TokenNode *start, int depth)
       return;
    }
 
+   PrefetchIncludes(start);
    if(JLIKELY(start->type == TOK_JWM)) {
       for(tp = start->subnodeHead; tp; tp = tp->next) {
-         if(shouldReload) {
-            switch(tp->type) {
-            case TOK_ROOTMENU:
-               ParseRootMenu(tp);
-               break;
-            case TOK_INCLUDE:
-               ParseInclude(tp, depth);
-               break;
-            default:
-               break;
-            }
-         } else {
-            switch(tp->type) {
-            case TOK_DESKTOPS:
-               ParseDesktops(tp);
-               break;
-            case TOK_DOUBLECLICKSPEED:
-               settings.doubleClickSpeed = ParseUnsigned(tp, tp->value);
-               break;
-            case TOK_DOUBLECLICKDELTA:
-               settings.doubleClickDelta = ParseUnsigned(tp, tp->value);
-               break;
-            case TOK_FOCUSMODEL:
-               ParseFocusModel(tp);
-               break;
-            case TOK_GROUP:
-               ParseGroup(tp);
-               break;
-            case TOK_ICONPATH:
-               AddIconPath(tp->value);
-               break;
-            case TOK_INCLUDE:
-               ParseInclude(tp, depth);
-               break;
-            case TOK_KEY:
-               ParseKey(tp);
-               break;
-            case TOK_MOUSE:
-               ParseMouse(tp);
-               break;
-            case TOK_MENUSTYLE:
-               ParseMenuStyle(tp);
-               break;
-            case TOK_MOVEMODE:
-               ParseMoveMode(tp);
-               break;
-            case TOK_PAGERSTYLE:
-               ParsePagerStyle(tp);
-               break;
-            case TOK_POPUPSTYLE:
-               ParsePopupStyle(tp);
-               break;
-            case TOK_RESIZEMODE:
-               ParseResizeMode(tp);
-               break;
-            case TOK_RESTARTCOMMAND:
-               AddRestartCommand(tp->value);
-               break;
-            case TOK_ROOTMENU:
-               ParseRootMenu(tp);
-               break;
-            case TOK_SHUTDOWNCOMMAND:
-               AddShutdownCommand(tp->value);
-               break;
-            case TOK_SNAPMODE:
-               ParseSnapMode(tp);
-               break;
-            case TOK_STARTUPCOMMAND:
-               AddStartupCommand(tp->value);
-               break;
-            case TOK_TRAY:
-               ParseTray(tp);
-               break;
-            case TOK_TRAYSTYLE:
-               ParseTrayStyle(tp, FONT_TRAY, COLOR_TRAY_FG);
-               break;
-            case TOK_TASKLISTSTYLE:
-               ParseTrayStyle(tp, FONT_TASKLIST, COLOR_TASKLIST_FG);
-               break;
-            case TOK_TRAYBUTTONSTYLE:
-               ParseTrayStyle(tp, FONT_TRAYBUTTON, COLOR_TRAYBUTTON_FG);
-               break;
-            case TOK_CLOCKSTYLE:
-               ParseClockStyle(tp);
-               break;
-            case TOK_WINDOWSTYLE:
-               ParseWindowStyle(tp);
-               break;
-            case TOK_BUTTONCLOSE:
-               SetBorderIcon(BI_CLOSE, tp->value);
-               break;
-            case TOK_BUTTONMAX:
-               SetBorderIcon(BI_MAX, tp->value);
-               break;
-            case TOK_BUTTONMAXACTIVE:
-               SetBorderIcon(BI_MAX_ACTIVE, tp->value);
-               break;
-            case TOK_BUTTONMIN:
-               SetBorderIcon(BI_MIN, tp->value);
-               break;
-            case TOK_BUTTONMENU:
-               SetBorderIcon(BI_MENU, tp->value);
-               break;
-            case TOK_DEFAULTICON:
-               SetDefaultIcon(tp->value);
-               break;
-            case TOK_TITLEBUTTONORDER:
-               SetTitleButtonOrder(tp->value);
-               break;
-            default:
-               InvalidTag(tp, TOK_JWM);
-               break;
+         if(tp->type != TOK_INCLUDE) {
+            /* Includes are always read; the tags they contain are
+             * hashed and filtered individually. */
+            const ConfigMask section = GetTokenSection(tp->type);
+            UpdateHash(section, tp);
+            if(!(parseMask & section)) {
+               continue;
             }
          }
+         switch(tp->type) {
+         case TOK_DESKTOPS:
+            ParseDesktops(tp);
+            break;
+         case TOK_DOUBLECLICKSPEED:
+            settings.doubleClickSpeed = ParseUnsigned(tp, tp->value);
+            break;
+         case TOK_DOUBLECLICKDELTA:
+            settings.doubleClickDelta = ParseUnsigned(tp, tp->value);
+            break;
+         case TOK_FOCUSDELAY:
+            settings.focusDelay = ParseUnsigned(tp, tp->value);
+            break;
+         case TOK_FOCUSMODEL:
+            ParseFocusModel(tp);
+            break;
+         case TOK_ICONFILTER:
+            ParseIconFilter(tp);
+            break;
+         case TOK_ICONMEMORY:
+            settings.iconMemory = ParseUnsigned(tp, tp->value);
+            break;
+         case TOK_LOWMEMORY:
+            settings.lowMemory = tp->value && !strcmp(tp->value, TRUE_VALUE);
+            break;
+         case TOK_INPUTPRIORITY:
+            settings.inputPriority
+               = tp->value && !strcmp(tp->value, TRUE_VALUE);
+            break;
+         case TOK_GROUP:
+            ParseGroup(tp);
+            break;
+         case TOK_ICONPATH:
+            LintIconPath(tp);
+            AddIconPath(tp->value);
+            break;
+         case TOK_ICONTHEME:
+            SetIconTheme(tp->value);
+            break;
+         case TOK_INCLUDE:
+            ParseInclude(tp, depth);
+            break;
+         case TOK_KEY:
+            ParseKey(tp);
+            break;
+         case TOK_MOUSE:
+            ParseMouse(tp);
+            break;
+         case TOK_MENUSTYLE:
+            ParseMenuStyle(tp);
+            break;
+         case TOK_MOVEMODE:
+            ParseMoveMode(tp);
+            break;
+         case TOK_PAGERSTYLE:
+            ParsePagerStyle(tp);
+            break;
+         case TOK_POPUPSTYLE:
+            ParsePopupStyle(tp);
+            break;
+         case TOK_RESIZEMODE:
+            ParseResizeMode(tp);
+            break;
+         case TOK_RESTARTCOMMAND:
+            AddRestartCommand(tp->value);
+            break;
+         case TOK_ROOTMENU:
+            ParseRootMenu(tp);
+            break;
+         case TOK_SHUTDOWNCOMMAND:
+            AddShutdownCommand(tp->value);
+            break;
+         case TOK_SNAPMODE:
+            ParseSnapMode(tp);
+            break;
+         case TOK_STALLTIMEOUT:
+            ParseStallTimeout(tp);
+            break;
+         case TOK_STARTUPCOMMAND:
+            AddStartupCommand(tp->value);
+            break;
+         case TOK_STARTUPMODE:
+            ParseStartupMode(tp);
+            break;
+         case TOK_TRAY:
+            ParseTray(tp);
+            break;
+         case TOK_TRAYSTYLE:
+            ParseTrayStyle(tp, FONT_TRAY, COLOR_TRAY_FG);
+            break;
+         case TOK_TASKLISTSTYLE:
+            ParseTrayStyle(tp, FONT_TASKLIST, COLOR_TASKLIST_FG);
+            break;
+         case TOK_TRAYBUTTONSTYLE:
+            ParseTrayStyle(tp, FONT_TRAYBUTTON, COLOR_TRAYBUTTON_FG);
+            break;
+         case TOK_CLOCKSTYLE:
+            ParseClockStyle(tp);
+            break;
+         case TOK_WINDOWSTYLE:
+            ParseWindowStyle(tp);
+            break;
+         case TOK_BUTTONCLOSE:
+            SetBorderIcon(BI_CLOSE, tp->value);
+            break;
+         case TOK_BUTTONMAX:
+            SetBorderIcon(BI_MAX, tp->value);
+            break;
+         case TOK_BUTTONMAXACTIVE:
+            SetBorderIcon(BI_MAX_ACTIVE, tp->value);
+            break;
+         case TOK_BUTTONMIN:
+            SetBorderIcon(BI_MIN, tp->value);
+            break;
+         case TOK_BUTTONMENU:
+            SetBorderIcon(BI_MENU, tp->value);
+            break;
+         case TOK_DEFAULTICON:
+            SetDefaultIcon(tp->value);
+            break;
+         case TOK_TITLEBUTTONORDER:
+            SetTitleButtonOrder(tp->value);
+            break;
+         default:
+            InvalidTag(tp, TOK_JWM);
+            break;
+         }
       }
    } else {
       ParseError(start, _("invalid start tag: %s"), GetTokenName(start));
@@ -460,6 +693,40 @@ void ParseFocusModel(const TokenNode *tp) {
                                          settings.focusModel);
 }
 
+/** Parse the filter used to scale icons. */
+void ParseIconFilter(const TokenNode *tp)
+{
+   static const StringMappingType mapping[] = {
+      { "best",      ICON_FILTER_BEST     },
+      { "bilinear",  ICON_FILTER_BILINEAR },
+      { "good",      ICON_FILTER_GOOD     },
+      { "nearest",   ICON_FILTER_NEAREST  }
+   };
+   settings.iconFilter = ParseTokenValue(mapping, ARRAY_LENGTH(mapping), tp,
+                                         settings.iconFilter);
+}
+
+/** Parse the startup mode. */
+void ParseStartupMode(const TokenNode *tp)
+{
+   static const StringMappingType mapping[] = {
+      { "fast",      STARTUP_FAST   },
+      { "normal",    STARTUP_NORMAL }
+   };
+   settings.startupMode = ParseTokenValue(mapping, ARRAY_LENGTH(mapping), tp,
+                                          settings.startupMode);
+}
+
+/** Parse the stall watchdog timeout. */
+void ParseStallTimeout(const TokenNode *tp)
+{
+   const char *backtrace;
+
+   backtrace = FindAttribute(tp->attributes, "backtrace");
+   settings.stallBacktrace = backtrace && !strcmp(backtrace, TRUE_VALUE);
+   settings.stallTimeout = ParseUnsigned(tp, tp->value);
+}
+
 /** Parse snap mode for moving windows. */
 void ParseSnapMode(const TokenNode *tp)
 {
@@ -495,6 +762,10 @@ void ParseMoveMode(const TokenNode *tp)
    if(str && *str) {
       settings.moveMask = ParseModifierString(str);
    }
+   str = FindAttribute(tp->attributes, "rate");
+   if(str) {
+      settings.moveRate = ParseUnsigned(tp, str);
+   }
 
    settings.moveStatusType = ParseStatusWindowType(tp);
    settings.moveMode = ParseTokenValue(mapping, ARRAY_LENGTH(mapping), tp,
@@ -504,10 +775,15 @@ void ParseMoveMode(const TokenNode *tp)
 /** Parse resize mode. */
 void ParseResizeMode(const TokenNode *tp)
 {
+   const char *str;
    static const StringMappingType mapping[] = {
       { "opaque",    RESIZE_OPAQUE  },
       { "outline",   RESIZE_OUTLINE }
    };
+   str = FindAttribute(tp->attributes, "rate");
+   if(str) {
+      settings.resizeRate = ParseUnsigned(tp, str);
+   }
    settings.resizeStatusType = ParseStatusWindowType(tp);
    settings.resizeMode = ParseTokenValue(mapping, ARRAY_LENGTH(mapping), tp,
                                          settings.resizeMode);
@@ -563,6 +839,9 @@ void ParseRootMenu(const TokenNode *start)
    value = FindAttribute(start->attributes, DYNAMIC_ATTRIBUTE);
    menu->dynamic = CopyString(value);
    menu->timeout_ms = ParseTimeout(start, MENU_TIMEOUT_MS);
+   menu->ttl_ms = ParseTTL(start);
+   LintDynamicMenu(start, menu->dynamic, menu->timeout_ms, menu->ttl_ms);
+   LintMenu(start, menu);
 
    SetRootMenu(onroot, menu);
 }
@@ -608,6 +887,9 @@ MenuItem *ParseMenuItem(const TokenNode *start, Menu *menu, MenuItem *last)
          last->action.type = MA_DYNAMIC;
          last->action.str = CopyString(start->value);
          last->action.timeout_ms = ParseTimeout(start, MENU_TIMEOUT_MS);
+         last->action.ttl_ms = ParseTTL(start);
+         LintDynamicMenu(start, last->action.str, last->action.timeout_ms,
+                         last->action.ttl_ms);
 
          value = FindAttribute(start->attributes, HEIGHT_ATTRIBUTE);
          if(value) {
@@ -826,8 +1108,10 @@ TokenNode *ParseMenuIncludeHelper(const TokenNode *tp,
                                   unsigned timeout_ms,
                                   const char *command)
 {
+   const LintTime lintStart = StartLintTime();
    TokenNode *start;
    if(!strncmp(command, "exec:", 5)) {
+      LintInclude(tp, timeout_ms);
       start = TokenizePipe(&command[5], timeout_ms);
    } else {
       start = TokenizeFile(command);
@@ -840,6 +1124,8 @@ TokenNode *ParseMenuIncludeHelper(const TokenNode *tp,
       return NULL;
    }
 
+   PrefetchIncludes(start);
+   RecordParseTime(command, 1, lintStart);
    return start;
 }
 
@@ -847,17 +1133,134 @@ TokenNode *ParseMenuIncludeHelper(const TokenNode *tp,
 MenuItem *ParseMenuInclude(const TokenNode *tp, Menu *menu,
                            MenuItem *last)
 {
-   TokenNode *start;
-   const unsigned timeout_ms = ParseTimeout(tp, INCLUDE_TIMEOUT_MS);
-
-   start = ParseMenuIncludeHelper(tp, timeout_ms, tp->value);
+   const TokenNode *start = GetMenuIncludeTokens(tp);
    if(JLIKELY(start)) {
       last = ParseMenuItem(start->subnodeHead, menu, last);
-      ReleaseTokens(start);
    }
    return last;
 }
 
+/** Get the tokens of a menu include, reading them if needed.
+ * Files are read once per parse; unchanged files are also kept across
+ * restarts by the configuration cache. The output of a program is
+ * reused until its ttl expires.
+ * @return The tokens (owned by the include list, NULL on error).
+ */
+const TokenNode *GetMenuIncludeTokens(const TokenNode *tp)
+{
+   IncludeNode *ip;
+   TimeType now;
+
+   if(JUNLIKELY(!tp->value)) {
+      ParseError(tp, _("no include file specified"));
+      return NULL;
+   }
+
+   GetCurrentTime(&now);
+   for(ip = includes; ip; ip = ip->next) {
+      if(!strcmp(ip->name, tp->value)) {
+         if(  ip->current
+            || GetTimeDifference(&now, &ip->time) < ip->ttl_ms) {
+            ip->current = 1;
+            return ip->tokens;
+         }
+         ReleaseTokens(ip->tokens);
+         break;
+      }
+   }
+   if(!ip) {
+      ip = Allocate(sizeof(IncludeNode));
+      ip->name = CopyString(tp->value);
+      ip->next = includes;
+      includes = ip;
+   }
+
+   ip->tokens = ParseMenuIncludeHelper(tp,
+                                       ParseTimeout(tp, INCLUDE_TIMEOUT_MS),
+                                       tp->value);
+   ip->time = now;
+   ip->ttl_ms = strncmp(tp->value, "exec:", 5) ? 0 : ParseTTL(tp);
+   ip->current = 1;
+   return ip->tokens;
+}
+
+/** Release menu includes.
+ * @param all Set to release everything, otherwise only program output
+ *            with an unexpired ttl is kept.
+ */
+void ReleaseIncludes(char all)
+{
+   IncludeNode **ipp = &includes;
+   TimeType now;
+
+   GetCurrentTime(&now);
+   while(*ipp) {
+      IncludeNode *ip = *ipp;
+      if(  all || !ip->tokens
+         || GetTimeDifference(&now, &ip->time) >= ip->ttl_ms) {
+         *ipp = ip->next;
+         ReleaseTokens(ip->tokens);
+         Release(ip->name);
+         Release(ip);
+      } else {
+         ip->current = 0;
+         ipp = &ip->next;
+      }
+   }
+}
+
+/** Take the tokens saved for a file or command by GetConfigChanges.
+ * @param name The file or "exec:" command.
+ * @param tokens Set to the saved tokens (NULL if it could not be read).
+ * @return 1 if the tokens were saved, 0 if they must be read.
+ */
+char TakeSavedTokens(const char *name, TokenNode **tokens)
+{
+   SavedTokensNode **spp;
+   for(spp = &savedTokens; *spp; spp = &(*spp)->next) {
+      SavedTokensNode *sp = *spp;
+      if(!strcmp(sp->name, name)) {
+         *spp = sp->next;
+         *tokens = sp->tokens;
+         Release(sp->name);
+         Release(sp);
+         return 1;
+      }
+   }
+   return 0;
+}
+
+/** Release the tokens of a file or command once parsed.
+ * While checking for changes, the tokens are saved instead.
+ */
+void DoneWithTokens(const char *name, TokenNode *tokens)
+{
+   SavedTokensNode **spp;
+   if(!checkingChanges) {
+      ReleaseTokens(tokens);
+      return;
+   }
+
+   /* Keep the order read so a file included twice is found twice. */
+   for(spp = &savedTokens; *spp; spp = &(*spp)->next);
+   *spp = Allocate(sizeof(SavedTokensNode));
+   (*spp)->name = CopyString(name);
+   (*spp)->tokens = tokens;
+   (*spp)->next = NULL;
+}
+
+/** Release tokens saved by GetConfigChanges that were not used. */
+void ReleaseSavedTokens(void)
+{
+   while(savedTokens) {
+      SavedTokensNode *next = savedTokens->next;
+      ReleaseTokens(savedTokens->tokens);
+      Release(savedTokens->name);
+      Release(savedTokens);
+      savedTokens = next;
+   }
+}
+
 /** Parse a dynamic menu (called from menu code). */
 Menu *ParseDynamicMenu(unsigned timeout_ms, const char *command)
 {
@@ -866,10 +1269,26 @@ Menu *ParseDynamicMenu(unsigned timeout_ms, const char *command)
    if(JLIKELY(start)) {
       menu = ParseMenu(start);
       ReleaseTokens(start);
+      ReleaseIncludes(0);
    }
    return menu;
 }
 
+/** Parse the output of a dynamic menu command (called from menu code). */
+Menu *ParseDynamicMenuOutput(const char *command, const char *output)
+{
+   Menu *menu = NULL;
+   TokenNode *start = Tokenize(output, command);
+   if(JLIKELY(start && start->type == TOK_JWM)) {
+      menu = ParseMenu(start);
+      ReleaseIncludes(0);
+   } else {
+      ParseError(NULL, _("invalid include: %s"), command);
+   }
+   ReleaseTokens(start);
+   return menu;
+}
+
 /** Parse an action. */
 ActionType ParseAction(const char *str, const char **command)
 {
@@ -1080,13 +1499,19 @@ void ParseInclude(const TokenNode *tp, int depth)
 
    timeout_ms = ParseTimeout(tp, INCLUDE_TIMEOUT_MS);
    if(!strncmp(tp->value, "exec:", 5)) {
-      TokenNode *tokens = TokenizePipe(&tp->value[5], timeout_ms);
+      const LintTime lintStart = StartLintTime();
+      TokenNode *tokens;
+      LintInclude(tp, timeout_ms);
+      if(!TakeSavedTokens(tp->value, &tokens)) {
+         tokens = TokenizePipe(&tp->value[5], timeout_ms);
+      }
       if(JLIKELY(tokens)) {
          Parse(tokens, 0);
-         ReleaseTokens(tokens);
+         RecordParseTime(tp->value, depth + 1, lintStart);
       } else {
          ParseError(tp, _("could not process include: %s"), &tp->value[5]);
       }
+      DoneWithTokens(tp->value, tokens);
    } else {
       if(JUNLIKELY(!ParseFile(tp->value, depth))) {
          ParseError(tp, _("could not open included file: %s"), tp->value);
@@ -1173,6 +1598,7 @@ void ParseDesktop(int desktop, const TokenNode *tp) {
 void ParseDesktopBackground(int desktop, const TokenNode *tp)
 {
    const char *type = FindAttribute(tp->attributes, "type");
+   LintBackground(tp, type);
    SetBackground(desktop, type, tp->value);
 }
 
@@ -1356,6 +1782,9 @@ void ParseTray(const TokenNode *tp)
       case TOK_CLOCK:
          ParseClock(np, tray);
          break;
+      case TOK_TRAYTEXT:
+         ParseTrayText(np, tray);
+         break;
       case TOK_DOCK:
          ParseDock(np, tray);
          break;
@@ -1377,6 +1806,7 @@ void ParsePager(const TokenNode *tp, TrayType *tray)
    TrayComponentType *cp;
    const char *temp;
    int labeled;
+   int preview;
 
    Assert(tp);
    Assert(tray);
@@ -1386,7 +1816,12 @@ void ParsePager(const TokenNode *tp, TrayType *tray)
    if(temp && !strcmp(temp, TRUE_VALUE)) {
       labeled = 1;
    }
-   cp = CreatePager(labeled);
+   preview = 0;
+   temp = FindAttribute(tp->attributes, PREVIEW_ATTRIBUTE);
+   if(temp && !strcmp(temp, TRUE_VALUE)) {
+      preview = 1;
+   }
+   cp = CreatePager(labeled, preview);
    AddTrayComponent(tray, cp);
 
 }
@@ -1564,6 +1999,41 @@ void ParseClock(const TokenNode *tp, TrayType *tray)
 
 }
 
+/** Parse a text tray component. */
+void ParseTrayText(const TokenNode *tp, TrayType *tray)
+{
+   TrayComponentType *cp;
+   const char *command;
+   const char *temp;
+   int width, height;
+
+   Assert(tp);
+   Assert(tray);
+
+   command = FindAttribute(tp->attributes, "command");
+
+   temp = FindAttribute(tp->attributes, WIDTH_ATTRIBUTE);
+   if(temp) {
+      width = ParseUnsigned(tp, temp);
+   } else {
+      width = 0;
+   }
+
+   temp = FindAttribute(tp->attributes, HEIGHT_ATTRIBUTE);
+   if(temp) {
+      height = ParseUnsigned(tp, temp);
+   } else {
+      height = 0;
+   }
+
+   cp = CreateTrayText(command, width, height);
+   if(JLIKELY(cp)) {
+      ParseTrayComponentActions(tp, cp, AddTrayTextAction);
+      AddTrayComponent(tray, cp);
+   }
+
+}
+
 /** Parse tray component actions. */
 void ParseTrayComponentActions(const TokenNode *tp, TrayComponentType *cp,
                                AddTrayActionFunc func)
@@ -1669,9 +2139,15 @@ void ParsePagerStyle(const TokenNode *tp)
 {
 
    const TokenNode *np;
+   const char *str;
 
    Assert(tp);
 
+   str = FindAttribute(tp->attributes, "rate");
+   if(str) {
+      settings.pagerRate = ParseUnsigned(tp, str);
+   }
+
    for(np = tp->subnodeHead; np; np = np->next) {
       switch(np->type) {
       case TOK_OUTLINE:
@@ -1833,15 +2309,18 @@ void ParseGroup(const TokenNode *tp)
    for(np = tp->subnodeHead; np; np = np->next) {
       switch(np->type) {
       case TOK_CLASS:
+         LintPattern(np);
          AddGroupClass(group, np->value);
          break;
       case TOK_NAME:
+         LintPattern(np);
          AddGroupName(group, np->value);
          break;
       case TOK_TYPE:
          AddGroupType(group, np->value);
          break;
       case TOK_MACHINE:
+         LintPattern(np);
          AddGroupMachine(group, np->value);
          break;
       case TOK_OPTION:
@@ -2013,36 +2492,93 @@ TokenNode *TokenizeFile(const char *fileName)
    char *path;
    char *buffer;
    ssize_t offset;
+   int fd;
+   char mapped;
 
    path = CopyString(fileName);
    ExpandPath(&path);
 
-   int fd = open(path, O_RDONLY);
-   Release(path);
-
+   fd = open(path, O_RDONLY);
    if(fd < 0) {
+      Release(path);
       return NULL;
    }
    if(JUNLIKELY(fstat(fd, &sbuf) == -1)) {
+      Release(path);
       close(fd);
       return NULL;
    }
-   buffer = Allocate(sbuf.st_size + 1);
-   offset = 0;
-   while(offset < sbuf.st_size) {
-      const ssize_t rc = read(fd, &buffer[offset], sbuf.st_size - offset);
-      if(rc <= 0) {
-         break;
+
+   tokens = GetCachedTokens(path, &sbuf, fileName);
+   if(tokens) {
+      Release(path);
+      close(fd);
+      return tokens;
+   }
+
+   /* Map the file unless it ends on a page boundary: the rest of the
+    * last page reads as zero, which terminates the buffer. */
+   mapped = 0;
+   if(sbuf.st_size > 0 && sbuf.st_size % sysconf(_SC_PAGESIZE) != 0) {
+      buffer = mmap(NULL, sbuf.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if(JLIKELY(buffer != MAP_FAILED)) {
+         tokens = Tokenize(buffer, fileName);
+         munmap(buffer, sbuf.st_size);
+         mapped = 1;
       }
-      offset += rc;
    }
-   buffer[offset] = 0;
-   tokens = Tokenize(buffer, fileName);
-   Release(buffer);
+
+   /* Read the file if it could not be mapped. */
+   if(!mapped) {
+      buffer = Allocate(sbuf.st_size + 1);
+      offset = 0;
+      while(offset < sbuf.st_size) {
+         const ssize_t rc = read(fd, &buffer[offset], sbuf.st_size - offset);
+         if(rc <= 0) {
+            break;
+         }
+         offset += rc;
+      }
+      buffer[offset] = 0;
+      tokens = Tokenize(buffer, fileName);
+      Release(buffer);
+   }
    close(fd);
+
+   if(tokens) {
+      CacheTokens(path, &sbuf, tokens);
+   }
+   Release(path);
    return tokens;
 }
 
+/** Start reading the files included by a token tree.
+ * The files are still tokenized one at a time, in order, as they are
+ * parsed, but the reads of all of them are queued up front so the
+ * kernel can fetch them while earlier files are being tokenized.
+ */
+void PrefetchIncludes(const TokenNode *tp)
+{
+#if defined(HAVE_POSIX_FADVISE) && defined(POSIX_FADV_WILLNEED)
+   for(; tp; tp = tp->next) {
+      if(tp->type == TOK_INCLUDE && tp->value
+         && strncmp(tp->value, "exec:", 5)) {
+         char *path = CopyString(tp->value);
+         int fd;
+         ExpandPath(&path);
+         fd = open(path, O_RDONLY);
+         if(fd >= 0) {
+            (void)posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+            close(fd);
+         }
+         Release(path);
+      } else if(tp->subnodeHead) {
+         PrefetchIncludes(tp->subnodeHead);
+      }
+   }
+#endif
+}
+
 /** Tokenize the output of a command. */
 TokenNode *TokenizePipe(const char *command, unsigned timeout_ms)
 {
@@ -2109,6 +2645,13 @@ unsigned ParseTimeout(const TokenNode *tp, unsigned timeout_ms)
    return timeout_ms;
 }
 
+/** Parse the cache lifetime of a dynamic menu. */
+unsigned ParseTTL(const TokenNode *tp)
+{
+   const char *temp = FindAttribute(tp->attributes, TTL_ATTRIBUTE);
+   return temp ? ParseUnsigned(tp, temp) : 0;
+}
+
 /** Parse opacity (a float between 0.0 and 1.0). */
 unsigned ParseOpacity(const TokenNode *tp, const char *str)
 {
@@ -2175,6 +2718,11 @@ void ParseError(const TokenNode *tp, const char *str, ...)
 
    char *msg;
 
+   /* Errors are reported when the changes are applied. */
+   if(checkingChanges) {
+      return;
+   }
+
    va_start(ap, str);
 
    if(tp) {
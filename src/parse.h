@@ -12,11 +12,38 @@
 
 struct Menu;
 
+/** Sections of the configuration that can be reloaded separately. */
+typedef unsigned char ConfigMask;
+#define CONFIG_NONE        0           /**< Nothing. */
+#define CONFIG_MENUS       (1 << 0)    /**< Root menus. */
+#define CONFIG_BINDINGS    (1 << 1)    /**< Key and mouse bindings. */
+#define CONFIG_GROUPS      (1 << 2)    /**< Program groups. */
+#define CONFIG_OTHER       (1 << 3)    /**< Everything else. */
+#define CONFIG_ALL         0x0F        /**< All sections. */
+
 /** Parse a configuration file.
  * @param fileName The user-specified config file to parse.
  */
 void ParseConfig(const char *fileName);
 
+/** Parse only some sections of a configuration file.
+ * The caller is responsible for clearing the old data for the sections.
+ * @param fileName The user-specified config file to parse.
+ * @param mask The sections to parse.
+ */
+void ReloadConfig(const char *fileName, ConfigMask mask);
+
+/** Determine which sections of a configuration file changed.
+ * This reads the configuration without applying it and compares it to
+ * the configuration that was last parsed.
+ * @param fileName The user-specified config file to check.
+ * @return The sections that changed.
+ */
+ConfigMask GetConfigChanges(const char *fileName);
+
+/** Release the menu includes kept between parses. */
+void DestroyIncludes(void);
+
 /** Parse a dynamic menu.
  * @param timeout_ms The timeout in milliseconds.
  * @param command The command to generate the menu.
@@ -24,5 +51,12 @@ void ParseConfig(const char *fileName);
  */
 struct Menu *ParseDynamicMenu(unsigned timeout_ms, const char *command);
 
+/** Parse the output of a dynamic menu command.
+ * @param command The command that generated the output.
+ * @param output The output of the command.
+ * @return The menu (NULL if the output is invalid).
+ */
+struct Menu *ParseDynamicMenuOutput(const char *command, const char *output);
+
 #endif /* PARSE_H */
 
@@ -16,6 +16,7 @@
 #include "settings.h"
 #include "clientlist.h"
 #include "misc.h"
+#include "stats.h"
 
 typedef struct Strut {
    ClientNode *client;
@@ -25,26 +26,70 @@ typedef struct Strut {
 
 static Strut *struts = NULL;
 
+/** Maximum number of struts read for a client (one per edge). */
+#define CLIENT_STRUT_COUNT 4
+
+/** Usable area of a screen for a layer. */
+typedef struct Workarea {
+   BoundingBox box;
+   char valid;
+} Workarea;
+
+/* (screenCount + 1) x LAYER_COUNT for workareaDesktop.
+ * The last screen is the whole root window. */
+static Workarea *workareas = NULL;
+static unsigned int workareaDesktop;
+
+/* The area last written to _NET_WORKAREA. */
+static BoundingBox publishedWorkarea;
+static int publishedDesktopCount = 0;
+
+/** Frame rectangle of a client considered by tiled placement. */
+typedef struct TileRect {
+   int x1, y1;
+   int x2, y2;
+} TileRect;
+
 /* desktopCount x screenCount */
 /* Note that we assume x and y are 0 based for all screens here. */
 static int *cascadeOffsets = NULL;
 
 static char DoRemoveClientStrut(ClientNode *np);
 static void InsertStrut(const BoundingBox *box, ClientNode *np);
+static void InvalidateStrutArea(const BoundingBox *box,
+                                const ClientNode *np);
+static void AddStrutBox(BoundingBox *boxes, unsigned int *count,
+                        long x, long y, long width, long height);
+static char IsStrutChanged(const ClientNode *np, const BoundingBox *boxes,
+                           unsigned int count);
 static void CenterClient(const BoundingBox *box, ClientNode *np);
 static int IntComparator(const void *a, const void *b);
+static int TileRectComparator(const void *a, const void *b);
+static int UniqueCoordinates(int *values, int count);
 static int TryTileClient(const BoundingBox *box, ClientNode *np,
-                         int x, int y);
-static char TileClient(const BoundingBox *box, ClientNode *np);
+                         int x, int y, const TileRect *rects,
+                         int rectCount, int limit);
 static void CascadeClient(const BoundingBox *box, ClientNode *np);
 
 static void SubtractStrutBounds(BoundingBox *box, const ClientNode *np);
 static void SubtractBounds(const BoundingBox *src, BoundingBox *dest);
 static void SubtractTrayBounds(BoundingBox *box, unsigned int layer);
+static void GetWorkarea(const ScreenType *sp, unsigned int layer,
+                        const ClientNode *np, BoundingBox *box);
+static char HasStrut(const ClientNode *np);
 static void SetWorkarea(void);
+static void AllocatePlacement(void);
+static void ReconfigureClient(ClientNode *np);
 
 /** Startup placement. */
 void StartupPlacement(void)
+{
+   AllocatePlacement();
+   SetWorkarea();
+}
+
+/** Allocate the per-screen placement data. */
+void AllocatePlacement(void)
 {
    const unsigned titleHeight = GetTitleHeight();
    int count;
@@ -57,7 +102,91 @@ void StartupPlacement(void)
       cascadeOffsets[x] = settings.borderWidth + titleHeight;
    }
 
+   count = (GetScreenCount() + 1) * LAYER_COUNT;
+   workareas = Allocate(count * sizeof(Workarea));
+   InvalidateWorkarea();
+}
+
+/** Update placement after the screen geometry changed. */
+void ReconfigurePlacement(void)
+{
+   ClientNode *np;
+   unsigned int layer;
+
+   Release(cascadeOffsets);
+   Release(workareas);
+   AllocatePlacement();
    SetWorkarea();
+
+   for(layer = 0; layer < LAYER_COUNT; layer++) {
+      for(np = nodes[layer]; np; np = np->next) {
+         ReconfigureClient(np);
+      }
+   }
+}
+
+/** Keep a client on the screens after the screen geometry changed.
+ * Maximized and fullscreen clients are fit to their screen again and
+ * clients left outside of every screen are moved onto a screen.
+ * Other clients are not touched.
+ */
+void ReconfigureClient(ClientNode *np)
+{
+   BoundingBox box;
+   const ScreenType *sp;
+   int north, south, east, west;
+   int oldx, oldy, oldWidth, oldHeight;
+   int x, y, width, height;
+   int cx, cy;
+
+   x = np->x;
+   y = np->y;
+   width = np->width;
+   height = np->height;
+
+   GetClientBorderSize(np, &north, &south, &east, &west);
+   cx = np->x + (east + west + np->width) / 2;
+   cy = np->y + (north + south + np->height) / 2;
+   sp = GetCurrentScreen(cx, cy);
+   GetScreenBounds(sp, &box);
+
+   if(np->state.status & STAT_FULLSCREEN) {
+      np->x = box.x + west;
+      np->y = box.y + north;
+      np->width = box.width - east - west;
+      np->height = box.height - north - south;
+   } else if(np->state.maxFlags != MAX_NONE) {
+      /* Keep the geometry to restore. */
+      oldx = np->oldx;
+      oldy = np->oldy;
+      oldWidth = np->oldWidth;
+      oldHeight = np->oldHeight;
+      PlaceMaximizedClient(np, np->state.maxFlags);
+      np->oldx = oldx;
+      np->oldy = oldy;
+      np->oldWidth = oldWidth;
+      np->oldHeight = oldHeight;
+   } else if(cx < box.x || cx >= box.x + box.width
+          || cy < box.y || cy >= box.y + box.height) {
+      if(np->x + np->width + east > box.x + box.width) {
+         np->x = box.x + box.width - np->width - east;
+      }
+      if(np->y + np->height + south > box.y + box.height) {
+         np->y = box.y + box.height - np->height - south;
+      }
+      if(np->x < box.x + west) {
+         np->x = box.x + west;
+      }
+      if(np->y < box.y + north) {
+         np->y = box.y + north;
+      }
+   }
+
+   if(  np->x != x || np->y != y
+      || np->width != width || np->height != height) {
+      ResetBorder(np);
+      SendConfigureEvent(np);
+   }
 }
 
 /** Shutdown placement. */
@@ -67,6 +196,9 @@ void ShutdownPlacement(void)
    Strut *sp;
 
    Release(cascadeOffsets);
+   Release(workareas);
+   workareas = NULL;
+   publishedDesktopCount = 0;
 
    while(struts) {
       sp = struts->next;
@@ -93,6 +225,7 @@ char DoRemoveClientStrut(ClientNode *np)
       Strut *sp = *spp;
       if(sp->client == np) {
          *spp = sp->next;
+         InvalidateStrutArea(&sp->box, np);
          Release(sp);
          updated = 1;
       } else {
@@ -106,20 +239,165 @@ char DoRemoveClientStrut(ClientNode *np)
 /** Insert a bounding box to the list of struts. */
 void InsertStrut(const BoundingBox *box, ClientNode *np)
 {
-   if(JLIKELY(box->width > 0 && box->height > 0)) {
-      Strut *sp = Allocate(sizeof(Strut));
-      sp->client = np;
-      sp->box = *box;
-      sp->next = struts;
-      struts = sp;
+   Strut *sp = Allocate(sizeof(Strut));
+   sp->client = np;
+   sp->box = *box;
+   sp->next = struts;
+   struts = sp;
+   InvalidateStrutArea(box, np);
+}
+
+/** Forget the cached usable areas of the screens a strut touches.
+ * Only struts of clients on the current desktop are subtracted, so other
+ * struts leave the cache alone.
+ */
+void InvalidateStrutArea(const BoundingBox *box, const ClientNode *np)
+{
+   const int screenCount = GetScreenCount();
+   unsigned int layer;
+   int index;
+
+   if(!workareas || !IsClientOnCurrentDesktop(np)) {
+      return;
+   }
+   if(workareaDesktop != currentDesktop) {
+      InvalidateWorkarea();
+      return;
+   }
+
+   /* The last entry is the whole root window. */
+   for(index = 0; index <= screenCount; index++) {
+      if(index < screenCount) {
+         const ScreenType *sp = GetScreen(index);
+         if(   box->x >= sp->x + sp->width || box->x + box->width <= sp->x
+            || box->y >= sp->y + sp->height
+            || box->y + box->height <= sp->y) {
+            continue;
+         }
+      }
+      for(layer = 0; layer < LAYER_COUNT; layer++) {
+         workareas[index * LAYER_COUNT + layer].valid = 0;
+      }
+   }
+}
+
+/** Add a strut read from a client to a list (empty struts are ignored). */
+void AddStrutBox(BoundingBox *boxes, unsigned int *count,
+                 long x, long y, long width, long height)
+{
+   if(width > 0 && height > 0) {
+      BoundingBox *box = &boxes[*count];
+      box->x = x;
+      box->y = y;
+      box->width = width;
+      box->height = height;
+      *count += 1;
+   }
+}
+
+/** Determine if the struts read for a client differ from those stored. */
+char IsStrutChanged(const ClientNode *np, const BoundingBox *boxes,
+                    unsigned int count)
+{
+   const Strut *sp;
+   unsigned int found = 0;
+   unsigned int i;
+
+   for(sp = struts; sp; sp = sp->next) {
+      if(sp->client != np) {
+         continue;
+      }
+      for(i = 0; i < count; i++) {
+         if(   boxes[i].x == sp->box.x && boxes[i].y == sp->box.y
+            && boxes[i].width == sp->box.width
+            && boxes[i].height == sp->box.height) {
+            break;
+         }
+      }
+      if(i == count) {
+         return 1;
+      }
+      found += 1;
+   }
+   return found != count;
+}
+
+/** Forget the cached usable areas. */
+void InvalidateWorkarea(void)
+{
+   if(workareas) {
+      const unsigned int count = (GetScreenCount() + 1) * LAYER_COUNT;
+      unsigned int i;
+      for(i = 0; i < count; i++) {
+         workareas[i].valid = 0;
+      }
+   }
+   workareaDesktop = currentDesktop;
+}
+
+/** Determine if a client has struts. */
+char HasStrut(const ClientNode *np)
+{
+   const Strut *sp;
+   for(sp = struts; sp; sp = sp->next) {
+      if(sp->client == np) {
+         return 1;
+      }
+   }
+   return 0;
+}
+
+/** Get the area of a screen not covered by trays or struts.
+ * @param sp The screen (NULL for the whole root window).
+ * @param layer The layer; only trays above it are subtracted.
+ * @param np The client whose own struts are ignored (or NULL).
+ * @param box The usable area.
+ */
+void GetWorkarea(const ScreenType *sp, unsigned int layer,
+                 const ClientNode *np, BoundingBox *box)
+{
+   Workarea *wp;
+
+   if(sp) {
+      GetScreenBounds(sp, box);
+   } else {
+      box->x = 0;
+      box->y = 0;
+      box->width = rootWidth;
+      box->height = rootHeight;
+   }
+
+   /* Struts are only subtracted for clients on the current desktop and
+    * the area is different for clients with struts of their own. */
+   if(workareaDesktop != currentDesktop) {
+      InvalidateWorkarea();
+   }
+   if(!workareas || (np && HasStrut(np))) {
+      SubtractTrayBounds(box, layer);
+      SubtractStrutBounds(box, np);
+      return;
    }
+
+   wp = &workareas[(sp ? sp->index : GetScreenCount()) * LAYER_COUNT + layer];
+   if(!wp->valid) {
+      wp->box = *box;
+      SubtractTrayBounds(&wp->box, layer);
+      SubtractStrutBounds(&wp->box, NULL);
+      wp->valid = 1;
+   }
+   *box = wp->box;
 }
 
-/** Add client specified struts to our list. */
+/** Add client specified struts to our list.
+ * Struts are compared with those already stored so that clients that
+ * set the same struts repeatedly do not cause workarea updates.
+ */
 void ReadClientStrut(ClientNode *np)
 {
 
-   BoundingBox box;
+   BoundingBox boxes[CLIENT_STRUT_COUNT];
+   unsigned int boxCount;
+   unsigned int i;
    int status;
    Atom actualType;
    int actualFormat;
@@ -128,14 +406,8 @@ void ReadClientStrut(ClientNode *np)
    unsigned char *value;
    long *lvalue;
    long leftWidth, rightWidth, topHeight, bottomHeight;
-   char updated;
-
-   updated = DoRemoveClientStrut(np);
 
-   box.x = 0;
-   box.y = 0;
-   box.width = 0;
-   box.height = 0;
+   boxCount = 0;
 
    /* First try to read _NET_WM_STRUT_PARTIAL */
    /* Format is:
@@ -170,98 +442,53 @@ void ReadClientStrut(ClientNode *np)
          bottomStart    = lvalue[10];
          bottomStop     = lvalue[11];
 
-         if(leftWidth > 0) {
-            box.x = 0;
-            box.y = leftStart;
-            box.height = leftStop - leftStart;
-            box.width = leftWidth;
-            InsertStrut(&box, np);
-         }
-
-         if(rightWidth > 0) {
-            box.x = rootWidth - rightWidth;
-            box.y = rightStart;
-            box.height = rightStop - rightStart;
-            box.width = rightWidth;
-            InsertStrut(&box, np);
-         }
-
-         if(topHeight > 0) {
-            box.x = topStart;
-            box.y = 0;
-            box.height = topHeight;
-            box.width = topStop - topStart;
-            InsertStrut(&box, np);
-         }
-
-         if(bottomHeight > 0) {
-            box.x = bottomStart;
-            box.y = rootHeight - bottomHeight;
-            box.width = bottomStop - bottomStart;
-            box.height = bottomHeight;
-            InsertStrut(&box, np);
-         }
+         AddStrutBox(boxes, &boxCount, 0, leftStart,
+                     leftWidth, leftStop - leftStart);
+         AddStrutBox(boxes, &boxCount, rootWidth - rightWidth, rightStart,
+                     rightWidth, rightStop - rightStart);
+         AddStrutBox(boxes, &boxCount, topStart, 0,
+                     topStop - topStart, topHeight);
+         AddStrutBox(boxes, &boxCount, bottomStart, rootHeight - bottomHeight,
+                     bottomStop - bottomStart, bottomHeight);
 
       }
       JXFree(value);
-      SetWorkarea();
-      return;
-   }
-
-   /* Next try to read _NET_WM_STRUT */
-   /* Format is: left_width, right_width, top_width, bottom_width */
-   count = 0;
-   status = JXGetWindowProperty(display, np->window, atoms[ATOM_NET_WM_STRUT],
-                                0, 4, False, XA_CARDINAL, &actualType,
-                                &actualFormat, &count, &bytesLeft, &value);
-   if(status == Success && actualFormat != 0) {
-      if(JLIKELY(count == 4)) {
-         lvalue = (long*)value;
-         leftWidth = lvalue[0];
-         rightWidth = lvalue[1];
-         topHeight = lvalue[2];
-         bottomHeight = lvalue[3];
-
-         if(leftWidth > 0) {
-            box.x = 0;
-            box.y = 0;
-            box.width = leftWidth;
-            box.height = rootHeight;
-            InsertStrut(&box, np);
-         }
-
-         if(rightWidth > 0) {
-            box.x = rootWidth - rightWidth;
-            box.y = 0;
-            box.width = rightWidth;
-            box.height = rootHeight;
-            InsertStrut(&box, np);
-         }
-
-         if(topHeight > 0) {
-            box.x = 0;
-            box.y = 0;
-            box.width = rootWidth;
-            box.height = topHeight;
-            InsertStrut(&box, np);
-         }
+   } else {
 
-         if(bottomHeight > 0) {
-            box.x = 0;
-            box.y = rootHeight - bottomHeight;
-            box.width = rootWidth;
-            box.height = bottomHeight;
-            InsertStrut(&box, np);
+      /* Next try to read _NET_WM_STRUT */
+      /* Format is: left_width, right_width, top_width, bottom_width */
+      count = 0;
+      status = JXGetWindowProperty(display, np->window,
+                                   atoms[ATOM_NET_WM_STRUT],
+                                   0, 4, False, XA_CARDINAL, &actualType,
+                                   &actualFormat, &count, &bytesLeft,
+                                   &value);
+      if(status == Success && actualFormat != 0) {
+         if(JLIKELY(count == 4)) {
+            lvalue = (long*)value;
+            leftWidth = lvalue[0];
+            rightWidth = lvalue[1];
+            topHeight = lvalue[2];
+            bottomHeight = lvalue[3];
+
+            AddStrutBox(boxes, &boxCount, 0, 0, leftWidth, rootHeight);
+            AddStrutBox(boxes, &boxCount, rootWidth - rightWidth, 0,
+                        rightWidth, rootHeight);
+            AddStrutBox(boxes, &boxCount, 0, 0, rootWidth, topHeight);
+            AddStrutBox(boxes, &boxCount, 0, rootHeight - bottomHeight,
+                        rootWidth, bottomHeight);
          }
-
+         JXFree(value);
       }
-      JXFree(value);
-      SetWorkarea();
-      return;
+
    }
 
-   /* Struts were removed. */
-   if(updated) {
+   /* Only the screens touched by old or new struts are invalidated. */
+   if(IsStrutChanged(np, boxes, boxCount)) {
+      DoRemoveClientStrut(np);
+      for(i = 0; i < boxCount; i++) {
+         InsertStrut(&boxes[i], np);
+      }
       SetWorkarea();
    }
 
@@ -416,18 +643,46 @@ int IntComparator(const void *a, const void *b)
    return ia - ib;
 }
 
-/** Attempt to place the client at the specified coordinates. */
-int TryTileClient(const BoundingBox *box, ClientNode *np, int x, int y)
+/** Compare two tiling rectangles by left edge. */
+int TileRectComparator(const void *a, const void *b)
+{
+   const int ia = ((const TileRect*)a)->x1;
+   const int ib = ((const TileRect*)b)->x1;
+   return ia - ib;
+}
+
+/** Remove duplicates from a sorted list of coordinates.
+ * @return The new number of coordinates.
+ */
+int UniqueCoordinates(int *values, int count)
+{
+   int i, j;
+   j = 0;
+   for(i = 1; i < count; i++) {
+      if(values[i] != values[j]) {
+         j += 1;
+         values[j] = values[i];
+      }
+   }
+   return count > 0 ? j + 1 : 0;
+}
+
+/** Attempt to place the client at the specified coordinates.
+ * The rectangles are sorted by left edge, so the scan stops at the
+ * first rectangle that starts to the right of the client. Scoring also
+ * stops once the overlap reaches the limit since the position can no
+ * longer win.
+ */
+int TryTileClient(const BoundingBox *box, ClientNode *np, int x, int y,
+                  const TileRect *rects, int rectCount, int limit)
 {
-   const ClientNode *tp;
-   int layer;
    int north, south, east, west;
    int x1, x2, y1, y2;
-   int ox1, ox2, oy1, oy2;
    int overlap;
+   int i;
 
    /* Set the client position. */
-   GetBorderSize(&np->state, &north, &south, &east, &west);
+   GetClientBorderSize(np, &north, &south, &east, &west);
    np->x = x + west;
    np->y = y + north;
    ConstrainSize(np);
@@ -449,37 +704,21 @@ int TryTileClient(const BoundingBox *box, ClientNode *np, int x, int y)
        return INT_MAX;
    }
 
-   /* Loop over each client. */
-   for(layer = np->state.layer; layer < LAYER_COUNT; layer++) {
-      for(tp = nodes[layer]; tp; tp = tp->next) {
-
-         /* Skip clients that aren't visible. */
-         if(!IsClientOnCurrentDesktop(tp)) {
-            continue;
-         }
-         if(!(tp->state.status & STAT_MAPPED)) {
-            continue;
-         }
-         if(tp == np) {
-            continue;
-         }
+   /* Loop over each client that starts to the left of our right edge. */
+   for(i = 0; i < rectCount && rects[i].x1 < x2; i++) {
+      const TileRect *rp = &rects[i];
 
-         /* Get the boundaries of the other client. */
-         GetBorderSize(&tp->state, &north, &south, &east, &west);
-         ox1 = tp->x - west;
-         ox2 = tp->x + tp->width + east;
-         oy1 = tp->y - north;
-         oy2 = tp->y + tp->height + south;
-
-         /* Check for an overlap. */
-         if(x2 <= ox1 || x1 >= ox2) {
-            continue;
-         }
-         if(y2 <= oy1 || y1 >= oy2) {
-            continue;
-         }
-         overlap += (Min(ox2, x2) - Max(ox1, x1))
-                  * (Min(oy2, y2) - Max(oy1, y1));
+      /* Check for an overlap. */
+      if(x1 >= rp->x2) {
+         continue;
+      }
+      if(y2 <= rp->y1 || y1 >= rp->y2) {
+         continue;
+      }
+      overlap += (Min(rp->x2, x2) - Max(rp->x1, x1))
+               * (Min(rp->y2, y2) - Max(rp->y1, y1));
+      if(overlap >= limit) {
+         break;
       }
    }
 
@@ -494,14 +733,15 @@ char TileClient(const BoundingBox *box, ClientNode *np)
    int layer;
    int north, south, east, west;
    int i, j;
-   int count;
+   int count, xcount, ycount;
    int *xs;
    int *ys;
+   TileRect *rects;
    int leastOverlap;
    int bestx, besty;
 
-   /* Count insertion points, including bounding box edges. */
-   count = 2;
+   /* Count the clients we might overlap. */
+   count = 0;
    for(layer = np->state.layer; layer < LAYER_COUNT; layer++) {
       for(tp = nodes[layer]; tp; tp = tp->next) {
          if(!IsClientOnCurrentDesktop(tp)) {
@@ -513,18 +753,20 @@ char TileClient(const BoundingBox *box, ClientNode *np)
          if(tp == np) {
             continue;
          }
-         count += 2;
+         count += 1;
       }
    }
 
-   /* Allocate space for the points. */
-   xs = AllocateStack(sizeof(int) * count);
-   ys = AllocateStack(sizeof(int) * count);
+   /* Allocate space for the rectangles and the points, including
+    * the bounding box edges. */
+   rects = AllocateStack(sizeof(TileRect) * (count + 1));
+   xs = AllocateStack(sizeof(int) * (count * 2 + 2));
+   ys = AllocateStack(sizeof(int) * (count * 2 + 2));
 
-   /* Insert points. */
+   /* Take a snapshot of the frame rectangles and insert points. */
    xs[0] = box->x;
    ys[0] = box->y;
-   count = 1;
+   count = 0;
    for(layer = np->state.layer; layer < LAYER_COUNT; layer++) {
       for(tp = nodes[layer]; tp; tp = tp->next) {
          if(!IsClientOnCurrentDesktop(tp)) {
@@ -536,32 +778,42 @@ char TileClient(const BoundingBox *box, ClientNode *np)
          if(tp == np) {
             continue;
          }
-         GetBorderSize(&tp->state, &north, &south, &east, &west);
-         xs[count + 0] = tp->x - west;
-         xs[count + 1] = tp->x + tp->width + east;
-         ys[count + 0] = tp->y - north;
-         ys[count + 1] = tp->y + tp->height + south;
-         count += 2;
+         GetClientBorderSize(tp, &north, &south, &east, &west);
+         rects[count].x1 = tp->x - west;
+         rects[count].x2 = tp->x + tp->width + east;
+         rects[count].y1 = tp->y - north;
+         rects[count].y2 = tp->y + tp->height + south;
+         xs[count * 2 + 1] = rects[count].x1;
+         xs[count * 2 + 2] = rects[count].x2;
+         ys[count * 2 + 1] = rects[count].y1;
+         ys[count * 2 + 2] = rects[count].y2;
+         count += 1;
       }
    }
+   qsort(rects, count, sizeof(TileRect), TileRectComparator);
 
    /* Try placing at lower right edge of box, too. */
-   GetBorderSize(&np->state, &north, &south, &east, &west);
-   xs[count] = box->x + box->width - np->width - east - west;
-   ys[count] = box->y + box->height - np->height - north - south;
-   count += 1;
-
-   /* Sort the points. */
-   qsort(xs, count, sizeof(int), IntComparator);
-   qsort(ys, count, sizeof(int), IntComparator);
+   GetClientBorderSize(np, &north, &south, &east, &west);
+   xs[count * 2 + 1] = box->x + box->width - np->width - east - west;
+   ys[count * 2 + 1] = box->y + box->height - np->height - north - south;
+
+   /* Sort the points and drop duplicates (clients that line up share
+    * edges, so this removes many positions). */
+   xcount = count * 2 + 2;
+   ycount = count * 2 + 2;
+   qsort(xs, xcount, sizeof(int), IntComparator);
+   qsort(ys, ycount, sizeof(int), IntComparator);
+   xcount = UniqueCoordinates(xs, xcount);
+   ycount = UniqueCoordinates(ys, ycount);
 
    /* Try all possible positions. */
    leastOverlap = INT_MAX;
    bestx = xs[0];
    besty = ys[0];
-   for(i = 0; i < count; i++) {
-      for(j = 0; j < count; j++) {
-         const int overlap = TryTileClient(box, np, xs[i], ys[j]);
+   for(i = 0; i < xcount && leastOverlap > 0; i++) {
+      for(j = 0; j < ycount; j++) {
+         const int overlap = TryTileClient(box, np, xs[i], ys[j],
+                                           rects, count, leastOverlap);
          if(overlap < leastOverlap) {
             leastOverlap = overlap;
             bestx = xs[i];
@@ -573,12 +825,13 @@ char TileClient(const BoundingBox *box, ClientNode *np)
       }
    }
 
-   ReleaseStack(xs);
    ReleaseStack(ys);
+   ReleaseStack(xs);
+   ReleaseStack(rects);
 
    if(leastOverlap < INT_MAX) {
       /* Set the client position. */
-      GetBorderSize(&np->state, &north, &south, &east, &west);
+      GetClientBorderSize(np, &north, &south, &east, &west);
       np->x = bestx + west;
       np->y = besty + north;
       ConstrainSize(np);
@@ -599,7 +852,7 @@ void CascadeClient(const BoundingBox *box, ClientNode *np)
    int cascadeIndex;
    char overflow;
 
-   GetBorderSize(&np->state, &north, &south, &east, &west);
+   GetClientBorderSize(np, &north, &south, &east, &west);
    sp = GetMouseScreen();
    cascadeIndex = sp->index * settings.desktopCount + currentDesktop;
 
@@ -659,13 +912,14 @@ void PlaceClient(ClientNode *np, char alreadyMapped)
    } else {
 
       sp = GetMouseScreen();
-      GetScreenBounds(sp, &box);
-      SubtractTrayBounds(&box, np->state.layer);
-      SubtractStrutBounds(&box, np);
+      GetWorkarea(sp, np->state.layer, np, &box);
 
       /* If tiled is specified, first attempt to use tiled placement. */
       if(np->state.status & STAT_TILED) {
-         if(TileClient(&box, np)) {
+         const StatsTime start = StartStats();
+         const char tiled = TileClient(&box, np);
+         RecordSectionStats(SECTION_TILE, start);
+         if(tiled) {
             return;
          }
       }
@@ -699,10 +953,8 @@ char ConstrainSize(ClientNode *np)
 
    /* Constrain the width if necessary. */
    sp = GetCurrentScreen(np->x, np->y);
-   GetScreenBounds(sp, &box);
-   SubtractTrayBounds(&box, np->state.layer);
-   SubtractStrutBounds(&box, np);
-   GetBorderSize(&np->state, &north, &south, &east, &west);
+   GetWorkarea(sp, np->state.layer, np, &box);
+   GetClientBorderSize(np, &north, &south, &east, &west);
    if(np->width + east + west > sp->width) {
       box.x += west;
       box.width -= east + west;
@@ -761,15 +1013,10 @@ void ConstrainPosition(ClientNode *np)
    int north, south, east, west;
 
    /* Get the bounds for placement. */
-   box.x = 0;
-   box.y = 0;
-   box.width = rootWidth;
-   box.height = rootHeight;
-   SubtractTrayBounds(&box, np->state.layer);
-   SubtractStrutBounds(&box, np);
+   GetWorkarea(NULL, np->state.layer, np, &box);
 
    /* Fix the position. */
-   GetBorderSize(&np->state, &north, &south, &east, &west);
+   GetClientBorderSize(np, &north, &south, &east, &west);
    if(np->x + np->width + east + west > box.x + box.width) {
       np->x = box.x + box.width - np->width - east;
    }
@@ -798,21 +1045,26 @@ void PlaceMaximizedClient(ClientNode *np, MaxFlags flags)
    np->oldHeight = np->height;
    np->state.maxFlags = flags;
 
-   GetBorderSize(&np->state, &north, &south, &east, &west);
+   GetClientBorderSize(np, &north, &south, &east, &west);
 
    sp = GetCurrentScreen(np->x + (east + west + np->width) / 2,
                          np->y + (north + south + np->height) / 2);
-   GetScreenBounds(sp, &box);
-   if(!(flags & (MAX_HORIZ | MAX_LEFT | MAX_RIGHT))) {
-      box.x = np->x;
-      box.width = np->width;
-   }
-   if(!(flags & (MAX_VERT | MAX_TOP | MAX_BOTTOM))) {
-      box.y = np->y;
-      box.height = np->height;
+   if(  (flags & (MAX_HORIZ | MAX_LEFT | MAX_RIGHT))
+      && (flags & (MAX_VERT | MAX_TOP | MAX_BOTTOM))) {
+      GetWorkarea(sp, np->state.layer, np, &box);
+   } else {
+      GetScreenBounds(sp, &box);
+      if(!(flags & (MAX_HORIZ | MAX_LEFT | MAX_RIGHT))) {
+         box.x = np->x;
+         box.width = np->width;
+      }
+      if(!(flags & (MAX_VERT | MAX_TOP | MAX_BOTTOM))) {
+         box.y = np->y;
+         box.height = np->height;
+      }
+      SubtractTrayBounds(&box, np->state.layer);
+      SubtractStrutBounds(&box, np);
    }
-   SubtractTrayBounds(&box, np->state.layer);
-   SubtractStrutBounds(&box, np);
 
    if(box.width > np->maxWidth) {
       box.width = np->maxWidth;
@@ -878,7 +1130,7 @@ void PlaceMaximizedClient(ClientNode *np, MaxFlags flags)
 void GetGravityDelta(const ClientNode *np, int gravity, int *x, int  *y)
 {
    int north, south, east, west;
-   GetBorderSize(&np->state, &north, &south, &east, &west);
+   GetClientBorderSize(np, &north, &south, &east, &west);
    switch(gravity) {
    case NorthWestGravity:
       *y = -north;
@@ -937,7 +1189,7 @@ void GravitateClient(ClientNode *np, char negate)
    }
 }
 
-/** Set _NET_WORKAREA. */
+/** Set _NET_WORKAREA if it changed. */
 void SetWorkarea(void)
 {
    BoundingBox box;
@@ -945,17 +1197,19 @@ void SetWorkarea(void)
    unsigned int count;
    int x;
 
+   GetWorkarea(NULL, LAYER_NORMAL, NULL, &box);
+   if(   publishedDesktopCount == settings.desktopCount
+      && box.x == publishedWorkarea.x && box.y == publishedWorkarea.y
+      && box.width == publishedWorkarea.width
+      && box.height == publishedWorkarea.height) {
+      return;
+   }
+   publishedWorkarea = box;
+   publishedDesktopCount = settings.desktopCount;
+
    count = 4 * settings.desktopCount * sizeof(unsigned long);
    array = (unsigned long*)AllocateStack(count);
 
-   box.x = 0;
-   box.y = 0;
-   box.width = rootWidth;
-   box.height = rootHeight;
-
-   SubtractTrayBounds(&box, LAYER_NORMAL);
-   SubtractStrutBounds(&box, NULL);
-
    for(x = 0; x < settings.desktopCount; x++) {
       array[x * 4 + 0] = box.x;
       array[x * 4 + 1] = box.y;
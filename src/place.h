@@ -40,6 +40,17 @@ void RemoveClientStrut(ClientNode *np);
  */
 void ReadClientStrut(ClientNode *np);
 
+/** Forget the cached usable areas of the screens.
+ * This must be called when trays or the desktop of clients with
+ * struts change.
+ */
+void InvalidateWorkarea(void);
+
+/** Update placement after the screen geometry changed.
+ * Maximized, fullscreen, and stranded clients are placed again.
+ */
+void ReconfigurePlacement(void);
+
 /** Place a client on the screen.
  * @param np The client to place.
  * @param alreadyMapped 1 if already mapped, 0 if unmapped.
@@ -52,6 +63,13 @@ void PlaceClient(ClientNode *np, char alreadyMapped);
  */
 void PlaceMaximizedClient(ClientNode *np, MaxFlags flags);
 
+/** Place a client where it overlaps the fewest other clients.
+ * @param box The area to place the client in.
+ * @param np The client to place.
+ * @return 1 if the client was placed, 0 if it does not fit in the area.
+ */
+char TileClient(const BoundingBox *box, ClientNode *np);
+
 /** Move a client window for a border.
  * @param np The client.
  * @param negate 0 to gravitate for a border, 1 to gravitate for no border.
@@ -18,16 +18,22 @@
 #include "misc.h"
 #include "settings.h"
 #include "event.h"
+#include "expose.h"
 #include "hint.h"
+#include "winpool.h"
 
 typedef struct PopupType {
    int x, y;   /* The coordinates of the upper-left corner of the popup. */
+   int rx, ry; /* The position requested for the popup. */
    int mx, my; /* The mouse position when the popup was created. */
    Window mw;
    int width, height;
+   int textWidth; /* The width needed for the text. */
+   int pmapWidth, pmapHeight;
    char *text;    /* The raw popup text. */
    char *lines;   /* Popup text split into NUL-separated lines. */
    int lineCount; /* The number of lines. */
+   char shown;    /* Set if the popup window is mapped. */
    Window window;
    Pixmap pmap;
 } PopupType;
@@ -35,6 +41,8 @@ typedef struct PopupType {
 static PopupType popup;
 
 static void MeasurePopupText();
+static void DrawPopup();
+static void HidePopup();
 static void SignalPopup(const TimeType *now, int x, int y, Window w,
                         void *data);
 
@@ -43,6 +51,8 @@ void StartupPopup(void)
 {
    popup.text = NULL;
    popup.window = None;
+   popup.pmap = None;
+   popup.shown = 0;
    RegisterCallback(100, SignalPopup, NULL);
 }
 
@@ -57,9 +67,13 @@ void ShutdownPopup(void)
    }
    if(popup.window != None) {
       JXDestroyWindow(display, popup.window);
-      JXFreePixmap(display, popup.pmap);
       popup.window = None;
    }
+   if(popup.pmap != None) {
+      ReleasePoolPixmap(popup.pmap);
+      popup.pmap = None;
+   }
+   popup.shown = 0;
 }
 
 /** Calculate dimensions of a popup window given the popup text. */
@@ -71,7 +85,7 @@ void MeasurePopupText()
    popup.lines = CopyString(popup.text);
    ptr = popup.lines;
 
-   popup.width       = 0;
+   popup.textWidth   = 0;
    popup.height      = 1;
    popup.lineCount   = 0;
    for(;;) {
@@ -81,7 +95,7 @@ void MeasurePopupText()
          *end = 0;
       }
       currentWidth = GetStringWidth(FONT_POPUP, ptr) + 9;
-      popup.width = Max(popup.width, currentWidth);
+      popup.textWidth = Max(popup.textWidth, currentWidth);
       popup.height += textHeight;
       popup.lineCount += 1;
       if(end) {
@@ -92,41 +106,94 @@ void MeasurePopupText()
    }
 }
 
+/** Render the popup text to the popup pixmap. */
+void DrawPopup()
+{
+   char *ptr;
+   int textHeight;
+   int i;
+
+   /* The pixmap is only replaced when the popup outgrows it. */
+   if(popup.pmap == None
+      || popup.pmapWidth < popup.width
+      || popup.pmapHeight < popup.height) {
+      if(popup.pmap != None) {
+         ReleasePoolPixmap(popup.pmap);
+      }
+      popup.pmap = AcquirePoolPixmap(popup.width, popup.height);
+      popup.pmapWidth = popup.width;
+      popup.pmapHeight = popup.height;
+   }
+
+   JXSetForeground(display, rootGC, colors[COLOR_POPUP_BG]);
+   JXFillRectangle(display, popup.pmap, rootGC, 0, 0,
+                   popup.width - 1, popup.height - 1);
+   JXSetForeground(display, rootGC, colors[COLOR_POPUP_OUTLINE]);
+   JXDrawRectangle(display, popup.pmap, rootGC, 0, 0,
+                   popup.width - 1, popup.height - 1);
+   ptr = popup.lines;
+   textHeight = GetStringHeight(FONT_POPUP) + 1;
+   for(i = 0; i < popup.lineCount; i++) {
+      RenderString(popup.pmap, FONT_POPUP, COLOR_POPUP_FG, 4,
+                   textHeight * i + 1, popup.width, ptr);
+      ptr += strlen(ptr) + 1;
+   }
+}
+
+/** Hide the popup window.
+ * The window and pixmap are kept for the next popup.
+ */
+void HidePopup()
+{
+   if(popup.shown) {
+      JXUnmapWindow(display, popup.window);
+      popup.shown = 0;
+   }
+}
+
 /** Show a popup window. */
 void ShowPopup(int x, int y, const char *text,
                const PopupMaskType context)
 {
    const ScreenType *sp;
-   char *ptr;
-   int textHeight;
-   int i;
+   int oldX, oldY, oldWidth, oldHeight;
+   char textChanged;
 
    if(!(settings.popupMask & context)) {
       return;
    }
 
-   if(popup.text) {
-      if(x == popup.x && y == popup.y && !strcmp(popup.text, text)) {
+   if(popup.text && !strcmp(popup.text, text)) {
+      if(popup.shown && x == popup.rx && y == popup.ry) {
          /* This popup is already shown. */
          return;
       }
-      Release(popup.text);
-      Release(popup.lines);
-      popup.text = NULL;
-   }
-
-   if(text[0] == 0) {
-      return;
+      textChanged = 0;
+   } else {
+      if(popup.text) {
+         Release(popup.text);
+         Release(popup.lines);
+         popup.text = NULL;
+      }
+      if(text[0] == 0) {
+         return;
+      }
+      popup.text = CopyString(text);
+      MeasurePopupText();
+      textChanged = 1;
    }
 
    GetMousePosition(&popup.mx, &popup.my, &popup.mw);
-   popup.text = CopyString(text);
+   popup.rx = x;
+   popup.ry = y;
+
+   oldX = popup.x;
+   oldY = popup.y;
+   oldWidth = popup.width;
+   oldHeight = popup.height;
 
-   MeasurePopupText();
    sp = GetCurrentScreen(x, y);
-   if(popup.width > sp->width) {
-      popup.width = sp->width;
-   }
+   popup.width = Min(popup.textWidth, sp->width);
 
    popup.x = x;
    if(y + 2 * popup.height + 2 >= sp->height) {
@@ -171,47 +238,37 @@ void ShowPopup(int x, int y, const char *text,
                                     CopyFromParent, attrMask, &attr);
       SetAtomAtom(popup.window, ATOM_NET_WM_WINDOW_TYPE,
                   ATOM_NET_WM_WINDOW_TYPE_NOTIFICATION);
-      JXMapRaised(display, popup.window);
-
-   } else {
+      textChanged = 1;
 
+   } else if(oldWidth != popup.width || oldHeight != popup.height) {
       JXMoveResizeWindow(display, popup.window, popup.x, popup.y,
                          popup.width, popup.height);
-      JXFreePixmap(display, popup.pmap);
-
+      textChanged = 1;
+   } else if(oldX != popup.x || oldY != popup.y) {
+      JXMoveWindow(display, popup.window, popup.x, popup.y);
    }
 
-   popup.pmap = JXCreatePixmap(display, popup.window,
-                               popup.width, popup.height,
-                               rootDepth);
-
-   JXSetForeground(display, rootGC, colors[COLOR_POPUP_BG]);
-   JXFillRectangle(display, popup.pmap, rootGC, 0, 0,
-                   popup.width - 1, popup.height - 1);
-   JXSetForeground(display, rootGC, colors[COLOR_POPUP_OUTLINE]);
-   JXDrawRectangle(display, popup.pmap, rootGC, 0, 0,
-                   popup.width - 1, popup.height - 1);
-   ptr = popup.lines;
-   textHeight = GetStringHeight(FONT_POPUP) + 1;
-   for(i = 0; i < popup.lineCount; i++) {
-      RenderString(popup.pmap, FONT_POPUP, COLOR_POPUP_FG, 4,
-                   textHeight * i + 1, popup.width, ptr);
-      ptr += strlen(ptr) + 1;
+   if(textChanged) {
+      DrawPopup();
+   }
+   if(!popup.shown) {
+      /* The contents are copied when the window is exposed. */
+      JXMapRaised(display, popup.window);
+      popup.shown = 1;
+   } else if(textChanged) {
+      JXCopyArea(display, popup.pmap, popup.window, rootGC,
+                 0, 0, popup.width, popup.height, 0, 0);
    }
-   JXCopyArea(display, popup.pmap, popup.window, rootGC,
-              0, 0, popup.width, popup.height, 0, 0);
 
 }
 
 /** Signal popup (this is used to hide popups after awhile). */
 void SignalPopup(const TimeType *now, int x, int y, Window w, void *data)
 {
-   if(popup.window != None) {
+   if(popup.shown) {
       if(popup.mw != w ||
          abs(popup.mx - x) > 0 || abs(popup.my - y) > 0) {
-         JXDestroyWindow(display, popup.window);
-         JXFreePixmap(display, popup.pmap);
-         popup.window = None;
+         HidePopup();
       }
    }
 }
@@ -221,12 +278,11 @@ char ProcessPopupEvent(const XEvent *event)
 {
    if(popup.window != None && event->xany.window == popup.window) {
       if(event->type == Expose && event->xexpose.count == 0) {
-         JXCopyArea(display, popup.pmap, popup.window, rootGC,
-                    0, 0, popup.width, popup.height, 0, 0);
+         CopyExposedArea(popup.pmap, popup.window,
+                         GetExposeRegion(popup.window),
+                         popup.width, popup.height);
       } else if(event->type == MotionNotify) {
-         JXDestroyWindow(display, popup.window);
-         JXFreePixmap(display, popup.pmap);
-         popup.window = None;
+         HidePopup();
       }
       return 1;
    }
@@ -0,0 +1,358 @@
+/**
+ * @file prefetch.c
+ * @author Joe Wingbermuehle
+ * @date 2026
+ *
+ * @brief Pipelined property reads for new clients.
+ *
+ * Managing a window reads a dozen properties one at a time, each
+ * costing a round trip. With XCB all of the requests are sent up front
+ * and the replies are served to the existing XGetWindowProperty callers.
+ *
+ */
+
+#include "jwm.h"
+#include "prefetch.h"
+#include "main.h"
+#include "bulk.h"
+
+/** Determine which windows are viewable and not override-redirect. */
+unsigned int FilterViewableWindows(Window *wins, unsigned int count)
+{
+#ifdef USE_XCB
+   xcb_connection_t *c = XGetXCBConnection(display);
+   xcb_get_window_attributes_cookie_t *cookies;
+#else
+   XWindowAttributes attr;
+#endif
+   unsigned int x, result;
+
+#ifdef USE_XCB
+   cookies = AllocateStack(count * sizeof(*cookies) + 1);
+   JXFlush(display);
+   for(x = 0; x < count; x++) {
+      cookies[x] = xcb_get_window_attributes(c, wins[x]);
+   }
+#endif
+
+   result = 0;
+   for(x = 0; x < count; x++) {
+#ifdef USE_XCB
+      xcb_get_window_attributes_reply_t *rp;
+      rp = xcb_get_window_attributes_reply(c, cookies[x], NULL);
+      if(rp) {
+         if(!rp->override_redirect && rp->map_state == XCB_MAP_STATE_VIEWABLE) {
+            wins[result] = wins[x];
+            result += 1;
+         }
+         free(rp);
+      }
+#else
+      if(JXGetWindowAttributes(display, wins[x], &attr)) {
+         if(attr.override_redirect == False && attr.map_state == IsViewable) {
+            wins[result] = wins[x];
+            result += 1;
+         }
+      }
+#endif
+   }
+
+#ifdef USE_XCB
+   ReleaseStack(cookies);
+#endif
+
+   return result;
+}
+
+#ifdef USE_XCB
+
+#include "hint.h"
+#include "misc.h"
+
+/** Property to prefetch and the length to request (in 32-bit units).
+ * The length must be at least what the reader asks for.
+ */
+typedef struct PrefetchSpec {
+   AtomType atom;
+   unsigned long length;
+} PrefetchSpec;
+
+static const PrefetchSpec PREFETCH_SPECS[] = {
+   { ATOM_NET_WM_NAME,              1024     },
+   { ATOM_NET_WM_STATE,             32       },
+   { ATOM_NET_WM_WINDOW_TYPE,       32       },
+   { ATOM_NET_WM_DESKTOP,           1        },
+   { ATOM_NET_WM_WINDOW_OPACITY,    1        },
+   { ATOM_NET_WM_STRUT_PARTIAL,     12       },
+   { ATOM_NET_WM_STRUT,             4        },
+   { ATOM_NET_WM_ICON,              1 << 20  },
+   { ATOM_WM_PROTOCOLS,             32       },
+   { ATOM_WM_STATE,                 2        },
+   { ATOM_MOTIF_WM_HINTS,           20       }
+};
+#define PREFETCH_COUNT (sizeof(PREFETCH_SPECS) / sizeof(PREFETCH_SPECS[0]))
+
+/** State of a prefetched property. */
+typedef struct PrefetchEntry {
+   xcb_get_property_cookie_t cookie;
+   xcb_get_property_reply_t *reply;
+   char pending;     /**< Set if the reply has not been read. */
+   char valid;       /**< Set if the entry may be used. */
+} PrefetchEntry;
+
+/** Prefetched properties for a window. */
+typedef struct PrefetchWindow {
+   Window window;
+   PrefetchEntry entries[PREFETCH_COUNT];
+} PrefetchWindow;
+
+static PrefetchWindow windows[PREFETCH_WINDOWS];
+static unsigned int windowCount = 0;
+
+static PrefetchWindow *FindWindow(Window w);
+static PrefetchEntry *FindEntry(Window w, Atom atom, unsigned int *index);
+static void ReleaseEntry(PrefetchEntry *ep);
+static void ReleaseWindow(PrefetchWindow *pw);
+
+/** Read a property from the server. */
+#define ReadProperty( a, b, c, d, e, f, g, h, i, j, k, l ) \
+   (JPROBE(XGetWindowProperty), \
+    XGetWindowProperty(a, b, c, d, e, f, g, h, i, j, k, l))
+
+/** Request the properties read when clients are managed. */
+void PrefetchProperties(const Window *wins, unsigned int count)
+{
+   xcb_connection_t *c = XGetXCBConnection(display);
+   unsigned int x, y;
+   char flushed = 0;
+
+   for(x = 0; x < count; x++) {
+      PrefetchWindow *pw;
+      if(wins[x] == None || FindWindow(wins[x])) {
+         continue;
+      }
+      if(windowCount == PREFETCH_WINDOWS) {
+         /* Reuse the oldest slot if the table is full. */
+         ReleaseWindow(&windows[0]);
+         memmove(&windows[0], &windows[1],
+                 (windowCount - 1) * sizeof(PrefetchWindow));
+         windowCount -= 1;
+      }
+      if(!flushed) {
+         /* Xlib may be holding requests that must come first. */
+         JXFlush(display);
+         flushed = 1;
+      }
+      pw = &windows[windowCount];
+      windowCount += 1;
+      pw->window = wins[x];
+      for(y = 0; y < PREFETCH_COUNT; y++) {
+         PrefetchEntry *ep = &pw->entries[y];
+         ep->reply = NULL;
+         if(haveBulk && PREFETCH_SPECS[y].atom == ATOM_NET_WM_ICON) {
+            /* Icons are read on the bulk connection instead. */
+            ep->pending = 0;
+            ep->valid = 0;
+            continue;
+         }
+         ep->cookie = xcb_get_property(c, 0, wins[x],
+                                       atoms[PREFETCH_SPECS[y].atom],
+                                       XCB_GET_PROPERTY_TYPE_ANY, 0,
+                                       PREFETCH_SPECS[y].length);
+         ep->pending = 1;
+         ep->valid = 1;
+      }
+   }
+   if(flushed) {
+      xcb_flush(c);
+   }
+}
+
+/** Release prefetched properties for a window. */
+void ReleasePrefetch(Window w)
+{
+   PrefetchWindow *pw = FindWindow(w);
+   if(pw) {
+      const unsigned int index = pw - windows;
+      ReleaseWindow(pw);
+      memmove(&windows[index], &windows[index + 1],
+              (windowCount - index - 1) * sizeof(PrefetchWindow));
+      windowCount -= 1;
+   }
+}
+
+/** Release all prefetched properties. */
+void FinishPrefetch(void)
+{
+   unsigned int x;
+   for(x = 0; x < windowCount; x++) {
+      ReleaseWindow(&windows[x]);
+   }
+   windowCount = 0;
+}
+
+/** Release the replies for a window. */
+void ReleaseWindow(PrefetchWindow *pw)
+{
+   unsigned int x;
+   for(x = 0; x < PREFETCH_COUNT; x++) {
+      ReleaseEntry(&pw->entries[x]);
+   }
+   pw->window = None;
+}
+
+/** Release the reply for an entry and mark it unusable. */
+void ReleaseEntry(PrefetchEntry *ep)
+{
+   if(ep->pending) {
+      xcb_discard_reply(XGetXCBConnection(display), ep->cookie.sequence);
+      ep->pending = 0;
+   }
+   if(ep->reply) {
+      free(ep->reply);
+      ep->reply = NULL;
+   }
+   ep->valid = 0;
+}
+
+/** Find the prefetched properties for a window. */
+PrefetchWindow *FindWindow(Window w)
+{
+   unsigned int x;
+   for(x = 0; x < windowCount; x++) {
+      if(windows[x].window == w) {
+         return &windows[x];
+      }
+   }
+   return NULL;
+}
+
+/** Find the prefetch entry for a property.
+ * @param w The window.
+ * @param atom The property.
+ * @param index Set to the index in PREFETCH_SPECS (may be NULL).
+ * @return The entry or NULL if the property was not prefetched.
+ */
+PrefetchEntry *FindEntry(Window w, Atom atom, unsigned int *index)
+{
+   PrefetchWindow *pw;
+   unsigned int x;
+   if(w == None || windowCount == 0) {
+      return NULL;
+   }
+   pw = FindWindow(w);
+   if(!pw) {
+      return NULL;
+   }
+   for(x = 0; x < PREFETCH_COUNT; x++) {
+      if(atoms[PREFETCH_SPECS[x].atom] == atom) {
+         if(index) {
+            *index = x;
+         }
+         return pw->entries[x].valid ? &pw->entries[x] : NULL;
+      }
+   }
+   return NULL;
+}
+
+/** Drop a prefetched property that is about to change. */
+void ForgetPrefetchedProperty(Window w, Atom atom)
+{
+   PrefetchEntry *ep = FindEntry(w, atom, NULL);
+   if(ep) {
+      ReleaseEntry(ep);
+   }
+}
+
+/** Read a window property, using a prefetched reply if possible.
+ * The result is built the way Xlib builds it: 32-bit data is returned
+ * as an array of longs and the data is terminated with a zero byte.
+ */
+int GetPrefetchedProperty(Display *d, Window w, Atom atom,
+                          long offset, long length, Bool shouldDelete,
+                          Atom reqType, Atom *actualType,
+                          int *actualFormat, unsigned long *count,
+                          unsigned long *bytesAfter, unsigned char **data)
+{
+   PrefetchEntry *ep;
+   const xcb_get_property_reply_t *rp;
+   const unsigned char *value;
+   unsigned long total, fetched, bytes, items, x;
+   unsigned int unit, index;
+
+   ep = FindEntry(w, atom, &index);
+   if(!ep || offset != 0 || shouldDelete || length < 0
+      || (unsigned long)length > PREFETCH_SPECS[index].length) {
+      return ReadProperty(d, w, atom, offset, length, shouldDelete,
+                          reqType, actualType, actualFormat, count,
+                          bytesAfter, data);
+   }
+
+   if(ep->pending) {
+      ep->reply = xcb_get_property_reply(XGetXCBConnection(d), ep->cookie,
+                                         NULL);
+      ep->pending = 0;
+   }
+   rp = ep->reply;
+   if(!rp) {
+      /* The request failed (for example, the window is gone). */
+      *data = NULL;
+      return BadWindow;
+   }
+
+   *data = NULL;
+   *actualType = rp->type;
+   *actualFormat = rp->format;
+   *count = 0;
+   *bytesAfter = 0;
+   if(rp->type == None) {
+      return Success;
+   }
+
+   fetched = xcb_get_property_value_length(rp);
+   total = fetched + rp->bytes_after;
+   if(reqType != AnyPropertyType && reqType != rp->type) {
+      /* Type mismatch: the server returns no data, only the size. */
+      *bytesAfter = total;
+      *data = malloc(1);
+      (*data)[0] = 0;
+      return Success;
+   }
+
+   bytes = Min(total, (unsigned long)length * 4);
+   unit = rp->format / 8;
+   if(bytes > fetched || unit == 0) {
+      return ReadProperty(d, w, atom, offset, length, shouldDelete,
+                          reqType, actualType, actualFormat, count,
+                          bytesAfter, data);
+   }
+   items = bytes / unit;
+   value = xcb_get_property_value(rp);
+
+   switch(rp->format) {
+   case 8:
+      *data = malloc(items + 1);
+      memcpy(*data, value, items);
+      (*data)[items] = 0;
+      break;
+   case 16:
+      *data = malloc(items * sizeof(short) + 1);
+      for(x = 0; x < items; x++) {
+         ((short*)*data)[x] = ((const int16_t*)value)[x];
+      }
+      (*data)[items * sizeof(short)] = 0;
+      break;
+   default:
+      *data = malloc(items * sizeof(long) + 1);
+      for(x = 0; x < items; x++) {
+         ((long*)*data)[x] = ((const int32_t*)value)[x];
+      }
+      (*data)[items * sizeof(long)] = 0;
+      break;
+   }
+   *count = items;
+   *bytesAfter = total - bytes;
+   return Success;
+}
+
+#endif /* USE_XCB */
@@ -0,0 +1,66 @@
+/**
+ * @file prefetch.h
+ * @author Joe Wingbermuehle
+ * @date 2026
+ *
+ * @brief Pipelined property reads for new clients.
+ *
+ */
+
+#ifndef PREFETCH_H
+#define PREFETCH_H
+
+/** Maximum number of windows to prefetch at once. */
+#define PREFETCH_WINDOWS 32
+
+/** Determine which windows are viewable and not override-redirect.
+ * With XCB the attributes for all windows are requested at once.
+ * @param wins The windows (compacted in place to the matching windows).
+ * @param count The number of windows.
+ * @return The number of matching windows.
+ */
+unsigned int FilterViewableWindows(Window *wins, unsigned int count);
+
+#ifdef USE_XCB
+
+/** Request the properties read when clients are managed.
+ * The requests are sent at once; replies are collected as the
+ * properties are read with JXGetWindowProperty.
+ * Windows that were already requested are skipped.
+ * @param wins The client windows.
+ * @param count The number of windows.
+ */
+void PrefetchProperties(const Window *wins, unsigned int count);
+
+/** Release prefetched properties for a window.
+ * @param w The client window.
+ */
+void ReleasePrefetch(Window w);
+
+/** Release all prefetched properties. */
+void FinishPrefetch(void);
+
+/** Read a window property, using a prefetched reply if possible.
+ * This has the same interface as XGetWindowProperty.
+ */
+int GetPrefetchedProperty(Display *d, Window w, Atom atom,
+                          long offset, long length, Bool shouldDelete,
+                          Atom reqType, Atom *actualType,
+                          int *actualFormat, unsigned long *count,
+                          unsigned long *bytesAfter, unsigned char **data);
+
+/** Drop a prefetched property that is about to change.
+ * @param w The window.
+ * @param atom The property.
+ */
+void ForgetPrefetchedProperty(Window w, Atom atom);
+
+#else
+
+#define PrefetchProperties( w, c )     ((void)0)
+#define ReleasePrefetch( w )           ((void)0)
+#define FinishPrefetch()               ((void)0)
+
+#endif /* USE_XCB */
+
+#endif /* PREFETCH_H */
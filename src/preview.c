@@ -0,0 +1,243 @@
+/**
+ * @file preview.c
+ * @author Joe Wingbermuehle
+ * @date 2026
+ *
+ * @brief Live window previews for the pager.
+ *
+ * Top-level windows are redirected so the server keeps their contents.
+ * Each client shown on a pager keeps a scaled copy of its frame that is
+ * refreshed only after the frame reports damage. The damage is not
+ * cleared until the preview is refreshed, so a window that keeps
+ * drawing while the pager is hidden sends only one event.
+ *
+ */
+
+#include "jwm.h"
+
+#ifdef USE_XCOMPOSITE
+
+#include "preview.h"
+#include "border.h"
+#include "client.h"
+#include "event.h"
+#include "main.h"
+#include "misc.h"
+#include "render.h"
+#include "timing.h"
+
+/** Minimum milliseconds between refreshes of a preview. */
+#define PREVIEW_INTERVAL 500
+
+/** The preview of a client. */
+typedef struct PreviewNode {
+   Damage damage;          /**< Damage object for the frame. */
+   Pixmap pixmap;          /**< The scaled contents (None if none yet). */
+   Picture picture;        /**< Picture for the pixmap. */
+   int width, height;      /**< Size of the pixmap. */
+   unsigned int serial;    /**< Contents serial (0 if none yet). */
+   char damaged;           /**< Set if the frame changed since refresh. */
+   TimeType refreshed;     /**< Time of the last refresh. */
+} PreviewNode;
+
+static char previewsEnabled = 0;
+static char previewsActive = 0;
+static char retryPending = 0;
+static unsigned int lastSerial = 0;
+
+static void RefreshPreview(ClientNode *np, PreviewNode *pp,
+                           int width, int height);
+static void PreviewTimeout(const TimeType *now, int x, int y, Window w,
+                           void *data);
+
+/** Reset the preview configuration. */
+void InitializePreviews(void)
+{
+   previewsEnabled = 0;
+}
+
+/** Start keeping window contents if a pager shows previews. */
+void StartupPreviews(void)
+{
+   if(previewsEnabled && haveComposite && haveRender) {
+      JXCompositeRedirectSubwindows(display, rootWindow,
+                                    CompositeRedirectAutomatic);
+      previewsActive = 1;
+   }
+}
+
+/** Stop keeping window contents. */
+void ShutdownPreviews(void)
+{
+   if(previewsActive) {
+      JXCompositeUnredirectSubwindows(display, rootWindow,
+                                      CompositeRedirectAutomatic);
+      previewsActive = 0;
+   }
+   if(retryPending) {
+      UnregisterTimeout(PreviewTimeout, NULL);
+      retryPending = 0;
+   }
+}
+
+/** Request previews. */
+void EnablePreviews(void)
+{
+   previewsEnabled = 1;
+}
+
+/** Update the preview of a client. */
+unsigned int UpdatePreview(ClientNode *np, int width, int height,
+                           char refresh)
+{
+   const unsigned int hiddenMask = STAT_HIDDEN | STAT_MINIMIZED
+                                 | STAT_SHADED;
+   PreviewNode *pp;
+   TimeType now;
+
+   if(!previewsActive || np->parent == None || width <= 0 || height <= 0) {
+      return 0;
+   }
+
+   pp = np->preview;
+   if(!pp) {
+      pp = Allocate(sizeof(PreviewNode));
+      pp->damage = JXDamageCreate(display, np->parent,
+                                  XDamageReportNonEmpty);
+      pp->pixmap = None;
+      pp->picture = None;
+      pp->width = 0;
+      pp->height = 0;
+      pp->serial = 0;
+      pp->damaged = 1;
+      pp->refreshed.seconds = 0;
+      pp->refreshed.ms = 0;
+      np->preview = pp;
+   }
+
+   /* Windows that are not viewable keep their last preview. */
+   if(  !refresh || !(np->state.status & STAT_MAPPED)
+      || (np->state.status & hiddenMask)) {
+      return pp->serial;
+   }
+
+   if(pp->damaged || pp->width != width || pp->height != height) {
+      GetCurrentTime(&now);
+      if(  pp->serial == 0 || pp->width != width || pp->height != height
+         || GetTimeDifference(&now, &pp->refreshed) >= PREVIEW_INTERVAL) {
+         RefreshPreview(np, pp, width, height);
+         pp->refreshed = now;
+      } else if(!retryPending) {
+         retryPending = 1;
+         RegisterTimeout(PREVIEW_INTERVAL, PreviewTimeout, NULL);
+      }
+   }
+
+   return pp->serial;
+}
+
+/** Copy the contents of a frame to its preview. */
+void RefreshPreview(ClientNode *np, PreviewNode *pp, int width, int height)
+{
+   XRenderPictFormat *fp;
+   XTransform xf;
+   Pixmap contents;
+   Picture source;
+   int north, south, east, west;
+
+   fp = JXRenderFindVisualFormat(display, rootVisual);
+   Assert(fp);
+
+   if(pp->width != width || pp->height != height) {
+      if(pp->pixmap != None) {
+         JXRenderFreePicture(display, pp->picture);
+         JXFreePixmap(display, pp->pixmap);
+      }
+      pp->pixmap = JXCreatePixmap(display, rootWindow, width, height,
+                                  rootDepth);
+      pp->picture = JXRenderCreatePicture(display, pp->pixmap, fp, 0, NULL);
+      pp->width = width;
+      pp->height = height;
+   }
+
+   /* Scale the whole frame to the preview. */
+   GetBorderSize(&np->state, &north, &south, &east, &west);
+   contents = JXCompositeNameWindowPixmap(display, np->parent);
+   source = JXRenderCreatePicture(display, contents, fp, 0, NULL);
+   memset(&xf, 0, sizeof(xf));
+   xf.matrix[0][0] = ((np->width + east + west) << 16) / width;
+   xf.matrix[1][1] = ((np->height + north + south) << 16) / height;
+   xf.matrix[2][2] = 65536;
+   XRenderSetPictureTransform(display, source, &xf);
+   XRenderSetPictureFilter(display, source, FilterGood, NULL, 0);
+   JXRenderComposite(display, PictOpSrc, source, None, pp->picture,
+                     0, 0, 0, 0, 0, 0, width, height);
+   JXRenderFreePicture(display, source);
+   JXFreePixmap(display, contents);
+
+   JXDamageSubtract(display, pp->damage, None, None);
+   pp->damaged = 0;
+   lastSerial += 1;
+   if(JUNLIKELY(lastSerial == 0)) {
+      lastSerial = 1;
+   }
+   pp->serial = lastSerial;
+}
+
+/** Draw the preview of a client. */
+char PutPreview(const ClientNode *np, Drawable d,
+                int x, int y, int width, int height)
+{
+   const PreviewNode *pp = np->preview;
+   if(!previewsActive || !pp || pp->picture == None) {
+      return 0;
+   }
+   JXRenderComposite(display, PictOpSrc, pp->picture, None,
+                     GetRenderTarget(d), 0, 0, 0, 0, x, y,
+                     Min(width, pp->width), Min(height, pp->height));
+   return 1;
+}
+
+/** Release the preview of a client. */
+void ReleasePreview(ClientNode *np)
+{
+   PreviewNode *pp = np->preview;
+   if(pp) {
+      JXDamageDestroy(display, pp->damage);
+      if(pp->pixmap != None) {
+         JXRenderFreePicture(display, pp->picture);
+         JXFreePixmap(display, pp->pixmap);
+      }
+      Release(pp);
+      np->preview = NULL;
+   }
+}
+
+/** Handle a damage event. */
+char HandlePreviewEvent(const XEvent *event)
+{
+   const XDamageNotifyEvent *de;
+   ClientNode *np;
+
+   if(!haveComposite || event->type != damageEvent + XDamageNotify) {
+      return 0;
+   }
+
+   /* The pager redraws the client once the preview is refreshed. */
+   de = (const XDamageNotifyEvent*)event;
+   np = FindClient(de->drawable);
+   if(np && np->preview) {
+      np->preview->damaged = 1;
+      RequirePagerUpdate();
+   }
+   return 1;
+}
+
+/** Retry refreshes that were held back by the rate limit. */
+void PreviewTimeout(const TimeType *now, int x, int y, Window w, void *data)
+{
+   retryPending = 0;
+   RequirePagerUpdate();
+}
+
+#endif /* USE_XCOMPOSITE */
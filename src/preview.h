@@ -0,0 +1,78 @@
+/**
+ * @file preview.h
+ * @author Joe Wingbermuehle
+ * @date 2026
+ *
+ * @brief Live window previews for the pager.
+ *
+ */
+
+#ifndef PREVIEW_H
+#define PREVIEW_H
+
+struct ClientNode;
+
+#ifdef USE_XCOMPOSITE
+
+/** Reset the preview configuration. */
+void InitializePreviews(void);
+
+/** Start keeping window contents if a pager shows previews. */
+void StartupPreviews(void);
+
+/** Stop keeping window contents. */
+void ShutdownPreviews(void);
+
+/** Request previews (called when a pager with previews is created). */
+void EnablePreviews(void);
+
+/** Update the preview of a client.
+ * The preview is refreshed from the window if the window changed, it is
+ * viewable and the last refresh was long enough ago.
+ * @param np The client.
+ * @param width The width of the preview.
+ * @param height The height of the preview.
+ * @param refresh Set if the preview is shown and may be refreshed.
+ * @return The contents serial of the preview (0 if there is none).
+ */
+unsigned int UpdatePreview(struct ClientNode *np, int width, int height,
+                           char refresh);
+
+/** Draw the preview of a client.
+ * @param np The client.
+ * @param d The drawable.
+ * @param x The x-coordinate.
+ * @param y The y-coordinate.
+ * @param width The width of the area.
+ * @param height The height of the area.
+ * @return 1 if a preview was drawn, 0 otherwise.
+ */
+char PutPreview(const struct ClientNode *np, Drawable d,
+                int x, int y, int width, int height);
+
+/** Release the preview of a client.
+ * This must be called before the frame of the client is destroyed.
+ * @param np The client.
+ */
+void ReleasePreview(struct ClientNode *np);
+
+/** Handle a damage event.
+ * @param event The event.
+ * @return 1 if the event was a damage event, 0 otherwise.
+ */
+char HandlePreviewEvent(const XEvent *event);
+
+#else
+
+#define InitializePreviews()           ((void)0)
+#define StartupPreviews()              ((void)0)
+#define ShutdownPreviews()             ((void)0)
+#define EnablePreviews()               ((void)0)
+#define UpdatePreview( a, b, c, d )    0
+#define PutPreview( a, b, c, d, e, f ) 0
+#define ReleasePreview( a )            ((void)0)
+#define HandlePreviewEvent( a )        0
+
+#endif /* USE_XCOMPOSITE */
+
+#endif /* PREVIEW_H */
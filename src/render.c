@@ -14,10 +14,334 @@
 #include "main.h"
 #include "color.h"
 #include "misc.h"
+#include "settings.h"
+#include "shm.h"
+#include "gcpool.h"
+
+#ifdef USE_XRENDER
+
+/** Number of destination pictures to keep. */
+#define TARGET_COUNT 8
+
+/** A destination picture for a drawable. */
+typedef struct RenderTarget {
+   Drawable drawable;
+   Picture picture;
+} RenderTarget;
+
+/** Number of gradient pictures to keep. */
+#define GRADIENT_COUNT 32
+
+/** A linear gradient picture. */
+typedef struct RenderGradient {
+   Picture picture;           /**< The gradient (None if unused). */
+   long fromColor;            /**< The starting color pixel value. */
+   long toColor;              /**< The ending color pixel value. */
+   unsigned int height;       /**< Height of the gradient. */
+   unsigned long stamp;       /**< Last use, for replacement. */
+} RenderGradient;
+
+/** Number of icon atlases to keep. */
+#define ATLAS_COUNT 8
+
+/** Width and height of an icon atlas. */
+#define ATLAS_SIZE 256
+
+/** Largest icon to place in an atlas. */
+#define ATLAS_ICON_SIZE 48
+
+/** A picture shared by small icons.
+ * Icons are placed left to right on shelves, with a transparent pixel
+ * between them. Space is reused once every icon in the atlas is gone.
+ */
+typedef struct RenderAtlas {
+   Pixmap pixmap;             /**< The pixmap (None if unused). */
+   Picture picture;           /**< The picture for the pixmap. */
+   unsigned int users;        /**< Number of icons in the atlas. */
+   unsigned int shelfX;       /**< Next free column on the shelf. */
+   unsigned int shelfY;       /**< Top of the shelf. */
+   unsigned int shelfHeight;  /**< Height of the shelf. */
+   int xscale, yscale;        /**< Scale of the current transform. */
+   int xoffset, yoffset;      /**< Translation of the current transform. */
+} RenderAtlas;
+
+static RenderTarget targets[TARGET_COUNT];
+static unsigned int nextTarget = 0;
+
+static RenderGradient gradients[GRADIENT_COUNT];
+static unsigned long gradientStamp = 0;
+static int haveGradients = -1;
+
+static RenderAtlas atlases[ATLAS_COUNT];
+
+static void SetIconFilter(Picture picture);
+static char HaveRenderGradients(void);
+static Picture GetGradientPicture(long fromColor, long toColor,
+                                  unsigned int height);
+static int PlaceInAtlas(unsigned int width, unsigned int height,
+                        int *x, int *y);
+static void SetAtlasTransform(RenderAtlas *ap, int xscale, int yscale,
+                              int xoffset, int yoffset);
+
+/** Get the destination picture for a drawable.
+ * Pictures are kept for the most recently used drawables, so drawables
+ * must be released with ReleaseRenderTarget before they are freed.
+ */
+Picture GetRenderTarget(Drawable d)
+{
+   XRenderPictureAttributes pa;
+   XRenderPictFormat *fp;
+   RenderTarget *tp;
+   unsigned int x;
+
+   for(x = 0; x < TARGET_COUNT; x++) {
+      if(targets[x].drawable == d && targets[x].picture != None) {
+         return targets[x].picture;
+      }
+   }
+
+   tp = &targets[nextTarget];
+   nextTarget = (nextTarget + 1) % TARGET_COUNT;
+   if(tp->picture != None) {
+      JXRenderFreePicture(display, tp->picture);
+   }
+
+   fp = JXRenderFindVisualFormat(display, rootVisual);
+   Assert(fp);
+   pa.subwindow_mode = IncludeInferiors;
+   tp->drawable = d;
+   tp->picture = JXRenderCreatePicture(display, d, fp, CPSubwindowMode, &pa);
+   return tp->picture;
+}
+
+/** Set the configured scaling filter on a picture. */
+void SetIconFilter(Picture picture)
+{
+   const char *filter;
+   switch(settings.iconFilter) {
+   case ICON_FILTER_GOOD:
+      filter = FilterGood;
+      break;
+   case ICON_FILTER_BILINEAR:
+      filter = FilterBilinear;
+      break;
+   case ICON_FILTER_NEAREST:
+      filter = FilterNearest;
+      break;
+   default:
+      filter = FilterBest;
+      break;
+   }
+   XRenderSetPictureFilter(display, picture, filter, NULL, 0);
+}
+
+/** Determine if gradients can be drawn by the server.
+ * Gradient pictures were added in version 0.10 of the extension. The
+ * core path allocates the color of each line, so other visuals are
+ * left to it.
+ */
+char HaveRenderGradients(void)
+{
+   if(haveGradients < 0) {
+      int major = 0;
+      int minor = 0;
+      haveGradients = 0;
+      if(  haveRender && rootVisual->class == TrueColor
+         && JXRenderQueryVersion(display, &major, &minor)) {
+         haveGradients = major > 0 || minor >= 10;
+      }
+   }
+   return haveGradients != 0;
+}
+
+/** Get the picture for a gradient, creating it if needed. */
+Picture GetGradientPicture(long fromColor, long toColor, unsigned int height)
+{
+   XLinearGradient line;
+   XFixed stops[2];
+   XRenderColor colors[2];
+   XColor c;
+   RenderGradient *gp;
+   RenderGradient *best;
+   unsigned int i;
+
+   gradientStamp += 1;
+   best = &gradients[0];
+   for(i = 0; i < GRADIENT_COUNT; i++) {
+      gp = &gradients[i];
+      if(  gp->picture != None && gp->height == height
+         && gp->fromColor == fromColor && gp->toColor == toColor) {
+         gp->stamp = gradientStamp;
+         return gp->picture;
+      }
+      if(gp->stamp < best->stamp) {
+         best = gp;
+      }
+   }
+
+   c.pixel = fromColor;
+   GetColorFromPixel(&c);
+   colors[0].red = c.red;
+   colors[0].green = c.green;
+   colors[0].blue = c.blue;
+   colors[0].alpha = 0xFFFF;
+   c.pixel = toColor;
+   GetColorFromPixel(&c);
+   colors[1].red = c.red;
+   colors[1].green = c.green;
+   colors[1].blue = c.blue;
+   colors[1].alpha = 0xFFFF;
+   stops[0] = XDoubleToFixed(0.0);
+   stops[1] = XDoubleToFixed(1.0);
+   line.p1.x = 0;
+   line.p1.y = 0;
+   line.p2.x = 0;
+   line.p2.y = XDoubleToFixed(height);
+
+   gp = best;
+   if(gp->picture != None) {
+      JXRenderFreePicture(display, gp->picture);
+   }
+   gp->picture = JXRenderCreateLinearGradient(display, &line, stops,
+                                              colors, 2);
+   gp->fromColor = fromColor;
+   gp->toColor = toColor;
+   gp->height = height;
+   gp->stamp = gradientStamp;
+   return gp->picture;
+}
+
+/** Find space for an icon in an atlas.
+ * @return The atlas index (-1 if the icon does not fit in any atlas).
+ */
+int PlaceInAtlas(unsigned int width, unsigned int height, int *x, int *y)
+{
+   XRenderPictFormat *fp;
+   XRenderColor clear;
+   RenderAtlas *ap;
+   int i;
+
+   if(width > ATLAS_ICON_SIZE || height > ATLAS_ICON_SIZE) {
+      return -1;
+   }
+
+   for(i = 0; i < ATLAS_COUNT; i++) {
+      ap = &atlases[i];
+      if(ap->pixmap == None) {
+         fp = JXRenderFindStandardFormat(display, PictStandardARGB32);
+         Assert(fp);
+         ap->pixmap = JXCreatePixmap(display, rootWindow,
+                                     ATLAS_SIZE, ATLAS_SIZE, 32);
+         ap->picture = JXRenderCreatePicture(display, ap->pixmap, fp, 0, NULL);
+         SetIconFilter(ap->picture);
+         memset(&clear, 0, sizeof(clear));
+         JXRenderFillRectangle(display, PictOpSrc, ap->picture, &clear,
+                               0, 0, ATLAS_SIZE, ATLAS_SIZE);
+         ap->users = 0;
+         ap->shelfX = 0;
+         ap->shelfY = 0;
+         ap->shelfHeight = 0;
+         ap->xscale = 65536;
+         ap->yscale = 65536;
+         ap->xoffset = 0;
+         ap->yoffset = 0;
+      }
+
+      /* Start a new shelf if the icon does not fit on the current one. */
+      if(  ap->shelfX + width > ATLAS_SIZE
+         || (ap->shelfX > 0 && height > ap->shelfHeight)) {
+         ap->shelfY += ap->shelfHeight + 1;
+         ap->shelfX = 0;
+         ap->shelfHeight = 0;
+      }
+      if(ap->shelfY + height <= ATLAS_SIZE) {
+         *x = ap->shelfX;
+         *y = ap->shelfY;
+         ap->shelfX += width + 1;
+         ap->shelfHeight = Max(ap->shelfHeight, height);
+         ap->users += 1;
+         return i;
+      }
+   }
+
+   return -1;
+}
+
+/** Set the transform of an atlas picture if it changed. */
+void SetAtlasTransform(RenderAtlas *ap, int xscale, int yscale,
+                       int xoffset, int yoffset)
+{
+   XTransform xf;
+   if(  ap->xscale != xscale || ap->yscale != yscale
+      || ap->xoffset != xoffset || ap->yoffset != yoffset) {
+      memset(&xf, 0, sizeof(xf));
+      xf.matrix[0][0] = xscale;
+      xf.matrix[0][2] = xoffset << 16;
+      xf.matrix[1][1] = yscale;
+      xf.matrix[1][2] = yoffset << 16;
+      xf.matrix[2][2] = 65536;
+      XRenderSetPictureTransform(display, ap->picture, &xf);
+      ap->xscale = xscale;
+      ap->yscale = yscale;
+      ap->xoffset = xoffset;
+      ap->yoffset = yoffset;
+   }
+}
+
+#endif /* USE_XRENDER */
+
+/** Draw part of a gradient. */
+char PutRenderGradient(Drawable d, long fromColor, long toColor,
+                       int x, int y, unsigned int width, unsigned int height,
+                       int offset, unsigned int span)
+{
+#ifdef USE_XRENDER
+   Picture source;
+   if(!HaveRenderGradients()) {
+      return 0;
+   }
+   source = GetGradientPicture(fromColor, toColor, span);
+   JXRenderComposite(display, PictOpSrc, source, None, GetRenderTarget(d),
+                     0, offset, 0, 0, x, y, width, height);
+   return 1;
+#else
+   return 0;
+#endif
+}
+
+/** Release gradient pictures. */
+void ReleaseRenderGradients(void)
+{
+#ifdef USE_XRENDER
+   unsigned int i;
+   for(i = 0; i < GRADIENT_COUNT; i++) {
+      if(gradients[i].picture != None) {
+         JXRenderFreePicture(display, gradients[i].picture);
+         gradients[i].picture = None;
+      }
+   }
+   gradientStamp = 0;
+#endif
+}
+
+/** Release the destination picture for a drawable. */
+void ReleaseRenderTarget(Drawable d)
+{
+#ifdef USE_XRENDER
+   unsigned int x;
+   for(x = 0; x < TARGET_COUNT; x++) {
+      if(targets[x].drawable == d && targets[x].picture != None) {
+         JXRenderFreePicture(display, targets[x].picture);
+         targets[x].drawable = None;
+         targets[x].picture = None;
+      }
+   }
+#endif
+}
 
 /** Draw a scaled icon. */
 void PutScaledRenderIcon(const IconNode *icon,
-                         const ScaledIconNode *node,
+                         ScaledIconNode *node,
                          Drawable d, int x, int y, int width, int height)
 {
 
@@ -31,17 +355,12 @@ void PutScaledRenderIcon(const IconNode *icon,
    source = node->image;
    if(source != None) {
 
-      XRenderPictureAttributes pa;
       XTransform xf;
       int xscale, yscale;
       int nwidth, nheight;
       Picture dest;
-      Picture alpha = node->mask;
-      XRenderPictFormat *fp = JXRenderFindVisualFormat(display, rootVisual);
-      Assert(fp);
 
-      pa.subwindow_mode = IncludeInferiors;
-      dest = JXRenderCreatePicture(display, d, fp, CPSubwindowMode, &pa);
+      dest = GetRenderTarget(d);
 
       width = width == 0 ? node->width : width;
       height = height == 0 ? node->height : height;
@@ -61,19 +380,37 @@ void PutScaledRenderIcon(const IconNode *icon,
       xscale = (node->width << 16) / nwidth;
       yscale = (node->height << 16) / nheight;
 
-      memset(&xf, 0, sizeof(xf));
-      xf.matrix[0][0] = xscale;
-      xf.matrix[1][1] = yscale;
-      xf.matrix[2][2] = 65536;
-      XRenderSetPictureTransform(display, source, &xf);
-      XRenderSetPictureFilter(display, source, FilterBest, NULL, 0);
-      XRenderSetPictureTransform(display, alpha, &xf);
-      XRenderSetPictureFilter(display, alpha, FilterBest, NULL, 0);
+      /* Icons in an atlas are drawn from their part of the atlas. When
+       * scaled, the transform moves the source to that part. */
+      if(node->atlas >= 0) {
+         RenderAtlas *ap = &atlases[node->atlas];
+         if(xscale == 65536 && yscale == 65536) {
+            SetAtlasTransform(ap, xscale, yscale, 0, 0);
+            JXRenderComposite(display, PictOpOver, source, None, dest,
+                              node->atlasX, node->atlasY, 0, 0, x, y,
+                              nwidth, nheight);
+         } else {
+            SetAtlasTransform(ap, xscale, yscale,
+                              node->atlasX, node->atlasY);
+            JXRenderComposite(display, PictOpOver, source, None, dest,
+                              0, 0, 0, 0, x, y, nwidth, nheight);
+         }
+         return;
+      }
 
-      JXRenderComposite(display, PictOpOver, source, alpha, dest,
-                        0, 0, 0, 0, x, y, width, height);
+      /* Icons are usually drawn at the same size every time. */
+      if(xscale != node->xscale || yscale != node->yscale) {
+         memset(&xf, 0, sizeof(xf));
+         xf.matrix[0][0] = xscale;
+         xf.matrix[1][1] = yscale;
+         xf.matrix[2][2] = 65536;
+         XRenderSetPictureTransform(display, source, &xf);
+         node->xscale = xscale;
+         node->yscale = yscale;
+      }
 
-      JXRenderFreePicture(display, dest);
+      JXRenderComposite(display, PictOpOver, source, None, dest,
+                        0, 0, 0, 0, x, y, width, height);
 
    }
 
@@ -81,7 +418,10 @@ void PutScaledRenderIcon(const IconNode *icon,
 
 }
 
-/** Create a scaled icon. */
+/** Create a scaled icon.
+ * The icon is uploaded as a single premultiplied ARGB picture so that no
+ * separate mask is needed to composite it.
+ */
 ScaledIconNode *CreateScaledRenderIcon(ImageNode *image, long fg)
 {
 
@@ -90,16 +430,11 @@ ScaledIconNode *CreateScaledRenderIcon(ImageNode *image, long fg)
 #ifdef USE_XRENDER
 
    XRenderPictFormat *fp;
-   XColor color;
-   GC maskGC;
+   GC gc;
    XImage *destImage;
-   XImage *destMask;
-   Pixmap pmap, mask;
+   Pixmap pmap;
    const unsigned width = image->width;
    const unsigned height = image->height;
-   unsigned perLine;
-   int x, y;
-   int maskLine;
 
    Assert(haveRender);
 
@@ -107,89 +442,125 @@ ScaledIconNode *CreateScaledRenderIcon(ImageNode *image, long fg)
    result->fg = fg;
    result->width = width;
    result->height = height;
+   result->mask = None;
 
-   mask = JXCreatePixmap(display, rootWindow, width, height, 8);
-   maskGC = JXCreateGC(display, mask, 0, NULL);
-   pmap = JXCreatePixmap(display, rootWindow, width, height, rootDepth);
+   /* Small icons share an atlas. */
+   result->atlas = PlaceInAtlas(width, height,
+                                &result->atlasX, &result->atlasY);
+   if(result->atlas >= 0) {
+      pmap = atlases[result->atlas].pixmap;
+   } else {
+      pmap = JXCreatePixmap(display, rootWindow, width, height, 32);
+      result->atlasX = 0;
+      result->atlasY = 0;
+   }
+   gc = AcquireGC(32, 0, NULL);
+   destImage = CreateUploadImage(32, width, height);
 
-   destImage = JXCreateImage(display, rootVisual, rootDepth,
-                             ZPixmap, 0, NULL, width, height, 8, 0);
-   destImage->data = Allocate(sizeof(unsigned long) * width * height);
+   ConvertRenderImage(image, fg, destImage);
 
-   destMask = JXCreateImage(display, rootVisual, 8, ZPixmap,
-                            0, NULL, width, height, 8, 0);
-   destMask->data = Allocate(width * height);
+   PutUploadImage(pmap, gc, destImage, result->atlasX, result->atlasY);
+   DestroyUploadImage(destImage);
+   ReleaseGC(gc);
 
-   if(image->bitmap) {
-      perLine = (image->width >> 3) + ((image->width & 7) ? 1 : 0);
+   result->xscale = 65536;
+   result->yscale = 65536;
+   if(result->atlas >= 0) {
+      result->image = atlases[result->atlas].picture;
    } else {
-      perLine = image->width;
-   }
-   maskLine = 0;
-   for(y = 0; y < height; y++) {
-      const int yindex = y * perLine;
-      for(x = 0; x < width; x++) {
-         if(image->bitmap) {
-
-            const int offset = yindex + (x >> 3);
-            const int mask = 1 << (x & 7);
-            unsigned long alpha = 0;
-            if(image->data[offset] & mask) {
-               alpha = 255;
-               XPutPixel(destImage, x, y, fg);
-            }
-            destMask->data[maskLine + x] = alpha;
-
-         } else {
+      fp = JXRenderFindStandardFormat(display, PictStandardARGB32);
+      Assert(fp);
+      result->image = JXRenderCreatePicture(display, pmap, fp, 0, NULL);
+      JXFreePixmap(display, pmap);
 
-            const int index = 4 * (yindex + x);
-            const unsigned long alpha = image->data[index];
-            color.red = image->data[index + 1];
-            color.red |= color.red << 8;
-            color.green = image->data[index + 2];
-            color.green |= color.green << 8;
-            color.blue = image->data[index + 3];
-            color.blue |= color.blue << 8;
-
-            color.red = (color.red * alpha) >> 8;
-            color.green = (color.green * alpha) >> 8;
-            color.blue = (color.blue * alpha) >> 8;
-
-            GetColor(&color);
-            XPutPixel(destImage, x, y, color.pixel);
-            destMask->data[maskLine + x] = alpha;
-         }
-      }
-      maskLine += destMask->bytes_per_line;
+      /* Pictures start with the identity transform. */
+      SetIconFilter(result->image);
    }
 
-   /* Render the image data to the image pixmap. */
-   JXPutImage(display, pmap, rootGC, destImage, 0, 0, 0, 0, width, height);
-   Release(destImage->data);
-   destImage->data = NULL;
-   JXDestroyImage(destImage);
+#endif
 
-   /* Render the alpha data to the mask pixmap. */
-   JXPutImage(display, mask, maskGC, destMask, 0, 0, 0, 0, width, height);
-   Release(destMask->data);
-   destMask->data = NULL;
-   JXDestroyImage(destMask);
-   JXFreeGC(display, maskGC);
+   return result;
 
-   /* Create the alpha picture. */
-   fp = JXRenderFindStandardFormat(display, PictStandardA8);
-   Assert(fp);
-   result->mask = JXRenderCreatePicture(display, mask, fp, 0, NULL);
-   JXFreePixmap(display, mask);
+}
 
-   /* Create the render picture. */
-   fp = JXRenderFindVisualFormat(display, rootVisual);
-   Assert(fp);
-   result->image = JXRenderCreatePicture(display, pmap, fp, 0, NULL);
-   JXFreePixmap(display, pmap);
+#ifdef USE_XRENDER
+/** Convert an image to premultiplied ARGB for upload. */
+void ConvertRenderImage(const ImageNode *image, long fg, XImage *destImage)
+{
+   XColor color;
+   const unsigned width = image->width;
+   const unsigned height = image->height;
+   const unsigned char *src;
+   unsigned char *dest;
+   unsigned long fgPixel;
+   unsigned x, y;
+   int shift[4];
+
+   /* Shifts to store each byte of a pixel in the image byte order. */
+   for(x = 0; x < 4; x++) {
+      shift[x] = destImage->byte_order == MSBFirst ? 24 - 8 * x : 8 * x;
+   }
 
-#endif
+   fgPixel = 0;
+   if(image->bitmap) {
+      color.pixel = fg;
+      GetColorFromPixel(&color);
+      fgPixel = 0xFF000000UL
+              | ((unsigned long)(color.red >> 8) << 16)
+              | ((unsigned long)(color.green >> 8) << 8)
+              | (unsigned long)(color.blue >> 8);
+   }
 
-   return result;
+   for(y = 0; y < height; y++) {
+      dest = (unsigned char*)&destImage->data[y * destImage->bytes_per_line];
+      if(image->bitmap) {
+         src = &image->data[y * ((width + 7) / 8)];
+         for(x = 0; x < width; x++) {
+            const unsigned long pixel
+               = (src[x >> 3] & (1 << (x & 7))) ? fgPixel : 0;
+            dest[0] = (unsigned char)(pixel >> shift[0]);
+            dest[1] = (unsigned char)(pixel >> shift[1]);
+            dest[2] = (unsigned char)(pixel >> shift[2]);
+            dest[3] = (unsigned char)(pixel >> shift[3]);
+            dest += 4;
+         }
+      } else {
+         src = &image->data[4 * y * width];
+         for(x = 0; x < width; x++) {
+            const unsigned int alpha = src[0];
+            const unsigned long pixel
+               = ((unsigned long)alpha << 24)
+               | ((unsigned long)((src[1] * alpha + 127) / 255) << 16)
+               | ((unsigned long)((src[2] * alpha + 127) / 255) << 8)
+               | (unsigned long)((src[3] * alpha + 127) / 255);
+            dest[0] = (unsigned char)(pixel >> shift[0]);
+            dest[1] = (unsigned char)(pixel >> shift[1]);
+            dest[2] = (unsigned char)(pixel >> shift[2]);
+            dest[3] = (unsigned char)(pixel >> shift[3]);
+            src += 4;
+            dest += 4;
+         }
+      }
+   }
+}
+#endif
 
+/** Release the server resources of a scaled icon. */
+void ReleaseScaledRenderIcon(ScaledIconNode *node)
+{
+#ifdef USE_XRENDER
+   if(node->atlas >= 0) {
+      RenderAtlas *ap = &atlases[node->atlas];
+      Assert(ap->users > 0);
+      ap->users -= 1;
+      if(ap->users == 0) {
+         JXRenderFreePicture(display, ap->picture);
+         JXFreePixmap(display, ap->pixmap);
+         ap->picture = None;
+         ap->pixmap = None;
+      }
+   } else if(node->image != None) {
+      JXRenderFreePicture(display, node->image);
+   }
+#endif
 }
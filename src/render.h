@@ -25,9 +25,43 @@ struct ScaledIconNode;
  * @return 1 if the icon was successfully rendered, 0 otherwise.
  */
 void PutScaledRenderIcon(const struct IconNode *image,
-                         const struct ScaledIconNode *node,
+                         struct ScaledIconNode *node,
                          Drawable d, int x, int y, int width, int height);
 
+#ifdef USE_XRENDER
+/** Get the destination picture for a drawable.
+ * @param d The drawable.
+ * @return The picture, which must not be freed.
+ */
+Picture GetRenderTarget(Drawable d);
+#endif
+
+/** Release the picture used to draw icons on a drawable.
+ * This must be called before freeing a pixmap that icons were drawn on.
+ * @param d The drawable.
+ */
+void ReleaseRenderTarget(Drawable d);
+
+/** Draw part of a vertical gradient on the server.
+ * Rows offset to offset + height of a gradient span rows tall are drawn.
+ * @param d The drawable.
+ * @param fromColor The starting color pixel value.
+ * @param toColor The ending color pixel value.
+ * @param x The x-coordinate.
+ * @param y The y-coordinate.
+ * @param width The width of the area to fill.
+ * @param height The height of the area to fill.
+ * @param offset The first row of the gradient to draw.
+ * @param span The height of the whole gradient.
+ * @return 1 if the gradient was drawn, 0 if the server can't draw it.
+ */
+char PutRenderGradient(Drawable d, long fromColor, long toColor,
+                       int x, int y, unsigned int width, unsigned int height,
+                       int offset, unsigned int span);
+
+/** Release gradient pictures. */
+void ReleaseRenderGradients(void);
+
 /** Create a scaled icon.
  * @param image The image.
  * @param fg The foreground color (for bitmaps).
@@ -35,4 +69,19 @@ void PutScaledRenderIcon(const struct IconNode *image,
  */
 struct ScaledIconNode *CreateScaledRenderIcon(struct ImageNode *image, long fg);
 
+#ifdef USE_XRENDER
+/** Convert an image to the premultiplied ARGB pixels of a render icon.
+ * @param image The image.
+ * @param fg The foreground color (for bitmaps).
+ * @param dest The 32-bit image to fill (the size of the image).
+ */
+void ConvertRenderImage(const struct ImageNode *image, long fg,
+                        XImage *dest);
+#endif
+
+/** Release the server resources of a scaled icon.
+ * @param node The scaled icon from CreateScaledRenderIcon.
+ */
+void ReleaseScaledRenderIcon(struct ScaledIconNode *node);
+
 #endif /* RENDER_H */
@@ -18,8 +18,10 @@
 #include "binding.h"
 #include "event.h"
 #include "settings.h"
+#include "xsync.h"
 
 static char shouldStopResize;
+static char resizePending;
 
 static void StopResize(ClientNode *np);
 static void ResizeController(int wasDestroyed);
@@ -30,6 +32,7 @@ static void UpdateSize(ClientNode *np, const MouseContextType context,
                        const int oldw, const int oldh);
 static void FixWidth(ClientNode *np);
 static void FixHeight(ClientNode *np);
+static void ApplyResize(ClientNode *np);
 
 /** Callback to stop a resize. */
 void ResizeController(int wasDestroyed)
@@ -40,6 +43,8 @@ void ResizeController(int wasDestroyed)
    JXUngrabPointer(display, CurrentTime);
    JXUngrabKeyboard(display, CurrentTime);
    DestroyResizeWindow();
+   CancelMotionEvents();
+   StopSyncResize();
    shouldStopResize = 1;
 }
 
@@ -157,7 +162,7 @@ void ResizeClient(ClientNode *np, MouseContextType context,
    gwidth = (np->width - np->baseWidth) / np->xinc;
    gheight = (np->height - np->baseHeight) / np->yinc;
 
-   GetBorderSize(&np->state, &north, &south, &east, &west);
+   GetClientBorderSize(np, &north, &south, &east, &west);
 
    startx += np->x - west;
    starty += np->y - north;
@@ -170,6 +175,11 @@ void ResizeClient(ClientNode *np, MouseContextType context,
       return;
    }
 
+   resizePending = 0;
+   if(settings.resizeMode != RESIZE_OUTLINE) {
+      StartSyncResize(np);
+   }
+
    for(;;) {
 
       WaitForEvent(&event);
@@ -183,6 +193,9 @@ void ResizeClient(ClientNode *np, MouseContextType context,
       case ButtonRelease:
          if(   event.xbutton.button == Button1
             || event.xbutton.button == Button3) {
+            if(ReplayMotionEvent(&event)) {
+               break;
+            }
             StopResize(np);
             return;
          }
@@ -192,6 +205,9 @@ void ResizeClient(ClientNode *np, MouseContextType context,
          SetMousePosition(event.xmotion.x_root, event.xmotion.y_root,
                           event.xmotion.window);
          DiscardMotionEvents(&event, np->window);
+         if(DeferMotionEvent(&event, settings.resizeRate)) {
+            break;
+         }
 
          UpdateSize(np, context, event.xmotion.x, event.xmotion.y,
                     startx, starty, oldx, oldy, oldw, oldh);
@@ -207,7 +223,6 @@ void ResizeClient(ClientNode *np, MouseContextType context,
             UpdateResizeWindow(np, gwidth, gheight);
 
             if(settings.resizeMode == RESIZE_OUTLINE) {
-               ClearOutline();
                if(np->state.status & STAT_SHADED) {
                   DrawOutline(np->x - west, np->y - north,
                      np->width + west + east, north + south);
@@ -216,9 +231,11 @@ void ResizeClient(ClientNode *np, MouseContextType context,
                      np->width + west + east,
                      np->height + north + south);
                }
+            } else if(IsSyncPending()) {
+               /* Wait for the client to catch up. */
+               resizePending = 1;
             } else {
-               ResetBorder(np);
-               SendConfigureEvent(np);
+               ApplyResize(np);
             }
 
             RequirePagerUpdate();
@@ -227,12 +244,24 @@ void ResizeClient(ClientNode *np, MouseContextType context,
 
          break;
       default:
+         if(HandleSyncEvent(&event) && resizePending) {
+            ApplyResize(np);
+         }
          break;
       }
    }
 
 }
 
+/** Resize the client to its current size. */
+void ApplyResize(ClientNode *np)
+{
+   resizePending = 0;
+   SendSyncRequest(np);
+   ResetBorder(np);
+   SendConfigureEvent(np);
+}
+
 /** Resize a client window (keyboard or menu initiated). */
 void ResizeClientKeyboard(ClientNode *np, MouseContextType context)
 {
@@ -279,7 +308,7 @@ void ResizeClientKeyboard(ClientNode *np, MouseContextType context)
    gwidth = (np->width - np->baseWidth) / np->xinc;
    gheight = (np->height - np->baseHeight) / np->yinc;
 
-   GetBorderSize(&np->state, &north, &south, &east, &west);
+   GetClientBorderSize(np, &north, &south, &east, &west);
 
    CreateResizeWindow(np);
    UpdateResizeWindow(np, gwidth, gheight);
@@ -390,7 +419,6 @@ void ResizeClientKeyboard(ClientNode *np, MouseContextType context)
          UpdateResizeWindow(np, gwidth, gheight);
 
          if(settings.resizeMode == RESIZE_OUTLINE) {
-            ClearOutline();
             if(np->state.status & STAT_SHADED) {
                DrawOutline(np->x - west, np->y - north,
                   np->width + west + east,
@@ -438,6 +466,9 @@ void StopResize(ClientNode *np)
    JXUngrabKeyboard(display, CurrentTime);
 
    DestroyResizeWindow();
+   CancelMotionEvents();
+   StopSyncResize();
+   resizePending = 0;
 
    ResetBorder(np);
    SendConfigureEvent(np);
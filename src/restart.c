@@ -0,0 +1,267 @@
+/**
+ * @file restart.c
+ * @author Joe Wingbermuehle
+ * @date 2026
+ *
+ * @brief Client state carried across a restart.
+ *
+ * Most of the state of a client survives a restart in its properties,
+ * but the stacking order within a layer, the geometry to restore after
+ * maximizing, and the focused window do not. These are written to a
+ * property on the root window when JWM shuts down for a restart and are
+ * read back when the clients are adopted again, either by this process
+ * or by a new binary started with exec.
+ *
+ */
+
+#include "jwm.h"
+#include "restart.h"
+#include "client.h"
+#include "clientlist.h"
+#include "main.h"
+#include "event.h"
+#include "settings.h"
+#include "misc.h"
+
+/** Version of the saved state layout. */
+#define RESTART_VERSION    1
+
+/** Number of values in the header. */
+#define RESTART_HEADER     3
+
+/** Number of values saved for each client. */
+#define RESTART_RECORD     9
+
+/** Status bits carried across a restart. */
+#define RESTART_STATUS_MASK                                          \
+   (STAT_STICKY | STAT_MINIMIZED | STAT_SHADED | STAT_SDESKTOP       \
+   | STAT_FULLSCREEN | STAT_NOLIST | STAT_NOPAGER)
+
+/** Saved state of a client. */
+typedef struct RestartRecord {
+   Window window;
+   unsigned int status;
+   unsigned short desktop;
+   unsigned char layer;
+   unsigned char maxFlags;
+   int oldx, oldy;
+   int oldWidth, oldHeight;
+   unsigned int order;           /**< Position in the stack (0 is top). */
+   struct ClientNode *client;    /**< The client once adopted. */
+} RestartRecord;
+
+static RestartRecord *records = NULL;
+static unsigned int recordCount = 0;
+static Window savedActive = None;
+
+static int CompareRecordWindow(const void *a, const void *b);
+static int CompareRecordOrder(const void *a, const void *b);
+
+/** Save the state of all clients on the root window. */
+void SaveRestartState(void)
+{
+   ClientNode *np;
+   unsigned long *data;
+   unsigned int count;
+   unsigned int index;
+   unsigned int layer;
+
+   count = 0;
+   for(layer = FIRST_LAYER; layer <= LAST_LAYER; layer++) {
+      for(np = nodes[layer]; np; np = np->next) {
+         count += 1;
+      }
+   }
+
+   data = Allocate(sizeof(unsigned long)
+                   * (RESTART_HEADER + count * RESTART_RECORD));
+   np = GetActiveClient();
+   data[0] = RESTART_VERSION;
+   data[1] = np ? np->window : None;
+   data[2] = count;
+
+   /* Clients are written from the top of the stack down. */
+   index = RESTART_HEADER;
+   for(layer = LAST_LAYER + 1; layer > FIRST_LAYER; layer--) {
+      for(np = nodes[layer - 1]; np; np = np->next) {
+         data[index++] = np->window;
+         data[index++] = np->state.status & RESTART_STATUS_MASK;
+         data[index++] = np->state.desktop;
+         data[index++] = np->state.layer;
+         data[index++] = np->state.maxFlags;
+         data[index++] = (unsigned long)np->oldx;
+         data[index++] = (unsigned long)np->oldy;
+         data[index++] = (unsigned long)np->oldWidth;
+         data[index++] = (unsigned long)np->oldHeight;
+      }
+   }
+
+   JXChangeProperty(display, rootWindow, atoms[ATOM_JWM_RESTART_STATE],
+                    XA_CARDINAL, 32, PropModeReplace,
+                    (unsigned char*)data, index);
+   Release(data);
+}
+
+/** Determine if a previous instance left its state on the root window. */
+char HaveRestartState(void)
+{
+   unsigned long version;
+   return GetCardinalAtom(rootWindow, ATOM_JWM_RESTART_STATE, &version)
+      && version == RESTART_VERSION;
+}
+
+/** Load and remove the saved state from the root window. */
+void LoadRestartState(void)
+{
+   unsigned long count;
+   unsigned long extra;
+   Atom realType;
+   int realFormat;
+   unsigned char *data;
+   int status;
+
+   Assert(records == NULL);
+   recordCount = 0;
+   savedActive = None;
+
+   count = 0;
+   status = JXGetWindowProperty(display, rootWindow,
+                                atoms[ATOM_JWM_RESTART_STATE], 0, LONG_MAX,
+                                True, XA_CARDINAL, &realType, &realFormat,
+                                &count, &extra, &data);
+   if(status != Success || realFormat != 32 || !data) {
+      return;
+   }
+   if(count >= RESTART_HEADER) {
+      const unsigned long *values = (const unsigned long*)data;
+      const unsigned long total = (count - RESTART_HEADER) / RESTART_RECORD;
+      if(values[0] == RESTART_VERSION && values[2] == total && total > 0) {
+         unsigned int x;
+         savedActive = (Window)values[1];
+         recordCount = (unsigned int)total;
+         records = Allocate(sizeof(RestartRecord) * recordCount);
+         values += RESTART_HEADER;
+         for(x = 0; x < recordCount; x++) {
+            RestartRecord *rp = &records[x];
+            rp->window = (Window)values[0];
+            rp->status = (unsigned int)values[1] & RESTART_STATUS_MASK;
+            rp->desktop = (unsigned short)values[2];
+            rp->layer = (unsigned char)Min(values[3], LAST_LAYER);
+            rp->maxFlags = (unsigned char)values[4];
+            rp->oldx = (int)(long)values[5];
+            rp->oldy = (int)(long)values[6];
+            rp->oldWidth = (int)(long)values[7];
+            rp->oldHeight = (int)(long)values[8];
+            rp->order = x;
+            rp->client = NULL;
+            values += RESTART_RECORD;
+         }
+         qsort(records, recordCount, sizeof(RestartRecord),
+               CompareRecordWindow);
+      }
+   }
+   JXFree(data);
+}
+
+/** Apply the saved state to a client being added. */
+void ApplyRestartState(ClientNode *np)
+{
+   RestartRecord key;
+   RestartRecord *rp;
+
+   if(!records) {
+      return;
+   }
+
+   key.window = np->window;
+   rp = bsearch(&key, records, recordCount, sizeof(RestartRecord),
+                CompareRecordWindow);
+   if(!rp || rp->client) {
+      return;
+   }
+   rp->client = np;
+
+   np->state.status &= ~RESTART_STATUS_MASK;
+   np->state.status |= rp->status;
+   if(rp->desktop < settings.desktopCount) {
+      np->state.desktop = rp->desktop;
+   }
+   np->state.layer = rp->layer;
+   np->state.maxFlags = rp->maxFlags;
+}
+
+/** Restore the stacking order and focus and release the saved state. */
+char FinishRestartState(void)
+{
+   ClientNode *np;
+   unsigned int x;
+   char focused = 0;
+
+   if(!records) {
+      return 0;
+   }
+
+   /* Move each restored client to the top of its layer from the bottom
+    * of the saved stack up. Clients that were not saved end up below. */
+   qsort(records, recordCount, sizeof(RestartRecord), CompareRecordOrder);
+   for(x = recordCount; x > 0; x--) {
+      const RestartRecord *rp = &records[x - 1];
+      np = rp->client;
+      if(!np) {
+         continue;
+      }
+
+      /* Maximizing while adopting replaced the geometry to restore. */
+      if(np->state.maxFlags != MAX_NONE) {
+         np->oldx = rp->oldx;
+         np->oldy = rp->oldy;
+         np->oldWidth = rp->oldWidth;
+         np->oldHeight = rp->oldHeight;
+      }
+
+      if(nodes[np->state.layer] == np) {
+         continue;
+      }
+      np->prev->next = np->next;
+      if(np->next) {
+         np->next->prev = np->prev;
+      } else {
+         nodeTail[np->state.layer] = np->prev;
+      }
+      np->prev = NULL;
+      np->next = nodes[np->state.layer];
+      np->next->prev = np;
+      nodes[np->state.layer] = np;
+   }
+   RequireRestack();
+
+   if(savedActive != None) {
+      np = FindClientByWindow(savedActive);
+      if(np && (np->state.status & STAT_MAPPED)) {
+         FocusClient(np);
+         focused = 1;
+      }
+   }
+
+   Release(records);
+   records = NULL;
+   recordCount = 0;
+   savedActive = None;
+   return focused;
+}
+
+/** Compare saved records by window. */
+int CompareRecordWindow(const void *a, const void *b)
+{
+   const Window wa = ((const RestartRecord*)a)->window;
+   const Window wb = ((const RestartRecord*)b)->window;
+   return (wa > wb) - (wa < wb);
+}
+
+/** Compare saved records by stacking order. */
+int CompareRecordOrder(const void *a, const void *b)
+{
+   const unsigned int oa = ((const RestartRecord*)a)->order;
+   const unsigned int ob = ((const RestartRecord*)b)->order;
+   return (oa > ob) - (oa < ob);
+}
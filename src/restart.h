@@ -0,0 +1,40 @@
+/**
+ * @file restart.h
+ * @author Joe Wingbermuehle
+ * @date 2026
+ *
+ * @brief Client state carried across a restart.
+ *
+ */
+
+#ifndef RESTART_H
+#define RESTART_H
+
+struct ClientNode;
+
+/** Save the state of all clients on the root window.
+ * This must be called before the clients are released.
+ */
+void SaveRestartState(void);
+
+/** Determine if a previous instance left its state on the root window.
+ * @return 1 if there is saved state, 0 otherwise.
+ */
+char HaveRestartState(void);
+
+/** Load and remove the saved state from the root window.
+ * This must be called before clients are added.
+ */
+void LoadRestartState(void);
+
+/** Apply the saved state to a client being added.
+ * @param np The client (not yet in the layer lists).
+ */
+void ApplyRestartState(struct ClientNode *np);
+
+/** Restore the stacking order and focus and release the saved state.
+ * @return 1 if the saved active client was focused, 0 otherwise.
+ */
+char FinishRestartState(void);
+
+#endif /* RESTART_H */
@@ -19,15 +19,23 @@
 #include "parse.h"
 #include "settings.h"
 #include "desktop.h"
+#include "event.h"
+#include "main.h"
 
 /** Number of root menus to support. */
 #define ROOT_MENU_COUNT 36
 
+/** Milliseconds to wait for the event queue to drain in fast startup. */
+#define ROOT_MENU_IDLE_DELAY 50
+
 static Menu *rootMenu[ROOT_MENU_COUNT];
 
 static void ExitHandler(ClientNode *np);
 
 static void RunRootCommand(MenuAction *action, unsigned button);
+static void PrepareRootMenus(char prefetch);
+static void PrepareRootMenusTimeout(const TimeType *now, int x, int y,
+                                    Window w, void *data);
 
 /** Initialize root menu data. */
 void InitializeRootMenu(void)
@@ -40,6 +48,18 @@ void InitializeRootMenu(void)
 
 /** Startup root menus. */
 void StartupRootMenu(void)
+{
+   if(settings.startupMode == STARTUP_FAST) {
+      RegisterTimeout(0, PrepareRootMenusTimeout, NULL);
+   } else {
+      PrepareRootMenus(0);
+   }
+}
+
+/** Initialize the root menus.
+ * @param prefetch Set to also start reading dynamic menus.
+ */
+void PrepareRootMenus(char prefetch)
 {
 
    unsigned int x, y;
@@ -55,19 +75,48 @@ void StartupRootMenu(void)
             }
          }
          if(!found) {
-            InitializeMenu(rootMenu[x]);
+            if(!rootMenu[x]->initialized) {
+               InitializeMenu(rootMenu[x]);
+            }
+            if(prefetch) {
+               PrefetchDynamicMenus(rootMenu[x]);
+            }
          }
       }
    }
 
 }
 
+/** Initialize the root menus once the event queue is empty. */
+void PrepareRootMenusTimeout(const TimeType *now, int x, int y,
+                             Window w, void *data)
+{
+   if(JXPending(display) > 0) {
+      RegisterTimeout(ROOT_MENU_IDLE_DELAY, PrepareRootMenusTimeout, NULL);
+   } else {
+      PrepareRootMenus(1);
+   }
+}
+
+/** Release root menu pixmaps. */
+void ShutdownRootMenu(void)
+{
+   unsigned int x;
+   UnregisterTimeout(PrepareRootMenusTimeout, NULL);
+   for(x = 0; x < ROOT_MENU_COUNT; x++) {
+      if(rootMenu[x]) {
+         ReleaseMenuPixmaps(rootMenu[x]);
+      }
+   }
+}
+
 /** Destroy root menu data. */
 void DestroyRootMenu(void)
 {
 
    unsigned int x, y;
 
+   DestroyDynamicMenus();
    for(x = 0; x < ROOT_MENU_COUNT; x++) {
       if(rootMenu[x]) {
          DestroyMenu(rootMenu[x]);
@@ -174,6 +223,9 @@ void GetRootMenuSize(int index, int *width, int *height)
       *height = 0;
       return;
    }
+   if(!rootMenu[index]->initialized) {
+      InitializeMenu(rootMenu[index]);
+   }
    *width = rootMenu[index]->width;
    *height = rootMenu[index]->height;
 
@@ -190,7 +242,8 @@ char ShowRootMenu(int index, int x, int y, char keyboard)
    }
    if(rootMenu[index]->dynamic) {
       Menu *menu = rootMenu[index];
-      menu = ParseDynamicMenu(menu->timeout_ms, menu->dynamic);
+      menu = CreateDynamicMenu(menu->dynamic, menu->timeout_ms,
+                               menu->ttl_ms);
       if(menu) {
          InitializeMenu(menu);
          ShowMenu(menu, RunRootCommand, x, y, keyboard);
@@ -211,7 +264,14 @@ void ExitHandler(ClientNode *np)
 /** Restart callback for the restart menu item. */
 void Restart(void)
 {
-   shouldRestart = 1;
+   shouldHotReload = 1;
+   shouldExit = 1;
+}
+
+/** Restart by running the executable again. */
+void Reexec(void)
+{
+   shouldReexec = 1;
    shouldExit = 1;
 }
 
@@ -236,7 +296,7 @@ void ReloadMenu(void)
       ShutdownRootMenu();
       DestroyRootMenu();
       InitializeRootMenu();
-      ParseConfig(configPath);
+      ReloadConfig(configPath, CONFIG_MENUS);
       StartupRootMenu();
       shouldReload = 0;
    }
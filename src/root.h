@@ -15,7 +15,7 @@ struct Menu;
 /*@{*/
 void InitializeRootMenu(void);
 void StartupRootMenu(void);
-#define ShutdownRootMenu() (void)(0)
+void ShutdownRootMenu(void);
 void DestroyRootMenu(void);
 /*@}*/
 
@@ -56,9 +56,17 @@ void GetRootMenuSize(int index, int *width, int *height);
  */
 char ShowRootMenu(int index, int x, int y, char keyboard);
 
-/** Restart the window manager. */
+/** Restart the window manager.
+ * The configuration is applied in place if only root menus, bindings,
+ * or groups changed.
+ */
 void Restart(void);
 
+/** Restart the window manager by running its executable again.
+ * Client state is saved on the root window for the new process.
+ */
+void Reexec(void);
+
 /** Exit the window manager.
  * @param confirm 1 to confirm exit, 0 for immediate exit.
  */
@@ -6,8 +6,8 @@
  * @brief Screen functions.
  *
  * Note that screen here refers to physical monitors. Screens are
- * determined using the xinerama extension (if available). There will
- * always be at least one screen.
+ * determined using the CRTCs reported by RandR or the xinerama extension
+ * (if available). There will always be at least one screen.
  *
  */
 
@@ -19,53 +19,327 @@
 
 static ScreenType *screens = NULL;
 static int screenCount;
+static int screenCapacity = 0;
+
+/* Tables to look up the screen containing a point.
+ * The root window is split into cells at every screen edge. The column
+ * and row of each coordinate index a grid holding the screen of each
+ * cell.
+ */
+static unsigned short *screenColumns = NULL;
+static unsigned short *screenRows = NULL;
+static unsigned short *screenGrid = NULL;
+static int columnCount;
+static int gridWidth, gridHeight;
+
+static int ReadScreens(ScreenType **result);
+#ifdef USE_XRANDR
+static int ReadRandRScreens(ScreenType **result);
+#endif
+static void CreateScreenGrid(void);
+static void ReleaseScreenGrid(void);
+static int CreateScreenEdges(unsigned short *table, int size,
+                             int *edges, char vertical);
+static int FindScreen(int x, int y);
+static int IntComparator(const void *a, const void *b);
 
 /** Startup screens. */
 void StartupScreens(void)
 {
-#ifdef USE_XINERAMA
+   screenCount = ReadScreens(&screens);
+   screenCapacity = screenCount;
+   gridWidth = rootWidth;
+   gridHeight = rootHeight;
+   if(screenCount > 1) {
+      CreateScreenGrid();
+   }
+
+#ifdef USE_XRANDR
+   if(haveRandR) {
+      JXRRSelectInput(display, rootWindow,
+                      RRScreenChangeNotifyMask | RRCrtcChangeNotifyMask);
+   }
+#endif
+}
+
+/** Read the geometry of the screens again. */
+char UpdateScreens(void)
+{
+   ScreenType *list;
+   int count;
+
+   count = ReadScreens(&list);
+   if(  count == screenCount
+      && gridWidth == rootWidth && gridHeight == rootHeight
+      && !memcmp(list, screens, sizeof(ScreenType) * count)) {
+      Release(list);
+      return 0;
+   }
 
+   /* Reuse the array if possible since pointers to screens may be held
+    * while the new geometry is applied. */
+   if(count <= screenCapacity) {
+      memcpy(screens, list, sizeof(ScreenType) * count);
+      Release(list);
+   } else {
+      Release(screens);
+      screens = list;
+      screenCapacity = count;
+   }
+   screenCount = count;
+
+   ReleaseScreenGrid();
+   gridWidth = rootWidth;
+   gridHeight = rootHeight;
+   if(screenCount > 1) {
+      CreateScreenGrid();
+   }
+   return 1;
+}
+
+/** Read the geometry of the screens.
+ * @param result Set to the screens (to be released with Release).
+ * @return The number of screens (at least 1).
+ */
+int ReadScreens(ScreenType **result)
+{
+   ScreenType *list;
+   int count;
+#ifdef USE_XINERAMA
    XineramaScreenInfo *info;
    int x;
+#endif
+
+#ifdef USE_XRANDR
+   count = ReadRandRScreens(result);
+   if(count > 0) {
+      return count;
+   }
+#endif
 
-   if(XineramaIsActive(display)) {
+#ifdef USE_XINERAMA
+   /* jwm-bench reads the screens without a display. */
+   if(display && XineramaIsActive(display)) {
+      info = XineramaQueryScreens(display, &count);
+      if(info) {
+         list = Allocate(sizeof(ScreenType) * Max(count, 1));
+         for(x = 0; x < count; x++) {
+            list[x].index = x;
+            list[x].x = info[x].x_org;
+            list[x].y = info[x].y_org;
+            list[x].width = info[x].width;
+            list[x].height = info[x].height;
+         }
+         JXFree(info);
+         if(count > 0) {
+            *result = list;
+            return count;
+         }
+         Release(list);
+      }
+   }
+#endif
+
+   count = 1;
+   list = Allocate(sizeof(ScreenType));
+   list->index = 0;
+   list->x = 0;
+   list->y = 0;
+   list->width = rootWidth;
+   list->height = rootHeight;
+   *result = list;
+   return count;
+}
+
+#ifdef USE_XRANDR
+
+/** Read the geometry of the active CRTCs.
+ * The CRTC of the primary output comes first and CRTCs showing the
+ * same area (mirrored outputs) are merged.
+ * @param result Set to the screens if any are found.
+ * @return The number of screens (0 if RandR is not available).
+ */
+int ReadRandRScreens(ScreenType **result)
+{
+   XRRScreenResources *res;
+   XRROutputInfo *output;
+   XRRCrtcInfo *info;
+   ScreenType *list;
+   RRCrtc primary;
+   RROutput po;
+   int count;
+   int i, x;
 
-      info = XineramaQueryScreens(display, &screenCount);
+   if(!haveRandR) {
+      return 0;
+   }
+   res = JXRRGetScreenResourcesCurrent(display, rootWindow);
+   if(JUNLIKELY(!res)) {
+      return 0;
+   }
 
-      screens = Allocate(sizeof(ScreenType) * screenCount);
-      for(x = 0; x < screenCount; x++) {
-         screens[x].index = x;
-         screens[x].x = info[x].x_org;
-         screens[x].y = info[x].y_org;
-         screens[x].width = info[x].width;
-         screens[x].height = info[x].height;
+   primary = None;
+   po = JXRRGetOutputPrimary(display, rootWindow);
+   if(po != None) {
+      output = JXRRGetOutputInfo(display, res, po);
+      if(output) {
+         primary = output->crtc;
+         JXRRFreeOutputInfo(output);
       }
+   }
 
-      JXFree(info);
+   count = 0;
+   list = Allocate(sizeof(ScreenType) * Max(res->ncrtc, 1));
+   for(i = 0; i < res->ncrtc; i++) {
+      info = JXRRGetCrtcInfo(display, res, res->crtcs[i]);
+      if(!info) {
+         continue;
+      }
+      if(info->mode != None && info->width > 0 && info->height > 0) {
+         for(x = 0; x < count; x++) {
+            if(  list[x].x == info->x && list[x].y == info->y
+               && list[x].width == (int)info->width
+               && list[x].height == (int)info->height) {
+               break;
+            }
+         }
+         if(x == count) {
+            if(res->crtcs[i] == primary && count > 0) {
+               memmove(&list[1], &list[0], sizeof(ScreenType) * count);
+               x = 0;
+            }
+            list[x].x = info->x;
+            list[x].y = info->y;
+            list[x].width = info->width;
+            list[x].height = info->height;
+            count += 1;
+         }
+      }
+      JXRRFreeCrtcInfo(info);
+   }
+   JXRRFreeScreenResources(res);
 
-   } else {
+   if(count == 0) {
+      Release(list);
+      return 0;
+   }
+   for(x = 0; x < count; x++) {
+      list[x].index = x;
+   }
+   *result = list;
+   return count;
+}
 
-      screenCount = 1;
-      screens = Allocate(sizeof(ScreenType));
-      screens->index = 0;
-      screens->x = 0;
-      screens->y = 0;
-      screens->width = rootWidth;
-      screens->height = rootHeight;
+#endif /* USE_XRANDR */
 
+/** Create the tables to look up the screen containing a point. */
+void CreateScreenGrid(void)
+{
+   int *edges;
+   int *xedges;
+   int rowCount;
+   int c, r;
+
+   edges = Allocate(sizeof(int) * (2 * screenCount + 1) * 2);
+   xedges = &edges[2 * screenCount + 1];
+
+   screenColumns = Allocate(sizeof(unsigned short) * gridWidth);
+   screenRows = Allocate(sizeof(unsigned short) * gridHeight);
+   columnCount = CreateScreenEdges(screenColumns, gridWidth, xedges, 0);
+   rowCount = CreateScreenEdges(screenRows, gridHeight, edges, 1);
+
+   /* Every point in a cell is on the same screens, so check a corner. */
+   screenGrid = Allocate(sizeof(unsigned short) * columnCount * rowCount);
+   for(r = 0; r < rowCount; r++) {
+      for(c = 0; c < columnCount; c++) {
+         screenGrid[r * columnCount + c] = FindScreen(xedges[c], edges[r]);
+      }
    }
 
-#else
+   Release(edges);
+}
+
+/** Split the root window at the edges of the screens along one axis.
+ * @param table The cell of each coordinate (size entries).
+ * @param size The width or height of the root window.
+ * @param edges Filled with the starting coordinate of each cell.
+ * @param vertical Set to split along the y-axis.
+ * @return The number of cells.
+ */
+int CreateScreenEdges(unsigned short *table, int size,
+                      int *edges, char vertical)
+{
+   int count;
+   int i, x;
+
+   count = 0;
+   edges[count++] = 0;
+   for(i = 0; i < screenCount; i++) {
+      const ScreenType *sp = &screens[i];
+      const int start = vertical ? sp->y : sp->x;
+      const int stop = start + (vertical ? sp->height : sp->width);
+      if(start > 0 && start < size) {
+         edges[count++] = start;
+      }
+      if(stop > 0 && stop < size) {
+         edges[count++] = stop;
+      }
+   }
+   qsort(edges, count, sizeof(int), IntComparator);
 
-   screenCount = 1;
-   screens = Allocate(sizeof(ScreenType));
-   screens->index = 0;
-   screens->x = 0;
-   screens->y = 0;
-   screens->width = rootWidth;
-   screens->height = rootHeight;
+   /* Remove duplicates. */
+   x = 1;
+   for(i = 1; i < count; i++) {
+      if(edges[i] != edges[x - 1]) {
+         edges[x++] = edges[i];
+      }
+   }
+   count = x;
 
-#endif /* USE_XINERAMA */
+   i = 0;
+   for(x = 0; x < size; x++) {
+      if(i + 1 < count && x >= edges[i + 1]) {
+         i += 1;
+      }
+      table[x] = i;
+   }
+   return count;
+}
+
+/** Find the screen containing a point by checking each screen. */
+int FindScreen(int x, int y)
+{
+   int index;
+   for(index = 1; index < screenCount; index++) {
+      const ScreenType *sp = &screens[index];
+      if(x >= sp->x && x < sp->x + sp->width) {
+         if(y >= sp->y && y < sp->y + sp->height) {
+            return index;
+         }
+      }
+   }
+   return 0;
+}
+
+/** Compare two integers for qsort. */
+int IntComparator(const void *a, const void *b)
+{
+   const int ia = *(const int*)a;
+   const int ib = *(const int*)b;
+   return ia - ib;
+}
+
+/** Release the tables to look up the screen containing a point. */
+void ReleaseScreenGrid(void)
+{
+   if(screenGrid) {
+      Release(screenColumns);
+      Release(screenRows);
+      Release(screenGrid);
+      screenColumns = NULL;
+      screenRows = NULL;
+      screenGrid = NULL;
+   }
 }
 
 /** Shutdown screens. */
@@ -75,48 +349,42 @@ void ShutdownScreens(void)
       Release(screens);
       screens = NULL;
    }
+   screenCapacity = 0;
+   ReleaseScreenGrid();
 }
 
 /** Get the screen given global screen coordinates. */
 const ScreenType *GetCurrentScreen(int x, int y)
 {
 
-   ScreenType *sp;
-   int index;
+   int cell;
 
-   x = Max(0, x);
-   x = Min(x, rootWidth - 1);
-   y = Max(0, y);
-   y = Min(y, rootHeight - 1);
-   for(index = 1; index < screenCount; index++) {
-      sp = &screens[index];
-      if(x >= sp->x && x < sp->x + sp->width) {
-         if(y >= sp->y && y < sp->y + sp->height) {
-            return sp;
-         }
-      }
+   if(!screenGrid) {
+      return &screens[0];
    }
 
-   return &screens[0];
+   x = Max(0, x);
+   x = Min(x, gridWidth - 1);
+   y = Max(0, y);
+   y = Min(y, gridHeight - 1);
+   cell = screenRows[y] * columnCount + screenColumns[x];
+   return &screens[screenGrid[cell]];
 
 }
 
 /** Get the screen the mouse is currently on. */
 const ScreenType *GetMouseScreen(void)
 {
-#ifdef USE_XINERAMA
 
    Window w;
    int x, y;
 
+   if(screenCount == 1) {
+      return &screens[0];
+   }
    GetMousePosition(&x, &y, &w);
    return GetCurrentScreen(x, y);
 
-#else
-
-   return &screens[0];
-
-#endif
 }
 
 /** Get data for a screen. */
@@ -6,8 +6,8 @@
  * @brief Header for screen functions.
  *
  * Note that screen here refers to physical monitors. Screens are
- * determined using the xinerama extension (if available). There will
- * always be at least one screen.
+ * determined using the CRTCs reported by RandR or the xinerama extension
+ * (if available). There will always be at least one screen.
  *
  */
 
@@ -28,6 +28,13 @@ void ShutdownScreens(void);
 #define DestroyScreens()      (void)(0)
 /*@}*/
 
+/** Read the geometry of the screens again.
+ * This should be called after the monitor configuration or the size of
+ * the root window changed. Screens are updated in place when possible.
+ * @return 1 if the screens changed, 0 otherwise.
+ */
+char UpdateScreens(void);
+
 /** Get the screen of the specified coordinates.
  * @param x The x-coordinate.
  * @param y The y-coordinate.
@@ -39,6 +39,7 @@ void InitializeSettings(void)
    settings.moveStatusType = SW_SCREEN;
    settings.resizeStatusType = SW_SCREEN;
    settings.focusModel = FOCUS_SLOPPY;
+   settings.focusDelay = 0;
    settings.resizeMode = RESIZE_OPAQUE;
    settings.popupDelay = 600;
    settings.desktopDelay = 1000;
@@ -52,6 +53,13 @@ void InitializeSettings(void)
    settings.desktopWidth = 4;
    settings.desktopHeight = 1;
    settings.desktopBackAndForth = DBACKANDFORTH_OFF;
+   settings.iconFilter = ICON_FILTER_BEST;
+   settings.iconMemory = 4096;
+   settings.lowMemory = 0;
+   settings.inputPriority = 0;
+   settings.startupMode = STARTUP_NORMAL;
+   settings.stallTimeout = 0;
+   settings.stallBacktrace = 0;
    settings.menuOpacity = UINT_MAX;
    settings.windowDecorations = DECO_FLAT;
    settings.trayDecorations = DECO_FLAT;
@@ -61,6 +69,9 @@ void InitializeSettings(void)
    settings.groupTasks = 0;
    settings.listAllTasks = 0;
    settings.dockSpacing = 0;
+   settings.pagerRate = 30;
+   settings.moveRate = 60;
+   settings.resizeRate = 60;
    memcpy(settings.titleBarLayout, DEFAULT_TITLE_BAR_LAYOUT,
       sizeof(settings.titleBarLayout));
 }
@@ -76,6 +87,8 @@ void StartupSettings(void)
 
    FixRange(&settings.doubleClickDelta, 0, 64, 2);
    FixRange(&settings.doubleClickSpeed, 1, 2000, 400);
+   FixRange(&settings.focusDelay, 0, 2000, 0);
+   FixRange(&settings.stallTimeout, 0, 60000, 0);
 
    FixRange(&settings.desktopWidth, 1, 64, 4);
    FixRange(&settings.desktopHeight, 1, 64, 1);
@@ -86,6 +99,9 @@ void StartupSettings(void)
    }
 
    FixRange(&settings.dockSpacing, 0, 64, 0);
+   FixRange(&settings.pagerRate, 0, 1000, 30);
+   FixRange(&settings.moveRate, 0, 1000, 60);
+   FixRange(&settings.resizeRate, 0, 1000, 60);
 }
 
 /** Update a string setting. */
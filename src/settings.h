@@ -79,6 +79,18 @@ typedef unsigned char MouseContextType;
 #define MC_BORDER_E        0x40  /**< East border. */
 #define MC_BORDER_W        0x80  /**< West border. */
 
+/** Filters used to scale icons with XRender. */
+typedef unsigned char IconFilterType;
+#define ICON_FILTER_BEST      0  /**< FilterBest. */
+#define ICON_FILTER_GOOD      1  /**< FilterGood. */
+#define ICON_FILTER_BILINEAR  2  /**< FilterBilinear. */
+#define ICON_FILTER_NEAREST   3  /**< FilterNearest. */
+
+/** Startup modes. */
+typedef unsigned char StartupModeType;
+#define STARTUP_NORMAL  0  /**< Prepare everything before running. */
+#define STARTUP_FAST    1  /**< Defer work that is not visible. */
+
 /** Enumeration of desktop back and forth values. */
 typedef unsigned char DesktopBackAndForthType;
 #define DBACKANDFORTH_OFF 0 /**< No back and forth */
@@ -107,12 +119,16 @@ typedef struct {
    unsigned cornerRadius;
    unsigned moveMask;
    unsigned dockSpacing;
+   unsigned pagerRate;
+   unsigned moveRate;
+   unsigned resizeRate;
    AlignmentType titleTextAlignment;
    SnapModeType snapMode;
    MoveModeType moveMode;
    StatusWindowType moveStatusType;
    StatusWindowType resizeStatusType;
    FocusModelType focusModel;
+   unsigned focusDelay;
    ResizeModeType resizeMode;
    DecorationsType windowDecorations;
    DecorationsType trayDecorations;
@@ -123,6 +139,13 @@ typedef struct {
    char groupTasks;
    char listAllTasks;
    DesktopBackAndForthType desktopBackAndForth;
+   IconFilterType iconFilter;
+   unsigned iconMemory;
+   char lowMemory;
+   char inputPriority;
+   StartupModeType startupMode;
+   unsigned stallTimeout;
+   char stallBacktrace;
 } Settings;
 
 extern Settings settings;
@@ -0,0 +1,161 @@
+/**
+ * @file shm.c
+ * @author Joe Wingbermuehle
+ * @date 2026
+ *
+ * @brief Image uploads using the MIT-SHM extension.
+ *
+ * Large images are uploaded through a shared memory segment instead of
+ * being copied through the connection. Each image gets its own segment,
+ * which is released once the server has read it.
+ *
+ */
+
+#include "jwm.h"
+#include "shm.h"
+#include "main.h"
+#include "error.h"
+
+/** Smallest image in bytes to upload through shared memory.
+ * Setting up a segment costs a round trip, so small images are sent
+ * through the connection.
+ */
+#define SHM_THRESHOLD (64 * 1024)
+
+#ifdef USE_SHM
+
+char haveShm = 0;
+static char shmFailed;
+
+static char AttachSegment(XShmSegmentInfo *info, size_t size);
+static void DetachSegment(XShmSegmentInfo *info);
+static int ShmErrorHandler(Display *d, XErrorEvent *e);
+
+/** Determine if shared memory images can be used.
+ * The extension is also reported on remote displays, where attaching
+ * fails, so we attach a small segment to find out.
+ */
+void StartupShm(void)
+{
+   XShmSegmentInfo info;
+
+   haveShm = 0;
+   if(!JXShmQueryExtension(display)) {
+      Debug("MIT-SHM extension disabled");
+      return;
+   }
+
+   shmFailed = 0;
+   JXSetErrorHandler(ShmErrorHandler);
+   if(AttachSegment(&info, 1)) {
+      JXSync(display, False);
+      DetachSegment(&info);
+      haveShm = !shmFailed;
+   }
+   JXSetErrorHandler(ErrorHandler);
+
+   if(haveShm) {
+      Debug("MIT-SHM extension enabled");
+   } else {
+      Debug("MIT-SHM extension not usable");
+   }
+}
+
+/** Create and attach a shared memory segment. */
+char AttachSegment(XShmSegmentInfo *info, size_t size)
+{
+   info->shmid = shmget(IPC_PRIVATE, size, IPC_CREAT | 0600);
+   if(info->shmid < 0) {
+      return 0;
+   }
+   info->shmaddr = shmat(info->shmid, NULL, 0);
+   if(info->shmaddr == (char*)-1) {
+      shmctl(info->shmid, IPC_RMID, NULL);
+      return 0;
+   }
+   info->readOnly = True;
+   JXShmAttach(display, info);
+   return 1;
+}
+
+/** Detach and remove a shared memory segment.
+ * This waits for the server so that pending requests are done with it.
+ */
+void DetachSegment(XShmSegmentInfo *info)
+{
+   JXShmDetach(display, info);
+   JXSync(display, False);
+   shmdt(info->shmaddr);
+   shmctl(info->shmid, IPC_RMID, NULL);
+}
+
+/** Error handler used while testing the extension. */
+int ShmErrorHandler(Display *d, XErrorEvent *e)
+{
+   shmFailed = 1;
+   return 0;
+}
+
+#endif /* USE_SHM */
+
+/** Create an image to upload to the server. */
+XImage *CreateUploadImage(int depth, unsigned width, unsigned height)
+{
+   XImage *image;
+
+#ifdef USE_SHM
+   if(haveShm) {
+      XShmSegmentInfo *info = Allocate(sizeof(XShmSegmentInfo));
+      image = JXShmCreateImage(display, rootVisual, depth, ZPixmap, NULL,
+                               info, width, height);
+      if(image && (size_t)image->bytes_per_line * height >= SHM_THRESHOLD
+         && AttachSegment(info, (size_t)image->bytes_per_line * height)) {
+         image->data = info->shmaddr;
+         return image;
+      }
+      if(image) {
+         image->obdata = NULL;
+         JXDestroyImage(image);
+      }
+      Release(info);
+   }
+#endif
+
+   image = JXCreateImage(display, rootVisual, depth, ZPixmap,
+                         0, NULL, width, height, 8, 0);
+   image->data = Allocate(image->bytes_per_line * height);
+   return image;
+}
+
+/** Upload an image created with CreateUploadImage. */
+void PutUploadImage(Drawable d, GC gc, XImage *image, int x, int y)
+{
+#ifdef USE_SHM
+   if(image->obdata) {
+      JXShmPutImage(display, d, gc, image, 0, 0, x, y,
+                    image->width, image->height, False);
+      return;
+   }
+#endif
+   JXPutImage(display, d, gc, image, 0, 0, x, y,
+              image->width, image->height);
+}
+
+/** Destroy an image created with CreateUploadImage. */
+void DestroyUploadImage(XImage *image)
+{
+#ifdef USE_SHM
+   if(image->obdata) {
+      XShmSegmentInfo *info = (XShmSegmentInfo*)image->obdata;
+      DetachSegment(info);
+      Release(info);
+      image->obdata = NULL;
+      image->data = NULL;
+      JXDestroyImage(image);
+      return;
+   }
+#endif
+   Release(image->data);
+   image->data = NULL;
+   JXDestroyImage(image);
+}
@@ -0,0 +1,46 @@
+/**
+ * @file shm.h
+ * @author Joe Wingbermuehle
+ * @date 2026
+ *
+ * @brief Image uploads using the MIT-SHM extension.
+ *
+ */
+
+#ifndef SHM_H
+#define SHM_H
+
+#ifdef USE_SHM
+/** Set if shared memory images are used. */
+extern char haveShm;
+
+/** Determine if shared memory images can be used. */
+void StartupShm(void);
+#else
+#define StartupShm()       (void)(0)
+#endif
+
+/** Create an image to upload to the server.
+ * Large images are placed in shared memory when the server supports it.
+ * @param depth The depth of the image.
+ * @param width The width of the image.
+ * @param height The height of the image.
+ * @return A ZPixmap image with room for its data.
+ */
+XImage *CreateUploadImage(int depth, unsigned width, unsigned height);
+
+/** Upload an image created with CreateUploadImage.
+ * @param d The drawable to receive the image.
+ * @param gc The graphics context to use.
+ * @param image The image.
+ * @param x The x-coordinate in the drawable.
+ * @param y The y-coordinate in the drawable.
+ */
+void PutUploadImage(Drawable d, GC gc, XImage *image, int x, int y);
+
+/** Destroy an image created with CreateUploadImage.
+ * @param image The image.
+ */
+void DestroyUploadImage(XImage *image);
+
+#endif /* SHM_H */
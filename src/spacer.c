@@ -58,27 +58,20 @@ void SetSize(TrayComponentType *cp, int width, int height)
 /** Initialize. */
 void Create(TrayComponentType *cp)
 {
-   cp->pixmap = JXCreatePixmap(display, rootWindow, cp->width, cp->height,
-                               rootDepth);
+   CreateTrayPixmap(cp);
    ClearTrayDrawable(cp);
 }
 
 /** Resize. */
 void Resize(TrayComponentType *cp)
 {
-   if(cp->pixmap != None) {
-      JXFreePixmap(display, cp->pixmap);
-   }
-   cp->pixmap = JXCreatePixmap(display, rootWindow, cp->width, cp->height,
-                               rootDepth);
+   CreateTrayPixmap(cp);
    ClearTrayDrawable(cp);
 }
 
 /** Destroy. */
 void Destroy(TrayComponentType *cp)
 {
-   if(cp->pixmap != None) {
-      JXFreePixmap(display, cp->pixmap);
-   }
+   ReleaseTrayPixmap(cp);
 }
 
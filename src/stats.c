@@ -0,0 +1,348 @@
+/**
+ * @file stats.c
+ * @author Joe Wingbermuehle
+ * @date 2026
+ *
+ * @brief Run-time statistics.
+ *
+ */
+
+#include "jwm.h"
+
+#ifdef USE_STATS
+
+#include "stats.h"
+#include "main.h"
+#include "hint.h"
+#include "timing.h"
+#include "misc.h"
+
+/** Number of latency histogram buckets.
+ * Bucket n counts samples below 2^(n + 4) microseconds; the last bucket
+ * counts everything slower.
+ */
+#define HISTOGRAM_BUCKETS 16
+
+/** Maximum number of startup phases to report. */
+#define STARTUP_PHASES 16
+
+/** Slot used for extension events. */
+#define EXTENSION_EVENT LASTEvent
+
+/** Latency accumulator. */
+typedef struct StatsCounter {
+   unsigned long count;
+   unsigned long long total;
+   unsigned long long max;
+   unsigned long histogram[HISTOGRAM_BUCKETS];
+} StatsCounter;
+
+/** Time taken by a startup phase. */
+typedef struct StartupPhase {
+   const char *name;
+   unsigned long long duration;
+} StartupPhase;
+
+static StatsCounter eventStats[LASTEvent + 1];
+static StatsCounter processStats[LASTEvent + 1];
+static StatsCounter sectionStats[SECTION_COUNT];
+static StartupPhase startupPhases[STARTUP_PHASES];
+static unsigned int startupPhaseCount = 0;
+static long pixmapBytes[PIXMAP_COUNT];
+static long pixmapMaxBytes[PIXMAP_COUNT];
+static long pixmapCount[PIXMAP_COUNT];
+static long imageBytes = 0;
+static long imageMaxBytes = 0;
+static long imageCount = 0;
+static unsigned long long statsStartTime = 0;
+
+static const char * const EVENT_NAMES[LASTEvent + 1] = {
+   NULL,                /* 0 */
+   NULL,                /* 1 */
+   "KeyPress",
+   "KeyRelease",
+   "ButtonPress",
+   "ButtonRelease",
+   "MotionNotify",
+   "EnterNotify",
+   "LeaveNotify",
+   "FocusIn",
+   "FocusOut",
+   "KeymapNotify",
+   "Expose",
+   "GraphicsExpose",
+   "NoExpose",
+   "VisibilityNotify",
+   "CreateNotify",
+   "DestroyNotify",
+   "UnmapNotify",
+   "MapNotify",
+   "MapRequest",
+   "ReparentNotify",
+   "ConfigureNotify",
+   "ConfigureRequest",
+   "GravityNotify",
+   "ResizeRequest",
+   "CirculateNotify",
+   "CirculateRequest",
+   "PropertyNotify",
+   "SelectionClear",
+   "SelectionRequest",
+   "SelectionNotify",
+   "ColormapNotify",
+   "ClientMessage",
+   "MappingNotify",
+   "GenericEvent",
+   "Extension"
+};
+
+static const char * const SECTION_NAMES[SECTION_COUNT] = {
+   "ProcessTrayEvent",
+   "ProcessDialogEvent",
+   "ProcessSwallowEvent",
+   "ProcessPopupEvent",
+   "Callbacks",
+   "RestackClients",
+   "UpdateTaskBar",
+   "UpdatePager",
+   "TileClient",
+   "DoSnapBorder",
+   "ParseSections",
+   "ApplyGroups",
+   "CreateIconFromBinary",
+   "GetScaledIcon",
+   "DrawGradientLines",
+   "ServerGrab"
+};
+
+static const char * const PIXMAP_NAMES[PIXMAP_COUNT] = {
+   "icon",
+   "menu",
+   "background",
+   "border",
+   "gradient",
+   "pager"
+};
+
+static void UpdateCounter(StatsCounter *sp, StatsTime start);
+static void AppendCounter(TextBuffer *buffer, const char *kind,
+                          const char *name, const StatsCounter *sp);
+static void AppendResidentStats(TextBuffer *buffer);
+
+/** Start measuring. */
+StatsTime StartStats(void)
+{
+   const StatsTime now = GetMonotonicTime();
+   if(JUNLIKELY(statsStartTime == 0)) {
+      statsStartTime = now;
+   }
+   return now;
+}
+
+/** Record an event dispatched from WaitForEvent. */
+void RecordEventStats(int type, StatsTime start)
+{
+   if(type < 0 || type >= LASTEvent) {
+      type = EXTENSION_EVENT;
+   }
+   UpdateCounter(&eventStats[type], start);
+}
+
+/** Record an event handled by ProcessEvent. */
+void RecordProcessStats(int type, StatsTime start)
+{
+   if(type < 0 || type >= LASTEvent) {
+      type = EXTENSION_EVENT;
+   }
+   UpdateCounter(&processStats[type], start);
+}
+
+/** Record time spent in a section. */
+void RecordSectionStats(StatsSection section, StatsTime start)
+{
+   Assert(section < SECTION_COUNT);
+   UpdateCounter(&sectionStats[section], start);
+}
+
+/** Record a pixmap being created or freed. */
+void RecordPixmapStats(StatsPixmap kind, long bytes)
+{
+   Assert(kind < PIXMAP_COUNT);
+   pixmapBytes[kind] += bytes;
+   pixmapCount[kind] += bytes < 0 ? -1 : 1;
+   if(pixmapBytes[kind] > pixmapMaxBytes[kind]) {
+      pixmapMaxBytes[kind] = pixmapBytes[kind];
+   }
+}
+
+/** Record client-side image data being allocated or freed. */
+void RecordImageStats(long bytes)
+{
+   imageBytes += bytes;
+   imageCount += bytes < 0 ? -1 : 1;
+   if(imageBytes > imageMaxBytes) {
+      imageMaxBytes = imageBytes;
+   }
+}
+
+/** Add a sample to a counter. */
+void UpdateCounter(StatsCounter *sp, StatsTime start)
+{
+   const StatsTime elapsed = GetMonotonicTime() - start;
+   StatsTime limit;
+   unsigned int bucket;
+
+   sp->count += 1;
+   sp->total += elapsed;
+   if(elapsed > sp->max) {
+      sp->max = elapsed;
+   }
+
+   limit = 16;
+   for(bucket = 0; bucket < HISTOGRAM_BUCKETS - 1; bucket++) {
+      if(elapsed < limit) {
+         break;
+      }
+      limit <<= 1;
+   }
+   sp->histogram[bucket] += 1;
+}
+
+/** Record the time taken by a startup phase. */
+void RecordStartupStats(const char *name, StatsTime start)
+{
+   unsigned int x;
+   for(x = 0; x < startupPhaseCount; x++) {
+      if(startupPhases[x].name == name) {
+         break;
+      }
+   }
+   if(x == startupPhaseCount) {
+      if(JUNLIKELY(x == STARTUP_PHASES)) {
+         return;
+      }
+      startupPhases[x].name = name;
+      startupPhaseCount += 1;
+   }
+   startupPhases[x].duration = GetMonotonicTime() - start;
+}
+
+/** Append a counter to a report. */
+void AppendCounter(TextBuffer *buffer, const char *kind,
+                   const char *name, const StatsCounter *sp)
+{
+   unsigned int x;
+   if(sp->count == 0) {
+      return;
+   }
+   AppendText(buffer, "%s %s count=%lu total_us=%llu avg_us=%llu "
+              "max_us=%llu histogram=", kind, name, sp->count,
+              sp->total, sp->total / sp->count, sp->max);
+   for(x = 0; x < HISTOGRAM_BUCKETS; x++) {
+      AppendText(buffer, x ? ",%lu" : "%lu", sp->histogram[x]);
+   }
+   AppendText(buffer, "\n");
+}
+
+/** Get a report of the statistics collected so far. */
+char *GetStatsReport(void)
+{
+   TextBuffer buffer;
+   unsigned int x;
+
+   InitializeTextBuffer(&buffer, 1024);
+
+   AppendText(&buffer, "uptime_us=%llu\n",
+              statsStartTime ? GetMonotonicTime() - statsStartTime : 0);
+   AppendText(&buffer, "histogram_buckets_us=16");
+   for(x = 1; x < HISTOGRAM_BUCKETS - 1; x++) {
+      AppendText(&buffer, ",%u", 16 << x);
+   }
+   AppendText(&buffer, ",inf\n");
+#ifdef DEBUG
+   AppendText(&buffer, "allocations=%lu\n", GetAllocationCount());
+#endif
+
+   if(startupPhaseCount > 0) {
+      unsigned long long total = 0;
+      for(x = 0; x < startupPhaseCount; x++) {
+         AppendText(&buffer, "startup %s us=%llu\n", startupPhases[x].name,
+                    startupPhases[x].duration);
+         total += startupPhases[x].duration;
+      }
+      AppendText(&buffer, "startup total us=%llu\n", total);
+   }
+
+   for(x = 0; x <= LASTEvent; x++) {
+      if(EVENT_NAMES[x]) {
+         AppendCounter(&buffer, "event", EVENT_NAMES[x], &eventStats[x]);
+      }
+   }
+   for(x = 0; x <= LASTEvent; x++) {
+      if(EVENT_NAMES[x]) {
+         AppendCounter(&buffer, "process", EVENT_NAMES[x], &processStats[x]);
+      }
+   }
+   for(x = 0; x < SECTION_COUNT; x++) {
+      AppendCounter(&buffer, "section", SECTION_NAMES[x], &sectionStats[x]);
+   }
+   for(x = 0; x < PIXMAP_COUNT; x++) {
+      AppendText(&buffer, "pixmap %s count=%ld bytes=%ld max_bytes=%ld\n",
+                 PIXMAP_NAMES[x], pixmapCount[x], pixmapBytes[x],
+                 pixmapMaxBytes[x]);
+   }
+   AppendText(&buffer, "image count=%ld bytes=%ld max_bytes=%ld\n",
+              imageCount, imageBytes, imageMaxBytes);
+   AppendResidentStats(&buffer);
+
+#if defined(DEBUG) || defined(PROFILE_MEMORY)
+   {
+      char *memory = GetAllocationReport();
+      AppendText(&buffer, "%s", memory);
+      free(memory);
+   }
+#endif
+
+#ifdef PROFILE_X
+   {
+      char *xprofile = GetXProfileReport();
+      AppendText(&buffer, "%s", xprofile);
+      free(xprofile);
+   }
+#endif
+
+   return buffer.data;
+}
+
+/** Append the resident memory of the process.
+ * The pixmaps above are held by the X server; this is the memory held
+ * by JWM itself. Nothing is added where /proc is not available.
+ */
+void AppendResidentStats(TextBuffer *buffer)
+{
+   unsigned long size, resident;
+   FILE *fd;
+
+   fd = fopen("/proc/self/statm", "r");
+   if(!fd) {
+      return;
+   }
+   if(fscanf(fd, "%lu %lu", &size, &resident) == 2) {
+      const unsigned long page = (unsigned long)sysconf(_SC_PAGESIZE);
+      AppendText(buffer, "resident bytes=%lu virtual_bytes=%lu\n",
+                 resident * page, size * page);
+   }
+   fclose(fd);
+}
+
+/** Write the report to the _JWM_STATS property on the root window. */
+void PublishStats(void)
+{
+   char *report = GetStatsReport();
+   JXChangeProperty(display, rootWindow, atoms[ATOM_JWM_STATS],
+                    atoms[ATOM_UTF8_STRING], 8, PropModeReplace,
+                    (unsigned char*)report, strlen(report));
+   Release(report);
+}
+
+#endif /* USE_STATS */
@@ -0,0 +1,114 @@
+/**
+ * @file stats.h
+ * @author Joe Wingbermuehle
+ * @date 2026
+ *
+ * @brief Run-time statistics.
+ *
+ */
+
+#ifndef STATS_H
+#define STATS_H
+
+/** Instrumented sections outside of the main event switch. */
+typedef enum {
+   SECTION_TRAY_EVENT,     /**< ProcessTrayEvent. */
+   SECTION_DIALOG_EVENT,   /**< ProcessDialogEvent. */
+   SECTION_SWALLOW_EVENT,  /**< ProcessSwallowEvent. */
+   SECTION_POPUP_EVENT,    /**< ProcessPopupEvent. */
+   SECTION_CALLBACK,       /**< Timer callbacks run from Signal. */
+   SECTION_RESTACK,        /**< Deferred RestackClients. */
+   SECTION_TASKBAR,        /**< Deferred UpdateTaskBar. */
+   SECTION_PAGER,          /**< Deferred UpdatePager. */
+   SECTION_TILE,           /**< TileClient placement. */
+   SECTION_SNAP,           /**< DoSnapBorder while moving. */
+   SECTION_PARSE,          /**< Reading the configuration. */
+   SECTION_GROUPS,         /**< ApplyGroups for a new client. */
+   SECTION_ICON_BINARY,    /**< CreateIconFromBinary. */
+   SECTION_ICON_SCALE,     /**< Scaling an icon not in the cache. */
+   SECTION_GRADIENT,       /**< DrawGradientLines. */
+   SECTION_GRAB,           /**< Time the server is grabbed. */
+   SECTION_COUNT
+} StatsSection;
+
+/** Subsystems whose pixmaps are accounted. */
+typedef enum {
+   PIXMAP_ICON,            /**< Scaled icons. */
+   PIXMAP_MENU,            /**< Menu buffers. */
+   PIXMAP_BACKGROUND,      /**< Desktop backgrounds. */
+   PIXMAP_BORDER,          /**< Cached title bars. */
+   PIXMAP_GRADIENT,        /**< Cached gradient strips. */
+   PIXMAP_PAGER,           /**< Cached pager backgrounds. */
+   PIXMAP_COUNT
+} StatsPixmap;
+
+#ifdef USE_STATS
+
+/** Timestamp used to measure a section. */
+typedef unsigned long long StatsTime;
+
+/** Start measuring.
+ * @return The start time to pass to one of the record functions.
+ */
+StatsTime StartStats(void);
+
+/** Record an event dispatched from WaitForEvent.
+ * @param type The event type.
+ * @param start The time returned by StartStats.
+ */
+void RecordEventStats(int type, StatsTime start);
+
+/** Record an event handled by ProcessEvent.
+ * @param type The event type.
+ * @param start The time returned by StartStats.
+ */
+void RecordProcessStats(int type, StatsTime start);
+
+/** Record time spent in a section.
+ * @param section The section.
+ * @param start The time returned by StartStats.
+ */
+void RecordSectionStats(StatsSection section, StatsTime start);
+
+/** Record the time taken by a startup phase.
+ * A phase recorded again (after a restart) replaces the earlier time.
+ * @param name The name of the phase (must be a string literal).
+ * @param start The time returned by StartStats.
+ */
+void RecordStartupStats(const char *name, StatsTime start);
+
+/** Record a pixmap being created or freed.
+ * @param kind The subsystem holding the pixmap.
+ * @param bytes The size of the pixmap (negative when it is freed).
+ */
+void RecordPixmapStats(StatsPixmap kind, long bytes);
+
+/** Record client-side image data being allocated or freed.
+ * @param bytes The size of the data (negative when it is freed).
+ */
+void RecordImageStats(long bytes);
+
+/** Get a report of the statistics collected so far.
+ * @return The report (to be released by the caller).
+ */
+char *GetStatsReport(void);
+
+/** Write the report to the _JWM_STATS property on the root window. */
+void PublishStats(void);
+
+#else
+
+typedef int StatsTime;
+
+#define StartStats()                   0
+#define RecordEventStats( t, s )       ((void)(s))
+#define RecordProcessStats( t, s )     ((void)(s))
+#define RecordSectionStats( t, s )     ((void)(s))
+#define RecordStartupStats( n, s )     ((void)(s))
+#define RecordPixmapStats( k, b )      ((void)0)
+#define RecordImageStats( b )          ((void)0)
+#define PublishStats()                 ((void)0)
+
+#endif /* USE_STATS */
+
+#endif /* STATS_H */
@@ -15,6 +15,7 @@
 #include "client.h"
 #include "settings.h"
 #include "hint.h"
+#include "winpool.h"
 
 static Window statusWindow;
 static Pixmap statusPixmap;
@@ -62,9 +63,6 @@ void GetMoveResizeCoordinates(const ClientNode *np, StatusWindowType type,
 void CreateMoveResizeWindow(const ClientNode *np, StatusWindowType type)
 {
 
-   XSetWindowAttributes attrs;
-   long attrMask;
-
    if(type == SW_OFF) {
       return;
    }
@@ -74,26 +72,10 @@ void CreateMoveResizeWindow(const ClientNode *np, StatusWindowType type)
 
    GetMoveResizeCoordinates(np, type, &statusWindowX, &statusWindowY);
 
-   attrMask = 0;
-
-   attrMask |= CWBackPixel;
-   attrs.background_pixel = colors[COLOR_MENU_BG];
-
-   attrMask |= CWSaveUnder;
-   attrs.save_under = True;
-
-   attrMask |= CWOverrideRedirect;
-   attrs.override_redirect = True;
-
-   statusWindow = JXCreateWindow(display, rootWindow,
-      statusWindowX, statusWindowY,
-      statusWindowWidth, statusWindowHeight, 0,
-      rootDepth, InputOutput, rootVisual,
-      attrMask, &attrs);
-   SetAtomAtom(statusWindow, ATOM_NET_WM_WINDOW_TYPE,
-               ATOM_NET_WM_WINDOW_TYPE_NOTIFICATION);
-   statusPixmap = JXCreatePixmap(display, statusWindow,
-      statusWindowWidth, statusWindowHeight, rootDepth);
+   statusWindow = AcquirePoolWindow(POOL_WINDOW_STATUS,
+                                    statusWindowX, statusWindowY,
+                                    statusWindowWidth, statusWindowHeight);
+   statusPixmap = AcquirePoolPixmap(statusWindowWidth, statusWindowHeight);
 
    JXMapRaised(display, statusWindow);
 
@@ -151,11 +133,11 @@ void DrawMoveResizeWindow(const ClientNode *np,
 void DestroyMoveResizeWindow(void)
 {
    if(statusWindow != None) {
-      JXDestroyWindow(display, statusWindow);
+      ReleasePoolWindow(statusWindow);
       statusWindow = None;
    }
    if(statusPixmap != None) {
-      JXFreePixmap(display, statusPixmap);
+      ReleasePoolPixmap(statusPixmap);
       statusPixmap = None;
    }
 }
@@ -17,6 +17,9 @@
 #include "client.h"
 #include "misc.h"
 
+/** Number of buckets used to look up pending swallows by name. */
+#define SWALLOW_HASH_SIZE  16
+
 typedef struct SwallowNode {
 
    TrayComponentType *cp;
@@ -31,31 +34,70 @@ typedef struct SwallowNode {
 
 } SwallowNode;
 
-static SwallowNode *pendingNodes = NULL;
+/** Swallows waiting for a window, indexed by name. */
+static SwallowNode *pendingNodes[SWALLOW_HASH_SIZE];
+static unsigned int pendingCount = 0;
 static SwallowNode *swallowNodes = NULL;
 
+/** Names of programs started before a restart that have yet to map
+ * a window. Their commands are not run again after the restart. */
+static SwallowNode *launchedNodes = NULL;
+
 static void ReleaseNodes(SwallowNode *nodes);
+static unsigned int GetSwallowHash(const char *name);
+static char TakeLaunchedNode(const char *name);
 static void Destroy(TrayComponentType *cp);
 static void Resize(TrayComponentType *cp);
 
-/** Start swallow processing. */
+/** Start swallow processing.
+ * Nothing waits for the windows: they are swallowed as they are mapped.
+ */
 void StartupSwallow(void)
 {
    SwallowNode *np;
-   for(np = pendingNodes; np; np = np->next) {
-      if(np->command) {
-         RunCommand(np->command);
+   unsigned int x;
+
+   for(x = 0; x < SWALLOW_HASH_SIZE; x++) {
+      for(np = pendingNodes[x]; np; np = np->next) {
+         if(np->command && !TakeLaunchedNode(np->name)) {
+            RunCommand(np->command);
+         }
       }
    }
+
+   /* Programs that are no longer swallowed are left alone. */
+   ReleaseNodes(launchedNodes);
+   launchedNodes = NULL;
 }
 
 /** Destroy swallow data. */
 void DestroySwallow(void)
 {
-   ReleaseNodes(pendingNodes);
+   unsigned int x;
+
+   for(x = 0; x < SWALLOW_HASH_SIZE; x++) {
+      while(pendingNodes[x]) {
+         SwallowNode *np = pendingNodes[x];
+         pendingNodes[x] = np->next;
+         if(shouldRestart && np->command) {
+            /* Remember the program so that it is swallowed rather than
+             * started again once we restart. */
+            np->cp = NULL;
+            np->next = launchedNodes;
+            launchedNodes = np;
+         } else {
+            np->next = NULL;
+            ReleaseNodes(np);
+         }
+      }
+   }
+   pendingCount = 0;
    ReleaseNodes(swallowNodes);
-   pendingNodes = NULL;
    swallowNodes = NULL;
+   if(!shouldRestart) {
+      ReleaseNodes(launchedNodes);
+      launchedNodes = NULL;
+   }
 }
 
 /** Release a linked list of swallow nodes. */
@@ -73,12 +115,42 @@ void ReleaseNodes(SwallowNode *nodes)
    }
 }
 
+/** Get the bucket for a swallow name. */
+unsigned int GetSwallowHash(const char *name)
+{
+   unsigned int h = 5381;
+   while(*name) {
+      h = h * 33 + (unsigned char)*name;
+      name += 1;
+   }
+   return h & (SWALLOW_HASH_SIZE - 1);
+}
+
+/** Remove a program started before a restart.
+ * @return 1 if the program was started, 0 if not.
+ */
+char TakeLaunchedNode(const char *name)
+{
+   SwallowNode **npp;
+   for(npp = &launchedNodes; *npp; npp = &(*npp)->next) {
+      SwallowNode *np = *npp;
+      if(!strcmp(np->name, name)) {
+         *npp = np->next;
+         np->next = NULL;
+         ReleaseNodes(np);
+         return 1;
+      }
+   }
+   return 0;
+}
+
 /** Create a swallowed application tray component. */
 TrayComponentType *CreateSwallow(const char *name, const char *command,
                                  int width, int height)
 {
 
    TrayComponentType *cp;
+   SwallowNode **npp;
    SwallowNode *np;
 
    if(JUNLIKELY(!name)) {
@@ -90,8 +162,14 @@ TrayComponentType *CreateSwallow(const char *name, const char *command,
    np->name = CopyString(name);
    np->command = CopyString(command);
 
-   np->next = pendingNodes;
-   pendingNodes = np;
+   /* Keep the configuration order within a bucket. */
+   npp = &pendingNodes[GetSwallowHash(name)];
+   while(*npp) {
+      npp = &(*npp)->next;
+   }
+   np->next = NULL;
+   *npp = np;
+   pendingCount += 1;
 
    cp = CreateTrayComponent();
    np->cp = cp;
@@ -132,14 +210,14 @@ char ProcessSwallowEvent(const XEvent *event)
             np->cp->window = None;
             np->cp->requestedWidth = 1;
             np->cp->requestedHeight = 1;
-            ResizeTray(np->cp->tray);
+            ResizeTray(np->cp);
             break;
          case ResizeRequest:
             np->cp->requestedWidth
                = event->xresizerequest.width + np->border * 2;
             np->cp->requestedHeight
                = event->xresizerequest.height + np->border * 2;
-            ResizeTray(np->cp->tray);
+            ResizeTray(np->cp);
             break;
          case ConfigureNotify:
             /* I don't think this should be necessary, but somehow
@@ -150,7 +228,7 @@ char ProcessSwallowEvent(const XEvent *event)
                && height != np->cp->requestedHeight) {
                np->cp->requestedWidth = width;
                np->cp->requestedHeight = height;
-               ResizeTray(np->cp->tray);
+               ResizeTray(np->cp);
             }
             break;
          default:
@@ -204,33 +282,20 @@ void Destroy(TrayComponentType *cp)
 }
 
 /** Determine if this is a window to be swallowed, if it is, swallow it. */
-char CheckSwallowMap(Window win)
+char CheckSwallowMap(Window win, const char *name)
 {
 
    SwallowNode **npp;
-   XClassHint hint;
    XWindowAttributes attr;
-   char result;
-
-   /* Return if there are no programs left to swallow. */
-   if(!pendingNodes) {
-      return 0;
-   }
-
-   /* Get the name of the window. */
-   if(JXGetClassHint(display, win, &hint) == 0) {
-      return 0;
-   }
 
    /* Check if we should swallow this window. */
-   result = 0;
-   npp = &pendingNodes;
-   while(*npp) {
+   for(npp = &pendingNodes[GetSwallowHash(name)]; *npp;
+       npp = &(*npp)->next) {
 
       SwallowNode *np = *npp;
       Assert(np->cp->tray->window != None);
 
-      if(!strcmp(hint.res_name, np->name)) {
+      if(!strcmp(name, np->name)) {
 
          /* Swallow the window. */
          JXSelectInput(display, win,
@@ -242,11 +307,12 @@ char CheckSwallowMap(Window win)
          JXMapRaised(display, win);
          np->cp->window = win;
 
-         /* Remove this node from the pendingNodes list and place it
+         /* Remove this node from the pending nodes and place it
           * on the swallowNodes list. */
          *npp = np->next;
          np->next = swallowNodes;
          swallowNodes = np;
+         pendingCount -= 1;
 
          /* Update the size. */
          JXGetWindowAttributes(display, win, &attr);
@@ -258,25 +324,20 @@ char CheckSwallowMap(Window win)
             np->cp->requestedHeight = attr.height + 2 * np->border;
          }
 
-         ResizeTray(np->cp->tray);
-         result = 1;
+         ResizeTray(np->cp);
+         return 1;
 
-         break;
       }
 
-      npp = &np->next;
-
    }
-   JXFree(hint.res_name);
-   JXFree(hint.res_class);
 
-   return result;
+   return 0;
 
 }
 
 /** Determine if there are swallow processes pending. */
 char IsSwallowPending(void)
 {
-   return pendingNodes ? 1 : 0;
+   return pendingCount > 0 ? 1 : 0;
 }
 
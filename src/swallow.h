@@ -27,11 +27,12 @@ struct TrayComponentType *CreateSwallow(const char *name,
                                         const char *command,
                                         int width, int height);
 
-/** Determine if a window should be swallowed.
+/** Determine if a window should be swallowed, and if so, swallow it.
  * @param win The window.
- * @return 1 if this window should be swallowed, 0 if not.
+ * @param name The instance name from the class hint of the window.
+ * @return 1 if this window was swallowed, 0 if not.
  */
-char CheckSwallowMap(Window win);
+char CheckSwallowMap(Window win, const char *name);
 
 /** Process an event on a swallowed window.
  * @param event The event to process.
@@ -11,6 +11,7 @@
 #include "taskbar.h"
 #include "tray.h"
 #include "timing.h"
+#include "trace.h"
 #include "main.h"
 #include "client.h"
 #include "clientlist.h"
@@ -26,6 +27,19 @@
 #include "event.h"
 #include "misc.h"
 #include "desktop.h"
+#include "render.h"
+#include "font.h"
+
+/** What was last drawn for an item on a task bar.
+ * Items are only redrawn when this changes.
+ */
+typedef struct TaskSlot {
+   IconNode *icon;         /**< The icon shown. */
+   char *text;             /**< The label without the count (or NULL). */
+   unsigned int count;     /**< The count shown after the label (or 0). */
+   ButtonType type;        /**< The button type (active or not). */
+   char changed;           /**< Set if the item must be drawn. */
+} TaskSlot;
 
 typedef struct TaskBarType {
 
@@ -41,6 +55,13 @@ typedef struct TaskBarType {
 
    Pixmap buffer;
 
+   TaskSlot *slots;
+   unsigned int slotCount;
+   unsigned int slotCapacity;
+   int slotWidth, slotHeight;
+   char suspended;         /**< Set while the tray is not shown. */
+   char redraw;
+
    TimeType mouseTime;
    int mousex, mousey;
 
@@ -56,17 +77,50 @@ typedef struct TaskEntry {
    ClientEntry *clients;
    struct TaskEntry *next;
    struct TaskEntry *prev;
+   char *className;              /**< Group class (NULL if not grouped). */
+   struct TaskEntry *hashNext;   /**< Next group in the hash chain. */
 } TaskEntry;
 
+/** Size of the group hash (must be a power of two). */
+#define TASK_HASH_SIZE 64
+
+/** Minimum time between _NET_CLIENT_LIST_STACKING updates (ms). */
+#define STACKING_LIST_DELAY 100
+
+/** A window list last written to a root window property. */
+typedef struct WindowList {
+   Window *windows;
+   unsigned int count;
+   unsigned int capacity;
+   char valid;
+} WindowList;
+
 static TaskBarType *bars;
 static TaskEntry *taskEntries;
 static TaskEntry *taskEntriesTail;
+static TaskEntry *taskHash[TASK_HASH_SIZE];
+
+static WindowList clientList;
+static WindowList stackingList;
+static TimeType stackingTime;
+static char stackingPending;
+static char clientListHeld;
+static char clientListChanged;
 
 static void ComputeItemSize(TaskBarType *tp);
+static void PublishWindowList(WindowList *lp, AtomType atom,
+                              const Window *windows, unsigned int count);
+static void SignalStackingList(const TimeType *now, int x, int y, Window w,
+                               void *data);
 static char ShouldShowEntry(const TaskEntry *tp);
 static char ShouldFocusEntry(const TaskEntry *tp);
 static TaskEntry *GetEntry(TaskBarType *bar, int x, int y);
-static void Render(const TaskBarType *bp);
+static unsigned int GetTaskHash(const char *className);
+static void RemoveTaskEntry(TaskEntry *tp);
+static void Render(TaskBarType *bp);
+static char UpdateSlot(TaskSlot *sp, IconNode *icon, const char *text,
+                       unsigned int count, ButtonType type);
+static void ReleaseSlots(TaskBarType *bp);
 static void ShowClientList(TaskBarType *bar, TaskEntry *tp);
 static void RunTaskBarCommand(MenuAction *action, unsigned button);
 
@@ -82,6 +136,7 @@ static void ProcessTaskMotionEvent(TrayComponentType *cp,
                                    int x, int y, int mask);
 static void SignalTaskbar(const TimeType *now, int x, int y, Window w,
                           void *data);
+static void SetSuspended(TrayComponentType *cp, char suspended);
 
 /** Initialize task bar data. */
 void InitializeTaskBar(void)
@@ -89,6 +144,7 @@ void InitializeTaskBar(void)
    bars = NULL;
    taskEntries = NULL;
    taskEntriesTail = NULL;
+   memset(taskHash, 0, sizeof(taskHash));
 }
 
 /** Shutdown the task bar. */
@@ -96,7 +152,9 @@ void ShutdownTaskBar(void)
 {
    TaskBarType *bp;
    for(bp = bars; bp; bp = bp->next) {
-      JXFreePixmap(display, bp->buffer);
+      ReleaseTrayPixmap(bp->cp);
+      bp->buffer = None;
+      ReleaseSlots(bp);
    }
 }
 
@@ -106,10 +164,26 @@ void DestroyTaskBar(void)
    TaskBarType *bp;
    while(bars) {
       bp = bars->next;
-      UnregisterCallback(SignalTaskbar, bars);
+      if(!bars->suspended) {
+         UnregisterCallback(SignalTaskbar, bars);
+      }
+      ReleaseSlots(bars);
+      if(bars->slots) {
+         Release(bars->slots);
+      }
       Release(bars);
       bars = bp;
    }
+   UnregisterTimeout(SignalStackingList, NULL);
+   stackingPending = 0;
+   if(clientList.windows) {
+      Release(clientList.windows);
+   }
+   if(stackingList.windows) {
+      Release(stackingList.windows);
+   }
+   memset(&clientList, 0, sizeof(clientList));
+   memset(&stackingList, 0, sizeof(stackingList));
 }
 
 /** Create a new task bar tray component. */
@@ -132,6 +206,13 @@ TrayComponentType *CreateTaskBar()
    tp->mousey = -settings.doubleClickDelta;
    tp->mouseTime.seconds = 0;
    tp->mouseTime.ms = 0;
+   tp->slots = NULL;
+   tp->slotCount = 0;
+   tp->slotCapacity = 0;
+   tp->slotWidth = 0;
+   tp->slotHeight = 0;
+   tp->redraw = 1;
+   tp->suspended = 0;
 
    cp = CreateTrayComponent();
    cp->object = tp;
@@ -142,6 +223,7 @@ TrayComponentType *CreateTaskBar()
    cp->Resize = Resize;
    cp->ProcessButtonPress = ProcessTaskButtonEvent;
    cp->ProcessMotionEvent = ProcessTaskMotionEvent;
+   cp->SetSuspended = SetSuspended;
 
    RegisterCallback(settings.popupDelay / 2, SignalTaskbar, tp);
 
@@ -168,9 +250,9 @@ void SetSize(TrayComponentType *cp, int width, int height)
 void Create(TrayComponentType *cp)
 {
    TaskBarType *tp = (TaskBarType*)cp->object;
-   cp->pixmap = JXCreatePixmap(display, rootWindow, cp->width, cp->height,
-                               rootDepth);
+   CreateTrayPixmap(cp);
    tp->buffer = cp->pixmap;
+   tp->redraw = 1;
    ClearTrayDrawable(cp);
 }
 
@@ -178,12 +260,9 @@ void Create(TrayComponentType *cp)
 void Resize(TrayComponentType *cp)
 {
    TaskBarType *tp = (TaskBarType*)cp->object;
-   if(tp->buffer != None) {
-      JXFreePixmap(display, tp->buffer);
-   }
-   cp->pixmap = JXCreatePixmap(display, rootWindow, cp->width, cp->height,
-                               rootDepth);
+   CreateTrayPixmap(cp);
    tp->buffer = cp->pixmap;
+   tp->redraw = 1;
    ClearTrayDrawable(cp);
 }
 
@@ -624,6 +703,17 @@ void RunTaskBarCommand(MenuAction *action, unsigned button)
    }
 }
 
+/** Get the group hash of a class name. */
+unsigned int GetTaskHash(const char *className)
+{
+   unsigned int hash = 5381;
+   while(*className) {
+      hash = hash * 33 + (unsigned char)*className;
+      className += 1;
+   }
+   return hash & (TASK_HASH_SIZE - 1);
+}
+
 /** Add a client to the task bar. */
 void AddClientToTaskBar(ClientNode *np)
 {
@@ -632,16 +722,26 @@ void AddClientToTaskBar(ClientNode *np)
    cp->client = np;
 
    if(np->className && settings.groupTasks) {
-      for(tp = taskEntries; tp; tp = tp->next) {
-         const char *className = tp->clients->client->className;
-         if(className && !strcmp(np->className, className)) {
+      const unsigned int hash = GetTaskHash(np->className);
+      for(tp = taskHash[hash]; tp; tp = tp->hashNext) {
+         if(!strcmp(np->className, tp->className)) {
             break;
          }
       }
-   }
-   if(tp == NULL) {
+      if(tp == NULL) {
+         tp = Allocate(sizeof(TaskEntry));
+         tp->clients = NULL;
+         tp->className = CopyString(np->className);
+         tp->hashNext = taskHash[hash];
+         taskHash[hash] = tp;
+      }
+   } else {
       tp = Allocate(sizeof(TaskEntry));
       tp->clients = NULL;
+      tp->className = NULL;
+      tp->hashNext = NULL;
+   }
+   if(tp->clients == NULL) {
       tp->next = NULL;
       tp->prev = taskEntriesTail;
       if(taskEntriesTail) {
@@ -664,54 +764,97 @@ void AddClientToTaskBar(ClientNode *np)
 
 }
 
+/** Remove an empty group from the task bar. */
+void RemoveTaskEntry(TaskEntry *tp)
+{
+   if(tp->prev) {
+      tp->prev->next = tp->next;
+   } else {
+      taskEntries = tp->next;
+   }
+   if(tp->next) {
+      tp->next->prev = tp->prev;
+   } else {
+      taskEntriesTail = tp->prev;
+   }
+   if(tp->className) {
+      TaskEntry **lp = &taskHash[GetTaskHash(tp->className)];
+      while(*lp != tp) {
+         lp = &(*lp)->hashNext;
+      }
+      *lp = tp->hashNext;
+      Release(tp->className);
+   }
+   Release(tp);
+}
+
 /** Remove a client from the task bar. */
 void RemoveClientFromTaskBar(ClientNode *np)
 {
-   TaskEntry *tp;
-   for(tp = taskEntries; tp; tp = tp->next) {
-      ClientEntry *cp;
-      for(cp = tp->clients; cp; cp = cp->next) {
-         if(cp->client == np) {
-            if(cp->prev) {
-               cp->prev->next = cp->next;
-            } else {
-               tp->clients = cp->next;
-            }
-            if(cp->next) {
-               cp->next->prev = cp->prev;
-            }
-            Release(cp);
-            if(!tp->clients) {
-               if(tp->prev) {
-                  tp->prev->next = tp->next;
-               } else {
-                  taskEntries = tp->next;
-               }
-               if(tp->next) {
-                  tp->next->prev = tp->prev;
-               } else {
-                  taskEntriesTail = tp->prev;
-               }
-               Release(tp);
-            }
-            RequireTaskUpdate();
-            UpdateNetClientList();
-            return;
+   TaskEntry *tp = NULL;
+   ClientEntry *cp = NULL;
+
+   /* Look in the group for the class first; the class may have changed
+    * since the client was added, so fall back to checking every entry. */
+   if(np->className && settings.groupTasks) {
+      const unsigned int hash = GetTaskHash(np->className);
+      for(tp = taskHash[hash]; tp; tp = tp->hashNext) {
+         if(!strcmp(np->className, tp->className)) {
+            for(cp = tp->clients; cp && cp->client != np; cp = cp->next);
+            break;
+         }
+      }
+   }
+   if(cp == NULL) {
+      for(tp = taskEntries; tp; tp = tp->next) {
+         for(cp = tp->clients; cp && cp->client != np; cp = cp->next);
+         if(cp) {
+            break;
          }
       }
+      if(cp == NULL) {
+         return;
+      }
+   }
+
+   if(cp->prev) {
+      cp->prev->next = cp->next;
+   } else {
+      tp->clients = cp->next;
+   }
+   if(cp->next) {
+      cp->next->prev = cp->prev;
+   }
+   Release(cp);
+   if(!tp->clients) {
+      RemoveTaskEntry(tp);
    }
+   RequireTaskUpdate();
+   UpdateNetClientList();
+}
+
+/** Redraw every item on the next task bar update. */
+void InvalidateTaskBar(void)
+{
+   TaskBarType *bp;
+   for(bp = bars; bp; bp = bp->next) {
+      bp->redraw = 1;
+   }
+   RequireTaskUpdate();
 }
 
 /** Update all task bars. */
 void UpdateTaskBar(void)
 {
    TaskBarType *bp;
+   TraceTime traceStart;
    int lastHeight = -1;
 
    if(JUNLIKELY(shouldExit)) {
       return;
    }
 
+   traceStart = StartTrace();
    for(bp = bars; bp; bp = bp->next) {
       if(bp->layout == LAYOUT_VERTICAL) {
          TaskEntry *tp;
@@ -729,11 +872,29 @@ void UpdateTaskBar(void)
          }
          bp->cp->requestedHeight = Max(1, bp->cp->requestedHeight);
          if(lastHeight != bp->cp->requestedHeight) {
-            ResizeTray(bp->cp->tray);
+            ResizeTray(bp->cp);
          }
       }
       ComputeItemSize(bp);
-      Render(bp);
+      if(!bp->suspended) {
+         Render(bp);
+      }
+   }
+   RecordTrace("UpdateTaskBar", -1, traceStart);
+}
+
+/** Stop updating a task bar while its tray is not shown. */
+void SetSuspended(TrayComponentType *cp, char suspended)
+{
+   TaskBarType *bp = (TaskBarType*)cp->object;
+   bp->suspended = suspended;
+   if(suspended) {
+      UnregisterCallback(SignalTaskbar, bp);
+   } else {
+      RegisterCallback(settings.popupDelay / 2, SignalTaskbar, bp);
+      if(bp->buffer != None) {
+         Render(bp);
+      }
    }
 }
 
@@ -763,22 +924,30 @@ void SignalTaskbar(const TimeType *now, int x, int y, Window w, void *data)
 
 }
 
-/** Draw a specific task bar. */
-void Render(const TaskBarType *bp)
+/** Draw a specific task bar.
+ * Only items that changed since the last time are drawn and copied to
+ * the tray.
+ */
+void Render(TaskBarType *bp)
 {
-   TaskEntry *tp;
-   char *displayName;
    ButtonNode button;
    int x, y;
+   unsigned int index, count;
 
    if(JUNLIKELY(shouldExit)) {
       return;
    }
 
-   ClearTrayDrawable(bp->cp);
-   if(!taskEntries) {
+   /* Everything moves if the item size changes. */
+   if(bp->itemWidth != bp->slotWidth || bp->itemHeight != bp->slotHeight) {
+      bp->redraw = 1;
+   }
+   if(bp->redraw) {
+      ClearTrayDrawable(bp->cp);
+      ReleaseSlots(bp);
+      bp->slotWidth = bp->itemWidth;
+      bp->slotHeight = bp->itemHeight;
       UpdateSpecificTray(bp->cp->tray, bp->cp);
-      return;
    }
 
    ResetButton(&button, bp->cp->pixmap);
@@ -788,70 +957,180 @@ void Render(const TaskBarType *bp)
    button.width = bp->itemWidth;
    button.text = NULL;
 
+   count = UpdateTaskBarSlots(bp->cp);
    x = 0;
    y = 0;
+   for(index = 0; index < count; index++) {
+
+      const TaskSlot *sp = &bp->slots[index];
+
+      /* Draw the item if it changed. */
+      if(sp->changed) {
+         char *displayName = NULL;
+         button.type = sp->type;
+         button.icon = sp->icon;
+         button.x = bp->cp->pixmapX + x;
+         button.y = bp->cp->pixmapY + y;
+         button.text = sp->text;
+         if(sp->count) {
+            const size_t len = strlen(sp->text) + 16;
+            displayName = Allocate(len);
+            snprintf(displayName, len, "%s (%u)", sp->text, sp->count);
+            button.text = displayName;
+         }
+         DrawButton(&button);
+         if(displayName) {
+            Release(displayName);
+         }
+         UpdateTrayArea(bp->cp->tray, bp->cp, x, y,
+                        bp->itemWidth, bp->itemHeight);
+      }
+
+      if(bp->layout == LAYOUT_HORIZONTAL) {
+         x += bp->itemWidth;
+      } else {
+         y += bp->itemHeight;
+      }
+   }
+
+   /* Clear items that are no longer shown. */
+   if(count < bp->slotCount) {
+      int width, height;
+      if(bp->layout == LAYOUT_HORIZONTAL) {
+         width = (bp->slotCount - count) * bp->itemWidth;
+         height = bp->itemHeight;
+      } else {
+         width = bp->itemWidth;
+         height = (bp->slotCount - count) * bp->itemHeight;
+      }
+      ClearTrayArea(bp->cp, x, y, width, height);
+      UpdateTrayArea(bp->cp->tray, bp->cp, x, y, width, height);
+      while(bp->slotCount > count) {
+         bp->slotCount -= 1;
+         if(bp->slots[bp->slotCount].text) {
+            Release(bp->slots[bp->slotCount].text);
+         }
+      }
+   }
+   bp->redraw = 0;
+
+}
+
+/** Record what each item of a task bar shows. */
+unsigned int UpdateTaskBarSlots(TrayComponentType *component)
+{
+   TaskBarType *bp = (TaskBarType*)component->object;
+   TaskEntry *tp;
+   unsigned int index;
+
+   index = 0;
    for(tp = taskEntries; tp; tp = tp->next) {
 
+      ClientEntry *cp;
+      ButtonType type;
+      IconNode *icon;
+      const char *text;
+      unsigned clientCount = 0;
+      unsigned count;
+
       if(!ShouldShowEntry(tp)) {
          continue;
       }
 
       /* Check for an active or urgent window and count clients. */
-      ClientEntry *cp;
-      unsigned clientCount = 0;
-      button.type = BUTTON_TASK;
+      type = BUTTON_TASK;
       for(cp = tp->clients; cp; cp = cp->next) {
          if(ShouldFocus(cp->client, 0)) {
             const char flash = (cp->client->state.status & STAT_FLASH) != 0;
             const char active = (cp->client->state.status & STAT_ACTIVE)
                && IsClientOnCurrentDesktop(cp->client);
             if(flash || active) {
-               if(button.type == BUTTON_TASK) {
-                  button.type = BUTTON_TASK_ACTIVE;
+               if(type == BUTTON_TASK) {
+                  type = BUTTON_TASK_ACTIVE;
                } else {
-                  button.type = BUTTON_TASK;
+                  type = BUTTON_TASK;
                }
             }
             clientCount += 1;
          }
       }
-      button.x = x;
-      button.y = y;
       if(!tp->clients->client || !tp->clients->client->icon) {
-         button.icon = GetDefaultIcon();
+         icon = GetDefaultIcon();
       } else {
-         button.icon = tp->clients->client->icon;
+         icon = tp->clients->client->icon;
       }
-      displayName = NULL;
+      text = NULL;
+      count = 0;
       if(bp->labeled) {
          if(tp->clients->client->className && settings.groupTasks) {
+            text = tp->clients->client->className;
             if(clientCount != 1) {
-               const size_t len = strlen(tp->clients->client->className) + 16;
-               displayName = Allocate(len);
-               snprintf(displayName, len, "%s (%u)",
-                        tp->clients->client->className, clientCount);
-               button.text = displayName;
-            } else {
-               button.text = tp->clients->client->className;
+               count = clientCount;
             }
          } else {
-            button.text = tp->clients->client->name;
+            text = tp->clients->client->name;
          }
       }
-      DrawButton(&button);
-      if(displayName) {
-         Release(displayName);
-      }
 
-      if(bp->layout == LAYOUT_HORIZONTAL) {
-         x += bp->itemWidth;
-      } else {
-         y += bp->itemHeight;
+      /* Note if the item changed. */
+      if(!bp->slots) {
+         bp->slotCapacity = 8;
+         bp->slots = Allocate(bp->slotCapacity * sizeof(TaskSlot));
+      } else if(index >= bp->slotCapacity) {
+         bp->slotCapacity *= 2;
+         bp->slots = Reallocate(bp->slots,
+                                bp->slotCapacity * sizeof(TaskSlot));
       }
+      if(index >= bp->slotCount) {
+         /* BUTTON_MENU is never shown, so new items are always drawn. */
+         TaskSlot *sp = &bp->slots[index];
+         sp->icon = NULL;
+         sp->text = NULL;
+         sp->count = 0;
+         sp->type = BUTTON_MENU;
+         bp->slotCount = index + 1;
+      }
+      bp->slots[index].changed = UpdateSlot(&bp->slots[index], icon, text,
+                                            count, type);
+      index += 1;
    }
 
-   UpdateSpecificTray(bp->cp->tray, bp->cp);
+   return index;
+}
+
+/** Record what is drawn for an item.
+ * @return 1 if the item changed, 0 otherwise.
+ */
+char UpdateSlot(TaskSlot *sp, IconNode *icon, const char *text,
+                unsigned int count, ButtonType type)
+{
+   if(sp->icon == icon && sp->count == count && sp->type == type) {
+      if(text == NULL && sp->text == NULL) {
+         return 0;
+      }
+      if(text && sp->text && !strcmp(text, sp->text)) {
+         return 0;
+      }
+   }
+   sp->icon = icon;
+   sp->count = count;
+   sp->type = type;
+   if(sp->text) {
+      Release(sp->text);
+   }
+   sp->text = text ? CopyString(text) : NULL;
+   return 1;
+}
 
+/** Forget what was drawn on a task bar. */
+void ReleaseSlots(TaskBarType *bp)
+{
+   while(bp->slotCount > 0) {
+      bp->slotCount -= 1;
+      if(bp->slots[bp->slotCount].text) {
+         Release(bp->slots[bp->slotCount].text);
+      }
+   }
 }
 
 /** Focus the next client in the task bar. */
@@ -1028,6 +1307,59 @@ void SetTaskBarLabeled(TrayComponentType *cp, char labeled)
    bp->labeled = labeled;
 }
 
+/** Write a window list property, sending only what changed. */
+void PublishWindowList(WindowList *lp, AtomType atom,
+                       const Window *windows, unsigned int count)
+{
+   const unsigned int common = Min(count, lp->count);
+   const char isPrefix = common == lp->count
+      && (common == 0
+          || !memcmp(windows, lp->windows, common * sizeof(Window)));
+
+   if(lp->valid && isPrefix && count == lp->count) {
+      return;
+   }
+
+   if(lp->valid && isPrefix) {
+      /* Clients were only added at the end. */
+      JXChangeProperty(display, rootWindow, atoms[atom], XA_WINDOW, 32,
+                       PropModeAppend, (unsigned char*)&windows[common],
+                       count - common);
+   } else {
+      JXChangeProperty(display, rootWindow, atoms[atom], XA_WINDOW, 32,
+                       PropModeReplace, (unsigned char*)windows, count);
+   }
+
+   if(count > lp->capacity || !lp->windows) {
+      if(lp->windows) {
+         Release(lp->windows);
+      }
+      lp->capacity = count + count / 2 + 8;
+      lp->windows = Allocate(lp->capacity * sizeof(Window));
+   }
+   memcpy(lp->windows, windows, count * sizeof(Window));
+   lp->count = count;
+   lp->valid = 1;
+}
+
+/** Hold back _NET_CLIENT_LIST updates. */
+void HoldNetClientList(char hold)
+{
+   clientListHeld = hold;
+   if(!hold && clientListChanged) {
+      clientListChanged = 0;
+      UpdateNetClientList();
+   }
+}
+
+/** Publish a stacking list that was held back by the rate limit. */
+void SignalStackingList(const TimeType *now, int x, int y, Window w,
+                        void *data)
+{
+   stackingPending = 0;
+   UpdateNetClientList();
+}
+
 /** Maintain the _NET_CLIENT_LIST[_STACKING] properties on the root. */
 void UpdateNetClientList(void)
 {
@@ -1036,14 +1368,15 @@ void UpdateNetClientList(void)
    Window *windows;
    unsigned int count;
    int layer;
+   TimeType now;
 
-   /* Determine how much we need to allocate. */
-   if(clientCount == 0) {
-      windows = NULL;
-   } else {
-      windows = AllocateStack(clientCount * sizeof(Window));
+   if(clientListHeld) {
+      clientListChanged = 1;
+      return;
    }
 
+   windows = AllocateStack((clientCount + 1) * sizeof(Window));
+
    /* Set _NET_CLIENT_LIST */
    count = 0;
    for(tp = taskEntries; tp; tp = tp->next) {
@@ -1054,24 +1387,35 @@ void UpdateNetClientList(void)
       }
    }
    Assert(count <= clientCount);
-   JXChangeProperty(display, rootWindow, atoms[ATOM_NET_CLIENT_LIST],
-                    XA_WINDOW, 32, PropModeReplace,
-                    (unsigned char*)windows, count);
-
-   /* Set _NET_CLIENT_LIST_STACKING */
-   count = 0;
-   for(layer = FIRST_LAYER; layer <= LAST_LAYER; layer++) {
-      for(client = nodes[layer]; client; client = client->next) {
-         windows[count] = client->window;
-         count += 1;
+   PublishWindowList(&clientList, ATOM_NET_CLIENT_LIST, windows, count);
+
+   /* Set _NET_CLIENT_LIST_STACKING.
+    * This changes on every raise, so writes are limited to one every
+    * STACKING_LIST_DELAY milliseconds (for example while dragging).
+    * A change inside the window is sent when the window expires.
+    */
+   if(!stackingPending) {
+      count = 0;
+      for(layer = FIRST_LAYER; layer <= LAST_LAYER; layer++) {
+         for(client = nodes[layer]; client; client = client->next) {
+            windows[count] = client->window;
+            count += 1;
+         }
+      }
+      GetCurrentTime(&now);
+      if(shouldExit || !stackingList.valid
+         || GetTimeDifference(&now, &stackingTime) >= STACKING_LIST_DELAY) {
+         PublishWindowList(&stackingList, ATOM_NET_CLIENT_LIST_STACKING,
+                           windows, count);
+         stackingTime = now;
+      } else if(count != stackingList.count
+                || memcmp(windows, stackingList.windows,
+                          count * sizeof(Window))) {
+         stackingPending = 1;
+         RegisterTimeout(STACKING_LIST_DELAY, SignalStackingList, NULL);
       }
    }
-   JXChangeProperty(display, rootWindow, atoms[ATOM_NET_CLIENT_LIST_STACKING],
-                    XA_WINDOW, 32, PropModeReplace,
-                    (unsigned char*)windows, count);
 
-   if(windows != NULL) {
-      ReleaseStack(windows);
-   }
-   
+   ReleaseStack(windows);
+
 }
@@ -36,6 +36,19 @@ void RemoveClientFromTaskBar(struct ClientNode *np);
 /** Update all task bars. */
 void UpdateTaskBar(void);
 
+/** Record what each item of a task bar shows.
+ * This does not draw anything; items that must be drawn are marked.
+ * @param cp The task bar tray component.
+ * @return The number of items shown.
+ */
+unsigned int UpdateTaskBarSlots(struct TrayComponentType *cp);
+
+/** Redraw every item on the next task bar update.
+ * Task bars otherwise only redraw items whose state, label, or icon
+ * changed, so this is needed when an icon changes in place.
+ */
+void InvalidateTaskBar(void);
+
 /** Focus the next client in the task bar. */
 void FocusNext(void);
 
@@ -63,4 +76,11 @@ void SetTaskBarLabeled(struct TrayComponentType *cp, char value);
 /** Update the _NET_CLIENT_LIST property. */
 void UpdateNetClientList(void);
 
+/** Hold back _NET_CLIENT_LIST updates.
+ * This is used while adopting windows at startup. Releasing the hold
+ * publishes the list if it changed.
+ * @param hold 1 to hold updates, 0 to release.
+ */
+void HoldNetClientList(char hold);
+
 #endif /* TASKBAR_H */
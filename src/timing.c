@@ -9,9 +9,42 @@
 
 #include "jwm.h"
 #include "timing.h"
+#include "misc.h"
+
+#ifdef HAVE_LANGINFO_H
+#  include <langinfo.h>
+#endif
 
 static const unsigned long MAX_TIME_SECONDS = 60;
 
+/** How long the UTC offset of a zone is reused, in seconds.
+ * Offsets only change at transitions, which fall on quarter hours.
+ */
+#define ZONE_OFFSET_PERIOD 900
+
+/** Cached rules for a time zone. */
+typedef struct TimeZoneNode {
+   char *zone;                   /**< The zone in tzset() format. */
+#ifdef HAVE_LOCALTIME_RZ
+   timezone_t tz;                /**< The parsed zone. */
+#else
+   time_t expires;               /**< When the offset must be recomputed. */
+   long offset;                  /**< Seconds east of UTC. */
+   int isdst;                    /**< Daylight saving time flag. */
+   char name[16];                /**< Abbreviation of the zone. */
+#endif
+   struct TimeZoneNode *next;    /**< Next zone. */
+} TimeZoneNode;
+
+static TimeZoneNode *zones = NULL;
+
+static TimeZoneNode *GetTimeZone(const char *zone);
+#ifndef HAVE_LOCALTIME_RZ
+static void UpdateTimeZone(TimeZoneNode *zp, time_t t);
+static const char *GetZoneFormat(const TimeZoneNode *zp, const char *format,
+                                 char *buffer, size_t size, int depth);
+#endif
+
 /** Get the current time in milliseconds since midnight 1970-01-01 UTC. */
 void GetCurrentTime(TimeType *t)
 {
@@ -53,40 +86,262 @@ unsigned long GetTimeDifference(const TimeType *t1, const TimeType *t2)
 
 }
 
+/** Compare two times. */
+int CompareTime(const TimeType *t1, const TimeType *t2)
+{
+   if(t1->seconds != t2->seconds) {
+      return t1->seconds < t2->seconds ? -1 : 1;
+   } else if(t1->ms != t2->ms) {
+      return t1->ms < t2->ms ? -1 : 1;
+   } else {
+      return 0;
+   }
+}
+
+/** Advance a time by the specified number of milliseconds. */
+void AdvanceTime(TimeType *t, unsigned long ms)
+{
+   ms += t->ms;
+   t->seconds += ms / 1000;
+   t->ms = ms % 1000;
+}
+
+/** Get a monotonic timestamp in microseconds. */
+unsigned long long GetMonotonicTime(void)
+{
+#if defined(HAVE_CLOCK_GETTIME) && defined(CLOCK_MONOTONIC)
+   struct timespec val;
+   clock_gettime(CLOCK_MONOTONIC, &val);
+   return (unsigned long long)val.tv_sec * 1000000ULL + val.tv_nsec / 1000;
+#else
+   struct timeval val;
+   gettimeofday(&val, NULL);
+   return (unsigned long long)val.tv_sec * 1000000ULL + val.tv_usec;
+#endif
+}
+
 /** Get the current time. */
 const char *GetTimeString(const char *format, const char *zone)
 {
-   static char saveTZ[256];
-   static char newTZ[256];
    static char str[80];
    time_t t;
 
    time(&t);
    if(zone) {
-      const char *oldTZ = getenv("TZ");
-      if(oldTZ) {
-         snprintf(saveTZ, sizeof(saveTZ), "TZ=%s", oldTZ);
-#ifndef HAVE_UNSETENV
-      } else {
-         strcpy(saveTZ, "TZ=");
-#endif
+      TimeZoneNode *zp = GetTimeZone(zone);
+      struct tm tm;
+#ifdef HAVE_LOCALTIME_RZ
+      localtime_rz(zp->tz, &t, &tm);
+      strftime(str, sizeof(str), format, &tm);
+#else
+      char buffer[256];
+      time_t local;
+      if(t >= zp->expires) {
+         UpdateTimeZone(zp, t);
       }
-      snprintf(newTZ, sizeof(newTZ), "TZ=%s", zone);
-      putenv(newTZ);
-      tzset();
+
+      /* Format the shifted UTC time, substituting the zone fields. */
+      local = t + zp->offset;
+      tm = *gmtime(&local);
+      tm.tm_isdst = zp->isdst;
+      strftime(str, sizeof(str),
+               GetZoneFormat(zp, format, buffer, sizeof(buffer), 0), &tm);
+#endif
+   } else {
       strftime(str, sizeof(str), format, localtime(&t));
-#ifdef HAVE_UNSETENV
-      if(oldTZ) {
-         putenv(saveTZ);
-      } else {
-         unsetenv("TZ");
+   }
+
+   return str;
+}
+
+/** Get the number of seconds between changes of a time string. */
+unsigned int GetTimeStringPeriod(const char *format)
+{
+   const char *ch;
+   for(ch = format; *ch; ch++) {
+      if(*ch != '%') {
+         continue;
+      }
+
+      /* Skip flags, width, and modifiers. */
+      ch += 1;
+      while(*ch && strchr("_-0^#EO123456789", *ch)) {
+         ch += 1;
+      }
+      switch(*ch) {
+      case 0:
+         return 60;
+      case 'S':
+      case 's':
+      case 'T':
+      case 'r':
+      case 'c':
+      case 'X':
+      case '+':
+         return 1;
+      default:
+         break;
       }
+   }
+   return 60;
+}
+
+/** Release cached time zones. */
+void DestroyTimeZones(void)
+{
+   while(zones) {
+      TimeZoneNode *zp = zones->next;
+#ifdef HAVE_LOCALTIME_RZ
+      tzfree(zones->tz);
+#endif
+      Release(zones->zone);
+      Release(zones);
+      zones = zp;
+   }
+}
+
+/** Get the cached rules for a time zone. */
+TimeZoneNode *GetTimeZone(const char *zone)
+{
+   TimeZoneNode *zp;
+   for(zp = zones; zp; zp = zp->next) {
+      if(!strcmp(zp->zone, zone)) {
+         return zp;
+      }
+   }
+   zp = Allocate(sizeof(TimeZoneNode));
+   zp->zone = CopyString(zone);
+#ifdef HAVE_LOCALTIME_RZ
+   zp->tz = tzalloc(zone);
 #else
+   zp->expires = 0;
+#endif
+   zp->next = zones;
+   zones = zp;
+   return zp;
+}
+
+#ifndef HAVE_LOCALTIME_RZ
+
+/** Determine the UTC offset of a zone.
+ * This is the only place the TZ environment variable is changed.
+ */
+void UpdateTimeZone(TimeZoneNode *zp, time_t t)
+{
+   static char saveTZ[256];
+   static char newTZ[256];
+   const char *oldTZ = getenv("TZ");
+   struct tm local;
+   struct tm utc;
+   long days;
+
+   if(oldTZ) {
+      snprintf(saveTZ, sizeof(saveTZ), "TZ=%s", oldTZ);
+#ifndef HAVE_UNSETENV
+   } else {
+      strcpy(saveTZ, "TZ=");
+#endif
+   }
+   snprintf(newTZ, sizeof(newTZ), "TZ=%s", zp->zone);
+   putenv(newTZ);
+   tzset();
+   local = *localtime(&t);
+   strftime(zp->name, sizeof(zp->name), "%Z", &local);
+#ifdef HAVE_UNSETENV
+   if(oldTZ) {
       putenv(saveTZ);
+   } else {
+      unsetenv("TZ");
+   }
+#else
+   putenv(saveTZ);
 #endif
+   tzset();
+
+   utc = *gmtime(&t);
+   if(local.tm_year != utc.tm_year) {
+      days = local.tm_year > utc.tm_year ? 1 : -1;
    } else {
-      strftime(str, sizeof(str), format, localtime(&t));
+      days = local.tm_yday - utc.tm_yday;
    }
+   zp->offset = days * 86400L
+              + (local.tm_hour - utc.tm_hour) * 3600L
+              + (local.tm_min - utc.tm_min) * 60L
+              + (local.tm_sec - utc.tm_sec);
+   zp->isdst = local.tm_isdst;
+   zp->expires = t - t % ZONE_OFFSET_PERIOD + ZONE_OFFSET_PERIOD;
+}
 
-   return str;
+/** Replace the zone conversions of a format.
+ * strftime would print the zone of the shifted UTC time for these.
+ * @return The format to use (format itself if the result does not fit).
+ */
+const char *GetZoneFormat(const TimeZoneNode *zp, const char *format,
+                          char *buffer, size_t size, int depth)
+{
+   const char *ch;
+   size_t len = 0;
+
+   for(ch = format; *ch; ch++) {
+      char temp[32];
+#ifdef HAVE_LANGINFO_H
+      char inner[128];
+#endif
+      const char *text = temp;
+      char escape = 1;
+
+      if(*ch != '%' || ch[1] == 0) {
+         temp[0] = *ch;
+         temp[1] = 0;
+         escape = 0;
+      } else {
+         ch += 1;
+         switch(*ch) {
+         case 'Z':
+            text = zp->name;
+            break;
+         case 'z':
+            snprintf(temp, sizeof(temp), "%c%02ld%02ld",
+                     zp->offset < 0 ? '-' : '+',
+                     labs(zp->offset) / 3600, (labs(zp->offset) / 60) % 60);
+            break;
+#ifdef HAVE_LANGINFO_H
+         case 'c':
+            /* The date and time format of the locale may include %Z. */
+            if(depth == 0) {
+               text = GetZoneFormat(zp, nl_langinfo(D_T_FMT), inner,
+                                    sizeof(inner), 1);
+               escape = 0;
+            } else {
+               temp[0] = '%';
+               temp[1] = *ch;
+               temp[2] = 0;
+               escape = 0;
+            }
+            break;
+#endif
+         default:
+            temp[0] = '%';
+            temp[1] = *ch;
+            temp[2] = 0;
+            escape = 0;
+            break;
+         }
+      }
+
+      /* Copy the text, escaping '%' in zone names. */
+      for(; *text; text++) {
+         if(len + 3 > size) {
+            return format;
+         }
+         if(escape && *text == '%') {
+            buffer[len++] = '%';
+         }
+         buffer[len++] = *text;
+      }
+   }
+   buffer[len] = 0;
+   return buffer;
 }
+
+#endif /* HAVE_LOCALTIME_RZ */
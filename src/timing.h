@@ -34,14 +34,44 @@ void GetCurrentTime(TimeType *t);
  */
 unsigned long GetTimeDifference(const TimeType *t1, const TimeType *t2);
 
+/** Compare two times.
+ * Note that the times must be normalized.
+ * @param t1 The first time.
+ * @param t2 The second time.
+ * @return -1 if t1 is before t2, 1 if t1 is after t2, 0 if equal.
+ */
+int CompareTime(const TimeType *t1, const TimeType *t2);
+
+/** Advance a time by the specified number of milliseconds.
+ * @param t The time to update (normalized).
+ * @param ms The number of milliseconds to add.
+ */
+void AdvanceTime(TimeType *t, unsigned long ms);
+
+/** Get a monotonic timestamp.
+ * This is meant for measuring intervals, not for wall-clock time.
+ * @return The time in microseconds since an unspecified point.
+ */
+unsigned long long GetMonotonicTime(void);
+
 /** Get a time string.
  * Note that the string returned is a static value and should not be
  * deleted. Therefore, this function is not thread safe.
+ * Zones are parsed once and cached; see DestroyTimeZones.
  * @param format The format to use for the string.
  * @param zone The timezone in tzset() format to use (defaults to local)
  * @return The time string.
  */
 const char *GetTimeString(const char *format, const char *zone);
 
+/** Get how often a time string changes.
+ * @param format The format used for the string.
+ * @return 1 if the format shows seconds, 60 otherwise.
+ */
+unsigned int GetTimeStringPeriod(const char *format);
+
+/** Release the time zones cached by GetTimeString. */
+void DestroyTimeZones(void);
+
 #endif /* TIMING_H */
 
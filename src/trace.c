@@ -0,0 +1,386 @@
+/**
+ * @file trace.c
+ * @author Joe Wingbermuehle
+ * @date 2026
+ *
+ * @brief Trace ring buffer.
+ *
+ * Spans are kept in a fixed-size ring buffer so that tracing can always
+ * be on. When a hitch is reported, the last few seconds of spans can be
+ * written in the Chrome trace event format and loaded into a trace
+ * viewer such as Perfetto.
+ *
+ * The stall watchdog uses a timer signal while handlers run. If one
+ * runs past the configured timeout, the signal handler writes the name
+ * of the handler (and optionally a backtrace) while it is still stuck;
+ * once it returns, the spans are written as for a hitch.
+ *
+ */
+
+#include "jwm.h"
+
+#ifdef USE_TRACE
+
+#include "trace.h"
+#include "error.h"
+#include "timing.h"
+#include "settings.h"
+#include "misc.h"
+
+#include <errno.h>
+#include <fcntl.h>
+
+#if defined(HAVE_EXECINFO_H) && defined(HAVE_BACKTRACE)
+#  define USE_BACKTRACE
+#  include <execinfo.h>
+#endif
+
+/** Number of spans to keep. */
+#define TRACE_SIZE 16384
+
+/** A completed span. */
+typedef struct TraceSpan {
+   const char *name;
+   TraceTime start;
+   unsigned int duration;  /**< Microseconds. */
+   int detail;
+} TraceSpan;
+
+static TraceSpan spans[TRACE_SIZE];
+static unsigned int nextSpan = 0;
+static char spansWrapped = 0;
+static volatile sig_atomic_t traceRequested = 0;
+
+/** Number of nested handlers tracked by the watchdog. */
+#define WATCHDOG_DEPTH 8
+
+/** Number of frames in a stall backtrace. */
+#define BACKTRACE_SIZE 32
+
+/** A handler tracked by the watchdog. */
+typedef struct WatchdogFrame {
+   const char *name;
+   int detail;
+   Window window;
+   TraceTime start;        /**< When the handler started. */
+   TraceTime idle;         /**< Total idle time when it started. */
+} WatchdogFrame;
+
+static WatchdogFrame watchdogFrames[WATCHDOG_DEPTH];
+static volatile sig_atomic_t watchdogDepth = 0;
+static volatile sig_atomic_t watchdogIdle = 1;
+static volatile sig_atomic_t watchdogFired = 0;
+static volatile TraceTime watchdogBusySince = 0;
+static TraceTime watchdogIdleStart = 0;
+static TraceTime watchdogIdleTotal = 0;
+static unsigned long watchdogTimeout = 0;    /**< Microseconds (0 = off). */
+
+static void ArmWatchdog(unsigned long period);
+static void HandleWatchdog(int sig);
+static void WriteWatchdog(const char *str);
+static void WriteWatchdogNumber(unsigned long value, unsigned int base);
+
+/** Start timing a span. */
+TraceTime StartTrace(void)
+{
+   return GetMonotonicTime();
+}
+
+/** Record a span that ended now. */
+void RecordTrace(const char *name, int detail, TraceTime start)
+{
+   const TraceTime now = GetMonotonicTime();
+   TraceSpan *sp = &spans[nextSpan];
+   sp->name = name;
+   sp->start = start;
+   sp->duration = (unsigned int)(now - start);
+   sp->detail = detail;
+   nextSpan += 1;
+   if(JUNLIKELY(nextSpan == TRACE_SIZE)) {
+      nextSpan = 0;
+      spansWrapped = 1;
+   }
+}
+
+/** Get the recorded spans in the Chrome trace event format. */
+char *GetTraceReport(void)
+{
+   TextBuffer buffer;
+   const unsigned int count = spansWrapped ? TRACE_SIZE : nextSpan;
+   const long pid = (long)getpid();
+   unsigned int index;
+   unsigned int x;
+
+   InitializeTextBuffer(&buffer, 64 + count * 96);
+
+   /* Spans are recorded when they end, so the oldest is next to be
+    * overwritten. The spans are already nested properly. */
+   AppendText(&buffer, "{\"traceEvents\":[");
+   index = spansWrapped ? nextSpan : 0;
+   for(x = 0; x < count; x++) {
+      const TraceSpan *sp = &spans[index];
+      AppendText(&buffer, "%s\n{\"name\":\"%s\",\"ph\":\"X\","
+                 "\"ts\":%llu,\"dur\":%u,\"pid\":%ld,\"tid\":%ld",
+                 x ? "," : "", sp->name, sp->start, sp->duration,
+                 pid, pid);
+      if(sp->detail >= 0) {
+         AppendText(&buffer, ",\"args\":{\"detail\":%d}", sp->detail);
+      }
+      AppendText(&buffer, "}");
+      index = (index + 1) % TRACE_SIZE;
+   }
+   AppendText(&buffer, "\n],\"displayTimeUnit\":\"ms\"}\n");
+   return buffer.data;
+}
+
+/** Request that the spans be written to a file. */
+void RequestTrace(void)
+{
+   traceRequested = 1;
+}
+
+/** Write the spans to a file if requested. */
+void ProcessTraceRequest(void)
+{
+   const char *dir;
+   char *report;
+   char *path;
+   size_t len;
+   int fd;
+
+   if(JLIKELY(!traceRequested)) {
+      return;
+   }
+   traceRequested = 0;
+
+   dir = getenv("XDG_RUNTIME_DIR");
+   if(!dir || !dir[0]) {
+      dir = "/tmp";
+   }
+   len = strlen(dir) + 32;
+   path = Allocate(len);
+   snprintf(path, len, "%s/jwm-trace-%ld.json", dir, (long)getpid());
+
+   fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+   if(JUNLIKELY(fd < 0)) {
+      Warning(_("could not write trace to %s"), path);
+   } else {
+      size_t offset = 0;
+      report = GetTraceReport();
+      len = strlen(report);
+      while(offset < len) {
+         const ssize_t rc = write(fd, &report[offset], len - offset);
+         if(rc <= 0) {
+            Warning(_("could not write trace to %s"), path);
+            break;
+         }
+         offset += rc;
+      }
+      close(fd);
+      Release(report);
+   }
+   Release(path);
+}
+
+/** Start the stall watchdog if a timeout is set. */
+void StartupWatchdog(void)
+{
+   struct sigaction sa;
+
+   watchdogDepth = 0;
+   watchdogIdle = 1;
+   watchdogFired = 0;
+   watchdogIdleStart = 0;
+   watchdogIdleTotal = 0;
+   watchdogTimeout = settings.stallTimeout * 1000UL;
+   if(!watchdogTimeout) {
+      return;
+   }
+
+#ifdef USE_BACKTRACE
+   if(settings.stallBacktrace) {
+      /* The first call may load libraries, which is not safe to do
+       * from the signal handler. */
+      void *frames[1];
+      backtrace(frames, 1);
+   }
+#endif
+
+   memset(&sa, 0, sizeof(sa));
+   sa.sa_flags = SA_RESTART;
+   sa.sa_handler = HandleWatchdog;
+   sigaction(SIGALRM, &sa, NULL);
+}
+
+/** Stop the stall watchdog. */
+void ShutdownWatchdog(void)
+{
+   if(watchdogTimeout) {
+      ArmWatchdog(0);
+      watchdogTimeout = 0;
+   }
+}
+
+/** Note that a handler started, for the stall watchdog. */
+void EnterWatchdog(const char *name, int detail, Window window)
+{
+   const int depth = watchdogDepth;
+   TraceTime now;
+
+   if(JLIKELY(!watchdogTimeout)) {
+      return;
+   }
+   now = GetMonotonicTime();
+   if(depth < WATCHDOG_DEPTH) {
+      WatchdogFrame *fp = &watchdogFrames[depth];
+      fp->name = name;
+      fp->detail = detail;
+      fp->window = window;
+      fp->start = now;
+      fp->idle = watchdogIdleTotal;
+   }
+   watchdogBusySince = now;
+   watchdogFired = 0;
+
+   /* The frame is complete before the signal handler can see it. */
+   watchdogDepth = depth + 1;
+}
+
+/** Note that the most recent handler passed to EnterWatchdog ended. */
+void LeaveWatchdog(void)
+{
+   TraceTime now;
+   int depth;
+
+   if(JLIKELY(!watchdogTimeout) || JUNLIKELY(watchdogDepth == 0)) {
+      return;
+   }
+   now = GetMonotonicTime();
+   depth = watchdogDepth - 1;
+   watchdogDepth = depth;
+   watchdogBusySince = now;
+   watchdogFired = 0;
+
+   if(depth < WATCHDOG_DEPTH) {
+      const WatchdogFrame *fp = &watchdogFrames[depth];
+      const TraceTime busy = now - fp->start
+                           - (watchdogIdleTotal - fp->idle);
+      if(JUNLIKELY(busy >= watchdogTimeout)) {
+         Warning(_("stall: %s (detail %d, window 0x%lx) ran for %lu ms"),
+                 fp->name, fp->detail, (unsigned long)fp->window,
+                 (unsigned long)(busy / 1000));
+         RequestTrace();
+      }
+   }
+}
+
+/** Note whether we are waiting for input. */
+void SetWatchdogIdle(char idle)
+{
+   TraceTime now;
+
+   if(JLIKELY(!watchdogTimeout)) {
+      return;
+   }
+   now = GetMonotonicTime();
+   if(idle) {
+      watchdogIdle = 1;
+      watchdogIdleStart = now;
+      ArmWatchdog(0);
+   } else if(watchdogIdle) {
+      if(watchdogIdleStart) {
+         watchdogIdleTotal += now - watchdogIdleStart;
+      }
+      watchdogBusySince = now;
+      watchdogFired = 0;
+      watchdogIdle = 0;
+      ArmWatchdog(Max(watchdogTimeout / 4, 1000));
+   }
+}
+
+/** Set the period of the watchdog timer in microseconds (0 to stop). */
+void ArmWatchdog(unsigned long period)
+{
+   struct itimerval timer;
+   timer.it_value.tv_sec = period / 1000000;
+   timer.it_value.tv_usec = period % 1000000;
+   timer.it_interval = timer.it_value;
+   setitimer(ITIMER_REAL, &timer, NULL);
+}
+
+/** Report a handler that is still running past the timeout.
+ * Only async-signal-safe calls are made here.
+ */
+void HandleWatchdog(int sig)
+{
+   const int savedErrno = errno;
+   const WatchdogFrame *fp;
+   TraceTime busy;
+   int depth;
+
+   if(watchdogIdle || watchdogFired) {
+      return;
+   }
+   busy = GetMonotonicTime() - watchdogBusySince;
+   if(busy < watchdogTimeout) {
+      errno = savedErrno;
+      return;
+   }
+   watchdogFired = 1;
+
+   depth = watchdogDepth;
+   WriteWatchdog("JWM: warning: stall in ");
+   if(depth == 0) {
+      WriteWatchdog("the event loop");
+   } else {
+      fp = &watchdogFrames[Min(depth, WATCHDOG_DEPTH) - 1];
+      WriteWatchdog(fp->name);
+      if(fp->detail >= 0) {
+         WriteWatchdog(" (detail ");
+         WriteWatchdogNumber((unsigned long)fp->detail, 10);
+         WriteWatchdog(", window 0x");
+      } else {
+         WriteWatchdog(" (window 0x");
+      }
+      WriteWatchdogNumber((unsigned long)fp->window, 16);
+      WriteWatchdog(")");
+   }
+   WriteWatchdog(" for ");
+   WriteWatchdogNumber((unsigned long)(busy / 1000), 10);
+   WriteWatchdog(" ms\n");
+
+#ifdef USE_BACKTRACE
+   if(settings.stallBacktrace) {
+      void *frames[BACKTRACE_SIZE];
+      const int count = backtrace(frames, BACKTRACE_SIZE);
+      backtrace_symbols_fd(frames, count, STDERR_FILENO);
+   }
+#endif
+
+   errno = savedErrno;
+}
+
+/** Write a string to stderr from the signal handler. */
+void WriteWatchdog(const char *str)
+{
+   if(write(STDERR_FILENO, str, strlen(str)) < 0) {
+      /* Nothing else can be done from a signal handler. */
+   }
+}
+
+/** Write a number to stderr from the signal handler. */
+void WriteWatchdogNumber(unsigned long value, unsigned int base)
+{
+   static const char DIGITS[] = "0123456789abcdef";
+   char buffer[24];
+   unsigned int x = sizeof(buffer) - 1;
+   buffer[x] = 0;
+   do {
+      x -= 1;
+      buffer[x] = DIGITS[value % base];
+      value /= base;
+   } while(value > 0);
+   WriteWatchdog(&buffer[x]);
+}
+
+#endif /* USE_TRACE */
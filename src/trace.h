@@ -0,0 +1,80 @@
+/**
+ * @file trace.h
+ * @author Joe Wingbermuehle
+ * @date 2026
+ *
+ * @brief Trace ring buffer.
+ *
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#ifdef USE_TRACE
+
+typedef unsigned long long TraceTime;
+
+/** Start timing a span.
+ * @return The start time to pass to RecordTrace.
+ */
+TraceTime StartTrace(void);
+
+/** Record a span that ended now.
+ * Only the most recent spans are kept.
+ * @param name The name of the span (must be a string literal).
+ * @param detail Extra detail such as an event type (-1 for none).
+ * @param start The time returned by StartTrace.
+ */
+void RecordTrace(const char *name, int detail, TraceTime start);
+
+/** Get the recorded spans in the Chrome trace event format.
+ * @return The JSON (to be released with Release).
+ */
+char *GetTraceReport(void);
+
+/** Request that the spans be written to a file.
+ * This is safe to call from a signal handler.
+ */
+void RequestTrace(void);
+
+/** Write the spans to a file if requested. */
+void ProcessTraceRequest(void);
+
+/*@{*/
+void StartupWatchdog(void);
+void ShutdownWatchdog(void);
+/*@}*/
+
+/** Note that a handler started, for the stall watchdog.
+ * @param name The name of the handler (must be a string literal).
+ * @param detail Extra detail such as an event type (-1 for none).
+ * @param window The window involved (None if unknown).
+ */
+void EnterWatchdog(const char *name, int detail, Window window);
+
+/** Note that the most recent handler passed to EnterWatchdog ended. */
+void LeaveWatchdog(void);
+
+/** Note whether we are waiting for input.
+ * Time spent waiting is not counted against a handler.
+ * @param idle 1 before waiting, 0 after.
+ */
+void SetWatchdogIdle(char idle);
+
+#else
+
+typedef int TraceTime;
+
+#define StartTrace()                0
+#define RecordTrace( n, d, s )      ((void)(s))
+#define RequestTrace()              ((void)0)
+#define ProcessTraceRequest()       ((void)0)
+#define StartupWatchdog()           ((void)0)
+#define ShutdownWatchdog()          ((void)0)
+#define EnterWatchdog( n, d, w )    ((void)0)
+#define LeaveWatchdog()             ((void)0)
+#define SetWatchdogIdle( i )        ((void)0)
+
+#endif /* USE_TRACE */
+
+#endif /* TRACE_H */
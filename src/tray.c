@@ -19,9 +19,14 @@
 #include "screen.h"
 #include "settings.h"
 #include "event.h"
+#include "expose.h"
 #include "client.h"
 #include "misc.h"
 #include "hint.h"
+#include "winmap.h"
+#include "place.h"
+#include "render.h"
+#include "font.h"
 
 #define DEFAULT_TRAY_WIDTH 32
 #define DEFAULT_TRAY_HEIGHT 32
@@ -30,27 +35,31 @@
 
 static TrayType *trays;
 static unsigned int trayCount;
+static char damagePending;
 
 static void HandleTrayExpose(TrayType *tp, const XExposeEvent *event);
+static void UpdateTraySuspension(TrayType *tp);
+static void DrawTrayOutline(const TrayType *tp);
 static void HandleTrayEnterNotify(TrayType *tp, const XCrossingEvent *event);
+static void HandleTrayLeaveNotify(TrayType *tp, const XCrossingEvent *event);
 
 static TrayComponentType *GetTrayComponent(TrayType *tp, int x, int y);
 static void HandleTrayButtonPress(TrayType *tp, const XButtonEvent *event);
 static void HandleTrayButtonRelease(TrayType *tp, const XButtonEvent *event);
 static void HandleTrayMotionNotify(TrayType *tp, const XMotionEvent *event);
 
-static void ComputeTrayGeometry(TrayType *tp);
-static int ComputeMaxWidth(TrayType *tp);
-static int ComputeTotalWidth(TrayType *tp);
-static int ComputeMaxHeight(TrayType *tp);
-static int ComputeTotalHeight(TrayType *tp);
-static char CheckHorizontalFill(TrayType *tp);
-static char CheckVerticalFill(TrayType *tp);
+static void ComputeTrayGeometry(TrayType *tp, int *fixedSize,
+                                unsigned int *variableCount);
+static void RelayoutTray(TrayType *tp, TrayComponentType *changed);
+static char GrowTrayBuffer(TrayType *tp);
 static void LayoutTray(TrayType *tp, int *variableSize,
                        int *variableRemainder);
 
-static void SignalTray(const TimeType *now, int x, int y, Window w,
-                       void *data);
+static void MergeTrayDamage(XRectangle *dest, const XRectangle *src);
+static long GetDamageArea(const XRectangle *rp);
+
+static void HideTrayTimeout(const TimeType *now, int x, int y, Window w,
+                            void *data);
 
 
 /** Initialize tray data. */
@@ -92,6 +101,7 @@ void StartupTray(void)
          | KeyPressMask
          | KeyReleaseMask
          | EnterWindowMask
+         | LeaveWindowMask
          | PointerMotionMask;
 
       attrMask |= CWBackPixel;
@@ -103,6 +113,7 @@ void StartupTray(void)
                                   tp->x, tp->y, tp->width, tp->height, 0,
                                   rootDepth, InputOutput,
                                   rootVisual, attrMask, &attr);
+      RegisterWindow(tp->window, WINDOW_TRAY, tp);
       SetAtomAtom(tp->window, ATOM_NET_WM_WINDOW_TYPE,
                   ATOM_NET_WM_WINDOW_TYPE_DOCK);
 
@@ -113,6 +124,11 @@ void StartupTray(void)
 
       SetDefaultCursor(tp->window);
 
+      /* Components share one buffer to save server memory. */
+      if(settings.lowMemory) {
+         GrowTrayBuffer(tp);
+      }
+
       /* Create and layout items on the tray. */
       xoffset = TRAY_BORDER_SIZE;
       yoffset = TRAY_BORDER_SIZE;
@@ -142,13 +158,17 @@ void StartupTray(void)
             }
             cp->width = Max(1, width);
             cp->height = Max(1, height);
-            (cp->Create)(cp);
          }
 
          cp->x = xoffset;
          cp->y = yoffset;
          cp->screenx = tp->x + xoffset;
          cp->screeny = tp->y + yoffset;
+         if(cp->Create) {
+            (cp->Create)(cp);
+         }
+         cp->layoutWidth = cp->width;
+         cp->layoutHeight = cp->height;
 
          if(cp->window != None) {
             JXReparentWindow(display, cp->window, tp->window,
@@ -164,6 +184,9 @@ void StartupTray(void)
 
       /* Show the tray. */
       JXMapWindow(display, tp->window);
+      if(tp->autoHide != THIDE_OFF) {
+         RegisterTimeout(tp->autoHideDelay, HideTrayTimeout, tp);
+      }
 
       trayCount += 1;
 
@@ -179,12 +202,24 @@ void ShutdownTray(void)
    TrayType *tp;
    TrayComponentType *cp;
 
+   damagePending = 0;
    for(tp = trays; tp; tp = tp->next) {
       for(cp = tp->components; cp; cp = cp->next) {
+         cp->damageCount = 0;
          if(cp->Destroy) {
             (cp->Destroy)(cp);
          }
+         ReleaseTrayPixmap(cp);
       }
+      if(tp->buffer != None) {
+         ReleaseRenderTarget(tp->buffer);
+         ReleaseFontTarget(tp->buffer);
+         JXFreePixmap(display, tp->buffer);
+         tp->buffer = None;
+         tp->bufferWidth = 0;
+         tp->bufferHeight = 0;
+      }
+      UnregisterWindow(tp->window);
       JXDestroyWindow(display, tp->window);
    }
 }
@@ -197,9 +232,7 @@ void DestroyTray(void)
 
    while(trays) {
       tp = trays->next;
-      if(trays->autoHide != THIDE_OFF) {
-         UnregisterCallback(SignalTray, trays);
-      }
+      UnregisterTimeout(HideTrayTimeout, trays);
       while(trays->components) {
          cp = trays->components->next;
          Release(trays->components);
@@ -232,12 +265,16 @@ TrayType *CreateTray(void)
    tp->valign = TALIGN_FIXED;
    tp->halign = TALIGN_FIXED;
 
-   GetCurrentTime(&tp->showTime);
    tp->autoHide = THIDE_OFF;
    tp->autoHideDelay = 0;
    tp->hidden = 0;
+   tp->covered = 0;
+   tp->suspended = 0;
 
    tp->window = None;
+   tp->buffer = None;
+   tp->bufferWidth = 0;
+   tp->bufferHeight = 0;
 
    tp->components = NULL;
    tp->componentsTail = NULL;
@@ -264,10 +301,15 @@ TrayComponentType *CreateTrayComponent(void)
    cp->requestedHeight = 0;
    cp->width = 0;
    cp->height = 0;
+   cp->layoutWidth = 0;
+   cp->layoutHeight = 0;
    cp->grabbed = 0;
 
    cp->window = None;
    cp->pixmap = None;
+   cp->pixmapX = 0;
+   cp->pixmapY = 0;
+   cp->damageCount = 0;
 
    cp->Create = NULL;
    cp->Destroy = NULL;
@@ -279,6 +321,7 @@ TrayComponentType *CreateTrayComponent(void)
    cp->ProcessButtonRelease = NULL;
    cp->ProcessMotionEvent = NULL;
    cp->Redraw = NULL;
+   cp->SetSuspended = NULL;
 
    cp->next = NULL;
 
@@ -298,108 +341,20 @@ void AddTrayComponent(TrayType *tp, TrayComponentType *cp)
    cp->next = NULL;
 }
 
-/** Compute the max component width. */
-int ComputeMaxWidth(TrayType *tp)
-{
-   TrayComponentType *cp;
-   int result;
-   int temp;
-
-   result = 0;
-   for(cp = tp->components; cp; cp = cp->next) {
-      temp = cp->width;
-      if(temp > 0) {
-         if(temp > result) {
-            result = temp;
-         }
-      }
-   }
-
-   return result;
-}
-
-/** Compute the total width of a tray. */
-int ComputeTotalWidth(TrayType *tp)
-{
-   TrayComponentType *cp;
-   int result;
-
-   result = 2 * TRAY_BORDER_SIZE;
-   for(cp = tp->components; cp; cp = cp->next) {
-      result += cp->width;
-   }
-
-   return result;
-}
-
-/** Compute the max component height. */
-int ComputeMaxHeight(TrayType *tp)
-{
-   TrayComponentType *cp;
-   int result;
-   int temp;
-
-   result = 0;
-   for(cp = tp->components; cp; cp = cp->next) {
-      temp = cp->height;
-      if(temp > 0) {
-         if(temp > result) {
-            result = temp;
-         }
-      }
-   }
-
-   return result;
-}
-
-/** Compute the total height of a tray. */
-int ComputeTotalHeight(TrayType *tp)
-{
-   TrayComponentType *cp;
-   int result;
-
-   result = 2 * TRAY_BORDER_SIZE;
-   for(cp = tp->components; cp; cp = cp->next) {
-      result += cp->height;
-   }
-
-   return result;
-}
-
-/** Check if the tray fills the screen horizontally. */
-char CheckHorizontalFill(TrayType *tp)
-{
-   TrayComponentType *cp;
-
-   for(cp = tp->components; cp; cp = cp->next) {
-      if(cp->width == 0) {
-         return 1;
-      }
-   }
-
-   return 0;
-}
-
-/** Check if the tray fills the screen vertically. */
-char CheckVerticalFill(TrayType *tp)
-{
-   TrayComponentType *cp;
-
-   for(cp = tp->components; cp; cp = cp->next) {
-      if(cp->height == 0) {
-         return 1;
-      }
-   }
-
-   return 0;
-}
-
-/** Compute the size and position of a tray. */
-void ComputeTrayGeometry(TrayType *tp)
+/** Compute the size and position of a tray.
+ * The component sizes are totaled along the way for LayoutTray.
+ * @param tp The tray.
+ * @param fixedSize Set to the total size of the fixed size components
+ *        in the direction of the layout.
+ * @param variableCount Set to the number of variable size components.
+ */
+void ComputeTrayGeometry(TrayType *tp, int *fixedSize,
+                         unsigned int *variableCount)
 {
    const ScreenType *sp = GetScreen(tp->screen);
    TrayComponentType *cp;
    int x, y;
+   int maxSize, size;
 
    /* Set requested position.
     * The requested coordinates (if provided) are screen-relative.
@@ -433,30 +388,28 @@ void ComputeTrayGeometry(TrayType *tp)
    } else {
       tp->height = sp->height + tp->requestedHeight - (y - sp->y);
    }
+   maxSize = 0;
    for(cp = tp->components; cp; cp = cp->next) {
-      if(cp->requestedWidth) {
-         cp->width = cp->requestedWidth;
-      } else {
-         cp->width = 0;
-      }
-      if(cp->requestedHeight) {
-         cp->height = cp->requestedHeight;
+      cp->width = cp->requestedWidth;
+      cp->height = cp->requestedHeight;
+      if(tp->layout == LAYOUT_HORIZONTAL) {
+         maxSize = Max(maxSize, cp->height);
       } else {
-         cp->height = 0;
+         maxSize = Max(maxSize, cp->width);
       }
    }
 
    /* Determine the first dimension. */
    if(tp->layout == LAYOUT_HORIZONTAL) {
       if(tp->requestedHeight == 0) {
-         tp->height = ComputeMaxHeight(tp) + TRAY_BORDER_SIZE * 2;
+         tp->height = maxSize + TRAY_BORDER_SIZE * 2;
       }
       if(tp->height == 0) {
          tp->height = DEFAULT_TRAY_HEIGHT;
       }
    } else {
       if(tp->requestedWidth == 0) {
-         tp->width = ComputeMaxWidth(tp) + TRAY_BORDER_SIZE * 2;
+         tp->width = maxSize + TRAY_BORDER_SIZE * 2;
       }
       if(tp->width == 0) {
          tp->width = DEFAULT_TRAY_WIDTH;
@@ -464,23 +417,35 @@ void ComputeTrayGeometry(TrayType *tp)
    }
 
    /* Now at least one size is known. Inform the components. */
+   *fixedSize = 0;
+   *variableCount = 0;
    for(cp = tp->components; cp; cp = cp->next) {
-      if(cp->SetSize) {
-         if(tp->layout == LAYOUT_HORIZONTAL) {
+      if(tp->layout == LAYOUT_HORIZONTAL) {
+         if(cp->SetSize) {
             (cp->SetSize)(cp, 0, tp->height - TRAY_BORDER_SIZE * 2);
-         } else {
+         }
+         size = cp->width;
+      } else {
+         if(cp->SetSize) {
             (cp->SetSize)(cp, tp->width - TRAY_BORDER_SIZE * 2, 0);
          }
+         size = cp->height;
+      }
+      if(size > 0) {
+         *fixedSize += size;
+      } else {
+         *variableCount += 1;
       }
    }
 
-   /* Determine the missing dimension. */
+   /* Determine the missing dimension.
+    * Variable size components fill the screen. */
    if(tp->layout == LAYOUT_HORIZONTAL) {
       if(tp->requestedWidth == 0) {
-         if(CheckHorizontalFill(tp)) {
+         if(*variableCount) {
             tp->width = sp->width - abs(tp->requestedX);
          } else {
-            tp->width = ComputeTotalWidth(tp);
+            tp->width = *fixedSize + TRAY_BORDER_SIZE * 2;
          }
          if(tp->width == 0) {
             tp->width = DEFAULT_TRAY_WIDTH;
@@ -488,10 +453,10 @@ void ComputeTrayGeometry(TrayType *tp)
       }
    } else {
       if(tp->requestedHeight == 0) {
-         if(CheckVerticalFill(tp)) {
+         if(*variableCount) {
             tp->height = sp->height - abs(tp->requestedY);
          } else {
-            tp->height = ComputeTotalHeight(tp);
+            tp->height = *fixedSize + TRAY_BORDER_SIZE * 2;
          }
          if(tp->height == 0) {
             tp->height = DEFAULT_TRAY_HEIGHT;
@@ -550,9 +515,15 @@ void ShowTray(TrayType *tp)
    if(tp->hidden) {
 
       tp->hidden = 0;
-      GetCurrentTime(&tp->showTime);
       JXMoveWindow(display, tp->window, tp->x, tp->y);
 
+      /* Hide the tray again unless the mouse enters it. */
+      RegisterTimeout(tp->autoHideDelay, HideTrayTimeout, tp);
+
+      /* Components catch up with changes made while hidden. */
+      UpdateTraySuspension(tp);
+      DrawSpecificTray(tp);
+
       JXQueryPointer(display, rootWindow, &win1, &win2,
                      &mousex, &mousey, &winx, &winy, &mask);
       SetMousePosition(mousex, mousey, win2);
@@ -587,6 +558,7 @@ void HideTray(TrayType *tp)
    }
 
    tp->hidden = 1;
+   UpdateTraySuspension(tp);
 
    /* Derive the location for hiding the tray. */
    sp = GetCurrentScreen(tp->x, tp->y);
@@ -643,64 +615,113 @@ void HideTray(TrayType *tp)
 /** Process a tray event. */
 char ProcessTrayEvent(const XEvent *event)
 {
-   TrayType *tp;
+   WindowKind kind;
+   TrayType *tp = LookupWindow(event->xany.window, &kind);
 
-   for(tp = trays; tp; tp = tp->next) {
-      if(event->xany.window == tp->window) {
-         switch(event->type) {
-         case Expose:
-            HandleTrayExpose(tp, &event->xexpose);
-            return 1;
-         case EnterNotify:
-            HandleTrayEnterNotify(tp, &event->xcrossing);
-            return 1;
-         case ButtonPress:
-            HandleTrayButtonPress(tp, &event->xbutton);
-            return 1;
-         case ButtonRelease:
-            HandleTrayButtonRelease(tp, &event->xbutton);
-            return 1;
-         case MotionNotify:
-            HandleTrayMotionNotify(tp, &event->xmotion);
-            return 1;
-         default:
-            return 0;
-         }
-      }
+   if(kind != WINDOW_TRAY) {
+      return 0;
+   }
+   switch(event->type) {
+   case Expose:
+      HandleTrayExpose(tp, &event->xexpose);
+      return 1;
+   case EnterNotify:
+      HandleTrayEnterNotify(tp, &event->xcrossing);
+      return 1;
+   case LeaveNotify:
+      HandleTrayLeaveNotify(tp, &event->xcrossing);
+      return 1;
+   case ButtonPress:
+      HandleTrayButtonPress(tp, &event->xbutton);
+      return 1;
+   case ButtonRelease:
+      HandleTrayButtonRelease(tp, &event->xbutton);
+      return 1;
+   case MotionNotify:
+      HandleTrayMotionNotify(tp, &event->xmotion);
+      return 1;
+   default:
+      return 0;
    }
-
-   return 0;
 }
 
-/** Signal the tray (needed for autohide). */
-void SignalTray(const TimeType *now, int x, int y, Window w, void *data)
+/** Hide a tray once the autohide delay has passed. */
+void HideTrayTimeout(const TimeType *now, int x, int y, Window w, void *data)
 {
    TrayType *tp = (TrayType*)data;
-   Assert(tp->autoHide != THIDE_OFF);
-   if(tp->hidden || menuShown) {
+   if(tp->hidden || (tp->autoHide & ~THIDE_RAISED) == THIDE_OFF) {
       return;
    }
 
+   /* Keep the tray while a menu (possibly from the tray) is open. */
+   if(menuShown) {
+      RegisterTimeout(tp->autoHideDelay, HideTrayTimeout, tp);
+      return;
+   }
+
+   /* The timer may outlast a missed crossing event. */
    if(x < tp->x || x >= tp->x + tp->width
       || y < tp->y || y >= tp->y + tp->height) {
-      if(GetTimeDifference(now, &tp->showTime) >= tp->autoHideDelay) {
-         HideTray(tp);
-      }
-   } else {
-      tp->showTime = *now;
+      HideTray(tp);
    }
 }
 
-/** Handle a tray expose event. */
+/** Handle a tray expose event.
+ * Only the parts of components in the exposed region are copied. The
+ * outline is drawn again if the region reaches the edge of the tray.
+ */
 void HandleTrayExpose(TrayType *tp, const XExposeEvent *event)
 {
-   DrawSpecificTray(tp);
+   TrayComponentType *cp;
+   Region region;
+   Region part;
+   XRectangle box;
+
+   region = GetExposeRegion(tp->window);
+   if(!region) {
+      DrawSpecificTray(tp);
+      return;
+   }
+
+   for(cp = tp->components; cp; cp = cp->next) {
+      if(JXRectInRegion(region, cp->x, cp->y, cp->width, cp->height)
+         == RectangleOut) {
+         continue;
+      }
+      box.x = cp->x;
+      box.y = cp->y;
+      box.width = cp->width;
+      box.height = cp->height;
+      part = JXCreateRegion();
+      JXUnionRectWithRegion(&box, part, part);
+      JXIntersectRegion(part, region, part);
+      JXClipBox(part, &box);
+      JXDestroyRegion(part);
+      UpdateTrayArea(tp, cp, box.x - cp->x, box.y - cp->y,
+                     box.width, box.height);
+   }
+
+   if(JXRectInRegion(region, 1, 1, tp->width - 2, tp->height - 2)
+      != RectangleIn) {
+      DrawTrayOutline(tp);
+   }
 }
 
 /** Handle a tray enter notify (for autohide). */
 void HandleTrayEnterNotify(TrayType *tp, const XCrossingEvent *event)
 {
    ShowTray(tp);
+   UnregisterTimeout(HideTrayTimeout, tp);
+}
+
+/** Handle a tray leave notify (for autohide). */
+void HandleTrayLeaveNotify(TrayType *tp, const XCrossingEvent *event)
+{
+   /* Moving onto a swallowed window or dock icon is still on the tray. */
+   if(  (tp->autoHide & ~THIDE_RAISED) != THIDE_OFF
+      && event->detail != NotifyInferior) {
+      RegisterTimeout(tp->autoHideDelay, HideTrayTimeout, tp);
+   }
 }
 
 /** Get the tray component under the given coordinates. */
@@ -805,7 +826,12 @@ void DrawSpecificTray(const TrayType *tp)
    for(cp = tp->components; cp; cp = cp->next) {
       UpdateSpecificTray(tp, cp);
    }
+   DrawTrayOutline(tp);
+}
 
+/** Draw the outline of a tray. */
+void DrawTrayOutline(const TrayType *tp)
+{
    if(settings.trayDecorations == DECO_MOTIF) {
       JXSetForeground(display, rootGC, colors[COLOR_TRAY_UP]);
       JXDrawLine(display, tp->window, rootGC, 0, 0, tp->width - 1, 0);
@@ -832,6 +858,7 @@ void RaiseTrays(void)
       ShowTray(tp);
       JXRaiseWindow(display, tp->window);
    }
+   InvalidateStack();
 }
 
 /** Lower tray windows. */
@@ -840,55 +867,203 @@ void LowerTrays(void)
    TrayType *tp;
    for(tp = trays; tp; tp = tp->next) {
       tp->autoHide &= ~THIDE_RAISED;
+      if(tp->autoHide != THIDE_OFF) {
+         RegisterTimeout(tp->autoHideDelay, HideTrayTimeout, tp);
+      }
    }
    RequireRestack();
 }
 
 /** Update a specific component on a tray. */
-void UpdateSpecificTray(const TrayType *tp, const TrayComponentType *cp)
+void UpdateSpecificTray(const TrayType *tp, TrayComponentType *cp)
+{
+   UpdateTrayArea(tp, cp, 0, 0, cp->width, cp->height);
+}
+
+/** Update part of a component on a tray. */
+void UpdateTrayArea(const TrayType *tp, TrayComponentType *cp,
+                    int x, int y, int width, int height)
 {
+   XRectangle area;
+   long best;
+   unsigned int bestIndex;
+   unsigned int i;
+
    if(JUNLIKELY(shouldExit)) {
       return;
    }
+   if(cp->pixmap == None) {
+      return;
+   }
 
-   /* If the tray is hidden, draw only the background. */
-   if(cp->pixmap != None) {
-      JXCopyArea(display, cp->pixmap, tp->window, rootGC, 0, 0,
-                 cp->width, cp->height, cp->x, cp->y);
+   /* Clip to the component. */
+   if(x < 0) {
+      width += x;
+      x = 0;
+   }
+   if(y < 0) {
+      height += y;
+      y = 0;
+   }
+   width = Min(width, cp->width - x);
+   height = Min(height, cp->height - y);
+   if(width <= 0 || height <= 0) {
+      return;
+   }
+   area.x = x;
+   area.y = y;
+   area.width = width;
+   area.height = height;
+
+   /* Merge with areas where that costs no more than it saves.
+    * If the list is full, merge with the area that grows the least. */
+   for(;;) {
+      best = LONG_MAX;
+      bestIndex = 0;
+      for(i = 0; i < cp->damageCount; i++) {
+         XRectangle merged = cp->damage[i];
+         long cost;
+         MergeTrayDamage(&merged, &area);
+         cost = GetDamageArea(&merged) - GetDamageArea(&cp->damage[i])
+              - GetDamageArea(&area);
+         if(cost < best) {
+            best = cost;
+            bestIndex = i;
+         }
+      }
+      if(cp->damageCount == 0
+         || (best > 0 && cp->damageCount < TRAY_DAMAGE_COUNT)) {
+         break;
+      }
+      MergeTrayDamage(&area, &cp->damage[bestIndex]);
+      cp->damageCount -= 1;
+      cp->damage[bestIndex] = cp->damage[cp->damageCount];
    }
+   cp->damage[cp->damageCount] = area;
+   cp->damageCount += 1;
+   damagePending = 1;
+}
+
+/** Copy the damaged areas of all tray components to their trays. */
+void FlushTrayDamage(void)
+{
+   TrayType *tp;
+   TrayComponentType *cp;
+   unsigned int i;
+
+   if(!damagePending) {
+      return;
+   }
+   damagePending = 0;
+
+   for(tp = trays; tp; tp = tp->next) {
+
+      /* Covered trays are copied in full when uncovered. */
+      if(tp->covered) {
+         continue;
+      }
+
+      for(cp = tp->components; cp; cp = cp->next) {
+         for(i = 0; i < cp->damageCount; i++) {
+            const XRectangle *rp = &cp->damage[i];
+            const int width = Min(rp->width, cp->width - rp->x);
+            const int height = Min(rp->height, cp->height - rp->y);
+
+            /* The component may have shrunk since the area was added. */
+            if(cp->pixmap != None && width > 0 && height > 0) {
+               JXCopyArea(display, cp->pixmap, tp->window, rootGC,
+                          cp->pixmapX + rp->x, cp->pixmapY + rp->y,
+                          width, height,
+                          cp->x + rp->x, cp->y + rp->y);
+            }
+         }
+         cp->damageCount = 0;
+      }
+   }
+}
+
+/** Suspend or resume the components of a tray.
+ * Components are suspended while the tray is hidden or covered. Callers
+ * redraw the tray after it is resumed.
+ */
+void UpdateTraySuspension(TrayType *tp)
+{
+   TrayComponentType *cp;
+   const char suspended = tp->hidden || tp->covered;
+   if(suspended == tp->suspended) {
+      return;
+   }
+   tp->suspended = suspended;
+   for(cp = tp->components; cp; cp = cp->next) {
+      if(cp->SetSuspended) {
+         (cp->SetSuspended)(cp, suspended);
+      }
+   }
+}
+
+/** Update which trays are covered by a fullscreen client. */
+void UpdateTrayCoverage(void)
+{
+   const unsigned int hiddenMask = STAT_HIDDEN | STAT_MINIMIZED;
+   const ClientNode *np = GetActiveClient();
+   TrayType *tp;
+
+   /* The active fullscreen client is stacked above the trays. */
+   if(np && (!(np->state.status & STAT_FULLSCREEN)
+      || !(np->state.status & STAT_MAPPED)
+      || (np->state.status & hiddenMask))) {
+      np = NULL;
+   }
+
+   for(tp = trays; tp; tp = tp->next) {
+      const char covered = np != NULL
+         && tp->x >= np->x && tp->y >= np->y
+         && tp->x + tp->width <= np->x + np->width
+         && tp->y + tp->height <= np->y + np->height;
+      if(covered == tp->covered) {
+         continue;
+      }
+      tp->covered = covered;
+      UpdateTraySuspension(tp);
+      if(!covered) {
+         DrawSpecificTray(tp);
+      }
+   }
+}
+
+/** Extend a damaged area to include another. */
+void MergeTrayDamage(XRectangle *dest, const XRectangle *src)
+{
+   const int x1 = Min(dest->x, src->x);
+   const int y1 = Min(dest->y, src->y);
+   const int x2 = Max(dest->x + dest->width, src->x + src->width);
+   const int y2 = Max(dest->y + dest->height, src->y + src->height);
+   dest->x = x1;
+   dest->y = y1;
+   dest->width = x2 - x1;
+   dest->height = y2 - y1;
+}
+
+/** Get the number of pixels in a damaged area. */
+long GetDamageArea(const XRectangle *rp)
+{
+   return (long)rp->width * rp->height;
 }
 
 /** Layout tray components on a tray. */
 void LayoutTray(TrayType *tp, int *variableSize, int *variableRemainder)
 {
-   TrayComponentType *cp;
    unsigned int variableCount;
-   int width, height;
-   int temp;
+   int fixedSize;
+   int remaining;
 
-   ComputeTrayGeometry(tp);
+   ComputeTrayGeometry(tp, &fixedSize, &variableCount);
 
    /* Get the remaining size after setting fixed size components. */
-   /* Also, keep track of the number of variable size components. */
-   width = tp->width - TRAY_BORDER_SIZE * 2;
-   height = tp->height - TRAY_BORDER_SIZE * 2;
-   variableCount = 0;
-   for(cp = tp->components; cp; cp = cp->next) {
-      if(tp->layout == LAYOUT_HORIZONTAL) {
-         temp = cp->width;
-         if(temp > 0) {
-            width -= temp;
-         } else {
-            variableCount += 1;
-         }
-      } else {
-         temp = cp->height;
-         if(temp > 0) {
-            height -= temp;
-         } else {
-            variableCount += 1;
-         }
-      }
+   if(tp->layout == LAYOUT_HORIZONTAL) {
+      remaining = tp->width - TRAY_BORDER_SIZE * 2 - fixedSize;
+   } else {
+      remaining = tp->height - TRAY_BORDER_SIZE * 2 - fixedSize;
    }
 
    /* Distribute excess size among variable size components.
@@ -897,53 +1072,78 @@ void LayoutTray(TrayType *tp, int *variableSize, int *variableRemainder)
     */
    *variableSize = 1;
    *variableRemainder = 0;
-   if(tp->layout == LAYOUT_HORIZONTAL) {
-      if(variableCount) {
-         if(width >= variableCount) {
-            *variableSize = width / variableCount;
-            *variableRemainder = width % variableCount;
-         }
-      } else if(width > 0) {
-         tp->width -= width;
+   if(variableCount) {
+      if(remaining >= (int)variableCount) {
+         *variableSize = remaining / variableCount;
+         *variableRemainder = remaining % variableCount;
       }
-   } else {
-      if(variableCount) {
-         if(height >= variableCount) {
-            *variableSize = height / variableCount;
-            *variableRemainder = height % variableCount;
-         }
-      } else if(height > 0) {
-         tp->height -= height;
+   } else if(remaining > 0) {
+      if(tp->layout == LAYOUT_HORIZONTAL) {
+         tp->width -= remaining;
+      } else {
+         tp->height -= remaining;
       }
    }
 
    tp->width = Max(1, tp->width);
    tp->height = Max(1, tp->height);
+   InvalidateWorkarea();
 }
 
-/** Resize a tray. */
-void ResizeTray(TrayType *tp)
+/** Resize the tray containing a component. */
+void ResizeTray(TrayComponentType *changed)
+{
+   Assert(changed->tray);
+   RelayoutTray(changed->tray, changed);
+}
+
+/** Lay out all trays again after the screen geometry changed. */
+void ReconfigureTrays(void)
+{
+   TrayType *tp;
+   for(tp = trays; tp; tp = tp->next) {
+      if(tp->window != None) {
+         RelayoutTray(tp, NULL);
+      }
+   }
+}
+
+/** Lay out a tray and update the components that moved or changed.
+ * @param tp The tray.
+ * @param changed The component that requested the layout (or NULL).
+ */
+void RelayoutTray(TrayType *tp, TrayComponentType *changed)
 {
    TrayComponentType *cp;
    int variableSize;
    int variableRemainder;
    int xoffset, yoffset;
    int width, height;
-
-   Assert(tp);
-
+   int oldx, oldy, oldWidth, oldHeight;
+   Pixmap oldBuffer;
+   char moved, resized;
+   char sizeChanged, positionChanged;
+
+   oldx = tp->x;
+   oldy = tp->y;
+   oldWidth = tp->width;
+   oldHeight = tp->height;
    LayoutTray(tp, &variableSize, &variableRemainder);
+   moved = tp->x != oldx || tp->y != oldy;
+   resized = tp->width != oldWidth || tp->height != oldHeight;
+
+   /* The shared buffer only grows; its old contents are drawn again. */
+   oldBuffer = tp->buffer;
+   if(oldBuffer != None && !GrowTrayBuffer(tp)) {
+      oldBuffer = None;
+   }
 
-   /* Reposition items on the tray. */
+   /* Reposition items on the tray.
+    * Only components that changed are resized, moved, and redrawn. */
    xoffset = TRAY_BORDER_SIZE;
    yoffset = TRAY_BORDER_SIZE;
    for(cp = tp->components; cp; cp = cp->next) {
 
-      cp->x = xoffset;
-      cp->y = yoffset;
-      cp->screenx = tp->x + xoffset;
-      cp->screeny = tp->y + yoffset;
-
       if(cp->Resize) {
          if(tp->layout == LAYOUT_HORIZONTAL) {
             height = tp->height - TRAY_BORDER_SIZE * 2;
@@ -968,12 +1168,32 @@ void ResizeTray(TrayType *tp)
          }
          cp->width = width;
          cp->height = height;
-         (cp->Resize)(cp);
       }
+      sizeChanged = cp->width != cp->layoutWidth
+                 || cp->height != cp->layoutHeight;
+      positionChanged = cp->x != xoffset || cp->y != yoffset;
+      cp->layoutWidth = cp->width;
+      cp->layoutHeight = cp->height;
 
-      if(cp->window != None) {
+      cp->x = xoffset;
+      cp->y = yoffset;
+      cp->screenx = tp->x + xoffset;
+      cp->screeny = tp->y + yoffset;
+
+      /* Parts of the shared buffer move with the components. */
+      if(tp->buffer != None && cp->pixmap != None
+         && (oldBuffer != None || positionChanged)) {
+         sizeChanged = 1;
+      }
+      if(cp->Resize && (cp == changed || sizeChanged)) {
+         (cp->Resize)(cp);
+      }
+      if(cp->window != None && positionChanged) {
          JXMoveWindow(display, cp->window, xoffset, yoffset);
       }
+      if(!resized && (cp == changed || sizeChanged || positionChanged)) {
+         UpdateSpecificTray(tp, cp);
+      }
 
       if(tp->layout == LAYOUT_HORIZONTAL) {
          xoffset += cp->width;
@@ -982,28 +1202,99 @@ void ResizeTray(TrayType *tp)
       }
    }
 
-   JXMoveResizeWindow(display, tp->window, tp->x, tp->y,
-                      tp->width, tp->height);
+   if(oldBuffer != None) {
+      ReleaseRenderTarget(oldBuffer);
+      ReleaseFontTarget(oldBuffer);
+      JXFreePixmap(display, oldBuffer);
+   }
+
+   if(resized) {
+      JXMoveResizeWindow(display, tp->window, tp->x, tp->y,
+                         tp->width, tp->height);
+      DrawSpecificTray(tp);
+   } else if(moved) {
+      JXMoveWindow(display, tp->window, tp->x, tp->y);
+   }
 
    RequireTaskUpdate();
-   DrawSpecificTray(tp);
 
-   if(tp->hidden) {
+   if(tp->hidden && (moved || resized)) {
       HideTray(tp);
    }
 }
 
+/** Make the shared buffer of a tray at least as large as the tray.
+ * @return 1 if a new buffer was created, 0 if the old one still fits.
+ */
+char GrowTrayBuffer(TrayType *tp)
+{
+   if(tp->buffer != None
+      && tp->width <= tp->bufferWidth && tp->height <= tp->bufferHeight) {
+      return 0;
+   }
+   tp->bufferWidth = Max(tp->width, tp->bufferWidth);
+   tp->bufferHeight = Max(tp->height, tp->bufferHeight);
+   tp->buffer = JXCreatePixmap(display, rootWindow, tp->bufferWidth,
+                               tp->bufferHeight, rootDepth);
+   return 1;
+}
+
+/** Create the pixmap of a tray component. */
+void CreateTrayPixmap(TrayComponentType *cp)
+{
+   const TrayType *tp = cp->tray;
+   ReleaseTrayPixmap(cp);
+   if(tp->buffer != None
+      && cp->x + cp->width <= tp->bufferWidth
+      && cp->y + cp->height <= tp->bufferHeight) {
+      cp->pixmap = tp->buffer;
+      cp->pixmapX = cp->x;
+      cp->pixmapY = cp->y;
+   } else {
+      cp->pixmap = JXCreatePixmap(display, rootWindow, cp->width,
+                                  cp->height, rootDepth);
+      cp->pixmapX = 0;
+      cp->pixmapY = 0;
+   }
+}
+
+/** Release the pixmap of a tray component. */
+void ReleaseTrayPixmap(TrayComponentType *cp)
+{
+   if(cp->pixmap != None && cp->pixmap != cp->tray->buffer) {
+      ReleaseRenderTarget(cp->pixmap);
+      ReleaseFontTarget(cp->pixmap);
+      JXFreePixmap(display, cp->pixmap);
+   }
+   cp->pixmap = None;
+}
+
 /** Draw the tray background on a drawable. */
 void ClearTrayDrawable(const TrayComponentType *cp)
 {
-   const Drawable d = cp->pixmap != None ? cp->pixmap : cp->window;
+   ClearTrayArea(cp, 0, 0, cp->width, cp->height);
+}
+
+/** Draw the tray background on part of a drawable. */
+void ClearTrayArea(const TrayComponentType *cp,
+                   int x, int y, int width, int height)
+{
+   Drawable d = cp->window;
+   int ox = 0;
+   int oy = 0;
+   if(cp->pixmap != None) {
+      d = cp->pixmap;
+      ox = cp->pixmapX;
+      oy = cp->pixmapY;
+   }
    if(colors[COLOR_TRAY_BG1] == colors[COLOR_TRAY_BG2]) {
       JXSetForeground(display, rootGC, colors[COLOR_TRAY_BG1]);
-      JXFillRectangle(display, d, rootGC, 0, 0, cp->width, cp->height);
+      JXFillRectangle(display, d, rootGC, ox + x, oy + y, width, height);
    } else {
-      DrawHorizontalGradient(d, rootGC, colors[COLOR_TRAY_BG1],
-                             colors[COLOR_TRAY_BG2], 0, 0,
-                             cp->width, cp->height);
+      /* The gradient spans the whole component. */
+      DrawPartialGradient(d, rootGC, colors[COLOR_TRAY_BG1],
+                          colors[COLOR_TRAY_BG2], ox + x, oy + y,
+                          width, height, y, cp->height);
    }
 }
 
@@ -1024,16 +1315,8 @@ void SetAutoHideTray(TrayType *tp,
                      TrayAutoHideType autohide,
                      unsigned timeout_ms)
 {
-   if(JUNLIKELY(tp->autoHide != THIDE_OFF)) {
-      UnregisterCallback(SignalTray, tp);
-   }
-
    tp->autoHide = autohide;
    tp->autoHideDelay = timeout_ms;
-
-   if(autohide != THIDE_OFF) {
-      RegisterCallback(timeout_ms, SignalTray, tp);
-   }
 }
 
 /** Set the x-coordinate of a tray. */
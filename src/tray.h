@@ -38,6 +38,11 @@ typedef unsigned char TrayAutoHideType;
 #define THIDE_INVISIBLE 6 /**< Make the tray invisible when hidden. */
 #define THIDE_RAISED    8 /**< Mask to indicate the tray is raised. */
 
+/** Maximum number of damaged areas tracked per tray component.
+ * Further areas are merged into the existing ones.
+ */
+#define TRAY_DAMAGE_COUNT  4
+
 /** Structure to hold common tray component data.
  * Sizing is handled as follows:
  *  - The component is created via a factory method. It sets its
@@ -49,17 +54,18 @@ typedef unsigned char TrayAutoHideType;
  * Resizing is handled as follows:
  *  - A component determines that it needs to change size. It updates
  *    its requested size (0 for no preference).
- *  - The component calls ResizeTray.
+ *  - The component calls ResizeTray with itself.
  *  - The SetSize callback is issued with size constraints
  *    (0 for no constraint). The component should update
  *    width and height in SetSize.
  *  - The Resize callback is issued with finalized size information.
+ *    Other components only get the callback if their size changed.
  */
 typedef struct TrayComponentType {
 
    /** The tray containing the component.
-    * UpdateSpecificTray(TrayType*, TrayComponentType*) should be called
-    * when content changes.
+    * UpdateSpecificTray(TrayType*, TrayComponentType*) or UpdateTrayArea
+    * should be called when content changes.
     */
    struct TrayType *tray;
 
@@ -79,10 +85,19 @@ typedef struct TrayComponentType {
    int width;     /**< Actual width. */
    int height;    /**< Actual height. */
 
+   int layoutWidth;  /**< Width given by the last layout. */
+   int layoutHeight; /**< Height given by the last layout. */
+
    char grabbed;     /**< 1 if the mouse was grabbed by this component. */
 
    Window window;    /**< Content (if a window, otherwise None). */
    Pixmap pixmap;    /**< Content (if a pixmap, otherwise None). */
+   int pixmapX;      /**< x-coordinate of the content in the pixmap. */
+   int pixmapY;      /**< y-coordinate of the content in the pixmap. */
+
+   /** Areas of the pixmap not yet copied to the tray. */
+   XRectangle damage[TRAY_DAMAGE_COUNT];
+   unsigned char damageCount; /**< Number of damaged areas. */
 
    /** Callback to create the component. */
    void (*Create)(struct TrayComponentType *cp);
@@ -117,6 +132,12 @@ typedef struct TrayComponentType {
     */
    void (*Redraw)(struct TrayComponentType *cp);
 
+   /** Callback when the tray is hidden or covered, or shown again.
+    * Components stop periodic work and drawing while suspended and
+    * catch up when resumed. This is optional.
+    */
+   void (*SetSuspended)(struct TrayComponentType *cp, char suspended);
+
    /** The next component in the tray. */
    struct TrayComponentType *next;
 
@@ -143,13 +164,18 @@ typedef struct TrayType {
    TrayAlignmentType valign;  /**< Vertical alignment. */
    TrayAlignmentType halign;  /**< Horizontal alignment. */
 
-   TimeType showTime;
    TrayAutoHideType  autoHide;
    unsigned autoHideDelay;
    char hidden;     /**< 1 if hidden (due to autohide), 0 otherwise. */
+   char covered;    /**< 1 if covered by a fullscreen client. */
+   char suspended;  /**< 1 if components are suspended. */
 
    Window window; /**< The tray window. */
 
+   Pixmap buffer;       /**< Buffer shared by components (or None). */
+   int bufferWidth;     /**< Width of the shared buffer. */
+   int bufferHeight;    /**< Height of the shared buffer. */
+
    /** Start of the tray components. */
    struct TrayComponentType *components;
 
@@ -170,6 +196,13 @@ void DestroyTray(void);
  */
 TrayType *CreateTray(void);
 
+/** Update which trays are covered by a fullscreen client.
+ * Covered trays are not copied to the screen and their components are
+ * suspended. A tray that is uncovered is redrawn.
+ * This is called after the clients are restacked.
+ */
+void UpdateTrayCoverage(void);
+
 /** Create a tray component.
  * @return A new tray component structure.
  */
@@ -209,19 +242,67 @@ void RaiseTrays(void);
 void LowerTrays(void);
 
 /** Update a component on a tray.
+ * The copy to the tray is deferred until FlushTrayDamage.
+ * @param tp The tray containing the component.
+ * @param cp The component that needs updating.
+ */
+void UpdateSpecificTray(const TrayType *tp, TrayComponentType *cp);
+
+/** Update part of a component on a tray.
+ * Areas reported before the next FlushTrayDamage are merged, so
+ * components should report only the pixels that changed.
  * @param tp The tray containing the component.
  * @param cp The component that needs updating.
+ * @param x The x-coordinate of the area within the component.
+ * @param y The y-coordinate of the area within the component.
+ * @param width The width of the area.
+ * @param height The height of the area.
+ */
+void UpdateTrayArea(const TrayType *tp, TrayComponentType *cp,
+                    int x, int y, int width, int height);
+
+/** Copy the damaged areas of all tray components to their trays.
+ * This is called from the event loop before waiting for events.
  */
-void UpdateSpecificTray(const TrayType *tp, const TrayComponentType *cp);
+void FlushTrayDamage(void);
 
-/** Resize a tray.
- * @param tp The tray to resize containing the new requested size information.
+/** Resize the tray containing a component.
+ * Components are only resized, moved, and redrawn if their geometry
+ * changed, and the tray window only if its geometry changed.
+ * @param cp The component whose requested size changed.
  */
-void ResizeTray(TrayType *tp);
+void ResizeTray(TrayComponentType *cp);
+
+/** Lay out all trays again after the screen geometry changed. */
+void ReconfigureTrays(void);
+
+/** Create the pixmap of a tray component.
+ * Any previous pixmap is released. With LowMemory set, components
+ * that fit share the tray buffer and draw at pixmapX and pixmapY in it;
+ * otherwise the component gets its own pixmap at the origin.
+ * This is called from the Create and Resize callbacks.
+ * @param cp The component.
+ */
+void CreateTrayPixmap(TrayComponentType *cp);
+
+/** Release the pixmap of a tray component.
+ * @param cp The component.
+ */
+void ReleaseTrayPixmap(TrayComponentType *cp);
 
 /** Draw the tray background on a drawable. */
 void ClearTrayDrawable(const TrayComponentType *cp);
 
+/** Draw the tray background on part of a drawable.
+ * @param cp The component whose drawable to clear.
+ * @param x The x-coordinate of the area.
+ * @param y The y-coordinate of the area.
+ * @param width The width of the area.
+ * @param height The height of the area.
+ */
+void ClearTrayArea(const TrayComponentType *cp,
+                   int x, int y, int width, int height);
+
 /** Get a linked list of trays.
  * @return The trays.
  */
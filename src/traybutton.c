@@ -27,6 +27,7 @@
 #include "settings.h"
 #include "event.h"
 #include "action.h"
+#include "render.h"
 
 typedef struct TrayButtonType {
 
@@ -41,6 +42,8 @@ typedef struct TrayButtonType {
    int mousey;
    TimeType mouseTime;
 
+   char suspended;
+
    struct ActionNode *actions;
    struct TrayButtonType *next;
 
@@ -53,6 +56,7 @@ static void Destroy(TrayComponentType *cp);
 static void SetSize(TrayComponentType *cp, int width, int height);
 static void Resize(TrayComponentType *cp);
 static void Draw(TrayComponentType *cp);
+static void SetSuspended(TrayComponentType *cp, char suspended);
 
 static void ProcessButtonPress(TrayComponentType *cp,
                                int x, int y, int button);
@@ -100,7 +104,9 @@ void DestroyTrayButtons(void)
    TrayButtonType *bp;
    while(buttons) {
       bp = buttons->next;
-      UnregisterCallback(SignalTrayButton, buttons);
+      if(!buttons->suspended) {
+         UnregisterCallback(SignalTrayButton, buttons);
+      }
       if(buttons->label) {
          Release(buttons->label);
       }
@@ -138,6 +144,7 @@ TrayComponentType *CreateTrayButton(const char *iconName,
    buttons = bp;
 
    bp->icon = NULL;
+   bp->suspended = 0;
    bp->iconName = CopyString(iconName);
    bp->label = CopyString(label);
    bp->actions = NULL;
@@ -157,6 +164,7 @@ TrayComponentType *CreateTrayButton(const char *iconName,
    cp->SetSize = SetSize;
    cp->Resize = Resize;
    cp->Redraw = Draw;
+   cp->SetSuspended = SetSuspended;
 
    cp->ProcessButtonPress = ProcessButtonPress;
    cp->ProcessButtonRelease = ProcessButtonRelease;
@@ -253,24 +261,20 @@ void SetSize(TrayComponentType *cp, int width, int height)
 /** Initialize a button tray component. */
 void Create(TrayComponentType *cp)
 {
-   cp->pixmap = JXCreatePixmap(display, rootWindow,
-                               cp->width, cp->height, rootDepth);
+   CreateTrayPixmap(cp);
    Draw(cp);
 }
 
 /** Resize a button tray component. */
 void Resize(TrayComponentType *cp)
 {
-   Destroy(cp);
    Create(cp);
 }
 
 /** Destroy a button tray component. */
 void Destroy(TrayComponentType *cp)
 {
-   if(cp->pixmap != None) {
-      JXFreePixmap(display, cp->pixmap);
-   }
+   ReleaseTrayPixmap(cp);
 }
 
 /** Draw a tray button. */
@@ -292,8 +296,8 @@ void Draw(TrayComponentType *cp)
    button.width = cp->width;
    button.height = cp->height;
    button.border = settings.trayDecorations == DECO_MOTIF;
-   button.x = 0;
-   button.y = 0;
+   button.x = cp->pixmapX;
+   button.y = cp->pixmapY;
    button.font = FONT_TRAY;
    button.text = bp->label;
    button.icon = bp->icon;
@@ -324,6 +328,18 @@ void ProcessMotionEvent(TrayComponentType *cp, int x, int y, int mask)
    GetCurrentTime(&bp->mouseTime);
 }
 
+/** Stop checking for popups while the tray is not shown. */
+void SetSuspended(TrayComponentType *cp, char suspended)
+{
+   TrayButtonType *bp = (TrayButtonType*)cp->object;
+   bp->suspended = suspended;
+   if(suspended) {
+      UnregisterCallback(SignalTrayButton, bp);
+   } else {
+      RegisterCallback(settings.popupDelay / 2, SignalTrayButton, bp);
+   }
+}
+
 /** Signal (needed for popups). */
 void SignalTrayButton(const TimeType *now, int x, int y, Window w, void *data)
 {
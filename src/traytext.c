@@ -0,0 +1,304 @@
+/**
+ * @file traytext.c
+ * @author Joe Wingbermuehle
+ * @date 2026
+ *
+ * @brief Tray component showing lines read from a process.
+ *
+ * The command runs for the life of the tray and writes one line for
+ * each update. The text is only drawn again when a line differs from
+ * the one shown.
+ *
+ */
+
+#include "jwm.h"
+#include "traytext.h"
+#include "tray.h"
+#include "color.h"
+#include "font.h"
+#include "gradient.h"
+#include "main.h"
+#include "command.h"
+#include "misc.h"
+#include "error.h"
+#include "action.h"
+
+/** Structure to represent a text tray component. */
+typedef struct TrayTextType {
+
+   TrayComponentType *cp;        /**< Common component data. */
+
+   char *command;                /**< The command to run. */
+   struct ActionNode *actions;   /**< Actions */
+   char *text;                   /**< The last line read. */
+   char *shown;                  /**< Currently displayed string. */
+   int textx;                    /**< Location of the displayed string. */
+   int textWidth;                /**< Width of the displayed string. */
+
+   int userWidth;                /**< User-specified width (or 0). */
+   char running;                 /**< Set while the command runs. */
+   char suspended;               /**< Set while the tray is not shown. */
+
+   struct TrayTextType *next;    /**< Next text component in the list. */
+
+} TrayTextType;
+
+static TrayTextType *texts;
+
+static void Create(TrayComponentType *cp);
+static void Resize(TrayComponentType *cp);
+static void Destroy(TrayComponentType *cp);
+static void SetSuspended(TrayComponentType *cp, char suspended);
+static void ProcessTextButtonPress(TrayComponentType *cp,
+                                   int x, int y, int button);
+static void ProcessTextButtonRelease(TrayComponentType *cp,
+                                     int x, int y, int button);
+
+static void ReadTrayText(const char *line, void *data);
+static void DrawTrayText(TrayTextType *tt);
+
+/** Initialize text components. */
+void InitializeTrayText(void)
+{
+   texts = NULL;
+}
+
+/** Start text components. */
+void StartupTrayText(void)
+{
+   TrayTextType *tt;
+   for(tt = texts; tt; tt = tt->next) {
+      if(tt->cp->requestedWidth == 0) {
+         tt->cp->requestedWidth = 1;
+      }
+      if(tt->cp->requestedHeight == 0) {
+         tt->cp->requestedHeight = GetStringHeight(FONT_CLOCK) + 4;
+      }
+      tt->running = 1;
+      ReadLinesFromProcess(tt->command, ReadTrayText, tt);
+   }
+}
+
+/** Stop the commands of text components. */
+void ShutdownTrayText(void)
+{
+   TrayTextType *tt;
+   for(tt = texts; tt; tt = tt->next) {
+      if(tt->running) {
+         CancelReadFromProcess(ReadTrayText, tt);
+         tt->running = 0;
+      }
+   }
+}
+
+/** Destroy text components. */
+void DestroyTrayText(void)
+{
+   while(texts) {
+      TrayTextType *tt = texts->next;
+      Release(texts->command);
+      if(texts->text) {
+         Release(texts->text);
+      }
+      if(texts->shown) {
+         Release(texts->shown);
+      }
+      DestroyActions(texts->actions);
+      Release(texts);
+      texts = tt;
+   }
+}
+
+/** Create a text tray component. */
+TrayComponentType *CreateTrayText(const char *command, int width, int height)
+{
+
+   TrayComponentType *cp;
+   TrayTextType *tt;
+
+   if(JUNLIKELY(!command)) {
+      Warning(_("no command specified for TrayText"));
+      return NULL;
+   }
+
+   tt = Allocate(sizeof(TrayTextType));
+   tt->next = texts;
+   texts = tt;
+
+   tt->command = CopyString(command);
+   tt->actions = NULL;
+   tt->text = NULL;
+   tt->shown = NULL;
+   tt->running = 0;
+   tt->suspended = 0;
+
+   cp = CreateTrayComponent();
+   cp->object = tt;
+   tt->cp = cp;
+   if(width > 0) {
+      cp->requestedWidth = width;
+      tt->userWidth = 1;
+   } else {
+      cp->requestedWidth = 0;
+      tt->userWidth = 0;
+   }
+   cp->requestedHeight = height;
+
+   cp->Create = Create;
+   cp->Resize = Resize;
+   cp->Destroy = Destroy;
+   cp->SetSuspended = SetSuspended;
+   cp->ProcessButtonPress = ProcessTextButtonPress;
+   cp->ProcessButtonRelease = ProcessTextButtonRelease;
+
+   return cp;
+}
+
+/** Add an action to a text component. */
+void AddTrayTextAction(TrayComponentType *cp,
+                       const char *action,
+                       int mask)
+{
+   TrayTextType *tt = (TrayTextType*)cp->object;
+   AddAction(&tt->actions, action, mask);
+}
+
+/** Initialize a text tray component. */
+void Create(TrayComponentType *cp)
+{
+   CreateTrayPixmap(cp);
+}
+
+/** Resize a text tray component. */
+void Resize(TrayComponentType *cp)
+{
+   TrayTextType *tt = (TrayTextType*)cp->object;
+   CreateTrayPixmap(cp);
+   if(tt->shown) {
+      Release(tt->shown);
+      tt->shown = NULL;
+   }
+   DrawTrayText(tt);
+}
+
+/** Destroy a text tray component. */
+void Destroy(TrayComponentType *cp)
+{
+   TrayTextType *tt = (TrayTextType*)cp->object;
+   ReleaseTrayPixmap(cp);
+   if(tt->shown) {
+      Release(tt->shown);
+      tt->shown = NULL;
+   }
+}
+
+/** Stop drawing a text component while its tray is not shown.
+ * Lines are still read so the command does not block.
+ */
+void SetSuspended(TrayComponentType *cp, char suspended)
+{
+   TrayTextType *tt = (TrayTextType*)cp->object;
+   tt->suspended = suspended;
+   if(!suspended) {
+      DrawTrayText(tt);
+   }
+}
+
+/** Process a press event on a text tray component. */
+void ProcessTextButtonPress(TrayComponentType *cp, int x, int y, int button)
+{
+   const TrayTextType *tt = (TrayTextType*)cp->object;
+   ProcessActionPress(tt->actions, cp, x, y, button);
+}
+
+/** Process a release event on a text tray component. */
+void ProcessTextButtonRelease(TrayComponentType *cp,
+                              int x, int y, int button)
+{
+   const TrayTextType *tt = (TrayTextType*)cp->object;
+   ProcessActionRelease(tt->actions, cp, x, y, button);
+}
+
+/** Receive a line from the command of a text component. */
+void ReadTrayText(const char *line, void *data)
+{
+   TrayTextType *tt = (TrayTextType*)data;
+   if(!line) {
+      /* The command exited; keep the last line. */
+      tt->running = 0;
+      return;
+   }
+   if(tt->text && !strcmp(tt->text, line)) {
+      return;
+   }
+   if(tt->text) {
+      Release(tt->text);
+   }
+   tt->text = CopyString(line);
+   if(!tt->suspended) {
+      DrawTrayText(tt);
+   }
+}
+
+/** Draw a text tray component if the text changed. */
+void DrawTrayText(TrayTextType *tt)
+{
+
+   TrayComponentType *cp;
+   const char *text;
+   int width;
+   int rwidth;
+   int x;
+
+   cp = tt->cp;
+   if(cp->pixmap == None) {
+      return;
+   }
+   text = tt->text ? tt->text : "";
+   if(tt->shown && !strcmp(tt->shown, text)) {
+      return;
+   }
+
+   /* Determine if the component is the right size. */
+   width = GetStringWidth(FONT_CLOCK, text);
+   rwidth = width + 4;
+   if(rwidth != cp->requestedWidth && !tt->userWidth) {
+      cp->requestedWidth = rwidth;
+      ResizeTray(cp);
+      return;
+   }
+
+   /* Clear the area. */
+   if(colors[COLOR_CLOCK_BG1] == colors[COLOR_CLOCK_BG2]) {
+      JXSetForeground(display, rootGC, colors[COLOR_CLOCK_BG1]);
+      JXFillRectangle(display, cp->pixmap, rootGC,
+                      cp->pixmapX, cp->pixmapY, cp->width, cp->height);
+   } else {
+      DrawHorizontalGradient(cp->pixmap, rootGC,
+                             colors[COLOR_CLOCK_BG1], colors[COLOR_CLOCK_BG2],
+                             cp->pixmapX, cp->pixmapY,
+                             cp->width, cp->height);
+   }
+
+   /* Draw the text. */
+   x = Max((cp->width - width) / 2, 0);
+   RenderString(cp->pixmap, FONT_CLOCK, COLOR_CLOCK_FG,
+                cp->pixmapX + x, cp->pixmapY
+                + (cp->height - GetStringHeight(FONT_CLOCK)) / 2,
+                cp->width, text);
+
+   /* Update only the columns covered by the old and new strings. */
+   if(tt->shown) {
+      const int x1 = Min(x, tt->textx);
+      const int x2 = Min(Max(x + width, tt->textx + tt->textWidth),
+                         cp->width);
+      UpdateTrayArea(cp->tray, cp, x1, 0, x2 - x1, cp->height);
+      Release(tt->shown);
+   } else {
+      UpdateSpecificTray(cp->tray, cp);
+   }
+   tt->shown = CopyString(text);
+   tt->textx = x;
+   tt->textWidth = width;
+
+}
@@ -0,0 +1,41 @@
+/**
+ * @file traytext.h
+ * @author Joe Wingbermuehle
+ * @date 2026
+ *
+ * @brief Tray component showing lines read from a process.
+ *
+ */
+
+#ifndef TRAYTEXT_H
+#define TRAYTEXT_H
+
+struct TrayComponentType;
+
+/*@{*/
+void InitializeTrayText(void);
+void StartupTrayText(void);
+void ShutdownTrayText(void);
+void DestroyTrayText(void);
+/*@}*/
+
+/** Create a text component for the tray.
+ * The command is started when the tray starts and the last line it
+ * writes is shown.
+ * @param command The command to run.
+ * @param width The width of the text (0 for auto).
+ * @param height The height of the text (0 for auto).
+ */
+struct TrayComponentType *CreateTrayText(const char *command,
+                                         int width, int height);
+
+/** Add an action to a text component.
+ * @param cp The text component.
+ * @param action The action to take.
+ * @param mask The mouse button mask.
+ */
+void AddTrayTextAction(struct TrayComponentType *cp,
+                       const char *action,
+                       int mask);
+
+#endif /* TRAYTEXT_H */
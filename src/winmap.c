@@ -0,0 +1,164 @@
+/**
+ * @file winmap.c
+ * @author Joe Wingbermuehle
+ * @date 2026
+ *
+ * @brief Window lookup table.
+ *
+ * Windows are stored in an open-addressing hash table with linear
+ * probing so that a single probe tells both which object owns a window
+ * and what role the window plays (for example client window vs. frame).
+ *
+ */
+
+#include "jwm.h"
+#include "winmap.h"
+
+/** Initial number of slots (must be a power of 2). */
+#define INITIAL_SIZE 64
+
+/** Entry in the window table. */
+typedef struct WindowEntry {
+   Window window;       /**< The window (None for an empty slot). */
+   void *data;          /**< The object that owns the window. */
+   WindowKind kind;     /**< The kind of window. */
+} WindowEntry;
+
+static WindowEntry *windowTable = NULL;
+static unsigned int windowTableSize = 0;
+static unsigned int windowCount = 0;
+
+static unsigned int HashWindow(Window w);
+static void ResizeWindowMap(unsigned int size);
+
+/** Release the window table. */
+void DestroyWindowMap(void)
+{
+   if(windowTable) {
+      Release(windowTable);
+      windowTable = NULL;
+   }
+   windowTableSize = 0;
+   windowCount = 0;
+}
+
+/** Get the starting slot for a window.
+ * X resource IDs are allocated sequentially within a client's base, so
+ * the low bits are mixed to keep runs of IDs from clustering.
+ */
+unsigned int HashWindow(Window w)
+{
+   unsigned long h = (unsigned long)w;
+   h ^= h >> 16;
+   h *= 0x45D9F3BUL;
+   h ^= h >> 16;
+   return (unsigned int)h & (windowTableSize - 1);
+}
+
+/** Rehash the table into the specified number of slots. */
+void ResizeWindowMap(unsigned int size)
+{
+   WindowEntry *old = windowTable;
+   const unsigned int oldSize = windowTableSize;
+   unsigned int x;
+
+   windowTable = Allocate(sizeof(WindowEntry) * size);
+   windowTableSize = size;
+   for(x = 0; x < size; x++) {
+      windowTable[x].window = None;
+   }
+   for(x = 0; x < oldSize; x++) {
+      if(old[x].window != None) {
+         unsigned int index = HashWindow(old[x].window);
+         while(windowTable[index].window != None) {
+            index = (index + 1) & (size - 1);
+         }
+         windowTable[index] = old[x];
+      }
+   }
+   if(old) {
+      Release(old);
+   }
+}
+
+/** Register a window. */
+void RegisterWindow(Window w, WindowKind kind, void *data)
+{
+   unsigned int index;
+
+   Assert(w != None);
+   Assert(kind != WINDOW_NONE);
+
+   /* Keep the load factor at or below 1/2. */
+   if((windowCount + 1) * 2 > windowTableSize) {
+      ResizeWindowMap(windowTableSize ? windowTableSize * 2 : INITIAL_SIZE);
+   }
+
+   index = HashWindow(w);
+   while(windowTable[index].window != None) {
+      if(windowTable[index].window == w) {
+         windowTable[index].kind = kind;
+         windowTable[index].data = data;
+         return;
+      }
+      index = (index + 1) & (windowTableSize - 1);
+   }
+   windowTable[index].window = w;
+   windowTable[index].kind = kind;
+   windowTable[index].data = data;
+   windowCount += 1;
+}
+
+/** Remove a window from the table. */
+void UnregisterWindow(Window w)
+{
+   unsigned int index, next;
+
+   if(w == None || windowCount == 0) {
+      return;
+   }
+
+   index = HashWindow(w);
+   while(windowTable[index].window != w) {
+      if(windowTable[index].window == None) {
+         return;
+      }
+      index = (index + 1) & (windowTableSize - 1);
+   }
+
+   /* Shift back any entries that probed past the removed slot so that
+    * lookups never need tombstones. */
+   next = index;
+   for(;;) {
+      unsigned int home;
+      next = (next + 1) & (windowTableSize - 1);
+      if(windowTable[next].window == None) {
+         break;
+      }
+      home = HashWindow(windowTable[next].window);
+      if(((next - home) & (windowTableSize - 1))
+         >= ((next - index) & (windowTableSize - 1))) {
+         windowTable[index] = windowTable[next];
+         index = next;
+      }
+   }
+   windowTable[index].window = None;
+   windowCount -= 1;
+}
+
+/** Look up a window. */
+void *LookupWindow(Window w, WindowKind *kind)
+{
+   if(windowCount > 0 && w != None) {
+      unsigned int index = HashWindow(w);
+      while(windowTable[index].window != None) {
+         if(windowTable[index].window == w) {
+            *kind = windowTable[index].kind;
+            return windowTable[index].data;
+         }
+         index = (index + 1) & (windowTableSize - 1);
+      }
+   }
+   *kind = WINDOW_NONE;
+   return NULL;
+}
@@ -0,0 +1,44 @@
+/**
+ * @file winmap.h
+ * @author Joe Wingbermuehle
+ * @date 2026
+ *
+ * @brief Header for the window lookup table.
+ *
+ */
+
+#ifndef WINMAP_H
+#define WINMAP_H
+
+/** Kinds of windows stored in the table. */
+typedef enum {
+   WINDOW_NONE,      /**< Not registered. */
+   WINDOW_CLIENT,    /**< Client window (data is a ClientNode). */
+   WINDOW_FRAME,     /**< Client frame (data is a ClientNode). */
+   WINDOW_TRAY       /**< Tray window (data is a TrayType). */
+} WindowKind;
+
+/** Release the window table. */
+void DestroyWindowMap(void);
+
+/** Register a window.
+ * If the window is already registered, its entry is replaced.
+ * @param w The window.
+ * @param kind The kind of window.
+ * @param data The object that owns the window.
+ */
+void RegisterWindow(Window w, WindowKind kind, void *data);
+
+/** Remove a window from the table.
+ * @param w The window (may be None or unregistered).
+ */
+void UnregisterWindow(Window w);
+
+/** Look up a window.
+ * @param w The window.
+ * @param kind Set to the kind of window (WINDOW_NONE if not found).
+ * @return The object registered for the window or NULL.
+ */
+void *LookupWindow(Window w, WindowKind *kind);
+
+#endif /* WINMAP_H */
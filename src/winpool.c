@@ -0,0 +1,222 @@
+/**
+ * @file winpool.c
+ * @author Joe Wingbermuehle
+ * @date 2026
+ *
+ * @brief Pool of windows and pixmaps for short-lived surfaces.
+ *
+ * Menus and status windows are shown and hidden many times while
+ * navigating, so their windows are unmapped and kept rather than
+ * destroyed. Pixmaps for popups, dialogs, and the status window are
+ * kept as well and grow to the largest size requested.
+ *
+ */
+
+#include "jwm.h"
+#include "winpool.h"
+#include "main.h"
+#include "color.h"
+#include "hint.h"
+#include "settings.h"
+#include "render.h"
+#include "font.h"
+#include "misc.h"
+
+/** Maximum number of pooled windows. */
+#define WINDOW_POOL_SIZE   8
+
+/** Maximum number of pooled pixmaps. */
+#define PIXMAP_POOL_SIZE   4
+
+/** A pooled window. */
+typedef struct PooledWindow {
+   Window window;          /**< The window. */
+   PoolWindowType type;    /**< The kind of window. */
+   char used;              /**< Set if acquired. */
+} PooledWindow;
+
+/** A pooled pixmap. */
+typedef struct PooledPixmap {
+   Pixmap pixmap;          /**< The pixmap. */
+   int width, height;      /**< Size of the pixmap. */
+   char used;              /**< Set if acquired. */
+} PooledPixmap;
+
+static PooledWindow windows[WINDOW_POOL_SIZE];
+static unsigned int windowCount = 0;
+static PooledPixmap pixmaps[PIXMAP_POOL_SIZE];
+static unsigned int pixmapCount = 0;
+
+static Window CreatePoolWindow(PoolWindowType type, int x, int y,
+                               int width, int height);
+static void FreePoolPixmap(Pixmap p);
+
+/** Release the pooled windows and pixmaps. */
+void ShutdownWindowPool(void)
+{
+   unsigned int x;
+   for(x = 0; x < windowCount; x++) {
+      Assert(!windows[x].used);
+      JXDestroyWindow(display, windows[x].window);
+   }
+   windowCount = 0;
+   for(x = 0; x < pixmapCount; x++) {
+      Assert(!pixmaps[x].used);
+      FreePoolPixmap(pixmaps[x].pixmap);
+   }
+   pixmapCount = 0;
+}
+
+/** Get a window from the pool. */
+Window AcquirePoolWindow(PoolWindowType type, int x, int y,
+                         int width, int height)
+{
+   PooledWindow *wp;
+   unsigned int i;
+
+   Assert(type < POOL_WINDOW_COUNT);
+
+   for(i = 0; i < windowCount; i++) {
+      wp = &windows[i];
+      if(!wp->used && wp->type == type) {
+         JXMoveResizeWindow(display, wp->window, x, y, width, height);
+         wp->used = 1;
+         return wp->window;
+      }
+   }
+
+   /* When the pool is full, the window is destroyed on release. */
+   if(JUNLIKELY(windowCount >= WINDOW_POOL_SIZE)) {
+      return CreatePoolWindow(type, x, y, width, height);
+   }
+
+   wp = &windows[windowCount];
+   windowCount += 1;
+   wp->window = CreatePoolWindow(type, x, y, width, height);
+   wp->type = type;
+   wp->used = 1;
+   return wp->window;
+}
+
+/** Unmap a window and return it to the pool. */
+void ReleasePoolWindow(Window w)
+{
+   unsigned int i;
+   for(i = 0; i < windowCount; i++) {
+      if(windows[i].window == w) {
+         Assert(windows[i].used);
+         JXUnmapWindow(display, w);
+         windows[i].used = 0;
+         return;
+      }
+   }
+   JXDestroyWindow(display, w);
+}
+
+/** Create a window of a kind. */
+Window CreatePoolWindow(PoolWindowType type, int x, int y,
+                        int width, int height)
+{
+   XSetWindowAttributes attr;
+   unsigned long attrMask;
+   Window w;
+
+   attrMask = CWBackPixel | CWSaveUnder;
+   attr.background_pixel = colors[COLOR_MENU_BG];
+   attr.save_under = True;
+
+   if(type == POOL_WINDOW_MENU) {
+      attrMask |= CWEventMask;
+      attr.event_mask = ExposureMask;
+      w = JXCreateWindow(display, rootWindow, x, y, width, height, 0,
+                         CopyFromParent, InputOutput,
+                         CopyFromParent, attrMask, &attr);
+      SetAtomAtom(w, ATOM_NET_WM_WINDOW_TYPE, ATOM_NET_WM_WINDOW_TYPE_MENU);
+      if(settings.menuOpacity < UINT_MAX) {
+         SetCardinalAtom(w, ATOM_NET_WM_WINDOW_OPACITY, settings.menuOpacity);
+      }
+   } else {
+      attrMask |= CWOverrideRedirect;
+      attr.override_redirect = True;
+      w = JXCreateWindow(display, rootWindow, x, y, width, height, 0,
+                         rootDepth, InputOutput, rootVisual,
+                         attrMask, &attr);
+      SetAtomAtom(w, ATOM_NET_WM_WINDOW_TYPE,
+                  ATOM_NET_WM_WINDOW_TYPE_NOTIFICATION);
+   }
+   return w;
+}
+
+/** Get a pixmap of the root depth from the pool. */
+Pixmap AcquirePoolPixmap(int width, int height)
+{
+   PooledPixmap *best = NULL;
+   PooledPixmap *spare = NULL;
+   PooledPixmap *pp;
+   unsigned int i;
+
+   /* Take the smallest pixmap that fits. */
+   for(i = 0; i < pixmapCount; i++) {
+      pp = &pixmaps[i];
+      if(pp->used) {
+         continue;
+      }
+      if(pp->width >= width && pp->height >= height) {
+         if(!best || pp->width * pp->height < best->width * best->height) {
+            best = pp;
+         }
+      } else {
+         spare = pp;
+      }
+   }
+   if(best) {
+      best->used = 1;
+      return best->pixmap;
+   }
+
+   /* Otherwise replace a pixmap that is too small, keeping the larger
+    * dimensions so the pool settles on the largest size used. */
+   if(spare) {
+      FreePoolPixmap(spare->pixmap);
+      pp = spare;
+      width = Max(width, pp->width);
+      height = Max(height, pp->height);
+   } else if(JLIKELY(pixmapCount < PIXMAP_POOL_SIZE)) {
+      pp = &pixmaps[pixmapCount];
+      pixmapCount += 1;
+   } else {
+      return JXCreatePixmap(display, rootWindow, width, height, rootDepth);
+   }
+   pp->pixmap = JXCreatePixmap(display, rootWindow, width, height, rootDepth);
+   pp->width = width;
+   pp->height = height;
+   pp->used = 1;
+   return pp->pixmap;
+}
+
+/** Return a pixmap to the pool. */
+void ReleasePoolPixmap(Pixmap p)
+{
+   unsigned int i;
+   for(i = 0; i < pixmapCount; i++) {
+      if(pixmaps[i].pixmap == p) {
+         Assert(pixmaps[i].used);
+         if(settings.lowMemory) {
+            pixmapCount -= 1;
+            pixmaps[i] = pixmaps[pixmapCount];
+            break;
+         }
+         pixmaps[i].used = 0;
+         return;
+      }
+   }
+   FreePoolPixmap(p);
+}
+
+/** Free a pixmap and the drawing state cached for it. */
+void FreePoolPixmap(Pixmap p)
+{
+   ReleaseRenderTarget(p);
+   ReleaseFontTarget(p);
+   JXFreePixmap(display, p);
+}
@@ -0,0 +1,54 @@
+/**
+ * @file winpool.h
+ * @author Joe Wingbermuehle
+ * @date 2026
+ *
+ * @brief Pool of windows and pixmaps for short-lived surfaces.
+ *
+ */
+
+#ifndef WINPOOL_H
+#define WINPOOL_H
+
+/** Kinds of pooled windows. */
+typedef unsigned char PoolWindowType;
+#define POOL_WINDOW_MENU     0  /**< Menus. */
+#define POOL_WINDOW_STATUS   1  /**< Move and resize status. */
+#define POOL_WINDOW_COUNT    2
+
+/** Release the pooled windows and pixmaps. */
+void ShutdownWindowPool(void);
+
+/** Get a window from the pool.
+ * The window has the attributes and type for its kind and is moved and
+ * resized as requested. It is not mapped.
+ * @param type The kind of window.
+ * @param x The x-coordinate.
+ * @param y The y-coordinate.
+ * @param width The width.
+ * @param height The height.
+ * @return The window, which must be released with ReleasePoolWindow.
+ */
+Window AcquirePoolWindow(PoolWindowType type, int x, int y,
+                         int width, int height);
+
+/** Unmap a window and return it to the pool.
+ * @param w The window from AcquirePoolWindow.
+ */
+void ReleasePoolWindow(Window w);
+
+/** Get a pixmap of the root depth from the pool.
+ * The pixmap may be larger than requested and its contents are
+ * undefined.
+ * @param width The minimum width.
+ * @param height The minimum height.
+ * @return The pixmap, which must be released with ReleasePoolPixmap.
+ */
+Pixmap AcquirePoolPixmap(int width, int height);
+
+/** Return a pixmap to the pool.
+ * @param p The pixmap from AcquirePoolPixmap.
+ */
+void ReleasePoolPixmap(Pixmap p);
+
+#endif /* WINPOOL_H */
@@ -0,0 +1,144 @@
+/**
+ * @file xsync.c
+ * @author Joe Wingbermuehle
+ * @date 2026
+ *
+ * @brief Resize synchronization using _NET_WM_SYNC_REQUEST.
+ *
+ * Clients that support the protocol increment a sync counter once they
+ * have handled a configure. During a resize the next size is held back
+ * until the client has caught up with the previous one.
+ *
+ */
+
+#include "jwm.h"
+
+#ifdef USE_XSYNC
+
+#include "xsync.h"
+#include "client.h"
+#include "event.h"
+#include "main.h"
+#include "hint.h"
+#include "timing.h"
+
+/** Milliseconds to wait for a client before giving up on it. */
+#define SYNC_TIMEOUT 1000
+
+static XSyncCounter syncCounter = None;
+static XSyncAlarm syncAlarm = None;
+static XSyncValue syncValue;
+static TimeType syncTime;
+static char syncWaiting = 0;
+
+/** Start synchronizing the resize of a client. */
+void StartSyncResize(const ClientNode *np)
+{
+   XSyncAlarmAttributes aa;
+   XSyncValue value;
+   unsigned long counter;
+
+   StopSyncResize();
+   if(!haveSync || !(np->state.status & STAT_SYNC)) {
+      return;
+   }
+   if(!GetCardinalAtom(np->window, ATOM_NET_WM_SYNC_REQUEST_COUNTER,
+                       &counter) || counter == None) {
+      return;
+   }
+   if(!JXSyncQueryCounter(display, (XSyncCounter)counter, &value)) {
+      return;
+   }
+
+   syncCounter = (XSyncCounter)counter;
+   syncValue = value;
+   aa.trigger.counter = syncCounter;
+   aa.trigger.value_type = XSyncAbsolute;
+   aa.trigger.wait_value = value;
+   aa.trigger.test_type = XSyncPositiveComparison;
+   XSyncIntToValue(&aa.delta, 0);
+   aa.events = True;
+   syncAlarm = JXSyncCreateAlarm(display,
+                                 XSyncCACounter | XSyncCAValueType
+                                 | XSyncCAValue | XSyncCATestType
+                                 | XSyncCADelta | XSyncCAEvents, &aa);
+   syncWaiting = 0;
+}
+
+/** Stop synchronizing a resize. */
+void StopSyncResize(void)
+{
+   if(syncAlarm != None) {
+      JXSyncDestroyAlarm(display, syncAlarm);
+      syncAlarm = None;
+   }
+   syncCounter = None;
+   syncWaiting = 0;
+}
+
+/** Ask the client to acknowledge the next configure. */
+void SendSyncRequest(const ClientNode *np)
+{
+   XSyncAlarmAttributes aa;
+   XSyncValue one;
+   XEvent event;
+   Bool overflow;
+
+   if(syncAlarm == None) {
+      return;
+   }
+
+   XSyncIntToValue(&one, 1);
+   XSyncValueAdd(&syncValue, syncValue, one, &overflow);
+
+   memset(&event, 0, sizeof(event));
+   event.xclient.type = ClientMessage;
+   event.xclient.window = np->window;
+   event.xclient.message_type = atoms[ATOM_WM_PROTOCOLS];
+   event.xclient.format = 32;
+   event.xclient.data.l[0] = atoms[ATOM_NET_WM_SYNC_REQUEST];
+   event.xclient.data.l[1] = eventTime;
+   event.xclient.data.l[2] = XSyncValueLow32(syncValue);
+   event.xclient.data.l[3] = XSyncValueHigh32(syncValue);
+   JXSendEvent(display, np->window, False, NoEventMask, &event);
+
+   aa.trigger.wait_value = syncValue;
+   JXSyncChangeAlarm(display, syncAlarm, XSyncCAValue, &aa);
+
+   GetCurrentTime(&syncTime);
+   syncWaiting = 1;
+}
+
+/** Determine if the client has yet to acknowledge a configure. */
+char IsSyncPending(void)
+{
+   TimeType now;
+   if(!syncWaiting) {
+      return 0;
+   }
+   GetCurrentTime(&now);
+   if(GetTimeDifference(&now, &syncTime) > SYNC_TIMEOUT) {
+      Debug("client did not answer _NET_WM_SYNC_REQUEST");
+      StopSyncResize();
+      return 0;
+   }
+   return 1;
+}
+
+/** Handle an event from the sync extension. */
+char HandleSyncEvent(const XEvent *event)
+{
+   const XSyncAlarmNotifyEvent *ap;
+   if(!haveSync || event->type != syncEvent + XSyncAlarmNotify) {
+      return 0;
+   }
+   ap = (const XSyncAlarmNotifyEvent*)event;
+   if(  !syncWaiting || ap->alarm != syncAlarm
+      || !XSyncValueGreaterOrEqual(ap->counter_value, syncValue)) {
+      return 0;
+   }
+   syncWaiting = 0;
+   return 1;
+}
+
+#endif /* USE_XSYNC */
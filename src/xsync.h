@@ -0,0 +1,54 @@
+/**
+ * @file xsync.h
+ * @author Joe Wingbermuehle
+ * @date 2026
+ *
+ * @brief Resize synchronization using _NET_WM_SYNC_REQUEST.
+ *
+ */
+
+#ifndef XSYNC_H
+#define XSYNC_H
+
+struct ClientNode;
+
+#ifdef USE_XSYNC
+
+/** Start synchronizing the resize of a client.
+ * Nothing is done unless the client supports _NET_WM_SYNC_REQUEST.
+ * @param np The client being resized.
+ */
+void StartSyncResize(const struct ClientNode *np);
+
+/** Stop synchronizing a resize. */
+void StopSyncResize(void);
+
+/** Ask the client to acknowledge the next configure.
+ * This must be called before the client window is resized.
+ * @param np The client being resized.
+ */
+void SendSyncRequest(const struct ClientNode *np);
+
+/** Determine if the client has yet to acknowledge a configure.
+ * Clients that take too long are no longer waited for.
+ * @return 1 if the next configure should be held back.
+ */
+char IsSyncPending(void);
+
+/** Handle an event from the sync extension.
+ * @param event The event.
+ * @return 1 if the event was the acknowledgement of the last request.
+ */
+char HandleSyncEvent(const XEvent *event);
+
+#else
+
+#define StartSyncResize( a )     ((void)0)
+#define StopSyncResize()         ((void)0)
+#define SendSyncRequest( a )     ((void)0)
+#define IsSyncPending()          0
+#define HandleSyncEvent( a )     0
+
+#endif /* USE_XSYNC */
+
+#endif /* XSYNC_H */